@@ -65,10 +65,17 @@ struct benchmark_args {
 	bool thread_affinity;	 /* set worker threads CPU affinity mask */
 	ssize_t main_affinity;	 /* main thread affinity */
 	char *affinity_list;	 /* set CPU affinity order */
+	bool numa_interleave;	 /* spread worker threads across NUMA nodes */
+	char *numa_placement;	 /* pin workers local or remote to the pool */
 	size_t dsize;		 /* data size */
 	unsigned seed;		 /* PRNG seed */
 	unsigned repeats;	 /* number of repeats of one scenario */
+	unsigned n_processes;	 /* number of worker processes */
+	char *latency_json;	 /* latency histogram JSON output file */
+	bool perf_stats;	 /* sample hardware counters per repeat */
 	unsigned min_exe_time;	 /* minimal execution time */
+	size_t warmup;		 /* ops per thread excluded from stats */
+	unsigned steady_state;	 /* steady-state CV threshold in percent */
 	bool help;		 /* print help for benchmark */
 	void *opts;		 /* benchmark specific arguments */
 };
@@ -115,11 +122,16 @@ struct thread_results {
 	benchmark_time_t end_op[];
 };
 
+/* log2-bucketed latency histogram - bucket i covers [2^i, 2^(i+1)) nsec */
+#define LAT_HIST_BUCKETS 64
+
 /*
  * struct bench_results -- results of the whole benchmark
  */
 struct bench_results {
 	struct thread_results **thres;
+	uint64_t llc_misses;  /* LLC misses during the measured phase */
+	uint64_t dtlb_misses; /* dTLB misses during the measured phase */
 };
 
 /*
@@ -129,9 +141,14 @@ struct total_results {
 	size_t nrepeats;
 	size_t nthreads;
 	size_t nops;
+	size_t warmup;	 /* ops per thread excluded from statistics */
+	double steady_cv; /* steady-state CV threshold, 0 disables */
 	double nopsps;
 	struct results total;
 	struct latency latency;
+	uint64_t lat_hist[LAT_HIST_BUCKETS];
+	uint64_t llc_misses;  /* LLC misses summed over all repeats */
+	uint64_t dtlb_misses; /* dTLB misses summed over all repeats */
 	struct bench_results *res;
 };
 
@@ -60,6 +60,8 @@ struct map_bench_args {
 	char *type;
 	bool ext_tx;
 	bool alloc;
+	unsigned writers; /* number of writer threads (map_mixed) */
+	uint64_t burst;	  /* writer burst length in operations (map_mixed) */
 };
 
 struct map_bench_worker {
@@ -86,6 +88,15 @@ struct map_bench {
 	int (*insert)(struct map_bench *, uint64_t);
 	int (*remove)(struct map_bench *, uint64_t);
 	int (*get)(struct map_bench *, uint64_t);
+
+	/* map_mixed: the number of writers currently in an insert burst */
+	uint64_t burst_writers;
+
+	/* map_mixed: reader latency split by the writer phase */
+	uint64_t rd_quiet_ns;
+	uint64_t rd_quiet_ops;
+	uint64_t rd_burst_ns;
+	uint64_t rd_burst_ops;
 };
 
 /*
@@ -733,11 +744,197 @@ map_get_exit(struct benchmark *bench, struct benchmark_args *args)
 	return map_common_exit(bench, args);
 }
 
+/*
+ * Reader statistics of the last map_mixed run. They have to outlive the
+ * map_bench structure, which is freed before the results are printed.
+ */
+static struct {
+	uint64_t quiet_ns;
+	uint64_t quiet_ops;
+	uint64_t burst_ns;
+	uint64_t burst_ops;
+} map_mixed_stats;
+
+/*
+ * map_mixed_init -- init function for map_mixed benchmark
+ */
+static int
+map_mixed_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	auto *targs = (struct map_bench_args *)args->opts;
+
+	if (targs->writers >= args->n_threads) {
+		fprintf(stderr, "at least one reader thread is required\n");
+		return -1;
+	}
+
+	return map_bench_get_init(bench, args);
+}
+
+/*
+ * map_mixed_init_worker -- init worker function for map_mixed benchmark
+ *
+ * The first "writers" workers insert fresh random keys; the remaining
+ * workers look up keys prefilled into the map.
+ */
+static int
+map_mixed_init_worker(struct benchmark *bench, struct benchmark_args *args,
+		      struct worker_info *worker)
+{
+	auto *targs = (struct map_bench_args *)args->opts;
+
+	if (worker->index < targs->writers)
+		return map_insert_init_worker(bench, args, worker);
+
+	return map_bench_get_init_worker(bench, args, worker);
+}
+
+/*
+ * map_mixed_timespec_diff -- (internal) difference of two timespecs in
+ * nanoseconds
+ */
+static uint64_t
+map_mixed_timespec_diff(const struct timespec *t1, const struct timespec *t2)
+{
+	return (uint64_t)(t2->tv_sec - t1->tv_sec) * 1000000000ULL +
+		(uint64_t)t2->tv_nsec - (uint64_t)t1->tv_nsec;
+}
+
+/*
+ * map_mixed_op -- main operation for map_mixed benchmark
+ *
+ * Writers alternate between insert bursts and quiet phases of "burst-ops"
+ * operations each (during a quiet phase they perform lookups like
+ * the readers do). Readers always perform lookups and account their
+ * latency separately depending on whether any writer burst was in
+ * progress, which is what quantifies the reader latency degradation
+ * caused by the writers.
+ */
+static int
+map_mixed_op(struct benchmark *bench, struct operation_info *info)
+{
+	auto *map_bench = (struct map_bench *)pmembench_get_priv(bench);
+	auto *tworker = (struct map_bench_worker *)info->worker->priv;
+	auto *targs = (struct map_bench_args *)info->args->opts;
+
+	uint64_t key = tworker->keys[info->index];
+	int ret;
+
+	if (info->worker->index < targs->writers) {
+		uint64_t phase_op = info->index % (2 * targs->burst);
+
+		if (phase_op == 0) /* the burst phase begins */
+			util_fetch_and_add64(&map_bench->burst_writers, 1);
+		else if (phase_op == targs->burst) /* the quiet phase begins */
+			util_fetch_and_add64(&map_bench->burst_writers, -1);
+
+		mutex_lock_nofail(&map_bench->lock);
+
+		if (phase_op < targs->burst) {
+			ret = map_bench->insert(map_bench, key);
+		} else {
+			/* quiet writers look up keys which may not exist */
+			(void) map_bench->get(map_bench, key);
+			ret = 0;
+		}
+
+		mutex_unlock_nofail(&map_bench->lock);
+
+		return ret;
+	}
+
+	/* a reader */
+	uint64_t burst_writers;
+	util_atomic_load_explicit64(&map_bench->burst_writers, &burst_writers,
+				    memory_order_relaxed);
+
+	struct timespec t1;
+	struct timespec t2;
+	if (os_clock_gettime(CLOCK_MONOTONIC, &t1)) {
+		perror("os_clock_gettime");
+		return -1;
+	}
+
+	mutex_lock_nofail(&map_bench->lock);
+
+	ret = map_bench->get(map_bench, key);
+
+	mutex_unlock_nofail(&map_bench->lock);
+
+	if (os_clock_gettime(CLOCK_MONOTONIC, &t2)) {
+		perror("os_clock_gettime");
+		return -1;
+	}
+
+	uint64_t ns = map_mixed_timespec_diff(&t1, &t2);
+	if (burst_writers > 0) {
+		util_fetch_and_add64(&map_bench->rd_burst_ns, ns);
+		util_fetch_and_add64(&map_bench->rd_burst_ops, 1);
+	} else {
+		util_fetch_and_add64(&map_bench->rd_quiet_ns, ns);
+		util_fetch_and_add64(&map_bench->rd_quiet_ops, 1);
+	}
+
+	return ret;
+}
+
+/*
+ * map_mixed_exit -- exit function for map_mixed benchmark. Snapshots the
+ * reader statistics before the common cleanup frees them.
+ */
+static int
+map_mixed_exit(struct benchmark *bench, struct benchmark_args *args)
+{
+	auto *tree = (struct map_bench *)pmembench_get_priv(bench);
+
+	map_mixed_stats.quiet_ns = tree->rd_quiet_ns;
+	map_mixed_stats.quiet_ops = tree->rd_quiet_ops;
+	map_mixed_stats.burst_ns = tree->rd_burst_ns;
+	map_mixed_stats.burst_ops = tree->rd_burst_ops;
+
+	return map_get_exit(bench, args);
+}
+
+/*
+ * map_mixed_print_extra_headers -- prints the headers of the reader
+ * statistics columns
+ */
+static void
+map_mixed_print_extra_headers(void)
+{
+	printf(";reader-quiet-avg[nsec];reader-burst-avg[nsec]"
+	       ";reader-degradation");
+}
+
+/*
+ * map_mixed_print_extra_values -- prints the average reader latency in
+ * and outside of writer bursts and the ratio of the two
+ */
+static void
+map_mixed_print_extra_values(struct benchmark *bench,
+			     struct benchmark_args *args,
+			     struct total_results *res)
+{
+	double quiet = map_mixed_stats.quiet_ops == 0
+		? 0.0
+		: (double)map_mixed_stats.quiet_ns /
+			(double)map_mixed_stats.quiet_ops;
+	double burst = map_mixed_stats.burst_ops == 0
+		? 0.0
+		: (double)map_mixed_stats.burst_ns /
+			(double)map_mixed_stats.burst_ops;
+	double degradation = quiet == 0.0 ? 0.0 : burst / quiet;
+
+	printf(";%f;%f;%f", quiet, burst, degradation);
+}
+
 static struct benchmark_clo map_bench_clos[5];
+static struct benchmark_clo map_mixed_clos[7];
 
 static struct benchmark_info map_insert_info;
 static struct benchmark_info map_remove_info;
 static struct benchmark_info map_get_info;
+static struct benchmark_info map_mixed_info;
 
 CONSTRUCTOR(map_bench_constructor)
 void
@@ -843,4 +1040,55 @@ map_bench_constructor(void)
 	map_get_info.rm_file = true;
 	map_get_info.allow_poolset = true;
 	REGISTER_BENCHMARK(map_get_info);
+
+	/* map_mixed accepts all of the common options plus two own ones */
+	memcpy(map_mixed_clos, map_bench_clos, sizeof(map_bench_clos));
+
+	map_mixed_clos[5].opt_short = 'W';
+	map_mixed_clos[5].opt_long = "writers";
+	map_mixed_clos[5].descr = "Number of writer threads; the remaining "
+				  "threads are readers";
+	map_mixed_clos[5].off =
+		clo_field_offset(struct map_bench_args, writers);
+	map_mixed_clos[5].type = CLO_TYPE_UINT;
+	map_mixed_clos[5].def = "1";
+	map_mixed_clos[5].type_uint.size =
+		clo_field_size(struct map_bench_args, writers);
+	map_mixed_clos[5].type_uint.base = CLO_INT_BASE_DEC;
+	map_mixed_clos[5].type_uint.min = 1;
+	map_mixed_clos[5].type_uint.max = UINT_MAX;
+
+	map_mixed_clos[6].opt_short = 'B';
+	map_mixed_clos[6].opt_long = "burst-ops";
+	map_mixed_clos[6].descr = "Length of the writer insert bursts (and "
+				  "of the quiet phases between them) in "
+				  "operations";
+	map_mixed_clos[6].off = clo_field_offset(struct map_bench_args, burst);
+	map_mixed_clos[6].type = CLO_TYPE_UINT;
+	map_mixed_clos[6].def = "1000";
+	map_mixed_clos[6].type_uint.size =
+		clo_field_size(struct map_bench_args, burst);
+	map_mixed_clos[6].type_uint.base = CLO_INT_BASE_DEC;
+	map_mixed_clos[6].type_uint.min = 1;
+	map_mixed_clos[6].type_uint.max = UINT64_MAX;
+
+	map_mixed_info.name = "map_mixed";
+	map_mixed_info.brief = "Concurrent tree lookups with bursts "
+			       "of inserts";
+	map_mixed_info.init = map_mixed_init;
+	map_mixed_info.exit = map_mixed_exit;
+	map_mixed_info.multithread = true;
+	map_mixed_info.multiops = true;
+	map_mixed_info.init_worker = map_mixed_init_worker;
+	map_mixed_info.free_worker = map_common_free_worker;
+	map_mixed_info.operation = map_mixed_op;
+	map_mixed_info.measure_time = true;
+	map_mixed_info.clos = map_mixed_clos;
+	map_mixed_info.nclos = ARRAY_SIZE(map_mixed_clos);
+	map_mixed_info.opts_size = sizeof(struct map_bench_args);
+	map_mixed_info.rm_file = true;
+	map_mixed_info.allow_poolset = true;
+	map_mixed_info.print_extra_headers = map_mixed_print_extra_headers;
+	map_mixed_info.print_extra_values = map_mixed_print_extra_values;
+	REGISTER_BENCHMARK(map_mixed_info);
 }
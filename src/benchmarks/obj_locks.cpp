@@ -7,6 +7,13 @@
 
 #include <cassert>
 #include <cerrno>
+#include <cinttypes>
+#include <ctime>
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include "benchmark.hpp"
 #include "libpmemobj.h"
@@ -29,6 +36,7 @@ struct prog_args {
 	char *lock_mode;	      /* "1by1" or "all-lock" */
 	char *lock_type;	      /* "mutex", "rwlock" or "ram-mutex" */
 	bool use_rdlock;	      /* use read lock, instead of write lock */
+	unsigned n_waiters;	      /* number of waiter processes */
 };
 
 /*
@@ -50,6 +58,31 @@ typedef union lock_union {
 	os_rwlock_t pt_rwlock;
 } lock_t;
 
+/* number of power-of-two wakeup latency buckets */
+#define LAT_BUCKETS 64
+
+/*
+ * cond_region -- pool-resident state shared by the signaling process and
+ * the waiter processes in the cond wakeup benchmarks
+ *
+ * The region lives in the memory pool, so the forked waiters see it through
+ * the shared mapping. The histogram is filled by the waiters and read by
+ * the parent after they are reaped.
+ */
+struct cond_region {
+	PMEMmutex lock;		/* guards pending in the cond variant */
+	PMEMcond cond;		/* the waited-on condition variable */
+	uint64_t signal_ts;	/* CLOCK_MONOTONIC at signal time, ns */
+	uint64_t pending;	/* issued wakeups not yet consumed */
+	uint64_t acks;		/* wakeups consumed by the waiters */
+	uint32_t futex_word;	/* futex the waiters sleep on */
+	uint32_t shutdown;	/* set to make the waiters exit */
+	uint64_t hist[LAT_BUCKETS]; /* wakeup latency histogram */
+	uint64_t lat_sum;	/* sum of measured latencies, ns */
+	uint64_t lat_count;	/* number of measured wakeups */
+	uint64_t lat_max;	/* highest measured latency, ns */
+};
+
 POBJ_LAYOUT_BEGIN(pmembench_lock_layout);
 POBJ_LAYOUT_ROOT(pmembench_lock_layout, struct my_root);
 POBJ_LAYOUT_TOID(pmembench_lock_layout, lock_t);
@@ -78,6 +111,8 @@ enum benchmark_mode {
 	BENCH_MODE_MUTEX,	   /* PMEMmutex vs. os_mutex_t */
 	BENCH_MODE_RWLOCK,	   /* PMEMrwlock vs. os_rwlock_t */
 	BENCH_MODE_VOLATILE_MUTEX, /* PMEMmutex with os_thread mutex in RAM */
+	BENCH_MODE_COND,	   /* PMEMcond wakeups of waiter processes */
+	BENCH_MODE_FUTEX_COND,	   /* raw futex wakeups of waiter processes */
 	BENCH_MODE_MAX
 };
 
@@ -100,6 +135,9 @@ struct mutex_bench {
 	enum benchmark_mode lock_type; /* lock type */
 	lock_t *locks;		       /* pointer to the array of locks */
 	struct bench_ops *ops;
+	struct cond_region *cr;	       /* cond wakeup benchmarks state */
+	pid_t *waiter_pids;	       /* pids of the forked waiters */
+	uint64_t ops_issued;	       /* wakeups issued so far */
 };
 
 #define GET_VOLATILE_MUTEX(pop, mutexp)                                        \
@@ -598,10 +636,297 @@ op_bench_vmutex(struct mutex_bench *mb)
 	return 0;
 }
 
+/*
+ * monotonic_ns -- read CLOCK_MONOTONIC as nanoseconds
+ */
+static uint64_t
+monotonic_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * sys_futex -- thin wrapper around the futex syscall
+ */
+static long
+sys_futex(uint32_t *addr, int op, uint32_t val)
+{
+	return syscall(SYS_futex, addr, op, val, nullptr, nullptr, 0);
+}
+
+/*
+ * record_latency -- store one measured wakeup latency in the shared region
+ */
+static void
+record_latency(struct cond_region *cr, uint64_t ns)
+{
+	unsigned bucket = 0;
+	if (ns > 0)
+		bucket = (unsigned)(64 - __builtin_clzll(ns)) - 1;
+	if (bucket >= LAT_BUCKETS)
+		bucket = LAT_BUCKETS - 1;
+
+	util_fetch_and_add64(&cr->hist[bucket], 1);
+	util_fetch_and_add64(&cr->lat_sum, ns);
+	util_fetch_and_add64(&cr->lat_count, 1);
+
+	uint64_t max;
+	while (ns > (max = cr->lat_max)) {
+		if (util_bool_compare_and_swap64(&cr->lat_max, max, ns))
+			break;
+	}
+}
+
+/*
+ * cond_waiter_loop -- waiter process body for the "cond" benchmark
+ *
+ * Consumes wakeups delivered through pmemobj_cond_wait and records the
+ * time that passed since the matching pmemobj_cond_signal.
+ */
+static void
+cond_waiter_loop(struct mutex_bench *mb)
+{
+	struct cond_region *cr = mb->cr;
+
+	while (1) {
+		pmemobj_mutex_lock(mb->pop, &cr->lock);
+		while (cr->pending == 0 && !cr->shutdown)
+			pmemobj_cond_wait(mb->pop, &cr->cond, &cr->lock);
+		if (cr->shutdown) {
+			pmemobj_mutex_unlock(mb->pop, &cr->lock);
+			break;
+		}
+		uint64_t now = monotonic_ns();
+		cr->pending--;
+		record_latency(cr, now - cr->signal_ts);
+		util_fetch_and_add64(&cr->acks, 1);
+		pmemobj_mutex_unlock(mb->pop, &cr->lock);
+	}
+}
+
+/*
+ * futex_waiter_loop -- waiter process body for the "futex-cond" benchmark
+ *
+ * The comparison path: sleeps directly on a futex word instead of a
+ * condition variable, consuming wakeups claimed through the shared
+ * pending counter.
+ */
+static void
+futex_waiter_loop(struct mutex_bench *mb)
+{
+	struct cond_region *cr = mb->cr;
+
+	while (1) {
+		uint32_t val;
+		util_atomic_load_explicit32(&cr->futex_word, &val,
+					    memory_order_acquire);
+		if (cr->shutdown)
+			break;
+
+		uint64_t pending = cr->pending;
+		if (pending > 0 && util_bool_compare_and_swap64(
+					   &cr->pending, pending,
+					   pending - 1)) {
+			record_latency(cr, monotonic_ns() - cr->signal_ts);
+			util_fetch_and_add64(&cr->acks, 1);
+			continue;
+		}
+
+		sys_futex(&cr->futex_word, FUTEX_WAIT, val);
+	}
+}
+
+/*
+ * init_bench_cond_common -- allocate the shared region and fork the waiters
+ */
+static int
+init_bench_cond_common(struct mutex_bench *mb,
+		       void (*waiter_loop)(struct mutex_bench *))
+{
+	struct my_root *root = D_RW(mb->root);
+	assert(root != nullptr);
+
+	POBJ_ZALLOC(mb->pop, &root->locks, lock_t,
+		    sizeof(struct cond_region));
+	if (TOID_IS_NULL(root->locks)) {
+		perror("POBJ_ZALLOC");
+		return -1;
+	}
+
+	mb->cr = (struct cond_region *)D_RW(root->locks);
+	mb->ops_issued = 0;
+
+	mb->waiter_pids =
+		(pid_t *)malloc(mb->pa->n_waiters * sizeof(pid_t));
+	if (mb->waiter_pids == nullptr) {
+		perror("malloc");
+		POBJ_FREE(&root->locks);
+		return -1;
+	}
+
+	/*
+	 * The waiters are forked after the pool was created, so they all
+	 * operate on one shared mapping of the pool - the same situation
+	 * as multiple processes opening the pool.
+	 */
+	for (unsigned i = 0; i < mb->pa->n_waiters; i++) {
+		pid_t pid = fork();
+		if (pid < 0) {
+			perror("fork");
+			mb->cr->shutdown = 1;
+			while (i > 0)
+				waitpid(mb->waiter_pids[--i], nullptr, 0);
+			free(mb->waiter_pids);
+			POBJ_FREE(&root->locks);
+			return -1;
+		}
+		if (pid == 0) {
+			waiter_loop(mb);
+			_exit(0);
+		}
+		mb->waiter_pids[i] = pid;
+	}
+
+	return 0;
+}
+
+/*
+ * init_bench_cond -- initialize the PMEMcond wakeup benchmark
+ */
+static int
+init_bench_cond(struct mutex_bench *mb)
+{
+	return init_bench_cond_common(mb, cond_waiter_loop);
+}
+
+/*
+ * init_bench_fcond -- initialize the futex wakeup benchmark
+ */
+static int
+init_bench_fcond(struct mutex_bench *mb)
+{
+	return init_bench_cond_common(mb, futex_waiter_loop);
+}
+
+/*
+ * print_wakeup_histogram -- dump the collected wakeup latencies
+ *
+ * Written to stderr so it does not disturb the regular benchmark
+ * output parsing.
+ */
+static void
+print_wakeup_histogram(struct cond_region *cr)
+{
+	if (cr->lat_count == 0)
+		return;
+
+	fprintf(stderr,
+		"wakeup latency: count %" PRIu64 " avg %" PRIu64
+		" ns max %" PRIu64 " ns\n",
+		cr->lat_count, cr->lat_sum / cr->lat_count, cr->lat_max);
+	fprintf(stderr, "wakeup latency histogram (bucket_ns;count):\n");
+	for (unsigned i = 0; i < LAT_BUCKETS; i++) {
+		if (cr->hist[i] == 0)
+			continue;
+		fprintf(stderr, "%" PRIu64 ";%" PRIu64 "\n", UINT64_C(1) << i,
+			cr->hist[i]);
+	}
+}
+
+/*
+ * exit_bench_cond_common -- stop the waiters and report the histogram
+ */
+static int
+exit_bench_cond_common(struct mutex_bench *mb)
+{
+	struct cond_region *cr = mb->cr;
+
+	if (mb->lock_type == BENCH_MODE_COND) {
+		pmemobj_mutex_lock(mb->pop, &cr->lock);
+		cr->shutdown = 1;
+		pmemobj_cond_broadcast(mb->pop, &cr->cond);
+		pmemobj_mutex_unlock(mb->pop, &cr->lock);
+	} else {
+		cr->shutdown = 1;
+		util_fetch_and_add32(&cr->futex_word, 1);
+		sys_futex(&cr->futex_word, FUTEX_WAKE, UINT32_MAX);
+	}
+
+	for (unsigned i = 0; i < mb->pa->n_waiters; i++)
+		waitpid(mb->waiter_pids[i], nullptr, 0);
+
+	print_wakeup_histogram(cr);
+
+	free(mb->waiter_pids);
+	POBJ_FREE(&D_RW(mb->root)->locks);
+
+	return 0;
+}
+
+/*
+ * op_bench_cond -- issue one PMEMcond wakeup and wait for its consumption
+ */
+static int
+op_bench_cond(struct mutex_bench *mb)
+{
+	struct cond_region *cr = mb->cr;
+
+	pmemobj_mutex_lock(mb->pop, &cr->lock);
+	cr->signal_ts = monotonic_ns();
+	cr->pending++;
+	pmemobj_cond_signal(mb->pop, &cr->cond);
+	pmemobj_mutex_unlock(mb->pop, &cr->lock);
+
+	/*
+	 * Wait until a waiter consumed the wakeup, so each operation
+	 * measures one complete signal-to-wakeup round and signal_ts is
+	 * never overwritten while a wakeup is in flight.
+	 */
+	uint64_t target = ++mb->ops_issued;
+	uint64_t acks;
+	do {
+		util_atomic_load_explicit64(&cr->acks, &acks,
+					    memory_order_acquire);
+		if (acks < target)
+			sched_yield();
+	} while (acks < target);
+
+	return 0;
+}
+
+/*
+ * op_bench_fcond -- issue one futex wakeup and wait for its consumption
+ */
+static int
+op_bench_fcond(struct mutex_bench *mb)
+{
+	struct cond_region *cr = mb->cr;
+
+	cr->signal_ts = monotonic_ns();
+	util_fetch_and_add64(&cr->pending, 1);
+	util_fetch_and_add32(&cr->futex_word, 1);
+	sys_futex(&cr->futex_word, FUTEX_WAKE, 1);
+
+	uint64_t target = ++mb->ops_issued;
+	uint64_t acks;
+	do {
+		util_atomic_load_explicit64(&cr->acks, &acks,
+					    memory_order_acquire);
+		if (acks < target)
+			sched_yield();
+	} while (acks < target);
+
+	return 0;
+}
+
 struct bench_ops benchmark_ops[BENCH_MODE_MAX] = {
 	{init_bench_mutex, exit_bench_mutex, op_bench_mutex},
 	{init_bench_rwlock, exit_bench_rwlock, op_bench_rwlock},
-	{init_bench_vmutex, exit_bench_vmutex, op_bench_vmutex}};
+	{init_bench_vmutex, exit_bench_vmutex, op_bench_vmutex},
+	{init_bench_cond, exit_bench_cond_common, op_bench_cond},
+	{init_bench_fcond, exit_bench_cond_common, op_bench_fcond}};
 
 /*
  * operation_mode -- parses command line "--mode" and returns
@@ -631,6 +956,10 @@ parse_benchmark_mode(const char *arg)
 		return &benchmark_ops[BENCH_MODE_RWLOCK];
 	else if (strcmp(arg, "volatile-mutex") == 0)
 		return &benchmark_ops[BENCH_MODE_VOLATILE_MUTEX];
+	else if (strcmp(arg, "cond") == 0)
+		return &benchmark_ops[BENCH_MODE_COND];
+	else if (strcmp(arg, "futex-cond") == 0)
+		return &benchmark_ops[BENCH_MODE_FUTEX_COND];
 	else
 		return nullptr;
 }
@@ -678,6 +1007,8 @@ locks_init(struct benchmark *bench, struct benchmark_args *args)
 		goto err_free_mb;
 	}
 
+	mb->lock_type = (enum benchmark_mode)(mb->ops - benchmark_ops);
+
 	/* reserve some space for metadata */
 	poolsize = mb->pa->n_locks * sizeof(lock_t) + PMEMOBJ_MIN_POOL;
 
@@ -760,7 +1091,7 @@ locks_op(struct benchmark *bench, struct operation_info *info)
 }
 
 /* structure to define command line arguments */
-static struct benchmark_clo locks_clo[7];
+static struct benchmark_clo locks_clo[8];
 static struct benchmark_info locks_info;
 CONSTRUCTOR(pmem_locks_constructor)
 void
@@ -819,8 +1150,8 @@ pmem_locks_constructor(void)
 
 	locks_clo[5].opt_short = 'b';
 	locks_clo[5].opt_long = "bench_type";
-	locks_clo[5].descr = "The Benchmark type: mutex, "
-			     "rwlock or volatile-mutex";
+	locks_clo[5].descr = "The Benchmark type: mutex, rwlock, "
+			     "volatile-mutex, cond or futex-cond";
 	locks_clo[5].type = CLO_TYPE_STR;
 	locks_clo[5].off = clo_field_offset(struct prog_args, lock_type);
 	locks_clo[5].def = "mutex";
@@ -832,6 +1163,20 @@ pmem_locks_constructor(void)
 	locks_clo[6].type = CLO_TYPE_FLAG;
 	locks_clo[6].off = clo_field_offset(struct prog_args, use_rdlock);
 
+	locks_clo[7].opt_short = 'w';
+	locks_clo[7].opt_long = "waiters";
+	locks_clo[7].descr = "The number of waiter processes, only "
+			     "valid when bench_type is \"cond\" "
+			     "or \"futex-cond\"";
+	locks_clo[7].def = "1";
+	locks_clo[7].off = clo_field_offset(struct prog_args, n_waiters);
+	locks_clo[7].type = CLO_TYPE_UINT;
+	locks_clo[7].type_uint.size =
+		clo_field_size(struct prog_args, n_waiters);
+	locks_clo[7].type_uint.base = CLO_INT_BASE_DEC;
+	locks_clo[7].type_uint.min = 1;
+	locks_clo[7].type_uint.max = 1024;
+
 	locks_info.name = "obj_locks";
 	locks_info.brief = "Benchmark for pmem locks operations";
 	locks_info.init = locks_init;
@@ -42,6 +42,10 @@ struct prog_args {
 	size_t minsize;	      /* minimum size for random allocation size */
 	bool use_random_size; /* if set, use random size allocations */
 	unsigned seed;	      /* PRNG seed */
+	bool nt_headers;      /* write chunk headers with nt-stores */
+	size_t inject_rate;   /* slow-path injection rate (0 - disabled) */
+	size_t inject_size;   /* size of the injected allocation */
+	size_t occupancy;     /* target heap occupancy in percent */
 };
 
 POBJ_LAYOUT_BEGIN(pmalloc_layout);
@@ -65,6 +69,11 @@ struct obj_bench {
 	size_t *sizes;		   /* sizes for allocations */
 	TOID(struct my_root) root; /* root object's OID */
 	uint64_t *offs;		   /* pointer to the vector of offsets */
+
+	/* heap statistics snapshot taken before the pool is closed */
+	uint64_t stat_allocated;     /* stats.heap.curr_allocated */
+	uint64_t stat_run_allocated; /* stats.heap.run_allocated */
+	uint64_t stat_run_active;    /* stats.heap.run_active */
 };
 
 /*
@@ -149,6 +158,16 @@ obj_init(struct benchmark *bench, struct benchmark_args *args)
 		goto free_ob;
 	}
 
+	if (ob->pa->nt_headers) {
+		int enabled = 1;
+		if (pmemobj_ctl_set(ob->pop, "heap.nt_headers.enabled",
+				&enabled) != 0) {
+			fprintf(stderr, "pmemobj_ctl_set: %s\n",
+				pmemobj_errormsg());
+			goto free_pop;
+		}
+	}
+
 	ob->root = POBJ_ROOT(ob->pop, struct my_root);
 	if (TOID_IS_NULL(ob->root)) {
 		fprintf(stderr, "POBJ_ROOT: %s\n", pmemobj_errormsg());
@@ -213,6 +232,55 @@ obj_exit(struct benchmark *bench, struct benchmark_args *args)
 	return 0;
 }
 
+struct pmix_worker {
+	size_t nobjects;
+	size_t shuffle_start;
+	size_t inject_countdown; /* ops until the next injected slow path */
+	rng_t rng;
+};
+
+/*
+ * inject_slow_path -- force an allocator slow path
+ *
+ * A chunk-sized allocation freed right away bypasses the thread-local
+ * buckets and exercises the huge bucket, the chunk recycler and - when
+ * the heap has to grow - zone initialization. Mixing such operations
+ * into a regular workload at a controlled rate shows up in the latency
+ * percentiles, which makes tail-latency regressions in those paths
+ * visible when comparing against an uninjected run.
+ */
+static int
+inject_slow_path(struct obj_bench *ob)
+{
+	uint64_t off = 0;
+
+	int ret = pmalloc(ob->pop, &off, ob->pa->inject_size, 0, 0);
+	if (ret) {
+		fprintf(stderr, "injected pmalloc ret: %d\n", ret);
+		return ret;
+	}
+	pfree(ob->pop, &off);
+
+	return 0;
+}
+
+/*
+ * inject_due -- checks whether the next operation should be an injected
+ * slow path and winds up the countdown again if so
+ */
+static int
+inject_due(struct obj_bench *ob, struct pmix_worker *w)
+{
+	if (w->inject_countdown == 0) /* injection disabled */
+		return 0;
+
+	if (--w->inject_countdown != 0)
+		return 0;
+
+	w->inject_countdown = ob->pa->inject_rate;
+	return 1;
+}
+
 /*
  * pmalloc_init -- initialization for the pmalloc benchmark. Performs only the
  * common initialization.
@@ -230,6 +298,10 @@ static int
 pmalloc_op(struct benchmark *bench, struct operation_info *info)
 {
 	auto *ob = (struct obj_bench *)pmembench_get_priv(bench);
+	auto *w = (struct pmix_worker *)info->worker->priv;
+
+	if (inject_due(ob, w))
+		return inject_slow_path(ob);
 
 	uint64_t i = info->index +
 		info->worker->index * info->args->n_ops_per_thread;
@@ -243,12 +315,6 @@ pmalloc_op(struct benchmark *bench, struct operation_info *info)
 	return 0;
 }
 
-struct pmix_worker {
-	size_t nobjects;
-	size_t shuffle_start;
-	rng_t rng;
-};
-
 /*
  * pmix_worker_init -- initialization of the worker structure
  */
@@ -262,6 +328,7 @@ pmix_worker_init(struct benchmark *bench, struct benchmark_args *args,
 		return -1;
 
 	randomize_r(&w->rng, ob->pa->seed);
+	w->inject_countdown = ob->pa->inject_rate;
 
 	worker->priv = w;
 
@@ -311,6 +378,9 @@ pmix_op(struct benchmark *bench, struct operation_info *info)
 	auto *ob = (struct obj_bench *)pmembench_get_priv(bench);
 	auto *w = (struct pmix_worker *)info->worker->priv;
 
+	if (inject_due(ob, w))
+		return inject_slow_path(ob);
+
 	uint64_t idx = info->worker->index * info->args->n_ops_per_thread;
 
 	uint64_t *objects = &ob->offs[idx];
@@ -400,8 +470,188 @@ pfree_op(struct benchmark *bench, struct operation_info *info)
 	return 0;
 }
 
+/*
+ * psteady_init -- initialization for the psteady benchmark. Brings the heap
+ * up to the target occupancy before any operation is measured so that the
+ * measured phase runs against a fragmented steady state rather than a fresh
+ * heap.
+ */
+static int
+psteady_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	if (obj_init(bench, args))
+		return -1;
+
+	auto *ob = (struct obj_bench *)pmembench_get_priv(bench);
+
+	int enabled = POBJ_STATS_ENABLED_BOTH;
+	if (pmemobj_ctl_set(ob->pop, "stats.enabled", &enabled) != 0) {
+		fprintf(stderr, "pmemobj_ctl_set: %s\n", pmemobj_errormsg());
+		goto err;
+	}
+
+	{
+		size_t n_ops_total = args->n_ops_per_thread * args->n_threads;
+		for (size_t i = 0; i < n_ops_total; i++) {
+			if (i % 100 >= ob->pa->occupancy)
+				continue;
+			if (pmalloc(ob->pop, &ob->offs[i], ob->sizes[i],
+					0, 0)) {
+				fprintf(stderr, "prefill pmalloc: %s\n",
+					pmemobj_errormsg());
+				goto err;
+			}
+		}
+	}
+
+	return 0;
+
+err:
+	obj_exit(bench, args);
+	return -1;
+}
+
+/*
+ * psteady_worker_init -- initialization of the worker structure for the
+ * psteady benchmark. Counts the objects prefilled into the worker's slice
+ * of the offset vector.
+ */
+static int
+psteady_worker_init(struct benchmark *bench, struct benchmark_args *args,
+		    struct worker_info *worker)
+{
+	if (pmix_worker_init(bench, args, worker))
+		return -1;
+
+	auto *ob = (struct obj_bench *)pmembench_get_priv(bench);
+	auto *w = (struct pmix_worker *)worker->priv;
+
+	uint64_t *objects = &ob->offs[worker->index * args->n_ops_per_thread];
+	for (size_t i = 0; i < args->n_ops_per_thread; i++) {
+		if (objects[i] != 0)
+			w->nobjects++;
+	}
+
+	return 0;
+}
+
+/*
+ * psteady_op -- steady-state workload benchmark
+ *
+ * Holds the worker's slice of the offset vector at the target occupancy:
+ * below the target objects are allocated, above it they are freed, and at
+ * the target the operation picked depends on the state of a randomly
+ * chosen slot, which makes the workload alternate between frees and
+ * allocations of fresh (randomly sized) objects. Such replacement churn
+ * is what fragments a long-running heap.
+ */
+static int
+psteady_op(struct benchmark *bench, struct operation_info *info)
+{
+	auto *ob = (struct obj_bench *)pmembench_get_priv(bench);
+	auto *w = (struct pmix_worker *)info->worker->priv;
+
+	if (inject_due(ob, w))
+		return inject_slow_path(ob);
+
+	uint64_t idx = info->worker->index * info->args->n_ops_per_thread;
+	uint64_t *objects = &ob->offs[idx];
+	size_t nslots = info->args->n_ops_per_thread;
+	size_t target = (nslots * ob->pa->occupancy) / 100;
+	size_t s = RRAND_R(&w->rng, nslots - 1, 0);
+
+	int do_alloc;
+	if (w->nobjects < target)
+		do_alloc = 1;
+	else if (w->nobjects > target)
+		do_alloc = 0;
+	else
+		do_alloc = (objects[s] == 0);
+
+	/* never scan for a slot which does not exist */
+	if (w->nobjects == 0)
+		do_alloc = 1;
+	else if (w->nobjects == nslots)
+		do_alloc = 0;
+
+	if (do_alloc) {
+		while (objects[s] != 0)
+			s = (s + 1) % nslots;
+
+		int ret = pmalloc(ob->pop, &objects[s],
+				  ob->sizes[idx + info->index], 0, 0);
+		if (ret) {
+			fprintf(stderr, "pmalloc ret: %d\n", ret);
+			return ret;
+		}
+		w->nobjects++;
+	} else {
+		while (objects[s] == 0)
+			s = (s + 1) % nslots;
+
+		pfree(ob->pop, &objects[s]);
+		w->nobjects--;
+	}
+
+	return 0;
+}
+
+/*
+ * psteady_exit -- snapshots the heap statistics, which have to outlive the
+ * pool to be printed along the results, and performs the common cleanup
+ */
+static int
+psteady_exit(struct benchmark *bench, struct benchmark_args *args)
+{
+	auto *ob = (struct obj_bench *)pmembench_get_priv(bench);
+
+	(void) pmemobj_ctl_get(ob->pop, "stats.heap.curr_allocated",
+			       &ob->stat_allocated);
+	(void) pmemobj_ctl_get(ob->pop, "stats.heap.run_allocated",
+			       &ob->stat_run_allocated);
+	(void) pmemobj_ctl_get(ob->pop, "stats.heap.run_active",
+			       &ob->stat_run_active);
+
+	return pmalloc_exit(bench, args);
+}
+
+/*
+ * psteady_print_extra_headers -- prints the headers of the heap statistics
+ * columns
+ */
+static void
+psteady_print_extra_headers(void)
+{
+	printf(";heap-allocated[bytes];run-allocated[bytes]"
+	       ";run-active[bytes];run-utilization");
+}
+
+/*
+ * psteady_print_extra_values -- prints the heap statistics alongside the
+ * results
+ *
+ * run-utilization is the fraction of the memory reserved for runs which
+ * actually holds objects - the lower it is, the more fragmented the heap.
+ */
+static void
+psteady_print_extra_values(struct benchmark *bench,
+			   struct benchmark_args *args,
+			   struct total_results *res)
+{
+	auto *ob = (struct obj_bench *)pmembench_get_priv(bench);
+
+	double util = ob->stat_run_active == 0
+		? 1.0
+		: (double)ob->stat_run_allocated /
+			(double)ob->stat_run_active;
+
+	printf(";%" PRIu64 ";%" PRIu64 ";%" PRIu64 ";%f", ob->stat_allocated,
+	       ob->stat_run_allocated, ob->stat_run_active, util);
+}
+
 /* command line options definition */
-static struct benchmark_clo pmalloc_clo[3];
+static struct benchmark_clo pmalloc_clo[6];
+static struct benchmark_clo psteady_clo[7];
 /*
  * Stores information about pmalloc benchmark.
  */
@@ -414,6 +664,10 @@ static struct benchmark_info pfree_info;
  * Stores information about pmix benchmark.
  */
 static struct benchmark_info pmix_info;
+/*
+ * Stores information about psteady benchmark.
+ */
+static struct benchmark_info psteady_info;
 
 CONSTRUCTOR(obj_pmalloc_constructor)
 void
@@ -451,6 +705,38 @@ obj_pmalloc_constructor(void)
 	pmalloc_clo[2].type_uint.min = 1;
 	pmalloc_clo[2].type_uint.max = UINT_MAX;
 
+	pmalloc_clo[3].opt_short = 0;
+	pmalloc_clo[3].opt_long = "nt-headers";
+	pmalloc_clo[3].descr = "Write chunk headers with non-temporal "
+			       "stores (heap.nt_headers.enabled)";
+	pmalloc_clo[3].off = clo_field_offset(struct prog_args, nt_headers);
+	pmalloc_clo[3].type = CLO_TYPE_FLAG;
+
+	pmalloc_clo[4].opt_short = 0;
+	pmalloc_clo[4].opt_long = "inject-rate";
+	pmalloc_clo[4].descr = "Replace every Nth operation with an "
+			       "allocator slow path (0 - disabled)";
+	pmalloc_clo[4].type = CLO_TYPE_UINT;
+	pmalloc_clo[4].off = clo_field_offset(struct prog_args, inject_rate);
+	pmalloc_clo[4].def = "0";
+	pmalloc_clo[4].type_uint.size =
+		clo_field_size(struct prog_args, inject_rate);
+	pmalloc_clo[4].type_uint.base = CLO_INT_BASE_DEC;
+	pmalloc_clo[4].type_uint.min = 0;
+	pmalloc_clo[4].type_uint.max = UINT64_MAX;
+
+	pmalloc_clo[5].opt_short = 0;
+	pmalloc_clo[5].opt_long = "inject-size";
+	pmalloc_clo[5].descr = "Size of the injected slow-path allocation";
+	pmalloc_clo[5].type = CLO_TYPE_UINT;
+	pmalloc_clo[5].off = clo_field_offset(struct prog_args, inject_size);
+	pmalloc_clo[5].def = "2097152";
+	pmalloc_clo[5].type_uint.size =
+		clo_field_size(struct prog_args, inject_size);
+	pmalloc_clo[5].type_uint.base = CLO_INT_BASE_DEC;
+	pmalloc_clo[5].type_uint.min = ALLOC_MIN_SIZE;
+	pmalloc_clo[5].type_uint.max = UINT64_MAX;
+
 	pmalloc_info.name = "pmalloc",
 	pmalloc_info.brief = "Benchmark for internal pmalloc() "
 			     "operation";
@@ -459,6 +745,8 @@ obj_pmalloc_constructor(void)
 	pmalloc_info.multithread = true;
 	pmalloc_info.multiops = true;
 	pmalloc_info.operation = pmalloc_op;
+	pmalloc_info.init_worker = pmix_worker_init;
+	pmalloc_info.free_worker = pmix_worker_fini;
 	pmalloc_info.measure_time = true;
 	pmalloc_info.clos = pmalloc_clo;
 	pmalloc_info.nclos = ARRAY_SIZE(pmalloc_clo);
@@ -501,4 +789,40 @@ obj_pmalloc_constructor(void)
 	pmix_info.rm_file = true;
 	pmix_info.allow_poolset = true;
 	REGISTER_BENCHMARK(pmix_info);
+
+	/* psteady accepts all of the pmalloc options plus the occupancy */
+	memcpy(psteady_clo, pmalloc_clo, sizeof(pmalloc_clo));
+
+	psteady_clo[6].opt_short = 0;
+	psteady_clo[6].opt_long = "occupancy";
+	psteady_clo[6].descr = "Percentage of objects held allocated "
+			       "during the steady state";
+	psteady_clo[6].type = CLO_TYPE_UINT;
+	psteady_clo[6].off = clo_field_offset(struct prog_args, occupancy);
+	psteady_clo[6].def = "50";
+	psteady_clo[6].type_uint.size =
+		clo_field_size(struct prog_args, occupancy);
+	psteady_clo[6].type_uint.base = CLO_INT_BASE_DEC;
+	psteady_clo[6].type_uint.min = 1;
+	psteady_clo[6].type_uint.max = 100;
+
+	psteady_info.name = "psteady";
+	psteady_info.brief = "Benchmark for a mixed alloc/free workload "
+			     "at a steady-state occupancy";
+	psteady_info.init = psteady_init;
+	psteady_info.exit = psteady_exit;
+	psteady_info.multithread = true;
+	psteady_info.multiops = true;
+	psteady_info.operation = psteady_op;
+	psteady_info.init_worker = psteady_worker_init;
+	psteady_info.free_worker = pmix_worker_fini;
+	psteady_info.measure_time = true;
+	psteady_info.clos = psteady_clo;
+	psteady_info.nclos = ARRAY_SIZE(psteady_clo);
+	psteady_info.opts_size = sizeof(struct prog_args);
+	psteady_info.rm_file = true;
+	psteady_info.allow_poolset = true;
+	psteady_info.print_extra_headers = psteady_print_extra_headers;
+	psteady_info.print_extra_values = psteady_print_extra_values;
+	REGISTER_BENCHMARK(psteady_info);
 };
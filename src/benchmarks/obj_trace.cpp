@@ -0,0 +1,454 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2024, Intel Corporation */
+
+/*
+ * obj_trace.cpp -- allocation trace replay benchmark definition
+ *
+ * Replays a binary allocation trace recorded by the heap.trace ctl namespace
+ * (see struct palloc_trace_entry). The trace is partitioned between worker
+ * threads by the recorded thread field and each worker replays its share of
+ * operations in the recorded order, optionally reproducing the recorded
+ * inter-operation delays at a configurable speed-up.
+ */
+
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "benchmark.hpp"
+#include "file.h"
+#include "libpmemobj.h"
+#include "os.h"
+#include "pmalloc.h"
+#include "poolset_util.hpp"
+
+/*
+ * The factor used for PMEM pool size calculation, accounts for metadata,
+ * fragmentation and etc.
+ */
+#define FACTOR 1.9f
+
+/* OOB and allocation header size */
+#define OOB_HEADER_SIZE 64
+
+/*
+ * trace_args - command line parsed arguments
+ */
+struct trace_args {
+	char *file;	  /* path to the binary trace file */
+	unsigned speedup; /* divisor applied to the recorded delays */
+	bool no_delays;	  /* if set, ignore the recorded delays */
+};
+
+POBJ_LAYOUT_BEGIN(trace_layout);
+POBJ_LAYOUT_ROOT(trace_layout, struct trace_root);
+POBJ_LAYOUT_TOID(trace_layout, uint64_t);
+POBJ_LAYOUT_END(trace_layout);
+
+/*
+ * trace_root - root object with the vector of allocated object offsets
+ */
+struct trace_root {
+	TOID(uint64_t) offs;
+};
+
+/*
+ * trace_worker - per-worker replay state
+ *
+ * Each worker owns a contiguous range of offset slots in the persistent
+ * offset vector. Allocations take a slot from the free stack and push it on
+ * the live stack, frees do the reverse, so slots are recycled when the
+ * replay cycles over the trace more than once.
+ */
+struct trace_worker {
+	size_t *entries; /* indices of trace entries replayed by this worker */
+	size_t nentries;
+	uint64_t *slots; /* base of this worker's persistent offset slots */
+	size_t *live;	 /* stack of slots holding live allocations */
+	size_t nlive;
+	size_t *avail;	 /* stack of free slots */
+	size_t navail;
+};
+
+/*
+ * obj_trace_bench - benchmark context
+ */
+struct obj_trace_bench {
+	PMEMobjpool *pop;		    /* persistent pool handle */
+	struct trace_args *ta;		    /* parsed arguments */
+	struct palloc_trace_entry *trace;   /* loaded trace entries */
+	size_t ntrace;			    /* number of trace entries */
+	TOID(struct trace_root) root;	    /* root object's OID */
+	uint64_t *offs;			    /* persistent offset vector */
+	struct trace_worker *workers;	    /* per-worker replay state */
+};
+
+/*
+ * trace_load -- (internal) reads the whole binary trace file into memory
+ */
+static int
+trace_load(struct obj_trace_bench *tb, const char *path)
+{
+	ssize_t size = util_file_get_size(path);
+	if (size < 0 || (size_t)size % sizeof(struct palloc_trace_entry)) {
+		fprintf(stderr, "invalid trace file %s\n", path);
+		return -1;
+	}
+
+	tb->ntrace = (size_t)size / sizeof(struct palloc_trace_entry);
+	if (tb->ntrace == 0) {
+		fprintf(stderr, "empty trace file %s\n", path);
+		return -1;
+	}
+
+	tb->trace = (struct palloc_trace_entry *)malloc((size_t)size);
+	if (tb->trace == nullptr) {
+		perror("malloc");
+		return -1;
+	}
+
+	FILE *f = os_fopen(path, "rb");
+	if (f == nullptr) {
+		perror(path);
+		free(tb->trace);
+		return -1;
+	}
+
+	if (fread(tb->trace, sizeof(struct palloc_trace_entry), tb->ntrace,
+		  f) != tb->ntrace) {
+		perror(path);
+		fclose(f);
+		free(tb->trace);
+		return -1;
+	}
+
+	fclose(f);
+
+	return 0;
+}
+
+/*
+ * trace_partition -- (internal) splits the trace entries between workers by
+ *	the recorded thread field
+ */
+static int
+trace_partition(struct obj_trace_bench *tb, unsigned n_threads)
+{
+	tb->workers = (struct trace_worker *)calloc(n_threads,
+						    sizeof(*tb->workers));
+	if (tb->workers == nullptr) {
+		perror("calloc");
+		return -1;
+	}
+
+	for (size_t i = 0; i < tb->ntrace; i++)
+		tb->workers[tb->trace[i].thread % n_threads].nentries++;
+
+	size_t slot_off = 0;
+	for (unsigned w = 0; w < n_threads; w++) {
+		struct trace_worker *tw = &tb->workers[w];
+		size_t n = tw->nentries ? tw->nentries : 1;
+
+		tw->entries = (size_t *)malloc(n * sizeof(*tw->entries));
+		tw->live = (size_t *)malloc(n * sizeof(*tw->live));
+		tw->avail = (size_t *)malloc(n * sizeof(*tw->avail));
+		if (tw->entries == nullptr || tw->live == nullptr ||
+		    tw->avail == nullptr) {
+			perror("malloc");
+			return -1;
+		}
+
+		/* initially all of the worker's slots are free */
+		for (size_t s = 0; s < n; s++)
+			tw->avail[s] = n - 1 - s;
+		tw->navail = n;
+		tw->nlive = 0;
+
+		tw->slots = tb->offs + slot_off;
+		slot_off += n;
+		tw->nentries = 0;
+	}
+
+	for (size_t i = 0; i < tb->ntrace; i++) {
+		struct trace_worker *tw =
+			&tb->workers[tb->trace[i].thread % n_threads];
+		tw->entries[tw->nentries++] = i;
+	}
+
+	return 0;
+}
+
+/*
+ * obj_trace_init -- benchmark initialization - creates the pool and loads
+ *	the trace
+ */
+static int
+obj_trace_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	struct trace_root *root = nullptr;
+	assert(bench != nullptr);
+	assert(args != nullptr);
+	assert(args->opts != nullptr);
+
+	char path[PATH_MAX];
+	if (util_safe_strcpy(path, args->fname, sizeof(path)) != 0)
+		return -1;
+
+	enum file_type type = util_file_get_type(args->fname);
+	if (type == OTHER_ERROR) {
+		fprintf(stderr, "could not check type of file %s\n",
+			args->fname);
+		return -1;
+	}
+
+	auto *tb = (struct obj_trace_bench *)calloc(1,
+		sizeof(struct obj_trace_bench));
+	if (tb == nullptr) {
+		perror("calloc");
+		return -1;
+	}
+	pmembench_set_priv(bench, tb);
+
+	tb->ta = (struct trace_args *)args->opts;
+	if (tb->ta->speedup == 0)
+		tb->ta->speedup = 1;
+
+	if (trace_load(tb, tb->ta->file))
+		goto free_tb;
+
+	{
+		/* size the pool for the sum of all recorded allocations */
+		size_t alloc_bytes = 0;
+		for (size_t i = 0; i < tb->ntrace; i++)
+			if (tb->trace[i].op != PALLOC_TRACE_FREE)
+				alloc_bytes += tb->trace[i].size +
+					OOB_HEADER_SIZE;
+
+		size_t poolsize = PMEMOBJ_MIN_POOL + alloc_bytes +
+			tb->ntrace * sizeof(uint64_t);
+		poolsize = (size_t)(poolsize * FACTOR);
+
+		if (args->is_poolset || type == TYPE_DEVDAX) {
+			if (args->fsize < poolsize) {
+				fprintf(stderr, "file size too large\n");
+				goto free_trace;
+			}
+			poolsize = 0;
+		} else if (poolsize < PMEMOBJ_MIN_POOL) {
+			poolsize = PMEMOBJ_MIN_POOL;
+		}
+
+		if (args->is_dynamic_poolset) {
+			int ret = dynamic_poolset_create(args->fname,
+							 poolsize);
+			if (ret == -1)
+				goto free_trace;
+
+			if (util_safe_strcpy(path, POOLSET_PATH,
+					     sizeof(path)) != 0)
+				goto free_trace;
+
+			poolsize = 0;
+		}
+
+		tb->pop = pmemobj_create(path, POBJ_LAYOUT_NAME(trace_layout),
+					 poolsize, args->fmode);
+		if (tb->pop == nullptr) {
+			fprintf(stderr, "%s\n", pmemobj_errormsg());
+			goto free_trace;
+		}
+	}
+
+	tb->root = POBJ_ROOT(tb->pop, struct trace_root);
+	if (TOID_IS_NULL(tb->root)) {
+		fprintf(stderr, "POBJ_ROOT: %s\n", pmemobj_errormsg());
+		goto free_pop;
+	}
+
+	root = D_RW(tb->root);
+	assert(root != nullptr);
+	POBJ_ZALLOC(tb->pop, &root->offs, uint64_t,
+		    tb->ntrace * sizeof(uint64_t));
+	if (TOID_IS_NULL(root->offs)) {
+		fprintf(stderr, "POBJ_ZALLOC off_vect: %s\n",
+			pmemobj_errormsg());
+		goto free_pop;
+	}
+
+	tb->offs = D_RW(root->offs);
+
+	if (trace_partition(tb, args->n_threads))
+		goto free_pop;
+
+	return 0;
+
+free_pop:
+	pmemobj_close(tb->pop);
+
+free_trace:
+	free(tb->trace);
+
+free_tb:
+	free(tb);
+	return -1;
+}
+
+/*
+ * obj_trace_exit -- benchmark clean-up
+ */
+static int
+obj_trace_exit(struct benchmark *bench, struct benchmark_args *args)
+{
+	auto *tb = (struct obj_trace_bench *)pmembench_get_priv(bench);
+
+	if (tb->workers != nullptr) {
+		for (unsigned w = 0; w < args->n_threads; w++) {
+			free(tb->workers[w].entries);
+			free(tb->workers[w].live);
+			free(tb->workers[w].avail);
+		}
+		free(tb->workers);
+	}
+
+	POBJ_FREE(&D_RW(tb->root)->offs);
+	pmemobj_close(tb->pop);
+	free(tb->trace);
+	free(tb);
+
+	return 0;
+}
+
+/*
+ * trace_delay -- (internal) busy-waits for the recorded delay scaled down
+ *	by the speed-up factor
+ */
+static void
+trace_delay(const struct obj_trace_bench *tb,
+	    const struct palloc_trace_entry *e)
+{
+	if (tb->ta->no_delays)
+		return;
+
+	unsigned long long nsecs = e->delay / tb->ta->speedup;
+	if (nsecs == 0)
+		return;
+
+	benchmark_time_t start;
+	benchmark_time_get(&start);
+
+	benchmark_time_t now;
+	benchmark_time_t diff;
+	do {
+		benchmark_time_get(&now);
+		benchmark_time_diff(&diff, &start, &now);
+	} while (benchmark_time_get_nsecs(&diff) < nsecs);
+}
+
+/*
+ * obj_trace_op -- replays a single trace entry
+ */
+static int
+obj_trace_op(struct benchmark *bench, struct operation_info *info)
+{
+	auto *tb = (struct obj_trace_bench *)pmembench_get_priv(bench);
+	struct trace_worker *tw = &tb->workers[info->worker->index];
+
+	if (tw->nentries == 0) /* more workers than recorded threads */
+		return 0;
+
+	const struct palloc_trace_entry *e =
+		&tb->trace[tw->entries[info->index % tw->nentries]];
+
+	trace_delay(tb, e);
+
+	size_t slot;
+	int ret;
+
+	switch (e->op) {
+		case PALLOC_TRACE_ALLOC:
+			if (tw->navail == 0) /* all slots hold live objects */
+				return 0;
+			slot = tw->avail[--tw->navail];
+			ret = pmalloc(tb->pop, &tw->slots[slot], e->size, 0,
+				      e->class_id);
+			if (ret) {
+				perror("pmalloc");
+				return ret;
+			}
+			tw->live[tw->nlive++] = slot;
+			break;
+		case PALLOC_TRACE_FREE:
+			if (tw->nlive == 0) /* nothing left to free */
+				return 0;
+			slot = tw->live[--tw->nlive];
+			pfree(tb->pop, &tw->slots[slot]);
+			tw->avail[tw->navail++] = slot;
+			break;
+		case PALLOC_TRACE_REALLOC:
+			if (tw->nlive == 0)
+				return 0;
+			slot = tw->live[tw->nlive - 1];
+			ret = prealloc(tb->pop, &tw->slots[slot], e->size, 0,
+				       e->class_id);
+			if (ret) {
+				perror("prealloc");
+				return ret;
+			}
+			break;
+		default:
+			fprintf(stderr, "corrupted trace entry\n");
+			return -1;
+	}
+
+	return 0;
+}
+
+static struct benchmark_clo trace_clo[3];
+static struct benchmark_info trace_info;
+CONSTRUCTOR(obj_trace_constructor)
+void
+obj_trace_constructor(void)
+{
+	trace_clo[0].opt_short = 'T';
+	trace_clo[0].opt_long = "trace-file";
+	trace_clo[0].descr = "Binary allocation trace to replay";
+	trace_clo[0].off = clo_field_offset(struct trace_args, file);
+	trace_clo[0].type = CLO_TYPE_STR;
+	trace_clo[0].def = "trace.bin";
+
+	trace_clo[1].opt_short = 'S';
+	trace_clo[1].opt_long = "speedup";
+	trace_clo[1].descr = "Divisor applied to the recorded delays";
+	trace_clo[1].off = clo_field_offset(struct trace_args, speedup);
+	trace_clo[1].type = CLO_TYPE_UINT;
+	trace_clo[1].def = "1";
+	trace_clo[1].type_uint.size =
+		clo_field_size(struct trace_args, speedup);
+	trace_clo[1].type_uint.base = CLO_INT_BASE_DEC;
+	trace_clo[1].type_uint.min = 1;
+	trace_clo[1].type_uint.max = UINT_MAX;
+
+	trace_clo[2].opt_short = 'D';
+	trace_clo[2].opt_long = "no-delays";
+	trace_clo[2].descr = "Ignore the recorded delays";
+	trace_clo[2].off = clo_field_offset(struct trace_args, no_delays);
+	trace_clo[2].type = CLO_TYPE_FLAG;
+	trace_clo[2].def = "false";
+
+	trace_info.name = "obj_trace";
+	trace_info.brief = "Benchmark replaying recorded allocation traces";
+	trace_info.init = obj_trace_init;
+	trace_info.exit = obj_trace_exit;
+	trace_info.multithread = true;
+	trace_info.multiops = true;
+	trace_info.operation = obj_trace_op;
+	trace_info.measure_time = true;
+	trace_info.clos = trace_clo;
+	trace_info.nclos = ARRAY_SIZE(trace_clo);
+	trace_info.opts_size = sizeof(struct trace_args);
+	trace_info.rm_file = true;
+	trace_info.allow_poolset = true;
+	REGISTER_BENCHMARK(trace_info);
+};
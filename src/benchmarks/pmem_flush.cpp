@@ -55,6 +55,7 @@ roundup_len(size_t len, void *addr, uintptr_t align)
 struct pmem_args {
 	char *operation; /* msync, dummy_msync, persist, ... */
 	char *mode;	 /* stat, seq, rand */
+	char *store;	 /* rmw, temporal, nt */
 	bool no_warmup;	 /* don't do warmup */
 };
 
@@ -80,6 +81,9 @@ struct pmem_bench {
 
 	/* the actual benchmark operation */
 	int (*func_op)(struct pmem_bench *pmb, void *addr, size_t len);
+
+	/* the store performed before each flush operation */
+	void (*func_store)(void *addr, size_t len);
 };
 
 /*
@@ -143,6 +147,68 @@ parse_op_mode(const char *arg)
 	return -1;
 }
 
+/*
+ * store_rmw -- dirty the first word of the chunk with a regular store
+ */
+static void
+store_rmw(void *addr, size_t len)
+{
+	*(int *)addr = *(int *)addr + 1;
+}
+
+/*
+ * store_temporal -- fill the whole chunk with cached (temporal) stores
+ */
+static void
+store_temporal(void *addr, size_t len)
+{
+	pmem_memset(addr, 0x5a, len, PMEM_F_MEM_TEMPORAL | PMEM_F_MEM_NOFLUSH);
+}
+
+/*
+ * store_nt -- fill the whole chunk with non-temporal stores
+ */
+static void
+store_nt(void *addr, size_t len)
+{
+	pmem_memset(addr, 0x5a, len,
+		    PMEM_F_MEM_NONTEMPORAL | PMEM_F_MEM_NOFLUSH);
+}
+
+/*
+ * store_type -- the store performed before each flush operation
+ *
+ *	* rmw      - a single 4-byte read-modify-write,
+ *	* temporal - memset of the whole chunk through the CPU cache,
+ *	* nt       - memset of the whole chunk bypassing the CPU cache.
+ */
+struct store_type {
+	const char *store;
+	void (*func_store)(void *addr, size_t len);
+};
+
+static struct store_type stores[] = {
+	{"rmw", store_rmw},
+	{"temporal", store_temporal},
+	{"nt", store_nt},
+};
+
+#define NSTORES (sizeof(stores) / sizeof(stores[0]))
+
+/*
+ * parse_store_type -- parses command line "--store"
+ * and returns proper store type index.
+ */
+static int
+parse_store_type(const char *arg)
+{
+	for (unsigned i = 0; i < NSTORES; i++) {
+		if (strcmp(arg, stores[i].store) == 0)
+			return i;
+	}
+	return -1;
+}
+
 /*
  * flush_noop -- dummy flush, does nothing
  */
@@ -188,6 +254,26 @@ flush_persist_2M(struct pmem_bench *pmb, void *addr, size_t len)
 	return 0;
 }
 
+/*
+ * flush_flush -- flush CPU cache using pmem_flush(), without a drain
+ */
+static int
+flush_flush(struct pmem_bench *pmb, void *addr, size_t len)
+{
+	pmem_flush(addr, len);
+	return 0;
+}
+
+/*
+ * flush_drain -- order prior flushes using pmem_drain() alone
+ */
+static int
+flush_drain(struct pmem_bench *pmb, void *addr, size_t len)
+{
+	pmem_drain();
+	return 0;
+}
+
 /*
  * flush_msync -- flush data to persistence using pmem_msync()
  */
@@ -308,6 +394,8 @@ struct op {
 
 static struct op ops[] = {
 	{"noop", flush_noop},
+	{"flush", flush_flush},
+	{"drain", flush_drain},
 	{"persist", flush_persist},
 	{"persist_4K", flush_persist_4K},
 	{"persist_2M", flush_persist_2M},
@@ -372,6 +460,13 @@ pmem_flush_init(struct benchmark *bench, struct benchmark_args *args)
 	}
 	pmb->func_op = ops[i].func_op;
 
+	i = parse_store_type(pmb->pargs->store);
+	if (i == -1) {
+		fprintf(stderr, "wrong store type: %s\n", pmb->pargs->store);
+		goto err_free_pmb;
+	}
+	pmb->func_store = stores[i].func_store;
+
 	pmb->n_offsets = args->n_ops_per_thread * args->n_threads;
 
 	pmb->fsize = pmb->n_offsets * args->dsize + (2 * PAGE_2M);
@@ -488,13 +583,13 @@ pmem_flush_operation(struct benchmark *bench, struct operation_info *info)
 		(char *)pmb->pmem_addr_aligned + chunk_idx * info->args->dsize;
 
 	/* store + flush */
-	*(int *)addr = *(int *)addr + 1;
+	pmb->func_store(addr, info->args->dsize);
 	pmb->func_op(pmb, addr, info->args->dsize);
 	return 0;
 }
 
 /* structure to define command line arguments */
-static struct benchmark_clo pmem_flush_clo[3];
+static struct benchmark_clo pmem_flush_clo[4];
 /* Stores information about benchmark. */
 static struct benchmark_info pmem_flush_bench;
 CONSTRUCTOR(pmem_flush_constructor)
@@ -516,11 +611,18 @@ pmem_flush_constructor(void)
 	pmem_flush_clo[1].off = clo_field_offset(struct pmem_args, mode);
 	pmem_flush_clo[1].def = "stat";
 
-	pmem_flush_clo[2].opt_short = 'w';
-	pmem_flush_clo[2].opt_long = "no-warmup";
-	pmem_flush_clo[2].descr = "Don't do warmup";
-	pmem_flush_clo[2].type = CLO_TYPE_FLAG;
-	pmem_flush_clo[2].off = clo_field_offset(struct pmem_args, no_warmup);
+	pmem_flush_clo[2].opt_short = 0;
+	pmem_flush_clo[2].opt_long = "store";
+	pmem_flush_clo[2].descr = "store type - rmw, temporal or nt";
+	pmem_flush_clo[2].type = CLO_TYPE_STR;
+	pmem_flush_clo[2].off = clo_field_offset(struct pmem_args, store);
+	pmem_flush_clo[2].def = "rmw";
+
+	pmem_flush_clo[3].opt_short = 'w';
+	pmem_flush_clo[3].opt_long = "no-warmup";
+	pmem_flush_clo[3].descr = "Don't do warmup";
+	pmem_flush_clo[3].type = CLO_TYPE_FLAG;
+	pmem_flush_clo[3].off = clo_field_offset(struct pmem_args, no_warmup);
 
 	pmem_flush_bench.name = "pmem_flush";
 	pmem_flush_bench.brief = "Benchmark for pmem_msync() "
@@ -14,9 +14,16 @@
 #include <cstring>
 #include <dirent.h>
 #include <err.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <linux/limits.h>
+#include <linux/perf_event.h>
+#include <pthread.h>
 #include <sched.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -89,7 +96,7 @@ static struct version_s {
 static struct bench_list benchmarks;
 
 /* common arguments for benchmarks */
-static struct benchmark_clo pmembench_clos[13];
+static struct benchmark_clo pmembench_clos[20];
 
 /* list of arguments for pmembench */
 static struct benchmark_clo pmembench_opts[2];
@@ -260,6 +267,83 @@ pmembench_constructor(void)
 	pmembench_clos[12].off =
 		clo_field_offset(struct benchmark_args, is_dynamic_poolset);
 	pmembench_clos[12].ignore_in_res = true;
+
+	pmembench_clos[13].opt_long = "processes";
+	pmembench_clos[13].type = CLO_TYPE_UINT;
+	pmembench_clos[13].descr = "Number of worker processes";
+	pmembench_clos[13].off =
+		clo_field_offset(struct benchmark_args, n_processes);
+	pmembench_clos[13].def = "1";
+	pmembench_clos[13].type_uint.size =
+		clo_field_size(struct benchmark_args, n_processes);
+	pmembench_clos[13].type_uint.base = CLO_INT_BASE_DEC;
+	pmembench_clos[13].type_uint.min = 1;
+	pmembench_clos[13].type_uint.max = 1024;
+
+	pmembench_clos[14].opt_long = "latency-json";
+	pmembench_clos[14].type = CLO_TYPE_STR;
+	pmembench_clos[14].descr =
+		"Append latency histograms in JSON to a file";
+	pmembench_clos[14].off =
+		clo_field_offset(struct benchmark_args, latency_json);
+	pmembench_clos[14].def = "";
+	pmembench_clos[14].ignore_in_res = true;
+
+	pmembench_clos[15].opt_long = "perf-stats";
+	pmembench_clos[15].type = CLO_TYPE_FLAG;
+	pmembench_clos[15].descr =
+		"Sample hardware counters during the measured phase";
+	pmembench_clos[15].off =
+		clo_field_offset(struct benchmark_args, perf_stats);
+	pmembench_clos[15].def = "false";
+	pmembench_clos[15].ignore_in_res = true;
+
+	pmembench_clos[16].opt_long = "numa-interleave";
+	pmembench_clos[16].type = CLO_TYPE_FLAG;
+	pmembench_clos[16].descr =
+		"Pin worker threads round-robin to the cpusets of all NUMA "
+		"nodes";
+	pmembench_clos[16].off =
+		clo_field_offset(struct benchmark_args, numa_interleave);
+	pmembench_clos[16].def = "false";
+
+	pmembench_clos[17].opt_long = "numa-placement";
+	pmembench_clos[17].type = CLO_TYPE_STR;
+	pmembench_clos[17].descr =
+		"Pin worker threads to the NUMA node backing the pool "
+		"(local) or to the next one (remote)";
+	pmembench_clos[17].off =
+		clo_field_offset(struct benchmark_args, numa_placement);
+	pmembench_clos[17].def = "";
+
+	pmembench_clos[18].opt_long = "warmup";
+	pmembench_clos[18].type = CLO_TYPE_UINT;
+	pmembench_clos[18].descr =
+		"Number of initial operations per thread excluded from "
+		"statistics";
+	pmembench_clos[18].off =
+		clo_field_offset(struct benchmark_args, warmup);
+	pmembench_clos[18].def = "0";
+	pmembench_clos[18].type_uint.size =
+		clo_field_size(struct benchmark_args, warmup);
+	pmembench_clos[18].type_uint.base = CLO_INT_BASE_DEC;
+	pmembench_clos[18].type_uint.min = 0;
+	pmembench_clos[18].type_uint.max = ULLONG_MAX;
+
+	pmembench_clos[19].opt_long = "steady-state";
+	pmembench_clos[19].type = CLO_TYPE_UINT;
+	pmembench_clos[19].descr =
+		"Detect the warm-up automatically: exclude operations "
+		"executed before the rolling throughput stabilizes below "
+		"the given coefficient of variation (in percent)";
+	pmembench_clos[19].off =
+		clo_field_offset(struct benchmark_args, steady_state);
+	pmembench_clos[19].def = "0";
+	pmembench_clos[19].type_uint.size =
+		clo_field_size(struct benchmark_args, steady_state);
+	pmembench_clos[19].type_uint.base = CLO_INT_BASE_DEC;
+	pmembench_clos[19].type_uint.min = 0;
+	pmembench_clos[19].type_uint.max = 100;
 }
 
 /*
@@ -413,6 +497,10 @@ pmembench_print_header(struct pmembench *pb, struct benchmark *bench,
 	if (bench->info->print_bandwidth)
 		printf(";bandwidth[MiB/s]");
 
+	auto *args0 = (struct benchmark_args *)clo_vec_get_args(clovec, 0);
+	if (args0 != nullptr && args0->perf_stats)
+		printf(";llc-misses-per-op;dtlb-misses-per-op");
+
 	if (bench->info->print_extra_headers)
 		bench->info->print_extra_headers();
 	printf("\n");
@@ -444,11 +532,68 @@ pmembench_print_results(struct benchmark *bench, struct benchmark_args *args,
 	if (bench->info->print_bandwidth)
 		printf(";%f", res->nopsps * args->dsize / 1024 / 1024);
 
+	if (args->perf_stats) {
+		double nops = (double)(res->nrepeats * res->nthreads *
+				       res->nops);
+		printf(";%f;%f", (double)res->llc_misses / nops,
+		       (double)res->dtlb_misses / nops);
+	}
+
 	if (bench->info->print_extra_values)
 		bench->info->print_extra_values(bench, args, res);
 	printf("\n");
 }
 
+/*
+ * pmembench_print_latency_json -- append the latency statistics and the
+ * log2-bucketed latency histogram as a JSON object to the requested file
+ */
+static int
+pmembench_print_latency_json(struct benchmark *bench,
+			     struct benchmark_args *args,
+			     struct total_results *res)
+{
+	FILE *f = os_fopen(args->latency_json, "a");
+	if (f == nullptr) {
+		perror(args->latency_json);
+		return -1;
+	}
+
+	fprintf(f, "{\"benchmark\": \"%s\", \"threads\": %u, ",
+		bench->info->name, args->n_threads);
+	fprintf(f, "\"ops-per-thread\": %zu, \"repeats\": %u, ",
+		args->n_ops_per_thread, args->repeats);
+	fprintf(f,
+		"\"latency\": {\"avg\": %" PRIu64 ", \"min\": %" PRIu64
+		", \"max\": %" PRIu64 ", \"std-dev\": %f, \"pctl-50.0\": %" PRIu64
+		", \"pctl-99.0\": %" PRIu64 ", \"pctl-99.9\": %" PRIu64 "}, ",
+		res->latency.avg, res->latency.min, res->latency.max,
+		res->latency.std_dev, res->latency.pctl50_0p,
+		res->latency.pctl99_0p, res->latency.pctl99_9p);
+
+	fprintf(f, "\"histogram\": [");
+	int first = 1;
+	for (unsigned i = 0; i < LAT_HIST_BUCKETS; i++) {
+		if (res->lat_hist[i] == 0)
+			continue;
+		fprintf(f,
+			"%s{\"min-nsec\": %" PRIu64 ", \"max-nsec\": %" PRIu64
+			", \"count\": %" PRIu64 "}",
+			first ? "" : ", ", UINT64_C(1) << i,
+			(i == 63) ? UINT64_MAX : (UINT64_C(2) << i) - 1,
+			res->lat_hist[i]);
+		first = 0;
+	}
+	fprintf(f, "]}\n");
+
+	if (fclose(f)) {
+		perror(args->latency_json);
+		return -1;
+	}
+
+	return 0;
+}
+
 /*
  * pmembench_parse_clos -- parse command line arguments for benchmark
  */
@@ -528,6 +673,130 @@ err:
 	return -1;
 }
 
+/*
+ * pmembench_get_nnodes -- count the NUMA nodes of the machine
+ */
+static int
+pmembench_get_nnodes(void)
+{
+	char path[PATH_MAX];
+	int n = 0;
+
+	while (snprintf(path, sizeof(path),
+			"/sys/devices/system/node/node%d", n) > 0 &&
+			os_access(path, F_OK) == 0)
+		n++;
+
+	return n;
+}
+
+/*
+ * pmembench_get_node_cpuset -- build the cpuset of one NUMA node from its
+ * sysfs cpulist ("0-15,32-47" style ranges)
+ */
+static int
+pmembench_get_node_cpuset(int node, os_cpu_set_t *set)
+{
+	char path[PATH_MAX];
+	if (snprintf(path, sizeof(path),
+			"/sys/devices/system/node/node%d/cpulist", node) < 0)
+		return -1;
+
+	FILE *f = os_fopen(path, "r");
+	if (f == nullptr) {
+		perror(path);
+		return -1;
+	}
+
+	char list[1024];
+	if (fgets(list, sizeof(list), f) == nullptr) {
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+
+	os_cpu_zero(set);
+
+	int ncpus = 0;
+	char *saveptr = nullptr;
+	for (char *tok = strtok_r(list, ",\n", &saveptr); tok != nullptr;
+			tok = strtok_r(nullptr, ",\n", &saveptr)) {
+		char *end;
+		long first = strtol(tok, &end, 10);
+		long last = first;
+		if (*end == '-')
+			last = strtol(end + 1, &end, 10);
+		if (*end != '\0' || last < first)
+			return -1;
+		for (long cpu = first; cpu <= last; cpu++) {
+			os_cpu_set((int)cpu, set);
+			ncpus++;
+		}
+	}
+
+	return ncpus > 0 ? 0 : -1;
+}
+
+/*
+ * pmembench_get_pool_node -- detect the NUMA node backing the pool file
+ *
+ * A page of the file (or of a probe file next to it, when the pool does
+ * not exist yet) is faulted in and looked up with move_pages(2), which
+ * covers both page cache and fsdax mappings without any ndctl help.
+ */
+static int
+pmembench_get_pool_node(const char *fname)
+{
+	char probe[PATH_MAX];
+	const char *path = fname;
+	int is_probe = 0;
+	int node = -1;
+
+	os_stat_t st;
+	int exists = os_stat(fname, &st) == 0;
+	int is_dir = exists && S_ISDIR(st.st_mode);
+	if (!exists || is_dir || st.st_size == 0) {
+		if (snprintf(probe, sizeof(probe), "%s%s.numa-probe",
+				fname, is_dir ? "/" : "") < 0)
+			return -1;
+		path = probe;
+		is_probe = 1;
+	}
+
+	int fd = os_open(path, O_CREAT | O_RDWR, 0600);
+	if (fd < 0) {
+		perror(path);
+		return -1;
+	}
+
+	if (is_probe && ftruncate(fd, (os_off_t)Pagesize) != 0)
+		goto end;
+
+	{
+		void *addr = mmap(nullptr, Pagesize, PROT_READ, MAP_SHARED,
+			fd, 0);
+		if (addr == MAP_FAILED)
+			goto end;
+
+		/* fault the page in, so it has a backing node */
+		*(volatile char *)addr;
+
+		void *pages[1] = {addr};
+		int status = -1;
+		if (syscall(SYS_move_pages, 0, 1, pages, nullptr, &status,
+				0) == 0 && status >= 0)
+			node = status;
+
+		munmap(addr, Pagesize);
+	}
+end:
+	os_close(fd);
+	if (is_probe)
+		util_unlink(path);
+
+	return node;
+}
+
 /*
  * pmembench_init_workers -- init benchmark's workers
  */
@@ -540,6 +809,53 @@ pmembench_init_workers(struct benchmark_worker **workers,
 	char *saveptr = nullptr;
 	int ret = 0;
 
+	int nnodes = 0;
+	int pool_node = -1;
+	bool numa_local = false;
+	bool use_numa = args->numa_interleave ||
+		(args->numa_placement && *args->numa_placement != '\0');
+
+	if (args->thread_affinity && use_numa) {
+		fprintf(stderr,
+			"thread affinity and NUMA pinning are mutually exclusive\n");
+		return -1;
+	}
+
+	if (use_numa) {
+		nnodes = pmembench_get_nnodes();
+		if (nnodes <= 0) {
+			fprintf(stderr, "cannot read the NUMA topology\n");
+			return -1;
+		}
+
+		if (!args->numa_interleave) {
+			numa_local = strcmp(args->numa_placement,
+				"local") == 0;
+			if (!numa_local && strcmp(args->numa_placement,
+					"remote") != 0) {
+				fprintf(stderr,
+					"invalid numa-placement: %s\n",
+					args->numa_placement);
+				return -1;
+			}
+
+			pool_node = pmembench_get_pool_node(args->fname);
+			if (pool_node < 0) {
+				fprintf(stderr,
+					"cannot determine the NUMA node of %s\n",
+					args->fname);
+				return -1;
+			}
+		}
+
+		/* label the results with the topology they were taken on */
+		printf("(numa: %d nodes%s%s)\n", nnodes,
+			args->numa_interleave ? ", interleaved" : "",
+			pool_node >= 0 ?
+				(numa_local ? ", local to the pool" :
+					", remote to the pool") : "");
+	}
+
 	if (args->thread_affinity) {
 		ncpus = sysconf(_SC_NPROCESSORS_ONLN);
 		if (ncpus <= 0)
@@ -577,6 +893,31 @@ pmembench_init_workers(struct benchmark_worker **workers,
 				ret = -1;
 				goto end;
 			}
+		} else if (use_numa) {
+			int node;
+			if (args->numa_interleave)
+				node = (int)i % nnodes;
+			else if (numa_local)
+				node = pool_node;
+			else
+				node = (pool_node + 1) % nnodes;
+
+			os_cpu_set_t cpuset;
+			if (pmembench_get_node_cpuset(node, &cpuset)) {
+				fprintf(stderr,
+					"cannot read the cpuset of node %d\n",
+					node);
+				ret = -1;
+				goto end;
+			}
+			errno = os_thread_setaffinity_np(&workers[i]->thread,
+							 sizeof(os_cpu_set_t),
+							 &cpuset);
+			if (errno) {
+				perror("os_thread_setaffinity_np");
+				ret = -1;
+				goto end;
+			}
 		}
 
 		workers[i]->info.index = i;
@@ -670,6 +1011,8 @@ results_alloc(struct benchmark_args *args)
 	total->nrepeats = args->repeats;
 	total->nthreads = args->n_threads;
 	total->nops = args->n_ops_per_thread;
+	total->warmup = args->warmup;
+	total->steady_cv = (double)args->steady_state / 100.0;
 	total->res = (struct bench_results *)malloc(args->repeats *
 						    sizeof(*total->res));
 	assert(total->res != nullptr);
@@ -707,6 +1050,87 @@ results_free(struct total_results *total)
 	free(total);
 }
 
+/* number of rolling-throughput windows the op stream is split into */
+#define STEADY_STATE_WINDOWS 20
+
+/*
+ * results_detect_steady_state -- detect the warm-up cutoff from rolling
+ * throughput
+ *
+ * Splits every repeat's operation stream into windows of equal operation
+ * count and walks forward until the coefficient of variation of the
+ * remaining windows' aggregate throughput falls below the configured
+ * threshold; everything before that point is cold-cache warm-up. At most
+ * half of the run may be discarded - a repeat that never stabilizes is
+ * reported on stderr and kept whole. The largest cutoff found across the
+ * repeats is returned, so every repeat contributes the same number of
+ * measured operations.
+ */
+static size_t
+results_detect_steady_state(struct total_results *tres)
+{
+	size_t wops = tres->nops / STEADY_STATE_WINDOWS;
+	if (wops == 0)
+		return 0;
+
+	double tput[STEADY_STATE_WINDOWS];
+	size_t cutoff = 0;
+
+	for (size_t i = 0; i < tres->nrepeats; i++) {
+		struct bench_results *res = &tres->res[i];
+
+		for (size_t w = 0; w < STEADY_STATE_WINDOWS; w++) {
+			size_t first = w * wops;
+			size_t last = w == STEADY_STATE_WINDOWS - 1 ?
+				tres->nops : first + wops;
+
+			tput[w] = 0.0;
+			for (size_t j = 0; j < tres->nthreads; j++) {
+				struct thread_results *thres = res->thres[j];
+				benchmark_time_t *beg = first == 0 ?
+					&thres->beg :
+					&thres->end_op[first - 1];
+				benchmark_time_t diff;
+				benchmark_time_diff(&diff, beg,
+						    &thres->end_op[last - 1]);
+				double secs = benchmark_time_get_secs(&diff);
+				if (secs > 0.0)
+					tput[w] += (double)(last - first) /
+						secs;
+			}
+		}
+
+		size_t w0;
+		for (w0 = 0; w0 <= STEADY_STATE_WINDOWS / 2; w0++) {
+			size_t nwin = STEADY_STATE_WINDOWS - w0;
+			double avg = 0.0;
+			for (size_t w = w0; w < STEADY_STATE_WINDOWS; w++)
+				avg += tput[w];
+			avg /= (double)nwin;
+
+			double var = 0.0;
+			for (size_t w = w0; w < STEADY_STATE_WINDOWS; w++)
+				var += (tput[w] - avg) * (tput[w] - avg);
+
+			if (avg > 0.0 &&
+			    sqrt(var / (double)nwin) / avg <= tres->steady_cv)
+				break;
+		}
+
+		if (w0 > STEADY_STATE_WINDOWS / 2) {
+			fprintf(stderr,
+				"steady state not reached in repeat %zu - keeping the whole run\n",
+				i);
+			continue;
+		}
+
+		if (w0 * wops > cutoff)
+			cutoff = w0 * wops;
+	}
+
+	return cutoff;
+}
+
 /*
  * get_total_results -- return results of all repeats of scenario
  */
@@ -717,9 +1141,27 @@ get_total_results(struct total_results *tres)
 	assert(tres->nthreads != 0);
 	assert(tres->nops != 0);
 
+	/* operations before the warm-up cutoff are excluded from statistics */
+	size_t warmup = tres->warmup;
+	if (tres->steady_cv > 0.0) {
+		size_t detected = results_detect_steady_state(tres);
+		if (detected > warmup)
+			warmup = detected;
+	}
+	assert(warmup < tres->nops);
+	size_t mops = tres->nops - warmup;
+
 	/* reset results */
 	memset(&tres->total, 0, sizeof(tres->total));
 	memset(&tres->latency, 0, sizeof(tres->latency));
+	memset(tres->lat_hist, 0, sizeof(tres->lat_hist));
+	tres->llc_misses = 0;
+	tres->dtlb_misses = 0;
+
+	for (size_t i = 0; i < tres->nrepeats; i++) {
+		tres->llc_misses += tres->res[i].llc_misses;
+		tres->dtlb_misses += tres->res[i].dtlb_misses;
+	}
 
 	tres->total.min = DBL_MAX;
 	tres->total.max = DBL_MIN;
@@ -738,7 +1180,7 @@ get_total_results(struct total_results *tres)
 
 	/* estimate total penalty of getting time from the system */
 	benchmark_time_t Tget;
-	unsigned long long nsecs = tres->nops * Get_time_avg;
+	unsigned long long nsecs = mops * Get_time_avg;
 	benchmark_time_set(&Tget, nsecs);
 
 	for (size_t i = 0; i < tres->nrepeats; i++) {
@@ -746,7 +1188,8 @@ get_total_results(struct total_results *tres)
 
 		/* get start and end timestamps of each worker */
 		for (size_t j = 0; j < tres->nthreads; j++) {
-			tbeg[j] = res->thres[j]->beg;
+			tbeg[j] = warmup == 0 ? res->thres[j]->beg :
+				res->thres[j]->end_op[warmup - 1];
 			tend[j] = res->thres[j]->end;
 		}
 
@@ -794,7 +1237,7 @@ get_total_results(struct total_results *tres)
 
 	/* number of operations per second */
 	tres->nopsps =
-		(double)tres->nops * (double)tres->nthreads / tres->total.avg;
+		(double)mops * (double)tres->nthreads / tres->total.avg;
 
 	/* std deviation of total time */
 	for (size_t i = 0; i < tres->nrepeats; i++) {
@@ -811,8 +1254,9 @@ get_total_results(struct total_results *tres)
 		struct bench_results *res = &tres->res[i];
 		for (size_t j = 0; j < tres->nthreads; j++) {
 			struct thread_results *thres = res->thres[j];
-			benchmark_time_t *beg = &thres->beg;
-			for (size_t o = 0; o < tres->nops; o++) {
+			benchmark_time_t *beg = warmup == 0 ? &thres->beg :
+				&thres->end_op[warmup - 1];
+			for (size_t o = warmup; o < tres->nops; o++) {
 				benchmark_time_t lat;
 				benchmark_time_diff(&lat, beg,
 						    &thres->end_op[o]);
@@ -832,7 +1276,7 @@ get_total_results(struct total_results *tres)
 	}
 
 	/* average latency */
-	size_t count = tres->nrepeats * tres->nthreads * tres->nops;
+	size_t count = tres->nrepeats * tres->nthreads * mops;
 	assert(count > 0);
 	tres->latency.avg /= count;
 
@@ -845,8 +1289,9 @@ get_total_results(struct total_results *tres)
 		struct bench_results *res = &tres->res[i];
 		for (size_t j = 0; j < tres->nthreads; j++) {
 			struct thread_results *thres = res->thres[j];
-			benchmark_time_t *beg = &thres->beg;
-			for (size_t o = 0; o < tres->nops; o++) {
+			benchmark_time_t *beg = warmup == 0 ? &thres->beg :
+				&thres->end_op[warmup - 1];
+			for (size_t o = warmup; o < tres->nops; o++) {
 				benchmark_time_t lat;
 				benchmark_time_diff(&lat, beg,
 						    &thres->end_op[o]);
@@ -857,6 +1302,8 @@ get_total_results(struct total_results *tres)
 
 				tres->latency.std_dev += dev;
 
+				tres->lat_hist[util_mssb_index64(nsecs | 1)]++;
+
 				beg = &thres->end_op[o];
 
 				ntotals[count] = nsecs;
@@ -1105,6 +1552,71 @@ pmembench_remove_file(const char *path)
 	return util_file_dir_remove(path);
 }
 
+/* hardware counters sampled during the measured phase of each repeat */
+#define PERF_NCOUNTERS 2
+
+/*
+ * pmembench_perf_open -- (internal) opens the hardware counters for the
+ * calling process
+ *
+ * The counters are opened disabled, with inheritance, before the worker
+ * threads are spawned, so the threads are included in the counts. Media-level
+ * counters live on vendor-specific uncore PMUs and are not portable, so only
+ * the generic cache and TLB events are sampled. When the events are not
+ * available (permissions, virtualization), the run continues without them.
+ */
+static void
+pmembench_perf_open(int *fds)
+{
+	static const uint64_t configs[PERF_NCOUNTERS] = {
+		PERF_COUNT_HW_CACHE_LL |
+			(PERF_COUNT_HW_CACHE_OP_READ << 8) |
+			(PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+		PERF_COUNT_HW_CACHE_DTLB |
+			(PERF_COUNT_HW_CACHE_OP_READ << 8) |
+			(PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+	};
+	static bool warned;
+
+	for (int i = 0; i < PERF_NCOUNTERS; i++) {
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.config = configs[i];
+		attr.disabled = 1;
+		attr.inherit = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+
+		fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1,
+				      0);
+		if (fds[i] < 0 && !warned) {
+			perror("perf_event_open");
+			warned = true;
+		}
+	}
+}
+
+/*
+ * pmembench_perf_collect -- (internal) stops the counters, reads their
+ * values and closes them
+ */
+static void
+pmembench_perf_collect(int *fds, uint64_t *values)
+{
+	for (int i = 0; i < PERF_NCOUNTERS; i++) {
+		values[i] = 0;
+		if (fds[i] < 0)
+			continue;
+		ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+		if (read(fds[i], &values[i], sizeof(values[i])) !=
+		    sizeof(values[i]))
+			values[i] = 0;
+		close(fds[i]);
+	}
+}
+
 /*
  * pmembench_single_repeat -- runs benchmark ones
  */
@@ -1153,11 +1665,27 @@ pmembench_single_repeat(struct benchmark *bench, struct benchmark_args *args,
 		args->n_threads * sizeof(struct benchmark_worker *));
 	assert(workers != nullptr);
 
+	int perf_fds[PERF_NCOUNTERS];
+	uint64_t perf_values[PERF_NCOUNTERS] = {0, 0};
+
+	/* open before the workers are spawned so they inherit the counters */
+	if (args->perf_stats)
+		pmembench_perf_open(perf_fds);
+
 	if ((ret = pmembench_init_workers(workers, bench, args)) != 0) {
+		if (args->perf_stats)
+			pmembench_perf_collect(perf_fds, perf_values);
 		goto out;
 	}
 
 	unsigned j;
+
+	if (args->perf_stats) {
+		for (int c = 0; c < PERF_NCOUNTERS; c++)
+			if (perf_fds[c] >= 0)
+				ioctl(perf_fds[c], PERF_EVENT_IOC_ENABLE, 0);
+	}
+
 	for (j = 0; j < args->n_threads; j++) {
 		benchmark_worker_run(workers[j]);
 	}
@@ -1170,6 +1698,12 @@ pmembench_single_repeat(struct benchmark *bench, struct benchmark_args *args,
 		}
 	}
 
+	if (args->perf_stats)
+		pmembench_perf_collect(perf_fds, perf_values);
+
+	res->llc_misses = perf_values[0];
+	res->dtlb_misses = perf_values[1];
+
 	results_store(res, workers, args->n_threads, args->n_ops_per_thread);
 
 	for (j = 0; j < args->n_threads; j++) {
@@ -1188,6 +1722,243 @@ out:
 	return ret;
 }
 
+/*
+ * struct proc_results -- per-process result summary passed through the
+ * shared memory region back to the coordinator
+ */
+struct proc_results {
+	int ret;
+	double nopsps;
+	struct results total;
+	struct latency latency;
+	uint64_t lat_hist[LAT_HIST_BUCKETS];
+	uint64_t llc_misses;
+	uint64_t dtlb_misses;
+};
+
+/*
+ * struct processes_shm -- shared memory region used to coordinate worker
+ * processes - a process-shared barrier for synchronizing the start of each
+ * repeat and one result slot per process
+ */
+struct processes_shm {
+	pthread_barrier_t barrier;
+	struct proc_results res[];
+};
+
+/*
+ * pmembench_merge_process_results -- combine per-process result summaries
+ * into a single row of output
+ *
+ * The processes run concurrently, so throughput is summed and total times
+ * are averaged. Latency averages and standard deviations are pooled over
+ * equally-sized populations; the percentiles of the merged distribution
+ * cannot be recovered from the summaries, so the worst value reported by
+ * any process is used as a conservative estimate.
+ */
+static void
+pmembench_merge_process_results(struct total_results *merged,
+				const struct proc_results *procs,
+				unsigned nprocs)
+{
+	merged->total.min = DBL_MAX;
+	merged->total.max = DBL_MIN;
+	merged->latency.min = UINT64_MAX;
+	merged->latency.max = 0;
+
+	double lat_avg = 0;
+
+	for (unsigned p = 0; p < nprocs; p++) {
+		const struct proc_results *pr = &procs[p];
+
+		merged->nopsps += pr->nopsps;
+
+		if (pr->total.min < merged->total.min)
+			merged->total.min = pr->total.min;
+		if (pr->total.max > merged->total.max)
+			merged->total.max = pr->total.max;
+		merged->total.avg += pr->total.avg / nprocs;
+		merged->total.med += pr->total.med / nprocs;
+		merged->total.std_dev += pr->total.std_dev / nprocs;
+
+		if (pr->latency.min < merged->latency.min)
+			merged->latency.min = pr->latency.min;
+		if (pr->latency.max > merged->latency.max)
+			merged->latency.max = pr->latency.max;
+		lat_avg += (double)pr->latency.avg / nprocs;
+
+		if (pr->latency.pctl50_0p > merged->latency.pctl50_0p)
+			merged->latency.pctl50_0p = pr->latency.pctl50_0p;
+		if (pr->latency.pctl99_0p > merged->latency.pctl99_0p)
+			merged->latency.pctl99_0p = pr->latency.pctl99_0p;
+		if (pr->latency.pctl99_9p > merged->latency.pctl99_9p)
+			merged->latency.pctl99_9p = pr->latency.pctl99_9p;
+
+		for (unsigned b = 0; b < LAT_HIST_BUCKETS; b++)
+			merged->lat_hist[b] += pr->lat_hist[b];
+
+		merged->llc_misses += pr->llc_misses;
+		merged->dtlb_misses += pr->dtlb_misses;
+	}
+
+	merged->latency.avg = (uint64_t)lat_avg;
+
+	/* pooled variance: mean of variances plus spread of the means */
+	double var = 0;
+	for (unsigned p = 0; p < nprocs; p++) {
+		const struct proc_results *pr = &procs[p];
+		double d = (double)pr->latency.avg - lat_avg;
+		var += (pr->latency.std_dev * pr->latency.std_dev + d * d) /
+			nprocs;
+	}
+	merged->latency.std_dev = sqrt(var);
+}
+
+/*
+ * pmembench_worker_process -- run all repeats of a benchmark in a forked
+ * worker process and store the result summary in the shared memory slot
+ *
+ * Pools are opened with an exclusive file lock, so each process operates
+ * on its own file - the benchmarked library code still contends for CPUs,
+ * caches and the memory bus with its siblings.
+ */
+static int
+pmembench_worker_process(struct benchmark *bench, struct benchmark_args *args,
+			 struct processes_shm *shm, unsigned proc_idx)
+{
+	char fname[PATH_MAX];
+	if (util_snprintf(fname, sizeof(fname), "%s.%u", args->fname,
+			  proc_idx) < 0) {
+		perror("util_snprintf");
+		return -1;
+	}
+	args->fname = fname;
+
+	struct total_results *total_res = results_alloc(args);
+	assert(total_res != nullptr);
+
+	int ret = 0;
+	for (unsigned i = 0; i < args->repeats; i++) {
+		/* all workers start each repeat at the same moment */
+		pthread_barrier_wait(&shm->barrier);
+
+		/*
+		 * after a failure keep joining the barrier so that the
+		 * remaining workers are not blocked forever
+		 */
+		if (ret != 0)
+			continue;
+
+		ret = pmembench_single_repeat(bench, args,
+					      &total_res->res[i]);
+	}
+
+	if (ret == 0) {
+		get_total_results(total_res);
+		shm->res[proc_idx].nopsps = total_res->nopsps;
+		shm->res[proc_idx].total = total_res->total;
+		shm->res[proc_idx].latency = total_res->latency;
+		memcpy(shm->res[proc_idx].lat_hist, total_res->lat_hist,
+		       sizeof(total_res->lat_hist));
+		shm->res[proc_idx].llc_misses = total_res->llc_misses;
+		shm->res[proc_idx].dtlb_misses = total_res->dtlb_misses;
+	}
+	shm->res[proc_idx].ret = ret;
+
+	results_free(total_res);
+
+	return ret;
+}
+
+/*
+ * pmembench_run_processes -- fork worker processes, wait for them to finish
+ * and print a single row with the merged results
+ */
+static int
+pmembench_run_processes(struct benchmark *bench, struct benchmark_args *args)
+{
+	unsigned nprocs = args->n_processes;
+	int ret = 0;
+
+	size_t shm_size = sizeof(struct processes_shm) +
+		nprocs * sizeof(struct proc_results);
+	auto *shm = (struct processes_shm *)mmap(nullptr, shm_size,
+						 PROT_READ | PROT_WRITE,
+						 MAP_SHARED | MAP_ANONYMOUS,
+						 -1, 0);
+	if (shm == MAP_FAILED) {
+		perror("mmap");
+		return -1;
+	}
+
+	pthread_barrierattr_t battr;
+	pthread_barrierattr_init(&battr);
+	pthread_barrierattr_setpshared(&battr, PTHREAD_PROCESS_SHARED);
+	errno = pthread_barrier_init(&shm->barrier, &battr, nprocs);
+	pthread_barrierattr_destroy(&battr);
+	if (errno) {
+		perror("pthread_barrier_init");
+		munmap(shm, shm_size);
+		return -1;
+	}
+
+	for (unsigned p = 0; p < nprocs; p++)
+		shm->res[p].ret = -1;
+
+	auto *pids = (pid_t *)calloc(nprocs, sizeof(pid_t));
+	assert(pids != nullptr);
+
+	unsigned nstarted;
+	for (nstarted = 0; nstarted < nprocs; nstarted++) {
+		pid_t pid = fork();
+		if (pid < 0) {
+			perror("fork");
+			ret = -1;
+			break;
+		}
+		if (pid == 0) {
+			exit(pmembench_worker_process(bench, args, shm,
+						      nstarted));
+		}
+		pids[nstarted] = pid;
+	}
+
+	if (ret != 0) {
+		for (unsigned p = 0; p < nstarted; p++)
+			kill(pids[p], SIGKILL);
+	}
+
+	for (unsigned p = 0; p < nstarted; p++) {
+		int status;
+		if (waitpid(pids[p], &status, 0) < 0 || !WIFEXITED(status) ||
+		    WEXITSTATUS(status) != 0 || shm->res[p].ret != 0) {
+			fprintf(stderr, "worker process %u failed\n", p);
+			ret = -1;
+		}
+	}
+
+	if (ret == 0) {
+		struct total_results merged;
+		memset(&merged, 0, sizeof(merged));
+		merged.nrepeats = args->repeats;
+		/* all workers across all processes count towards per-op stats */
+		merged.nthreads = (size_t)args->n_threads * nprocs;
+		merged.nops = args->n_ops_per_thread;
+		pmembench_merge_process_results(&merged, shm->res, nprocs);
+		pmembench_print_results(bench, args, &merged);
+
+		if (args->latency_json[0] != '\0')
+			ret = pmembench_print_latency_json(bench, args,
+							   &merged);
+	}
+
+	free(pids);
+	pthread_barrier_destroy(&shm->barrier);
+	munmap(shm, shm_size);
+
+	return ret;
+}
+
 /*
  * scale_up_min_exe_time -- scale up the number of operations to obtain an
  * execution time not smaller than the assumed minimal execution time
@@ -1399,6 +2170,43 @@ pmembench_run(struct pmembench *pb, struct benchmark *bench)
 		size_t n_ops_per_thread_copy = args->n_ops_per_thread;
 		args->n_ops_per_thread =
 			!bench->info->multiops ? 1 : args->n_ops_per_thread;
+		size_t warmup_copy = args->warmup;
+		args->warmup = !bench->info->multiops ? 0 : args->warmup;
+
+		if (args->warmup >= args->n_ops_per_thread &&
+		    bench->info->multiops) {
+			fprintf(stderr,
+				"warmup must be lower than the number of operations per thread\n");
+			ret = -1;
+			goto out;
+		}
+
+		if (args->n_processes > 1) {
+			/*
+			 * every worker process needs its own file - poolsets
+			 * and device dax cannot be cloned per process
+			 */
+			if (args->is_poolset || args->is_dynamic_poolset ||
+			    type == TYPE_DEVDAX) {
+				fprintf(stderr,
+					"multi-process mode requires a regular file\n");
+				ret = -1;
+				goto out;
+			}
+			if (args->min_exe_time != 0)
+				fprintf(stderr,
+					"minimal execution time is ignored in multi-process mode\n");
+
+			ret = pmembench_run_processes(bench, args);
+
+			args->n_ops_per_thread = n_ops_per_thread_copy;
+			args->n_threads = n_threads_copy;
+			args->warmup = warmup_copy;
+
+			if (ret != 0)
+				goto out;
+			continue;
+		}
 
 		stats = (struct latency *)calloc(args->repeats,
 						 sizeof(struct latency));
@@ -1427,8 +2235,16 @@ pmembench_run(struct pmembench *pb, struct benchmark *bench)
 		get_total_results(total_res);
 		pmembench_print_results(bench, args, total_res);
 
+		if (args->latency_json[0] != '\0') {
+			ret = pmembench_print_latency_json(bench, args,
+							   total_res);
+			if (ret != 0)
+				goto out;
+		}
+
 		args->n_ops_per_thread = n_ops_per_thread_copy;
 		args->n_threads = n_threads_copy;
+		args->warmup = warmup_copy;
 
 		results_free(total_res);
 		free(stats);
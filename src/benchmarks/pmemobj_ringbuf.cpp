@@ -0,0 +1,218 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2024, Intel Corporation */
+
+/*
+ * pmemobj_ringbuf.cpp -- persistent ring buffer benchmark definition
+ *
+ * Worker threads act as producers appending data-size records to one shared
+ * ring buffer while a background thread continuously drains it in batches,
+ * so the reported numbers cover the full multi-producer single-consumer
+ * append path.
+ */
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <sched.h>
+
+#include "benchmark.hpp"
+#include "file.h"
+#include "libpmemobj.h"
+#include "os_thread.h"
+
+/*
+ * prog_args - benchmark specific command line options
+ */
+struct prog_args {
+	size_t ring_entries; /* capacity of the ring buffer */
+};
+
+/*
+ * obj_bench - variables used in benchmark, passed within functions
+ */
+struct obj_bench {
+	PMEMobjpool *pop;     /* persistent pool handle */
+	struct prog_args *pa; /* prog_args structure */
+	PMEMoid rb;	      /* the shared ring buffer */
+	char *data;	      /* record payload written by producers */
+	os_thread_t consumer; /* background draining thread */
+	int stop;	      /* tells the consumer to finish */
+};
+
+/*
+ * ringbuf_drain_cb -- (internal) consumption callback, discards the record
+ */
+static int
+ringbuf_drain_cb(const void *data, size_t len, void *arg)
+{
+	(void) data;
+	(void) len;
+	(void) arg;
+
+	return 0;
+}
+
+/*
+ * ringbuf_consumer -- (internal) drains the ring buffer until told to stop
+ */
+static void *
+ringbuf_consumer(void *arg)
+{
+	auto *ob = (struct obj_bench *)arg;
+
+	while (!util_bool_compare_and_swap32(&ob->stop, 1, 1)) {
+		if (pmemobj_ringbuf_dequeue(ob->pop, ob->rb, 0,
+			ringbuf_drain_cb, nullptr) == 0)
+			sched_yield();
+	}
+
+	/* leave the buffer empty so producers never exit on a full ring */
+	pmemobj_ringbuf_dequeue(ob->pop, ob->rb, 0, ringbuf_drain_cb, nullptr);
+
+	return nullptr;
+}
+
+/*
+ * ringbuf_init -- benchmark initialization
+ */
+static int
+ringbuf_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	assert(bench != nullptr);
+	assert(args != nullptr);
+	assert(args->opts != nullptr);
+
+	enum file_type type = util_file_get_type(args->fname);
+	if (type == OTHER_ERROR) {
+		fprintf(stderr, "could not check type of file %s\n",
+			args->fname);
+		return -1;
+	}
+
+	auto *ob = (struct obj_bench *)calloc(1, sizeof(struct obj_bench));
+	if (ob == nullptr) {
+		perror("calloc");
+		return -1;
+	}
+	pmembench_set_priv(bench, ob);
+
+	ob->pa = (struct prog_args *)args->opts;
+
+	ob->data = (char *)malloc(args->dsize);
+	if (ob->data == nullptr) {
+		perror("malloc");
+		goto err_free_ob;
+	}
+	memset(ob->data, 0xc, args->dsize);
+
+	size_t psize;
+	if (args->is_poolset || type == TYPE_DEVDAX)
+		psize = 0;
+	else
+		psize = PMEMOBJ_MIN_POOL +
+			2 * ob->pa->ring_entries * (args->dsize + 64);
+
+	/* create pmemobj pool */
+	ob->pop = pmemobj_create(args->fname, "obj_ringbuf", psize,
+		args->fmode);
+	if (ob->pop == nullptr) {
+		fprintf(stderr, "%s\n", pmemobj_errormsg());
+		goto err_free_data;
+	}
+
+	if (pmemobj_ringbuf_new(ob->pop, &ob->rb, args->dsize,
+		ob->pa->ring_entries, 0) != 0) {
+		fprintf(stderr, "%s\n", pmemobj_errormsg());
+		goto err_close;
+	}
+
+	if (os_thread_create(&ob->consumer, nullptr, ringbuf_consumer, ob)) {
+		perror("os_thread_create");
+		goto err_close;
+	}
+
+	return 0;
+
+err_close:
+	pmemobj_close(ob->pop);
+err_free_data:
+	free(ob->data);
+err_free_ob:
+	free(ob);
+	return -1;
+}
+
+/*
+ * ringbuf_exit -- benchmark clean up
+ */
+static int
+ringbuf_exit(struct benchmark *bench, struct benchmark_args *args)
+{
+	auto *ob = (struct obj_bench *)pmembench_get_priv(bench);
+
+	util_bool_compare_and_swap32(&ob->stop, 0, 1);
+	os_thread_join(&ob->consumer, nullptr);
+
+	pmemobj_close(ob->pop);
+	free(ob->data);
+	free(ob);
+
+	return 0;
+}
+
+/*
+ * ringbuf_op -- performs a single enqueue operation
+ */
+static int
+ringbuf_op(struct benchmark *bench, struct operation_info *info)
+{
+	auto *ob = (struct obj_bench *)pmembench_get_priv(bench);
+
+	while (pmemobj_ringbuf_enqueue(ob->pop, ob->rb, ob->data,
+		info->args->dsize) != 0) {
+		if (errno != EAGAIN) {
+			fprintf(stderr, "%s\n", pmemobj_errormsg());
+			return -1;
+		}
+		sched_yield();
+	}
+
+	return 0;
+}
+
+static struct benchmark_clo ringbuf_clo[1];
+static struct benchmark_info ringbuf_info;
+
+CONSTRUCTOR(pmemobj_ringbuf_constructor)
+void
+pmemobj_ringbuf_constructor(void)
+{
+	ringbuf_clo[0].opt_short = 'e';
+	ringbuf_clo[0].opt_long = "ring-entries";
+	ringbuf_clo[0].descr = "Capacity of the ring buffer "
+			       "(rounded up to a power of two)";
+	ringbuf_clo[0].type = CLO_TYPE_UINT;
+	ringbuf_clo[0].off = clo_field_offset(struct prog_args, ring_entries);
+	ringbuf_clo[0].def = "4096";
+	ringbuf_clo[0].type_uint.size =
+		clo_field_size(struct prog_args, ring_entries);
+	ringbuf_clo[0].type_uint.base = CLO_INT_BASE_DEC;
+	ringbuf_clo[0].type_uint.min = 1;
+	ringbuf_clo[0].type_uint.max = UINT32_MAX;
+
+	ringbuf_info.name = "obj_ringbuf";
+	ringbuf_info.brief = "Benchmark for persistent ring "
+			     "buffer appends";
+	ringbuf_info.init = ringbuf_init;
+	ringbuf_info.exit = ringbuf_exit;
+	ringbuf_info.multithread = true;
+	ringbuf_info.multiops = true;
+	ringbuf_info.operation = ringbuf_op;
+	ringbuf_info.measure_time = true;
+	ringbuf_info.clos = ringbuf_clo;
+	ringbuf_info.nclos = ARRAY_SIZE(ringbuf_clo);
+	ringbuf_info.opts_size = sizeof(struct prog_args);
+	ringbuf_info.rm_file = true;
+	ringbuf_info.allow_poolset = true;
+	REGISTER_BENCHMARK(ringbuf_info);
+}
@@ -0,0 +1,318 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2024, Intel Corporation */
+
+/*
+ * pmemobj_stack.cpp -- persistent stack benchmark definition
+ *
+ * Worker threads push data-size records onto one shared stack while a
+ * background thread continuously pops it in batches. The same workload can
+ * run against the non-transactional stack or against a transactional
+ * linked-list equivalent (--tx), so the two fast paths can be compared
+ * directly.
+ */
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <sched.h>
+
+#include "benchmark.hpp"
+#include "file.h"
+#include "libpmemobj.h"
+#include "os_thread.h"
+
+/*
+ * prog_args - benchmark specific command line options
+ */
+struct prog_args {
+	size_t stack_entries; /* capacity of the stack */
+	bool use_tx;	      /* use the transactional equivalent */
+};
+
+/* a node of the transactional linked-list stack */
+struct tx_node {
+	PMEMoid next;
+	size_t len;
+	char data[];
+};
+
+/*
+ * obj_bench - variables used in benchmark, passed within functions
+ */
+struct obj_bench {
+	PMEMobjpool *pop;     /* persistent pool handle */
+	struct prog_args *pa; /* prog_args structure */
+	PMEMoid st;	      /* the shared non-transactional stack */
+	PMEMoid root;	      /* head holder of the transactional stack */
+	os_mutex_t lock;      /* serializes the transactional variant */
+	char *data;	      /* record payload written by producers */
+	os_thread_t consumer; /* background popping thread */
+	int stop;	      /* tells the consumer to finish */
+};
+
+/*
+ * stack_drain_cb -- (internal) consumption callback, discards the record
+ */
+static int
+stack_drain_cb(const void *data, size_t len, void *arg)
+{
+	(void) data;
+	(void) len;
+	(void) arg;
+
+	return 0;
+}
+
+/*
+ * stack_tx_push -- (internal) pushes one node onto the transactional stack
+ */
+static int
+stack_tx_push(struct obj_bench *ob, size_t dsize)
+{
+	int ret = 0;
+
+	os_mutex_lock(&ob->lock);
+
+	TX_BEGIN(ob->pop) {
+		auto *headp = (PMEMoid *)pmemobj_direct(ob->root);
+		pmemobj_tx_add_range(ob->root, 0, sizeof(PMEMoid));
+
+		PMEMoid n = pmemobj_tx_alloc(sizeof(struct tx_node) + dsize,
+			0);
+		auto *node = (struct tx_node *)pmemobj_direct(n);
+		node->next = *headp;
+		node->len = dsize;
+		memcpy(node->data, ob->data, dsize);
+
+		*headp = n;
+	} TX_ONABORT {
+		ret = -1;
+	} TX_END
+
+	os_mutex_unlock(&ob->lock);
+
+	return ret;
+}
+
+/*
+ * stack_tx_pop -- (internal) pops one node off the transactional stack
+ *
+ * Returns 1 when a node was popped and 0 when the stack is empty.
+ */
+static int
+stack_tx_pop(struct obj_bench *ob)
+{
+	int popped = 0;
+
+	os_mutex_lock(&ob->lock);
+
+	TX_BEGIN(ob->pop) {
+		auto *headp = (PMEMoid *)pmemobj_direct(ob->root);
+		if (!OID_IS_NULL(*headp)) {
+			pmemobj_tx_add_range(ob->root, 0, sizeof(PMEMoid));
+
+			PMEMoid n = *headp;
+			auto *node = (struct tx_node *)pmemobj_direct(n);
+			*headp = node->next;
+			pmemobj_tx_free(n);
+			popped = 1;
+		}
+	} TX_END
+
+	os_mutex_unlock(&ob->lock);
+
+	return popped;
+}
+
+/*
+ * stack_consumer -- (internal) pops the stack until told to stop
+ */
+static void *
+stack_consumer(void *arg)
+{
+	auto *ob = (struct obj_bench *)arg;
+
+	while (!util_bool_compare_and_swap32(&ob->stop, 1, 1)) {
+		size_t n;
+		if (ob->pa->use_tx)
+			n = (size_t)stack_tx_pop(ob);
+		else
+			n = pmemobj_stack_pop(ob->pop, ob->st, 0,
+				stack_drain_cb, nullptr);
+		if (n == 0)
+			sched_yield();
+	}
+
+	/* leave the stack empty so producers never exit on a full stack */
+	if (ob->pa->use_tx) {
+		while (stack_tx_pop(ob))
+			;
+	} else {
+		pmemobj_stack_pop(ob->pop, ob->st, 0, stack_drain_cb,
+			nullptr);
+	}
+
+	return nullptr;
+}
+
+/*
+ * stack_init -- benchmark initialization
+ */
+static int
+stack_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	assert(bench != nullptr);
+	assert(args != nullptr);
+	assert(args->opts != nullptr);
+
+	enum file_type type = util_file_get_type(args->fname);
+	if (type == OTHER_ERROR) {
+		fprintf(stderr, "could not check type of file %s\n",
+			args->fname);
+		return -1;
+	}
+
+	auto *ob = (struct obj_bench *)calloc(1, sizeof(struct obj_bench));
+	if (ob == nullptr) {
+		perror("calloc");
+		return -1;
+	}
+	pmembench_set_priv(bench, ob);
+
+	ob->pa = (struct prog_args *)args->opts;
+	os_mutex_init(&ob->lock);
+
+	ob->data = (char *)malloc(args->dsize);
+	if (ob->data == nullptr) {
+		perror("malloc");
+		goto err_free_ob;
+	}
+	memset(ob->data, 0xc, args->dsize);
+
+	size_t psize;
+	if (args->is_poolset || type == TYPE_DEVDAX)
+		psize = 0;
+	else
+		psize = PMEMOBJ_MIN_POOL +
+			2 * ob->pa->stack_entries * (args->dsize + 64);
+
+	/* create pmemobj pool */
+	ob->pop = pmemobj_create(args->fname, "obj_stack", psize,
+		args->fmode);
+	if (ob->pop == nullptr) {
+		fprintf(stderr, "%s\n", pmemobj_errormsg());
+		goto err_free_data;
+	}
+
+	if (ob->pa->use_tx) {
+		ob->root = pmemobj_root(ob->pop, sizeof(PMEMoid));
+		if (OID_IS_NULL(ob->root)) {
+			fprintf(stderr, "%s\n", pmemobj_errormsg());
+			goto err_close;
+		}
+	} else if (pmemobj_stack_new(ob->pop, &ob->st, args->dsize,
+		ob->pa->stack_entries, 0) != 0) {
+		fprintf(stderr, "%s\n", pmemobj_errormsg());
+		goto err_close;
+	}
+
+	if (os_thread_create(&ob->consumer, nullptr, stack_consumer, ob)) {
+		perror("os_thread_create");
+		goto err_close;
+	}
+
+	return 0;
+
+err_close:
+	pmemobj_close(ob->pop);
+err_free_data:
+	free(ob->data);
+err_free_ob:
+	os_mutex_destroy(&ob->lock);
+	free(ob);
+	return -1;
+}
+
+/*
+ * stack_exit -- benchmark clean up
+ */
+static int
+stack_exit(struct benchmark *bench, struct benchmark_args *args)
+{
+	auto *ob = (struct obj_bench *)pmembench_get_priv(bench);
+
+	util_bool_compare_and_swap32(&ob->stop, 0, 1);
+	os_thread_join(&ob->consumer, nullptr);
+
+	pmemobj_close(ob->pop);
+	os_mutex_destroy(&ob->lock);
+	free(ob->data);
+	free(ob);
+
+	return 0;
+}
+
+/*
+ * stack_op -- performs a single push operation
+ */
+static int
+stack_op(struct benchmark *bench, struct operation_info *info)
+{
+	auto *ob = (struct obj_bench *)pmembench_get_priv(bench);
+
+	if (ob->pa->use_tx)
+		return stack_tx_push(ob, info->args->dsize);
+
+	while (pmemobj_stack_push(ob->pop, ob->st, ob->data,
+		info->args->dsize) != 0) {
+		if (errno != EAGAIN) {
+			fprintf(stderr, "%s\n", pmemobj_errormsg());
+			return -1;
+		}
+		sched_yield();
+	}
+
+	return 0;
+}
+
+static struct benchmark_clo stack_clo[2];
+static struct benchmark_info stack_info;
+
+CONSTRUCTOR(pmemobj_stack_constructor)
+void
+pmemobj_stack_constructor(void)
+{
+	stack_clo[0].opt_short = 'e';
+	stack_clo[0].opt_long = "stack-entries";
+	stack_clo[0].descr = "Capacity of the stack";
+	stack_clo[0].type = CLO_TYPE_UINT;
+	stack_clo[0].off = clo_field_offset(struct prog_args, stack_entries);
+	stack_clo[0].def = "4096";
+	stack_clo[0].type_uint.size =
+		clo_field_size(struct prog_args, stack_entries);
+	stack_clo[0].type_uint.base = CLO_INT_BASE_DEC;
+	stack_clo[0].type_uint.min = 1;
+	stack_clo[0].type_uint.max = UINT32_MAX;
+
+	stack_clo[1].opt_short = 'x';
+	stack_clo[1].opt_long = "tx";
+	stack_clo[1].descr = "Use a transactional linked-list stack "
+			     "guarded by a mutex instead";
+	stack_clo[1].type = CLO_TYPE_FLAG;
+	stack_clo[1].off = clo_field_offset(struct prog_args, use_tx);
+
+	stack_info.name = "obj_stack";
+	stack_info.brief = "Benchmark for persistent stack pushes";
+	stack_info.init = stack_init;
+	stack_info.exit = stack_exit;
+	stack_info.multithread = true;
+	stack_info.multiops = true;
+	stack_info.operation = stack_op;
+	stack_info.measure_time = true;
+	stack_info.clos = stack_clo;
+	stack_info.nclos = ARRAY_SIZE(stack_clo);
+	stack_info.opts_size = sizeof(struct prog_args);
+	stack_info.rm_file = true;
+	stack_info.allow_poolset = true;
+	REGISTER_BENCHMARK(stack_info);
+}
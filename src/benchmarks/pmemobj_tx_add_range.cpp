@@ -47,6 +47,7 @@ struct ranged_obj {
 struct obj_bench_args {
 	uint64_t nranges;  /* number of allocated objects */
 	bool shuffle_objs; /* shuffles the array of allocated objects */
+	bool no_snapshot;  /* adds the ranges with POBJ_XADD_NO_SNAPSHOT */
 };
 
 /*
@@ -59,6 +60,7 @@ struct obj_bench {
 	uint64_t nranges;	   /* number of ranges */
 	uint64_t nallocs;	   /* number of allocations */
 	bool shuffle_objs;	   /* shuffles array of ranges */
+	bool no_snapshot;	   /* adds ranges with POBJ_XADD_NO_SNAPSHOT */
 	rng_t rng;		   /* PRNG */
 };
 
@@ -172,6 +174,7 @@ tx_add_range_init(struct benchmark *bench, struct benchmark_args *args)
 	ob->nranges = bargs->nranges;
 	ob->obj_size = args->dsize;
 	ob->shuffle_objs = bargs->shuffle_objs;
+	ob->no_snapshot = bargs->no_snapshot;
 	randomize_r(&ob->rng, args->seed);
 
 	if (init_ranges(ob))
@@ -201,7 +204,12 @@ tx_add_range_op(struct benchmark *bench, struct operation_info *info)
 	{
 		for (size_t i = 0; i < ob->nranges; i++) {
 			struct ranged_obj *r = &ob->ranges[i];
-			pmemobj_tx_add_range_direct(r->ptr, r->size);
+			if (ob->no_snapshot)
+				pmemobj_tx_xadd_range_direct(
+					r->ptr, r->size,
+					POBJ_XADD_NO_SNAPSHOT);
+			else
+				pmemobj_tx_add_range_direct(r->ptr, r->size);
 		}
 	}
 	TX_ONABORT
@@ -229,7 +237,7 @@ tx_add_range_exit(struct benchmark *bench, struct benchmark_args *args)
 	return 0;
 }
 
-static struct benchmark_clo tx_add_range_clo[2];
+static struct benchmark_clo tx_add_range_clo[3];
 
 /* Stores information about benchmark. */
 static struct benchmark_info tx_add_range_info;
@@ -260,6 +268,16 @@ tx_add_range_constructor(void)
 		clo_field_offset(struct obj_bench_args, shuffle_objs);
 	tx_add_range_clo[1].type = CLO_TYPE_FLAG;
 
+	tx_add_range_clo[2].opt_short = 0;
+	tx_add_range_clo[2].opt_long = "no-snapshot";
+	tx_add_range_clo[2].descr =
+		"Add the ranges with POBJ_XADD_NO_SNAPSHOT - "
+		"only write-only bookkeeping, no undo log";
+	tx_add_range_clo[2].def = "false";
+	tx_add_range_clo[2].off =
+		clo_field_offset(struct obj_bench_args, no_snapshot);
+	tx_add_range_clo[2].type = CLO_TYPE_FLAG;
+
 	tx_add_range_info.name = "pmemobj_tx_add_range";
 	tx_add_range_info.brief = "Benchmark for pmemobj_tx_add_range() "
 				  "operation";
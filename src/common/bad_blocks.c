@@ -14,6 +14,143 @@
 #include "core_assert.h"
 #include "vec.h"
 #include "os.h"
+#include "os_thread.h"
+#include "sys_util.h"
+#include "alloc.h"
+
+/*
+ * Cache of badblock scan results.  Enumerating bad blocks walks sysfs
+ * (or queries ndctl) for every part of every replica, which dominates
+ * the pool open time on multi-namespace machines.  The snapshot is keyed
+ * by the device unsafe shutdown count, so a cached result is reused only
+ * as long as the generation of the backing device has not changed.
+ * Clearing bad blocks drops the affected entry.
+ */
+struct bb_cache_entry {
+	struct bb_cache_entry *next;
+	char *file;
+	uint64_t usc;
+	struct badblocks bbs;
+};
+
+static struct bb_cache_entry *Bb_cache;
+static os_mutex_t Bb_cache_lock;
+static os_once_t Bb_cache_once = OS_ONCE_INIT;
+
+/*
+ * bb_cache_init -- (internal) initialize the badblock cache lock
+ */
+static void
+bb_cache_init(void)
+{
+	util_mutex_init(&Bb_cache_lock);
+}
+
+/*
+ * bb_cache_copy -- (internal) duplicate a badblocks array
+ *
+ * Returns -1 on allocation failure.
+ */
+static int
+bb_cache_copy(struct badblocks *dst, const struct badblocks *src)
+{
+	dst->bb_cnt = src->bb_cnt;
+	dst->bbv = NULL;
+
+	if (src->bb_cnt == 0)
+		return 0;
+
+	size_t size = src->bb_cnt * sizeof(*src->bbv);
+	dst->bbv = Malloc(size);
+	if (dst->bbv == NULL)
+		return -1;
+
+	memcpy(dst->bbv, src->bbv, size);
+	return 0;
+}
+
+/*
+ * bb_cache_lookup -- (internal) copy out a cached snapshot for the file,
+ * if one exists and the device generation still matches
+ *
+ * Returns 1 on a hit, 0 on a miss.
+ */
+static int
+bb_cache_lookup(const char *file, uint64_t usc, struct badblocks *bbs)
+{
+	os_once(&Bb_cache_once, bb_cache_init);
+
+	int hit = 0;
+
+	util_mutex_lock(&Bb_cache_lock);
+	for (struct bb_cache_entry *e = Bb_cache; e; e = e->next) {
+		if (e->usc == usc && strcmp(e->file, file) == 0) {
+			hit = (bb_cache_copy(bbs, &e->bbs) == 0);
+			break;
+		}
+	}
+	util_mutex_unlock(&Bb_cache_lock);
+
+	return hit;
+}
+
+/*
+ * bb_cache_drop -- (internal) remove the cached snapshot for the file
+ */
+static void
+bb_cache_drop(const char *file)
+{
+	os_once(&Bb_cache_once, bb_cache_init);
+
+	util_mutex_lock(&Bb_cache_lock);
+	struct bb_cache_entry **pe = &Bb_cache;
+	while (*pe) {
+		struct bb_cache_entry *e = *pe;
+		if (strcmp(e->file, file) == 0) {
+			*pe = e->next;
+			Free(e->bbs.bbv);
+			Free(e->file);
+			Free(e);
+		} else {
+			pe = &e->next;
+		}
+	}
+	util_mutex_unlock(&Bb_cache_lock);
+}
+
+/*
+ * bb_cache_store -- (internal) remember the scan result for the file
+ *
+ * Best effort - on allocation failure the result is simply not cached.
+ */
+static void
+bb_cache_store(const char *file, uint64_t usc, const struct badblocks *bbs)
+{
+	bb_cache_drop(file);
+
+	struct bb_cache_entry *e = Malloc(sizeof(*e));
+	if (e == NULL)
+		return;
+
+	e->file = Strdup(file);
+	if (e->file == NULL) {
+		Free(e);
+		return;
+	}
+
+	if (bb_cache_copy(&e->bbs, bbs)) {
+		Free(e->file);
+		Free(e);
+		return;
+	}
+
+	e->usc = usc;
+
+	util_mutex_lock(&Bb_cache_lock);
+	e->next = Bb_cache;
+	Bb_cache = e;
+	util_mutex_unlock(&Bb_cache_lock);
+}
 
 /*
  * badblocks_count -- returns number of bad blocks in the file
@@ -54,6 +191,8 @@ badblocks_get(const char *file, struct badblocks *bbs)
 	struct pmem2_badblock bb;
 	int bb_found = -1; /* -1 means an error */
 	int ret;
+	uint64_t usc = 0;
+	int have_usc = 0;
 
 	VEC(bbsvec, struct bad_block) bbv = VEC_INITIALIZER;
 	memset(bbs, 0, sizeof(*bbs));
@@ -68,6 +207,18 @@ badblocks_get(const char *file, struct badblocks *bbs)
 	if (ret)
 		goto exit_close;
 
+	/*
+	 * If the generation of the backing device is known, a cached
+	 * snapshot from the same generation makes the scan unnecessary.
+	 */
+	have_usc = (pmem2_source_device_usc(src, &usc) == 0);
+	if (have_usc && bb_cache_lookup(file, usc, bbs)) {
+		LOG(4, "using cached badblock snapshot -- '%s'", file);
+		pmem2_source_delete(&src);
+		os_close(fd);
+		return 0;
+	}
+
 	ret = pmem2_badblock_context_new(&bbctx, src);
 	if (ret)
 		goto exit_delete_source;
@@ -106,6 +257,9 @@ badblocks_get(const char *file, struct badblocks *bbs)
 		ASSERTeq((unsigned)bb_found, bbs->bb_cnt);
 	}
 
+	if (have_usc && bb_found >= 0)
+		bb_cache_store(file, usc, bbs);
+
 	pmem2_badblock_context_delete(&bbctx);
 
 exit_delete_source:
@@ -163,6 +317,9 @@ badblocks_clear(const char *file, struct badblocks *bbs)
 		}
 	}
 
+	/* the set of bad blocks just changed, forget the cached snapshot */
+	bb_cache_drop(file);
+
 exit_delete_ctx:
 	pmem2_badblock_context_delete(&bbctx);
 
@@ -219,6 +376,9 @@ badblocks_clear_all(const char *file)
 		}
 	};
 
+	/* the set of bad blocks just changed, forget the cached snapshot */
+	bb_cache_drop(file);
+
 exit_delete_ctx:
 	pmem2_badblock_context_delete(&bbctx);
 
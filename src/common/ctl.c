@@ -7,8 +7,11 @@
  */
 #include "ctl.h"
 #include "os.h"
+#include "os_thread.h"
+#include "sys_util.h"
 #include "alloc.h"
 #include "core_assert.h"
+#include "vec.h"
 
 #define CTL_MAX_ENTRIES 100
 
@@ -312,6 +315,171 @@ out:
 	return ret;
 }
 
+/*
+ * A compiled ctl query - stores the leaf resolved by ctl_find_node together
+ * with the index values parsed out of the name, so that repeated queries skip
+ * the string parsing and tree walk entirely.
+ */
+struct ctl_handle {
+	const struct ctl_node *node;
+	struct ctl_indexes indexes;
+};
+
+/*
+ * ctl_handle_new -- resolves the name into a reusable ctl query handle
+ */
+struct ctl_handle *
+ctl_handle_new(struct ctl *ctl, const char *name)
+{
+	LOG(3, "ctl %p name %s", ctl, name);
+
+	if (name == NULL) {
+		ERR_WO_ERRNO("invalid query");
+		errno = EINVAL;
+		return NULL;
+	}
+
+	struct ctl_handle *handle = Malloc(sizeof(*handle));
+	if (handle == NULL) {
+		ERR_W_ERRNO("Malloc");
+		return NULL;
+	}
+
+	PMDK_SLIST_INIT(&handle->indexes);
+
+	handle->node = ctl_find_node(CTL_NODE(global), name, &handle->indexes);
+
+	if (handle->node == NULL && ctl) {
+		ctl_delete_indexes(&handle->indexes);
+		handle->node = ctl_find_node(ctl->root, name, &handle->indexes);
+	}
+
+	if (handle->node == NULL || handle->node->type != CTL_NODE_LEAF) {
+		ERR_WO_ERRNO("invalid query entry point %s", name);
+		errno = EINVAL;
+		ctl_handle_delete(handle);
+		return NULL;
+	}
+
+	return handle;
+}
+
+/*
+ * ctl_handle_delete -- frees a compiled ctl query handle
+ */
+void
+ctl_handle_delete(struct ctl_handle *handle)
+{
+	ctl_delete_indexes(&handle->indexes);
+	Free(handle);
+}
+
+/*
+ * ctl_query_handle -- executes a previously compiled ctl query
+ */
+int
+ctl_query_handle(struct ctl_handle *handle, void *ctx,
+	enum ctl_query_source source, enum ctl_query_type type, void *arg)
+{
+	LOG(3, "handle %p ctx %p source %d type %d arg %p",
+			handle, ctx, source, type, arg);
+
+	const struct ctl_node *n = handle->node;
+
+	if (n->cb[type] == NULL) {
+		ERR_WO_ERRNO("invalid query type for entry point %s", n->name);
+		errno = EINVAL;
+		return -1;
+	}
+
+	return ctl_exec_query[type](ctx, n, source, arg, &handle->indexes);
+}
+
+/*
+ * The compiled configuration cache.
+ *
+ * The same PMEMOBJ_CONF string (or config file) is loaded once per pool
+ * open, so a process opening many pools parses the identical queries over
+ * and over. The cache stores the source string together with the compiled
+ * handle and the value of each of its queries; subsequent loads of the
+ * same string replay the handles and skip the parsing entirely.
+ *
+ * A compiled handle stays valid across pools: leaf nodes live in static
+ * per-module arrays and only the tree roots are per-pool, so a handle
+ * resolved while loading one pool points at the exact same leaf every
+ * other pool would resolve. Only loads with a pool-level tree are cached -
+ * the initial global load silently skips pool-only entry points and would
+ * seed an incomplete cache.
+ */
+struct ctl_cfg_entry {
+	struct ctl_handle *handle;
+	char *value;
+};
+
+static struct {
+	char *source;
+	VEC(, struct ctl_cfg_entry) entries;
+} Cfg_cache;
+
+static os_mutex_t Cfg_cache_lock;
+static os_once_t Cfg_cache_once = OS_ONCE_INIT;
+
+/*
+ * ctl_cfg_cache_init -- (internal) initializes the config cache lock
+ */
+static void
+ctl_cfg_cache_init(void)
+{
+	util_mutex_init(&Cfg_cache_lock);
+}
+
+/*
+ * ctl_cfg_cache_drop -- (internal) frees all cached queries
+ *
+ * Must be called with the cache lock held.
+ */
+static void
+ctl_cfg_cache_drop(void)
+{
+	struct ctl_cfg_entry *e;
+	VEC_FOREACH_BY_PTR(e, &Cfg_cache.entries) {
+		ctl_handle_delete(e->handle);
+		Free(e->value);
+	}
+	VEC_CLEAR(&Cfg_cache.entries);
+	Free(Cfg_cache.source);
+	Cfg_cache.source = NULL;
+}
+
+/*
+ * ctl_cfg_cache_replay -- (internal) re-executes the cached queries
+ *
+ * Must be called with the cache lock held. The cached value strings are
+ * duplicated for each replay because config-input argument parsing
+ * tokenizes its input in place.
+ */
+static int
+ctl_cfg_cache_replay(void *ctx)
+{
+	struct ctl_cfg_entry *e;
+	VEC_FOREACH_BY_PTR(e, &Cfg_cache.entries) {
+		char *value = Strdup(e->value);
+		if (value == NULL) {
+			ERR_W_ERRNO("Strdup");
+			return -1;
+		}
+
+		int r = ctl_query_handle(e->handle, ctx,
+			CTL_QUERY_CONFIG_INPUT, CTL_QUERY_WRITE, value);
+		Free(value);
+
+		if (r < 0 && ctx != NULL)
+			return -1;
+	}
+
+	return 0;
+}
+
 /*
  * ctl_register_module_node -- adds a new node to the CTL tree root.
  */
@@ -356,6 +524,10 @@ ctl_parse_query(char *qbuf, char **name, char **value)
 
 /*
  * ctl_load_config -- executes the entire query collection from a provider
+ *
+ * Loads against a pool-level tree are compiled into the config cache, so
+ * that repeated loads of the same configuration string replay the compiled
+ * queries instead of parsing the string again.
  */
 static int
 ctl_load_config(struct ctl *ctl, void *ctx, char *buf)
@@ -364,27 +536,86 @@ ctl_load_config(struct ctl *ctl, void *ctx, char *buf)
 	char *sptr = NULL; /* for internal use of strtok */
 	char *name;
 	char *value;
+	char *source = NULL;
+	int cached = 0;
 
 	ASSERTne(buf, NULL);
 
+	if (ctl != NULL) {
+		os_once(&Cfg_cache_once, ctl_cfg_cache_init);
+		util_mutex_lock(&Cfg_cache_lock);
+
+		if (Cfg_cache.source != NULL &&
+		    strcmp(Cfg_cache.source, buf) == 0) {
+			r = ctl_cfg_cache_replay(ctx);
+			util_mutex_unlock(&Cfg_cache_lock);
+			return r;
+		}
+
+		/* a different string - recompile the cache as we parse */
+		ctl_cfg_cache_drop();
+		source = Strdup(buf); /* tokenizing mangles buf */
+		if (source != NULL)
+			cached = 1;
+		else
+			util_mutex_unlock(&Cfg_cache_lock);
+	}
+
 	char *qbuf = strtok_r(buf, CTL_STRING_QUERY_SEPARATOR, &sptr);
 	while (qbuf != NULL) {
 		r = ctl_parse_query(qbuf, &name, &value);
 		if (r != 0) {
 			ERR_WO_ERRNO("failed to parse query %s", qbuf);
-			return -1;
+			goto error;
 		}
 
-		r = ctl_query(ctl, ctx, CTL_QUERY_CONFIG_INPUT,
-				name, CTL_QUERY_WRITE, value);
+		if (cached) {
+			struct ctl_cfg_entry e;
+			e.handle = ctl_handle_new(ctl, name);
+			if (e.handle == NULL)
+				goto error;
+
+			e.value = Strdup(value);
+			if (e.value == NULL) {
+				ERR_W_ERRNO("Strdup");
+				ctl_handle_delete(e.handle);
+				goto error;
+			}
+
+			if (VEC_PUSH_BACK(&Cfg_cache.entries, e) != 0) {
+				ctl_handle_delete(e.handle);
+				Free(e.value);
+				goto error;
+			}
+
+			r = ctl_query_handle(e.handle, ctx,
+				CTL_QUERY_CONFIG_INPUT, CTL_QUERY_WRITE,
+				value);
+		} else {
+			r = ctl_query(ctl, ctx, CTL_QUERY_CONFIG_INPUT,
+					name, CTL_QUERY_WRITE, value);
+		}
 
 		if (r < 0 && ctx != NULL)
-			return -1;
+			goto error;
 
 		qbuf = strtok_r(NULL, CTL_STRING_QUERY_SEPARATOR, &sptr);
 	}
 
+	if (cached) {
+		Cfg_cache.source = source;
+		util_mutex_unlock(&Cfg_cache_lock);
+	}
+
 	return 0;
+
+error:
+	if (cached) {
+		ctl_cfg_cache_drop();
+		Free(source);
+		util_mutex_unlock(&Cfg_cache_lock);
+	}
+	return -1;
 }
 
 /*
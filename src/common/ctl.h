@@ -134,6 +134,19 @@ ctl_node_##__VA_ARGS__##_##name
 int ctl_query(struct ctl *ctl, void *ctx, enum ctl_query_source source,
 		const char *name, enum ctl_query_type type, void *arg);
 
+/*
+ * A compiled ctl query handle. The dotted entry point name is resolved to a
+ * leaf node exactly once, and the handle can then be executed any number of
+ * times without re-parsing the name or walking the tree.
+ */
+struct ctl_handle;
+
+struct ctl_handle *ctl_handle_new(struct ctl *ctl, const char *name);
+void ctl_handle_delete(struct ctl_handle *handle);
+int ctl_query_handle(struct ctl_handle *handle, void *ctx,
+		enum ctl_query_source source, enum ctl_query_type type,
+		void *arg);
+
 /* Declaration of a new child node */
 #define CTL_CHILD(name, ...)\
 {CTL_STR(name), CTL_NODE_NAMED, {NULL, NULL, NULL}, NULL,\
@@ -186,9 +199,10 @@ ctl_arg_##name
  * Declaration of a new read-write leaf. If used both read and write function
  * must be declared by CTL_READ_HANDLER and CTL_WRITE_HANDLER macros.
  */
-#define CTL_LEAF_RW(name)\
+#define CTL_LEAF_RW(name, ...)\
 {CTL_STR(name), CTL_NODE_LEAF,\
-	{CTL_READ_HANDLER(name), CTL_WRITE_HANDLER(name), NULL},\
+	{CTL_READ_HANDLER(name, __VA_ARGS__),\
+	CTL_WRITE_HANDLER(name, __VA_ARGS__), NULL},\
 	&CTL_ARG(name), NULL}
 
 #define CTL_REGISTER_MODULE(_ctl, name)\
@@ -16,6 +16,8 @@ extern void ctl_prefault_register(void);
 extern void ctl_sds_register(void);
 extern void ctl_fallocate_register(void);
 extern void ctl_cow_register(void);
+extern void ctl_thp_register(void);
+extern void ctl_resctrl_register(void);
 
 static inline void
 ctl_global_register(void)
@@ -24,6 +26,8 @@ ctl_global_register(void)
 	ctl_sds_register();
 	ctl_fallocate_register();
 	ctl_cow_register();
+	ctl_thp_register();
+	ctl_resctrl_register();
 }
 
 #ifdef __cplusplus
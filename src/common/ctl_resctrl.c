@@ -0,0 +1,275 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2026, Intel Corporation */
+
+/*
+ * ctl_resctrl.c -- implementation of the cache.resctrl CTL namespace
+ *
+ * See resctrl.h for the overview. The CLOS assignment works by writing the
+ * thread id into the tasks file of the configured resctrl group before a
+ * qualifying copy and into the tasks file of the parent group (the default
+ * class of service) after it. Both files are opened once, when the group
+ * is configured, so a qualifying copy costs two write() calls - which is
+ * why only copies of at least cache.resctrl.threshold bytes take the
+ * assignment.
+ *
+ * Reconfiguring or disabling while copies are in flight is benign: a
+ * thread that loses the race stays in the group it is in until its next
+ * qualifying copy. The file descriptors of a replaced group are closed
+ * only after the new ones are published.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "ctl.h"
+#include "os.h"
+#include "out.h"
+#include "core_assert.h"
+#include "resctrl.h"
+#include "ctl_global.h"
+
+int Resctrl_active;
+
+#define RESCTRL_DEFAULT_THRESHOLD (1 << 16)
+
+static char Resctrl_group[PATH_MAX];
+static long long Resctrl_threshold = RESCTRL_DEFAULT_THRESHOLD;
+static int Group_tasks_fd = -1;
+static int Default_tasks_fd = -1;
+
+/* nonzero while the calling thread runs under the restricted group */
+static __thread int Resctrl_entered;
+
+/*
+ * resctrl_write_tid -- (internal) assigns the calling thread to the resctrl
+ *	group behind the given tasks file descriptor
+ */
+static int
+resctrl_write_tid(int fd)
+{
+	char buf[32];
+	int len = util_snprintf(buf, sizeof(buf), "%ld",
+		(long)syscall(SYS_gettid));
+	if (len < 0)
+		return -1;
+
+	return write(fd, buf, (size_t)len) == len ? 0 : -1;
+}
+
+/*
+ * resctrl_enter -- moves the calling thread into the restricted group if the
+ *	copy is large enough to warrant it
+ *
+ * Returns 1 when the thread was moved and resctrl_exit() must follow the
+ * copy, 0 otherwise.
+ */
+int
+resctrl_enter(size_t len)
+{
+	if (!Resctrl_active || len < (size_t)Resctrl_threshold)
+		return 0;
+
+	/* a qualifying copy nested in another one is already confined */
+	if (Resctrl_entered)
+		return 0;
+
+	if (resctrl_write_tid(Group_tasks_fd) != 0)
+		return 0;
+
+	Resctrl_entered = 1;
+
+	return 1;
+}
+
+/*
+ * resctrl_exit -- moves the calling thread back to the default group
+ */
+void
+resctrl_exit(void)
+{
+	(void) resctrl_write_tid(Default_tasks_fd);
+
+	Resctrl_entered = 0;
+}
+
+/*
+ * resctrl_group_set -- (internal) configures and activates a resctrl group
+ */
+static int
+resctrl_group_set(const char *path)
+{
+	char tasks[PATH_MAX];
+
+	if (util_snprintf(tasks, sizeof(tasks), "%s/tasks", path) < 0) {
+		ERR_W_ERRNO("snprintf");
+		return -1;
+	}
+
+	int gfd = os_open(tasks, O_WRONLY);
+	if (gfd < 0) {
+		ERR_W_ERRNO("open %s", tasks);
+		return -1;
+	}
+
+	/*
+	 * Threads leaving the partition go to the default class of service,
+	 * which is the parent resctrl group.
+	 */
+	char parent[PATH_MAX];
+	strncpy(parent, path, sizeof(parent) - 1);
+	parent[sizeof(parent) - 1] = '\0';
+	char *last = strrchr(parent, '/');
+	if (last == NULL || last == parent) {
+		ERR_WO_ERRNO("invalid resctrl group path %s", path);
+		errno = EINVAL;
+		os_close(gfd);
+		return -1;
+	}
+	*last = '\0';
+	if (util_snprintf(tasks, sizeof(tasks), "%s/tasks", parent) < 0) {
+		ERR_W_ERRNO("snprintf");
+		os_close(gfd);
+		return -1;
+	}
+
+	int dfd = os_open(tasks, O_WRONLY);
+	if (dfd < 0) {
+		ERR_W_ERRNO("open %s", tasks);
+		os_close(gfd);
+		return -1;
+	}
+
+	int old_gfd = Group_tasks_fd;
+	int old_dfd = Default_tasks_fd;
+
+	strncpy(Resctrl_group, path, sizeof(Resctrl_group) - 1);
+	Resctrl_group[sizeof(Resctrl_group) - 1] = '\0';
+	Group_tasks_fd = gfd;
+	Default_tasks_fd = dfd;
+	Resctrl_active = 1;
+
+	if (old_gfd >= 0)
+		os_close(old_gfd);
+	if (old_dfd >= 0)
+		os_close(old_dfd);
+
+	LOG(3, "internal copies >= %lld bytes confined to %s",
+		Resctrl_threshold, Resctrl_group);
+
+	return 0;
+}
+
+static int
+CTL_READ_HANDLER(group)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(ctx, source, indexes);
+
+	/* the argument must be a buffer of at least PATH_MAX bytes */
+	strncpy(arg, Resctrl_group, PATH_MAX);
+
+	return 0;
+}
+
+static int
+CTL_WRITE_HANDLER(group)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(ctx, source, indexes);
+
+	return resctrl_group_set(arg);
+}
+
+static int
+CTL_READ_HANDLER(threshold)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(ctx, source, indexes);
+
+	long long *arg_out = arg;
+	*arg_out = Resctrl_threshold;
+
+	return 0;
+}
+
+static int
+CTL_WRITE_HANDLER(threshold)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(ctx, source, indexes);
+
+	long long arg_in = *(long long *)arg;
+	if (arg_in <= 0) {
+		ERR_WO_ERRNO("invalid threshold %lld", arg_in);
+		errno = EINVAL;
+		return -1;
+	}
+
+	Resctrl_threshold = arg_in;
+
+	return 0;
+}
+
+static int
+CTL_READ_HANDLER(enabled)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(ctx, source, indexes);
+
+	int *arg_out = arg;
+	*arg_out = Resctrl_active;
+
+	return 0;
+}
+
+static int
+CTL_WRITE_HANDLER(enabled)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(ctx, source, indexes);
+
+	int arg_in = *(int *)arg;
+	if (arg_in && Group_tasks_fd < 0) {
+		ERR_WO_ERRNO("no resctrl group configured");
+		errno = EINVAL;
+		return -1;
+	}
+
+	Resctrl_active = arg_in;
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(group) = CTL_ARG_STRING(PATH_MAX);
+static const struct ctl_argument CTL_ARG(threshold) = CTL_ARG_LONG_LONG;
+static const struct ctl_argument CTL_ARG(enabled) = CTL_ARG_BOOLEAN;
+
+static const struct ctl_node CTL_NODE(resctrl)[] = {
+	CTL_LEAF_RW(group),
+	CTL_LEAF_RW(threshold),
+	CTL_LEAF_RW(enabled),
+
+	CTL_NODE_END
+};
+
+static const struct ctl_node CTL_NODE(cache)[] = {
+	CTL_CHILD(resctrl),
+
+	CTL_NODE_END
+};
+
+void
+ctl_resctrl_register(void)
+{
+	CTL_REGISTER_MODULE(NULL, cache);
+}
@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2026, Intel Corporation */
+
+/*
+ * ctl_thp.c -- implementation of the thp CTL namespace
+ */
+
+#include "ctl.h"
+#include "out.h"
+#include "ctl_global.h"
+#include "mmap.h"
+
+static int
+CTL_READ_HANDLER(at_map)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(ctx, source, indexes);
+
+	int *arg_out = arg;
+	*arg_out = Thp_at_map;
+
+	return 0;
+}
+
+static int
+CTL_WRITE_HANDLER(at_map)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(ctx, source, indexes);
+
+	int arg_in = *(int *)arg;
+	Thp_at_map = arg_in;
+
+	return 0;
+}
+
+static struct ctl_argument CTL_ARG(at_map) = CTL_ARG_BOOLEAN;
+
+static const struct ctl_node CTL_NODE(thp)[] = {
+	CTL_LEAF_RW(at_map),
+
+	CTL_NODE_END
+};
+
+void
+ctl_thp_register(void)
+{
+	CTL_REGISTER_MODULE(NULL, thp);
+}
@@ -25,6 +25,13 @@
 
 #define DEVICE_DAX_ZERO_LEN (2 * MEGABYTE)
 
+/*
+ * Controls whether newly created pool files are preallocated; disabled via
+ * the fallocate.at_create ctl when the underlying device is known to be
+ * zeroed already and provisioning time matters.
+ */
+int Fallocate_at_create = 1;
+
 /*
  * util_file_exists -- checks whether file exists
  */
@@ -431,9 +438,21 @@ util_file_create(const char *path, size_t size, size_t minsize)
 		return -1;
 	}
 
-	if ((errno = os_posix_fallocate(fd, 0, (os_off_t)size)) != 0) {
-		ERR_W_ERRNO("posix_fallocate \"%s\", %zu", path, size);
-		goto err;
+	if (Fallocate_at_create) {
+		if ((errno = os_posix_fallocate(fd, 0, (os_off_t)size)) != 0) {
+			ERR_W_ERRNO("posix_fallocate \"%s\", %zu", path, size);
+			goto err;
+		}
+	} else {
+		/*
+		 * The caller vouches for the underlying device being
+		 * zeroed already - just set the file size and skip the
+		 * potentially very expensive block preallocation.
+		 */
+		if (os_ftruncate(fd, (os_off_t)size) != 0) {
+			ERR_W_ERRNO("ftruncate \"%s\", %zu", path, size);
+			goto err;
+		}
 	}
 
 	if (os_flock(fd, OS_LOCK_EX | OS_LOCK_NB) < 0) {
@@ -50,6 +50,7 @@ ssize_t util_fd_get_size(int fd);
 size_t util_file_device_dax_alignment(const char *path);
 void *util_file_map_whole(const char *path);
 int util_file_zero(const char *path, os_off_t off, size_t len);
+int util_file_punch_hole(const char *path, os_off_t off, size_t len);
 ssize_t util_file_pread(const char *path, void *buffer, size_t size,
 	os_off_t offset);
 ssize_t util_file_pwrite(const char *path, const void *buffer, size_t size,
@@ -57,6 +58,8 @@ ssize_t util_file_pwrite(const char *path, const void *buffer, size_t size,
 
 int util_is_absolute_path(const char *path);
 
+extern int Fallocate_at_create;
+
 int util_file_create(const char *path, size_t size, size_t minsize);
 int util_file_open(const char *path, size_t *size, size_t minsize, int flags);
 int util_unlink(const char *path);
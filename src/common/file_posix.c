@@ -132,6 +132,46 @@ end:
 	return size;
 }
 
+/*
+ * util_file_punch_hole -- returns the specified region of the file
+ *	to the filesystem
+ *
+ * The file length is not changed, the deallocated region reads as zeros.
+ */
+int
+util_file_punch_hole(const char *path, os_off_t off, size_t len)
+{
+	LOG(3, "path \"%s\" off %ju len %zu", path, off, len);
+
+	enum file_type type = util_file_get_type(path);
+	if (type < 0)
+		return -1;
+
+	if (type == TYPE_DEVDAX) {
+		/* Device DAX has no filesystem to return the space to */
+		errno = ENOTSUP;
+		ERR_W_ERRNO("punch hole \"%s\"", path);
+		return -1;
+	}
+
+	int fd = os_open(path, O_RDWR);
+	if (fd < 0) {
+		ERR_W_ERRNO("open \"%s\"", path);
+		return -1;
+	}
+
+	int ret = fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+		off, (os_off_t)len);
+	if (ret < 0)
+		ERR_W_ERRNO("fallocate \"%s\"", path);
+
+	int olderrno = errno;
+	(void) os_close(fd);
+	errno = olderrno;
+
+	return ret;
+}
+
 /*
  * util_file_device_dax_alignment -- returns internal Device DAX alignment
  */
@@ -8,6 +8,7 @@
 #include <errno.h>
 #include <inttypes.h>
 #include <fcntl.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
@@ -23,6 +24,7 @@
 
 int Mmap_no_random;
 void *Mmap_hint;
+int Thp_at_map = 1;
 static os_rwlock_t Mmap_list_lock;
 
 static PMDK_SORTEDQ_HEAD(map_list_head, map_tracker) Mmap_list =
@@ -105,6 +107,15 @@ util_map(int fd, os_off_t off, size_t len, int flags, int rdonly,
 		return NULL;
 	}
 
+	/*
+	 * The mappings are 2MB-aligned (see util_map_hint_align()), so ask
+	 * the kernel to back them with huge pages.  This is just a hint and
+	 * the failure (e.g. Device DAX, where the page size is a property
+	 * of the device itself) is not fatal.
+	 */
+	if (Thp_at_map)
+		(void) util_range_hugepage_advise(base, len);
+
 	LOG(3, "mapped at %p", base);
 
 	return base;
@@ -215,6 +226,198 @@ util_range_none(void *addr, size_t len)
 	return retval;
 }
 
+/*
+ * util_range_advise -- give the kernel an advice about the expected use of
+ *	a memory range
+ */
+int
+util_range_advise(void *addr, size_t len, int advice)
+{
+	LOG(3, "addr %p len %zu advice %d", addr, len, advice);
+
+	uintptr_t uptr;
+	int retval;
+
+	/*
+	 * madvise requires addr to be a multiple of pagesize, so
+	 * adjust addr and len to represent the full 4k chunks
+	 * covering the given range.
+	 */
+
+	/* increase len by the amount we gain when we round addr down */
+	len += (uintptr_t)addr & (Pagesize - 1);
+
+	/* round addr down to page boundary */
+	uptr = (uintptr_t)addr & ~(Pagesize - 1);
+
+	if ((retval = madvise((void *)uptr, len, advice)) < 0)
+		ERR_W_ERRNO("madvise: %d", advice);
+
+	return retval;
+}
+
+/*
+ * util_range_hugepage_interior -- (internal) shrinks the range to the part
+ *	that is aligned to the huge page size
+ */
+static int
+util_range_hugepage_interior(void *addr, size_t len, uintptr_t *beg,
+	uintptr_t *end)
+{
+	*beg = ((uintptr_t)addr + 2 * MEGABYTE - 1) & ~(2 * MEGABYTE - 1);
+	*end = ((uintptr_t)addr + len) & ~(2 * MEGABYTE - 1);
+
+	return *beg < *end ? 0 : -1;
+}
+
+/*
+ * util_range_hugepage_advise -- advise the kernel to back the huge-page
+ *	aligned part of a memory range with transparent huge pages
+ *
+ * This is only a hint, so the failure is merely logged and not reported
+ * to the caller with errno.
+ */
+int
+util_range_hugepage_advise(void *addr, size_t len)
+{
+	LOG(3, "addr %p len %zu", addr, len);
+
+	uintptr_t beg;
+	uintptr_t end;
+	if (util_range_hugepage_interior(addr, len, &beg, &end) != 0)
+		return 0;
+
+	if (madvise((void *)beg, end - beg, MADV_HUGEPAGE) < 0) {
+		LOG(4, "!madvise: MADV_HUGEPAGE");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * util_range_hugepage_repair -- collapse the huge-page aligned part of
+ *	a memory range back into huge page mappings
+ *
+ * Memory pressure can split a huge page mapping into base pages and the
+ * kernel never reassembles it on its own.  This asks for a synchronous
+ * collapse (MADV_COLLAPSE), so it's best called during quiet periods.
+ */
+int
+util_range_hugepage_repair(void *addr, size_t len)
+{
+	LOG(3, "addr %p len %zu", addr, len);
+
+	uintptr_t beg;
+	uintptr_t end;
+	if (util_range_hugepage_interior(addr, len, &beg, &end) != 0)
+		return 0;
+
+	if (madvise((void *)beg, end - beg, MADV_COLLAPSE) < 0) {
+		ERR_W_ERRNO("madvise: MADV_COLLAPSE");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * util_range_hugepages -- count the bytes of a memory range that are
+ *	currently mapped with huge pages
+ *
+ * The granularity of /proc/self/smaps is a single mapping, so the result
+ * includes the huge pages of every mapping the range overlaps.
+ */
+int
+util_range_hugepages(const void *addr, size_t len, size_t *hugepage)
+{
+	LOG(3, "addr %p len %zu hugepage %p", addr, len, hugepage);
+
+	uintptr_t start = (uintptr_t)addr;
+	uintptr_t end = start + len;
+
+	FILE *fp = os_fopen("/proc/self/smaps", "r");
+	if (fp == NULL) {
+		ERR_W_ERRNO("fopen \"/proc/self/smaps\"");
+		return -1;
+	}
+
+	char line[256];
+	size_t total = 0;
+	int overlaps = 0;
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		uintptr_t mstart;
+		uintptr_t mend;
+		size_t kb;
+
+		if (sscanf(line, "%" SCNxPTR "-%" SCNxPTR " ",
+				&mstart, &mend) == 2) {
+			overlaps = mstart < end && mend > start;
+			continue;
+		}
+
+		if (!overlaps)
+			continue;
+
+		if (sscanf(line, "AnonHugePages: %zu kB", &kb) == 1 ||
+		    sscanf(line, "ShmemPmdMapped: %zu kB", &kb) == 1 ||
+		    sscanf(line, "FilePmdMapped: %zu kB", &kb) == 1)
+			total += kb * KILOBYTE;
+	}
+
+	fclose(fp);
+
+	*hugepage = total;
+
+	return 0;
+}
+
+/*
+ * The number of pages counted per mincore call; bounds the size of the
+ * residency vector while keeping the number of syscalls per range low.
+ */
+#define RESIDENT_VEC_LEN 4096
+
+/*
+ * util_range_resident -- count the bytes of a memory range that are resident
+ *	in physical memory
+ */
+int
+util_range_resident(void *addr, size_t len, size_t *resident)
+{
+	LOG(3, "addr %p len %zu resident %p", addr, len, resident);
+
+	/* adjust addr and len to represent the full pages covering the range */
+	len += (uintptr_t)addr & (Pagesize - 1);
+	uintptr_t uptr = (uintptr_t)addr & ~(Pagesize - 1);
+
+	unsigned char vec[RESIDENT_VEC_LEN];
+	size_t npages = 0;
+
+	while (len > 0) {
+		size_t chunk = RESIDENT_VEC_LEN * Pagesize;
+		if (chunk > len)
+			chunk = len;
+
+		if (mincore((void *)uptr, chunk, vec) < 0) {
+			ERR_W_ERRNO("mincore");
+			return -1;
+		}
+
+		size_t n = (chunk + Pagesize - 1) / Pagesize;
+		for (size_t i = 0; i < n; ++i)
+			npages += vec[i] & 1;
+
+		uptr += chunk;
+		len -= chunk;
+	}
+
+	*resident = npages * Pagesize;
+
+	return 0;
+}
+
 /*
  * util_range_comparer -- (internal) compares the two mapping trackers
  */
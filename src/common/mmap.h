@@ -26,6 +26,7 @@ extern "C" {
 extern int Mmap_no_random;
 extern void *Mmap_hint;
 extern char *Mmap_mapfile;
+extern int Thp_at_map;
 
 void *util_map_sync(void *addr, size_t len, int proto, int flags, int fd,
 	os_off_t offset, int *map_sync);
@@ -43,6 +44,18 @@ int util_unmap(void *addr, size_t len);
 #define MAP_SHARED_VALIDATE 0x03
 #endif
 
+#ifndef MADV_COLD
+#define MADV_COLD 20
+#endif
+
+#ifndef MADV_PAGEOUT
+#define MADV_PAGEOUT 21
+#endif
+
+#ifndef MADV_COLLAPSE
+#define MADV_COLLAPSE 25
+#endif
+
 /*
  * macros for micromanaging range protections for the debug version
  */
@@ -87,6 +100,11 @@ void util_mmap_fini(void);
 int util_range_ro(void *addr, size_t len);
 int util_range_rw(void *addr, size_t len);
 int util_range_none(void *addr, size_t len);
+int util_range_advise(void *addr, size_t len, int advice);
+int util_range_resident(void *addr, size_t len, size_t *resident);
+int util_range_hugepage_advise(void *addr, size_t len);
+int util_range_hugepage_repair(void *addr, size_t len);
+int util_range_hugepages(const void *addr, size_t len, size_t *hugepage);
 
 char *util_map_hint_unused(void *minaddr, size_t len, size_t align);
 char *util_map_hint(size_t len, size_t req_align);
@@ -277,6 +277,7 @@ static const features_t feature_2_pmempool_feature_map[] = {
 	FEAT_INCOMPAT(CKSUM_2K),	/* PMEMPOOL_FEAT_CKSUM_2K */
 	FEAT_INCOMPAT(SDS),		/* PMEMPOOL_FEAT_SHUTDOWN_STATE */
 	FEAT_COMPAT(CHECK_BAD_BLOCKS),	/* PMEMPOOL_FEAT_CHECK_BAD_BLOCKS */
+	FEAT_COMPAT(PART_GROW),		/* PMEMPOOL_FEAT_PART_GROW */
 };
 
 #define FEAT_2_PMEMPOOL_FEATURE_MAP_SIZE \
@@ -287,6 +288,7 @@ static const char *str_2_pmempool_feature_map[] = {
 	"CKSUM_2K",
 	"SHUTDOWN_STATE",
 	"CHECK_BAD_BLOCKS",
+	"PART_GROW",
 };
 
 #define PMEMPOOL_FEATURE_2_STR_MAP_SIZE ARRAY_SIZE(str_2_pmempool_feature_map)
@@ -177,9 +177,10 @@ static const features_t features_zero =
  * compat features
  */
 #define POOL_FEAT_CHECK_BAD_BLOCKS	0x0001U	/* check bad blocks in a pool */
+#define POOL_FEAT_PART_GROW		0x0002U	/* grow part files on demand */
 
 #define POOL_FEAT_COMPAT_ALL \
-	(POOL_FEAT_CHECK_BAD_BLOCKS)
+	(POOL_FEAT_CHECK_BAD_BLOCKS | POOL_FEAT_PART_GROW)
 
 #define FEAT_COMPAT(X) \
 	{POOL_FEAT_##X, POOL_FEAT_ZERO, POOL_FEAT_ZERO}
@@ -204,7 +205,7 @@ static const features_t features_zero =
 #endif
 
 #define POOL_FEAT_COMPAT_VALID \
-	(POOL_FEAT_CHECK_BAD_BLOCKS)
+	(POOL_FEAT_CHECK_BAD_BLOCKS | POOL_FEAT_PART_GROW)
 
 #define POOL_FEAT_INCOMPAT_VALID \
 	(POOL_FEAT_SINGLEHDR | POOL_FEAT_CKSUM_2K | POOL_E_FEAT_SDS)
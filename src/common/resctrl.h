@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright 2026, Intel Corporation */
+
+/*
+ * resctrl.h -- opt-in CPU cache partitioning for heavy internal copies
+ *
+ * Once a resctrl group (an Intel CAT class of service exposed through the
+ * kernel resctrl filesystem) is configured via the cache.resctrl ctl
+ * namespace, a thread issuing an internal copy of at least the configured
+ * threshold is moved into that group for the duration of the copy and back
+ * to the default group afterwards. The flush traffic of such copies then
+ * competes for cache ways only within its partition instead of evicting
+ * the application's working set. Everything is off, and the fast-path cost
+ * is a single global load, until a group is configured.
+ */
+
+#ifndef PMDK_RESCTRL_H
+#define PMDK_RESCTRL_H 1
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int Resctrl_active;
+
+int resctrl_enter(size_t len);
+void resctrl_exit(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -70,9 +70,19 @@
 #include "fs.h"
 #include "os_deep.h"
 #include "set_badblocks.h"
+#include "../libpmem2/usc.h"
 
 #define SIZE_AUTODETECT_STR "AUTO"
 
+/*
+ * Kernels older than 4.17 do not know MAP_FIXED_NOREPLACE; with the flag
+ * expanding to 0 the address is a plain hint and landing elsewhere is
+ * detected after the fact.
+ */
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0
+#endif
+
 #define PMEM_EXT ".pmem"
 #define PMEM_EXT_LEN sizeof(PMEM_EXT)
 #define PMEM_FILE_PADDING 6
@@ -82,7 +92,6 @@
 int Prefault_at_open = 0;
 int Prefault_at_create = 0;
 int SDS_at_create = POOL_FEAT_INCOMPAT_DEFAULT & POOL_E_FEAT_SDS ? 1 : 0;
-int Fallocate_at_create = 1;
 int COW_at_open = 0;
 
 /* list of pool set option names and flags */
@@ -1533,25 +1542,107 @@ util_part_fdclose(struct pool_set_part *part)
 	}
 }
 
+/*
+ * part_open_args -- (internal) arguments for the part opening worker thread
+ */
+struct part_open_args {
+	struct pool_set_part *part;
+	size_t minsize;
+	int create;
+	int started;
+	int ret;
+	int oerrno;
+};
+
+/*
+ * util_part_open_worker -- (internal) opens a single part file in a worker
+ *	thread
+ */
+static void *
+util_part_open_worker(void *arg)
+{
+	struct part_open_args *args = arg;
+
+	args->ret = util_part_open(args->part, args->minsize, args->create);
+	if (args->ret != 0)
+		args->oerrno = errno;
+
+	return NULL;
+}
+
 /*
  * util_poolset_files_local -- (internal) open or create all the local
  *                              part files of a pool set and replica sets
+ *
+ * When parts are created, the block preallocation dominates the pool
+ * creation time, so the part files are initialized in parallel, striped
+ * one worker thread per part.
  */
 static int
 util_poolset_files_local(struct pool_set *set, size_t minpartsize, int create)
 {
 	LOG(3, "set %p minpartsize %zu create %d", set, minpartsize, create);
 
+	unsigned nparts = 0;
+	for (unsigned r = 0; r < set->nreplicas; r++)
+		nparts += set->replica[r]->nparts;
+
+	if (!create || nparts < 2) {
+		for (unsigned r = 0; r < set->nreplicas; r++) {
+			struct pool_replica *rep = set->replica[r];
+			for (unsigned p = 0; p < rep->nparts; p++) {
+				if (util_part_open(&rep->part[p], minpartsize,
+						create))
+					return -1;
+			}
+		}
+
+		return 0;
+	}
+
+	struct part_open_args *args = Zalloc(nparts * sizeof(*args));
+	os_thread_t *threads = Malloc(nparts * sizeof(*threads));
+	if (args == NULL || threads == NULL) {
+		Free(args);
+		Free(threads);
+		return -1;
+	}
+
+	int ret = 0;
+	unsigned i = 0;
 	for (unsigned r = 0; r < set->nreplicas; r++) {
 		struct pool_replica *rep = set->replica[r];
-		for (unsigned p = 0; p < rep->nparts; p++) {
-			if (util_part_open(&rep->part[p], minpartsize,
-					create))
-				return -1;
+		for (unsigned p = 0; p < rep->nparts; p++, i++) {
+			struct part_open_args *a = &args[i];
+			a->part = &rep->part[p];
+			a->minsize = minpartsize;
+			a->create = create;
+
+			a->started = os_thread_create(&threads[i], NULL,
+				util_part_open_worker, a) == 0;
+			if (!a->started) {
+				/* fall back to opening the part in place */
+				util_part_open_worker(a);
+			}
 		}
 	}
 
-	return 0;
+	for (i = 0; i < nparts; i++)
+		if (args[i].started)
+			os_thread_join(&threads[i], NULL);
+
+	for (i = 0; i < nparts; i++) {
+		if (args[i].ret != 0) {
+			errno = args[i].oerrno;
+			ret = -1;
+			break;
+		}
+	}
+
+	Free(args);
+	Free(threads);
+
+	return ret;
 }
 
 /*
@@ -1771,12 +1862,19 @@ util_header_create(struct pool_set *set, unsigned repidx, unsigned partidx,
 	}
 
 	if (!set->ignore_sds && partidx == 0) {
+		/* one device context walk serves all parts of the replica */
+		struct pmem2_usc_ctx *usc_ctx = NULL;
+		(void) pmem2_usc_ctx_new(&usc_ctx);
+
 		shutdown_state_init(&hdrp->sds, rep);
 		for (unsigned p = 0; p < rep->nparts; p++) {
-			if (shutdown_state_add_part(&hdrp->sds,
-					PART(rep, p)->fd, rep))
+			if (shutdown_state_add_part(&hdrp->sds, usc_ctx,
+					PART(rep, p)->fd, rep)) {
+				pmem2_usc_ctx_delete(&usc_ctx);
 				return -1;
+			}
 		}
+		pmem2_usc_ctx_delete(&usc_ctx);
 		shutdown_state_set_dirty(&hdrp->sds, rep);
 	}
 
@@ -1910,6 +2008,53 @@ util_header_check(struct pool_set *set, unsigned repidx, unsigned partidx,
 	return 0;
 }
 
+/*
+ * util_header_check_trusted -- (internal) reduced validation of a single
+ * pool set file header
+ *
+ * Used by the trusted open fast path.  Part #0 of every replica is always
+ * fully validated, so the signature, versions, features and replica
+ * linkage have been vetted; the remaining parts only need proof that
+ * their headers were not torn or overwritten, which the stored header
+ * checksum provides.  Any divergence that the full check would catch
+ * (foreign part, stale uuid links) implies a header rewritten outside of
+ * this library and so a checksum computed over different content.
+ */
+static int
+util_header_check_trusted(struct pool_set *set, unsigned repidx,
+	unsigned partidx)
+{
+	LOG(3, "set %p repidx %u partidx %u", set, repidx, partidx);
+
+	struct pool_replica *rep = set->replica[repidx];
+
+	struct pool_hdr *hdrp = rep->part[partidx].hdr;
+	struct pool_hdr hdr;
+
+	memcpy(&hdr, hdrp, sizeof(hdr));
+
+	util_convert2h_hdr_nocheck(&hdr);
+
+	/* to be valid, a header must have a major version of at least 1 */
+	if (hdr.major == 0) {
+		ERR_WO_ERRNO("invalid major version (0)");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!util_checksum(&hdr, sizeof(hdr), &hdr.checksum,
+			0, POOL_HDR_CSUM_END_OFF(&hdr))) {
+		ERR_WO_ERRNO("invalid checksum of pool header");
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* the feature check of part #0 covers all parts */
+	rep->part[partidx].rdonly = rep->part[0].rdonly;
+
+	return 0;
+}
+
 /*
  * util_replica_set_is_pmem -- sets per-replica is_pmem flag
  *
@@ -2342,6 +2487,71 @@ err:
 	return NULL;
 }
 
+/*
+ * util_poolset_grow_range -- allocates the backing for a range of the pool
+ *
+ * The range is given as an offset from the beginning of the pool and is
+ * translated onto the file ranges of the parts it spans in every replica.
+ * Used for pools with the PART_GROW compat feature, whose part files are
+ * created sparse and claim their capacity on demand.
+ */
+int
+util_poolset_grow_range(struct pool_set *set, size_t offset, size_t len)
+{
+	LOG(3, "set %p offset %zu len %zu", set, offset, len);
+
+	size_t hdrsize = (set->options & OPTION_SINGLEHDR) ? 0 : Mmap_align;
+
+	for (unsigned r = 0; r < set->nreplicas; r++) {
+		struct pool_replica *rep = set->replica[r];
+		char *base = rep->part[0].addr;
+
+		for (unsigned p = 0; p < rep->nparts; p++) {
+			struct pool_set_part *part = &rep->part[p];
+
+			/* Device DAX is always fully backed */
+			if (part->is_dev_dax)
+				continue;
+
+			size_t pstart = (size_t)((char *)part->addr - base);
+			size_t pend = pstart + part->size;
+
+			if (offset >= pend || offset + len <= pstart)
+				continue;
+
+			size_t start = offset > pstart ? offset : pstart;
+			size_t end = offset + len < pend ? offset + len : pend;
+
+			/* part files keep their data past the part header */
+			size_t foff = start - pstart;
+			if (p > 0)
+				foff += hdrsize;
+
+			int fd = part->fd;
+			if (fd < 0)
+				fd = os_open(part->path, O_RDWR);
+			if (fd < 0) {
+				ERR_W_ERRNO("open \"%s\"", part->path);
+				return -1;
+			}
+
+			int ret = os_posix_fallocate(fd, (os_off_t)foff,
+					(os_off_t)(end - start));
+
+			if (part->fd < 0)
+				(void) os_close(fd);
+
+			if (ret != 0) {
+				errno = ret;
+				ERR_W_ERRNO("fallocate \"%s\"", part->path);
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
 /*
  * util_print_bad_files_cb -- (internal) callback printing names of pool files
  *                            containing bad blocks
@@ -2581,12 +2791,20 @@ util_replica_open_local(struct pool_set *set, unsigned repidx, int flags)
 	struct pool_replica *rep = set->replica[repidx];
 	void *addr = NULL;
 
+	/* the requested base address applies only to the first replica */
+	void *addr_hint = repidx == 0 ? set->addr_hint : NULL;
+
+	/* an address that is not mapping-aligned cannot be valid */
+	if ((uintptr_t)addr_hint % Mmap_align != 0)
+		addr_hint = NULL;
+
 	do {
 		retry_for_contiguous_addr = 0;
 
 		/* determine a hint address for mmap() if not specified */
 		if (addr == NULL)
-			addr = util_map_hint(rep->resvsize, 0);
+			addr = addr_hint != NULL ? addr_hint :
+				util_map_hint(rep->resvsize, 0);
 		if (addr == MAP_FAILED) {
 			CORE_LOG_ERROR(
 				"cannot find a contiguous region of given size");
@@ -2597,13 +2815,39 @@ util_replica_open_local(struct pool_set *set, unsigned repidx, int flags)
 
 		/* map the first part and reserve space for remaining parts */
 		if (util_map_part(&rep->part[0], addr, rep->resvsize, 0,
-				flags, 0) != 0) {
+				flags | (addr == addr_hint ?
+					MAP_FIXED_NOREPLACE : 0), 0) != 0) {
+			if (addr == addr_hint) {
+				/* the region is taken, fall back */
+				CORE_LOG_WARNING(
+					"cannot map at the requested address %p - falling back",
+					addr_hint);
+				addr_hint = NULL;
+				addr = NULL;
+				retry_for_contiguous_addr = 1;
+				continue;
+			}
 			CORE_LOG_ERROR(
 				"pool mapping failed - replica #%u part #0",
 				repidx);
 			return -1;
 		}
 
+		/*
+		 * A kernel without MAP_FIXED_NOREPLACE treats the address as
+		 * a plain hint; landing elsewhere counts as a failed attempt.
+		 */
+		if (addr == addr_hint && rep->part[0].addr != addr_hint) {
+			util_unmap_part(&rep->part[0]);
+			CORE_LOG_WARNING(
+				"cannot map at the requested address %p - falling back",
+				addr_hint);
+			addr_hint = NULL;
+			addr = NULL;
+			retry_for_contiguous_addr = 1;
+			continue;
+		}
+
 		VALGRIND_REGISTER_PMEM_MAPPING(rep->part[0].addr,
 			rep->resvsize);
 		VALGRIND_REGISTER_PMEM_FILE(rep->part[0].fd,
@@ -2775,13 +3019,138 @@ util_unmap_all_hdrs(struct pool_set *set)
 	}
 }
 
+/* arguments and result of a single header check of the parallel pass */
+struct header_check_args {
+	struct pool_set *set;
+	const struct pool_attr *attr;
+	unsigned repidx;
+	unsigned partidx;
+	int trusted;
+	int started;
+	int ret;
+	int oerrno;
+};
+
+/*
+ * util_header_check_worker -- (internal) validates a single part header in a
+ *	worker thread
+ */
+static void *
+util_header_check_worker(void *arg)
+{
+	struct header_check_args *args = arg;
+
+	args->ret = (args->trusted && args->partidx > 0) ?
+		util_header_check_trusted(args->set, args->repidx,
+			args->partidx) :
+		util_header_check(args->set, args->repidx, args->partidx,
+			args->attr);
+	if (args->ret != 0)
+		args->oerrno = errno;
+
+	return NULL;
+}
+
+/*
+ * util_headers_check -- (internal) validate the headers of all parts of all
+ *	replicas
+ *
+ * The checks of different headers only read the shared state (part #0 and
+ * the neighboring headers, for the linkage) and each one writes only its own
+ * part, so they are independent. On a cold open the dominant cost is
+ * faulting in and checksumming every header page, serialized on media
+ * latency when done part after part, so the headers are validated in one
+ * parallel pass, striped one worker thread per header like the part file
+ * initialization in util_poolset_files_local().
+ */
+static int
+util_headers_check(struct pool_set *set, const struct pool_attr *attr,
+	int trusted)
+{
+	LOG(3, "set %p attr %p trusted %d", set, attr, trusted);
+
+	unsigned nhdrs = 0;
+	for (unsigned r = 0; r < set->nreplicas; r++)
+		nhdrs += set->replica[r]->nhdrs;
+
+	if (nhdrs < 2) {
+		for (unsigned r = 0; r < set->nreplicas; r++) {
+			struct pool_replica *rep = set->replica[r];
+			for (unsigned p = 0; p < rep->nhdrs; p++) {
+				if (util_header_check(set, r, p, attr) != 0) {
+					CORE_LOG_ERROR(
+						"header check failed - part #%d",
+						p);
+					return -1;
+				}
+			}
+		}
+
+		return 0;
+	}
+
+	struct header_check_args *args = Zalloc(nhdrs * sizeof(*args));
+	os_thread_t *threads = Malloc(nhdrs * sizeof(*threads));
+	if (args == NULL || threads == NULL) {
+		Free(args);
+		Free(threads);
+		return -1;
+	}
+
+	int ret = 0;
+	unsigned i = 0;
+	for (unsigned r = 0; r < set->nreplicas; r++) {
+		struct pool_replica *rep = set->replica[r];
+		for (unsigned p = 0; p < rep->nhdrs; p++, i++) {
+			struct header_check_args *a = &args[i];
+			a->set = set;
+			a->attr = attr;
+			a->repidx = r;
+			a->partidx = p;
+			a->trusted = trusted;
+
+			a->started = os_thread_create(&threads[i], NULL,
+				util_header_check_worker, a) == 0;
+			if (!a->started) {
+				/* fall back to checking the header in place */
+				util_header_check_worker(a);
+			}
+		}
+	}
+
+	for (i = 0; i < nhdrs; i++)
+		if (args[i].started)
+			os_thread_join(&threads[i], NULL);
+
+	for (i = 0; i < nhdrs; i++) {
+		if (args[i].ret != 0) {
+			/*
+			 * the detailed error was raised on the worker thread,
+			 * so the last error message of the calling thread has
+			 * to be set here
+			 */
+			ERR_WO_ERRNO("header check failed - part #%d",
+				args[i].partidx);
+			errno = args[i].oerrno;
+			ret = -1;
+			break;
+		}
+	}
+
+	Free(args);
+	Free(threads);
+
+	return ret;
+}
+
 /*
  * util_replica_check -- check headers, check UUID's, check replicas linkage
  */
 static int
-util_replica_check(struct pool_set *set, const struct pool_attr *attr)
+util_replica_check(struct pool_set *set, const struct pool_attr *attr,
+	int trusted)
 {
-	LOG(3, "set %p attr %p", set, attr);
+	LOG(3, "set %p attr %p trusted %d", set, attr, trusted);
 
 	/* read shutdown state toggle from header */
 	int pool_ignore_sds = IGNORE_SDS(HDR(REP(set, 0), 0));
@@ -2797,16 +3166,29 @@ util_replica_check(struct pool_set *set, const struct pool_attr *attr)
 	}
 	set->ignore_sds |= pool_ignore_sds;
 
+	/*
+	 * The trusted fast path leans on the shutdown state check below to
+	 * prove the pool was left by a clean close, so it cannot be taken
+	 * when that check is disabled.
+	 */
+	if (set->ignore_sds)
+		trusted = 0;
+
+	if (util_headers_check(set, attr, trusted) != 0)
+		return -1;
+
+	/*
+	 * one device context walk serves the shutdown state queries of all
+	 * parts of all replicas
+	 */
+	struct pmem2_usc_ctx *usc_ctx = NULL;
+	if (!set->ignore_sds)
+		(void) pmem2_usc_ctx_new(&usc_ctx);
+
 	for (unsigned r = 0; r < set->nreplicas; r++) {
 		struct pool_replica *rep = set->replica[r];
-		for (unsigned p = 0; p < rep->nhdrs; p++) {
-			if (util_header_check(set, r, p, attr) != 0) {
-				CORE_LOG_ERROR(
-					"header check failed - part #%d", p);
-				return -1;
-			}
+		for (unsigned p = 0; p < rep->nhdrs; p++)
 			set->rdonly |= rep->part[p].rdonly;
-		}
 
 		if (memcmp(HDR(REPP(set, r), 0)->uuid,
 					HDR(REP(set, r), 0)->prev_repl_uuid,
@@ -2816,15 +3198,15 @@ util_replica_check(struct pool_set *set, const struct pool_attr *attr)
 					POOL_HDR_UUID_LEN)) {
 			ERR_WO_ERRNO("wrong replica UUID");
 			errno = EINVAL;
-			return -1;
+			goto err;
 		}
 		if (!set->ignore_sds && rep->nhdrs) {
 			struct shutdown_state sds;
 			shutdown_state_init(&sds, NULL);
 			for (unsigned p = 0; p < rep->nparts; p++) {
-				if (shutdown_state_add_part(&sds,
+				if (shutdown_state_add_part(&sds, usc_ctx,
 						PART(rep, p)->fd, NULL))
-					return -1;
+					goto err;
 			}
 
 			ASSERTne(rep->nhdrs, 0);
@@ -2833,13 +3215,18 @@ util_replica_check(struct pool_set *set, const struct pool_attr *attr)
 					rep)) {
 				CORE_LOG_ERROR("ADR failure detected");
 				errno = EINVAL;
-				return -1;
+				goto err;
 			}
 			shutdown_state_set_dirty(&HDR(rep, 0)->sds,
 				rep);
 		}
 	}
+	pmem2_usc_ctx_delete(&usc_ctx);
 	return 0;
+
+err:
+	pmem2_usc_ctx_delete(&usc_ctx);
+	return -1;
 }
 
 /*
@@ -3025,6 +3412,9 @@ util_pool_open(struct pool_set **setp, const char *path, size_t minpartsize,
 		goto err_poolset_free;
 	}
 
+	/* try to map the first replica at the requested address, if any */
+	(*setp)->addr_hint = addr;
+
 	if (cow && (*setp)->replica[0]->part[0].is_dev_dax) {
 		ERR_WO_ERRNO("device dax cannot be mapped privately");
 		errno = ENOTSUP;
@@ -3092,8 +3482,14 @@ util_pool_open(struct pool_set **setp, const char *path, size_t minpartsize,
 		}
 	}
 
+	/* the fast path can also be requested per process */
+	int trusted = flags & POOL_OPEN_TRUSTED;
+	char *e = os_getenv("PMDK_TRUSTED_OPEN");
+	if (e && strcmp(e, "1") == 0)
+		trusted = 1;
+
 	/* check headers, check UUID's, check replicas linkage */
-	if (attr != NULL && util_replica_check(set, attr))
+	if (attr != NULL && util_replica_check(set, attr, trusted))
 		goto err_replica;
 
 	/* unmap all headers */
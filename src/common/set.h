@@ -87,6 +87,7 @@ struct pool_set_option {
 #define POOL_OPEN_IGNORE_SDS		2	/* ignore shutdown state */
 #define POOL_OPEN_IGNORE_BAD_BLOCKS	4	/* ignore bad blocks */
 #define POOL_OPEN_CHECK_BAD_BLOCKS	8	/* check bad blocks */
+#define POOL_OPEN_TRUSTED		16	/* reduced header validation */
 
 enum del_parts_mode {
 	DO_NOT_DELETE_PARTS,	/* do not delete part files */
@@ -154,6 +155,14 @@ struct pool_set {
 	unsigned next_directory_id;
 
 	int ignore_sds;		/* don't use shutdown state */
+
+	/*
+	 * Requested base address for the first replica, or NULL. Honored on
+	 * a best-effort basis - when the region is taken the mapping falls
+	 * back to a system-chosen address.
+	 */
+	void *addr_hint;
+
 	struct pool_replica *replica[];
 };
 
@@ -310,7 +319,6 @@ HDRP(struct pool_replica *rep, unsigned p)
 extern int Prefault_at_open;
 extern int Prefault_at_create;
 extern int SDS_at_create;
-extern int Fallocate_at_create;
 extern int COW_at_open;
 
 int util_poolset_parse(struct pool_set **setp, const char *path, int fd);
@@ -370,6 +378,7 @@ int util_pool_open(struct pool_set **setp, const char *path, size_t minpartsize,
 	unsigned flags);
 
 void *util_pool_extend(struct pool_set *set, size_t *size, size_t minpartsize);
+int util_poolset_grow_range(struct pool_set *set, size_t offset, size_t len);
 
 void util_replica_fdclose(struct pool_replica *rep);
 int util_replica_close_local(struct pool_replica *rep, unsigned repn,
@@ -16,6 +16,7 @@
 #include "libpmem2.h"
 #include "badblocks.h"
 #include "../libpmem2/pmem2_utils.h"
+#include "../libpmem2/usc.h"
 
 #define FLUSH_SDS(sds, rep) \
 	if ((rep) != NULL) os_part_deep_common(rep, 0, sds, sizeof(*(sds)), 1)
@@ -52,13 +53,16 @@ shutdown_state_init(struct shutdown_state *sds, struct pool_replica *rep)
 /*
  * shutdown_state_add_part -- adds file uuid and usc to shutdown_state struct
  *
+ * The device queries go through the caller's usc_ctx, so one context (an
+ * expensive sysfs walk on ndctl platforms) serves all the parts of a pass.
+ *
  * if path does not exist it will fail which does NOT mean shutdown failure
  */
 int
-shutdown_state_add_part(struct shutdown_state *sds, int fd,
-	struct pool_replica *rep)
+shutdown_state_add_part(struct shutdown_state *sds,
+	struct pmem2_usc_ctx *usc_ctx, int fd, struct pool_replica *rep)
 {
-	LOG(3, "sds %p, fd %d", sds, fd);
+	LOG(3, "sds %p, usc_ctx %p, fd %d", sds, usc_ctx, fd);
 
 	size_t len = 0;
 	char *uid;
@@ -69,7 +73,7 @@ shutdown_state_add_part(struct shutdown_state *sds, int fd,
 	if (pmem2_source_from_fd(&src, fd))
 		return 1;
 
-	int ret = pmem2_source_device_usc(src, &usc);
+	int ret = pmem2_usc_ctx_device_usc(usc_ctx, src, &usc);
 
 	if (ret != 0) {
 		if (ret == -EPERM) {
@@ -82,7 +86,7 @@ shutdown_state_add_part(struct shutdown_state *sds, int fd,
 		goto err;
 	}
 
-	ret = pmem2_source_device_id(src, NULL, &len);
+	ret = pmem2_usc_ctx_device_id(usc_ctx, src, NULL, &len);
 	if (ret != 0) {
 		ERR_WO_ERRNO("cannot read uuid of %d", fd);
 		goto err;
@@ -96,7 +100,7 @@ shutdown_state_add_part(struct shutdown_state *sds, int fd,
 		goto err;
 	}
 
-	ret = pmem2_source_device_id(src, uid, &len);
+	ret = pmem2_usc_ctx_device_id(usc_ctx, src, uid, &len);
 	if (ret != 0) {
 		ERR_WO_ERRNO("cannot read uuid of %d", fd);
 		Free(uid);
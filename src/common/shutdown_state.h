@@ -15,6 +15,7 @@ extern "C" {
 #endif
 
 struct pool_replica;
+struct pmem2_usc_ctx;
 struct shutdown_state {
 	uint64_t usc;
 	uint64_t uuid; /* UID checksum */
@@ -24,8 +25,8 @@ struct shutdown_state {
 };
 
 int shutdown_state_init(struct shutdown_state *sds, struct pool_replica *rep);
-int shutdown_state_add_part(struct shutdown_state *sds, int fd,
-	struct pool_replica *rep);
+int shutdown_state_add_part(struct shutdown_state *sds,
+	struct pmem2_usc_ctx *usc_ctx, int fd, struct pool_replica *rep);
 void shutdown_state_set_dirty(struct shutdown_state *sds,
 	struct pool_replica *rep);
 void shutdown_state_clear_dirty(struct shutdown_state *sds,
@@ -9,12 +9,19 @@
  * the *_errormsg() API calls.
  */
 
+/*
+ * Note: The undef below is critical to use the XSI-compliant version of
+ * the strerror_r(3) instead of the GNU-specific. Otherwise, the produced
+ * error string may not end up in the message buffer.
+ */
+#undef _GNU_SOURCE
+#include <string.h>
+
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <limits.h>
-#include <string.h>
 
 #include "last_error_msg.h"
 #include "os_thread.h"
@@ -23,6 +30,16 @@
 
 struct lasterrormsg
 {
+	/*
+	 * An error recorded without formatting, see last_error_msg_defer().
+	 * A non-NULL format means the deferred error is newer than the
+	 * formatted message below and the user-readable form is produced
+	 * only when the message is actually read.
+	 */
+	const char *deferred_format;
+	uint64_t deferred_arg;
+	int deferred_errnum;
+
 	char msg[CORE_LAST_ERROR_MSG_MAXPRINT];
 };
 
@@ -73,6 +90,7 @@ last_error_msg_get_internal(void)
 			return NULL;
 		/* make sure it contains empty string initially */
 		last->msg[0] = '\0';
+		last->deferred_format = NULL;
 		int ret = os_tls_set(Last_errormsg_key, last);
 		if (ret)
 			CORE_LOG_FATAL_W_ERRNO("os_tls_set");
@@ -80,12 +98,79 @@ last_error_msg_get_internal(void)
 	return last;
 }
 
+/*
+ * last_error_msg_format_deferred -- (internal) produces the user-readable
+ *	form of a deferred error, mirroring the eager formatting done
+ *	in core_log_va()
+ */
+static void
+last_error_msg_format_deferred(struct lasterrormsg *last)
+{
+	const char *format = last->deferred_format;
+	last->deferred_format = NULL;
+
+	int msg_len = snprintf(last->msg, sizeof(last->msg), format,
+		last->deferred_arg);
+	if (msg_len < 0) {
+		last->msg[0] = '\0';
+		return;
+	}
+
+	if ((size_t)msg_len < sizeof(last->msg) - 1 &&
+	    last->deferred_errnum != NO_ERRNO) {
+		/*
+		 * If it fails, the best thing to do is to at least pass
+		 * the message as is.
+		 */
+		(void) strerror_r(last->deferred_errnum, last->msg + msg_len,
+			sizeof(last->msg) - (size_t)msg_len);
+	}
+}
+
 /*
  * last_error_msg_get -- get the last error message
  */
 const char *
 last_error_msg_get(void)
 {
-	const struct lasterrormsg *last = last_error_msg_get_internal();
+	struct lasterrormsg *last = last_error_msg_get_internal();
+	if (last->deferred_format != NULL)
+		last_error_msg_format_deferred(last);
+	return &last->msg[0];
+}
+
+/*
+ * last_error_msg_acquire -- get the TLS buffer for an eagerly formatted
+ *	error message
+ *
+ * The message about to be written supersedes any deferred error.
+ */
+char *
+last_error_msg_acquire(void)
+{
+	struct lasterrormsg *last = last_error_msg_get_internal();
+	last->deferred_format = NULL;
 	return &last->msg[0];
 }
+
+/*
+ * last_error_msg_defer -- record an error without formatting it
+ *
+ * Only the errno value, the format string and its single integer argument
+ * are stored; the user-readable form is produced when last_error_msg_get()
+ * is actually called. This keeps expected-failure paths that are hit at
+ * high rates and consumed programmatically free of the formatting cost.
+ * The format must point to a string of static lifetime consuming at most
+ * one integer argument.
+ */
+void
+last_error_msg_defer(int errnum, const char *format, uint64_t arg)
+{
+	struct lasterrormsg *last = last_error_msg_get_internal();
+	if (last == NULL)
+		return;
+
+	last->deferred_format = format;
+	last->deferred_arg = arg;
+	last->deferred_errnum = errnum;
+}
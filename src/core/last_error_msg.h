@@ -8,6 +8,8 @@
 #ifndef CORE_LAST_ERROR_MSG_H
 #define CORE_LAST_ERROR_MSG_H
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -18,6 +20,8 @@ void last_error_msg_init(void);
 void last_error_msg_fini(void);
 
 const char *last_error_msg_get(void);
+char *last_error_msg_acquire(void);
+void last_error_msg_defer(int errnum, const char *format, uint64_t arg);
 
 #ifdef __cplusplus
 }
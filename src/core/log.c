@@ -24,6 +24,7 @@
 #include "log_default.h"
 #include "last_error_msg.h"
 #include "core_assert.h"
+#include "os.h"
 
 /*
  * Default levels of the logging thresholds
@@ -64,8 +65,17 @@ core_log_init()
 
 	/* enable the default logging function */
 	core_log_default_init();
-	while (EAGAIN ==
-		core_log_set_function(CORE_LOG_USE_DEFAULT_FUNCTION))
+
+	/*
+	 * The rate-limited variant of the default logging function is
+	 * an opt-in, see core_log_rate_limited_function().
+	 */
+	core_log_function *log_function = CORE_LOG_USE_DEFAULT_FUNCTION;
+	char *rate_limit = os_getenv("PMDK_LOG_RATE_LIMIT");
+	if (rate_limit != NULL && rate_limit[0] == '1')
+		log_function = core_log_rate_limited_function;
+
+	while (EAGAIN == core_log_set_function(log_function))
 		;
 }
 
@@ -225,7 +235,7 @@ core_log(enum core_log_level level, int errnum, const char *file_name,
 	size_t buf_len = sizeof(message);
 	if (level == CORE_LOG_LEVEL_ERROR_LAST) {
 		level = CORE_LOG_LEVEL_ERROR;
-		buf = (char *)last_error_msg_get();
+		buf = last_error_msg_acquire();
 		buf_len = CORE_LAST_ERROR_MSG_MAXPRINT;
 	}
 
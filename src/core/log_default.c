@@ -147,6 +147,116 @@ core_log_default_function(enum core_log_level level, const char *file_name,
 	}
 }
 
+/*
+ * Rate limiting state. Each slot tracks a single call site (identified by
+ * the file name pointer and the line number) and counts the messages it has
+ * emitted in the current time window. The table is fixed-size and slots are
+ * claimed lock-free on first use; call sites which do not fit are simply
+ * not rate-limited.
+ */
+
+#define RATE_LIMIT_SLOTS 128 /* must be a power of two */
+#define RATE_LIMIT_BURST 20 /* messages allowed per call site per window */
+#define RATE_LIMIT_WINDOW_NS 1000000000ULL /* 1s */
+
+struct rate_limit_slot {
+	const char *file_name; /* claimed by CAS, never released */
+	unsigned line_no;
+	uint64_t window_start; /* CLOCK_MONOTONIC, in nanoseconds */
+	uint64_t count; /* messages emitted in the current window */
+	uint64_t suppressed; /* messages dropped since the last summary */
+};
+
+static struct rate_limit_slot Rate_limit_slots[RATE_LIMIT_SLOTS];
+
+/*
+ * rate_limit_slot_get -- (internal) find or claim the slot for a call site
+ *
+ * Returns NULL when the call site does not fit into the table.
+ */
+static struct rate_limit_slot *
+rate_limit_slot_get(const char *file_name, unsigned line_no)
+{
+	/* the file name is a string literal so its address identifies it */
+	uintptr_t key = ((uintptr_t)file_name >> 4) * 2654435761UL + line_no;
+	struct rate_limit_slot *slot =
+		&Rate_limit_slots[key & (RATE_LIMIT_SLOTS - 1)];
+
+	if (slot->file_name == NULL &&
+	    util_bool_compare_and_swap64(&slot->file_name, NULL, file_name))
+		slot->line_no = line_no;
+
+	if (slot->file_name != file_name || slot->line_no != line_no)
+		return NULL; /* the slot belongs to another call site */
+
+	return slot;
+}
+
+/*
+ * core_log_rate_limited_function -- a variant of the default logging function
+ * which caps the number of messages a single call site may emit per second
+ *
+ * A noisy call site may only slip through RATE_LIMIT_BURST messages per
+ * window; the rest are counted and reported in a single summary line when
+ * the call site becomes eligible again. The bookkeeping is lock-free and
+ * the counters are updated with relaxed atomics - under contention a few
+ * messages more or less may get through which is perfectly fine for
+ * a throttling heuristic. Messages of the ERROR level and above are never
+ * suppressed.
+ *
+ * Enabled by setting the PMDK_LOG_RATE_LIMIT environment variable to 1.
+ */
+void
+core_log_rate_limited_function(enum core_log_level level,
+	const char *file_name, unsigned line_no, const char *function_name,
+	const char *message)
+{
+	struct timespec ts;
+	struct rate_limit_slot *slot;
+
+	if (level <= CORE_LOG_LEVEL_ERROR || file_name == NULL)
+		goto emit;
+
+	if (os_clock_gettime(CLOCK_MONOTONIC, &ts))
+		goto emit;
+
+	slot = rate_limit_slot_get(file_name, line_no);
+	if (slot == NULL)
+		goto emit;
+
+	uint64_t now = (uint64_t)ts.tv_sec * 1000000000ULL +
+		(uint64_t)ts.tv_nsec;
+	uint64_t start;
+	util_atomic_load_explicit64(&slot->window_start, &start,
+		memory_order_relaxed);
+
+	if (now - start > RATE_LIMIT_WINDOW_NS &&
+	    util_bool_compare_and_swap64(&slot->window_start, start, now)) {
+		/* this thread opened a new window */
+		uint64_t dropped = slot->suppressed;
+		slot->suppressed = 0;
+		slot->count = 0;
+
+		if (dropped > 0) {
+			char summary[64];
+			(void) snprintf(summary, sizeof(summary),
+				"suppressed %lu similar messages",
+				(unsigned long)dropped);
+			core_log_default_function(level, file_name, line_no,
+				function_name, summary);
+		}
+	}
+
+	if (util_fetch_and_add64(&slot->count, 1) >= RATE_LIMIT_BURST) {
+		util_fetch_and_add64(&slot->suppressed, 1);
+		return;
+	}
+
+emit:
+	core_log_default_function(level, file_name, line_no, function_name,
+		message);
+}
+
 /*
  * core_log_default_init -- explain why not calling openlog(3)
  */
@@ -11,6 +11,10 @@
 void core_log_default_function(enum core_log_level level, const char *file_name,
 	unsigned line_no, const char *function_name, const char *message);
 
+void core_log_rate_limited_function(enum core_log_level level,
+	const char *file_name, unsigned line_no, const char *function_name,
+	const char *message);
+
 void core_log_default_init(void);
 
 void core_log_default_fini(void);
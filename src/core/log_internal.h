@@ -12,6 +12,8 @@
 #include <stdint.h>
 #include <errno.h>
 
+#include "last_error_msg.h"
+
 #ifdef ATOMIC_OPERATIONS_SUPPORTED
 #include <stdatomic.h>
 #endif /* ATOMIC_OPERATIONS_SUPPORTED */
@@ -194,6 +196,35 @@ void core_log(enum core_log_level level, int errnum, const char *file_name,
 #define CORE_LOG_ERROR_W_ERRNO_LAST(format, ...) \
 		_CORE_LOG_TO_LAST(errno, format ": ", ##__VA_ARGS__);
 
+/*
+ * 'Deferred' macros' flavours. When error logging is disabled the error is
+ * recorded without formatting it - the user-readable message is produced only
+ * if the *_errormsg() API calls are actually made. This makes expected-failure
+ * paths hit at high rates nearly free. When error logging is enabled
+ * the regular eager path is taken so the log stream does not lose messages.
+ * The format must be a literal consuming at most one integer argument.
+ */
+
+#define _CORE_LOG_DEFERRED(errnum, format, arg) \
+	do { \
+		if (CORE_LOG_LEVEL_ERROR <= \
+				_core_log_get_threshold_internal()) { \
+			core_log(CORE_LOG_LEVEL_ERROR_LAST, errnum, __FILE__, \
+				__LINE__, __func__, format, arg); \
+		} else { \
+			last_error_msg_defer(errnum, format, (uint64_t)(arg)); \
+		} \
+	} while (0)
+
+#define CORE_LOG_ERROR_LAST_DEFERRED(format) \
+	_CORE_LOG_DEFERRED(NO_ERRNO, format, 0)
+
+#define CORE_LOG_ERROR_LAST_DEFERRED_ARG(format, arg) \
+	_CORE_LOG_DEFERRED(NO_ERRNO, format, arg)
+
+#define CORE_LOG_ERROR_W_ERRNO_LAST_DEFERRED(format) \
+	_CORE_LOG_DEFERRED(errno, format ": ", 0)
+
 /* Aliases */
 
 #define ERR_W_ERRNO(f, ...)\
@@ -202,6 +233,15 @@ void core_log(enum core_log_level level, int errnum, const char *file_name,
 #define ERR_WO_ERRNO(f, ...)\
 	CORE_LOG_ERROR_LAST(f, ##__VA_ARGS__)
 
+#define ERR_DEFER_WO_ERRNO(f)\
+	CORE_LOG_ERROR_LAST_DEFERRED(f)
+
+#define ERR_DEFER_ARG_WO_ERRNO(f, arg)\
+	CORE_LOG_ERROR_LAST_DEFERRED_ARG(f, arg)
+
+#define ERR_DEFER_W_ERRNO(f)\
+	CORE_LOG_ERROR_W_ERRNO_LAST_DEFERRED(f)
+
 #ifdef __cplusplus
 }
 #endif
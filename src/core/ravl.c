@@ -424,6 +424,90 @@ error_duplicate:
 	return -1;
 }
 
+/*
+ * ravl_build_sorted -- (internal) recursively builds a balanced subtree out
+ *	of a sorted array of data pointers
+ *
+ * The middle element becomes the subtree root and the ranks are set to the
+ * subtree heights, which trivially satisfies the rank rule.  Returns NULL
+ * when a node allocation fails, after unwinding whatever was built so far.
+ */
+static struct ravl_node *
+ravl_build_sorted(struct ravl *ravl, const void **data, size_t count,
+	struct ravl_node *parent)
+{
+	if (count == 0)
+		return NULL;
+
+	size_t mid = count / 2;
+
+	struct ravl_node *n = ravl_new_node(ravl,
+		ravl_node_insert_constructor, data[mid]);
+	if (n == NULL)
+		return NULL;
+
+	n->parent = parent;
+
+	if (mid > 0) {
+		n->slots[RAVL_LEFT] = ravl_build_sorted(ravl, data, mid, n);
+		if (n->slots[RAVL_LEFT] == NULL)
+			goto error_subtree_build;
+	}
+
+	if (count - mid - 1 > 0) {
+		n->slots[RAVL_RIGHT] = ravl_build_sorted(ravl, data + mid + 1,
+			count - mid - 1, n);
+		if (n->slots[RAVL_RIGHT] == NULL)
+			goto error_subtree_build;
+	}
+
+	int lrank = ravl_node_rank(n->slots[RAVL_LEFT]);
+	int rrank = ravl_node_rank(n->slots[RAVL_RIGHT]);
+	n->rank = (lrank > rrank ? lrank : rrank) + 1;
+
+	return n;
+
+error_subtree_build:
+	ravl_foreach_node(n, NULL, NULL, 1);
+	return NULL;
+}
+
+/*
+ * ravl_bulk_insert -- constructs the tree bottom-up from a sorted array of
+ *	data pointers
+ *
+ * The array must be sorted in ascending order of the tree's comparator and
+ * must not contain duplicates.  Takes O(n) instead of the O(n log n) that
+ * repeated ravl_insert calls would - no balancing is ever needed.  When the
+ * tree is not empty the bottom-up construction cannot be used and the
+ * function falls back to regular inserts.
+ */
+int
+ravl_bulk_insert(struct ravl *ravl, const void **data, size_t count)
+{
+	LOG(6, NULL);
+
+	if (ravl->root != NULL) {
+		for (size_t i = 0; i < count; ++i) {
+			if (ravl_insert(ravl, data[i]) != 0)
+				return -1;
+		}
+
+		return 0;
+	}
+
+#ifdef DEBUG
+	for (size_t i = 1; i < count; ++i)
+		ASSERT(ravl->compare(data[i - 1], data[i]) < 0);
+#endif
+
+	ravl->root = ravl_build_sorted(ravl, data, count, NULL);
+	if (ravl->root == NULL && count != 0)
+		return -1;
+
+	return 0;
+}
+
 /*
  * ravl_node_type_most -- (internal) returns left-most or right-most node in
  *	the subtree
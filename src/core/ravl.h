@@ -39,6 +39,7 @@ void ravl_foreach(struct ravl *ravl, ravl_cb cb, void *arg);
 int ravl_empty(struct ravl *ravl);
 void ravl_clear(struct ravl *ravl);
 int ravl_insert(struct ravl *ravl, const void *data);
+int ravl_bulk_insert(struct ravl *ravl, const void **data, size_t count);
 int ravl_emplace(struct ravl *ravl, ravl_constr constr, const void *arg);
 int ravl_emplace_copy(struct ravl *ravl, const void *data);
 
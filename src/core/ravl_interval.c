@@ -146,73 +146,6 @@ ravl_interval_remove(struct ravl_interval *ri, struct ravl_interval_node *rin)
 	return 0;
 }
 
-/*
- * ravl_interval_find_prior -- find overlapping interval starting prior to
- *                             the current one
- */
-static struct ravl_interval_node *
-ravl_interval_find_prior(struct ravl *tree, struct ravl_interval_node *rin)
-{
-	struct ravl_node *node;
-	struct ravl_interval_node *cur;
-
-	node = ravl_find(tree, rin, RAVL_PREDICATE_LESS);
-	if (!node)
-		return NULL;
-
-	cur = ravl_data(node);
-	/*
-	 * If the end of the found interval is below the searched boundary, then
-	 * those intervals are not overlapping.
-	 */
-	if (cur->get_max(cur->addr) <= rin->get_min(rin->addr))
-		return NULL;
-
-	return cur;
-}
-
-/*
- * ravl_interval_find_eq -- find overlapping interval starting neither prior or
- *                          lather than the current one
- */
-static struct ravl_interval_node *
-ravl_interval_find_eq(struct ravl *tree, struct ravl_interval_node *rin)
-{
-	struct ravl_node *node;
-
-	node = ravl_find(tree, rin, RAVL_PREDICATE_EQUAL);
-	if (!node)
-		return NULL;
-
-	return ravl_data(node);
-}
-
-/*
- * ravl_interval_find_later -- find overlapping interval starting later than
- *                             the current one
- */
-static struct ravl_interval_node *
-ravl_interval_find_later(struct ravl *tree, struct ravl_interval_node *rin)
-{
-	struct ravl_node *node;
-	struct ravl_interval_node *cur;
-
-	node = ravl_find(tree, rin, RAVL_PREDICATE_GREATER);
-	if (!node)
-		return NULL;
-
-	cur = ravl_data(node);
-
-	/*
-	 * If the beginning of the found interval is above the end of
-	 * the searched range, then those interval are not overlapping
-	 */
-	if (cur->get_min(cur->addr) >= rin->get_max(rin->addr))
-		return NULL;
-
-	return cur;
-}
-
 /*
  * ravl_interval_find_equal -- find the interval with exact (min, max) range
  */
@@ -235,6 +168,13 @@ ravl_interval_find_equal(struct ravl_interval *ri, void *addr)
 
 /*
  * ravl_interval_find -- find the earliest interval within (min, max) range
+ *
+ * The tree never holds overlapping intervals (the insert comparator treats
+ * overlap as equality and the insert fails), so the earliest overlap is
+ * simply the lowest interval whose end lies above the searched minimum.
+ * The overlap comparator descends right exactly when a node ends at or
+ * below the searched minimum, which makes a single GREATER_EQUAL descent
+ * find that interval - no neighbor probing is needed.
  */
 struct ravl_interval_node *
 ravl_interval_find(struct ravl_interval *ri, void *addr)
@@ -245,12 +185,19 @@ ravl_interval_find(struct ravl_interval *ri, void *addr)
 	range.get_max = ri->get_max;
 	range.overlap = true;
 
-	struct ravl_interval_node *cur;
-	cur = ravl_interval_find_prior(ri->tree, &range);
-	if (!cur)
-		cur = ravl_interval_find_eq(ri->tree, &range);
-	if (!cur)
-		cur = ravl_interval_find_later(ri->tree, &range);
+	struct ravl_node *node = ravl_find(ri->tree, &range,
+			RAVL_PREDICATE_GREATER_EQUAL);
+	if (!node)
+		return NULL;
+
+	struct ravl_interval_node *cur = ravl_data(node);
+
+	/*
+	 * If the beginning of the found interval is above the end of
+	 * the searched range, then those intervals are not overlapping.
+	 */
+	if (cur->get_min(cur->addr) >= range.get_max(range.addr))
+		return NULL;
 
 	return cur;
 }
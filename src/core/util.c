@@ -13,6 +13,12 @@
 #include <errno.h>
 #include <time.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
 
 #include "util.h"
 #include "os.h"
@@ -50,6 +56,85 @@ unsigned _On_drd_or_hg;
 unsigned _On_memcheck;
 #endif
 
+#if VG_STATIC_NOPS_ENABLED
+
+/* bounds of the patchable check table, one per library */
+extern struct vg_check_site __start_vg_check_sites[]
+	__attribute__((visibility("hidden"), weak));
+extern struct vg_check_site __stop_vg_check_sites[]
+	__attribute__((visibility("hidden"), weak));
+
+/* the five byte nop replacing the jump of a disabled check */
+static const unsigned char Vg_check_nop[5] = { 0x0f, 0x1f, 0x44, 0x00, 0x00 };
+
+/*
+ * util_vg_patch_checks -- rewrites the valgrind checks of absent tools to nops
+ *
+ * Called once per library, after the tool flags have been computed.
+ * Patching is skipped entirely under valgrind - the live jumps behave
+ * exactly like the plain checks - and when the text cannot be made
+ * writable, so failure here only costs the optimization.
+ */
+void
+util_vg_patch_checks(void)
+{
+	if (_On_valgrind)
+		return;
+
+	struct vg_check_site *start = __start_vg_check_sites;
+	struct vg_check_site *stop = __stop_vg_check_sites;
+	if (start == NULL || start == stop)
+		return;
+
+	const unsigned *flags[VG_KEY_MAX] = {
+		[VG_KEY_VALGRIND] = &_On_valgrind,
+#if VG_HELGRIND_ENABLED
+		[VG_KEY_HELGRIND] = &_On_helgrind,
+#endif
+#if VG_DRD_ENABLED
+		[VG_KEY_DRD] = &_On_drd,
+#endif
+#if VG_HELGRIND_ENABLED || VG_DRD_ENABLED
+		[VG_KEY_DRD_OR_HG] = &_On_drd_or_hg,
+#endif
+#if VG_MEMCHECK_ENABLED
+		[VG_KEY_MEMCHECK] = &_On_memcheck,
+#endif
+#if VG_PMEMCHECK_ENABLED
+		[VG_KEY_PMEMCHECK] = &_On_pmemcheck,
+#endif
+	};
+
+	uintptr_t pagemask = ~((uintptr_t)Pagesize - 1);
+	uintptr_t first = UINTPTR_MAX;
+	uintptr_t last = 0;
+	for (struct vg_check_site *s = start; s != stop; ++s) {
+		if (s->code < first)
+			first = s->code;
+		if (s->code + sizeof(Vg_check_nop) > last)
+			last = s->code + sizeof(Vg_check_nop);
+	}
+	first &= pagemask;
+	last = (last + Pagesize - 1) & pagemask;
+
+	if (mprotect((void *)first, last - first,
+			PROT_READ | PROT_WRITE | PROT_EXEC))
+		return;
+
+	for (struct vg_check_site *s = start; s != stop; ++s) {
+		if (s->key >= VG_KEY_MAX)
+			continue;
+		const unsigned *flag = flags[s->key];
+		if (flag != NULL && *flag == 0)
+			memcpy((void *)s->code, Vg_check_nop,
+				sizeof(Vg_check_nop));
+	}
+
+	(void) mprotect((void *)first, last - first, PROT_READ | PROT_EXEC);
+}
+
+#endif /* VG_STATIC_NOPS_ENABLED */
+
 #if VG_PMEMCHECK_ENABLED
 /* Initialized to true if the process is running inside Valgrind pmemcheck. */
 unsigned _On_pmemcheck;
@@ -123,6 +208,96 @@ util_is_zeroed(const void *addr, size_t len)
 	return 0;
 }
 
+/*
+ * util_checksum_seq_scalar -- (internal) merges checksum from the old buffer
+ *	with checksum for current buffer, one word at a time
+ */
+static uint64_t
+util_checksum_seq_scalar(const void *addr, size_t len, uint64_t csum)
+{
+	const uint32_t *p32 = addr;
+	const uint32_t *p32end = (const uint32_t *)((const char *)addr + len);
+	uint32_t lo32 = (uint32_t)csum;
+	uint32_t hi32 = (uint32_t)(csum >> 32);
+	while (p32 < p32end) {
+		lo32 += le32toh(*p32);
+		++p32;
+		hi32 += lo32;
+	}
+	return (uint64_t)hi32 << 32 | lo32;
+}
+
+#ifdef __x86_64__
+
+/*
+ * util_checksum_seq_avx2 -- (internal) vectorized variant of the sequential
+ *	checksum, folding eight words per iteration
+ *
+ * For a block of words b1..b8 the scalar loop advances the state by
+ * lo += sum(bj) and hi += 8 * lo + sum((9 - j) * bj), which allows the
+ * per-word data dependency to be replaced with two horizontal sums.
+ */
+static uint64_t __attribute__((target("avx2")))
+util_checksum_seq_avx2(const void *addr, size_t len, uint64_t csum)
+{
+	const char *p = addr;
+	uint32_t lo32 = (uint32_t)csum;
+	uint32_t hi32 = (uint32_t)(csum >> 32);
+
+	/* how many times each word of a block counts towards hi32 */
+	const __m256i coef = _mm256_setr_epi32(8, 7, 6, 5, 4, 3, 2, 1);
+
+	size_t nblocks = len / 32;
+	for (size_t i = 0; i < nblocks; ++i) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)p);
+		__m256i w = _mm256_mullo_epi32(v, coef);
+
+		__m128i s = _mm_add_epi32(_mm256_castsi256_si128(v),
+			_mm256_extracti128_si256(v, 1));
+		s = _mm_add_epi32(s, _mm_shuffle_epi32(s,
+			_MM_SHUFFLE(1, 0, 3, 2)));
+		s = _mm_add_epi32(s, _mm_shuffle_epi32(s,
+			_MM_SHUFFLE(2, 3, 0, 1)));
+
+		__m128i t = _mm_add_epi32(_mm256_castsi256_si128(w),
+			_mm256_extracti128_si256(w, 1));
+		t = _mm_add_epi32(t, _mm_shuffle_epi32(t,
+			_MM_SHUFFLE(1, 0, 3, 2)));
+		t = _mm_add_epi32(t, _mm_shuffle_epi32(t,
+			_MM_SHUFFLE(2, 3, 0, 1)));
+
+		hi32 += 8 * lo32 + (uint32_t)_mm_cvtsi128_si32(t);
+		lo32 += (uint32_t)_mm_cvtsi128_si32(s);
+
+		p += 32;
+	}
+
+	return util_checksum_seq_scalar(p, len - nblocks * 32,
+		(uint64_t)hi32 << 32 | lo32);
+}
+
+#endif
+
+/* the sequential checksum kernel, selected at library initialization */
+static uint64_t (*Util_checksum_seq)(const void *addr, size_t len,
+	uint64_t csum) = util_checksum_seq_scalar;
+
+/*
+ * util_checksum_zeros -- (internal) advances the checksum as if the given
+ *	number of zero words was processed
+ */
+static uint64_t
+util_checksum_zeros(uint64_t csum, size_t nwords)
+{
+	uint32_t lo32 = (uint32_t)csum;
+	uint32_t hi32 = (uint32_t)(csum >> 32);
+
+	/* lo32 += 0; for every word, only the high part advances */
+	hi32 += (uint32_t)nwords * lo32;
+
+	return (uint64_t)hi32 << 32 | lo32;
+}
+
 /*
  * util_checksum_compute -- compute Fletcher64-like checksum
  *
@@ -136,32 +311,39 @@ util_checksum_compute(void *addr, size_t len, uint64_t *csump, size_t skip_off)
 	if (len % 4 != 0)
 		abort();
 
-	uint32_t *p32 = addr;
-	uint32_t *p32end = (uint32_t *)((char *)addr + len);
-	uint32_t *skip;
-	uint32_t lo32 = 0;
-	uint32_t hi32 = 0;
-
-	if (skip_off)
-		skip = (uint32_t *)((char *)addr + skip_off);
-	else
-		skip = (uint32_t *)((char *)addr + len);
-
-	while (p32 < p32end)
-		if (p32 == (uint32_t *)csump || p32 >= skip) {
-			/* lo32 += 0; treat first 32-bits as zero */
-			p32++;
-			hi32 += lo32;
-			/* lo32 += 0; treat second 32-bits as zero */
-			p32++;
-			hi32 += lo32;
+	char *data = addr;
+	char *dataend = data + len;
+	char *skip = skip_off ? data + skip_off : dataend;
+	char *csum = (char *)csump;
+	uint64_t c = 0;
+
+	/*
+	 * The skipped region is consumed two words at a time, so an odd
+	 * number of leftover words contributes one extra zero word.
+	 */
+	size_t nskip = (size_t)(dataend - skip) / 4;
+	nskip += nskip % 2;
+
+	if (csum >= data && csum + sizeof(*csump) <= dataend &&
+	    csum < skip && (size_t)(csum - data) % 4 == 0) {
+		c = Util_checksum_seq(data, (size_t)(csum - data), c);
+		/* the checksum location itself is treated as zeros */
+		c = util_checksum_zeros(c, sizeof(*csump) / 4);
+
+		char *rest = csum + sizeof(*csump);
+		if (rest <= skip) {
+			c = Util_checksum_seq(rest, (size_t)(skip - rest), c);
 		} else {
-			lo32 += le32toh(*p32);
-			++p32;
-			hi32 += lo32;
+			/* the checksum crossed into the skipped region */
+			nskip = (size_t)(dataend - rest) / 4;
+			nskip += nskip % 2;
 		}
+	} else {
+		c = Util_checksum_seq(data, (size_t)(skip - data), c);
+	}
 
-	return (uint64_t)hi32 << 32 | lo32;
+	/* everything from the skip offset onward is treated as zeros */
+	return util_checksum_zeros(c, nskip);
 }
 
 /*
@@ -198,16 +380,8 @@ util_checksum_seq(const void *addr, size_t len, uint64_t csum)
 {
 	if (len % 4 != 0)
 		abort();
-	const uint32_t *p32 = addr;
-	const uint32_t *p32end = (const uint32_t *)((const char *)addr + len);
-	uint32_t lo32 = (uint32_t)csum;
-	uint32_t hi32 = (uint32_t)(csum >> 32);
-	while (p32 < p32end) {
-		lo32 += le32toh(*p32);
-		++p32;
-		hi32 += lo32;
-	}
-	return (uint64_t)hi32 << 32 | lo32;
+
+	return Util_checksum_seq(addr, len, csum);
 }
 
 /*
@@ -300,6 +474,11 @@ util_init(void)
 
 	Mmap_align = Pagesize;
 
+#ifdef __x86_64__
+	if (__builtin_cpu_supports("avx2"))
+		Util_checksum_seq = util_checksum_seq_avx2;
+#endif
+
 #if ANY_VG_TOOL_ENABLED
 	_On_valgrind = RUNNING_ON_VALGRIND;
 #endif
@@ -361,6 +540,10 @@ util_init(void)
 		_Pmreorder_emit = 0;
 	}
 #endif
+
+#if VG_STATIC_NOPS_ENABLED
+	util_vg_patch_checks();
+#endif
 }
 
 /*
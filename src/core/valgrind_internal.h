@@ -33,9 +33,86 @@
 #define ANY_VG_TOOL_ENABLED 0
 #endif
 
+/*
+ * With VALGRIND_STATIC_NOPS=y every On_<tool> check is emitted as a
+ * patchable jump to the regular load-and-test of the tool flag, and its
+ * location is recorded in a per-library table. Once library init has
+ * determined which tools are absent, the jumps of their checks are
+ * rewritten to nops, removing the flag loads and branches from the hot
+ * paths while keeping a single binary usable both under valgrind and in
+ * production. Under valgrind nothing is patched - self-modified code
+ * would force retranslation and the branches are noise there anyway.
+ */
+#if defined(VALGRIND_STATIC_NOPS) && defined(__x86_64__) && \
+	defined(__GNUC__) && ANY_VG_TOOL_ENABLED
+#define VG_STATIC_NOPS_ENABLED 1
+#else
+#define VG_STATIC_NOPS_ENABLED 0
+#endif
+
+#if VG_STATIC_NOPS_ENABLED
+
+#include <stdint.h>
+
+/* ids of the patchable checks, indexing the flags in util_vg_patch_checks */
+enum vg_check_key {
+	VG_KEY_VALGRIND,
+	VG_KEY_HELGRIND,
+	VG_KEY_DRD,
+	VG_KEY_DRD_OR_HG,
+	VG_KEY_MEMCHECK,
+	VG_KEY_PMEMCHECK,
+
+	VG_KEY_MAX,
+};
+
+/* a single patchable check site, layout mirrored by .vg_check_sites */
+struct vg_check_site {
+	uint64_t code;	/* address of the five byte jump */
+	uint64_t key;	/* enum vg_check_key of the checked flag */
+};
+
+void util_vg_patch_checks(void);
+
+/*
+ * vg_static_check -- reads a valgrind tool flag through a patchable site
+ *
+ * The explicit .byte/.long encoding pins the jump at five bytes - the
+ * assembler would shorten an ordinary jmp to two - so the patcher can
+ * overwrite it with a five byte nop without measuring instructions.
+ * Until the library is initialized the jump is live and the check
+ * behaves exactly like the plain load-and-test. A statement expression
+ * with a local label is used so the key stays a literal constant even
+ * in unoptimized builds.
+ */
+#define vg_static_check(key, on) __extension__ ({\
+	__label__ vg_l_check;\
+	unsigned vg_on = 0;\
+	asm goto (\
+		"1:\n\t"\
+		".byte 0xe9\n\t"\
+		".long %l[vg_l_check] - (. + 4)\n\t"\
+		".pushsection vg_check_sites,\"aw\",@progbits\n\t"\
+		".balign 16\n\t"\
+		".quad 1b\n\t"\
+		".quad %c[k]\n\t"\
+		".popsection"\
+		: : [k] "i" (key) : : vg_l_check);\
+	if (0) {\
+vg_l_check:	vg_on = __builtin_expect(*(on), 0);\
+	}\
+	vg_on;\
+})
+
+#endif
+
 #if ANY_VG_TOOL_ENABLED
 extern unsigned _On_valgrind;
+#if VG_STATIC_NOPS_ENABLED
+#define On_valgrind vg_static_check(VG_KEY_VALGRIND, &_On_valgrind)
+#else
 #define On_valgrind __builtin_expect(_On_valgrind, 0)
+#endif
 #include "valgrind/valgrind.h"
 #else
 #define On_valgrind (0)
@@ -43,7 +120,11 @@ extern unsigned _On_valgrind;
 
 #if VG_HELGRIND_ENABLED
 extern unsigned _On_helgrind;
+#if VG_STATIC_NOPS_ENABLED
+#define On_helgrind vg_static_check(VG_KEY_HELGRIND, &_On_helgrind)
+#else
 #define On_helgrind __builtin_expect(_On_helgrind, 0)
+#endif
 #include "valgrind/helgrind.h"
 #else
 #define On_helgrind (0)
@@ -51,7 +132,11 @@ extern unsigned _On_helgrind;
 
 #if VG_DRD_ENABLED
 extern unsigned _On_drd;
+#if VG_STATIC_NOPS_ENABLED
+#define On_drd vg_static_check(VG_KEY_DRD, &_On_drd)
+#else
 #define On_drd __builtin_expect(_On_drd, 0)
+#endif
 #include "valgrind/drd.h"
 #else
 #define On_drd (0)
@@ -60,7 +145,11 @@ extern unsigned _On_drd;
 #if VG_HELGRIND_ENABLED || VG_DRD_ENABLED
 
 extern unsigned _On_drd_or_hg;
+#if VG_STATIC_NOPS_ENABLED
+#define On_drd_or_hg vg_static_check(VG_KEY_DRD_OR_HG, &_On_drd_or_hg)
+#else
 #define On_drd_or_hg __builtin_expect(_On_drd_or_hg, 0)
+#endif
 
 #define VALGRIND_ANNOTATE_HAPPENS_BEFORE(obj) do {\
 	if (On_drd_or_hg) \
@@ -134,7 +223,11 @@ extern unsigned _On_drd_or_hg;
 #if VG_PMEMCHECK_ENABLED
 
 extern unsigned _On_pmemcheck;
+#if VG_STATIC_NOPS_ENABLED
+#define On_pmemcheck vg_static_check(VG_KEY_PMEMCHECK, &_On_pmemcheck)
+#else
 #define On_pmemcheck __builtin_expect(_On_pmemcheck, 0)
+#endif
 
 #include "valgrind/pmemcheck.h"
 
@@ -382,7 +475,11 @@ extern int _Pmreorder_emit;
 #if VG_MEMCHECK_ENABLED
 
 extern unsigned _On_memcheck;
+#if VG_STATIC_NOPS_ENABLED
+#define On_memcheck vg_static_check(VG_KEY_MEMCHECK, &_On_memcheck)
+#else
 #define On_memcheck __builtin_expect(_On_memcheck, 0)
+#endif
 
 #include "valgrind/memcheck.h"
 
@@ -0,0 +1,232 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2026, Intel Corporation */
+
+/*
+ * bulk.c -- example of the batch idioms, timed against the per-object
+ *	patterns they replace
+ *
+ * Each section performs the same amount of work twice: once the way the
+ * other examples in this directory do it, one object or one persist at a
+ * time, and once with the batch API that amortizes the fixed costs over
+ * the whole set. The timings printed on a pmem device typically show the
+ * batch variants several times faster; copy the batch variants.
+ *
+ * usage: bulk <file-name>
+ */
+
+#include <ex_common.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <libpmemobj.h>
+
+#define POOL_SIZE (100 * 1024 * 1024)
+#define NOBJECTS 10000
+#define OBJECT_SIZE 128
+#define NRECORDS 1024
+#define RECORD_SIZE 256
+
+POBJ_LAYOUT_BEGIN(bulk);
+POBJ_LAYOUT_ROOT(bulk, struct journal);
+POBJ_LAYOUT_TOID(bulk, struct item);
+POBJ_LAYOUT_END(bulk);
+
+struct item {
+	char payload[OBJECT_SIZE];
+};
+
+struct journal {
+	char records[NRECORDS][RECORD_SIZE];
+};
+
+/*
+ * elapsed_ns -- returns the nanoseconds elapsed since *start
+ */
+static uint64_t
+elapsed_ns(const struct timespec *start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)(now.tv_sec - start->tv_sec) * 1000000000 +
+		(uint64_t)(now.tv_nsec - start->tv_nsec);
+}
+
+/*
+ * alloc_section -- allocates NOBJECTS objects one at a time, then again as
+ *	a single batch
+ *
+ * pmemobj_alloc_multi() publishes the heap metadata changes for the whole
+ * batch in one redo log pass, so the log persist cost is paid once instead
+ * of NOBJECTS times. The batch is atomic: either every object exists or
+ * none do.
+ */
+static void
+alloc_section(PMEMobjpool *pop, PMEMoid *oidv)
+{
+	struct timespec start;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < NOBJECTS; ++i) {
+		if (pmemobj_zalloc(pop, &oidv[i], OBJECT_SIZE,
+				TOID_TYPE_NUM(struct item))) {
+			perror("pmemobj_zalloc");
+			exit(1);
+		}
+	}
+	printf("alloc: one at a time      %8lu us\n",
+		elapsed_ns(&start) / 1000);
+
+	for (int i = 0; i < NOBJECTS; ++i)
+		pmemobj_free(&oidv[i]);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (pmemobj_alloc_multi(pop, oidv, NOBJECTS, OBJECT_SIZE,
+			TOID_TYPE_NUM(struct item), POBJ_FLAG_ZERO)) {
+		perror("pmemobj_alloc_multi");
+		exit(1);
+	}
+	printf("alloc: alloc_multi batch  %8lu us\n",
+		elapsed_ns(&start) / 1000);
+}
+
+/*
+ * publish_section -- frees the objects one transaction at a time, then
+ *	re-allocates and frees them again with a single action batch
+ *
+ * Actions reserve the allocator state changes without persisting anything;
+ * one pmemobj_publish() call then makes the entire set durable with a
+ * single redo log. This is the idiom for multi-object updates that do not
+ * need snapshots.
+ */
+static void
+publish_section(PMEMobjpool *pop, PMEMoid *oidv)
+{
+	struct timespec start;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < NOBJECTS; ++i) {
+		TX_BEGIN(pop) {
+			pmemobj_tx_free(oidv[i]);
+		} TX_ONABORT {
+			fprintf(stderr, "tx free failed\n");
+			exit(1);
+		} TX_END
+	}
+	printf("free: one tx per object   %8lu us\n",
+		elapsed_ns(&start) / 1000);
+
+	struct pobj_action *actv = malloc(sizeof(*actv) * NOBJECTS);
+	if (actv == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < NOBJECTS; ++i) {
+		oidv[i] = pmemobj_reserve(pop, &actv[i], OBJECT_SIZE,
+			TOID_TYPE_NUM(struct item));
+		if (OID_IS_NULL(oidv[i])) {
+			perror("pmemobj_reserve");
+			exit(1);
+		}
+	}
+	if (pmemobj_publish(pop, actv, NOBJECTS)) {
+		perror("pmemobj_publish");
+		exit(1);
+	}
+	printf("alloc: action batch       %8lu us\n",
+		elapsed_ns(&start) / 1000);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < NOBJECTS; ++i)
+		pmemobj_defer_free(pop, oidv[i], &actv[i]);
+	if (pmemobj_publish(pop, actv, NOBJECTS)) {
+		perror("pmemobj_publish");
+		exit(1);
+	}
+	printf("free: action batch        %8lu us\n",
+		elapsed_ns(&start) / 1000);
+
+	free(actv);
+}
+
+/*
+ * epoch_section -- writes NRECORDS journal records with a persist each,
+ *	then again inside a flush epoch
+ *
+ * Within an epoch the persists only record and merge the dirty ranges;
+ * the single drain at pmemobj_epoch_end() orders all of them at once.
+ * None of the records are durable until the epoch ends, so this fits
+ * workloads that only need durability at batch boundaries.
+ */
+static void
+epoch_section(PMEMobjpool *pop)
+{
+	struct journal *journal = D_RW(POBJ_ROOT(pop, struct journal));
+	struct timespec start;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < NRECORDS; ++i) {
+		memset(journal->records[i], (char)i, RECORD_SIZE);
+		pmemobj_persist(pop, journal->records[i], RECORD_SIZE);
+	}
+	printf("journal: persist each     %8lu us\n",
+		elapsed_ns(&start) / 1000);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (pmemobj_epoch_begin(pop)) {
+		perror("pmemobj_epoch_begin");
+		exit(1);
+	}
+	for (int i = 0; i < NRECORDS; ++i) {
+		memset(journal->records[i], (char)~i, RECORD_SIZE);
+		pmemobj_persist(pop, journal->records[i], RECORD_SIZE);
+	}
+	pmemobj_epoch_end(pop);
+	printf("journal: flush epoch      %8lu us\n",
+		elapsed_ns(&start) / 1000);
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		printf("usage: %s file-name\n", argv[0]);
+		return 1;
+	}
+
+	const char *path = argv[1];
+	PMEMobjpool *pop;
+
+	if (file_exists(path) != 0) {
+		if ((pop = pmemobj_create(path, POBJ_LAYOUT_NAME(bulk),
+				POOL_SIZE, CREATE_MODE_RW)) == NULL) {
+			perror("failed to create pool");
+			return 1;
+		}
+	} else {
+		if ((pop = pmemobj_open(path,
+				POBJ_LAYOUT_NAME(bulk))) == NULL) {
+			perror("failed to open pool");
+			return 1;
+		}
+	}
+
+	PMEMoid *oidv = malloc(sizeof(*oidv) * NOBJECTS);
+	if (oidv == NULL) {
+		perror("malloc");
+		pmemobj_close(pop);
+		return 1;
+	}
+
+	alloc_section(pop, oidv);
+	publish_section(pop, oidv);
+	epoch_section(pop);
+
+	free(oidv);
+	pmemobj_close(pop);
+
+	return 0;
+}
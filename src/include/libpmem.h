@@ -14,7 +14,9 @@
 #ifndef LIBPMEM_H
 #define LIBPMEM_H 1
 
+#include <stdint.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -33,13 +35,19 @@ extern "C" {
 #define PMEM_FILE_EXCL		(1 << 1)
 #define PMEM_FILE_SPARSE	(1 << 2)
 #define PMEM_FILE_TMPFILE	(1 << 3)
+#define PMEM_FILE_ALIGN_2M	(1 << 4)
+#define PMEM_FILE_ALIGN_1G	(1 << 5)
 
 void *pmem_map_file(const char *path, size_t len, int flags, mode_t mode,
 	size_t *mapped_lenp, int *is_pmemp);
 
+size_t pmem_map_pagesize(const void *addr);
+
 int pmem_unmap(void *addr, size_t len);
 int pmem_is_pmem(const void *addr, size_t len);
 void pmem_persist(const void *addr, size_t len);
+void pmem_persist_nodrain(const void *addr, size_t len);
+void pmem_drain_all(void);
 int pmem_msync(const void *addr, size_t len);
 int pmem_has_auto_flush(void);
 void pmem_flush(const void *addr, size_t len);
@@ -48,10 +56,48 @@ int pmem_deep_drain(const void *addr, size_t len);
 int pmem_deep_persist(const void *addr, size_t len);
 void pmem_drain(void);
 int pmem_has_hw_drain(void);
+int pmem_has_store_line(void);
+void pmem_store_line(void *pmemdest, const void *src);
+int pmem_has_store_16b(void);
+void pmem_store_16b(void *pmemdest, const void *src);
+int pmem_has_store_8b_nt(void);
+void pmem_store_8b_nt(void *pmemdest, const void *src);
+
+/*
+ * Introspection of the memcpy/memset dispatch: the name of the kernel
+ * family selected at library initialization (e.g. "sse2", "avx",
+ * "avx512f", "movdir64b"), the selected cache flush instruction (e.g.
+ * "clwb"), and the process-global copy size from which the memcpy/memset
+ * functions switch to non-temporal stores.
+ */
+const char *pmem_memcpy_impl(void);
+const char *pmem_flush_impl(void);
+size_t pmem_movnt_threshold(void);
+void pmem_movnt_threshold_set(size_t threshold);
 
 void *pmem_memmove_persist(void *pmemdest, const void *src, size_t len);
 void *pmem_memcpy_persist(void *pmemdest, const void *src, size_t len);
+void *pmem_memcpy_persistv(void *pmemdest, const struct iovec *iov,
+	int iovcnt);
 void *pmem_memset_persist(void *pmemdest, int c, size_t len);
+
+/*
+ * Guarded copies: pmem_memcpy_guard_persist() appends a small marker
+ * (a "guard band") directly behind the copied range, written only after
+ * the payload is durable. After a crash, a valid marker implies the whole
+ * range preceding it was persisted, giving non-transactional bulk stores
+ * cheap torn-write detection. The tag is an arbitrary caller-chosen value
+ * (e.g. a record sequence number) that prevents a stale marker left by a
+ * previous incarnation of the data from validating. A guarded record
+ * occupies len + PMEM_GUARD_SIZE bytes of pmem.
+ */
+#define PMEM_GUARD_SIZE 32
+
+void *pmem_memcpy_guard_persist(void *pmemdest, const void *src, size_t len,
+	uint64_t tag);
+int pmem_guard_verify(const void *pmemdest, size_t len, uint64_t tag);
+size_t pmem_guard_scan(const void *base, size_t len, size_t nrecords,
+	uint64_t first_tag);
 void *pmem_memmove_nodrain(void *pmemdest, const void *src, size_t len);
 void *pmem_memcpy_nodrain(void *pmemdest, const void *src, size_t len);
 void *pmem_memset_nodrain(void *pmemdest, int c, size_t len);
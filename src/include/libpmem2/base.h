@@ -58,6 +58,8 @@ extern "C" {
 #define PMEM2_E_FILE_DESCRIPTOR_NOT_SET		(-100035)
 #define PMEM2_E_SOURCE_TYPE_NOT_SUPPORTED	(-100036)
 #define PMEM2_E_IO_FAIL				(-100037)
+#define PMEM2_E_NO_EXTENT_FOUND			(-100038)
+#define PMEM2_E_INVALID_MEM_FLAG		(-100039)
 
 /* source setup */
 
@@ -72,6 +74,8 @@ int pmem2_source_size(const struct pmem2_source *src, size_t *size);
 int pmem2_source_alignment(const struct pmem2_source *src,
 	size_t *alignment);
 
+int pmem2_source_refresh(struct pmem2_source *src);
+
 int pmem2_source_delete(struct pmem2_source **src);
 
 int pmem2_source_pread_mcsafe(struct pmem2_source *src, void *buf, size_t size,
@@ -80,6 +84,21 @@ int pmem2_source_pread_mcsafe(struct pmem2_source *src, void *buf, size_t size,
 int pmem2_source_pwrite_mcsafe(struct pmem2_source *src, void *buf, size_t size,
 	size_t offset);
 
+struct pmem2_extent_context;
+
+struct pmem2_extent {
+    size_t offset;
+    size_t length;
+};
+
+int pmem2_extent_context_new(struct pmem2_extent_context **ctx_ptr,
+	const struct pmem2_source *src);
+
+int pmem2_extent_next(struct pmem2_extent_context *ctx,
+	struct pmem2_extent *ext);
+
+void pmem2_extent_context_delete(struct pmem2_extent_context **ctx_ptr);
+
 /* vm reservation setup */
 
 struct pmem2_map;
@@ -154,6 +173,9 @@ int pmem2_config_set_protection(struct pmem2_config *cfg,
 int pmem2_config_set_vm_reservation(struct pmem2_config *cfg,
 	struct pmem2_vm_reservation *rsv, size_t offset);
 
+int pmem2_config_set_prefault_threads(struct pmem2_config *cfg,
+	unsigned nthreads);
+
 /* mapping */
 struct pmem2_map;
 int pmem2_map_from_existing(struct pmem2_map **map,
@@ -195,12 +217,15 @@ pmem2_drain_fn pmem2_get_drain_fn(struct pmem2_map *map);
 
 #define PMEM2_F_MEM_NOFLUSH	(1U << 5)
 
+#define PMEM2_F_MEM_PARALLEL	(1U << 6)
+
 #define PMEM2_F_MEM_VALID_FLAGS (PMEM2_F_MEM_NODRAIN | \
 		PMEM2_F_MEM_NONTEMPORAL | \
 		PMEM2_F_MEM_TEMPORAL | \
 		PMEM2_F_MEM_WC | \
 		PMEM2_F_MEM_WB | \
-		PMEM2_F_MEM_NOFLUSH)
+		PMEM2_F_MEM_NOFLUSH | \
+		PMEM2_F_MEM_PARALLEL)
 
 typedef void *(*pmem2_memmove_fn)(void *pmemdest, const void *src, size_t len,
 	unsigned flags);
@@ -217,10 +242,70 @@ pmem2_memcpy_fn pmem2_get_memcpy_fn(struct pmem2_map *map);
 
 pmem2_memset_fn pmem2_get_memset_fn(struct pmem2_map *map);
 
+/* asynchronous memory operations */
+
+enum pmem2_future_state {
+	PMEM2_FUTURE_STATE_RUNNING,
+	PMEM2_FUTURE_STATE_COMPLETE,
+};
+
+/*
+ * A single in-flight memory operation, advanced one bounded chunk at a time
+ * by pmem2_future_poll(), so that an event loop can interleave many of them
+ * without ever blocking on a full-length copy. The structure is owned by the
+ * caller and must stay valid until the future completes; all fields are
+ * private to the library.
+ */
+struct pmem2_future {
+	struct pmem2_map *map;
+	void *dest;
+	const void *src;
+	int c;
+	size_t len;
+	size_t done;
+	unsigned flags;
+	int op;
+	enum pmem2_future_state state;
+};
+
+int pmem2_memmove_async(struct pmem2_future *future, struct pmem2_map *map,
+	void *pmemdest, const void *src, size_t len, unsigned flags);
+
+int pmem2_memcpy_async(struct pmem2_future *future, struct pmem2_map *map,
+	void *pmemdest, const void *src, size_t len, unsigned flags);
+
+int pmem2_memset_async(struct pmem2_future *future, struct pmem2_map *map,
+	void *pmemdest, int c, size_t len, unsigned flags);
+
+enum pmem2_future_state pmem2_future_poll(struct pmem2_future *future);
+
+void *pmem2_future_complete(struct pmem2_future *future);
+
+/* differential snapshots */
+
+int pmem2_snapshot_mark(struct pmem2_map *map);
+
+int pmem2_snapshot_diff(struct pmem2_map *map, int fd, size_t *copied);
+
 /* RAS */
 
 int pmem2_deep_flush(struct pmem2_map *map, void *ptr, size_t size);
 
+struct pmem2_deep_flush_handle;
+
+int pmem2_deep_flush_async(struct pmem2_map *map, void *ptr, size_t size,
+	struct pmem2_deep_flush_handle **handle_ptr);
+
+int pmem2_deep_flush_wait(struct pmem2_deep_flush_handle **handle_ptr);
+
+struct pmem2_deep_flush_range {
+    void *ptr;
+    size_t size;
+};
+
+int pmem2_deep_flush_ranges(struct pmem2_map *map,
+	const struct pmem2_deep_flush_range *ranges, size_t nranges);
+
 int pmem2_source_device_id(const struct pmem2_source *src,
 	char *id, size_t *len);
 
@@ -247,6 +332,14 @@ void pmem2_badblock_context_delete(
 int pmem2_badblock_clear(struct pmem2_badblock_context *bbctx,
 	const struct pmem2_badblock *bb);
 
+struct pmem2_badblock_clear_handle;
+
+int pmem2_badblock_clear_async(struct pmem2_badblock_context *bbctx,
+	const struct pmem2_badblock *bbs, size_t nbbs,
+	struct pmem2_badblock_clear_handle **handle_ptr);
+
+int pmem2_badblock_clear_wait(struct pmem2_badblock_clear_handle **handle_ptr);
+
 /* error handling */
 
 const char *pmem2_errormsg(void);
@@ -21,6 +21,8 @@
 #include <libpmemobj/lists_atomic.h>
 #include <libpmemobj/log.h>
 #include <libpmemobj/pool.h>
+#include <libpmemobj/ringbuf_base.h>
+#include <libpmemobj/stack_base.h>
 #include <libpmemobj/thread.h>
 #include <libpmemobj/tx.h>
 
@@ -61,6 +61,20 @@ void pmemobj_defer_free(PMEMobjpool *pop, PMEMoid oid, struct pobj_action *act);
 
 int pmemobj_publish(PMEMobjpool *pop, struct pobj_action *actv,
 	size_t actvcnt);
+
+/*
+ * Dependency-ordered publication: pmemobj_action_publish_after() records
+ * that act must become durable only after the action at index dep_index of
+ * the array later handed to pmemobj_publish_graph(). The graph publish
+ * groups the actions into dependency levels and publishes each level as a
+ * single batch, so the flushes of independent actions overlap while every
+ * dependent chain still waits for its predecessors. An action may only
+ * depend on an action that precedes it in the array; without any
+ * annotations the call is equivalent to pmemobj_publish().
+ */
+void pmemobj_action_publish_after(struct pobj_action *act, uint32_t dep_index);
+int pmemobj_publish_graph(PMEMobjpool *pop, struct pobj_action *actv,
+	size_t actvcnt);
 int pmemobj_tx_publish(struct pobj_action *actv, size_t actvcnt);
 int pmemobj_tx_xpublish(struct pobj_action *actv, size_t actvcnt,
 		uint64_t flags);
@@ -40,12 +40,125 @@ int pmemobj_xalloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
 	uint64_t type_num, uint64_t flags,
 	pmemobj_constr constructor, void *arg);
 
+/*
+ * Allocates with flags a new object from the pool, biasing the placement
+ * toward the heap zone that contains the hint object. The hint is
+ * best-effort - it improves locality of objects accessed together, but does
+ * not affect the outcome of the allocation. A null hint oid is equivalent to
+ * pmemobj_xalloc.
+ */
+int pmemobj_xalloc_near(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
+	uint64_t type_num, uint64_t flags, PMEMoid hint,
+	pmemobj_constr constructor, void *arg);
+
 /*
  * Allocates a new zeroed object from the pool.
  */
 int pmemobj_zalloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
 	uint64_t type_num);
 
+/*
+ * Atomically allocates a batch of objects, all with the same size and type.
+ * Either all of the objects are allocated, or none are. The heap metadata
+ * changes for the entire batch are published in a single redo log pass,
+ * amortizing the log persist cost over all objects in the batch.
+ */
+int pmemobj_alloc_multi(PMEMobjpool *pop, PMEMoid *oidv, size_t noids,
+	size_t size, uint64_t type_num, uint64_t flags);
+
+/*
+ * Allocates a persistent array of nslots fixed-stride slots as a single
+ * object. The entire array carries one allocation header, so arrays of small
+ * entries use a fraction of the memory that per-object allocations would, and
+ * the slots are contiguous, which makes scans sequential. The returned oid
+ * refers to the array as a whole; individual slots are addressed with
+ * pmemobj_array_at().
+ */
+int pmemobj_array_alloc(PMEMobjpool *pop, PMEMoid *oidp, size_t nslots,
+	size_t stride, uint64_t type_num, uint64_t flags);
+
+/*
+ * Returns the oid of the idx-th slot of the array, or OID_NULL if the oid
+ * does not refer to an array slot (e.g. idx is out of bounds).
+ */
+PMEMoid pmemobj_array_at(PMEMoid array, size_t idx);
+
+/*
+ * Returns the number of slots of the array, or 0 if the oid is not valid.
+ */
+size_t pmemobj_array_nslots(PMEMoid array);
+
+/*
+ * Returns the stride of the array, or 0 if the oid is not valid.
+ */
+size_t pmemobj_array_stride(PMEMoid array);
+
+typedef int (*pmemobj_array_cb)(size_t idx, void *slot, void *arg);
+
+/*
+ * Iterates over all slots of the array in index order, prefetching ahead of
+ * the slot passed to the callback. Stops and returns the callback's value on
+ * the first nonzero return; otherwise returns 0.
+ */
+int pmemobj_array_foreach(PMEMoid array, pmemobj_array_cb cb, void *arg);
+
+/*
+ * Migrates an object from the src pool to the dst pool: a new object of the
+ * same size and type number is allocated in dst, the data is copied directly
+ * between the mapped pools with non-temporal stores, and the source object is
+ * freed. The new object is published before the source is freed, so a crash
+ * mid-migration can leave the object in both pools, but never in neither.
+ * The oid of the new object is stored in the volatile location oidp points
+ * to, if not NULL.
+ */
+int pmemobj_migrate(PMEMobjpool *src, PMEMobjpool *dst, PMEMoid oid,
+	PMEMoid *oidp);
+
+/*
+ * Persistent blob handle: a 16-byte tagged union that stores values of up to
+ * PMEMOBJ_BLOB_INLINE_MAX bytes directly in the handle, and larger values in
+ * a separate allocation. The handle must reside in the pool; every update is
+ * committed in a single redo log pass together with any allocation or free it
+ * implies, so a handle is never observed half-updated after a crash.
+ * A zeroed handle is a valid empty blob.
+ */
+#define PMEMOBJ_BLOB_INLINE_MAX 14
+
+typedef union pobj_blob {
+	uint64_t data[2];
+	struct {
+		uint8_t data[PMEMOBJ_BLOB_INLINE_MAX];
+		uint8_t size;
+		uint8_t tag; /* nonzero for an inline value */
+	} inline_value;
+	struct {
+		uint64_t off;
+		uint64_t size; /* always below 2^56, so the tag stays zero */
+	} external_value;
+} PMEMblob;
+
+/*
+ * Sets the value of the blob, replacing (and freeing) the previous value if
+ * any. A size of 0 with a NULL data pointer clears the blob.
+ */
+int pmemobj_blob_set(PMEMobjpool *pop, PMEMblob *blobp, const void *data,
+	size_t size);
+
+/*
+ * Returns the address of the blob's value, or NULL if the blob is empty.
+ */
+void *pmemobj_blob_data(PMEMobjpool *pop, const PMEMblob *blobp);
+
+/*
+ * Returns the size of the blob's value, 0 if the blob is empty.
+ */
+size_t pmemobj_blob_size(const PMEMblob *blobp);
+
+/*
+ * Clears the blob, freeing the external value if one was allocated.
+ */
+int pmemobj_blob_free(PMEMobjpool *pop, PMEMblob *blobp);
+
 /*
  * Resizes an existing object.
  */
@@ -86,6 +199,14 @@ struct pobj_defrag_result {
 int pmemobj_defrag(PMEMobjpool *pop, PMEMoid **oidv, size_t oidcnt,
 	struct pobj_defrag_result *result);
 
+/*
+ * Performs a single budget-bound pass of defragmentation on the provided
+ * array of objects, resumable through the cursor.
+ */
+int pmemobj_defrag_incremental(PMEMobjpool *pop, PMEMoid **oidv, size_t oidcnt,
+	size_t max_objects, uint64_t max_usecs, size_t *cursor,
+	struct pobj_defrag_result *result);
+
 #ifdef __cplusplus
 }
 #endif
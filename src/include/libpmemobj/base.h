@@ -34,6 +34,8 @@ typedef struct pmemobjpool PMEMobjpool;
 #define POBJ_FLAG_NO_SNAPSHOT		(((uint64_t)1) << 2)
 #define POBJ_FLAG_ASSUME_INITIALIZED	(((uint64_t)1) << 3)
 #define POBJ_FLAG_TX_NO_ABORT		(((uint64_t)1) << 4)
+#define POBJ_FLAG_READ_ONLY		(((uint64_t)1) << 5)
+#define POBJ_FLAG_GENERATION		(((uint64_t)1) << 6)
 
 #define POBJ_CLASS_ID(id)	(((uint64_t)(id)) << 48)
 #define POBJ_ARENA_ID(id)	(((uint64_t)(id)) << 32)
@@ -43,6 +45,7 @@ typedef struct pmemobjpool PMEMobjpool;
 #define POBJ_XALLOC_ZERO	POBJ_FLAG_ZERO
 #define POBJ_XALLOC_NO_FLUSH	POBJ_FLAG_NO_FLUSH
 #define POBJ_XALLOC_NO_ABORT	POBJ_FLAG_TX_NO_ABORT
+#define POBJ_XALLOC_GENERATION	POBJ_FLAG_GENERATION
 
 /*
  * pmemobj_mem* flags
@@ -90,6 +93,25 @@ extern __thread struct _pobj_pcache {
 	int invalidate;
 } _pobj_cached_pool;
 
+/*
+ * Optional sampling of the oid translations, feeding the per-zone access
+ * heat counters readable through the stats.heap.zone ctl namespace. The
+ * period is the number of translations between samples, as set through
+ * heap.heatmap.period; zero (the default) disables the instrumentation,
+ * leaving a single well-predicted branch in the translation fast path.
+ */
+extern unsigned _pobj_heat_period;
+extern __thread unsigned _pobj_heat_countdown;
+
+void _pobj_heat_record(PMEMoid oid);
+
+static inline void
+_pobj_heat_sample(PMEMoid oid)
+{
+	if (_pobj_heat_period != 0 && _pobj_heat_countdown-- == 0)
+		_pobj_heat_record(oid);
+}
+
 /*
  * Returns the direct pointer of an object.
  */
@@ -112,18 +134,77 @@ pmemobj_direct_inline(PMEMoid oid)
 		cache->uuid_lo = oid.pool_uuid_lo;
 	}
 
+	_pobj_heat_sample(oid);
+
 	return (void *)((uintptr_t)cache->pop + oid.off);
 }
 
+/*
+ * The sole pool of the process, as registered with pmemobj_set_sole_pool().
+ * Both fields are zero when no pool is registered.
+ */
+extern struct _pobj_sole_pool {
+	PMEMobjpool *pop;
+	uint64_t uuid_lo;
+} _pobj_sole_pool;
+
+/*
+ * Registers the only pool the process intends to keep open, so that
+ * pmemobj_direct() can be resolved as a plain base + offset computation
+ * with no pool lookup (see pmemobj_direct_sole() below). Passing NULL
+ * unregisters the pool; closing the registered pool does so implicitly.
+ * The registration must not race with concurrent pmemobj_direct() calls.
+ */
+void pmemobj_set_sole_pool(PMEMobjpool *pop);
+
+/*
+ * Returns the direct pointer of an object, assuming it belongs to the pool
+ * registered with pmemobj_set_sole_pool(). Objects from other pools fall
+ * back to the generic per-thread cache lookup.
+ */
+static inline void *
+pmemobj_direct_sole(PMEMoid oid)
+{
+	if (oid.off == 0 || oid.pool_uuid_lo == 0)
+		return NULL;
+
+	if (oid.pool_uuid_lo != _pobj_sole_pool.uuid_lo)
+		return pmemobj_direct_inline(oid);
+
+	_pobj_heat_sample(oid);
+
+	return (void *)((uintptr_t)_pobj_sole_pool.pop + oid.off);
+}
+
 /*
  * Returns the direct pointer of an object.
  */
 #if defined(_PMEMOBJ_INTRNL) || defined(PMEMOBJ_DIRECT_NON_INLINE)
 void *pmemobj_direct(PMEMoid oid);
+#elif defined(PMEMOBJ_DIRECT_SOLE_POOL)
+#define pmemobj_direct pmemobj_direct_sole
 #else
 #define pmemobj_direct pmemobj_direct_inline
 #endif
 
+/*
+ * Issues software prefetches for a batch of objects, so that iterators over
+ * pointer-chained structures can overlap the memory fetches of upcoming
+ * nodes instead of serializing on them. Purely a performance hint; oids
+ * that do not resolve to an open pool are ignored.
+ */
+void pmemobj_prefetch_oids(const PMEMoid *oidv, size_t noids);
+
+/*
+ * Translates an array of oids into direct pointers in one call. The pool
+ * is resolved once from the pop argument and the translated objects are
+ * prefetched, so batch consumers do not pay the per-element lookup and
+ * do not serialize on the dependent loads. Oids equal to OID_NULL or not
+ * belonging to the given pool translate to NULL.
+ */
+void pmemobj_direct_multi(PMEMobjpool *pop, const PMEMoid *oidv, void **ptrv,
+	size_t noids);
+
 struct pmemvlt {
 	uint64_t runid;
 };
@@ -159,6 +240,23 @@ size_t pmemobj_alloc_usable_size(PMEMoid oid);
  */
 uint64_t pmemobj_type_num(PMEMoid oid);
 
+/*
+ * Reads the generation counter of an object allocated with
+ * POBJ_XALLOC_GENERATION.
+ *
+ * The counter starts at zero and is incremented every time the object is
+ * added to a transaction with pmemobj_tx_add_range or pmemobj_tx_xadd_range;
+ * an aborted transaction rolls the increment back. Readers can cache a copy
+ * of the object along with its generation and skip re-reading it as long as
+ * the generation is unchanged. The counter does not survive reallocation
+ * and is not incremented by the _direct variants of range snapshotting or
+ * by non-transactional stores.
+ *
+ * Returns 0 and stores the counter in *genp on success; returns -1 and sets
+ * errno to EINVAL if the object was not allocated with the flag.
+ */
+int pmemobj_generation(PMEMoid oid, uint64_t *genp);
+
 /*
  * Pmemobj specific low-level memory manipulation functions.
  *
@@ -227,6 +325,63 @@ int pmemobj_xflush(PMEMobjpool *pop, const void *addr, size_t len,
  */
 void pmemobj_drain(PMEMobjpool *pop);
 
+/*
+ * Starts a drain group for the calling thread. Until the matching
+ * pmemobj_drain_group_end(), explicit persists and drains on pmem pools only
+ * flush the data; the single drain issued at the end of the group orders all
+ * of them, no matter how many pools the writes spanned. Groups nest.
+ */
+void pmemobj_drain_group_begin(void);
+
+/*
+ * Concludes the calling thread's drain group with a single drain.
+ */
+void pmemobj_drain_group_end(void);
+
+/*
+ * Starts a flush epoch on the pool for the calling thread. Until the
+ * matching pmemobj_epoch_end(), explicit persists, flushes and drains on
+ * this pool only record and merge the ranges; the end of the epoch flushes
+ * them with a single concluding drain. The data written within the epoch is
+ * not durable until the epoch ends. Epochs nest; a thread may have an epoch
+ * open on one pool at a time. Returns -1 and sets errno to EINVAL when an
+ * epoch on a different pool is already open.
+ */
+int pmemobj_epoch_begin(PMEMobjpool *pop);
+
+/*
+ * Flushes the ranges recorded in the calling thread's epoch and concludes
+ * it with a single drain.
+ */
+void pmemobj_epoch_end(PMEMobjpool *pop);
+
+/*
+ * Compressed persistent pointers. A pool keeps an object table mapping
+ * 32-bit handles to objects, so pointer-heavy structures can store a 4-byte
+ * handle where a 16-byte PMEMoid would go, at the cost of one extra
+ * indirection on dereference. Handles are persistent and stay valid across
+ * pool opens; they are not position-independent across pools. Releasing a
+ * handle does not free the object and freeing an object does not release
+ * its handles.
+ */
+
+/*
+ * Returns the 32-bit handle of the given object, assigning one if the
+ * object has none yet. Returns 0 on error.
+ */
+uint32_t pmemobj_oid32(PMEMobjpool *pop, PMEMoid oid);
+
+/*
+ * Returns the direct pointer behind a 32-bit handle, or NULL when the
+ * handle maps no object.
+ */
+void *pmemobj_oid32_direct(PMEMobjpool *pop, uint32_t handle);
+
+/*
+ * Releases a 32-bit handle for reuse; the object itself is not freed.
+ */
+void pmemobj_oid32_release(PMEMobjpool *pop, uint32_t handle);
+
 /*
  * Version checking.
  */
@@ -137,6 +137,28 @@ struct pobj_alloc_class_desc {
 	unsigned class_id;
 };
 
+/*
+ * A single sample taken by the allocation latency tracer. Samples are
+ * recorded for operations whose duration exceeds the configured
+ * heap.lat_trace.threshold and drained with heap.lat_trace.samples.
+ */
+struct pobj_lat_sample {
+	uint64_t timestamp; /* operation start, CLOCK_MONOTONIC nanoseconds */
+	uint64_t size;	    /* requested size, 0 for free */
+	uint64_t nsecs;	    /* operation duration in nanoseconds */
+	int op;		    /* 0 - alloc, 1 - free, 2 - realloc */
+};
+
+/*
+ * Argument of the heap.lat_trace.samples query - drains up to max recorded
+ * samples into the user-provided buffer.
+ */
+struct pobj_lat_samples {
+	size_t max;			  /* capacity of the samples buffer */
+	size_t drained;			  /* number of samples copied out */
+	struct pobj_lat_sample *samples;  /* user-provided buffer */
+};
+
 enum pobj_stats_enabled {
 	POBJ_STATS_ENABLED_TRANSIENT,
 	POBJ_STATS_ENABLED_BOTH,
@@ -144,6 +166,50 @@ enum pobj_stats_enabled {
 	POBJ_STATS_DISABLED,
 };
 
+/*
+ * Header of the binary statistics block a pool can optionally publish in a
+ * POSIX shared memory segment (see the stats.export.* ctl namespace).
+ *
+ * The block consists of this header followed by an array of per-thread
+ * counter shards; a reader obtains an aggregate value by summing the given
+ * counter across all shards. All counters are 64-bit and updated in place by
+ * the publishing process, so a monitoring agent that mapped the segment can
+ * sample them with plain loads - no syscalls and no library calls. Individual
+ * loads are atomic, but there is no snapshot consistency across counters.
+ *
+ * The layout of a shard is described by the offset fields rather than by a
+ * public structure, so that new counters can be added without breaking
+ * existing readers. The signature is stored last during initialization -
+ * a reader that finds it in place can trust the remaining fields.
+ */
+#define POBJ_STATS_EXPORT_SIGNATURE "PMDKSTAT"
+#define POBJ_STATS_EXPORT_VERSION 1
+#define POBJ_STATS_EXPORT_NAME_MAX 64
+
+struct pobj_stats_export {
+	char signature[8];	/* POBJ_STATS_EXPORT_SIGNATURE */
+	uint64_t version;	/* POBJ_STATS_EXPORT_VERSION */
+	uint64_t size;		/* total size of the segment in bytes */
+	uint64_t pid;		/* process id of the publisher */
+
+	/* location and layout of the transient counter shards */
+	uint64_t shards_offset;	/* from the start of the block */
+	uint64_t nshards;
+	uint64_t shard_size;
+	uint64_t run_allocated_offset;		/* within a shard */
+	uint64_t run_active_offset;		/* within a shard */
+	uint64_t alloc_histogram_offset;	/* within a shard */
+	uint64_t alloc_histogram_unit;		/* bucket width in bytes */
+	uint64_t alloc_histogram_buckets;
+	uint64_t tx_histogram_offset;		/* within a shard */
+	uint64_t tx_histogram_buckets;
+
+	/* mirror of the persistent heap occupancy counter */
+	uint64_t heap_curr_allocated;
+
+	uint64_t reserved[9];
+};
+
 enum pobj_arenas_assignment_type {
 	POBJ_ARENAS_ASSIGNMENT_THREAD_KEY,
 	POBJ_ARENAS_ASSIGNMENT_GLOBAL,
@@ -154,6 +220,33 @@ int pmemobj_ctl_get(PMEMobjpool *pop, const char *name, void *arg);
 int pmemobj_ctl_set(PMEMobjpool *pop, const char *name, void *arg);
 int pmemobj_ctl_exec(PMEMobjpool *pop, const char *name, void *arg);
 
+/*
+ * A pre-compiled ctl query. The entry point name is parsed and resolved only
+ * once, in pmemobj_ctl_handle_new(), which makes the handle-based variants
+ * below significantly cheaper than pmemobj_ctl_get/set/exec for queries that
+ * are executed repeatedly (e.g., periodic statistics polling).
+ *
+ * A handle is bound to the pool it was compiled for and must not outlive it.
+ */
+struct pobj_ctl_handle;
+
+struct pobj_ctl_handle *pmemobj_ctl_handle_new(PMEMobjpool *pop,
+	const char *name);
+void pmemobj_ctl_handle_delete(struct pobj_ctl_handle *handle);
+int pmemobj_ctl_get_handle(PMEMobjpool *pop, struct pobj_ctl_handle *handle,
+	void *arg);
+int pmemobj_ctl_set_handle(PMEMobjpool *pop, struct pobj_ctl_handle *handle,
+	void *arg);
+
+/*
+ * Executes nqueries read queries in a single call. Entry number i reads
+ * handles[i] into args[i]. Returns 0 only if all queries succeeded; stops and
+ * returns -1 on the first failure, leaving the results of the preceding
+ * queries filled in.
+ */
+int pmemobj_ctl_get_multi(PMEMobjpool *pop, struct pobj_ctl_handle **handles,
+	void **args, size_t nqueries);
+
 #ifdef __cplusplus
 }
 #endif
@@ -32,6 +32,34 @@ PMEMoid pmemobj_first(PMEMobjpool *pop);
  */
 PMEMoid pmemobj_next(PMEMoid oid);
 
+/*
+ * The type of the callback invoked by pmemobj_scan() for every object.
+ * A non-zero return value stops the scan.
+ */
+typedef int pmemobj_scan_cb(PMEMoid oid, void *arg);
+
+/*
+ * Invokes the callback for every object in the pool in physical
+ * (zone/chunk/run) order, which makes a full-pool scan access the memory
+ * sequentially - unlike a pmemobj_first()/pmemobj_next() loop, which also
+ * re-walks the heap metadata on every step. A non-zero prefetch makes the
+ * scan fetch the data of that many objects ahead of the callback.
+ * Returns the first non-zero value returned by the callback, or 0 when
+ * the whole pool has been scanned.
+ */
+int pmemobj_scan(PMEMobjpool *pop, pmemobj_scan_cb *cb, void *arg,
+	unsigned prefetch);
+
+/*
+ * Invokes the callback for every object residing in a run whose occupancy
+ * is strictly below max_occupancy_pct percent. Relocating those objects
+ * with pmemobj_defrag() releases the underlying chunks, so they make the
+ * most profitable defragmentation candidates. A non-zero return value of
+ * the callback stops the traversal and is propagated to the caller.
+ */
+int pmemobj_defrag_candidates(PMEMobjpool *pop, unsigned max_occupancy_pct,
+	pmemobj_scan_cb *cb, void *arg);
+
 #ifdef __cplusplus
 }
 #endif
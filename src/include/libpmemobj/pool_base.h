@@ -12,6 +12,7 @@
 #include <sys/types.h>
 
 #include <libpmemobj/base.h>
+#include <libpmemobj/types.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -35,6 +36,37 @@ PMEMobjpool *pmemobj_create(const char *path, const char *layout,
 
 int pmemobj_check(const char *path, const char *layout);
 
+/*
+ * Fast consistency check tier - verifies only the metadata checksums, the
+ * heap headers and the lane consistency, without walking the entire heap.
+ */
+int pmemobj_check_quick(const char *path, const char *layout);
+
+/*
+ * Filled in by pmemobj_probe() from the pool header and descriptor alone.
+ */
+struct pmemobj_probe_info {
+	char layout[PMEMOBJ_MAX_LAYOUT];	/* layout the pool holds */
+	uint32_t major;		/* on-media format version of the pool */
+	uint32_t compat_features;
+	uint32_t incompat_features;
+	uint32_t ro_compat_features;
+	uint64_t created;	/* creation time, seconds since the epoch */
+};
+
+/*
+ * Checks whether the file (or poolset) at path is an obj pool this library
+ * can open, reading only the pool header and descriptor - no mapping, no
+ * heap or lane boot - so thousands of candidate files can be classified in
+ * the time a single pmemobj_open() would take. Returns 0 and fills info
+ * (which may be NULL) when the pool is compatible; returns -1 with errno
+ * set when it is not a pool, is of an incompatible version or feature set,
+ * or cannot be read. A successful probe does not guarantee a later open
+ * will succeed - the pool may still be locked, inconsistent beyond the
+ * descriptor, or concurrently modified.
+ */
+int pmemobj_probe(const char *path, struct pmemobj_probe_info *info);
+
 void pmemobj_close(PMEMobjpool *pop);
 /*
  * If called for the first time on a newly created pool, the root object
@@ -70,6 +102,98 @@ void pmemobj_set_user_data(PMEMobjpool *pop, void *data);
  */
 void *pmemobj_get_user_data(PMEMobjpool *pop);
 
+/*
+ * User-pluggable replica transport. Once attached, write() receives every
+ * range the library writes to the pool - pool-relative offset, a pointer to
+ * the new content and its length - with the same coalescing as the local
+ * stores, and drain() is called wherever the local store fence would be
+ * issued, so a transport can post writes asynchronously and treat drain as
+ * the completion barrier.
+ */
+struct pobj_replica_ops {
+	void (*write)(void *ctx, size_t offset, const void *data, size_t len);
+	void (*drain)(void *ctx);
+};
+
+/*
+ * Attaches a replica transport to the pool. May only be called when no other
+ * thread operates on the pool. Both callbacks are mandatory.
+ */
+int pmemobj_replica_attach(PMEMobjpool *pop,
+	const struct pobj_replica_ops *ops, void *ctx);
+
+/*
+ * Detaches the replica transport, under the same quiescence requirement.
+ */
+void pmemobj_replica_detach(PMEMobjpool *pop);
+
+/*
+ * Translates an oid into a pointer to the pool's DRAM shadow of the object,
+ * removing pmem read latency from lookups on the returned copy.
+ *
+ * The shadow is enabled per pool through the "shadow.enabled" ctl and is a
+ * volatile mirror kept write-through: every range the library writes to the
+ * pool is also copied into DRAM, so the mirror follows transactional commits
+ * and allocator activity. Stores made directly through pmemobj_direct()
+ * pointers reach the mirror only once they are persisted or flushed through
+ * the library. The returned pointer must be treated as read-only.
+ *
+ * When the pool has no shadow, this is equivalent to pmemobj_direct().
+ */
+void *pmemobj_direct_shadow(PMEMoid oid);
+
+/*
+ * Starts a background walk that faults the pool's heap into memory, hottest
+ * zones (as sampled by the allocator) first, so that a freshly opened pool
+ * reaches steady-state read latency without waiting for demand paging.
+ *
+ * rate_mbps caps the warmup bandwidth in megabytes per second; 0 leaves the
+ * walk unthrottled. Returns 0 when the warmup thread was started, or -1 with
+ * errno set to EBUSY when a previous warmup is still in flight. The walk
+ * finishes on its own and is stopped early if the pool is closed.
+ */
+int pmemobj_warmup(PMEMobjpool *pop, unsigned rate_mbps);
+
+/*
+ * Called by the background scrubber for every bad page it discovers, with
+ * the offset and length of the unreadable range relative to the beginning
+ * of the pool. The callback runs on the pool's maintenance thread and must
+ * not touch the reported range.
+ */
+typedef void (*pmemobj_scrub_cb)(PMEMobjpool *pop, size_t offset,
+	size_t length, void *arg);
+
+/*
+ * Registers the callback the background scrubber reports bad pages to,
+ * replacing any previous one; a NULL cb unregisters. The scrubber itself is
+ * driven by the "scrub.rate" ctl and reports through the scrub ctl counters
+ * whether or not a callback is registered.
+ */
+int pmemobj_scrub_callback(PMEMobjpool *pop, pmemobj_scrub_cb cb, void *arg);
+
+/*
+ * Heap occupancy levels reported by the watermark callback.
+ */
+enum pobj_watermark {
+	POBJ_WATERMARK_NORMAL,	/* occupancy fell back below the low mark */
+	POBJ_WATERMARK_HIGH,	/* occupancy crossed the high mark */
+};
+
+typedef void (*pmemobj_watermark_cb)(PMEMobjpool *pop,
+	enum pobj_watermark level, void *arg);
+
+/*
+ * Registers the callback invoked when heap occupancy crosses the watermarks
+ * configured through the "heap.watermark.high" and "heap.watermark.low"
+ * ctls (percentages of the heap size), replacing any previous one; a NULL
+ * cb unregisters. The allocation path only pays for a comparison - the
+ * callback itself runs on the pool's maintenance thread, outside of any
+ * allocator lock, so an eviction pass may allocate, free and run
+ * transactions on the pool directly from the callback.
+ */
+int pmemobj_watermark_callback(PMEMobjpool *pop, pmemobj_watermark_cb cb,
+	void *arg);
+
 #ifdef __cplusplus
 }
 #endif
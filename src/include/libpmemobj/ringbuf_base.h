@@ -0,0 +1,56 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright 2024, Intel Corporation */
+
+/*
+ * libpmemobj/ringbuf_base.h -- definitions of libpmemobj persistent ring
+ * buffer
+ */
+
+#ifndef LIBPMEMOBJ_RINGBUF_BASE_H
+#define LIBPMEMOBJ_RINGBUF_BASE_H 1
+
+#include <libpmemobj/base.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Non-transactional persistent multi-producer single-consumer ring buffer
+ * of fixed-capacity records. Appends are lock-free and commit a record with
+ * a single atomic store; a batch of records is consumed with a single
+ * atomic update of the consumer position.
+ */
+
+/*
+ * Allocates a ring buffer with room for at least nentries records of up to
+ * entry_size bytes each; the capacity is rounded up to a power of two.
+ */
+int pmemobj_ringbuf_new(PMEMobjpool *pop, PMEMoid *oidp, size_t entry_size,
+	size_t nentries, uint64_t type_num);
+
+/*
+ * Appends a record. Fails with EAGAIN when the buffer is full and with
+ * EINVAL when the record does not fit into a single entry.
+ */
+int pmemobj_ringbuf_enqueue(PMEMobjpool *pop, PMEMoid rb_oid,
+	const void *data, size_t len);
+
+/*
+ * Batch consumption callback, a nonzero return value ends the batch after
+ * the current record.
+ */
+typedef int (*pmemobj_ringbuf_cb)(const void *data, size_t len, void *arg);
+
+/*
+ * Consumes up to max records (0 means no limit) in commit order. Returns
+ * the number of records consumed, 0 when the buffer is empty.
+ */
+size_t pmemobj_ringbuf_dequeue(PMEMobjpool *pop, PMEMoid rb_oid, size_t max,
+	pmemobj_ringbuf_cb cb, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* libpmemobj/ringbuf_base.h */
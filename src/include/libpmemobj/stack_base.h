@@ -0,0 +1,55 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright 2024, Intel Corporation */
+
+/*
+ * libpmemobj/stack_base.h -- definitions of libpmemobj persistent stack
+ */
+
+#ifndef LIBPMEMOBJ_STACK_BASE_H
+#define LIBPMEMOBJ_STACK_BASE_H 1
+
+#include <libpmemobj/base.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Non-transactional persistent bounded stack of fixed-capacity records,
+ * the LIFO companion of the ring buffer. Pushes and pops never take a
+ * lock; every record is committed and released with a single atomic
+ * 8-byte store.
+ */
+
+/*
+ * Allocates a stack with room for nentries records of up to entry_size
+ * bytes each.
+ */
+int pmemobj_stack_new(PMEMobjpool *pop, PMEMoid *oidp, size_t entry_size,
+	size_t nentries, uint64_t type_num);
+
+/*
+ * Pushes a record. Fails with EAGAIN when the stack is full and with
+ * EINVAL when the record does not fit into a single entry.
+ */
+int pmemobj_stack_push(PMEMobjpool *pop, PMEMoid st_oid,
+	const void *data, size_t len);
+
+/*
+ * Batch consumption callback, a nonzero return value ends the batch after
+ * the current record.
+ */
+typedef int (*pmemobj_stack_cb)(const void *data, size_t len, void *arg);
+
+/*
+ * Pops up to max records (0 means no limit) newest-first. Returns the
+ * number of records popped, 0 when the stack is empty.
+ */
+size_t pmemobj_stack_pop(PMEMobjpool *pop, PMEMoid st_oid, size_t max,
+	pmemobj_stack_cb cb, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* libpmemobj/stack_base.h */
@@ -90,6 +90,26 @@ _pobj_validate_cb_sig(pmemobj_tx_callback cb)
 		errno = _pobj_errno;\
 }
 
+/*
+ * _pobj_tx_add_range_direct_sized -- (internal) dispatches a range add to
+ * a size-specialized entry point
+ *
+ * The size is a compile-time constant at every macro call site, so the
+ * switch is resolved by the compiler and small fixed-size fields go
+ * straight to the specialized entry point.
+ */
+static inline int
+_pobj_tx_add_range_direct_sized(const void *ptr, size_t size)
+{
+	switch (size) {
+		case 8: return pmemobj_tx_add_range_direct8(ptr);
+		case 16: return pmemobj_tx_add_range_direct16(ptr);
+		case 32: return pmemobj_tx_add_range_direct32(ptr);
+		case 64: return pmemobj_tx_add_range_direct64(ptr);
+		default: return pmemobj_tx_add_range_direct(ptr, size);
+	}
+}
+
 #define TX_ADD(o)\
 pmemobj_tx_add_range((o).oid, 0, sizeof(*(o)._type))
 
@@ -97,10 +117,10 @@ pmemobj_tx_add_range((o).oid, 0, sizeof(*(o)._type))
 	TX_ADD_DIRECT(&(D_RO(o)->field))
 
 #define TX_ADD_DIRECT(p)\
-pmemobj_tx_add_range_direct(p, sizeof(*(p)))
+_pobj_tx_add_range_direct_sized(p, sizeof(*(p)))
 
 #define TX_ADD_FIELD_DIRECT(p, field)\
-pmemobj_tx_add_range_direct(&(p)->field, sizeof((p)->field))
+_pobj_tx_add_range_direct_sized(&(p)->field, sizeof((p)->field))
 
 #define TX_XADD(o, flags)\
 pmemobj_tx_xadd_range((o).oid, 0, sizeof(*(o)._type), flags)
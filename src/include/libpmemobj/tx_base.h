@@ -43,6 +43,16 @@ enum pobj_tx_param {
 	TX_PARAM_MUTEX,	 /* PMEMmutex */
 	TX_PARAM_RWLOCK, /* PMEMrwlock */
 	TX_PARAM_CB,	 /* pmemobj_tx_callback cb, void *arg */
+
+	/*
+	 * No arguments. Marks the transaction as large: it runs on a lane
+	 * from the class reserved through the "tx.big_lanes.count" ctl,
+	 * pre-sized to the "tx.big_lanes.log_size" undo log capacity, so
+	 * its log growth does not interfere with concurrent small
+	 * transactions. Applies to the outermost level only; ignored when
+	 * no lanes are reserved.
+	 */
+	TX_PARAM_LARGE,
 };
 
 enum pobj_log_type {
@@ -97,20 +107,26 @@ enum tx_lock_deprecated pobj_tx_lock {
 typedef void (*pmemobj_tx_callback)(PMEMobjpool *pop, enum pobj_tx_stage stage,
 		void *);
 
+typedef int (*pmemobj_tx_read_validator)(PMEMobjpool *pop, const void *addr,
+		size_t size, void *arg);
+
 #define POBJ_TX_XALLOC_VALID_FLAGS	(POBJ_XALLOC_ZERO |\
 	POBJ_XALLOC_NO_FLUSH |\
 	POBJ_XALLOC_ARENA_MASK |\
 	POBJ_XALLOC_CLASS_MASK |\
-	POBJ_XALLOC_NO_ABORT)
+	POBJ_XALLOC_NO_ABORT |\
+	POBJ_XALLOC_GENERATION)
 
 #define POBJ_XADD_NO_FLUSH		POBJ_FLAG_NO_FLUSH
 #define POBJ_XADD_NO_SNAPSHOT		POBJ_FLAG_NO_SNAPSHOT
 #define POBJ_XADD_ASSUME_INITIALIZED	POBJ_FLAG_ASSUME_INITIALIZED
 #define POBJ_XADD_NO_ABORT		POBJ_FLAG_TX_NO_ABORT
+#define POBJ_XADD_READ_ONLY		POBJ_FLAG_READ_ONLY
 #define POBJ_XADD_VALID_FLAGS	(POBJ_XADD_NO_FLUSH |\
 	POBJ_XADD_NO_SNAPSHOT |\
 	POBJ_XADD_ASSUME_INITIALIZED |\
-	POBJ_XADD_NO_ABORT)
+	POBJ_XADD_NO_ABORT |\
+	POBJ_XADD_READ_ONLY)
 
 #define POBJ_XLOCK_NO_ABORT		POBJ_FLAG_TX_NO_ABORT
 #define POBJ_XLOCK_VALID_FLAGS	(POBJ_XLOCK_NO_ABORT)
@@ -133,6 +149,32 @@ typedef void (*pmemobj_tx_callback)(PMEMobjpool *pop, enum pobj_tx_stage stage,
  */
 int pmemobj_tx_begin(PMEMobjpool *pop, jmp_buf env, ...);
 
+/*
+ * Starts a new transaction coupled with a second pool. Must not be called
+ * within an open transaction.
+ *
+ * Ranges of either pool can be added to the transaction with the regular
+ * pmemobj_tx_add_range family and either all of them or none become durable,
+ * decided atomically by the commit of the primary pool. Allocations, locks
+ * and the read validator operate on the primary pool only.
+ *
+ * A pool can take part in one coupled transaction at a time. A transaction
+ * a crash left undecided between the two pools is resolved here before the
+ * new one starts.
+ */
+int pmemobj_tx_begin_multi(PMEMobjpool *pop, PMEMobjpool *pop2,
+	jmp_buf env, ...);
+
+/*
+ * Resolves a coupled transaction a crash left undecided in 'pop', using the
+ * commit record of its primary pool 'peer'. Called implicitly by
+ * pmemobj_tx_begin_multi; needed explicitly only when the pools are not
+ * going to be coupled again after the restart.
+ *
+ * Returns zero when nothing was pending or the transaction was resolved.
+ */
+int pmemobj_tx_multi_recover(PMEMobjpool *pop, PMEMobjpool *peer);
+
 /*
  * Adds lock of given type to current transaction.
  * 'Flags' is a bitmask of the following values:
@@ -162,6 +204,26 @@ void pmemobj_tx_abort(int errnum);
  */
 void pmemobj_tx_commit(void);
 
+/*
+ * Commits current transaction, deferring the cleanup of the transaction logs.
+ *
+ * The transaction is durable once this function returns. The deferred log
+ * maintenance is performed by pmemobj_tx_commit_complete(), or automatically
+ * at the beginning of the next transaction on the calling thread. It has to
+ * complete on the same thread and before the pool is closed.
+ *
+ * This function must be called during TX_STAGE_WORK.
+ */
+void pmemobj_tx_commit_async(void);
+
+/*
+ * Completes the cleanup deferred by pmemobj_tx_commit_async(), if any.
+ *
+ * This function must be called on the thread that committed the transaction
+ * and must *not* be called during TX_STAGE_WORK.
+ */
+void pmemobj_tx_commit_complete(void);
+
 /*
  * Cleanups current transaction. Must always be called after pmemobj_tx_begin,
  * even if starting the transaction failed.
@@ -219,6 +281,16 @@ int pmemobj_tx_add_range(PMEMoid oid, uint64_t off, size_t size);
  */
 int pmemobj_tx_add_range_direct(const void *ptr, size_t size);
 
+/*
+ * Size-specialized variants of pmemobj_tx_add_range_direct for small fixed
+ * size ranges, selected at compile time by the TX_ADD and TX_SET macro
+ * families.
+ */
+int pmemobj_tx_add_range_direct8(const void *ptr);
+int pmemobj_tx_add_range_direct16(const void *ptr);
+int pmemobj_tx_add_range_direct32(const void *ptr);
+int pmemobj_tx_add_range_direct64(const void *ptr);
+
 /*
  * Behaves exactly the same as pmemobj_tx_add_range when 'flags' equals 0.
  * 'Flags' is a bitmask of the following values:
@@ -227,6 +299,8 @@ int pmemobj_tx_add_range_direct(const void *ptr, size_t size);
  *  - POBJ_XADD_ASSUME_INITIALIZED - added range is assumed to be initialized
  *  - POBJ_XADD_NO_ABORT - if the function does not end successfully,
  *  do not abort the transaction and return the error number.
+ *  - POBJ_XADD_READ_ONLY - the range is added to the transaction read-set
+ *  instead of being snapshotted, see pmemobj_tx_set_read_validator.
  */
 int pmemobj_tx_xadd_range(PMEMoid oid, uint64_t off, size_t size,
 		uint64_t flags);
@@ -239,6 +313,8 @@ int pmemobj_tx_xadd_range(PMEMoid oid, uint64_t off, size_t size,
  *  - POBJ_XADD_ASSUME_INITIALIZED - added range is assumed to be initialized
  *  - POBJ_XADD_NO_ABORT - if the function does not end successfully,
  *  do not abort the transaction and return the error number.
+ *  - POBJ_XADD_READ_ONLY - the range is added to the transaction read-set
+ *  instead of being snapshotted, see pmemobj_tx_set_read_validator.
  */
 int pmemobj_tx_xadd_range_direct(const void *ptr, size_t size, uint64_t flags);
 
@@ -297,6 +373,40 @@ PMEMoid pmemobj_tx_realloc(PMEMoid oid, size_t size, uint64_t type_num);
  */
 PMEMoid pmemobj_tx_zrealloc(PMEMoid oid, size_t size, uint64_t type_num);
 
+/*
+ * Transactionally replaces the object referenced by dest with a new
+ * allocation, without snapshotting either one.
+ *
+ * The new object holds a copy of src, or is left uninitialized when src is
+ * NULL, in which case the caller is expected to fill it in, through
+ * pmemobj_direct(), before the transaction commits. The reference under dest
+ * is updated through the redo log at commit time and the previously
+ * referenced object, if any, is freed - on abort, dest and the old object
+ * are left untouched. This avoids the undo copy of the old data that an
+ * in-place update of the same size would have made.
+ *
+ * If successful, returns the PMEMoid of the new object.
+ * Otherwise, stage changes to TX_STAGE_ONABORT and an OID_NULL is returned.
+ *
+ * This function must be called during TX_STAGE_WORK.
+ */
+PMEMoid pmemobj_tx_replace(PMEMoid *dest, const void *src, size_t size,
+		uint64_t type_num);
+
+/*
+ * Transactionally replaces the object referenced by dest with a new
+ * allocation, without snapshotting either one.
+ *
+ * Behaves exactly the same as pmemobj_tx_replace when 'flags' equals zero.
+ * 'Flags' is a bitmask of the following values:
+ *  - POBJ_XALLOC_ZERO - zero the allocated object
+ *  - POBJ_XALLOC_NO_FLUSH - skip flush on commit
+ *  - POBJ_XALLOC_NO_ABORT - if the function does not end successfully,
+ *  do not abort the transaction and return the error number.
+ */
+PMEMoid pmemobj_tx_xreplace(PMEMoid *dest, const void *src, size_t size,
+		uint64_t type_num, uint64_t flags);
+
 /*
  * Transactionally allocates a new object with duplicate of the string s.
  *
@@ -398,6 +508,16 @@ int pmemobj_tx_log_append_buffer(enum pobj_log_type type,
 int pmemobj_tx_xlog_append_buffer(enum pobj_log_type type,
 	void *addr, size_t size, uint64_t flags);
 
+/*
+ * Ensures that the given transaction log has the requested capacity,
+ * extending it immediately if needed.
+ *
+ * If successful, returns zero. Otherwise, returns -1 and sets errno.
+ *
+ * This function must be called during TX_STAGE_WORK.
+ */
+int pmemobj_tx_log_reserve(enum pobj_log_type type, size_t size);
+
 /*
  * Enables or disables automatic ulog allocations.
  *
@@ -423,12 +543,41 @@ size_t pmemobj_tx_log_intents_max_size(size_t nintents);
  */
 void pmemobj_tx_set_user_data(void *data);
 
+/*
+ * Sets the read-set validation callback of the current transaction.
+ *
+ * The validator is invoked on commit of the outermost transaction, once for
+ * every range added with POBJ_XADD_READ_ONLY, before any of the transaction's
+ * changes are made durable. If it returns a non-zero value for any range, the
+ * commit turns into an abort with ECANCELED.
+ */
+void pmemobj_tx_set_read_validator(pmemobj_tx_read_validator validator,
+		void *arg);
+
 /*
  * Gets volatile pointer to the user data associated with the current
  * transaction.
  */
 void *pmemobj_tx_get_user_data(void);
 
+/*
+ * Resource usage counters of a single transaction, reset when the outermost
+ * transaction starts.
+ */
+struct pobj_tx_stats {
+	uint64_t snapshots; /* number of ranges snapshotted to the undo log */
+	uint64_t snapshot_bytes; /* payload bytes copied into the undo log */
+	uint64_t ulog_extensions; /* on-demand undo log extensions */
+	uint64_t flushes; /* flush operations issued by the transaction */
+};
+
+/*
+ * Retrieves the resource usage counters of the current transaction. May be
+ * called in any stage; returns -1 and sets errno if no transaction is in
+ * progress in this thread.
+ */
+int pmemobj_tx_get_stats(struct pobj_tx_stats *stats);
+
 /*
  * Sets the failure behavior of transactional functions.
  *
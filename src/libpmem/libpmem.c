@@ -39,6 +39,7 @@ libpmem_fini(void)
 {
 	LOG(3, NULL);
 
+	pmem_flush_stats_dump();
 	common_fini();
 }
 
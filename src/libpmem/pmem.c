@@ -139,8 +139,11 @@
 
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
 
 #include "libpmem.h"
 #include "pmem.h"
@@ -152,6 +155,7 @@
 #include "valgrind_internal.h"
 #include "os_deep.h"
 #include "auto_flush.h"
+#include "storelog.h"
 
 struct pmem_funcs {
 	struct memmove_nodrain memmove_funcs;
@@ -162,11 +166,88 @@ struct pmem_funcs {
 	flush_func deep_flush;
 	flush_func flush;
 	fence_func fence;
+	store_line_func store_line;
+	store_16b_func store_16b;
+	store_8b_nt_func store_8b_nt;
 };
 
 static struct pmem_funcs Funcs;
 static is_pmem_func Is_pmem = NULL;
 
+/*
+ * Opt-in flush traffic accounting, enabled with PMEM_FLUSH_STATS=1.
+ * The counters are shared and bumped with fetch-and-add - per-thread
+ * counters would be cheaper, but their content could not be collected
+ * from threads already gone by the time the report is printed at exit.
+ * The hot paths only pay for a predictable branch when the accounting
+ * is disabled.
+ */
+static int Flush_stats_enabled;
+
+static struct flush_stats {
+	uint64_t flush_calls;	/* pmem_flush() and pmem_persist() flushes */
+	uint64_t flush_bytes;	/* bytes covered by the above */
+	uint64_t drain_calls;	/* hw drains (fences) issued */
+	uint64_t store_bytes_nt; /* stores requested as non-temporal */
+	uint64_t store_bytes_t;	/* stores requested as temporal */
+	uint64_t store_bytes_auto; /* stores left to the threshold dispatch */
+} Flush_stats;
+
+/*
+ * flush_stats_count_store -- (internal) account bytes written through the
+ * memcpy/memset entry points, split by the requested store type
+ */
+static inline void
+flush_stats_count_store(size_t len, unsigned flags)
+{
+	if (likely(!Flush_stats_enabled))
+		return;
+
+	if (flags & (PMEM_F_MEM_NONTEMPORAL | PMEM_F_MEM_WC))
+		util_fetch_and_add64(&Flush_stats.store_bytes_nt, len);
+	else if (flags & (PMEM_F_MEM_TEMPORAL | PMEM_F_MEM_WB))
+		util_fetch_and_add64(&Flush_stats.store_bytes_t, len);
+	else
+		util_fetch_and_add64(&Flush_stats.store_bytes_auto, len);
+}
+
+/*
+ * storelog_range -- (internal) records the stores and flushes issued
+ * internally by the memcpy/memset entry points when store logging is enabled
+ */
+static inline void
+storelog_range(const void *pmemdest, size_t len)
+{
+	if (unlikely(Storelog_enabled))
+		storelog_flush(pmemdest, len);
+}
+
+/*
+ * pmem_flush_stats_dump -- print the flush accounting report at exit
+ */
+void
+pmem_flush_stats_dump(void)
+{
+	LOG(3, NULL);
+
+	if (!Flush_stats_enabled)
+		return;
+
+	fprintf(stderr, "libpmem flush statistics:\n");
+	fprintf(stderr, "\tflush calls:\t\t%" PRIu64 "\n",
+			Flush_stats.flush_calls);
+	fprintf(stderr, "\tflushed bytes:\t\t%" PRIu64 "\n",
+			Flush_stats.flush_bytes);
+	fprintf(stderr, "\tdrain calls:\t\t%" PRIu64 "\n",
+			Flush_stats.drain_calls);
+	fprintf(stderr, "\tnt store bytes:\t\t%" PRIu64 "\n",
+			Flush_stats.store_bytes_nt);
+	fprintf(stderr, "\tcached store bytes:\t%" PRIu64 "\n",
+			Flush_stats.store_bytes_t);
+	fprintf(stderr, "\tauto store bytes:\t%" PRIu64 "\n",
+			Flush_stats.store_bytes_auto);
+}
+
 /*
  * pmem_has_hw_drain -- return whether or not HW drain was found
  *
@@ -188,6 +269,12 @@ pmem_drain(void)
 {
 	LOG(15, NULL);
 
+	if (unlikely(Flush_stats_enabled))
+		util_fetch_and_add64(&Flush_stats.drain_calls, 1);
+
+	if (unlikely(Storelog_enabled))
+		storelog_fence();
+
 	Funcs.fence();
 }
 
@@ -202,6 +289,153 @@ pmem_has_auto_flush()
 	return pmem2_auto_flush();
 }
 
+/*
+ * pmem_memcpy_impl -- return the name of the memcpy/memset kernel family
+ *	selected at library initialization
+ */
+const char *
+pmem_memcpy_impl(void)
+{
+	LOG(3, NULL);
+
+	return Pmem2_memcpy_impl;
+}
+
+/*
+ * pmem_flush_impl -- return the name of the cache flush instruction
+ *	selected at library initialization
+ */
+const char *
+pmem_flush_impl(void)
+{
+	LOG(3, NULL);
+
+	return Pmem2_flush_impl;
+}
+
+/*
+ * pmem_movnt_threshold -- return the copy size, in bytes, from which the
+ *	memcpy/memset functions switch to non-temporal stores
+ */
+size_t
+pmem_movnt_threshold(void)
+{
+	LOG(3, NULL);
+
+	return Movnt_threshold;
+}
+
+/*
+ * pmem_movnt_threshold_set -- override the non-temporal store threshold
+ *
+ * The threshold is process-global; it has no effect when non-temporal
+ * stores are unsupported or disabled.
+ */
+void
+pmem_movnt_threshold_set(size_t threshold)
+{
+	LOG(3, "threshold %zu", threshold);
+
+	Movnt_threshold = threshold;
+}
+
+/*
+ * pmem_has_store_line -- check if the CPU can persist one full cache line
+ * atomically with a single direct store
+ */
+int
+pmem_has_store_line(void)
+{
+	LOG(3, NULL);
+
+	return Funcs.store_line != NULL;
+}
+
+/*
+ * pmem_store_line -- persist one full cache line with a direct store
+ *
+ * pmemdest must be aligned to the cache line size. The store bypasses the
+ * CPU cache, so no flush is needed - only pmem_drain() to order it against
+ * later stores. When the CPU has no direct store instruction the line is
+ * copied and persisted the regular way, which is not atomic - callers
+ * relying on atomicity must check pmem_has_store_line() first.
+ */
+void
+pmem_store_line(void *pmemdest, const void *src)
+{
+	LOG(15, "pmemdest %p src %p", pmemdest, src);
+
+	if (Funcs.store_line) {
+		Funcs.store_line(pmemdest, src);
+		storelog_range(pmemdest, CACHELINE_SIZE);
+		return;
+	}
+
+	pmem_memcpy_persist(pmemdest, src, CACHELINE_SIZE);
+}
+
+/*
+ * pmem_has_store_16b -- check if the CPU can store a 16-byte value atomically
+ */
+int
+pmem_has_store_16b(void)
+{
+	LOG(3, NULL);
+
+	return Funcs.store_16b != NULL;
+}
+
+/*
+ * pmem_store_16b -- persist one 16-byte value with an atomic store
+ *
+ * pmemdest must be 16-byte aligned. Unlike pmem_store_line() the data goes
+ * through the CPU cache, so it is flushed and drained here. When the CPU has
+ * no 16-byte atomic store the value is copied and persisted the regular way,
+ * which is not atomic - callers relying on atomicity must check
+ * pmem_has_store_16b() first.
+ */
+void
+pmem_store_16b(void *pmemdest, const void *src)
+{
+	LOG(15, "pmemdest %p src %p", pmemdest, src);
+
+	if (Funcs.store_16b) {
+		Funcs.store_16b(pmemdest, src);
+		pmem_persist(pmemdest, 16);
+		return;
+	}
+
+	pmem_memcpy_persist(pmemdest, src, 16);
+}
+
+/*
+ * pmem_has_store_8b_nt -- check if the CPU can store 8 bytes atomically while
+ * bypassing the cache
+ */
+int
+pmem_has_store_8b_nt(void)
+{
+	LOG(3, NULL);
+
+	return Funcs.store_8b_nt != NULL;
+}
+
+/*
+ * pmem_store_8b_nt -- store one 8-byte value with an atomic non-temporal store
+ *
+ * pmemdest must be 8-byte aligned. The data bypasses the CPU cache and is
+ * persistent once pmem_drain() returns, no flush is needed. Available only
+ * when pmem_has_store_8b_nt() returns true.
+ */
+void
+pmem_store_8b_nt(void *pmemdest, const void *src)
+{
+	LOG(15, "pmemdest %p src %p", pmemdest, src);
+
+	Funcs.store_8b_nt(pmemdest, src);
+	storelog_range(pmemdest, sizeof(uint64_t));
+}
+
 /*
  * pmem_deep_flush -- flush processor cache for the given range
  * regardless of eADR support on platform
@@ -226,6 +460,14 @@ pmem_flush(const void *addr, size_t len)
 
 	VALGRIND_DO_CHECK_MEM_IS_ADDRESSABLE(addr, len);
 
+	if (unlikely(Flush_stats_enabled)) {
+		util_fetch_and_add64(&Flush_stats.flush_calls, 1);
+		util_fetch_and_add64(&Flush_stats.flush_bytes, len);
+	}
+
+	if (unlikely(Storelog_enabled))
+		storelog_flush(addr, len);
+
 	Funcs.flush(addr, len);
 }
 
@@ -241,6 +483,35 @@ pmem_persist(const void *addr, size_t len)
 	pmem_drain();
 }
 
+/*
+ * pmem_persist_nodrain -- make a range of pmem persistent, defer the drain
+ *
+ * This is the flush step of pmem_persist() only.  The caller batches
+ * several of these and completes them all with a single pmem_drain_all().
+ */
+void
+pmem_persist_nodrain(const void *addr, size_t len)
+{
+	LOG(15, "addr %p len %zu", addr, len);
+
+	pmem_flush(addr, len);
+}
+
+/*
+ * pmem_drain_all -- wait for all outstanding deferred flushes to drain
+ *
+ * A single drain instruction orders every flush issued by the calling
+ * thread, so this is simply pmem_drain() under a name that documents
+ * the pairing with pmem_persist_nodrain().
+ */
+void
+pmem_drain_all(void)
+{
+	LOG(15, NULL);
+
+	pmem_drain();
+}
+
 /*
  * pmem_msync -- flush to persistence via msync
  *
@@ -384,7 +655,8 @@ pmem_is_pmem(const void *addr, size_t len)
 }
 
 #define PMEM_FILE_ALL_FLAGS\
-	(PMEM_FILE_CREATE|PMEM_FILE_EXCL|PMEM_FILE_SPARSE|PMEM_FILE_TMPFILE)
+	(PMEM_FILE_CREATE|PMEM_FILE_EXCL|PMEM_FILE_SPARSE|PMEM_FILE_TMPFILE|\
+	PMEM_FILE_ALIGN_2M|PMEM_FILE_ALIGN_1G)
 
 #define PMEM_DAX_VALID_FLAGS\
 	(PMEM_FILE_CREATE|PMEM_FILE_SPARSE)
@@ -415,6 +687,25 @@ pmem_map_fileU(const char *path, size_t len, int flags,
 		return NULL;
 	}
 
+	if ((flags & PMEM_FILE_ALIGN_2M) && (flags & PMEM_FILE_ALIGN_1G)) {
+		ERR_WO_ERRNO(
+			"PMEM_FILE_ALIGN_2M and PMEM_FILE_ALIGN_1G are mutually exclusive");
+		errno = EINVAL;
+		return NULL;
+	}
+
+	/*
+	 * An aligned mapping is only a request - the kernel picks the page
+	 * size - but on fsdax the alignment is a prerequisite for getting
+	 * the range backed by huge pages. Use pmem_map_pagesize() to verify
+	 * what was actually obtained.
+	 */
+	size_t req_align = 0;
+	if (flags & PMEM_FILE_ALIGN_2M)
+		req_align = 2 * MEGABYTE;
+	else if (flags & PMEM_FILE_ALIGN_1G)
+		req_align = GIGABYTE;
+
 	if (file_type == TYPE_DEVDAX) {
 		if (flags & ~(PMEM_DAX_VALID_FLAGS)) {
 			ERR_WO_ERRNO(
@@ -518,7 +809,8 @@ pmem_map_fileU(const char *path, size_t len, int flags,
 		len = (size_t)actual_size;
 	}
 
-	void *addr = pmem_map_register(fd, len, path, file_type == TYPE_DEVDAX);
+	void *addr = pmem_map_register(fd, len, path, file_type == TYPE_DEVDAX,
+			req_align);
 	if (addr == NULL)
 		goto err;
 
@@ -533,6 +825,9 @@ pmem_map_fileU(const char *path, size_t len, int flags,
 	VALGRIND_REGISTER_PMEM_MAPPING(addr, len);
 	VALGRIND_REGISTER_PMEM_FILE(fd, addr, len, 0);
 
+	if (unlikely(Storelog_enabled))
+		storelog_register_file(path, addr, len);
+
 	(void) os_close(fd);
 
 	return addr;
@@ -590,8 +885,10 @@ pmem_memmove(void *pmemdest, const void *src, size_t len, unsigned flags)
 #endif
 
 	PMEM_API_START();
+	flush_stats_count_store(len, flags);
 	Funcs.memmove_nodrain(pmemdest, src, len, flags & ~PMEM_F_MEM_NODRAIN,
 			Funcs.flush, &Funcs.memmove_funcs);
+	storelog_range(pmemdest, len);
 
 	if ((flags & (PMEM_F_MEM_NODRAIN | PMEM_F_MEM_NOFLUSH)) == 0)
 		pmem_drain();
@@ -621,8 +918,10 @@ pmem_memcpy(void *pmemdest, const void *src, size_t len, unsigned flags)
 #endif
 
 	PMEM_API_START();
+	flush_stats_count_store(len, flags);
 	Funcs.memmove_nodrain(pmemdest, src, len, flags & ~PMEM_F_MEM_NODRAIN,
 			Funcs.flush, &Funcs.memmove_funcs);
+	storelog_range(pmemdest, len);
 
 	if ((flags & (PMEM_F_MEM_NODRAIN | PMEM_F_MEM_NOFLUSH)) == 0)
 		pmem_drain();
@@ -653,8 +952,10 @@ pmem_memset(void *pmemdest, int c, size_t len, unsigned flags)
 #endif
 
 	PMEM_API_START();
+	flush_stats_count_store(len, flags);
 	Funcs.memset_nodrain(pmemdest, c, len, flags & ~PMEM_F_MEM_NODRAIN,
 			Funcs.flush, &Funcs.memset_funcs);
+	storelog_range(pmemdest, len);
 
 	if ((flags & (PMEM_F_MEM_NODRAIN | PMEM_F_MEM_NOFLUSH)) == 0)
 		pmem_drain();
@@ -673,8 +974,10 @@ pmem_memmove_nodrain(void *pmemdest, const void *src, size_t len)
 
 	PMEM_API_START();
 
+	flush_stats_count_store(len, 0);
 	Funcs.memmove_nodrain(pmemdest, src, len, 0, Funcs.flush,
 			&Funcs.memmove_funcs);
+	storelog_range(pmemdest, len);
 
 	PMEM_API_END();
 	return pmemdest;
@@ -690,8 +993,10 @@ pmem_memcpy_nodrain(void *pmemdest, const void *src, size_t len)
 
 	PMEM_API_START();
 
+	flush_stats_count_store(len, 0);
 	Funcs.memmove_nodrain(pmemdest, src, len, 0, Funcs.flush,
 			&Funcs.memmove_funcs);
+	storelog_range(pmemdest, len);
 
 	PMEM_API_END();
 	return pmemdest;
@@ -707,8 +1012,10 @@ pmem_memmove_persist(void *pmemdest, const void *src, size_t len)
 
 	PMEM_API_START();
 
+	flush_stats_count_store(len, 0);
 	Funcs.memmove_nodrain(pmemdest, src, len, 0, Funcs.flush,
 			&Funcs.memmove_funcs);
+	storelog_range(pmemdest, len);
 	pmem_drain();
 
 	PMEM_API_END();
@@ -725,14 +1032,153 @@ pmem_memcpy_persist(void *pmemdest, const void *src, size_t len)
 
 	PMEM_API_START();
 
+	flush_stats_count_store(len, 0);
 	Funcs.memmove_nodrain(pmemdest, src, len, 0, Funcs.flush,
 			&Funcs.memmove_funcs);
+	storelog_range(pmemdest, len);
 	pmem_drain();
 
 	PMEM_API_END();
 	return pmemdest;
 }
 
+/*
+ * pmem_memcpy_persistv -- gather scattered fragments into a contiguous
+ * range of pmem with a single drain at the end
+ *
+ * Each fragment goes through the same store dispatch as pmem_memcpy(),
+ * but the hw drain is issued only once, after all of them.
+ */
+void *
+pmem_memcpy_persistv(void *pmemdest, const struct iovec *iov, int iovcnt)
+{
+	LOG(15, "pmemdest %p iov %p iovcnt %d", pmemdest, iov, iovcnt);
+
+	PMEM_API_START();
+
+	char *dest = pmemdest;
+	for (int i = 0; i < iovcnt; i++) {
+		flush_stats_count_store(iov[i].iov_len, 0);
+		Funcs.memmove_nodrain(dest, iov[i].iov_base, iov[i].iov_len,
+				0, Funcs.flush, &Funcs.memmove_funcs);
+		storelog_range(dest, iov[i].iov_len);
+		dest += iov[i].iov_len;
+	}
+
+	pmem_drain();
+
+	PMEM_API_END();
+	return pmemdest;
+}
+
+/*
+ * The guard marker trailing a guarded range. The tag is chosen by the
+ * caller (typically a record sequence number) so that a marker left behind
+ * by a previous incarnation of the data is not mistaken for a valid one.
+ * The checksum covers the whole marker, so a marker torn by a crash fails
+ * validation - the safe direction, since a missing or invalid marker only
+ * means the range must be treated as incomplete.
+ */
+struct pmem_guard {
+	uint64_t signature;
+	uint64_t tag;
+	uint64_t len;
+	uint64_t csum;
+};
+
+#define PMEM_GUARD_SIG 0x004452474d454d50ULL /* "PMEMGRD\0" */
+
+/*
+ * pmem_memcpy_guard_persist -- memcpy to pmem with a trailing guard marker
+ *
+ * The payload is drained before the marker is written, so after a crash a
+ * valid marker implies the whole preceding range made it to the media -
+ * cheap torn-write detection for non-transactional bulk stores. The marker
+ * occupies PMEM_GUARD_SIZE bytes directly behind the range.
+ */
+void *
+pmem_memcpy_guard_persist(void *pmemdest, const void *src, size_t len,
+	uint64_t tag)
+{
+	LOG(15, "pmemdest %p src %p len %zu tag 0x%" PRIx64,
+			pmemdest, src, len, tag);
+
+	COMPILE_ERROR_ON(sizeof(struct pmem_guard) != PMEM_GUARD_SIZE);
+
+	PMEM_API_START();
+
+	flush_stats_count_store(len, 0);
+	Funcs.memmove_nodrain(pmemdest, src, len, 0, Funcs.flush,
+			&Funcs.memmove_funcs);
+	storelog_range(pmemdest, len);
+
+	/* the payload must be durable before the guard appears */
+	pmem_drain();
+
+	struct pmem_guard g;
+	g.signature = PMEM_GUARD_SIG;
+	g.tag = tag;
+	g.len = len;
+	util_checksum(&g, sizeof(g), &g.csum, 1, 0);
+
+	char *guard = (char *)pmemdest + len;
+	flush_stats_count_store(sizeof(g), 0);
+	Funcs.memmove_nodrain(guard, &g, sizeof(g), 0, Funcs.flush,
+			&Funcs.memmove_funcs);
+	storelog_range(guard, sizeof(g));
+	pmem_drain();
+
+	PMEM_API_END();
+	return pmemdest;
+}
+
+/*
+ * pmem_guard_verify -- checks the guard marker of a single guarded range
+ *
+ * Returns 1 if the marker is intact and matches the expected length and
+ * tag, which implies the range was completely persisted, 0 otherwise.
+ */
+int
+pmem_guard_verify(const void *pmemdest, size_t len, uint64_t tag)
+{
+	LOG(15, "pmemdest %p len %zu tag 0x%" PRIx64, pmemdest, len, tag);
+
+	struct pmem_guard g;
+	memcpy(&g, (const char *)pmemdest + len, sizeof(g));
+
+	if (g.signature != PMEM_GUARD_SIG || g.tag != tag || g.len != len)
+		return 0;
+
+	return util_checksum(&g, sizeof(g), &g.csum, 0, 0);
+}
+
+/*
+ * pmem_guard_scan -- verifies a run of equally sized guarded records
+ *
+ * The records carry len payload bytes each, lie back-to-back (every one
+ * followed by its guard) starting at base, and are tagged with consecutive
+ * values beginning at first_tag. Returns the number of leading records
+ * with a valid guard - for a sequentially written log this is the durable
+ * prefix that recovery can keep.
+ */
+size_t
+pmem_guard_scan(const void *base, size_t len, size_t nrecords,
+	uint64_t first_tag)
+{
+	LOG(15, "base %p len %zu nrecords %zu first_tag 0x%" PRIx64,
+			base, len, nrecords, first_tag);
+
+	const char *rec = base;
+	size_t n = 0;
+	for (; n < nrecords; n++) {
+		if (!pmem_guard_verify(rec, len, first_tag + n))
+			break;
+		rec += len + sizeof(struct pmem_guard);
+	}
+
+	return n;
+}
+
 /*
  * pmem_memset_nodrain -- memset to pmem without hw drain
  */
@@ -743,8 +1189,10 @@ pmem_memset_nodrain(void *pmemdest, int c, size_t len)
 
 	PMEM_API_START();
 
+	flush_stats_count_store(len, 0);
 	Funcs.memset_nodrain(pmemdest, c, len, 0, Funcs.flush,
 			&Funcs.memset_funcs);
+	storelog_range(pmemdest, len);
 
 	PMEM_API_END();
 	return pmemdest;
@@ -760,8 +1208,10 @@ pmem_memset_persist(void *pmemdest, int c, size_t len)
 
 	PMEM_API_START();
 
+	flush_stats_count_store(len, 0);
 	Funcs.memset_nodrain(pmemdest, c, len, 0, Funcs.flush,
 			&Funcs.memset_funcs);
+	storelog_range(pmemdest, len);
 	pmem_drain();
 
 	PMEM_API_END();
@@ -847,6 +1297,10 @@ pmem_init(void)
 	info.flush = NULL;
 	info.fence = NULL;
 	info.flush_has_builtin_fence = 0;
+	info.tune_threshold = NULL;
+	info.store_line = NULL;
+	info.store_16b = NULL;
+	info.store_8b_nt = NULL;
 
 	pmem2_arch_init(&info);
 
@@ -869,6 +1323,9 @@ pmem_init(void)
 	Funcs.memmove_funcs = info.memmove_funcs;
 	Funcs.memset_funcs = info.memset_funcs;
 	Funcs.deep_flush = info.flush;
+	Funcs.store_line = info.store_line;
+	Funcs.store_16b = info.store_16b;
+	Funcs.store_8b_nt = info.store_8b_nt;
 	if (flush) {
 		Funcs.flush = info.flush;
 		Funcs.memmove_nodrain = info.memmove_nodrain;
@@ -884,6 +1341,14 @@ pmem_init(void)
 		Funcs.fence = info.fence;
 	}
 
+	e = os_getenv("PMEM_FLUSH_STATS");
+	if (e && strcmp(e, "1") == 0) {
+		LOG(3, "flush accounting enabled");
+		Flush_stats_enabled = 1;
+	}
+
+	storelog_init();
+
 	char *ptr = os_getenv("PMEM_NO_GENERIC_MEMCPY");
 	long long no_generic = 0;
 	if (ptr)
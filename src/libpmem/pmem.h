@@ -24,10 +24,12 @@ extern "C" {
 typedef int (*is_pmem_func)(const void *addr, size_t len);
 
 void pmem_init(void);
+void pmem_flush_stats_dump(void);
 void pmem_os_init(is_pmem_func *func);
 
 int is_pmem_detect(const void *addr, size_t len);
-void *pmem_map_register(int fd, size_t len, const char *path, int is_dev_dax);
+void *pmem_map_register(int fd, size_t len, const char *path, int is_dev_dax,
+		size_t req_align);
 
 #if FAULT_INJECTION
 void
@@ -5,12 +5,20 @@
  * pmem_posix.c -- pmem utilities with Posix implementation
  */
 
+#include <errno.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <sys/mman.h>
 
+#include "libpmem.h"
 #include "pmem.h"
 #include "log_internal.h"
 #include "mmap.h"
+#include "os.h"
+#include "out.h"
+
+#define PROCSMAPS "/proc/self/smaps"
+#define PROCMAXLEN 2048 /* maximum expected line length in /proc files */
 
 /*
  * is_pmem_detect -- implement pmem_is_pmem()
@@ -39,14 +47,15 @@ is_pmem_detect(const void *addr, size_t len)
  * pmem_map_register -- memory map file and register mapping
  */
 void *
-pmem_map_register(int fd, size_t len, const char *path, int is_dev_dax)
+pmem_map_register(int fd, size_t len, const char *path, int is_dev_dax,
+		size_t req_align)
 {
-	LOG(3, "fd %d len %zu path %s id_dev_dax %d",
-			fd, len, path, is_dev_dax);
+	LOG(3, "fd %d len %zu path %s id_dev_dax %d req_align %zu",
+			fd, len, path, is_dev_dax, req_align);
 
 	void *addr;
 	int map_sync;
-	addr = util_map(fd, 0, len, MAP_SHARED, 0, 0, &map_sync);
+	addr = util_map(fd, 0, len, MAP_SHARED, 0, req_align, &map_sync);
 	if (!addr)
 		return NULL;
 
@@ -69,6 +78,68 @@ err_unmap:
 	return NULL;
 }
 
+/*
+ * pmem_map_pagesize -- return the size of the pages backing the mapping
+ * which contains addr
+ *
+ * The kernel picks the page size on its own - an aligned mapping is only
+ * a prerequisite - so the only way to verify that huge pages were actually
+ * obtained is to look the mapping up in /proc/self/smaps. Returns 0 if the
+ * address is not mapped or the information cannot be read.
+ */
+size_t
+pmem_map_pagesize(const void *addr)
+{
+	LOG(3, "addr %p", addr);
+
+	FILE *fp;
+	if ((fp = os_fopen(PROCSMAPS, "r")) == NULL) {
+		ERR_W_ERRNO(PROCSMAPS);
+		return 0;
+	}
+
+	char line[PROCMAXLEN];	/* for fgets() */
+	char *lo = NULL;	/* beginning of current range in smaps file */
+	char *hi = NULL;	/* end of current range in smaps file */
+	int found = 0;
+	size_t pagesize = 0;
+	size_t kb;
+
+	while (fgets(line, PROCMAXLEN, fp) != NULL) {
+		if (sscanf(line, "%p-%p", &lo, &hi) == 2) {
+			if (found)
+				break;	/* left the matching mapping */
+			found = (const char *)addr >= lo &&
+					(const char *)addr < hi;
+		} else if (found) {
+			/*
+			 * Huge pages show up either directly in the page
+			 * size of the mapping (hugetlbfs) or in the count
+			 * of bytes mapped with a PMD (DAX and file THP).
+			 */
+			if (sscanf(line, "MMUPageSize: %zu kB", &kb) == 1) {
+				pagesize = kb << 10;
+			} else if ((sscanf(line, "FilePmdMapped: %zu kB",
+					&kb) == 1 ||
+					sscanf(line, "AnonHugePages: %zu kB",
+					&kb) == 1) && kb > 0) {
+				pagesize = 2 * MEGABYTE;
+			}
+		}
+	}
+
+	fclose(fp);
+
+	if (!found) {
+		ERR_WO_ERRNO("no mapping found for address %p", addr);
+		errno = EINVAL;
+		return 0;
+	}
+
+	LOG(4, "returning %zu", pagesize);
+	return pagesize;
+}
+
 /*
  * pmem_os_init -- os-dependent part of pmem initialization
  */
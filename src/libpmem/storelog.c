@@ -0,0 +1,171 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2024, Intel Corporation */
+
+/*
+ * storelog.c -- native capture of pmreorder-compatible store traces
+ *
+ * When enabled with PMEM_REORDER_LOG=<file>, every flush issued through
+ * libpmem is recorded as a sequence of STORE entries, with the values read
+ * back from the flushed range, followed by a FLUSH entry; every drain is
+ * recorded as a FENCE. The log uses the text format produced by pmemcheck,
+ * so it can be fed directly to pmreorder without tracing the workload
+ * under valgrind.
+ *
+ * The capture works at flush granularity: stores within one flushed range
+ * are emitted in address order, because their real order is not observable
+ * from the library. pmreorder permutes stores between fences anyway, so
+ * the only information lost is the order of dependent stores to the same
+ * range issued without a fence in between - pmemcheck sees those, this
+ * shim does not.
+ *
+ * Ranges that are flushed repeatedly with unchanged content within one
+ * fence epoch are recorded only once. Allocator and transaction metadata
+ * make such flushes common enough that this cuts the logs considerably.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "storelog.h"
+#include "os.h"
+#include "out.h"
+#include "sys_util.h"
+#include "util.h"
+
+int Storelog_enabled;
+
+static FILE *Storelog_file;
+static os_mutex_t Storelog_lock;
+
+/*
+ * Recently recorded flushes of the current fence epoch, used for
+ * deduplication. The content of each flushed range is summarized with a
+ * checksum; a repeated flush of a range whose checksum did not change is
+ * dropped.
+ */
+#define STORELOG_DEDUP_SLOTS 8
+
+static struct storelog_dedup {
+	const void *addr;
+	size_t len;
+	uint64_t csum;
+} Dedup[STORELOG_DEDUP_SLOTS];
+static unsigned Dedup_next;
+
+/* set when anything was recorded since the last fence */
+static int Fence_needed;
+
+/*
+ * storelog_init -- enables store logging if PMEM_REORDER_LOG is set
+ */
+void
+storelog_init(void)
+{
+	char *e = os_getenv("PMEM_REORDER_LOG");
+	if (e == NULL)
+		return;
+
+	Storelog_file = os_fopen(e, "w");
+	if (Storelog_file == NULL) {
+		CORE_LOG_ERROR("cannot open store log file \"%s\"", e);
+		return;
+	}
+
+	util_mutex_init(&Storelog_lock);
+	Storelog_enabled = 1;
+
+	LOG(3, "recording stores to \"%s\"", e);
+}
+
+/*
+ * storelog_register_file -- records a mapping of a file
+ */
+void
+storelog_register_file(const char *path, const void *addr, size_t len)
+{
+	util_mutex_lock(&Storelog_lock);
+
+	fprintf(Storelog_file, "Register_file;%s;0x%" PRIxPTR ";0x%zx;0x0|",
+		path, (uintptr_t)addr, len);
+	Fence_needed = 1;
+
+	util_mutex_unlock(&Storelog_lock);
+}
+
+/*
+ * storelog_flush -- records the content of a flushed range
+ */
+void
+storelog_flush(const void *addr, size_t len)
+{
+	if (len == 0)
+		return;
+
+	util_mutex_lock(&Storelog_lock);
+
+	uint64_t csum = util_checksum_seq(addr, len, 0);
+
+	struct storelog_dedup *slot = NULL;
+	for (unsigned i = 0; i < STORELOG_DEDUP_SLOTS; ++i) {
+		if (Dedup[i].addr == addr && Dedup[i].len == len) {
+			slot = &Dedup[i];
+			break;
+		}
+	}
+
+	/* identical content of this range was already recorded */
+	if (slot != NULL && slot->csum == csum)
+		goto out;
+
+	if (slot == NULL) {
+		slot = &Dedup[Dedup_next];
+		Dedup_next = (Dedup_next + 1) % STORELOG_DEDUP_SLOTS;
+		slot->addr = addr;
+		slot->len = len;
+	}
+	slot->csum = csum;
+
+	const char *p = addr;
+	size_t remaining = len;
+	while (remaining > 0) {
+		size_t chunk = MIN(remaining, sizeof(uint64_t));
+		uint64_t val = 0;
+		memcpy(&val, p, chunk);
+
+		fprintf(Storelog_file, "STORE;0x%" PRIxPTR ";0x%" PRIx64
+			";0x%zx|", (uintptr_t)p, val, chunk);
+
+		p += chunk;
+		remaining -= chunk;
+	}
+
+	fprintf(Storelog_file, "FLUSH;0x%" PRIxPTR ";0x%zx|",
+		(uintptr_t)addr, len);
+	Fence_needed = 1;
+
+out:
+	util_mutex_unlock(&Storelog_lock);
+}
+
+/*
+ * storelog_fence -- records an ordering point and starts a new fence epoch
+ */
+void
+storelog_fence(void)
+{
+	util_mutex_lock(&Storelog_lock);
+
+	/* consecutive fences carry no additional ordering information */
+	if (!Fence_needed)
+		goto out;
+
+	fprintf(Storelog_file, "FENCE|");
+	Fence_needed = 0;
+
+	memset(Dedup, 0, sizeof(Dedup));
+	Dedup_next = 0;
+
+out:
+	util_mutex_unlock(&Storelog_lock);
+}
@@ -0,0 +1,28 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright 2024, Intel Corporation */
+
+/*
+ * storelog.h -- internal definitions for the native store trace capture
+ */
+
+#ifndef PMEM_STORELOG_H
+#define PMEM_STORELOG_H 1
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int Storelog_enabled;
+
+void storelog_init(void);
+void storelog_register_file(const char *path, const void *addr, size_t len);
+void storelog_flush(const void *addr, size_t len);
+void storelog_fence(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -13,6 +13,7 @@ extern "C" {
 #endif
 
 int pmem2_auto_flush(void);
+int pmem2_auto_flush_refresh(void);
 
 #ifdef __cplusplus
 }
@@ -22,6 +22,16 @@
 #define PERSISTENCE_DOMAIN "persistence_domain"
 #define DOMAIN_VALUE_LEN 32
 
+#define AUTO_FLUSH_UNKNOWN (-2)
+
+/*
+ * The persistence domain of the installed nvdimms cannot change while the
+ * process is running, so the result of the sysfs walk is cached after the
+ * first successful detection. Regions added at runtime are picked up only
+ * by an explicit pmem2_auto_flush_refresh() call.
+ */
+static int Auto_flush = AUTO_FLUSH_UNKNOWN;
+
 /*
  * check_cpu_cache -- (internal) check if file contains "cpu_cache" entry
  */
@@ -127,7 +137,8 @@ end:
 }
 
 /*
- * pmem2_auto_flush -- check if platform supports auto flush for all regions
+ * auto_flush_detect -- (internal) check if platform supports auto flush
+ * for all regions
  *
  * Traverse "/sys/bus/nd/devices" path to find all the nvdimm regions,
  * then for each region checks if "persistence_domain" file exists and
@@ -135,8 +146,8 @@ end:
  * If for any region "persistence_domain" entry does not exists, or its
  * context is not as expected, assume eADR is not available on this platform.
  */
-int
-pmem2_auto_flush(void)
+static int
+auto_flush_detect(void)
 {
 	LOG(15, NULL);
 
@@ -183,3 +194,46 @@ end:
 	fs_delete(dev);
 	return cpu_cache;
 }
+
+/*
+ * pmem2_auto_flush -- return the cached auto flush detection result,
+ * walking the sysfs bus topology only on the first call
+ *
+ * Detection errors are not cached, so a failed walk is retried on the
+ * next call. A concurrent first call may run the walk more than once,
+ * but every walk yields the same answer.
+ */
+int
+pmem2_auto_flush(void)
+{
+	LOG(15, NULL);
+
+	if (Auto_flush == AUTO_FLUSH_UNKNOWN) {
+		int ret = auto_flush_detect();
+		if (ret < 0)
+			return ret;
+		Auto_flush = ret;
+	}
+
+	return Auto_flush;
+}
+
+/*
+ * pmem2_auto_flush_refresh -- redo the auto flush detection and replace
+ * the cached result
+ *
+ * Meant for callers which change the nvdimm topology at runtime and
+ * cannot rely on the snapshot taken on the first pmem2_auto_flush() call.
+ */
+int
+pmem2_auto_flush_refresh(void)
+{
+	LOG(15, NULL);
+
+	int ret = auto_flush_detect();
+	if (ret < 0)
+		return ret;
+	Auto_flush = ret;
+
+	return Auto_flush;
+}
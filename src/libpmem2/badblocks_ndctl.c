@@ -24,6 +24,7 @@
 
 #include "file.h"
 #include "out.h"
+#include "os_thread.h"
 #include "badblocks.h"
 #include "set_badblocks.h"
 #include "extent.h"
@@ -773,3 +774,166 @@ pmem2_badblock_clear(struct pmem2_badblock_context *bbctx,
 
 	return pmem2_badblock_clear_fsdax(bbctx->fd, bb);
 }
+
+struct pmem2_badblock_clear_handle {
+	os_thread_t thread;
+	int async; /* the clear runs on its own thread and has to be joined */
+	struct pmem2_badblock_context *bbctx;
+	struct pmem2_badblock *ranges; /* sorted and merged bad blocks */
+	size_t nranges;
+	int ret;
+};
+
+/*
+ * badblock_offset_cmp -- (internal) compare bad blocks by offset,
+ *                        for sorting before the merge
+ */
+static int
+badblock_offset_cmp(const void *a, const void *b)
+{
+	const struct pmem2_badblock *bba = a;
+	const struct pmem2_badblock *bbb = b;
+
+	if (bba->offset < bbb->offset)
+		return -1;
+	if (bba->offset > bbb->offset)
+		return 1;
+	return 0;
+}
+
+/*
+ * badblock_clear_worker -- (internal) clear the merged ranges on behalf of
+ *                          pmem2_badblock_clear_async
+ *
+ * All ranges are attempted even after a failure - a scrubber wants as many
+ * blocks cleared as possible - and the first error is reported.
+ */
+static void *
+badblock_clear_worker(void *arg)
+{
+	struct pmem2_badblock_clear_handle *handle = arg;
+	struct pmem2_badblock_context *bbctx = handle->bbctx;
+
+	for (size_t i = 0; i < handle->nranges; i++) {
+		int ret;
+
+		if (bbctx->file_type == PMEM2_FTYPE_DEVDAX)
+			ret = pmem2_badblock_clear_devdax(bbctx,
+					&handle->ranges[i]);
+		else
+			ret = pmem2_badblock_clear_fsdax(bbctx->fd,
+					&handle->ranges[i]);
+
+		if (ret && handle->ret == 0)
+			handle->ret = ret;
+	}
+
+	return NULL;
+}
+
+/*
+ * pmem2_badblock_clear_async -- start clearing a batch of bad blocks without
+ * waiting for its completion
+ *
+ * The blocks are sorted and merged into the minimal set of contiguous
+ * ranges first, so clearing a few hundred blocks costs a handful of clear
+ * commands instead of one slow ACPI round trip each. The context must not
+ * be used again until pmem2_badblock_clear_wait() returns.
+ */
+int
+pmem2_badblock_clear_async(struct pmem2_badblock_context *bbctx,
+		const struct pmem2_badblock *bbs, size_t nbbs,
+		struct pmem2_badblock_clear_handle **handle_ptr)
+{
+	LOG(3, "bbctx %p bbs %p nbbs %zu handle_ptr %p",
+		bbctx, bbs, nbbs, handle_ptr);
+	PMEM2_ERR_CLR();
+
+	ASSERTne(bbctx, NULL);
+	ASSERTne(handle_ptr, NULL);
+
+	int ret;
+	*handle_ptr = NULL;
+
+	struct pmem2_badblock_clear_handle *handle =
+		pmem2_zalloc(sizeof(*handle), &ret);
+	if (handle == NULL)
+		return ret;
+
+	handle->bbctx = bbctx;
+
+	if (nbbs > 0) {
+		handle->ranges = pmem2_malloc(nbbs * sizeof(*bbs), &ret);
+		if (handle->ranges == NULL) {
+			Free(handle);
+			return ret;
+		}
+
+		memcpy(handle->ranges, bbs, nbbs * sizeof(*bbs));
+		qsort(handle->ranges, nbbs, sizeof(*bbs),
+			badblock_offset_cmp);
+
+		/* merge overlapping and adjacent ranges */
+		size_t n = 0;
+		for (size_t i = 0; i < nbbs; i++) {
+			struct pmem2_badblock bb = handle->ranges[i];
+
+			if (n > 0) {
+				struct pmem2_badblock *last =
+					&handle->ranges[n - 1];
+				if (bb.offset <=
+						last->offset + last->length) {
+					size_t end = bb.offset + bb.length;
+					if (end > last->offset + last->length)
+						last->length =
+							end - last->offset;
+					continue;
+				}
+			}
+
+			handle->ranges[n++] = bb;
+		}
+		handle->nranges = n;
+
+		LOG(4, "merged %zu bad blocks into %zu clear ranges",
+			nbbs, n);
+	}
+
+	handle->async = os_thread_create(&handle->thread, NULL,
+			badblock_clear_worker, handle) == 0;
+	if (!handle->async) {
+		/* no thread to run on - clear synchronously instead */
+		badblock_clear_worker(handle);
+	}
+
+	*handle_ptr = handle;
+
+	return 0;
+}
+
+/*
+ * pmem2_badblock_clear_wait -- waits for completion of the batch clear
+ * started by pmem2_badblock_clear_async and returns its result
+ */
+int
+pmem2_badblock_clear_wait(struct pmem2_badblock_clear_handle **handle_ptr)
+{
+	LOG(3, "handle_ptr %p", handle_ptr);
+	PMEM2_ERR_CLR();
+
+	struct pmem2_badblock_clear_handle *handle = *handle_ptr;
+
+	if (handle->async)
+		os_thread_join(&handle->thread, NULL);
+
+	int ret = handle->ret;
+	if (ret)
+		CORE_LOG_ERROR("cannot clear all bad blocks for bbctx %p",
+			handle->bbctx);
+
+	Free(handle->ranges);
+	Free(handle);
+	*handle_ptr = NULL;
+
+	return ret;
+}
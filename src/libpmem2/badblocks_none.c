@@ -53,3 +53,25 @@ pmem2_badblock_clear(struct pmem2_badblock_context *bbctx,
 	SUPPRESS_UNUSED(bbctx, bb);
 	return PMEM2_E_NOSUPP;
 }
+
+/*
+ * pmem2_badblock_clear_async -- start clearing a batch of bad blocks
+ */
+int
+pmem2_badblock_clear_async(struct pmem2_badblock_context *bbctx,
+		const struct pmem2_badblock *bbs, size_t nbbs,
+		struct pmem2_badblock_clear_handle **handle_ptr)
+{
+	SUPPRESS_UNUSED(bbctx, bbs, nbbs, handle_ptr);
+	return PMEM2_E_NOSUPP;
+}
+
+/*
+ * pmem2_badblock_clear_wait -- wait for completion of a batch clear
+ */
+int
+pmem2_badblock_clear_wait(struct pmem2_badblock_clear_handle **handle_ptr)
+{
+	SUPPRESS_UNUSED(handle_ptr);
+	return PMEM2_E_NOSUPP;
+}
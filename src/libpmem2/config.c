@@ -26,6 +26,7 @@ pmem2_config_init(struct pmem2_config *cfg)
 	cfg->protection_flag = PMEM2_PROT_READ | PMEM2_PROT_WRITE;
 	cfg->reserv = NULL;
 	cfg->reserv_offset = 0;
+	cfg->prefault_threads = 0;
 }
 
 /*
@@ -193,6 +194,20 @@ pmem2_config_set_vm_reservation(struct pmem2_config *cfg,
 	return 0;
 }
 
+/*
+ * pmem2_config_set_prefault_threads -- set the number of threads used to
+ * prefault the mapping in the pmem2_config structure
+ */
+int
+pmem2_config_set_prefault_threads(struct pmem2_config *cfg, unsigned nthreads)
+{
+	PMEM2_ERR_CLR();
+
+	cfg->prefault_threads = nthreads;
+
+	return 0;
+}
+
 /*
  * pmem2_config_set_protection -- set protection flags
  * in the config struct
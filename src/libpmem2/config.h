@@ -24,6 +24,8 @@ struct pmem2_config {
 	unsigned protection_flag;
 	struct pmem2_vm_reservation *reserv;
 	size_t reserv_offset;
+	/* number of threads used to prefault the mapping, 0 - no prefault */
+	unsigned prefault_threads;
 };
 
 void pmem2_config_init(struct pmem2_config *cfg);
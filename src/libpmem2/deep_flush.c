@@ -8,19 +8,20 @@
 #include <stdlib.h>
 
 #include "libpmem2.h"
+#include "alloc.h"
 #include "deep_flush.h"
+#include "os_thread.h"
 #include "out.h"
+#include "persist.h"
 #include "pmem2_utils.h"
 
 /*
- * pmem2_deep_flush -- performs deep flush operation
+ * deep_flush_validate_range -- (internal) check that the flushed range
+ * lies within the mapping
  */
-int
-pmem2_deep_flush(struct pmem2_map *map, void *ptr, size_t size)
+static int
+deep_flush_validate_range(struct pmem2_map *map, void *ptr, size_t size)
 {
-	LOG(3, "map %p ptr %p size %zu", map, ptr, size);
-	PMEM2_ERR_CLR();
-
 	uintptr_t map_addr = (uintptr_t)map->addr;
 	uintptr_t map_end = map_addr + map->content_length;
 	uintptr_t flush_addr = (uintptr_t)ptr;
@@ -33,7 +34,23 @@ pmem2_deep_flush(struct pmem2_map *map, void *ptr, size_t size)
 		return PMEM2_E_DEEP_FLUSH_RANGE;
 	}
 
-	int ret = map->deep_flush_fn(map, ptr, size);
+	return 0;
+}
+
+/*
+ * pmem2_deep_flush -- performs deep flush operation
+ */
+int
+pmem2_deep_flush(struct pmem2_map *map, void *ptr, size_t size)
+{
+	LOG(3, "map %p ptr %p size %zu", map, ptr, size);
+	PMEM2_ERR_CLR();
+
+	int ret = deep_flush_validate_range(map, ptr, size);
+	if (ret)
+		return ret;
+
+	ret = map->deep_flush_fn(map, ptr, size);
 	if (ret) {
 		CORE_LOG_ERROR(
 			"cannot perform deep flush operation for map %p", map);
@@ -42,3 +59,150 @@ pmem2_deep_flush(struct pmem2_map *map, void *ptr, size_t size)
 
 	return 0;
 }
+
+struct pmem2_deep_flush_handle {
+	os_thread_t thread;
+	int async; /* the flush runs on its own thread and has to be joined */
+	struct pmem2_map *map;
+	void *ptr;
+	size_t size;
+	int ret;
+};
+
+/*
+ * deep_flush_worker -- (internal) performs deep flush operation
+ * on behalf of pmem2_deep_flush_async
+ */
+static void *
+deep_flush_worker(void *arg)
+{
+	struct pmem2_deep_flush_handle *handle = arg;
+
+	handle->ret = handle->map->deep_flush_fn(handle->map, handle->ptr,
+			handle->size);
+
+	return NULL;
+}
+
+/*
+ * pmem2_deep_flush_async -- starts deep flush operation without waiting
+ * for its completion
+ */
+int
+pmem2_deep_flush_async(struct pmem2_map *map, void *ptr, size_t size,
+		struct pmem2_deep_flush_handle **handle_ptr)
+{
+	LOG(3, "map %p ptr %p size %zu handle_ptr %p", map, ptr, size,
+			handle_ptr);
+	PMEM2_ERR_CLR();
+
+	*handle_ptr = NULL;
+
+	int ret = deep_flush_validate_range(map, ptr, size);
+	if (ret)
+		return ret;
+
+	struct pmem2_deep_flush_handle *handle =
+		pmem2_malloc(sizeof(*handle), &ret);
+	if (handle == NULL)
+		return ret;
+
+	handle->map = map;
+	handle->ptr = ptr;
+	handle->size = size;
+	handle->ret = 0;
+
+	handle->async = os_thread_create(&handle->thread, NULL,
+			deep_flush_worker, handle) == 0;
+	if (!handle->async) {
+		/* no thread to run on - deep flush synchronously instead */
+		deep_flush_worker(handle);
+	}
+
+	*handle_ptr = handle;
+
+	return 0;
+}
+
+/*
+ * pmem2_deep_flush_wait -- waits for completion of the deep flush operation
+ * started by pmem2_deep_flush_async and returns its result
+ */
+int
+pmem2_deep_flush_wait(struct pmem2_deep_flush_handle **handle_ptr)
+{
+	LOG(3, "handle_ptr %p", handle_ptr);
+	PMEM2_ERR_CLR();
+
+	struct pmem2_deep_flush_handle *handle = *handle_ptr;
+
+	if (handle->async)
+		os_thread_join(&handle->thread, NULL);
+
+	int ret = handle->ret;
+	if (ret)
+		CORE_LOG_ERROR(
+			"cannot perform deep flush operation for map %p",
+			handle->map);
+
+	Free(handle);
+	*handle_ptr = NULL;
+
+	return ret;
+}
+
+/*
+ * pmem2_deep_flush_ranges -- performs deep flush operation for multiple
+ * ranges of a single mapping
+ */
+int
+pmem2_deep_flush_ranges(struct pmem2_map *map,
+		const struct pmem2_deep_flush_range *ranges, size_t nranges)
+{
+	LOG(3, "map %p ranges %p nranges %zu", map, ranges, nranges);
+	PMEM2_ERR_CLR();
+
+	int ret;
+	for (size_t i = 0; i < nranges; i++) {
+		ret = deep_flush_validate_range(map, ranges[i].ptr,
+				ranges[i].size);
+		if (ret)
+			return ret;
+	}
+
+	/*
+	 * On device DAX the deep flush of every range ends with the very same
+	 * write to the region's deep_flush file, so the cache write-back is
+	 * done per range and the WPQ flush is deduplicated into one write.
+	 */
+	if (nranges > 1 && map->source.type == PMEM2_SOURCE_FD &&
+			map->source.value.ftype == PMEM2_FTYPE_DEVDAX &&
+			map->effective_granularity != PMEM2_GRANULARITY_PAGE) {
+		for (size_t i = 0; i < nranges; i++)
+			pmem2_persist_cpu_cache(ranges[i].ptr,
+					ranges[i].size);
+
+		ret = pmem2_deep_flush_dax(map, ranges[0].ptr,
+				ranges[0].size);
+		if (ret) {
+			CORE_LOG_ERROR(
+				"cannot perform deep flush operation for map %p",
+				map);
+			return ret;
+		}
+
+		return 0;
+	}
+
+	for (size_t i = 0; i < nranges; i++) {
+		ret = map->deep_flush_fn(map, ranges[i].ptr, ranges[i].size);
+		if (ret) {
+			CORE_LOG_ERROR(
+				"cannot perform deep flush operation for map %p",
+				map);
+			return ret;
+		}
+	}
+
+	return 0;
+}
@@ -17,6 +17,7 @@
 #include "file.h"
 #include "out.h"
 #include "extent.h"
+#include "source.h"
 #include "alloc.h"
 
 /*
@@ -162,3 +163,105 @@ pmem2_extents_destroy(struct extents **exts)
 		*exts = NULL;
 	}
 }
+
+struct pmem2_extent_context {
+	struct extents *exts;
+	unsigned next;
+};
+
+/*
+ * pmem2_extent_context_new -- allocate and initialize the extent iterator
+ *                             context for the given source
+ */
+int
+pmem2_extent_context_new(struct pmem2_extent_context **ctx_ptr,
+		const struct pmem2_source *src)
+{
+	LOG(3, "ctx_ptr %p src %p", ctx_ptr, src);
+	PMEM2_ERR_CLR();
+
+	*ctx_ptr = NULL;
+
+	if (src->type != PMEM2_SOURCE_FD) {
+		ERR_WO_ERRNO(
+			"extents can only be queried on sources created from a file descriptor");
+		return PMEM2_E_SOURCE_TYPE_NOT_SUPPORTED;
+	}
+
+	struct extents *exts;
+	int ret = pmem2_extents_create_get(src->value.fd, &exts);
+	if (ret)
+		return ret;
+
+	/*
+	 * A DAX device has no extents - the whole device is allocated, so
+	 * report it as a single extent.
+	 */
+	if (src->value.ftype == PMEM2_FTYPE_DEVDAX) {
+		size_t size;
+		ret = pmem2_source_size(src, &size);
+		if (ret)
+			goto error_extents_destroy;
+
+		exts->extents = pmem2_malloc(sizeof(struct extent), &ret);
+		if (ret)
+			goto error_extents_destroy;
+
+		exts->extents_count = 1;
+		exts->extents[0].offset_physical = 0;
+		exts->extents[0].offset_logical = 0;
+		exts->extents[0].length = size;
+	}
+
+	struct pmem2_extent_context *ctx = pmem2_malloc(sizeof(*ctx), &ret);
+	if (ret)
+		goto error_extents_destroy;
+
+	ctx->exts = exts;
+	ctx->next = 0;
+	*ctx_ptr = ctx;
+
+	return 0;
+
+error_extents_destroy:
+	pmem2_extents_destroy(&exts);
+
+	return ret;
+}
+
+/*
+ * pmem2_extent_next -- return the next allocated extent of the source;
+ *                      holes between the returned extents hold no data
+ */
+int
+pmem2_extent_next(struct pmem2_extent_context *ctx, struct pmem2_extent *ext)
+{
+	LOG(3, "ctx %p ext %p", ctx, ext);
+	PMEM2_ERR_CLR();
+
+	if (ctx->next >= ctx->exts->extents_count)
+		return PMEM2_E_NO_EXTENT_FOUND;
+
+	struct extent *cur = &ctx->exts->extents[ctx->next];
+	ext->offset = cur->offset_logical;
+	ext->length = cur->length;
+	ctx->next++;
+
+	return 0;
+}
+
+/*
+ * pmem2_extent_context_delete -- free the extent iterator context
+ */
+void
+pmem2_extent_context_delete(struct pmem2_extent_context **ctx_ptr)
+{
+	LOG(3, "ctx_ptr %p", ctx_ptr);
+
+	if (*ctx_ptr == NULL)
+		return;
+
+	pmem2_extents_destroy(&(*ctx_ptr)->exts);
+	Free(*ctx_ptr);
+	*ctx_ptr = NULL;
+}
@@ -17,6 +17,7 @@
 #include "config.h"
 #include "file.h"
 #include "map.h"
+#include "os_thread.h"
 #include "out.h"
 #include "persist.h"
 #include "pmem2_utils.h"
@@ -285,6 +286,115 @@ vm_reservation_mend(struct pmem2_vm_reservation *rsv, void *addr, size_t size)
 	return 0;
 }
 
+struct map_prefault_stripe {
+	os_thread_t thread;
+	volatile char *addr;
+	size_t length;
+	int write;
+	int started;
+};
+
+/*
+ * map_prefault_stripe -- (internal) touch every page of a stripe so that
+ *                        it is faulted in
+ */
+static void *
+map_prefault_stripe(void *arg)
+{
+	struct map_prefault_stripe *stripe = arg;
+	volatile char *cur_addr = stripe->addr;
+	volatile char *addr_end = cur_addr + stripe->length;
+
+	for (; cur_addr < addr_end; cur_addr += Pagesize) {
+		if (stripe->write)
+			*cur_addr = *cur_addr;
+		else
+			(void) *cur_addr;
+		VALGRIND_SET_CLEAN(cur_addr, 1);
+	}
+
+	return NULL;
+}
+
+/*
+ * map_prefault -- (internal) fault the mapping in, splitting it into
+ *                 contiguous stripes faulted concurrently
+ *
+ * Prefaulting is best-effort - a stripe whose thread cannot be created
+ * is simply faulted in by the calling thread.
+ */
+static void
+map_prefault(void *addr, size_t length, const struct pmem2_config *cfg)
+{
+	LOG(3, "addr %p length %zu nthreads %u", addr, length,
+			cfg->prefault_threads);
+
+	if (cfg->protection_flag == PMEM2_PROT_NONE)
+		return;
+
+	/*
+	 * Writing to a MAP_PRIVATE mapping would privatize every touched
+	 * page, so such mappings are faulted in with reads only.
+	 */
+	int write = (cfg->protection_flag & PMEM2_PROT_WRITE) &&
+			cfg->sharing == PMEM2_SHARED;
+	if (!write && !(cfg->protection_flag & PMEM2_PROT_READ))
+		return;
+
+	size_t npages = (length + Pagesize - 1) / Pagesize;
+	unsigned nthreads = cfg->prefault_threads;
+	if (nthreads > npages)
+		nthreads = (unsigned)npages;
+	if (nthreads == 0)
+		return;
+
+	int ret;
+	struct map_prefault_stripe *stripes =
+		pmem2_malloc(nthreads * sizeof(*stripes), &ret);
+	if (stripes == NULL) {
+		/* fall back to faulting the whole range in from here */
+		struct map_prefault_stripe whole = {
+			.addr = addr, .length = length, .write = write,
+		};
+		map_prefault_stripe(&whole);
+		return;
+	}
+
+	size_t pages_per_stripe = npages / nthreads;
+	size_t leftover = npages % nthreads;
+	volatile char *cur_addr = addr;
+	size_t remaining = length;
+	for (unsigned i = 0; i < nthreads; ++i) {
+		size_t len = (pages_per_stripe + (i < leftover ? 1 : 0)) *
+				Pagesize;
+		if (len > remaining)
+			len = remaining;
+		stripes[i].addr = cur_addr;
+		stripes[i].length = len;
+		stripes[i].write = write;
+		stripes[i].started = 0;
+		cur_addr += len;
+		remaining -= len;
+	}
+
+	for (unsigned i = 1; i < nthreads; ++i) {
+		stripes[i].started = os_thread_create(&stripes[i].thread,
+				NULL, map_prefault_stripe, &stripes[i]) == 0;
+		if (!stripes[i].started)
+			map_prefault_stripe(&stripes[i]);
+	}
+
+	/* the first stripe always belongs to the calling thread */
+	map_prefault_stripe(&stripes[0]);
+
+	for (unsigned i = 1; i < nthreads; ++i) {
+		if (stripes[i].started)
+			os_thread_join(&stripes[i].thread, NULL);
+	}
+
+	Free(stripes);
+}
+
 /*
  * pmem2_map_new -- map memory according to provided config
  */
@@ -531,6 +641,15 @@ pmem2_map_new(struct pmem2_map **map_ptr, const struct pmem2_config *cfg,
 			map->addr, map->content_length, 0);
 	}
 
+	/* the tuning benchmark stores data, so the map must be writable */
+	if (cfg->sharing == PMEM2_SHARED &&
+			(cfg->protection_flag & PMEM2_PROT_READ) &&
+			(cfg->protection_flag & PMEM2_PROT_WRITE))
+		pmem2_autotune_mem_fns(map);
+
+	if (cfg->prefault_threads != 0)
+		map_prefault(map->addr, map->content_length, cfg);
+
 	return 0;
 
 err_unregister_map:
@@ -17,6 +17,20 @@ enum mcsafe_op_type {
 	MAX_MCSAFE_OP,
 };
 
+/*
+ * mcsafe_op -- machine safe operation definition
+ */
+typedef int (*mcsafe_op)(struct pmem2_source *src, void *buf, size_t size,
+			size_t offset);
+
+/* reads of at least this size are streamed through a mapping */
+#define MCSAFE_STREAM_MIN_SIZE (256UL * 1024)
+
+static int mapped_read(struct pmem2_source *src, void *buf, size_t size,
+		size_t offset);
+static int handle_sigbus_execute_mcsafe_op(struct pmem2_source *src, void *buf,
+		size_t size, size_t offset, mcsafe_op mcsafe_op);
+
 /*
  * mcsafe_op_none -- invalid safe operation definition
  */
@@ -39,6 +53,18 @@ static int
 mcsafe_op_reg_read(struct pmem2_source *src, void *buf, size_t size,
 		size_t offset)
 {
+	/*
+	 * Stream large reads through a mapping, so that clean data is moved
+	 * by the memcpy kernels instead of a syscall. Consuming poison raises
+	 * SIGBUS, which the trampoline turns into a failure here - in that
+	 * case (or when the source cannot be mapped) fall through to the
+	 * pread path below, which reports the error the usual way.
+	 */
+	if (size >= MCSAFE_STREAM_MIN_SIZE &&
+			handle_sigbus_execute_mcsafe_op(src, buf, size, offset,
+					mapped_read) == 0)
+		return 0;
+
 	int fd;
 	pmem2_source_get_fd(src, &fd);
 	ASSERT(fd >= 0);
@@ -102,12 +128,6 @@ signal_handler(int sig)
 	}
 }
 
-/*
- * mcsafe_op -- machine safe operation definition
- */
-typedef int (*mcsafe_op)(struct pmem2_source *src, void *buf, size_t size,
-			size_t offset);
-
 /*
  * handle_sigbus_execute_mcsafe_op -- execute provided operation and handle
  *                                    SIGBUS if necessary
@@ -157,10 +177,10 @@ clnup_null_global_jmp:
 }
 
 /*
- * devdax_read -- devdax read operation
+ * mapped_read -- read operation going through a mapping of the source
  */
 static int
-devdax_read(struct pmem2_source *src, void *buf, size_t size, size_t offset)
+mapped_read(struct pmem2_source *src, void *buf, size_t size, size_t offset)
 {
 	int ret;
 	struct pmem2_config *cfg;
@@ -183,7 +203,8 @@ devdax_read(struct pmem2_source *src, void *buf, size_t size, size_t offset)
 	void *addr = pmem2_map_get_address(map);
 	pmem2_memcpy_fn memcpy_fn = pmem2_get_memcpy_fn(map);
 
-	memcpy_fn(buf, ADDR_SUM(addr, offset), size, 0);
+	/* the destination buffer is volatile memory - nothing to flush */
+	memcpy_fn(buf, ADDR_SUM(addr, offset), size, PMEM2_F_MEM_NOFLUSH);
 
 #ifdef DEBUG /* variables required for ASSERTs below */
 	int clnup_ret =
@@ -197,10 +218,10 @@ clnup_cfg_delete:
 }
 
 /*
- * devdax_write -- devdax write operation
+ * mapped_write -- write operation going through a mapping of the source
  */
 static int
-devdax_write(struct pmem2_source *src, void *buf, size_t size, size_t offset)
+mapped_write(struct pmem2_source *src, void *buf, size_t size, size_t offset)
 {
 	int ret;
 	struct pmem2_config *cfg;
@@ -244,7 +265,7 @@ mcsafe_op_devdax_read(struct pmem2_source *src, void *buf, size_t size,
 		size_t offset)
 {
 	return handle_sigbus_execute_mcsafe_op(src, buf, size, offset,
-			devdax_read);
+			mapped_read);
 }
 
 /*
@@ -255,7 +276,7 @@ mcsafe_op_devdax_write(struct pmem2_source *src, void *buf, size_t size,
 		size_t offset)
 {
 	return handle_sigbus_execute_mcsafe_op(src, buf, size, offset,
-			devdax_write);
+			mapped_write);
 }
 
 /*
@@ -7,10 +7,12 @@
 
 #include <errno.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "libpmem2.h"
 #include "libpmem2/base.h"
 #include "map.h"
+#include "os_thread.h"
 #include "out.h"
 #include "os.h"
 #include "persist.h"
@@ -83,6 +85,7 @@ pmem2_persist_init(void)
 	Info.flush = NULL;
 	Info.fence = NULL;
 	Info.flush_has_builtin_fence = 0;
+	Info.tune_threshold = NULL;
 
 	pmem2_arch_init(&Info);
 
@@ -116,6 +119,25 @@ pmem2_persist_init(void)
 	}
 }
 
+/*
+ * pmem2_autotune_mem_fns -- run the arch-specific store-threshold
+ * auto-tuning on the given mapping, if it was requested
+ */
+void
+pmem2_autotune_mem_fns(struct pmem2_map *map)
+{
+	LOG(3, "map %p", map);
+
+	if (Info.tune_threshold == NULL)
+		return;
+
+	/* the first suitable mapping tunes the whole process */
+	tune_threshold_func tune = Info.tune_threshold;
+	Info.tune_threshold = NULL;
+
+	tune(&Info, map->addr, map->content_length);
+}
+
 /*
  * pmem2_drain -- wait for any PM stores to drain from HW buffers
  */
@@ -175,7 +197,7 @@ pmem2_persist_noflush(const void *addr, size_t len)
 /*
  * pmem2_persist_cpu_cache -- make all changes to a range of pmem persistent
  */
-static void
+void
 pmem2_persist_cpu_cache(const void *addr, size_t len)
 {
 	pmem2_flush_cpu_cache(addr, len);
@@ -429,6 +451,189 @@ pmem2_get_drain_fn(struct pmem2_map *map)
 	return map->drain_fn;
 }
 
+/*
+ * minimum length worth splitting across worker threads and the boundary
+ * the stripes are aligned to
+ */
+#define PARALLEL_COPY_MIN_LEN (8UL << 20)
+#define PARALLEL_COPY_ALIGN 4096UL
+#define PARALLEL_COPY_MAX_THREADS 16U
+
+struct parallel_copy_worker {
+	os_thread_t thread;
+	int started;
+	memmove_nodrain_func memmove_fn;
+	memset_nodrain_func memset_fn;
+	void *dest;
+	const void *src;
+	int c;
+	size_t len;
+	unsigned flags;
+};
+
+/*
+ * parallel_copy_nthreads -- (internal) number of stripes a copy of the
+ * given length is split into
+ */
+static unsigned
+parallel_copy_nthreads(size_t len)
+{
+	static long cpus;
+
+	if (cpus == 0)
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (cpus < 2)
+		return 1;
+
+	unsigned nthreads = (unsigned)cpus;
+	if (nthreads > PARALLEL_COPY_MAX_THREADS)
+		nthreads = PARALLEL_COPY_MAX_THREADS;
+	if (nthreads > len / PARALLEL_COPY_ALIGN)
+		nthreads = (unsigned)(len / PARALLEL_COPY_ALIGN);
+
+	return nthreads;
+}
+
+/*
+ * use_parallel_copy -- (internal) whether the operation is worth splitting
+ * and safe to split - concurrently copied stripes must not overlap
+ */
+static int
+use_parallel_copy(void *pmemdest, const void *src, size_t len, unsigned flags)
+{
+	if (!(flags & PMEM2_F_MEM_PARALLEL))
+		return 0;
+
+	if (len < PARALLEL_COPY_MIN_LEN)
+		return 0;
+
+	if (src != NULL) {
+		uintptr_t dest_off = (uintptr_t)pmemdest;
+		uintptr_t src_off = (uintptr_t)src;
+		size_t distance = dest_off > src_off ?
+			dest_off - src_off : src_off - dest_off;
+		if (distance < len)
+			return 0;
+	}
+
+	return parallel_copy_nthreads(len) > 1;
+}
+
+/*
+ * parallel_memmove_worker -- (internal) copy one stripe and drain this
+ * thread's stores before the join
+ */
+static void *
+parallel_memmove_worker(void *arg)
+{
+	struct parallel_copy_worker *w = arg;
+
+	w->memmove_fn(w->dest, w->src, w->len, w->flags, Info.flush,
+			&Info.memmove_funcs);
+	Info.fence();
+
+	return NULL;
+}
+
+/*
+ * parallel_memset_worker -- (internal) set one stripe and drain this
+ * thread's stores before the join
+ */
+static void *
+parallel_memset_worker(void *arg)
+{
+	struct parallel_copy_worker *w = arg;
+
+	w->memset_fn(w->dest, w->c, w->len, w->flags, Info.flush,
+			&Info.memset_funcs);
+	Info.fence();
+
+	return NULL;
+}
+
+/*
+ * parallel_copy_run -- (internal) run the prepared workers concurrently;
+ * the first stripe and any stripe whose thread cannot be created are
+ * handled by the calling thread
+ */
+static void
+parallel_copy_run(struct parallel_copy_worker *workers, unsigned nthreads,
+		void *(*worker_fn)(void *arg))
+{
+	for (unsigned i = 1; i < nthreads; i++) {
+		workers[i].started = os_thread_create(&workers[i].thread, NULL,
+				worker_fn, &workers[i]) == 0;
+		if (!workers[i].started)
+			worker_fn(&workers[i]);
+	}
+
+	worker_fn(&workers[0]);
+
+	for (unsigned i = 1; i < nthreads; i++) {
+		if (workers[i].started)
+			os_thread_join(&workers[i].thread, NULL);
+	}
+}
+
+/*
+ * pmem2_memmove_parallel -- (internal) memmove split across worker threads
+ */
+static void
+pmem2_memmove_parallel(memmove_nodrain_func memmove_fn, void *pmemdest,
+		const void *src, size_t len, unsigned flags)
+{
+	struct parallel_copy_worker workers[PARALLEL_COPY_MAX_THREADS];
+	unsigned nthreads = parallel_copy_nthreads(len);
+	size_t stripe = ALIGN_DOWN(len / nthreads, PARALLEL_COPY_ALIGN);
+
+	char *dest_cur = pmemdest;
+	const char *src_cur = src;
+	size_t remaining = len;
+	for (unsigned i = 0; i < nthreads; i++) {
+		size_t stripe_len = i == nthreads - 1 ? remaining : stripe;
+		workers[i].memmove_fn = memmove_fn;
+		workers[i].dest = dest_cur;
+		workers[i].src = src_cur;
+		workers[i].len = stripe_len;
+		workers[i].flags = flags;
+		workers[i].started = 0;
+		dest_cur += stripe_len;
+		src_cur += stripe_len;
+		remaining -= stripe_len;
+	}
+
+	parallel_copy_run(workers, nthreads, parallel_memmove_worker);
+}
+
+/*
+ * pmem2_memset_parallel -- (internal) memset split across worker threads
+ */
+static void
+pmem2_memset_parallel(memset_nodrain_func memset_fn, void *pmemdest, int c,
+		size_t len, unsigned flags)
+{
+	struct parallel_copy_worker workers[PARALLEL_COPY_MAX_THREADS];
+	unsigned nthreads = parallel_copy_nthreads(len);
+	size_t stripe = ALIGN_DOWN(len / nthreads, PARALLEL_COPY_ALIGN);
+
+	char *dest_cur = pmemdest;
+	size_t remaining = len;
+	for (unsigned i = 0; i < nthreads; i++) {
+		size_t stripe_len = i == nthreads - 1 ? remaining : stripe;
+		workers[i].memset_fn = memset_fn;
+		workers[i].dest = dest_cur;
+		workers[i].c = c;
+		workers[i].len = stripe_len;
+		workers[i].flags = flags;
+		workers[i].started = 0;
+		dest_cur += stripe_len;
+		remaining -= stripe_len;
+	}
+
+	parallel_copy_run(workers, nthreads, parallel_memset_worker);
+}
+
 /*
  * pmem2_memmove_nonpmem -- mem[move|cpy] followed by an msync
  */
@@ -441,9 +646,13 @@ pmem2_memmove_nonpmem(void *pmemdest, const void *src, size_t len,
 		ERR_WO_ERRNO("invalid flags 0x%x", flags);
 #endif
 	PMEM2_API_START("pmem2_memmove");
-	Info.memmove_nodrain(pmemdest, src, len,
-		flags & ~PMEM2_F_MEM_NODRAIN,
-		Info.flush, &Info.memmove_funcs);
+	if (use_parallel_copy(pmemdest, src, len, flags))
+		pmem2_memmove_parallel(Info.memmove_nodrain, pmemdest, src, len,
+			flags & ~(PMEM2_F_MEM_PARALLEL | PMEM2_F_MEM_NODRAIN));
+	else
+		Info.memmove_nodrain(pmemdest, src, len,
+			flags & ~PMEM2_F_MEM_NODRAIN,
+			Info.flush, &Info.memmove_funcs);
 
 	if (!(flags & PMEM2_F_MEM_NOFLUSH))
 		pmem2_persist_pages(pmemdest, len);
@@ -463,9 +672,13 @@ pmem2_memset_nonpmem(void *pmemdest, int c, size_t len, unsigned flags)
 		ERR_WO_ERRNO("invalid flags 0x%x", flags);
 #endif
 	PMEM2_API_START("pmem2_memset");
-	Info.memset_nodrain(pmemdest, c, len,
-		flags & ~PMEM2_F_MEM_NODRAIN,
-		Info.flush, &Info.memset_funcs);
+	if (use_parallel_copy(pmemdest, NULL, len, flags))
+		pmem2_memset_parallel(Info.memset_nodrain, pmemdest, c, len,
+			flags & ~(PMEM2_F_MEM_PARALLEL | PMEM2_F_MEM_NODRAIN));
+	else
+		Info.memset_nodrain(pmemdest, c, len,
+			flags & ~PMEM2_F_MEM_NODRAIN,
+			Info.flush, &Info.memset_funcs);
 
 	if (!(flags & PMEM2_F_MEM_NOFLUSH))
 		pmem2_persist_pages(pmemdest, len);
@@ -486,8 +699,12 @@ pmem2_memmove(void *pmemdest, const void *src, size_t len,
 		ERR_WO_ERRNO("invalid flags 0x%x", flags);
 #endif
 	PMEM2_API_START("pmem2_memmove");
-	Info.memmove_nodrain(pmemdest, src, len, flags, Info.flush,
-			&Info.memmove_funcs);
+	if (use_parallel_copy(pmemdest, src, len, flags))
+		pmem2_memmove_parallel(Info.memmove_nodrain, pmemdest, src, len,
+				flags & ~PMEM2_F_MEM_PARALLEL);
+	else
+		Info.memmove_nodrain(pmemdest, src, len, flags, Info.flush,
+				&Info.memmove_funcs);
 	if ((flags & (PMEM2_F_MEM_NODRAIN | PMEM2_F_MEM_NOFLUSH)) == 0)
 		pmem2_drain();
 
@@ -506,8 +723,12 @@ pmem2_memset(void *pmemdest, int c, size_t len, unsigned flags)
 		ERR_WO_ERRNO("invalid flags 0x%x", flags);
 #endif
 	PMEM2_API_START("pmem2_memset");
-	Info.memset_nodrain(pmemdest, c, len, flags, Info.flush,
-			&Info.memset_funcs);
+	if (use_parallel_copy(pmemdest, NULL, len, flags))
+		pmem2_memset_parallel(Info.memset_nodrain, pmemdest, c, len,
+				flags & ~PMEM2_F_MEM_PARALLEL);
+	else
+		Info.memset_nodrain(pmemdest, c, len, flags, Info.flush,
+				&Info.memset_funcs);
 	if ((flags & (PMEM2_F_MEM_NODRAIN | PMEM2_F_MEM_NOFLUSH)) == 0)
 		pmem2_drain();
 
@@ -527,8 +748,12 @@ pmem2_memmove_eadr(void *pmemdest, const void *src, size_t len,
 		ERR_WO_ERRNO("invalid flags 0x%x", flags);
 #endif
 	PMEM2_API_START("pmem2_memmove");
-	Info.memmove_nodrain_eadr(pmemdest, src, len, flags, Info.flush,
-			&Info.memmove_funcs);
+	if (use_parallel_copy(pmemdest, src, len, flags))
+		pmem2_memmove_parallel(Info.memmove_nodrain_eadr, pmemdest, src,
+				len, flags & ~PMEM2_F_MEM_PARALLEL);
+	else
+		Info.memmove_nodrain_eadr(pmemdest, src, len, flags, Info.flush,
+				&Info.memmove_funcs);
 	if ((flags & (PMEM2_F_MEM_NODRAIN | PMEM2_F_MEM_NOFLUSH)) == 0)
 		pmem2_drain();
 
@@ -547,8 +772,12 @@ pmem2_memset_eadr(void *pmemdest, int c, size_t len, unsigned flags)
 		ERR_WO_ERRNO("invalid flags 0x%x", flags);
 #endif
 	PMEM2_API_START("pmem2_memset");
-	Info.memset_nodrain_eadr(pmemdest, c, len, flags, Info.flush,
-			&Info.memset_funcs);
+	if (use_parallel_copy(pmemdest, NULL, len, flags))
+		pmem2_memset_parallel(Info.memset_nodrain_eadr, pmemdest, c,
+				len, flags & ~PMEM2_F_MEM_PARALLEL);
+	else
+		Info.memset_nodrain_eadr(pmemdest, c, len, flags, Info.flush,
+				&Info.memset_funcs);
 	if ((flags & (PMEM2_F_MEM_NODRAIN | PMEM2_F_MEM_NOFLUSH)) == 0)
 		pmem2_drain();
 
@@ -614,6 +843,169 @@ pmem2_get_memset_fn(struct pmem2_map *map)
 	return map->memset_fn;
 }
 
+/*
+ * Number of bytes processed by a single pmem2_future_poll() call. Small
+ * enough to keep any individual poll short, so that an event loop driving
+ * hundreds of in-flight operations stays responsive, large enough to
+ * amortize the per-chunk call overhead.
+ */
+#define PMEM2_FUTURE_CHUNK_SIZE (256 * 1024)
+
+enum pmem2_future_op {
+	PMEM2_FUTURE_MEMMOVE,
+	PMEM2_FUTURE_MEMCPY,
+	PMEM2_FUTURE_MEMSET,
+};
+
+/*
+ * pmem2_future_prepare -- (internal) initialize an in-flight operation
+ */
+static int
+pmem2_future_prepare(struct pmem2_future *future, struct pmem2_map *map,
+	void *pmemdest, const void *src, int c, size_t len, unsigned flags,
+	int op)
+{
+	if (flags & ~PMEM2_F_MEM_VALID_FLAGS) {
+		ERR_WO_ERRNO("invalid flags 0x%x", flags);
+		return PMEM2_E_INVALID_MEM_FLAG;
+	}
+
+	future->map = map;
+	future->dest = pmemdest;
+	future->src = src;
+	future->c = c;
+	future->len = len;
+	future->done = 0;
+	/* the chunked processing takes the place of the parallel copy path */
+	future->flags = flags & ~PMEM2_F_MEM_PARALLEL;
+	future->op = op;
+	future->state = PMEM2_FUTURE_STATE_RUNNING;
+
+	return 0;
+}
+
+/*
+ * pmem2_memmove_async -- start an asynchronous memmove on the mapping
+ */
+int
+pmem2_memmove_async(struct pmem2_future *future, struct pmem2_map *map,
+	void *pmemdest, const void *src, size_t len, unsigned flags)
+{
+	LOG(3, "future %p map %p pmemdest %p src %p len %zu flags 0x%x",
+			future, map, pmemdest, src, len, flags);
+	PMEM2_API_START("pmem2_memmove_async");
+
+	int ret = pmem2_future_prepare(future, map, pmemdest, src, 0, len,
+			flags, PMEM2_FUTURE_MEMMOVE);
+
+	PMEM2_API_END("pmem2_memmove_async");
+	return ret;
+}
+
+/*
+ * pmem2_memcpy_async -- start an asynchronous memcpy on the mapping
+ */
+int
+pmem2_memcpy_async(struct pmem2_future *future, struct pmem2_map *map,
+	void *pmemdest, const void *src, size_t len, unsigned flags)
+{
+	LOG(3, "future %p map %p pmemdest %p src %p len %zu flags 0x%x",
+			future, map, pmemdest, src, len, flags);
+	PMEM2_API_START("pmem2_memcpy_async");
+
+	int ret = pmem2_future_prepare(future, map, pmemdest, src, 0, len,
+			flags, PMEM2_FUTURE_MEMCPY);
+
+	PMEM2_API_END("pmem2_memcpy_async");
+	return ret;
+}
+
+/*
+ * pmem2_memset_async -- start an asynchronous memset on the mapping
+ */
+int
+pmem2_memset_async(struct pmem2_future *future, struct pmem2_map *map,
+	void *pmemdest, int c, size_t len, unsigned flags)
+{
+	LOG(3, "future %p map %p pmemdest %p c %d len %zu flags 0x%x",
+			future, map, pmemdest, c, len, flags);
+	PMEM2_API_START("pmem2_memset_async");
+
+	int ret = pmem2_future_prepare(future, map, pmemdest, NULL, c, len,
+			flags, PMEM2_FUTURE_MEMSET);
+
+	PMEM2_API_END("pmem2_memset_async");
+	return ret;
+}
+
+/*
+ * pmem2_future_poll -- advance an in-flight operation by one chunk
+ *
+ * Every poll writes and flushes a bounded region, the single drain that
+ * completes the whole operation is issued by the final poll. A memmove into
+ * an overlapping higher address processes the chunks back-to-front, so no
+ * source byte is overwritten before it has been copied.
+ */
+enum pmem2_future_state
+pmem2_future_poll(struct pmem2_future *future)
+{
+	LOG(15, "future %p", future);
+
+	struct pmem2_map *map = future->map;
+
+	if (future->state == PMEM2_FUTURE_STATE_COMPLETE)
+		return PMEM2_FUTURE_STATE_COMPLETE;
+
+	if (future->done < future->len) {
+		size_t n = future->len - future->done;
+		if (n > PMEM2_FUTURE_CHUNK_SIZE)
+			n = PMEM2_FUTURE_CHUNK_SIZE;
+
+		unsigned flags = future->flags | PMEM2_F_MEM_NODRAIN;
+
+		size_t off = future->done;
+		if (future->op == PMEM2_FUTURE_MEMMOVE &&
+		    future->src < future->dest &&
+		    (const char *)future->src + future->len >
+				(char *)future->dest)
+			off = future->len - future->done - n;
+
+		char *dest = (char *)future->dest + off;
+		if (future->op == PMEM2_FUTURE_MEMSET)
+			map->memset_fn(dest, future->c, n, flags);
+		else if (future->op == PMEM2_FUTURE_MEMCPY)
+			map->memcpy_fn(dest,
+				(const char *)future->src + off, n, flags);
+		else
+			map->memmove_fn(dest,
+				(const char *)future->src + off, n, flags);
+
+		future->done += n;
+		if (future->done < future->len)
+			return PMEM2_FUTURE_STATE_RUNNING;
+	}
+
+	if ((future->flags & (PMEM2_F_MEM_NODRAIN | PMEM2_F_MEM_NOFLUSH)) == 0)
+		map->drain_fn();
+
+	future->state = PMEM2_FUTURE_STATE_COMPLETE;
+	return PMEM2_FUTURE_STATE_COMPLETE;
+}
+
+/*
+ * pmem2_future_complete -- drive an in-flight operation to completion
+ */
+void *
+pmem2_future_complete(struct pmem2_future *future)
+{
+	LOG(15, "future %p", future);
+
+	while (pmem2_future_poll(future) != PMEM2_FUTURE_STATE_COMPLETE)
+		;
+
+	return future->dest;
+}
+
 #if VG_PMEMCHECK_ENABLED
 /*
  * pmem2_emit_log -- logs library and function names to pmemcheck store log
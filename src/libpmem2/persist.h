@@ -17,10 +17,12 @@ extern "C" {
 
 void pmem2_persist_init(void);
 
+void pmem2_persist_cpu_cache(const void *addr, size_t len);
 int pmem2_flush_file_buffers_os(struct pmem2_map *map, const void *addr,
 		size_t len, int autorestart);
 void pmem2_set_flush_fns(struct pmem2_map *map);
 void pmem2_set_mem_fns(struct pmem2_map *map);
+void pmem2_autotune_mem_fns(struct pmem2_map *map);
 
 #ifdef __cplusplus
 }
@@ -32,6 +32,11 @@ typedef void *(*memset_nodrain_func)(void *pmemdest, int c, size_t len,
 		const struct memset_nodrain *memset_funcs);
 typedef void (*memmove_func)(char *pmemdest, const char *src, size_t len);
 typedef void (*memset_func)(char *pmemdest, int c, size_t len);
+typedef void (*store_line_func)(char *pmemdest, const char *src);
+typedef void (*store_16b_func)(char *pmemdest, const char *src);
+typedef void (*store_8b_nt_func)(char *pmemdest, const char *src);
+typedef void (*tune_threshold_func)(struct pmem2_arch_info *info, void *addr,
+		size_t len);
 
 struct memmove_nodrain {
 	struct {
@@ -69,10 +74,41 @@ struct pmem2_arch_info {
 	flush_func flush;
 	fence_func fence;
 	int flush_has_builtin_fence;
+	/* requested auto-tuning of the temporal/non-temporal store cutoff */
+	tune_threshold_func tune_threshold;
+	/*
+	 * single-instruction store of one full, cache-line-aligned line;
+	 * the data bypasses the CPU cache and is persistent once drained,
+	 * no flush needed; NULL when the CPU has no direct store
+	 */
+	store_line_func store_line;
+	/*
+	 * atomic store of one 16-byte-aligned, 16-byte value; the data goes
+	 * through the CPU cache, so it still has to be flushed and drained
+	 * to be persistent; NULL when the CPU has no 16-byte atomic store
+	 */
+	store_16b_func store_16b;
+	/*
+	 * atomic non-temporal store of one 8-byte-aligned, 8-byte value;
+	 * the data bypasses the CPU cache and is persistent once drained,
+	 * no flush needed; NULL when the CPU has no such store
+	 */
+	store_8b_nt_func store_8b_nt;
 };
 
 void pmem2_arch_init(struct pmem2_arch_info *info);
 
+/*
+ * The names of the memcpy/memset kernel family and the cache flush
+ * instruction selected by pmem2_arch_init(), plus the cached-store vs
+ * non-temporal-store crossover point used by the dispatch. Defined in
+ * pmem2_utils.c so that architectures without a runtime dispatch still
+ * report their (generic) defaults.
+ */
+extern const char *Pmem2_memcpy_impl;
+extern const char *Pmem2_flush_impl;
+extern size_t Movnt_threshold;
+
 /*
  * flush_empty_nolog -- (internal) do not flush the CPU cache
  */
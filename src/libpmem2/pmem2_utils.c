@@ -9,9 +9,20 @@
 #include "alloc.h"
 #include "libpmem2.h"
 #include "out.h"
+#include "pmem2_arch.h"
 #include "pmem2_utils.h"
 #include "util.h"
 
+/*
+ * The kernels picked by pmem2_arch_init(); the defaults describe
+ * architectures that select their memory operations at build time.
+ */
+const char *Pmem2_memcpy_impl = "generic";
+const char *Pmem2_flush_impl = "generic";
+
+/* cached vs non-temporal store crossover of the x86 memcpy/memset kernels */
+size_t Movnt_threshold = 256;
+
 /*
  * pmem2_malloc -- allocate a buffer and handle an error
  */
@@ -0,0 +1,229 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2024, Intel Corporation */
+
+/*
+ * snapshot_linux.c -- differential snapshots based on soft-dirty tracking
+ *
+ * pmem2_snapshot_mark() resets the kernel's soft-dirty page tracking and
+ * pmem2_snapshot_diff() walks /proc/self/pagemap to copy only the pages
+ * written since the last mark into a checkpoint file, at their offsets
+ * within the mapping, so an incremental snapshot of a mostly-idle pool
+ * moves the working set instead of the whole file.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "libpmem2.h"
+#include "map.h"
+#include "os.h"
+#include "out.h"
+#include "pmem2_utils.h"
+#include "valgrind_internal.h"
+
+#define PAGEMAP_ENTRY_SIZE 8
+#define PAGEMAP_SOFT_DIRTY (1ULL << 55)
+
+/* pagemap entries read in one batch */
+#define PAGEMAP_BATCH 1024
+
+/*
+ * snapshot_supported -- (internal) check that the kernel actually tracks
+ * the soft-dirty bit
+ *
+ * A kernel built without CONFIG_MEM_SOFT_DIRTY accepts the clear_refs
+ * write but never sets the bit, which would turn every diff into a silent
+ * no-op, so a freshly written probe page is inspected once.
+ */
+static int
+snapshot_supported(void)
+{
+	static int supported = -1;
+
+	if (supported >= 0)
+		return supported;
+
+	supported = 0;
+
+	char *probe = mmap(NULL, Pagesize, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (probe == MAP_FAILED)
+		return 0;
+
+	*probe = 1;
+
+	int pm = os_open("/proc/self/pagemap", O_RDONLY);
+	if (pm >= 0) {
+		uint64_t entry = 0;
+		os_off_t off = (os_off_t)
+			((uintptr_t)probe / Pagesize * PAGEMAP_ENTRY_SIZE);
+		if (pread(pm, &entry, sizeof(entry), off) == sizeof(entry))
+			supported = (entry & PAGEMAP_SOFT_DIRTY) != 0;
+		os_close(pm);
+	}
+
+	munmap(probe, Pagesize);
+
+	return supported;
+}
+
+/*
+ * pmem2_snapshot_mark -- reset the soft-dirty bits, starting a new
+ * tracking interval
+ *
+ * The kernel interface is process-wide: a mark resets the tracking for
+ * every mapping of the calling process, not only for the given one.
+ */
+int
+pmem2_snapshot_mark(struct pmem2_map *map)
+{
+	LOG(3, "map %p", map);
+	PMEM2_API_START("pmem2_snapshot_mark");
+
+	SUPPRESS_UNUSED(map);
+
+	int ret = 0;
+
+	if (!snapshot_supported()) {
+		ERR_WO_ERRNO("kernel does not track the soft-dirty bit");
+		ret = PMEM2_E_NOSUPP;
+		goto end;
+	}
+
+	int fd = os_open("/proc/self/clear_refs", O_WRONLY);
+	if (fd < 0) {
+		ERR_W_ERRNO("os_open \"/proc/self/clear_refs\"");
+		ret = PMEM2_E_ERRNO;
+		goto end;
+	}
+
+	if (write(fd, "4\n", 2) != 2) {
+		ERR_W_ERRNO("write \"/proc/self/clear_refs\"");
+		ret = PMEM2_E_ERRNO;
+	}
+
+	os_close(fd);
+end:
+	PMEM2_API_END("pmem2_snapshot_mark");
+	return ret;
+}
+
+/*
+ * snapshot_copy -- (internal) write one dirty extent of the mapping into
+ * the snapshot file, at its offset within the mapping
+ */
+static int
+snapshot_copy(struct pmem2_map *map, int fd, size_t off, size_t len,
+	size_t *bytes)
+{
+	/* the last page of the mapping may stick out past the content */
+	if (len > map->content_length - off)
+		len = map->content_length - off;
+
+	*bytes += len;
+
+	const char *src = (const char *)map->addr + off;
+
+	while (len > 0) {
+		ssize_t w = pwrite(fd, src, len, (os_off_t)off);
+		if (w < 0) {
+			if (errno == EINTR)
+				continue;
+			ERR_W_ERRNO("pwrite");
+			return PMEM2_E_ERRNO;
+		}
+		src += w;
+		off += (size_t)w;
+		len -= (size_t)w;
+	}
+
+	return 0;
+}
+
+/*
+ * pmem2_snapshot_diff -- copy the pages written since the last mark into
+ * the given file, at their offsets within the mapping
+ */
+int
+pmem2_snapshot_diff(struct pmem2_map *map, int fd, size_t *copied)
+{
+	LOG(3, "map %p fd %d copied %p", map, fd, copied);
+	PMEM2_API_START("pmem2_snapshot_diff");
+
+	int ret = 0;
+	size_t bytes = 0;
+	size_t page = Pagesize;
+	uintptr_t base = (uintptr_t)map->addr;
+	size_t npages = (map->content_length + page - 1) / page;
+
+	size_t run_start = 0;
+	size_t run_len = 0;
+
+	if (!snapshot_supported()) {
+		ERR_WO_ERRNO("kernel does not track the soft-dirty bit");
+		ret = PMEM2_E_NOSUPP;
+		goto end;
+	}
+
+	int pm = os_open("/proc/self/pagemap", O_RDONLY);
+	if (pm < 0) {
+		ERR_W_ERRNO("os_open \"/proc/self/pagemap\"");
+		ret = PMEM2_E_ERRNO;
+		goto end;
+	}
+
+	uint64_t entries[PAGEMAP_BATCH];
+
+	for (size_t p = 0; p < npages; p += PAGEMAP_BATCH) {
+		size_t n = npages - p;
+		if (n > PAGEMAP_BATCH)
+			n = PAGEMAP_BATCH;
+
+		os_off_t pmoff =
+			(os_off_t)((base / page + p) * PAGEMAP_ENTRY_SIZE);
+		ssize_t r = pread(pm, entries, n * PAGEMAP_ENTRY_SIZE, pmoff);
+		if (r != (ssize_t)(n * PAGEMAP_ENTRY_SIZE)) {
+			ERR_W_ERRNO("pread \"/proc/self/pagemap\"");
+			ret = PMEM2_E_ERRNO;
+			goto close;
+		}
+
+		for (size_t i = 0; i < n; i++) {
+			if ((entries[i] & PAGEMAP_SOFT_DIRTY) == 0)
+				continue;
+
+			size_t off = (p + i) * page;
+			if (run_len != 0 && run_start + run_len == off) {
+				run_len += page;
+				continue;
+			}
+
+			if (run_len != 0) {
+				ret = snapshot_copy(map, fd, run_start,
+					run_len, &bytes);
+				if (ret)
+					goto close;
+			}
+
+			run_start = off;
+			run_len = page;
+		}
+	}
+
+	if (run_len != 0) {
+		ret = snapshot_copy(map, fd, run_start, run_len, &bytes);
+		if (ret)
+			goto close;
+	}
+
+	if (copied != NULL)
+		*copied = bytes;
+close:
+	os_close(pm);
+end:
+	PMEM2_API_END("pmem2_snapshot_diff");
+	return ret;
+}
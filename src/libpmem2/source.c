@@ -20,12 +20,30 @@ pmem2_source_from_anon(struct pmem2_source **src, size_t size)
 
 	srcp->type = PMEM2_SOURCE_ANON;
 	srcp->value.size = size;
+	srcp->cached.size_valid = 0;
+	srcp->cached.alignment_valid = 0;
 
 	*src = srcp;
 
 	return 0;
 }
 
+/*
+ * pmem2_source_refresh -- drop the memoized source properties so that the
+ * next query asks the OS again
+ */
+int
+pmem2_source_refresh(struct pmem2_source *src)
+{
+	LOG(3, "src %p", src);
+	PMEM2_ERR_CLR();
+
+	src->cached.size_valid = 0;
+	src->cached.alignment_valid = 0;
+
+	return 0;
+}
+
 int
 pmem2_source_delete(struct pmem2_source **src)
 {
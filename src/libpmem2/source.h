@@ -41,6 +41,18 @@ struct pmem2_source {
 			};
 		};
 	} value;
+	/*
+	 * Memoized device dax geometry. The size and the alignment of a dax
+	 * device are fixed for its lifetime, but retrieving them walks
+	 * sysfs/ndctl, which adds up when a many-part poolset is opened.
+	 * Dropped by pmem2_source_refresh().
+	 */
+	struct {
+		int size_valid;
+		int alignment_valid;
+		size_t size;
+		size_t alignment;
+	} cached;
 };
 
 #endif /* PMEM2_SOURCE_H */
@@ -78,6 +78,8 @@ pmem2_source_from_fd(struct pmem2_source **src, int fd)
 	srcp->value.fd = fd;
 	srcp->value.st_rdev = st.st_rdev;
 	srcp->value.st_dev = st.st_dev;
+	srcp->cached.size_valid = 0;
+	srcp->cached.alignment_valid = 0;
 	*src = srcp;
 
 	return 0;
@@ -111,9 +113,19 @@ pmem2_source_size(const struct pmem2_source *src, size_t *size)
 
 	switch (src->value.ftype) {
 	case PMEM2_FTYPE_DEVDAX: {
+		if (src->cached.size_valid) {
+			*size = src->cached.size;
+			break;
+		}
+
 		int ret = pmem2_device_dax_size(src, size);
 		if (ret)
 			return ret;
+
+		/* the cache is not a part of the observable source state */
+		struct pmem2_source *s = (struct pmem2_source *)src;
+		s->cached.size = *size;
+		s->cached.size_valid = 1;
 		break;
 	}
 	case PMEM2_FTYPE_REG:
@@ -153,9 +165,19 @@ pmem2_source_alignment(const struct pmem2_source *src, size_t *alignment)
 
 	switch (src->value.ftype) {
 	case PMEM2_FTYPE_DEVDAX: {
+		if (src->cached.alignment_valid) {
+			*alignment = src->cached.alignment;
+			break;
+		}
+
 		int ret = pmem2_device_dax_alignment(src, alignment);
 		if (ret)
 			return ret;
+
+		/* the cache is not a part of the observable source state */
+		struct pmem2_source *s = (struct pmem2_source *)src;
+		s->cached.alignment = *alignment;
+		s->cached.alignment_valid = 1;
 		break;
 	}
 	case PMEM2_FTYPE_REG:
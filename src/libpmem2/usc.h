@@ -0,0 +1,38 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright 2024, Intel Corporation */
+
+/*
+ * usc.h -- internal definitions for the unsafe shutdown count queries
+ *
+ * The public pmem2_source_device_usc()/pmem2_source_device_id() build a
+ * fresh device context (on ndctl platforms a full sysfs walk) for every
+ * call, which dominates their cost. Poolset-wide consumers query dozens
+ * of parts back to back, so this internal variant lets them build the
+ * context once and share it across all the queries of a single pass.
+ */
+
+#ifndef PMDK_USC_H
+#define PMDK_USC_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct pmem2_source;
+struct pmem2_usc_ctx;
+
+int pmem2_usc_ctx_new(struct pmem2_usc_ctx **ctxp);
+void pmem2_usc_ctx_delete(struct pmem2_usc_ctx **ctxp);
+int pmem2_usc_ctx_device_usc(struct pmem2_usc_ctx *ctx,
+	const struct pmem2_source *src, uint64_t *usc);
+int pmem2_usc_ctx_device_id(struct pmem2_usc_ctx *ctx,
+	const struct pmem2_source *src, char *id, size_t *len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* usc.h */
@@ -9,6 +9,7 @@
 #include <sys/sysmacros.h>
 #include <fcntl.h>
 
+#include "alloc.h"
 #include "config.h"
 #include "file.h"
 #include "libpmem2.h"
@@ -17,11 +18,52 @@
 #include "pmem2_utils.h"
 #include "source.h"
 #include "region_namespace_ndctl.h"
+#include "usc.h"
+
+/*
+ * A device context shared between queries, so that poolset-wide passes pay
+ * for the ndctl context (a full sysfs walk) once instead of per part.
+ */
+struct pmem2_usc_ctx {
+	struct ndctl_ctx *ndctl;
+};
 
 int
-pmem2_source_device_usc(const struct pmem2_source *src, uint64_t *usc)
+pmem2_usc_ctx_new(struct pmem2_usc_ctx **ctxp)
 {
-	LOG(3, "type %d, uid %p", src->type, usc);
+	int ret;
+	struct pmem2_usc_ctx *ctx = pmem2_malloc(sizeof(*ctx), &ret);
+	if (ctx == NULL)
+		return ret;
+
+	errno = ndctl_new(&ctx->ndctl) * (-1);
+	if (errno) {
+		ERR_W_ERRNO("ndctl_new");
+		Free(ctx);
+		return PMEM2_E_ERRNO;
+	}
+
+	*ctxp = ctx;
+	return 0;
+}
+
+void
+pmem2_usc_ctx_delete(struct pmem2_usc_ctx **ctxp)
+{
+	struct pmem2_usc_ctx *ctx = *ctxp;
+	if (ctx == NULL)
+		return;
+
+	ndctl_unref(ctx->ndctl);
+	Free(ctx);
+	*ctxp = NULL;
+}
+
+int
+pmem2_usc_ctx_device_usc(struct pmem2_usc_ctx *ctx,
+	const struct pmem2_source *src, uint64_t *usc)
+{
+	LOG(3, "ctx %p type %d, usc %p", ctx, src->type, usc);
 	PMEM2_ERR_CLR();
 
 	if (src->type == PMEM2_SOURCE_ANON) {
@@ -32,28 +74,23 @@ pmem2_source_device_usc(const struct pmem2_source *src, uint64_t *usc)
 
 	ASSERTeq(src->type, PMEM2_SOURCE_FD);
 
-	struct ndctl_ctx *ctx;
-	int ret = PMEM2_E_NOSUPP;
-	*usc = 0;
-
-	errno = ndctl_new(&ctx) * (-1);
-	if (errno) {
-		ERR_W_ERRNO("ndctl_new");
-		return PMEM2_E_ERRNO;
+	if (ctx == NULL) {
+		ERR_WO_ERRNO("no device context available");
+		return PMEM2_E_NOSUPP;
 	}
 
+	*usc = 0;
+
 	struct ndctl_region *region = NULL;
-	ret = pmem2_region_namespace(ctx, src, &region, NULL);
+	int ret = pmem2_region_namespace(ctx->ndctl, src, &region, NULL);
 
 	if (ret < 0)
-		goto err;
-
-	ret = PMEM2_E_NOSUPP;
+		return ret;
 
 	if (region == NULL) {
 		ERR_WO_ERRNO(
 			"Unsafe shutdown count is not supported for this source");
-		goto err;
+		return PMEM2_E_NOSUPP;
 	}
 
 	struct ndctl_dimm *dimm;
@@ -61,27 +98,22 @@ pmem2_source_device_usc(const struct pmem2_source *src, uint64_t *usc)
 	ndctl_dimm_foreach_in_region(region, dimm) {
 		long long dimm_usc = ndctl_dimm_get_dirty_shutdown(dimm);
 		if (dimm_usc < 0) {
-			ret = PMEM2_E_NOSUPP;
 			ERR_WO_ERRNO(
 				"Unsafe shutdown count is not supported for this source");
-			goto err;
+			return PMEM2_E_NOSUPP;
 		}
 		*usc += (unsigned long long)dimm_usc;
 	}
 
-	ret = 0;
-
-err:
-	ndctl_unref(ctx);
-	return ret;
+	return 0;
 }
 
 int
-pmem2_source_device_id(const struct pmem2_source *src, char *id, size_t *len)
+pmem2_usc_ctx_device_id(struct pmem2_usc_ctx *ctx,
+	const struct pmem2_source *src, char *id, size_t *len)
 {
 	PMEM2_ERR_CLR();
 
-	struct ndctl_ctx *ctx;
 	struct ndctl_dimm *dimm;
 	int ret;
 	struct ndctl_region *region = NULL;
@@ -94,56 +126,72 @@ pmem2_source_device_id(const struct pmem2_source *src, char *id, size_t *len)
 
 	ASSERTeq(src->type, PMEM2_SOURCE_FD);
 
-	errno = ndctl_new(&ctx) * (-1);
-	if (errno) {
-		ERR_W_ERRNO("ndctl_new");
-		return PMEM2_E_ERRNO;
+	if (ctx == NULL) {
+		ERR_WO_ERRNO("no device context available");
+		return PMEM2_E_NOSUPP;
 	}
 
 	size_t len_base = 1; /* '\0' */
 
-	ret = pmem2_region_namespace(ctx, src, &region, NULL);
+	ret = pmem2_region_namespace(ctx->ndctl, src, &region, NULL);
 
 	if (ret < 0)
-		goto err;
+		return ret;
 
-	if (region == NULL) {
-		ret = PMEM2_E_NOSUPP;
-		goto err;
-	}
+	if (region == NULL)
+		return PMEM2_E_NOSUPP;
 
 	if (id == NULL) {
 		ndctl_dimm_foreach_in_region(region, dimm) {
 			dimm_uid = ndctl_dimm_get_unique_id(dimm);
-			if (dimm_uid == NULL) {
-				ret = PMEM2_E_NOSUPP;
-				goto err;
-			}
+			if (dimm_uid == NULL)
+				return PMEM2_E_NOSUPP;
 			len_base += strlen(ndctl_dimm_get_unique_id(dimm));
 		}
-		goto end;
+		*len = len_base;
+		return 0;
 	}
 
 	size_t count = 1;
 	ndctl_dimm_foreach_in_region(region, dimm) {
 		dimm_uid = ndctl_dimm_get_unique_id(dimm);
-		if (dimm_uid == NULL) {
-			ret = PMEM2_E_NOSUPP;
-			goto err;
-		}
+		if (dimm_uid == NULL)
+			return PMEM2_E_NOSUPP;
 		count += strlen(dimm_uid);
-		if (count > *len) {
-			ret = PMEM2_E_BUFFER_TOO_SMALL;
-			goto err;
-		}
+		if (count > *len)
+			return PMEM2_E_BUFFER_TOO_SMALL;
 		strncat(id, dimm_uid, *len);
 	}
 
-end:
-	ret = 0;
-	if (id == NULL)
-		*len = len_base;
-err:
-	ndctl_unref(ctx);
+	return 0;
+}
+
+int
+pmem2_source_device_usc(const struct pmem2_source *src, uint64_t *usc)
+{
+	LOG(3, "type %d, uid %p", src->type, usc);
+
+	struct pmem2_usc_ctx *ctx;
+	int ret = pmem2_usc_ctx_new(&ctx);
+	if (ret != 0)
+		return ret;
+
+	ret = pmem2_usc_ctx_device_usc(ctx, src, usc);
+	pmem2_usc_ctx_delete(&ctx);
+	return ret;
+}
+
+int
+pmem2_source_device_id(const struct pmem2_source *src, char *id, size_t *len)
+{
+	LOG(3, "type %d, id %p, len %p", src->type, id, len);
+
+	struct pmem2_usc_ctx *ctx;
+	int ret = pmem2_usc_ctx_new(&ctx);
+	if (ret != 0)
+		return ret;
+
+	ret = pmem2_usc_ctx_device_id(ctx, src, id, len);
+	pmem2_usc_ctx_delete(&ctx);
 	return ret;
 }
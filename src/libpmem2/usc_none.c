@@ -7,8 +7,47 @@
 
 #include "libpmem2.h"
 #include "log_internal.h"
+#include "usc.h"
 #include "util.h"
 
+int
+pmem2_usc_ctx_new(struct pmem2_usc_ctx **ctxp)
+{
+	*ctxp = NULL;
+
+	ERR_WO_ERRNO("Cannot read device usc - ndctl is not available");
+
+	return PMEM2_E_NOSUPP;
+}
+
+void
+pmem2_usc_ctx_delete(struct pmem2_usc_ctx **ctxp)
+{
+	SUPPRESS_UNUSED(ctxp);
+}
+
+int
+pmem2_usc_ctx_device_usc(struct pmem2_usc_ctx *ctx,
+	const struct pmem2_source *src, uint64_t *usc)
+{
+	SUPPRESS_UNUSED(ctx, src, usc);
+
+	ERR_WO_ERRNO("Cannot read device usc - ndctl is not available");
+
+	return PMEM2_E_NOSUPP;
+}
+
+int
+pmem2_usc_ctx_device_id(struct pmem2_usc_ctx *ctx,
+	const struct pmem2_source *src, char *id, size_t *len)
+{
+	SUPPRESS_UNUSED(ctx, src, id, len);
+
+	ERR_WO_ERRNO("Cannot read device id - ndctl is not available");
+
+	return PMEM2_E_NOSUPP;
+}
+
 int
 pmem2_source_device_id(const struct pmem2_source *src, char *id, size_t *len)
 {
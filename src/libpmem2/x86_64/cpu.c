@@ -74,6 +74,14 @@ cpuid(unsigned func, unsigned subfunc, unsigned cpuinfo[4])
 #define bit_MOVDIR64B	(1 << 28)
 #endif
 
+#ifndef bit_ENQCMD
+#define bit_ENQCMD	(1 << 29)
+#endif
+
+#ifndef bit_CMPXCHG16B
+#define bit_CMPXCHG16B	(1 << 13)
+#endif
+
 /*
  * is_cpu_feature_present -- (internal) checks if CPU feature is supported
  */
@@ -177,6 +185,18 @@ is_cpu_avx512f_present(void)
 	return ret;
 }
 
+/*
+ * is_cpu_cmpxchg16b_present -- checks if cmpxchg16b instruction is supported
+ */
+int
+is_cpu_cmpxchg16b_present(void)
+{
+	int ret = is_cpu_feature_present(0x1, ECX_IDX, bit_CMPXCHG16B);
+	LOG(4, "cmpxchg16b %ssupported", ret == 0 ? "not " : "");
+
+	return ret;
+}
+
 /*
  * is_cpu_movdir64b_present -- checks if movdir64b instruction is supported
  */
@@ -188,3 +208,15 @@ is_cpu_movdir64b_present(void)
 
 	return ret;
 }
+
+/*
+ * is_cpu_enqcmd_present -- checks if enqcmd instruction is supported
+ */
+int
+is_cpu_enqcmd_present(void)
+{
+	int ret = is_cpu_feature_present(0x7, ECX_IDX, bit_ENQCMD);
+	LOG(4, "enqcmd %ssupported", ret == 0 ? "not " : "");
+
+	return ret;
+}
@@ -14,6 +14,8 @@ int is_cpu_clflushopt_present(void);
 int is_cpu_clwb_present(void);
 int is_cpu_avx_present(void);
 int is_cpu_avx512f_present(void);
+int is_cpu_cmpxchg16b_present(void);
 int is_cpu_movdir64b_present(void);
+int is_cpu_enqcmd_present(void);
 
 #endif
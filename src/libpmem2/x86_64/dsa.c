@@ -0,0 +1,250 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2024, Intel Corporation */
+
+/*
+ * dsa.c -- Data Streaming Accelerator offload for large copies
+ *
+ * Copies above Dsa_threshold are handed to an idxd shared work queue
+ * instead of being streamed by the core. The device writes straight to
+ * memory (the cache control flag is left off), so a successful completion
+ * needs no CPU flush, only the usual drain. Every failure path - no device,
+ * full queue, page fault, unsupported platform - falls back to the regular
+ * CPU kernels, which simply redo the whole copy.
+ *
+ * Only shared work queues are used; submission through ENQCMD reports
+ * back-pressure in the zero flag, while a dedicated queue would require
+ * client-side occupancy accounting to avoid silently dropped descriptors.
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <immintrin.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <linux/idxd.h>
+
+#include "cpu.h"
+#include "dsa.h"
+#include "out.h"
+#include "os.h"
+
+/*
+ * Copies below this many bytes stay on the CPU; the submission and polling
+ * overhead only pays off for large transfers. Overridable for testing with
+ * PMEM_DSA_THRESHOLD, PMEM_NO_DSA disables the offload entirely.
+ */
+#define DSA_THRESHOLD (1 << 20)
+
+size_t Dsa_threshold = SIZE_MAX;
+
+#define DSA_DEV_DIR "/dev/dsa"
+#define DSA_PORTAL_SIZE 0x1000
+
+/* ENQCMD retries before giving a full queue's copy back to the CPU */
+#define DSA_ENQ_RETRIES 32
+
+static char *Dsa_portal;
+static uint32_t Dsa_max_xfer;
+static uint32_t Dsa_bof; /* the queue handles page faults by itself */
+
+/*
+ * dsa_wq_attr -- (internal) read a sysfs attribute of a work queue
+ */
+static int
+dsa_wq_attr(const char *wq, const char *attr, char *buf, size_t len)
+{
+	char path[PATH_MAX];
+	int n = snprintf(path, sizeof(path), "/sys/bus/dsa/devices/%s/%s",
+		wq, attr);
+	if (n < 0 || (size_t)n >= sizeof(path))
+		return -1;
+
+	int fd = os_open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	ssize_t r = read(fd, buf, len - 1);
+	os_close(fd);
+	if (r <= 0)
+		return -1;
+
+	buf[r] = '\0';
+	if (buf[r - 1] == '\n')
+		buf[r - 1] = '\0';
+
+	return 0;
+}
+
+/*
+ * dsa_wq_open -- (internal) map the submission portal of a shared work queue
+ */
+static int
+dsa_wq_open(const char *wq)
+{
+	char mode[32];
+	if (dsa_wq_attr(wq, "mode", mode, sizeof(mode)) ||
+	    strcmp(mode, "shared") != 0)
+		return -1;
+
+	char path[PATH_MAX];
+	int n = snprintf(path, sizeof(path), DSA_DEV_DIR "/%s", wq);
+	if (n < 0 || (size_t)n >= sizeof(path))
+		return -1;
+
+	int fd = os_open(path, O_RDWR);
+	if (fd < 0)
+		return -1;
+
+	void *portal = mmap(NULL, DSA_PORTAL_SIZE, PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, fd, 0);
+	if (portal == MAP_FAILED) {
+		os_close(fd);
+		return -1;
+	}
+
+	/* the mapping holds its own reference to the queue */
+	os_close(fd);
+
+	char buf[32];
+	Dsa_max_xfer = 1U << 20;
+	if (dsa_wq_attr(wq, "max_transfer_size", buf, sizeof(buf)) == 0)
+		Dsa_max_xfer = (uint32_t)strtoul(buf, NULL, 10);
+
+	Dsa_bof = 0;
+	if (dsa_wq_attr(wq, "block_on_fault", buf, sizeof(buf)) == 0)
+		Dsa_bof = (uint32_t)strtoul(buf, NULL, 10);
+
+	Dsa_portal = portal;
+	LOG(3, "using DSA work queue %s (max transfer %u)", wq, Dsa_max_xfer);
+
+	return 0;
+}
+
+/*
+ * pmem2_dsa_init -- look for a usable shared work queue and arm the offload
+ */
+void
+pmem2_dsa_init(void)
+{
+	LOG(3, NULL);
+
+	if (os_getenv("PMEM_NO_DSA")) {
+		LOG(3, "DSA offload disabled");
+		return;
+	}
+
+	if (!is_cpu_enqcmd_present())
+		return;
+
+	DIR *dir = opendir(DSA_DEV_DIR);
+	if (dir == NULL) {
+		LOG(3, "no DSA work queues");
+		return;
+	}
+
+	struct dirent *de;
+	while ((de = readdir(dir)) != NULL) {
+		if (strncmp(de->d_name, "wq", 2) != 0)
+			continue;
+		if (dsa_wq_open(de->d_name) == 0)
+			break;
+	}
+	closedir(dir);
+
+	if (Dsa_portal == NULL)
+		return;
+
+	Dsa_threshold = DSA_THRESHOLD;
+
+	char *e = os_getenv("PMEM_DSA_THRESHOLD");
+	if (e) {
+		long long val = atoll(e);
+		if (val < 0) {
+			LOG(3, "Invalid PMEM_DSA_THRESHOLD");
+		} else {
+			LOG(3, "PMEM_DSA_THRESHOLD set to %zu", (size_t)val);
+			Dsa_threshold = (size_t)val;
+		}
+	}
+}
+
+/*
+ * dsa_enqcmd -- (internal) submit a descriptor, returns nonzero when the
+ * queue did not accept it
+ */
+static inline int
+dsa_enqcmd(volatile void *portal, const void *desc)
+{
+	unsigned char retry;
+
+	asm volatile(".byte 0xf2, 0x0f, 0x38, 0xf8, 0x02\n\t"
+		"setz %0"
+		: "=r" (retry)
+		: "a" (portal), "d" (desc)
+		: "memory");
+
+	return (int)retry;
+}
+
+/*
+ * pmem2_dsa_memmove -- copy through the work queue, NULL means the caller
+ * has to do the copy itself
+ */
+void *
+pmem2_dsa_memmove(void *dest, const void *src, size_t len)
+{
+	if (Dsa_portal == NULL)
+		return NULL;
+
+	char *d = dest;
+	const char *s = src;
+
+	/*
+	 * A failed chunk is redone by the CPU kernels from the original
+	 * source, which is only safe when the ranges do not overlap.
+	 */
+	if (d < s + len && s < d + len)
+		return NULL;
+
+	struct dsa_completion_record comp
+		__attribute__((aligned(32)));
+	struct dsa_hw_desc desc;
+
+	while (len > 0) {
+		size_t n = len > Dsa_max_xfer ? Dsa_max_xfer : len;
+
+		memset(&desc, 0, sizeof(desc));
+		desc.opcode = DSA_OPCODE_MEMMOVE;
+		desc.flags = IDXD_OP_FLAG_CRAV | IDXD_OP_FLAG_RCR;
+		if (Dsa_bof)
+			desc.flags |= IDXD_OP_FLAG_BOF;
+		desc.src_addr = (uint64_t)s;
+		desc.dst_addr = (uint64_t)d;
+		desc.xfer_size = (uint32_t)n;
+		desc.completion_addr = (uint64_t)&comp;
+		comp.status = 0;
+
+		int retries = DSA_ENQ_RETRIES;
+		while (dsa_enqcmd(Dsa_portal, &desc)) {
+			if (--retries == 0)
+				return NULL;
+			_mm_pause();
+		}
+
+		while (comp.status == 0)
+			_mm_pause();
+
+		if (comp.status != DSA_COMP_SUCCESS) {
+			LOG(4, "DSA completion status 0x%x", comp.status);
+			return NULL;
+		}
+
+		d += n;
+		s += n;
+		len -= n;
+	}
+
+	return dest;
+}
@@ -0,0 +1,49 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright 2024, Intel Corporation */
+
+/*
+ * dsa.h -- definitions for the DSA offload module
+ */
+
+#ifndef PMEM2_DSA_H
+#define PMEM2_DSA_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if DSA_AVAILABLE
+
+extern size_t Dsa_threshold;
+
+void pmem2_dsa_init(void);
+void *pmem2_dsa_memmove(void *dest, const void *src, size_t len);
+
+#else
+
+#define Dsa_threshold SIZE_MAX
+
+static inline void
+pmem2_dsa_init(void)
+{
+}
+
+static inline void *
+pmem2_dsa_memmove(void *dest, const void *src, size_t len)
+{
+	(void) dest;
+	(void) src;
+	(void) len;
+	return NULL;
+}
+
+#endif /* DSA_AVAILABLE */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -2,10 +2,13 @@
 /* Copyright 2014-2024, Intel Corporation */
 
 #include <string.h>
+#include <time.h>
 #include <xmmintrin.h>
 
+#include "alloc.h"
 #include "auto_flush.h"
 #include "cpu.h"
+#include "dsa.h"
 #include "flush.h"
 #include "memcpy_memset.h"
 #include "os.h"
@@ -14,10 +17,6 @@
 #include "pmem2_arch.h"
 #include "valgrind_internal.h"
 
-#define MOVNT_THRESHOLD	256
-
-size_t Movnt_threshold = MOVNT_THRESHOLD;
-
 /*
  * memory_barrier -- (internal) issue the fence instruction
  */
@@ -74,9 +73,20 @@ pmem2_memmove_nodrain(void *dest, const void *src, size_t len, unsigned flags,
 	if (len == 0 || src == dest)
 		return dest;
 
-	if (flags & PMEM2_F_MEM_NOFLUSH)
-		memmove_funcs->t.noflush(dest, src, len);
-	else if (flags & PMEM2_F_MEM_MOVNT)
+	/*
+	 * Large copies go to the accelerator, which writes to memory
+	 * directly, so a successful offload needs neither the temporal
+	 * nor the non-temporal CPU path.
+	 */
+	if (len >= Dsa_threshold && pmem2_dsa_memmove(dest, src, len) != NULL)
+		return dest;
+
+	if (flags & PMEM2_F_MEM_NOFLUSH) {
+		if (flags & PMEM2_F_MEM_MOVNT)
+			memmove_funcs->nt.noflush(dest, src, len);
+		else
+			memmove_funcs->t.noflush(dest, src, len);
+	} else if (flags & PMEM2_F_MEM_MOVNT)
 		memmove_funcs->nt.flush(dest, src, len);
 	else if (flags & PMEM2_F_MEM_MOV)
 		memmove_funcs->t.flush(dest, src, len);
@@ -99,9 +109,15 @@ pmem2_memmove_nodrain_eadr(void *dest, const void *src, size_t len,
 	if (len == 0 || src == dest)
 		return dest;
 
-	if (flags & PMEM2_F_MEM_NOFLUSH)
-		memmove_funcs->t.noflush(dest, src, len);
-	else if (flags & PMEM2_F_MEM_NONTEMPORAL)
+	if (len >= Dsa_threshold && pmem2_dsa_memmove(dest, src, len) != NULL)
+		return dest;
+
+	if (flags & PMEM2_F_MEM_NOFLUSH) {
+		if (flags & PMEM2_F_MEM_NONTEMPORAL)
+			memmove_funcs->nt.noflush(dest, src, len);
+		else
+			memmove_funcs->t.noflush(dest, src, len);
+	} else if (flags & PMEM2_F_MEM_NONTEMPORAL)
 		memmove_funcs->nt.empty(dest, src, len);
 	else
 		memmove_funcs->t.empty(dest, src, len);
@@ -119,9 +135,12 @@ pmem2_memset_nodrain(void *dest, int c, size_t len, unsigned flags,
 	if (len == 0)
 		return dest;
 
-	if (flags & PMEM2_F_MEM_NOFLUSH)
-		memset_funcs->t.noflush(dest, c, len);
-	else if (flags & PMEM2_F_MEM_MOVNT)
+	if (flags & PMEM2_F_MEM_NOFLUSH) {
+		if (flags & PMEM2_F_MEM_MOVNT)
+			memset_funcs->nt.noflush(dest, c, len);
+		else
+			memset_funcs->t.noflush(dest, c, len);
+	} else if (flags & PMEM2_F_MEM_MOVNT)
 		memset_funcs->nt.flush(dest, c, len);
 	else if (flags & PMEM2_F_MEM_MOV)
 		memset_funcs->t.flush(dest, c, len);
@@ -143,9 +162,12 @@ pmem2_memset_nodrain_eadr(void *dest, int c, size_t len, unsigned flags,
 	if (len == 0)
 		return dest;
 
-	if (flags & PMEM2_F_MEM_NOFLUSH)
-		memset_funcs->t.noflush(dest, c, len);
-	else if (flags & PMEM2_F_MEM_NONTEMPORAL)
+	if (flags & PMEM2_F_MEM_NOFLUSH) {
+		if (flags & PMEM2_F_MEM_NONTEMPORAL)
+			memset_funcs->nt.noflush(dest, c, len);
+		else
+			memset_funcs->t.noflush(dest, c, len);
+	} else if (flags & PMEM2_F_MEM_NONTEMPORAL)
 		memset_funcs->nt.empty(dest, c, len);
 	else
 		memset_funcs->t.empty(dest, c, len);
@@ -444,6 +466,7 @@ use_movdir64b_memcpy_memset(struct pmem2_arch_info *info,
 	info->memmove_funcs.nt.empty = memmove_movnt_movdir64b_empty;
 	info->memset_funcs.nt.noflush = memset_movnt_movdir64b_noflush;
 	info->memset_funcs.nt.empty = memset_movnt_movdir64b_empty;
+	info->store_line = store_line_movdir64b;
 
 	if (info->flush == flush_clflush) {
 		info->memmove_funcs.nt.flush = memmove_movnt_movdir64b_clflush;
@@ -550,6 +573,133 @@ pmem_cpuinfo_to_funcs(struct pmem2_arch_info *info, enum memcpy_impl *impl)
 	}
 }
 
+/* parameters of the Movnt_threshold auto-tuning benchmark */
+#define MOVNT_TUNE_AREA_SIZE	(64UL * 1024)
+#define MOVNT_TUNE_MIN_SIZE	64UL
+#define MOVNT_TUNE_MAX_SIZE	4096UL
+#define MOVNT_TUNE_LOOPS	64
+
+/*
+ * tune_time_copies -- (internal) time copying the saved content back onto
+ * the mapping with the given kernel
+ */
+static uint64_t
+tune_time_copies(memmove_func copy, fence_func fence, char *dest,
+		const char *src, size_t size)
+{
+	struct timespec t0, t1;
+
+	/* warm the benchmark area up first */
+	copy(dest, src, size);
+	fence();
+
+	os_clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (size_t i = 0; i < MOVNT_TUNE_LOOPS; i++) {
+		/* size is a power of two, so the copy never leaves the area */
+		size_t off = (i * size) & (MOVNT_TUNE_AREA_SIZE - 1);
+		copy(dest + off, src + off, size);
+		fence();
+	}
+	os_clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	return (uint64_t)(t1.tv_sec - t0.tv_sec) * 1000000000 +
+		(uint64_t)t1.tv_nsec - (uint64_t)t0.tv_nsec;
+}
+
+/*
+ * pmem_tune_movnt_threshold -- (internal) micro-benchmark cached vs
+ * non-temporal stores on the given mapping and move Movnt_threshold to
+ * the measured crossover point
+ *
+ * The benchmarked content is copied aside first and every timed copy
+ * writes the very same bytes back, so the mapping is left intact.
+ */
+static void
+pmem_tune_movnt_threshold(struct pmem2_arch_info *info, void *addr, size_t len)
+{
+	LOG(3, "info %p addr %p len %zu", info, addr, len);
+
+	if (len < MOVNT_TUNE_AREA_SIZE) {
+		LOG(3, "mapping too small to measure the movnt threshold on");
+		return;
+	}
+
+	if (info->memmove_funcs.t.flush == NULL ||
+			info->memmove_funcs.nt.flush == NULL)
+		return; /* movnt not supported or disabled - nothing to tune */
+
+	char *src = Malloc(MOVNT_TUNE_AREA_SIZE);
+	if (src == NULL)
+		return;
+
+	memcpy(src, addr, MOVNT_TUNE_AREA_SIZE);
+
+	/* if movnt never wins, move the cutoff above the tested range */
+	size_t threshold = 2 * MOVNT_TUNE_MAX_SIZE;
+	for (size_t size = MOVNT_TUNE_MIN_SIZE; size <= MOVNT_TUNE_MAX_SIZE;
+			size *= 2) {
+		uint64_t t_ns = tune_time_copies(info->memmove_funcs.t.flush,
+				info->fence, addr, src, size);
+		uint64_t nt_ns = tune_time_copies(info->memmove_funcs.nt.flush,
+				info->fence, addr, src, size);
+
+		if (nt_ns < t_ns) {
+			threshold = size;
+			break;
+		}
+	}
+
+	Free(src);
+
+	Movnt_threshold = threshold;
+	LOG(3, "PMEM_MOVNT_THRESHOLD auto-tuned to %zu", threshold);
+}
+
+/*
+ * store_16b_cmpxchg -- (internal) atomic 16-byte store using lock cmpxchg16b
+ *
+ * The plain x86-64 stores are atomic only up to 8 bytes, so the value is
+ * installed with a compare-exchange loop, which is atomic with respect to
+ * both concurrent readers and power failure. dest must be 16-byte aligned.
+ */
+static void
+store_16b_cmpxchg(char *dest, const char *src)
+{
+	uint64_t lo = ((const uint64_t *)src)[0];
+	uint64_t hi = ((const uint64_t *)src)[1];
+	uint64_t *d = (uint64_t *)dest;
+	uint64_t old_lo = d[0];
+	uint64_t old_hi = d[1];
+	unsigned char done;
+
+	do {
+		asm volatile("lock cmpxchg16b %[dst]"
+			: [dst] "+m" (*(volatile uint64_t (*)[2])d),
+			  "+a" (old_lo), "+d" (old_hi), "=@ccz" (done)
+			: "b" (lo), "c" (hi)
+			: "memory");
+	} while (!done);
+}
+
+/*
+ * store_8b_nt_movnti -- (internal) atomic non-temporal 8-byte store
+ *
+ * movnti writes the value directly to memory, bypassing the cache, so the
+ * store only has to be drained to become persistent. An aligned 8-byte
+ * store is atomic on x86-64. SSE2 is part of the base instruction set,
+ * no feature check is needed.
+ */
+static void
+store_8b_nt_movnti(char *dest, const char *src)
+{
+	uint64_t v;
+	memcpy(&v, src, sizeof(v));
+
+	asm volatile("movnti %1, %0"
+		: "=m" (*(volatile uint64_t *)dest)
+		: "r" (v));
+}
+
 /*
  * pmem2_arch_init -- initialize architecture-specific list of pmem operations
  */
@@ -561,6 +711,11 @@ pmem2_arch_init(struct pmem2_arch_info *info)
 
 	pmem_cpuinfo_to_funcs(info, &impl);
 
+	if (is_cpu_cmpxchg16b_present())
+		info->store_16b = store_16b_cmpxchg;
+
+	info->store_8b_nt = store_8b_nt_movnti;
+
 	/*
 	 * For testing, allow overriding the default threshold
 	 * for using non-temporal stores in pmem_memcpy_*(), pmem_memmove_*()
@@ -568,7 +723,11 @@ pmem2_arch_init(struct pmem2_arch_info *info)
 	 * It has no effect if movnt is not supported or disabled.
 	 */
 	const char *ptr = os_getenv("PMEM_MOVNT_THRESHOLD");
-	if (ptr) {
+	if (ptr && strcmp(ptr, "auto") == 0) {
+		LOG(3,
+			"PMEM_MOVNT_THRESHOLD will be measured on the first mapping");
+		info->tune_threshold = pmem_tune_movnt_threshold;
+	} else if (ptr) {
 		long long val = atoll(ptr);
 
 		if (val < 0) {
@@ -579,21 +738,32 @@ pmem2_arch_init(struct pmem2_arch_info *info)
 		}
 	}
 
+	pmem2_dsa_init();
+
 	if (info->flush == flush_clwb)
-		LOG(3, "using clwb");
+		Pmem2_flush_impl = "clwb";
 	else if (info->flush == flush_clflushopt)
-		LOG(3, "using clflushopt");
+		Pmem2_flush_impl = "clflushopt";
 	else if (info->flush == flush_clflush)
-		LOG(3, "using clflush");
+		Pmem2_flush_impl = "clflush";
 	else
 		CORE_LOG_FATAL("invalid deep flush function address");
 
 	if (impl == MEMCPY_MOVDIR64B)
-		LOG(3, "using movnt MOVDIR64B");
+		Pmem2_memcpy_impl = "movdir64b";
 	else if (impl == MEMCPY_AVX512F)
-		LOG(3, "using movnt AVX512F");
+		Pmem2_memcpy_impl = "avx512f";
 	else if (impl == MEMCPY_AVX)
-		LOG(3, "using movnt AVX");
+		Pmem2_memcpy_impl = "avx";
 	else if (impl == MEMCPY_SSE2)
-		LOG(3, "using movnt SSE2");
+		Pmem2_memcpy_impl = "sse2";
+
+	/*
+	 * A single greppable line for fleet monitoring - a microcode or
+	 * kernel update that silently drops the dispatch to a slower
+	 * family shows up as a change of this message.
+	 */
+	CORE_LOG_NOTICE(
+		"memcpy/memset dispatch: movnt %s, flush %s, movnt threshold %zu",
+		Pmem2_memcpy_impl, Pmem2_flush_impl, Movnt_threshold);
 }
@@ -219,3 +219,20 @@ memmove_movnt_movdir64b_clwb(char *dest, const char *src, size_t len)
 	memmove_movnt_movdir64b(dest, src, len, flush_clwb_nolog,
 			no_barrier_after_ntstores);
 }
+
+/*
+ * store_line_movdir64b -- store one full cache line with a single direct
+ * store; dest must be cache-line-aligned and the caller must drain to order
+ * the store, no flush is required
+ */
+void
+store_line_movdir64b(char *dest, const char *src)
+{
+	LOG(15, "dest %p src %p", dest, src);
+
+	ASSERTeq((uintptr_t)dest & 63, 0);
+
+	movdir64b(dest, src);
+
+	VALGRIND_DO_FLUSH(dest, 64);
+}
@@ -388,6 +388,20 @@ static force_inline void
 memmove_mov_avx512f(char *dest, const char *src, size_t len,
 		flush_fn flush, flush64b_fn flush64b)
 {
+	/* for small copies merge the head/body/tail flushes into one call */
+	if (len <= MEM_MOV_MERGE_FLUSH_MAX) {
+		if ((uintptr_t)dest - (uintptr_t)src >= len)
+			memmove_mov_avx512f_fw(dest, src, len,
+				noflush, noflush64b);
+		else
+			memmove_mov_avx512f_bw(dest, src, len,
+				noflush, noflush64b);
+
+		avx_zeroupper();
+		flush(dest, len);
+		return;
+	}
+
 	if ((uintptr_t)dest - (uintptr_t)src >= len)
 		memmove_mov_avx512f_fw(dest, src, len, flush, flush64b);
 	else
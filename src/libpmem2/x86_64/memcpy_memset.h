@@ -46,6 +46,15 @@ noflush64b(const void *addr)
 	SUPPRESS_UNUSED(addr);
 }
 
+/*
+ * A copy that starts or ends in the middle of a cache line pays three
+ * separate flush rounds: one for the partial head, one per full line and one
+ * for the partial tail. Temporal copies up to this size instead issue all of
+ * their stores unflushed and cover the whole range with a single flush call,
+ * which walks every affected line exactly once.
+ */
+#define MEM_MOV_MERGE_FLUSH_MAX (16 * 64)
+
 typedef void perf_barrier_fn(void);
 
 static force_inline void
@@ -226,6 +235,7 @@ void memset_movnt_movdir64b_clflushopt(char *dest, int c, size_t len);
 void memset_movnt_movdir64b_clwb(char *dest, int c, size_t len);
 void memset_movnt_movdir64b_empty(char *dest, int c, size_t len);
 void memset_movnt_movdir64b_noflush(char *dest, int c, size_t len);
+void store_line_movdir64b(char *dest, const char *src);
 #endif
 
 extern size_t Movnt_threshold;
@@ -26,9 +26,12 @@
 #define ACLASS_RESERVED ((void *)0xFFFFFFFFULL)
 
 /*
- * The last size that is handled by runs.
+ * The last size that is handled by runs. Everything above it falls back to
+ * the chunk-granular default class, so keeping this close to the run size
+ * cap bounds the tail waste of large allocations by the class step instead
+ * of the 256 kilobyte chunk rounding.
  */
-#define MAX_RUN_SIZE (CHUNKSIZE * 10)
+#define MAX_RUN_SIZE (CHUNKSIZE * RUN_SIZE_IDX_CAP)
 
 /*
  * Maximum number of bytes the allocation class generation algorithm can decide
@@ -77,7 +80,14 @@ static const struct {
 	{393216, 0.05f},
 };
 
-#define RUN_UNIT_MAX_ALLOC 8U
+/*
+ * The biggest number of units a single allocation can span inside of a run.
+ * Combined with the generated unit sizes this determines how far up runs
+ * can serve allocations: multiples of the mid-sized classes cover the
+ * multi-megabyte range at the category step granularity, where the default
+ * class would round up to whole 256 kilobyte chunks.
+ */
+#define RUN_UNIT_MAX_ALLOC 16U
 
 /*
  * Every allocation has to be a multiple of at least 8 because we need to
@@ -121,6 +131,13 @@ struct alloc_class_collection {
 
 	int fail_on_missing_class;
 	int autogenerate_on_missing_class;
+
+	/*
+	 * If set, classes created for a single fixed allocation size use
+	 * headerless runs, trading the per-object type number (which reads
+	 * back as zero) for the capacity the headers would have consumed.
+	 */
+	int headerless_runs;
 };
 
 /*
@@ -334,6 +351,43 @@ alloc_class_find_or_create(struct alloc_class_collection *ac, size_t n)
 		required_size_idx);
 }
 
+/*
+ * alloc_class_find_or_create_headerless -- (internal) searches for a
+ *	headerless allocation class with the given unit size, creating one if
+ *	none exists
+ *
+ * Unlike the generic classes, a headerless class serves allocations of
+ * exactly one unit, so the unit size is taken as-is and the run waste
+ * minimization performed for the generic classes does not apply.
+ */
+static struct alloc_class *
+alloc_class_find_or_create_headerless(struct alloc_class_collection *ac,
+	size_t n)
+{
+	LOG(10, NULL);
+
+	uint64_t required_size_bytes = n * RUN_MIN_NALLOCS;
+	uint32_t required_size_idx = 1;
+	if (required_size_bytes > RUN_DEFAULT_SIZE) {
+		required_size_bytes -= RUN_DEFAULT_SIZE;
+		required_size_idx +=
+			CALC_SIZE_IDX(CHUNKSIZE, required_size_bytes);
+		if (required_size_idx > RUN_SIZE_IDX_CAP)
+			required_size_idx = RUN_SIZE_IDX_CAP;
+	}
+
+	for (int i = 1; i < MAX_ALLOCATION_CLASSES; ++i) {
+		struct alloc_class *c = ac->aclasses[i];
+		if (c == NULL || c->type != CLASS_RUN)
+			continue;
+		if (c->header_type == HEADER_NONE && c->unit_size == n)
+			return c;
+	}
+
+	return alloc_class_new(-1, ac, CLASS_RUN, HEADER_NONE, n, 0,
+		required_size_idx);
+}
+
 /*
  * alloc_class_find_min_frag -- searches for an existing allocation
  * class that will provide the smallest internal fragmentation for the given
@@ -589,6 +643,56 @@ alloc_class_by_alloc_size(struct alloc_class_collection *ac, size_t size)
 	}
 }
 
+/*
+ * alloc_class_tune_for_size -- finds or creates an allocation class with the
+ *	lowest possible internal fragmentation for the given allocation size
+ *	and assigns it to handle allocations of that size
+ */
+struct alloc_class *
+alloc_class_tune_for_size(struct alloc_class_collection *ac, size_t size)
+{
+	LOG(10, NULL);
+
+	if (size == 0 || size >= ac->last_run_max_size)
+		return NULL;
+
+	size_t class_map_index = SIZE_TO_CLASS_MAP_INDEX(size,
+		ac->granularity);
+
+	struct alloc_class *c;
+	if (ac->headerless_runs) {
+		/*
+		 * Without a header the unit size does not need to accommodate
+		 * one, so the class map granule is used directly and every
+		 * allocation takes up exactly one unit.
+		 */
+		c = alloc_class_find_or_create_headerless(ac,
+			class_map_index * ac->granularity);
+	} else {
+		/*
+		 * The class map excludes the header, but the unit size of the
+		 * created class must accommodate it so that a single unit
+		 * satisfies the allocation.
+		 */
+		size_t n = class_map_index * ac->granularity +
+			header_type_to_size[HEADER_COMPACT];
+
+		c = alloc_class_find_or_create(ac, n);
+	}
+	if (c == NULL)
+		return NULL;
+
+	uint8_t current = ac->class_map_by_alloc_size[class_map_index];
+	if (current != c->id) {
+		/* see the locking comment in alloc_class_assign_by_size */
+		util_bool_compare_and_swap64(
+			&ac->class_map_by_alloc_size[class_map_index],
+			current, c->id);
+	}
+
+	return c;
+}
+
 /*
  * alloc_class_by_run -- returns the allocation class that has the given
  *	unit size
@@ -608,6 +712,27 @@ alloc_class_by_run(struct alloc_class_collection *ac,
 		RUN_CLASS_KEY_PACK(map_idx_s, flags_s, size_idx_s));
 }
 
+/*
+ * alloc_class_get_headerless_runs -- returns whether fixed-size classes are
+ *	created with headerless runs
+ */
+int
+alloc_class_get_headerless_runs(struct alloc_class_collection *ac)
+{
+	return ac->headerless_runs;
+}
+
+/*
+ * alloc_class_set_headerless_runs -- sets whether fixed-size classes are
+ *	created with headerless runs
+ */
+void
+alloc_class_set_headerless_runs(struct alloc_class_collection *ac,
+	int enabled)
+{
+	ac->headerless_runs = enabled;
+}
+
 /*
  * alloc_class_by_id -- returns the allocation class with an id
  */
@@ -55,6 +55,12 @@ struct alloc_class *alloc_class_by_alloc_size(
 	struct alloc_class_collection *ac, size_t size);
 struct alloc_class *alloc_class_by_id(
 	struct alloc_class_collection *ac, uint8_t id);
+struct alloc_class *alloc_class_tune_for_size(
+	struct alloc_class_collection *ac, size_t size);
+
+int alloc_class_get_headerless_runs(struct alloc_class_collection *ac);
+void alloc_class_set_headerless_runs(struct alloc_class_collection *ac,
+	int enabled);
 
 int alloc_class_reserve(struct alloc_class_collection *ac, uint8_t id);
 int alloc_class_find_first_free_slot(struct alloc_class_collection *ac,
@@ -32,6 +32,18 @@ struct bucket {
 
 	struct memory_block_reserved *active_memory_block;
 	int is_active;
+
+	/*
+	 * Identities of the runs most recently active in this bucket, kept
+	 * as an MRU ring. Buckets are per-arena instances, so the ring
+	 * remembers where this arena's threads have been allocating; the
+	 * recycler consults it to hand back a still-warm run instead of
+	 * whichever global best-fit candidate sorts first. Only identities
+	 * are cached - the runs themselves stay in the recycler, so a stale
+	 * entry simply never matches.
+	 */
+	struct recycler_run_hint recent[BUCKET_RECENT_RUNS];
+	unsigned recent_pos;
 };
 
 struct bucket_locked {
@@ -51,6 +63,8 @@ bucket_init(struct bucket *b, struct block_container *c,
 
 	b->is_active = 0;
 	b->active_memory_block = NULL;
+	memset(b->recent, 0, sizeof(b->recent));
+	b->recent_pos = 0;
 	if (aclass && aclass->type == CLASS_RUN) {
 		b->active_memory_block =
 			Zalloc(sizeof(struct memory_block_reserved));
@@ -120,6 +134,19 @@ bucket_acquire(struct bucket_locked *b)
 	return &b->bucket;
 }
 
+/*
+ * bucket_try_acquire -- acquires a usable bucket struct if its lock is
+ *	uncontended, returns NULL otherwise
+ */
+struct bucket *
+bucket_try_acquire(struct bucket_locked *b)
+{
+	if (util_mutex_trylock(&b->lock) != 0)
+		return NULL;
+
+	return &b->bucket;
+}
+
 /*
  * bucket_release -- releases a bucket struct
  */
@@ -171,6 +198,40 @@ bucket_insert_block(struct bucket *b, const struct memory_block *m)
 	return b->c_ops->insert(b->container, m);
 }
 
+/*
+ * bucket_insert_blocks -- inserts an array of blocks into the bucket
+ *
+ * Uses the container's bulk path when it provides one; the container is
+ * free to reorder the array.
+ */
+int
+bucket_insert_blocks(struct bucket *b, struct memory_block *blocks,
+	size_t nblocks)
+{
+	if (b->c_ops->insert_bulk == NULL) {
+		for (size_t i = 0; i < nblocks; ++i) {
+			if (bucket_insert_block(b, &blocks[i]) != 0)
+				return -1;
+		}
+
+		return 0;
+	}
+
+#if VG_MEMCHECK_ENABLED || VG_HELGRIND_ENABLED || VG_DRD_ENABLED
+	if (On_memcheck || On_drd_or_hg) {
+		for (size_t i = 0; i < nblocks; ++i) {
+			struct memory_block *m = &blocks[i];
+			size_t size = m->m_ops->get_real_size(m);
+			void *data = m->m_ops->get_real_data(m);
+			VALGRIND_DO_MAKE_MEM_NOACCESS(data, size);
+			VALGRIND_ANNOTATE_NEW_MEMORY(data, size);
+		}
+	}
+#endif
+
+	return b->c_ops->insert_bulk(b->container, blocks, nblocks);
+}
+
 /*
  * bucket_remove_block -- removes an exact block from the bucket
  */
@@ -218,12 +279,31 @@ bucket_attach_run(struct bucket *b, const struct memory_block *m)
 		b->active_memory_block->bucket = b->locked;
 		b->is_active = 1;
 		util_fetch_and_add64(&b->active_memory_block->nresv, 1);
+
+		struct recycler_run_hint *h = &b->recent[b->recent_pos];
+		if (h->zone_id != m->zone_id || h->chunk_id != m->chunk_id) {
+			b->recent_pos = (b->recent_pos + 1) %
+				BUCKET_RECENT_RUNS;
+			b->recent[b->recent_pos].zone_id = m->zone_id;
+			b->recent[b->recent_pos].chunk_id = m->chunk_id;
+			b->recent[b->recent_pos].valid = 1;
+		}
 	} else {
 		b->c_ops->rm_all(b->container);
 	}
 	return 0;
 }
 
+/*
+ * bucket_recent_runs -- returns the bucket's MRU ring of recently active
+ *	run identities
+ */
+const struct recycler_run_hint *
+bucket_recent_runs(struct bucket *b)
+{
+	return b->recent;
+}
+
 /*
  * bucket_detach_run - gets rid of the active block in the bucket
  */
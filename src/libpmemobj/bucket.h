@@ -15,6 +15,7 @@
 #include "container.h"
 #include "memblock.h"
 #include "os_thread.h"
+#include "recycler.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -23,6 +24,9 @@ extern "C" {
 #define CALC_SIZE_IDX(_unit_size, _size)\
 	((_size) == 0 ? 0 : (uint32_t)((((_size)-1) / (_unit_size)) + 1))
 
+/* the number of recently active run identities each bucket remembers */
+#define BUCKET_RECENT_RUNS 4
+
 struct bucket_locked;
 struct bucket;
 
@@ -30,11 +34,14 @@ struct bucket_locked *bucket_locked_new(struct block_container *c,
 					struct alloc_class *aclass);
 
 struct bucket *bucket_acquire(struct bucket_locked *b);
+struct bucket *bucket_try_acquire(struct bucket_locked *b);
 void bucket_release(struct bucket *b);
 
 struct alloc_class *bucket_alloc_class(struct bucket *b);
 int *bucket_current_resvp(struct bucket *b);
 int bucket_insert_block(struct bucket *b, const struct memory_block *m);
+int bucket_insert_blocks(struct bucket *b, struct memory_block *blocks,
+	size_t nblocks);
 void bucket_try_insert_attached_block(struct bucket *b,
 	const struct memory_block *m);
 int bucket_remove_block(struct bucket *b, const struct memory_block *m);
@@ -43,6 +50,7 @@ int bucket_alloc_block(struct bucket *b, struct memory_block *m_out);
 int bucket_attach_run(struct bucket *b, const struct memory_block *m);
 int bucket_detach_run(struct bucket *b,
 	struct memory_block *m_out, int *empty);
+const struct recycler_run_hint *bucket_recent_runs(struct bucket *b);
 
 struct memory_block_reserved *bucket_active_block(struct bucket *b);
 
@@ -23,6 +23,13 @@ struct block_container_ops {
 	/* inserts a new memory block into the container */
 	int (*insert)(struct block_container *c, const struct memory_block *m);
 
+	/*
+	 * inserts an array of memory blocks into the container in bulk,
+	 * possibly reordering the array; optional - can be NULL
+	 */
+	int (*insert_bulk)(struct block_container *c, struct memory_block *m,
+		size_t nblocks);
+
 	/* removes exact match memory block */
 	int (*get_rm_exact)(struct block_container *c,
 		const struct memory_block *m);
@@ -5,6 +5,9 @@
  * container_ravl.c -- implementation of ravl-based block container
  */
 
+#include <stdlib.h>
+
+#include "alloc.h"
 #include "container_ravl.h"
 #include "ravl.h"
 #include "out.h"
@@ -64,6 +67,46 @@ container_ravl_insert_block(struct block_container *bc,
 	return ravl_insert(c->tree, e);
 }
 
+/*
+ * container_ravl_insert_block_bulk -- (internal) inserts an array of memory
+ *	blocks into the container in one go
+ *
+ * The blocks are sorted and the tree is constructed bottom-up in O(n),
+ * instead of the O(n log n) of repeated insertions - ravl_bulk_insert
+ * falls back to those when the container is not empty.  The input array is
+ * reordered in the process.
+ */
+static int
+container_ravl_insert_block_bulk(struct block_container *bc,
+	struct memory_block *blocks, size_t nblocks)
+{
+	struct block_container_ravl *c =
+		(struct block_container_ravl *)bc;
+
+	qsort(blocks, nblocks, sizeof(*blocks), container_compare_memblocks);
+
+	const void **data = Malloc(nblocks * sizeof(*data));
+	if (data == NULL)
+		return -1;
+
+	for (size_t i = 0; i < nblocks; ++i) {
+		const struct memory_block *m = &blocks[i];
+		struct memory_block *e = m->m_ops->get_user_data(m);
+		VALGRIND_DO_MAKE_MEM_DEFINED(e, sizeof(*e));
+		VALGRIND_ADD_TO_TX(e, sizeof(*e));
+		*e = *m;
+		VALGRIND_SET_CLEAN(e, sizeof(*e));
+		VALGRIND_REMOVE_FROM_TX(e, sizeof(*e));
+		data[i] = e;
+	}
+
+	int ret = ravl_bulk_insert(c->tree, data, nblocks);
+
+	Free(data);
+
+	return ret;
+}
+
 /*
  * container_ravl_get_rm_block_bestfit -- (internal) removes and returns the
  *	best-fit memory block for size
@@ -155,6 +198,7 @@ container_ravl_destroy(struct block_container *bc)
  */
 static const struct block_container_ops container_ravl_ops = {
 	.insert = container_ravl_insert_block,
+	.insert_bulk = container_ravl_insert_block_bulk,
 	.get_rm_exact = container_ravl_get_rm_block_exact,
 	.get_rm_bestfit = container_ravl_get_rm_block_bestfit,
 	.is_empty = container_ravl_is_empty,
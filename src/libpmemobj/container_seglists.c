@@ -137,9 +137,14 @@ container_seglists_destroy(struct block_container *bc)
 /*
  * This container does not support retrieval of exact memory blocks, but other
  * than provides best-fit in O(1) time for unit sizes that do not exceed 64.
+ *
+ * Best-fit selection never scans the list heads: the occupancy bitmap is
+ * masked with the applicable sizes and the winning list is found with a
+ * single find-first-set instruction (util_lssb_index64).
  */
 static const struct block_container_ops container_seglists_ops = {
 	.insert = container_seglists_insert_block,
+	.insert_bulk = NULL,
 	.get_rm_exact = NULL,
 	.get_rm_bestfit = container_seglists_get_rm_block_bestfit,
 	.is_empty = container_seglists_is_empty,
@@ -4,7 +4,7 @@
 /*
  * critnib.c -- implementation of critnib tree
  *
- * It offers identity lookup (like a hashmap) and <= lookup (like a search
+ * It offers identity lookup (like a hashmap) and <=/>= lookup (like a search
  * tree).  Unlike some hashing algorithms (cuckoo hash, perfect hashing) the
  * complexity isn't constant, but for data sizes we expect it's several
  * times as fast as cuckoo, and has no "stop the world" cases that would
@@ -46,6 +46,14 @@
  * free.  Any synchronization with reads would kill their speed, thus
  * instead we have a remove count.  The grace period is DELETED_LIFE,
  * after which any read will notice staleness and restart its work.
+ *
+ * To keep insert-heavy phases from serializing on one write lock, the
+ * tree is split into shards selected by the top bits of the key, each
+ * with its own lock, node pools and remove count.  Reads stay lock-free
+ * exactly as before -- they just start from the shard's root.  Since the
+ * shard index is a monotonic function of the key, <= (and >=) lookups that
+ * miss in their own shard simply continue through the lower-numbered (or
+ * higher-numbered) shards.
  */
 #include <errno.h>
 #include <stdbool.h>
@@ -69,9 +77,9 @@
  * Allowing stale reads (of arbitrarily old writes or of deletes less than
  * DELETED_LIFE old) might sound counterintuitive, but it doesn't affect
  * semantics in any way: the thread could have been stalled just after
- * returning from our code.  Thus, the guarantee is: the result of get() or
- * find_le() is a value that was current at any point between the call
- * start and end.
+ * returning from our code.  Thus, the guarantee is: the result of get(),
+ * find_le() or find_ge() is a value that was current at any point between
+ * the call start and end.
  */
 #define DELETED_LIFE 16
 
@@ -79,6 +87,14 @@
 #define NIB ((1ULL << SLICE) - 1)
 #define SLNODES (1 << SLICE)
 
+/*
+ * Number of independently locked shards.  Writes to different shards never
+ * contend; keys are assigned to shards by their SHARD_BITS highest bits so
+ * that the shard order matches the key order (required for find_le).
+ */
+#define SHARD_BITS 4
+#define NSHARDS (1 << SHARD_BITS)
+
 typedef unsigned char sh_t;
 
 struct critnib_node {
@@ -107,7 +123,7 @@ struct critnib_leaf {
 	void *value;
 };
 
-struct critnib {
+struct critnib_shard {
 	struct critnib_node *root;
 
 	/* pool of freed nodes: singly linked list, next at child[0] */
@@ -120,9 +136,30 @@ struct critnib {
 
 	uint64_t remove_count;
 
-	os_mutex_t mutex; /* writes/removes */
+	/*
+	 * Reclamation statistics: entries (nodes and leaves) still within
+	 * their grace period, and entries already eligible for reuse.
+	 * Modified under the mutex, read without it via critnib_gc_stats.
+	 */
+	uint64_t pending_count;
+	uint64_t recyclable_count;
+
+	os_mutex_t mutex; /* writes/removes within this shard */
+};
+
+struct critnib {
+	struct critnib_shard shard[NSHARDS];
 };
 
+/*
+ * internal: shard_index -- return the shard a key belongs to
+ */
+static inline unsigned
+shard_index(uint64_t key)
+{
+	return (unsigned)(key >> (64 - SHARD_BITS));
+}
+
 /*
  * atomic load
  */
@@ -190,11 +227,15 @@ critnib_new(void)
 	if (!c)
 		return NULL;
 
-	util_mutex_init(&c->mutex);
+	for (int i = 0; i < NSHARDS; i++) {
+		struct critnib_shard *s = &c->shard[i];
+
+		util_mutex_init(&s->mutex);
 
-	VALGRIND_HG_DRD_DISABLE_CHECKING(&c->root, sizeof(c->root));
-	VALGRIND_HG_DRD_DISABLE_CHECKING(&c->remove_count,
-					sizeof(c->remove_count));
+		VALGRIND_HG_DRD_DISABLE_CHECKING(&s->root, sizeof(s->root));
+		VALGRIND_HG_DRD_DISABLE_CHECKING(&s->remove_count,
+						sizeof(s->remove_count));
+	}
 
 	return c;
 }
@@ -223,26 +264,30 @@ delete_node(struct critnib_node *__restrict n)
 void
 critnib_delete(struct critnib *c)
 {
-	if (c->root)
-		delete_node(c->root);
+	for (int j = 0; j < NSHARDS; j++) {
+		struct critnib_shard *s = &c->shard[j];
 
-	util_mutex_destroy(&c->mutex);
+		if (s->root)
+			delete_node(s->root);
 
-	for (struct critnib_node *m = c->deleted_node; m; ) {
-		struct critnib_node *mm = m->child[0];
-		Free(m);
-		m = mm;
-	}
+		util_mutex_destroy(&s->mutex);
 
-	for (struct critnib_leaf *k = c->deleted_leaf; k; ) {
-		struct critnib_leaf *kk = k->value;
-		Free(k);
-		k = kk;
-	}
+		for (struct critnib_node *m = s->deleted_node; m; ) {
+			struct critnib_node *mm = m->child[0];
+			Free(m);
+			m = mm;
+		}
 
-	for (int i = 0; i < DELETED_LIFE; i++) {
-		Free(c->pending_del_nodes[i]);
-		Free(c->pending_del_leaves[i]);
+		for (struct critnib_leaf *k = s->deleted_leaf; k; ) {
+			struct critnib_leaf *kk = k->value;
+			Free(k);
+			k = kk;
+		}
+
+		for (int i = 0; i < DELETED_LIFE; i++) {
+			Free(s->pending_del_nodes[i]);
+			Free(s->pending_del_leaves[i]);
+		}
 	}
 
 	Free(c);
@@ -257,7 +302,7 @@ critnib_delete(struct critnib *c)
  * to within the critnib structure.
  */
 static void
-free_node(struct critnib *__restrict c, struct critnib_node *__restrict n)
+free_node(struct critnib_shard *__restrict c, struct critnib_node *__restrict n)
 {
 	if (!n)
 		return;
@@ -265,13 +310,14 @@ free_node(struct critnib *__restrict c, struct critnib_node *__restrict n)
 	ASSERT(!is_leaf(n));
 	n->child[0] = c->deleted_node;
 	c->deleted_node = n;
+	c->recyclable_count++;
 }
 
 /*
  * internal: alloc_node -- allocate a node from our pool or from malloc
  */
 static struct critnib_node *
-alloc_node(struct critnib *__restrict c)
+alloc_node(struct critnib_shard *__restrict c)
 {
 	if (!c->deleted_node) {
 		struct critnib_node *n = Malloc(sizeof(struct critnib_node));
@@ -284,6 +330,7 @@ alloc_node(struct critnib *__restrict c)
 	struct critnib_node *n = c->deleted_node;
 
 	c->deleted_node = n->child[0];
+	c->recyclable_count--;
 	VALGRIND_ANNOTATE_NEW_MEMORY(n, sizeof(*n));
 
 	return n;
@@ -295,20 +342,21 @@ alloc_node(struct critnib *__restrict c)
  * See free_node().
  */
 static void
-free_leaf(struct critnib *__restrict c, struct critnib_leaf *__restrict k)
+free_leaf(struct critnib_shard *__restrict c, struct critnib_leaf *__restrict k)
 {
 	if (!k)
 		return;
 
 	k->value = c->deleted_leaf;
 	c->deleted_leaf = k;
+	c->recyclable_count++;
 }
 
 /*
  * internal: alloc_leaf -- allocate a leaf from our pool or from malloc
  */
 static struct critnib_leaf *
-alloc_leaf(struct critnib *__restrict c)
+alloc_leaf(struct critnib_shard *__restrict c)
 {
 	if (!c->deleted_leaf) {
 		struct critnib_leaf *k = Malloc(sizeof(struct critnib_leaf));
@@ -321,23 +369,24 @@ alloc_leaf(struct critnib *__restrict c)
 	struct critnib_leaf *k = c->deleted_leaf;
 
 	c->deleted_leaf = k->value;
+	c->recyclable_count--;
 	VALGRIND_ANNOTATE_NEW_MEMORY(k, sizeof(*k));
 
 	return k;
 }
 
 /*
- * critnib_insert -- write a key:value pair to the critnib structure
+ * internal: shard_insert -- write a key:value pair to one shard
  *
  * Returns:
  *  - 0 on success
  *  - EEXIST if such a key already exists
  *  - ENOMEM if we're out of memory
  *
- * Takes a global write lock but doesn't stall any readers.
+ * Takes the shard's write lock but doesn't stall any readers.
  */
-int
-critnib_insert(struct critnib *c, uint64_t key, void *value)
+static int
+shard_insert(struct critnib_shard *c, uint64_t key, void *value)
 {
 	util_mutex_lock(&c->mutex);
 
@@ -423,10 +472,19 @@ critnib_insert(struct critnib *c, uint64_t key, void *value)
 }
 
 /*
- * critnib_remove -- delete a key from the critnib structure, return its value
+ * critnib_insert -- write a key:value pair to the critnib structure
  */
-void *
-critnib_remove(struct critnib *c, uint64_t key)
+int
+critnib_insert(struct critnib *c, uint64_t key, void *value)
+{
+	return shard_insert(&c->shard[shard_index(key)], key, value);
+}
+
+/*
+ * internal: shard_remove -- delete a key from one shard, return its value
+ */
+static void *
+shard_remove(struct critnib_shard *c, uint64_t key)
 {
 	struct critnib_leaf *k;
 	void *value = NULL;
@@ -438,6 +496,10 @@ critnib_remove(struct critnib *c, uint64_t key)
 		goto not_found;
 
 	uint64_t del = util_fetch_and_add64(&c->remove_count, 1) % DELETED_LIFE;
+	if (c->pending_del_nodes[del])
+		c->pending_count--;
+	if (c->pending_del_leaves[del])
+		c->pending_count--;
 	free_node(c, c->pending_del_nodes[del]);
 	free_leaf(c, c->pending_del_leaves[del]);
 	c->pending_del_nodes[del] = NULL;
@@ -491,10 +553,12 @@ critnib_remove(struct critnib *c, uint64_t key)
 
 	store(n_parent, n->child[ochild]);
 	c->pending_del_nodes[del] = n;
+	c->pending_count++;
 
 del_leaf:
 	value = k->value;
 	c->pending_del_leaves[del] = k;
+	c->pending_count++;
 
 not_found:
 	util_mutex_unlock(&c->mutex);
@@ -502,7 +566,16 @@ not_found:
 }
 
 /*
- * critnib_get -- query for a key ("==" match), returns value or NULL
+ * critnib_remove -- delete a key from the critnib structure, return its value
+ */
+void *
+critnib_remove(struct critnib *c, uint64_t key)
+{
+	return shard_remove(&c->shard[shard_index(key)], key);
+}
+
+/*
+ * internal: shard_get -- query one shard for a key ("==" match)
  *
  * Doesn't need a lock but if many deletes happened while our thread was
  * somehow stalled the query is restarted (as freed nodes remain unused only
@@ -511,8 +584,8 @@ not_found:
  * Counterintuitively, it's pointless to return the most current answer,
  * we need only one that was valid at any point after the call started.
  */
-void *
-critnib_get(struct critnib *c, uint64_t key)
+static void *
+shard_get(struct critnib_shard *c, uint64_t key)
 {
 	uint64_t wrs1, wrs2;
 	void *res;
@@ -540,6 +613,15 @@ critnib_get(struct critnib *c, uint64_t key)
 	return res;
 }
 
+/*
+ * critnib_get -- query for a key ("==" match), returns value or NULL
+ */
+void *
+critnib_get(struct critnib *c, uint64_t key)
+{
+	return shard_get(&c->shard[shard_index(key)], key);
+}
+
 /*
  * internal: find_successor -- return the rightmost non-null node in a subtree
  */
@@ -629,12 +711,12 @@ find_le(struct critnib_node *__restrict n, uint64_t key)
 }
 
 /*
- * critnib_find_le -- query for a key ("<=" match), returns value or NULL
+ * internal: shard_find_le -- query one shard for a key ("<=" match)
  *
- * Same guarantees as critnib_get().
+ * Same guarantees as shard_get().
  */
-void *
-critnib_find_le(struct critnib *c, uint64_t key)
+static void *
+shard_find_le(struct critnib_shard *c, uint64_t key)
 {
 	uint64_t wrs1, wrs2;
 	void *res;
@@ -649,3 +731,229 @@ critnib_find_le(struct critnib *c, uint64_t key)
 
 	return res;
 }
+
+/*
+ * critnib_find_le -- query for a key ("<=" match), returns value or NULL
+ *
+ * Every key in shard s is smaller than any key in shard s + 1, so a miss
+ * in the key's own shard continues into the lower-numbered shards; the
+ * first hit is the overall answer.
+ */
+void *
+critnib_find_le(struct critnib *c, uint64_t key)
+{
+	for (unsigned i = shard_index(key) + 1; i > 0; i--) {
+		void *res = shard_find_le(&c->shard[i - 1], key);
+		if (res)
+			return res;
+	}
+
+	return NULL;
+}
+
+/*
+ * internal: find_leftmost -- return the leftmost non-null leaf in a subtree
+ */
+static struct critnib_leaf *
+find_leftmost(struct critnib_node *__restrict n)
+{
+	while (1) {
+		int nib;
+		for (nib = 0; nib <= (int)NIB; nib++)
+			if (n->child[nib])
+				break;
+
+		if (nib > (int)NIB)
+			return NULL;
+
+		n = n->child[nib];
+		if (is_leaf(n))
+			return to_leaf(n);
+	}
+}
+
+/*
+ * internal: find_ge -- recursively search >= in a subtree
+ *
+ * Mirror image of find_le(); returns the leaf rather than just the value
+ * because the range iterator needs the key to resume after it.
+ */
+static struct critnib_leaf *
+find_ge(struct critnib_node *__restrict n, uint64_t key)
+{
+	if (!n)
+		return NULL;
+
+	if (is_leaf(n)) {
+		struct critnib_leaf *k = to_leaf(n);
+
+		return (k->key >= key) ? k : NULL;
+	}
+
+	/* is our key outside the subtree we're in?  (see find_le) */
+	if ((key ^ n->path) >> (n->shift) & ~NIB) {
+		/*
+		 * subtree is too far to the right?
+		 * -> its leftmost value is good
+		 */
+		if (n->path > key)
+			return find_leftmost(n);
+
+		/*
+		 * subtree is too far to the left?
+		 * -> it has nothing of interest to us
+		 */
+		return NULL;
+	}
+
+	unsigned nib = slice_index(key, n->shift);
+	/* recursive call: follow the path */
+	{
+		struct critnib_node *m;
+		load(&n->child[nib], &m);
+		struct critnib_leaf *k = find_ge(m, key);
+		if (k)
+			return k;
+	}
+
+	/*
+	 * nothing in that subtree?  We strayed from the path at this point,
+	 * thus need to search every subtree to our right in this node.  No
+	 * need to dive into any but the first non-null, though.
+	 */
+	for (; nib < NIB; nib++) {
+		struct critnib_node *m;
+		load(&n->child[nib + 1], &m);
+		if (m) {
+			n = m;
+			if (is_leaf(n))
+				return to_leaf(n);
+
+			return find_leftmost(n);
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * internal: shard_find_ge -- query one shard for a key (">=" match)
+ *
+ * Same guarantees as shard_get().  The found key and value are copied out
+ * within the staleness-validation window, so the pair is consistent even if
+ * the leaf gets recycled right after.
+ */
+static int
+shard_find_ge(struct critnib_shard *c, uint64_t key,
+	uint64_t *rkey, void **rvalue)
+{
+	uint64_t wrs1, wrs2;
+	int found;
+
+	do {
+		load(&c->remove_count, &wrs1);
+		struct critnib_node *n; /* avoid a subtle TOCTOU */
+		load(&c->root, &n);
+		struct critnib_leaf *k = n ? find_ge(n, key) : NULL;
+		if ((found = (k != NULL))) {
+			*rkey = k->key;
+			*rvalue = k->value;
+		}
+		load(&c->remove_count, &wrs2);
+	} while (wrs1 + DELETED_LIFE <= wrs2);
+
+	return found;
+}
+
+/*
+ * internal: critnib_find_ge_kv -- query for a key (">=" match), copying out
+ *	the found key:value pair
+ *
+ * Mirror image of critnib_find_le(): a miss in the key's own shard continues
+ * into the higher-numbered shards.
+ */
+static int
+critnib_find_ge_kv(struct critnib *c, uint64_t key,
+	uint64_t *rkey, void **rvalue)
+{
+	for (unsigned i = shard_index(key); i < NSHARDS; i++) {
+		if (shard_find_ge(&c->shard[i], key, rkey, rvalue))
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * critnib_find_ge -- query for a key (">=" match), returns value or NULL
+ */
+void *
+critnib_find_ge(struct critnib *c, uint64_t key)
+{
+	uint64_t rkey;
+	void *rvalue;
+
+	return critnib_find_ge_kv(c, key, &rkey, &rvalue) ? rvalue : NULL;
+}
+
+/*
+ * critnib_range -- visit every key in [min, max], in ascending key order
+ *
+ * Implemented as a chain of >= queries, each with the usual lock-free read
+ * guarantees; the iteration holds no locks between steps, so entries
+ * inserted or removed concurrently may or may not be visited.  Returns 0
+ * after the whole range has been visited, or the first nonzero callback
+ * return value, which stops the iteration.
+ */
+int
+critnib_range(struct critnib *c, uint64_t min, uint64_t max,
+	critnib_range_cb cb, void *arg)
+{
+	uint64_t key = min;
+
+	for (;;) {
+		uint64_t rkey;
+		void *rvalue;
+
+		if (!critnib_find_ge_kv(c, key, &rkey, &rvalue) || rkey > max)
+			return 0;
+
+		int ret = cb(rkey, rvalue, arg);
+		if (ret)
+			return ret;
+
+		if (rkey == UINT64_MAX)
+			return 0;
+
+		key = rkey + 1;
+	}
+}
+
+/*
+ * critnib_gc_stats -- report reclamation state of a critnib
+ *
+ * Sums the pending (still within the DELETED_LIFE grace period) and
+ * recyclable (free for reuse) entry counts across all shards.  The
+ * counters are written under the shard locks but read without them, so
+ * the result is a consistent-enough snapshot for monitoring purposes.
+ */
+void
+critnib_gc_stats(struct critnib *c, uint64_t *pending, uint64_t *recyclable)
+{
+	uint64_t p = 0;
+	uint64_t r = 0;
+
+	for (int i = 0; i < NSHARDS; i++) {
+		uint64_t v;
+
+		util_atomic_load_explicit64(&c->shard[i].pending_count, &v,
+			memory_order_acquire);
+		p += v;
+		util_atomic_load_explicit64(&c->shard[i].recyclable_count, &v,
+			memory_order_acquire);
+		r += v;
+	}
+
+	*pending = p;
+	*recyclable = r;
+}
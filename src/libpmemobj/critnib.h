@@ -23,6 +23,14 @@ int critnib_insert(struct critnib *c, uint64_t key, void *value);
 void *critnib_remove(struct critnib *c, uint64_t key);
 void *critnib_get(struct critnib *c, uint64_t key);
 void *critnib_find_le(struct critnib *c, uint64_t key);
+void *critnib_find_ge(struct critnib *c, uint64_t key);
+
+typedef int (*critnib_range_cb)(uint64_t key, void *value, void *arg);
+int critnib_range(struct critnib *c, uint64_t min, uint64_t max,
+	critnib_range_cb cb, void *arg);
+
+void critnib_gc_stats(struct critnib *c, uint64_t *pending,
+	uint64_t *recyclable);
 
 #ifdef __cplusplus
 }
@@ -5,10 +5,14 @@
  * heap.c -- heap implementation
  */
 
+#define _GNU_SOURCE
+
 #include <errno.h>
+#include <sched.h>
 #include <unistd.h>
 #include <string.h>
 #include <float.h>
+#include <time.h>
 
 #include "bucket.h"
 #include "libpmemobj/ctl.h"
@@ -16,6 +20,7 @@
 #include "queue.h"
 #include "heap.h"
 #include "heap_layout.h"
+#include "mmap.h"
 #include "out.h"
 #include "util.h"
 #include "sys_util.h"
@@ -24,23 +29,48 @@
 #include "container_ravl.h"
 #include "container_seglists.h"
 #include "alloc_class.h"
+#include "os.h"
 #include "os_thread.h"
 #include "set.h"
+#include "badblocks.h"
+#include "file.h"
+#include "maintenance.h"
 
 #define MAX_RUN_LOCKS MAX_CHUNK
 #define MAX_RUN_LOCKS_VG 1024 /* avoid perf issues /w drd */
 
+/*
+ * The number of single-unit memory blocks cached per allocation class in the
+ * per-thread magazine. Chosen so that a full magazine spans at most a small
+ * fraction of a single run, keeping the worst-case memory overhead per
+ * thread negligible.
+ */
+#define MAGAZINE_CAPACITY 16
+
 /*
  * This is the value by which the heap might grow once we hit an OOM.
  */
 #define HEAP_DEFAULT_GROW_SIZE (1 << 27) /* 128 megabytes */
 #define MAX_DEFAULT_ARENAS (1 << 10) /* 1024 arenas */
 
+/*
+ * Number of contended bucket acquisitions after which an arena in a heap
+ * with automatic arena scaling enabled is considered overloaded and a new
+ * arena is created for the contending thread.
+ */
+#define ARENA_CONTENTION_THRESHOLD 1024
+
 enum pobj_arenas_assignment_type Default_arenas_assignment_type =
 	POBJ_ARENAS_ASSIGNMENT_THREAD_KEY;
 
 size_t Default_arenas_max = 0;
 
+/*
+ * The number of threads used to precompute run occupancies when a pool is
+ * opened without a clean shutdown snapshot, 0 means the scan stays lazy.
+ */
+size_t Default_boot_scan_threads = 0;
+
 struct arenas_thread_assignment {
 	enum pobj_arenas_assignment_type type;
 	union {
@@ -61,6 +91,16 @@ struct arenas {
 
 	/* stores a pointer to one of the arenas */
 	struct arenas_thread_assignment assignment;
+
+	/* the heap the arenas belong to */
+	struct palloc_heap *heap;
+
+	/*
+	 * When set, new arenas are created in response to sustained bucket
+	 * contention and arenas that lose their last thread discard their
+	 * cached runs, heap.narenas.auto_scale.
+	 */
+	int auto_scale;
 };
 
 /*
@@ -79,8 +119,67 @@ struct arena {
 	int automatic;
 	size_t nthreads;
 	struct arenas *arenas;
+
+	/* the number of contended bucket acquisitions, reset on scaling */
+	uint64_t contentions;
+
+	/* numa node preferred by this arena, assigned round-robin */
+	unsigned numa_node;
 };
 
+/*
+ * A single memory block stashed away in a thread's magazine. The memory
+ * block is already carved out of a run, so handing it out requires no
+ * shared state whatsoever. The reservation counter of the originating run
+ * is bumped for as long as the block sits in the magazine so that the run
+ * cannot be discarded from underneath us.
+ */
+struct magazine_block {
+	struct memory_block m;
+	struct memory_block_reserved *mresv;
+};
+
+struct magazine {
+	size_t nblocks;
+	struct magazine_block blocks[MAGAZINE_CAPACITY];
+};
+
+/*
+ * Per-thread cache of pre-carved memory blocks, one magazine for each
+ * allocation class. Accessed only by the owning thread, flushed back into
+ * the shared buckets when the thread exits.
+ */
+struct thread_magazines {
+	struct palloc_heap *heap;
+	struct magazine mags[MAX_ALLOCATION_CLASSES];
+};
+
+/*
+ * Volatile per-zone allocator state, updated on (nearly) every allocation
+ * and free. Each zone gets its own cache line - packing several zones'
+ * counters into one line makes concurrent allocations in different zones
+ * false-share it under multi-arena allocation storms.
+ */
+struct zone_rt {
+	/*
+	 * Occupancy summary, rebuilt from the chunk headers during the lazy
+	 * zone reclamation scan and updated incrementally afterwards. Unlike
+	 * the stats module counters these track absolute values, so they
+	 * cannot be toggled at runtime.
+	 */
+	struct zone_occupancy occupancy;
+
+	/*
+	 * Seconds-granularity timestamp of the last allocator activity in
+	 * the zone, sampled alongside the occupancy updates. Used to pick
+	 * cold zones for the heap.cold ctl namespace.
+	 */
+	uint64_t access;
+
+	/* counter of sampled oid translations, see heap_heat_record */
+	uint64_t heat;
+} __attribute__((aligned(CACHELINE_SIZE)));
+
 struct heap_rt {
 	struct alloc_class_collection *alloc_classes;
 
@@ -95,6 +194,47 @@ struct heap_rt {
 
 	unsigned nzones;
 	int *zone_reclaimed_map;
+
+	/*
+	 * An array of nzones per-zone volatile state entries, each in its
+	 * own cache line - see struct zone_rt.
+	 */
+	struct zone_rt *zone_rt;
+
+	uint64_t zone_access_clock;
+	uint64_t zone_access_ops;
+
+	/*
+	 * Run occupancies restored from the clean shutdown snapshot, sorted
+	 * by zone and chunk id. NULL if no valid snapshot was found on open.
+	 */
+	struct recycler_element *snapshot;
+	size_t snapshot_nentries;
+
+	/*
+	 * Media error ranges that overlap the heap, with offsets relative to
+	 * the heap start. Gathered once at boot; free chunks overlapping any
+	 * of the ranges are persistently retired, either right away for
+	 * zones that are already initialized or when the zone is first
+	 * initialized later on.
+	 */
+	struct badblocks badblocks;
+
+	/*
+	 * Nonzero for pools with the PART_GROW compat feature, whose sparse
+	 * part files claim their capacity zone by zone on first use.
+	 */
+	int part_grow;
+
+	/* per-thread allocation magazines, enabled via ctl */
+	os_tls_key_t magazines;
+	int magazines_enabled;
+
+	/*
+	 * The number of numa nodes the arenas are partitioned across,
+	 * 0 means that the assignment of threads to arenas is numa-unaware.
+	 */
+	unsigned numa_nodes;
 };
 
 /*
@@ -132,11 +272,13 @@ heap_get_recycler(struct palloc_heap *heap, size_t id, size_t nallocs)
  * heap_arenas_init - (internal) initialize generic arenas info
  */
 static int
-heap_arenas_init(struct arenas *arenas)
+heap_arenas_init(struct palloc_heap *heap, struct arenas *arenas)
 {
 	util_mutex_init(&arenas->lock);
 	VEC_INIT(&arenas->vec);
 	arenas->nactive = 0;
+	arenas->heap = heap;
+	arenas->auto_scale = 0;
 
 	if (VEC_RESERVE(&arenas->vec, MAX_DEFAULT_ARENAS) == -1)
 		return -1;
@@ -223,6 +365,8 @@ heap_get_best_class(struct palloc_heap *heap, size_t size)
 	return alloc_class_by_alloc_size(heap->rt->alloc_classes, size);
 }
 
+static void heap_arena_quiesce(struct palloc_heap *heap, struct arena *a);
+
 /*
  * heap_arena_thread_detach -- detaches arena from the current thread
  *
@@ -236,8 +380,12 @@ heap_arena_thread_detach(struct arena *a)
 	 * concurrently from the recycler (without the arenas lock).
 	 * That's why we are using an atomic operation.
 	 */
-	if ((--a->nthreads) == 0)
+	if ((--a->nthreads) == 0) {
 		util_fetch_and_sub64(&a->arenas->nactive, 1);
+
+		if (a->arenas->auto_scale && a->automatic)
+			heap_arena_quiesce(a->arenas->heap, a);
+	}
 }
 
 /*
@@ -368,10 +516,30 @@ heap_global_arena_assign(struct palloc_heap *heap)
 	return a;
 }
 
+/*
+ * heap_current_numa_node -- (internal) returns the numa node on which the
+ *	calling thread is currently running
+ */
+static unsigned
+heap_current_numa_node(void)
+{
+	unsigned cpu;
+	unsigned node;
+
+	if (getcpu(&cpu, &node) != 0)
+		return 0;
+
+	return node;
+}
+
 /*
  * heap_thread_arena_assign -- (internal) assigns the least used arena
  *	to current thread
  *
+ * If the arenas are partitioned across numa nodes, only the arenas local to
+ * the node the thread is running on are considered, so that the thread keeps
+ * allocating from the same region of the pool as its numa neighbors.
+ *
  * To avoid complexities with regards to races in the search for the least
  * used arena, a lock is used, but the nthreads counter of the arena is still
  * bumped using atomic instruction because it can happen in parallel to a
@@ -386,15 +554,32 @@ heap_thread_arena_assign(struct palloc_heap *heap)
 
 	ASSERTne(VEC_SIZE(&heap->rt->arenas.vec), 0);
 
+	unsigned numa_nodes = heap->rt->numa_nodes;
+	unsigned node = numa_nodes == 0 ? 0 :
+		heap_current_numa_node() % numa_nodes;
+
 	struct arena *a;
 	VEC_FOREACH(a, &heap->rt->arenas.vec) {
 		if (!a->automatic)
 			continue;
+		if (numa_nodes != 0 && a->numa_node != node)
+			continue;
 		if (least_used == NULL ||
 			a->nthreads < least_used->nthreads)
 			least_used = a;
 	}
 
+	/* fall back to any automatic arena if no node-local one exists */
+	if (least_used == NULL) {
+		VEC_FOREACH(a, &heap->rt->arenas.vec) {
+			if (!a->automatic)
+				continue;
+			if (least_used == NULL ||
+				a->nthreads < least_used->nthreads)
+				least_used = a;
+		}
+	}
+
 	LOG(4, "assigning %p arena to current thread", least_used);
 
 	/* at least one automatic arena must exist */
@@ -462,6 +647,35 @@ heap_get_thread_arena_id(struct palloc_heap *heap)
 	return arena_id;
 }
 
+/*
+ * heap_arena_grow -- (internal) creates a new automatic arena for the
+ *	current thread in response to sustained bucket contention
+ *
+ * The heap grows only up to the configured maximum number of arenas; once
+ * the limit is reached the contending threads keep their assignments.
+ */
+static void
+heap_arena_grow(struct palloc_heap *heap, struct arena *arena)
+{
+	util_atomic_store_explicit64(&arena->contentions, 0,
+		memory_order_relaxed);
+
+	if (heap->rt->arenas.assignment.type !=
+			POBJ_ARENAS_ASSIGNMENT_THREAD_KEY)
+		return;
+
+	if (heap_get_narenas_total(heap) >= heap_get_narenas_max(heap))
+		return;
+
+	int arena_id = heap_arena_create(heap);
+	if (arena_id < 0)
+		return;
+
+	/* the new arena must participate in automatic assignment */
+	heap_set_arena_auto(heap, (unsigned)arena_id, 1);
+	heap_set_arena_thread(heap, (unsigned)arena_id);
+}
+
 /*
  * heap_bucket_acquire -- fetches by arena or by id a bucket exclusive
  * for the thread until heap_bucket_release is called
@@ -482,6 +696,24 @@ heap_bucket_acquire(struct palloc_heap *heap, uint8_t class_id,
 		struct arena *arena = heap_thread_arena(heap);
 		ASSERTne(arena->buckets, NULL);
 		b = arena->buckets[class_id];
+
+		if (rt->arenas.auto_scale) {
+			struct bucket *fast = bucket_try_acquire(b);
+			if (fast != NULL)
+				return fast;
+
+			/*
+			 * With automatic scaling enabled, contended
+			 * acquisitions are counted and an overloaded arena is
+			 * split by moving the contending thread to a newly
+			 * created arena. The current operation still uses the
+			 * old arena's bucket - only the subsequent ones go to
+			 * the new arena.
+			 */
+			if (util_fetch_and_add64(&arena->contentions, 1) + 1 >=
+					ARENA_CONTENTION_THRESHOLD)
+				heap_arena_grow(heap, arena);
+		}
 	} else {
 		b = (VEC_ARR(&heap->rt->arenas.vec)
 			[arena_id - 1])->buckets[class_id];
@@ -552,6 +784,33 @@ zone_calc_size_idx(uint32_t zone_id, unsigned max_zone, size_t heap_size)
 	return (uint32_t)zone_size_idx;
 }
 
+/*
+ * heap_zone_backing_grow -- (internal) claims the file backing of a zone
+ *
+ * Pools with the PART_GROW feature have sparse part files; the zone's file
+ * range is allocated right before its first use, so that running out of
+ * space surfaces as OOM on allocation rather than as SIGBUS on first write.
+ */
+static int
+heap_zone_backing_grow(struct palloc_heap *heap, uint32_t zone_id)
+{
+	if (!heap->rt->part_grow || heap->set == NULL)
+		return 0;
+
+	struct zone *z = ZID_TO_ZONE(heap->layout, zone_id);
+	uint32_t size_idx = zone_calc_size_idx(zone_id, heap->rt->nzones,
+			*heap->sizep);
+
+	size_t offset = (size_t)((char *)z - (char *)heap->base);
+	size_t len = sizeof(z->header) + sizeof(z->chunk_headers) +
+		(size_t)size_idx * CHUNKSIZE;
+
+	if (util_poolset_grow_range(heap->set, offset, len) != 0)
+		return ENOMEM;
+
+	return 0;
+}
+
 /*
  * heap_zone_init -- (internal) writes zone's first chunk and header
  */
@@ -675,6 +934,18 @@ heap_free_chunk_reuse(struct palloc_heap *heap,
 	struct bucket *bucket,
 	struct memory_block *m)
 {
+	/*
+	 * Under a foreground latency budget the merge is left to the
+	 * background recycle task, which coalesces adjacent free chunks
+	 * during its zone scan; the chunk header is already in a valid
+	 * free state, so skipping the merge only costs fragmentation
+	 * until the task catches up.
+	 */
+	if (heap->latency_budget != 0 && heap->maint != NULL) {
+		maintenance_wake(heap->maint);
+		return bucket_insert_block(bucket, m);
+	}
+
 	/*
 	 * Perform coalescing just in case there
 	 * are any neighboring free chunks.
@@ -690,174 +961,949 @@ heap_free_chunk_reuse(struct palloc_heap *heap,
 }
 
 /*
- * heap_run_into_free_chunk -- (internal) creates a new free chunk in place of
- *	a run.
+ * The per-zone access clock is refreshed once per that many occupancy
+ * updates; the recency tracking only needs seconds granularity, so reading
+ * the time on every allocation would be wasted work.
+ */
+#define ZONE_ACCESS_CLOCK_INTERVAL 1024
+
+/*
+ * heap_zone_access_sample -- (internal) stamps a zone with the coarse access
+ *	clock
  */
 static void
-heap_run_into_free_chunk(struct palloc_heap *heap,
-	struct bucket *bucket,
-	struct memory_block *m)
+heap_zone_access_sample(struct palloc_heap *heap, uint32_t zone_id)
 {
-	struct chunk_header *hdr = heap_get_chunk_hdr(heap, m);
-
-	m->block_off = 0;
-	m->size_idx = hdr->size_idx;
-
-	STATS_SUB(heap->stats, transient, heap_run_active,
-		m->size_idx * CHUNKSIZE);
-
-	/*
-	 * The only thing this could race with is heap_memblock_on_free()
-	 * because that function is called after processing the operation,
-	 * which means that a different thread might immediately call this
-	 * function if the free() made the run empty.
-	 * We could forgo this lock if it weren't for helgrind which needs it
-	 * to establish happens-before relation for the chunk metadata.
-	 */
-	os_mutex_t *lock = m->m_ops->get_lock(m);
-	util_mutex_lock(lock);
-
-	*m = memblock_huge_init(heap, m->chunk_id, m->zone_id, m->size_idx);
+	struct heap_rt *h = heap->rt;
 
-	heap_free_chunk_reuse(heap, bucket, m);
+	/* the ops counter is racy by design, sampling needs no precision */
+	if ((h->zone_access_ops++ % ZONE_ACCESS_CLOCK_INTERVAL) == 0)
+		util_atomic_store_explicit64(&h->zone_access_clock,
+			(uint64_t)time(NULL), memory_order_relaxed);
 
-	util_mutex_unlock(lock);
+	uint64_t clock;
+	util_atomic_load_explicit64(&h->zone_access_clock, &clock,
+		memory_order_relaxed);
+	util_atomic_store_explicit64(&h->zone_rt[zone_id].access, clock,
+		memory_order_relaxed);
 }
 
 /*
- * heap_reclaim_run -- checks the run for available memory if unclaimed.
+ * heap_zone_idle -- reads the seconds elapsed since the last allocator
+ *	activity in the given zone
  *
- * Returns 1 if reclaimed chunk, 0 otherwise.
+ * Zones with no recorded activity since the pool was opened report
+ * UINT64_MAX, so they always qualify as cold.
  */
-static int
-heap_reclaim_run(struct palloc_heap *heap, struct memory_block *m, int startup)
+int
+heap_zone_idle(struct palloc_heap *heap, uint32_t zone_id, uint64_t *idle)
 {
-	struct chunk_run *run = heap_get_chunk_run(heap, m);
-	struct chunk_header *hdr = heap_get_chunk_hdr(heap, m);
-
-	struct alloc_class *c = alloc_class_by_run(
-		heap->rt->alloc_classes,
-		run->hdr.block_size, hdr->flags, m->size_idx);
-
-	struct recycler_element e = recycler_element_new(heap, m);
-	if (c == NULL) {
-#ifdef DEBUG
-		uint32_t size_idx = m->size_idx;
-#endif
-		struct run_bitmap b;
-		m->m_ops->get_bitmap(m, &b);
-
-		ASSERTeq(size_idx, m->size_idx);
+	struct heap_rt *h = heap->rt;
 
-		return e.free_space == b.nbits;
-	}
+	if (zone_id >= h->nzones)
+		return -1;
 
-	if (e.free_space == c->rdsc.nallocs)
-		return 1;
+	uint64_t last;
+	util_atomic_load_explicit64(&h->zone_rt[zone_id].access, &last,
+		memory_order_relaxed);
 
-	if (startup) {
-		STATS_INC(heap->stats, transient, heap_run_active,
-			m->size_idx * CHUNKSIZE);
-		STATS_INC(heap->stats, transient, heap_run_allocated,
-			(c->rdsc.nallocs - e.free_space) * run->hdr.block_size);
+	if (last == 0) {
+		*idle = UINT64_MAX;
+		return 0;
 	}
-	struct recycler *recycler = heap_get_recycler(heap, c->id,
-		c->rdsc.nallocs);
 
-	if (recycler == NULL || recycler_put(recycler, e) < 0)
-		ERR_WO_ERRNO(
-			"lost runtime tracking info of %u run due to OOM",
-			c->id);
+	uint64_t now = (uint64_t)time(NULL);
+	*idle = now > last ? now - last : 0;
 
 	return 0;
 }
 
 /*
- * heap_reclaim_zone_garbage -- (internal) creates volatile state of unused runs
+ * heap_heat_record -- bumps the access heat counter of the zone containing
+ *	the given offset
+ *
+ * Fed by the sampled oid translations, see _pobj_heat_record(). The relaxed
+ * increments may race and lose an occasional sample; the counters drive
+ * tiering heuristics, not correctness, so precision is not worth a stricter
+ * ordering in the translation path.
  */
-static void
-heap_reclaim_zone_garbage(struct palloc_heap *heap, struct bucket *bucket,
-	uint32_t zone_id)
+void
+heap_heat_record(struct palloc_heap *heap, uint64_t off)
 {
-	struct zone *z = ZID_TO_ZONE(heap->layout, zone_id);
+	struct heap_rt *h = heap->rt;
 
-	for (uint32_t i = 0; i < z->header.size_idx; ) {
-		struct chunk_header *hdr = &z->chunk_headers[i];
-		ASSERT(hdr->size_idx != 0);
+	uint32_t zone_id = heap_off_to_zone_id(heap, off);
+	if (zone_id >= h->nzones)
+		return;
 
-		struct memory_block m = MEMORY_BLOCK_NONE;
-		m.zone_id = zone_id;
-		m.chunk_id = i;
-		m.size_idx = hdr->size_idx;
+	util_fetch_and_add64(&h->zone_rt[zone_id].heat, 1);
+}
 
-		memblock_rebuild_state(heap, &m);
-		m.m_ops->reinit_chunk(&m);
+/*
+ * heap_zone_heat -- reads the number of sampled oid translations that
+ *	resolved into the given zone
+ */
+int
+heap_zone_heat(struct palloc_heap *heap, uint32_t zone_id, uint64_t *heat)
+{
+	struct heap_rt *h = heap->rt;
 
-		switch (hdr->type) {
-			case CHUNK_TYPE_RUN:
-				if (heap_reclaim_run(heap, &m, 1) != 0)
-					heap_run_into_free_chunk(heap, bucket,
-						&m);
-				break;
-			case CHUNK_TYPE_FREE:
-				heap_free_chunk_reuse(heap, bucket, &m);
-				break;
-			case CHUNK_TYPE_USED:
-				break;
-			default:
-				ASSERT(0);
-		}
+	if (zone_id >= h->nzones)
+		return -1;
 
-		i = m.chunk_id + m.size_idx; /* hdr might have changed */
-	}
+	util_atomic_load_explicit64(&h->zone_rt[zone_id].heat, heat,
+		memory_order_relaxed);
+
+	return 0;
 }
 
 /*
- * heap_ensure_zone_reclaimed -- make sure that the specified zone has been
- * already reclaimed.
+ * heap_zone_advise_cold -- applies the given madvise hint to every zone with
+ *	no allocator activity for at least min_idle seconds
+ *
+ * Only the chunk payload is advised; the zone and chunk headers stay
+ * resident so that metadata scans don't fault entire zones back in.
  */
-void
-heap_ensure_zone_reclaimed(struct palloc_heap *heap, uint32_t zone_id)
+int
+heap_zone_advise_cold(struct palloc_heap *heap, uint64_t min_idle, int advice,
+	unsigned *nadvised)
 {
-	int zone_reclaimed;
-	util_atomic_load_explicit32(&heap->rt->zone_reclaimed_map[zone_id],
-		&zone_reclaimed, memory_order_acquire);
-	if (zone_reclaimed)
-		return;
+	struct heap_rt *h = heap->rt;
+	unsigned n = 0;
 
-	struct bucket *defb = heap_bucket_acquire(heap,
-		DEFAULT_ALLOC_CLASS_ID,
-		HEAP_ARENA_PER_THREAD);
+	for (uint32_t zone_id = 0; zone_id < h->nzones; ++zone_id) {
+		uint64_t idle;
+		if (heap_zone_idle(heap, zone_id, &idle) != 0)
+			return -1;
 
-#ifdef DEBUG /* variables required for ASSERTs below */
-	struct zone *z = ZID_TO_ZONE(heap->layout, zone_id);
-#endif
-	ASSERTeq(z->header.magic, ZONE_HEADER_MAGIC);
+		if (idle < min_idle)
+			continue;
 
-	/* check a second time just to make sure no other thread was first */
-	util_atomic_load_explicit32(&heap->rt->zone_reclaimed_map[zone_id],
-		&zone_reclaimed, memory_order_acquire);
-	if (zone_reclaimed)
-		goto out;
+		size_t len = (size_t)zone_calc_size_idx(zone_id, h->nzones,
+			*heap->sizep) * CHUNKSIZE;
+		if (util_range_advise(GET_CHUNK(heap->layout, zone_id, 0),
+			len, advice) < 0)
+			return -1;
 
-	util_atomic_store_explicit32(&heap->rt->zone_reclaimed_map[zone_id], 1,
-		memory_order_release);
+		n++;
+	}
 
-	heap_reclaim_zone_garbage(heap, defb, zone_id);
+	if (nadvised != NULL)
+		*nadvised = n;
 
-out:
-	heap_bucket_release(defb);
+	return 0;
 }
 
 /*
- * heap_populate_bucket -- (internal) creates volatile state of memory blocks
+ * heap_zone_resident -- counts the bytes of the zone's chunk payload that
+ *	are resident in physical memory
  */
-static int
-heap_populate_bucket(struct palloc_heap *heap, struct bucket *bucket)
+int
+heap_zone_resident(struct palloc_heap *heap, uint32_t zone_id,
+	uint64_t *resident)
 {
 	struct heap_rt *h = heap->rt;
 
-	unsigned zone_id; /* first not reclaimed zone */
+	if (zone_id >= h->nzones)
+		return -1;
+
+	size_t len = (size_t)zone_calc_size_idx(zone_id, h->nzones,
+		*heap->sizep) * CHUNKSIZE;
+
+	size_t res;
+	if (util_range_resident(GET_CHUNK(heap->layout, zone_id, 0),
+		len, &res) < 0)
+		return -1;
+
+	*resident = res;
+
+	return 0;
+}
+
+/*
+ * heap_zone_prewarm -- faults a slice of the zone's chunk payload into memory
+ *
+ * Reads one cache line per page with a non-temporal prefetch hint so that the
+ * warmup itself does not evict hot data from the caches; the point is to
+ * populate the page tables and the media-side buffers, not the LLC.
+ *
+ * The slice starts offset bytes into the payload and spans at most length
+ * bytes; *touched is set to the number of bytes actually covered, 0 once the
+ * offset is past the end of the zone.
+ */
+int
+heap_zone_prewarm(struct palloc_heap *heap, uint32_t zone_id, size_t offset,
+	size_t length, size_t *touched)
+{
+	struct heap_rt *h = heap->rt;
+
+	if (zone_id >= h->nzones)
+		return -1;
+
+	size_t len = (size_t)zone_calc_size_idx(zone_id, h->nzones,
+		*heap->sizep) * CHUNKSIZE;
+
+	if (offset >= len) {
+		*touched = 0;
+		return 0;
+	}
+
+	if (length > len - offset)
+		length = len - offset;
+
+	char *base = (char *)GET_CHUNK(heap->layout, zone_id, 0) + offset;
+	for (size_t pos = 0; pos < length; pos += Pagesize) {
+		__builtin_prefetch(base + pos, 0, 0);
+		*(volatile char *)(base + pos);
+	}
+
+	*touched = length;
+
+	return 0;
+}
+
+/*
+ * heap_zone_occupancy_update -- accounts an allocated or freed memory block
+ *	in the occupancy summary of its zone
+ */
+void
+heap_zone_occupancy_update(struct palloc_heap *heap,
+	const struct memory_block *m, int alloc)
+{
+	struct zone_occupancy *occ = &heap->rt->zone_rt[m->zone_id].occupancy;
+
+	heap_zone_access_sample(heap, m->zone_id);
+	uint64_t size = m->m_ops->get_real_size(m);
+
+	if (alloc) {
+		util_fetch_and_add64(&occ->allocated, size);
+		if (m->type == MEMORY_BLOCK_RUN)
+			util_fetch_and_add64(&occ->run_allocated, size);
+	} else {
+		util_fetch_and_sub64(&occ->allocated, size);
+		if (m->type == MEMORY_BLOCK_RUN)
+			util_fetch_and_sub64(&occ->run_allocated, size);
+	}
+}
+
+/*
+ * heap_zone_occupancy_run_active -- (internal) accounts chunks turning into
+ *	runs or runs turning back into free chunks
+ */
+static void
+heap_zone_occupancy_run_active(struct palloc_heap *heap, uint32_t zone_id,
+	uint64_t size, int active)
+{
+	struct zone_occupancy *occ = &heap->rt->zone_rt[zone_id].occupancy;
+
+	if (active)
+		util_fetch_and_add64(&occ->run_active, size);
+	else
+		util_fetch_and_sub64(&occ->run_active, size);
+}
+
+/*
+ * heap_zone_occupancy_get -- reads the occupancy summary of a single zone
+ */
+int
+heap_zone_occupancy_get(struct palloc_heap *heap, uint32_t zone_id,
+	struct zone_occupancy *occ)
+{
+	struct heap_rt *h = heap->rt;
+
+	if (zone_id >= h->nzones)
+		return -1;
+
+	occ->capacity = (uint64_t)zone_calc_size_idx(zone_id, h->nzones,
+		*heap->sizep) * CHUNKSIZE;
+
+	struct zone_occupancy *src = &h->zone_rt[zone_id].occupancy;
+	util_atomic_load_explicit64(&src->allocated, &occ->allocated,
+		memory_order_acquire);
+	util_atomic_load_explicit64(&src->run_allocated, &occ->run_allocated,
+		memory_order_acquire);
+	util_atomic_load_explicit64(&src->run_active, &occ->run_active,
+		memory_order_acquire);
+
+	return 0;
+}
+
+/*
+ * heap_zone_count -- returns the maximum number of zones of the heap
+ */
+unsigned
+heap_zone_count(struct palloc_heap *heap)
+{
+	return heap->rt->nzones;
+}
+
+/*
+ * heap_snapshot_element_cmp -- (internal) compares snapshot elements by their
+ *	location in the heap
+ */
+static int
+heap_snapshot_element_cmp(const void *lhs, const void *rhs)
+{
+	const struct recycler_element *l = lhs;
+	const struct recycler_element *r = rhs;
+
+	if (l->zone_id != r->zone_id)
+		return l->zone_id > r->zone_id ? 1 : -1;
+	if (l->chunk_id != r->chunk_id)
+		return l->chunk_id > r->chunk_id ? 1 : -1;
+
+	return 0;
+}
+
+/*
+ * heap_snapshot_find -- (internal) looks up the recorded occupancy of a run
+ *	in the clean shutdown snapshot
+ */
+static const struct recycler_element *
+heap_snapshot_find(struct palloc_heap *heap, const struct memory_block *m)
+{
+	struct heap_rt *h = heap->rt;
+
+	if (h->snapshot == NULL)
+		return NULL;
+
+	struct recycler_element key = {
+		.max_free_block = 0,
+		.free_space = 0,
+		.chunk_id = m->chunk_id,
+		.zone_id = m->zone_id,
+	};
+
+	return bsearch(&key, h->snapshot, h->snapshot_nentries,
+		sizeof(struct recycler_element), heap_snapshot_element_cmp);
+}
+
+/*
+ * heap_snapshot_gather -- collects the current occupancy of every run in the
+ *	heap; with a NULL entries argument only counts the runs
+ */
+size_t
+heap_snapshot_gather(struct palloc_heap *heap,
+	struct recycler_element *entries, size_t capacity)
+{
+	size_t count = 0;
+
+	for (unsigned zone_id = 0; zone_id < heap->rt->nzones; ++zone_id) {
+		struct zone *z = ZID_TO_ZONE(heap->layout, zone_id);
+		if (z->header.magic != ZONE_HEADER_MAGIC)
+			continue; /* not yet initialized */
+
+		for (uint32_t i = 0; i < z->header.size_idx; ) {
+			struct chunk_header *hdr = &z->chunk_headers[i];
+			ASSERT(hdr->size_idx != 0);
+
+			if (hdr->type == CHUNK_TYPE_RUN) {
+				if (entries != NULL) {
+					if (count == capacity)
+						return count;
+
+					struct memory_block m =
+						MEMORY_BLOCK_NONE;
+					m.zone_id = zone_id;
+					m.chunk_id = i;
+					m.size_idx = hdr->size_idx;
+					memblock_rebuild_state(heap, &m);
+
+					entries[count] =
+						recycler_element_new(heap, &m);
+				}
+				count++;
+			}
+
+			i += hdr->size_idx;
+		}
+	}
+
+	return count;
+}
+
+/*
+ * Shared state of the parallel boot scan. Workers grab zones off a shared
+ * counter and gather the occupancy of every run into private vectors, which
+ * are merged into the volatile snapshot table once all of them are done.
+ */
+struct heap_boot_scan {
+	struct palloc_heap *heap;
+	uint64_t next_zone;
+};
+
+struct heap_boot_scan_worker {
+	struct heap_boot_scan *scan;
+	VEC(, struct recycler_element) elements;
+	os_thread_t thread;
+	int err;
+};
+
+/*
+ * heap_boot_scan_worker -- (internal) gathers the occupancy of every run in
+ *	the zones claimed by this worker
+ */
+static void *
+heap_boot_scan_worker(void *arg)
+{
+	struct heap_boot_scan_worker *w = arg;
+	struct palloc_heap *heap = w->scan->heap;
+
+	uint64_t zone_id;
+	while ((zone_id = util_fetch_and_add64(&w->scan->next_zone, 1)) <
+			heap->rt->nzones) {
+		struct zone *z = ZID_TO_ZONE(heap->layout, (uint32_t)zone_id);
+		if (z->header.magic != ZONE_HEADER_MAGIC)
+			continue; /* not yet initialized */
+
+		for (uint32_t i = 0; i < z->header.size_idx; ) {
+			struct chunk_header *hdr = &z->chunk_headers[i];
+			ASSERT(hdr->size_idx != 0);
+
+			if (hdr->type == CHUNK_TYPE_RUN) {
+				struct memory_block m = MEMORY_BLOCK_NONE;
+				m.zone_id = (uint32_t)zone_id;
+				m.chunk_id = i;
+				m.size_idx = hdr->size_idx;
+				memblock_rebuild_state(heap, &m);
+
+				struct recycler_element e =
+					recycler_element_new(heap, &m);
+				if (VEC_PUSH_BACK(&w->elements, e) != 0) {
+					w->err = ENOMEM;
+					return NULL;
+				}
+			}
+
+			i += hdr->size_idx;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * heap_boot_scan_parallel -- precomputes the occupancy of every run with a
+ *	pool of worker threads
+ *
+ * The gathered elements feed the same volatile snapshot table that a clean
+ * shutdown snapshot is loaded into, so the lazy zone reclamation logic stays
+ * unchanged and merges the state through the existing bulk inserts - only the
+ * run bitmap walks, the dominant cost on large pools, run in parallel. Any
+ * failure here simply leaves the table empty and the scans lazy.
+ */
+void
+heap_boot_scan_parallel(struct palloc_heap *heap, unsigned nthreads)
+{
+	LOG(3, "heap %p nthreads %u", heap, nthreads);
+
+	struct heap_boot_scan scan;
+	scan.heap = heap;
+	scan.next_zone = 0;
+
+	if (nthreads > heap->rt->nzones)
+		nthreads = heap->rt->nzones;
+
+	struct heap_boot_scan_worker *workers =
+		Zalloc(sizeof(*workers) * nthreads);
+	if (workers == NULL) {
+		ERR_W_ERRNO("Zalloc");
+		return;
+	}
+
+	unsigned nspawned = 0;
+	for (unsigned i = 0; i < nthreads; ++i) {
+		struct heap_boot_scan_worker *w = &workers[i];
+		w->scan = &scan;
+		VEC_INIT(&w->elements);
+
+		if (os_thread_create(&w->thread, NULL,
+		    heap_boot_scan_worker, w) != 0)
+			break;
+		nspawned++;
+	}
+
+	int err = nspawned == 0 ? ENOMEM : 0;
+	size_t total = 0;
+	for (unsigned i = 0; i < nspawned; ++i) {
+		os_thread_join(&workers[i].thread, NULL);
+		if (workers[i].err != 0)
+			err = workers[i].err;
+		total += VEC_SIZE(&workers[i].elements);
+	}
+
+	if (err == 0 && total != 0) {
+		struct recycler_element *entries =
+			Malloc(sizeof(*entries) * total);
+		if (entries != NULL) {
+			size_t n = 0;
+			for (unsigned i = 0; i < nspawned; ++i) {
+				memcpy(&entries[n],
+					VEC_ARR(&workers[i].elements),
+					VEC_SIZE(&workers[i].elements) *
+					sizeof(*entries));
+				n += VEC_SIZE(&workers[i].elements);
+			}
+
+			(void) heap_snapshot_load(heap, entries, total);
+			Free(entries);
+		}
+	}
+
+	for (unsigned i = 0; i < nthreads; ++i)
+		VEC_DELETE(&workers[i].elements);
+
+	Free(workers);
+}
+
+/*
+ * heap_snapshot_load -- stores a validated snapshot in the heap runtime state
+ *	for use by the zone reclamation scans
+ */
+int
+heap_snapshot_load(struct palloc_heap *heap,
+	const struct recycler_element *entries, size_t nentries)
+{
+	struct heap_rt *h = heap->rt;
+
+	if (nentries == 0)
+		return 0;
+
+	h->snapshot = Malloc(sizeof(*entries) * nentries);
+	if (h->snapshot == NULL) {
+		ERR_W_ERRNO("Malloc");
+		return -1;
+	}
+
+	memcpy(h->snapshot, entries, sizeof(*entries) * nentries);
+	qsort(h->snapshot, nentries, sizeof(*entries),
+		heap_snapshot_element_cmp);
+	h->snapshot_nentries = nentries;
+
+	return 0;
+}
+
+/*
+ * heap_run_into_free_chunk -- (internal) creates a new free chunk in place of
+ *	a run.
+ */
+static void
+heap_run_into_free_chunk(struct palloc_heap *heap,
+	struct bucket *bucket,
+	struct memory_block *m)
+{
+	struct chunk_header *hdr = heap_get_chunk_hdr(heap, m);
+
+	m->block_off = 0;
+	m->size_idx = hdr->size_idx;
+
+	STATS_SUB(heap->stats, transient, heap_run_active,
+		m->size_idx * CHUNKSIZE);
+	heap_zone_occupancy_run_active(heap, m->zone_id,
+		m->size_idx * CHUNKSIZE, 0);
+
+	/*
+	 * The only thing this could race with is heap_memblock_on_free()
+	 * because that function is called after processing the operation,
+	 * which means that a different thread might immediately call this
+	 * function if the free() made the run empty.
+	 * We could forgo this lock if it weren't for helgrind which needs it
+	 * to establish happens-before relation for the chunk metadata.
+	 */
+	os_mutex_t *lock = m->m_ops->get_lock(m);
+	util_mutex_lock(lock);
+
+	*m = memblock_huge_init(heap, m->chunk_id, m->zone_id, m->size_idx);
+
+	heap_free_chunk_reuse(heap, bucket, m);
+
+	util_mutex_unlock(lock);
+}
+
+/*
+ * heap_reclaim_run -- checks the run for available memory if unclaimed.
+ *
+ * Returns 1 if reclaimed chunk, 0 otherwise.
+ */
+static int
+heap_reclaim_run(struct palloc_heap *heap, struct memory_block *m, int startup)
+{
+	struct chunk_run *run = heap_get_chunk_run(heap, m);
+	struct chunk_header *hdr = heap_get_chunk_hdr(heap, m);
+
+	struct alloc_class *c = alloc_class_by_run(
+		heap->rt->alloc_classes,
+		run->hdr.block_size, hdr->flags, m->size_idx);
+
+	/*
+	 * Runs of a known class can reuse the occupancy recorded at the last
+	 * clean shutdown instead of scanning the bitmap. Frees that happened
+	 * in this instance before the zone was reclaimed can only make the
+	 * recorded free space an underestimate, which is benign - the
+	 * recycler recalculation corrects it the same way it handles frees
+	 * racing with the scan.
+	 */
+	struct recycler_element e;
+	const struct recycler_element *se = startup ?
+		heap_snapshot_find(heap, m) : NULL;
+	if (se != NULL && c != NULL)
+		e = *se;
+	else
+		e = recycler_element_new(heap, m);
+
+	if (c == NULL) {
+#ifdef DEBUG
+		uint32_t size_idx = m->size_idx;
+#endif
+		struct run_bitmap b;
+		m->m_ops->get_bitmap(m, &b);
+
+		ASSERTeq(size_idx, m->size_idx);
+
+		return e.free_space == b.nbits;
+	}
+
+	if (e.free_space == c->rdsc.nallocs)
+		return 1;
+
+	if (startup) {
+		uint64_t allocated = (c->rdsc.nallocs - e.free_space) *
+			run->hdr.block_size;
+
+		STATS_INC(heap->stats, transient, heap_run_active,
+			m->size_idx * CHUNKSIZE);
+		STATS_INC(heap->stats, transient, heap_run_allocated,
+			allocated);
+
+		/* rebuild the occupancy summary of a reopened zone */
+		struct zone_occupancy *occ =
+			&heap->rt->zone_rt[m->zone_id].occupancy;
+		util_fetch_and_add64(&occ->run_active,
+			m->size_idx * CHUNKSIZE);
+		util_fetch_and_add64(&occ->run_allocated, allocated);
+		util_fetch_and_add64(&occ->allocated, allocated);
+	}
+	struct recycler *recycler = heap_get_recycler(heap, c->id,
+		c->rdsc.nallocs);
+
+	if (recycler == NULL || recycler_put(recycler, e) < 0)
+		ERR_WO_ERRNO(
+			"lost runtime tracking info of %u run due to OOM",
+			c->id);
+
+	return 0;
+}
+
+/*
+ * heap_reclaimed_frees_insert -- (internal) inserts the free chunks gathered
+ *	during a zone scan into the bucket in one bulk operation
+ */
+static void
+heap_reclaimed_frees_insert(struct bucket *bucket,
+	struct memory_block *blocks, size_t nblocks)
+{
+	if (nblocks == 0)
+		return;
+
+	if (bucket_insert_blocks(bucket, blocks, nblocks) != 0) {
+		/* retry one block at a time before giving the tracking up */
+		for (size_t i = 0; i < nblocks; ++i) {
+			if (bucket_insert_block(bucket, &blocks[i]) != 0)
+				CORE_LOG_WARNING(
+					"failed to allocate memory block runtime tracking info");
+		}
+	}
+}
+
+/*
+ * heap_reclaim_zone_garbage -- (internal) creates volatile state of unused runs
+ */
+static void
+heap_reclaim_zone_garbage(struct palloc_heap *heap, struct bucket *bucket,
+	uint32_t zone_id)
+{
+	struct zone *z = ZID_TO_ZONE(heap->layout, zone_id);
+
+	/*
+	 * Free chunks discovered by the scan are gathered here and inserted
+	 * into the bucket in one sorted bulk operation at the end.  The scan
+	 * visits chunks in address order, so chunks adjacent to the last
+	 * gathered one are coalesced on discovery, without going through
+	 * container lookups.
+	 */
+	VEC(, struct memory_block) frees;
+	VEC_INIT(&frees);
+
+	for (uint32_t i = 0; i < z->header.size_idx; ) {
+		struct chunk_header *hdr = &z->chunk_headers[i];
+		ASSERT(hdr->size_idx != 0);
+
+		struct memory_block m = MEMORY_BLOCK_NONE;
+		m.zone_id = zone_id;
+		m.chunk_id = i;
+		m.size_idx = hdr->size_idx;
+
+		memblock_rebuild_state(heap, &m);
+		m.m_ops->reinit_chunk(&m);
+
+		switch (hdr->type) {
+			case CHUNK_TYPE_RUN:
+				if (heap_reclaim_run(heap, &m, 1) != 0) {
+					/*
+					 * The run turns into a free chunk
+					 * that coalesces through the bucket,
+					 * so the gathered chunks must get
+					 * there first.
+					 */
+					heap_reclaimed_frees_insert(bucket,
+						VEC_ARR(&frees),
+						VEC_SIZE(&frees));
+					VEC_CLEAR(&frees);
+					heap_run_into_free_chunk(heap, bucket,
+						&m);
+				}
+				break;
+			case CHUNK_TYPE_FREE: {
+				struct memory_block *prev =
+					VEC_SIZE(&frees) == 0 ? NULL :
+					&VEC_BACK(&frees);
+				if (prev != NULL && prev->chunk_id +
+				    prev->size_idx == m.chunk_id) {
+					const struct memory_block *bl[2] =
+						{prev, &m};
+					struct memory_block nm =
+						heap_coalesce(heap, bl, 2);
+					nm.m_ops->prep_hdr(&nm,
+						MEMBLOCK_FREE, NULL);
+					*prev = nm;
+					break;
+				}
+
+				struct memory_block nm =
+					heap_coalesce_huge(heap, bucket, &m);
+				if (nm.size_idx != m.size_idx)
+					nm.m_ops->prep_hdr(&nm,
+						MEMBLOCK_FREE, NULL);
+				m = nm;
+				if (VEC_PUSH_BACK(&frees, m) != 0)
+					bucket_insert_block(bucket, &m);
+				break;
+			}
+			case CHUNK_TYPE_BADBLOCK:
+				/* permanently retired, never reusable */
+				break;
+			case CHUNK_TYPE_USED:
+				/* rebuild the occupancy of a reopened zone */
+				util_fetch_and_add64(
+					&heap->rt->zone_rt[zone_id]
+					.occupancy.allocated,
+					(uint64_t)hdr->size_idx * CHUNKSIZE);
+				break;
+			default:
+				ASSERT(0);
+		}
+
+		i = m.chunk_id + m.size_idx; /* hdr might have changed */
+	}
+
+	heap_reclaimed_frees_insert(bucket, VEC_ARR(&frees), VEC_SIZE(&frees));
+	VEC_DELETE(&frees);
+}
+
+/*
+ * heap_zone_retire_badblocks -- (internal) retires the free chunks of a zone
+ *	that overlap a known media error
+ *
+ * Chunks with live data (used chunks and runs) are left alone - their
+ * contents are already compromised and retiring them would only destroy
+ * the metadata needed for recovery. Free chunks are split so that only the
+ * smallest chunk-aligned span covering the bad pages is taken out of
+ * circulation.
+ */
+static void
+heap_zone_retire_badblocks(struct palloc_heap *heap, uint32_t zone_id)
+{
+	struct badblocks *bbs = &heap->rt->badblocks;
+	if (bbs->bb_cnt == 0)
+		return;
+
+	struct zone *z = ZID_TO_ZONE(heap->layout, zone_id);
+	if (z->header.magic != ZONE_HEADER_MAGIC)
+		return;
+
+	uint64_t zone_start = (uint64_t)((char *)&z->chunks[0] -
+		(char *)heap->layout);
+
+	for (uint32_t i = 0; i < z->header.size_idx; ) {
+		struct chunk_header *hdr = &z->chunk_headers[i];
+		uint32_t size_idx = hdr->size_idx;
+		uint64_t start = zone_start + (uint64_t)i * CHUNKSIZE;
+		uint64_t end = start + (uint64_t)size_idx * CHUNKSIZE;
+
+		/*
+		 * Find the lowest bad range overlapping the chunk, expressed
+		 * as a range of chunk ids. The remainder of the chunk is
+		 * rechecked on the next iteration, so disjoint bad ranges
+		 * within one free chunk don't retire the chunks in between.
+		 */
+		uint32_t bad_first = UINT32_MAX;
+		uint32_t bad_last = 0;
+		for (unsigned b = 0; b < bbs->bb_cnt; ++b) {
+			struct bad_block *bb = &bbs->bbv[b];
+			if (bb->offset >= end ||
+			    bb->offset + bb->length <= start)
+				continue;
+
+			uint64_t first = bb->offset > start ?
+				bb->offset : start;
+			uint64_t last = bb->offset + bb->length < end ?
+				bb->offset + bb->length - 1 : end - 1;
+			uint32_t fc = (uint32_t)
+				((first - zone_start) / CHUNKSIZE);
+			uint32_t lc = (uint32_t)
+				((last - zone_start) / CHUNKSIZE);
+
+			if (fc < bad_first) {
+				bad_first = fc;
+				bad_last = lc;
+			} else if (fc == bad_first && lc > bad_last) {
+				bad_last = lc;
+			}
+		}
+
+		if (bad_first == UINT32_MAX) {
+			i += size_idx;
+			continue;
+		}
+
+		if (hdr->type != CHUNK_TYPE_FREE) {
+			if (hdr->type == CHUNK_TYPE_USED ||
+			    hdr->type == CHUNK_TYPE_RUN)
+				CORE_LOG_WARNING(
+					"a media error overlaps live data in zone %u chunk %u",
+					zone_id, i);
+			i += size_idx;
+			continue;
+		}
+
+		/*
+		 * Split the free chunk so that only the span covering the
+		 * bad pages is retired. The interior headers are written
+		 * first and the header of the original chunk last, so an
+		 * interrupted split always leaves a consistent chunk walk.
+		 */
+		if (bad_last + 1 < i + size_idx)
+			memblock_huge_init(heap, bad_last + 1, zone_id,
+				i + size_idx - (bad_last + 1));
+		memblock_badblock_init(heap, bad_first, zone_id,
+			bad_last - bad_first + 1);
+		if (bad_first > i)
+			memblock_huge_init(heap, i, zone_id, bad_first - i);
+
+		i = bad_last + 1;
+	}
+}
+
+/*
+ * heap_report_badblock -- records a media error range discovered at runtime
+ *	and retires the free chunks it overlaps
+ *
+ * Complements heap_gather_badblocks(), which only sees the errors the OS
+ * knew about at open time - the background scrubber feeds the ranges it
+ * trips over here, so the allocator stops handing them out without a
+ * pool reopen. The offset is relative to the heap start.
+ */
+int
+heap_report_badblock(struct palloc_heap *heap, uint64_t offset, size_t length)
+{
+	struct heap_rt *h = heap->rt;
+	struct badblocks *bbs = &h->badblocks;
+
+	if (length == 0 || offset >= *heap->sizep) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (length > *heap->sizep - offset)
+		length = *heap->sizep - offset;
+
+	struct bad_block *bbv = Realloc(bbs->bbv,
+		(bbs->bb_cnt + 1) * sizeof(*bbv));
+	if (bbv == NULL) {
+		ERR_W_ERRNO("Realloc");
+		return -1;
+	}
+	bbv[bbs->bb_cnt].offset = offset;
+	bbv[bbs->bb_cnt].length = length;
+	bbv[bbs->bb_cnt].nhealthy = NO_HEALTHY_REPLICA;
+	bbs->bbv = bbv;
+	bbs->bb_cnt++;
+
+	/* the default bucket lock serializes the splits, as at zone init */
+	struct bucket *defb = heap_bucket_acquire(heap,
+		DEFAULT_ALLOC_CLASS_ID,
+		HEAP_ARENA_PER_THREAD);
+
+	uint64_t zones_start = sizeof(struct heap_header);
+	uint32_t first = offset <= zones_start ? 0 :
+		(uint32_t)((offset - zones_start) / ZONE_MAX_SIZE);
+	uint32_t last = (uint32_t)
+		((offset + length - 1 - zones_start) / ZONE_MAX_SIZE);
+	if (last >= h->nzones)
+		last = h->nzones - 1;
+	for (uint32_t zone_id = first; zone_id <= last; ++zone_id)
+		heap_zone_retire_badblocks(heap, zone_id);
+
+	heap_bucket_release(defb);
+
+	return 0;
+}
+
+/*
+ * heap_ensure_zone_reclaimed -- make sure that the specified zone has been
+ * already reclaimed.
+ */
+void
+heap_ensure_zone_reclaimed(struct palloc_heap *heap, uint32_t zone_id)
+{
+	int zone_reclaimed;
+	util_atomic_load_explicit32(&heap->rt->zone_reclaimed_map[zone_id],
+		&zone_reclaimed, memory_order_acquire);
+	if (zone_reclaimed)
+		return;
+
+	struct bucket *defb = heap_bucket_acquire(heap,
+		DEFAULT_ALLOC_CLASS_ID,
+		HEAP_ARENA_PER_THREAD);
+
+#ifdef DEBUG /* variables required for ASSERTs below */
+	struct zone *z = ZID_TO_ZONE(heap->layout, zone_id);
+#endif
+	ASSERTeq(z->header.magic, ZONE_HEADER_MAGIC);
+
+	/* check a second time just to make sure no other thread was first */
+	util_atomic_load_explicit32(&heap->rt->zone_reclaimed_map[zone_id],
+		&zone_reclaimed, memory_order_acquire);
+	if (zone_reclaimed)
+		goto out;
+
+	util_atomic_store_explicit32(&heap->rt->zone_reclaimed_map[zone_id], 1,
+		memory_order_release);
+
+	heap_reclaim_zone_garbage(heap, defb, zone_id);
+
+out:
+	heap_bucket_release(defb);
+}
+
+/*
+ * heap_populate_bucket -- (internal) creates volatile state of memory blocks
+ */
+static int
+heap_populate_bucket(struct palloc_heap *heap, struct bucket *bucket)
+{
+	struct heap_rt *h = heap->rt;
+
+	unsigned zone_id; /* first not reclaimed zone */
 	for (zone_id = 0; zone_id < h->nzones; ++zone_id) {
 		if (h->zone_reclaimed_map[zone_id] == 0)
 			break;
@@ -876,8 +1922,14 @@ heap_populate_bucket(struct palloc_heap *heap, struct bucket *bucket)
 	VALGRIND_ADD_TO_GLOBAL_TX_IGNORE(z, sizeof(z->header) +
 		sizeof(z->chunk_headers));
 
-	if (z->header.magic != ZONE_HEADER_MAGIC)
+	if (z->header.magic != ZONE_HEADER_MAGIC) {
+		int err = heap_zone_backing_grow(heap, zone_id);
+		if (err != 0)
+			return err;
+
 		heap_zone_init(heap, zone_id, 0);
+		heap_zone_retire_badblocks(heap, zone_id);
+	}
 
 	heap_reclaim_zone_garbage(heap, bucket, zone_id);
 
@@ -970,24 +2022,398 @@ heap_ensure_huge_bucket_filled(struct palloc_heap *heap,
 	if (heap_populate_bucket(heap, bucket) == 0)
 		return 0;
 
-	return ENOMEM;
+	return ENOMEM;
+}
+
+/*
+ * heap_discard_run -- puts the memory block back into the global heap.
+ */
+void
+heap_discard_run(struct palloc_heap *heap, struct memory_block *m)
+{
+	if (heap_reclaim_run(heap, m, 0)) {
+		struct bucket *b =
+			heap_bucket_acquire(heap,
+			DEFAULT_ALLOC_CLASS_ID, 0);
+
+		heap_run_into_free_chunk(heap, b, m);
+
+		heap_bucket_release(b);
+	}
+}
+
+/*
+ * heap_magazine_flush_block -- (internal) returns a cached memory block back
+ *	to the bucket it was carved from
+ */
+static void
+heap_magazine_flush_block(struct palloc_heap *heap, struct magazine_block *mb)
+{
+	struct memory_block_reserved *mresv = mb->mresv;
+
+	struct bucket *b = bucket_acquire(mresv->bucket);
+	bucket_try_insert_attached_block(b, &mb->m);
+	bucket_release(b);
+
+	if (util_fetch_and_sub64(&mresv->nresv, 1) == 1) {
+		VALGRIND_ANNOTATE_HAPPENS_AFTER(&mresv->nresv);
+		/*
+		 * The run this block was carved from is no longer used by any
+		 * bucket nor action, so it can be given back to the heap.
+		 */
+		heap_discard_run(heap, &mresv->m);
+		Free(mresv);
+	} else {
+		VALGRIND_ANNOTATE_HAPPENS_BEFORE(&mresv->nresv);
+	}
+}
+
+/*
+ * heap_magazines_destructor -- (internal) flushes and destroys the magazines
+ *	of an exiting thread
+ */
+static void
+heap_magazines_destructor(void *arg)
+{
+	struct thread_magazines *tm = arg;
+
+	for (int i = 0; i < MAX_ALLOCATION_CLASSES; ++i) {
+		struct magazine *mag = &tm->mags[i];
+		for (size_t j = 0; j < mag->nblocks; ++j)
+			heap_magazine_flush_block(tm->heap, &mag->blocks[j]);
+	}
+
+	Free(tm);
+}
+
+/*
+ * heap_thread_magazines -- (internal) returns the magazines assigned to the
+ *	current thread, creating them on first use
+ */
+static struct thread_magazines *
+heap_thread_magazines(struct palloc_heap *heap)
+{
+	struct thread_magazines *tm = os_tls_get(heap->rt->magazines);
+	if (tm == NULL) {
+		tm = Zalloc(sizeof(*tm));
+		if (tm == NULL)
+			return NULL;
+		tm->heap = heap;
+		os_tls_set(heap->rt->magazines, tm);
+	}
+
+	return tm;
+}
+
+/*
+ * heap_magazine_fill -- (internal) carves out memory blocks from the bucket
+ *	in bulk and stashes them in the magazine
+ *
+ * The shared bucket lock is taken once per MAGAZINE_CAPACITY blocks instead
+ * of once per allocation.
+ */
+static void
+heap_magazine_fill(struct palloc_heap *heap, struct bucket *b,
+	struct magazine *mag)
+{
+	while (mag->nblocks < MAGAZINE_CAPACITY) {
+		struct memory_block m = MEMORY_BLOCK_NONE;
+		m.size_idx = 1;
+
+		if (heap_get_bestfit_block(heap, b, &m) != 0)
+			break;
+
+		struct memory_block_reserved *mresv = bucket_active_block(b);
+		if (mresv == NULL) {
+			/*
+			 * Blocks which don't belong to the currently active
+			 * run of the bucket cannot be tracked outside of it,
+			 * so they are not eligible for caching.
+			 */
+			bucket_insert_block(b, &m);
+			break;
+		}
+		util_fetch_and_add64(&mresv->nresv, 1);
+
+		mag->blocks[mag->nblocks].m = m;
+		mag->blocks[mag->nblocks].mresv = mresv;
+		mag->nblocks++;
+	}
+}
+
+/*
+ * heap_magazine_alloc_block -- hands out a pre-carved single-unit memory
+ *	block from the current thread's magazine, refilling the magazine from
+ *	the shared bucket if it is empty
+ *
+ * In the common case no shared locks are taken at all. Returns nonzero if
+ * the magazines are disabled or no memory could be cached - the caller is
+ * expected to fall back to the regular bucket path.
+ */
+int
+heap_magazine_alloc_block(struct palloc_heap *heap, struct alloc_class *c,
+	struct memory_block *m, struct memory_block_reserved **mresv)
+{
+	struct heap_rt *rt = heap->rt;
+
+	int enabled;
+	util_atomic_load_explicit32(&rt->magazines_enabled, &enabled,
+		memory_order_relaxed);
+	if (!enabled || c->type != CLASS_RUN)
+		return ENOENT;
+
+	struct thread_magazines *tm = heap_thread_magazines(heap);
+	if (tm == NULL)
+		return ENOMEM;
+
+	struct magazine *mag = &tm->mags[c->id];
+	if (mag->nblocks == 0) {
+		struct bucket *b = heap_bucket_acquire(heap, c->id,
+			HEAP_ARENA_PER_THREAD);
+		heap_magazine_fill(heap, b, mag);
+		heap_bucket_release(b);
+
+		if (mag->nblocks == 0)
+			return ENOMEM;
+	}
+
+	struct magazine_block *mb = &mag->blocks[--mag->nblocks];
+	*m = mb->m;
+	*mresv = mb->mresv;
+
+	return 0;
+}
+
+/*
+ * heap_get_magazines_enabled -- returns whether per-thread magazines are
+ *	enabled
+ */
+int
+heap_get_magazines_enabled(struct palloc_heap *heap)
+{
+	return heap->rt->magazines_enabled;
+}
+
+/*
+ * heap_set_magazines_enabled -- enables or disables per-thread magazines
+ *
+ * Blocks already cached by other threads remain cached until those threads
+ * exit - disabling only stops new blocks from being stashed away.
+ */
+void
+heap_set_magazines_enabled(struct palloc_heap *heap, int enabled)
+{
+	util_atomic_store_explicit32(&heap->rt->magazines_enabled, enabled,
+		memory_order_relaxed);
+}
+
+/*
+ * heap_zone_preinit_step -- (internal) initializes the headers of the next
+ *	zone the allocator is going to use, if it hasn't been initialized yet
+ *
+ * The default bucket lock serializes this against heap_populate_bucket()
+ * initializing the very same zone on the allocation path.
+ */
+static void
+heap_zone_preinit_step(struct palloc_heap *heap)
+{
+	struct heap_rt *h = heap->rt;
+
+	unsigned zone_id; /* first not reclaimed zone */
+	for (zone_id = 0; zone_id < h->nzones; ++zone_id) {
+		int reclaimed;
+		util_atomic_load_explicit32(&h->zone_reclaimed_map[zone_id],
+			&reclaimed, memory_order_acquire);
+		if (reclaimed == 0)
+			break;
+	}
+
+	if (zone_id == h->nzones)
+		return;
+
+	struct zone *z = ZID_TO_ZONE(heap->layout, zone_id);
+	if (z->header.magic == ZONE_HEADER_MAGIC)
+		return;
+
+	struct bucket *defb = heap_bucket_acquire(heap,
+		DEFAULT_ALLOC_CLASS_ID,
+		HEAP_ARENA_PER_THREAD);
+
+	/* check again, the allocator might have gotten there first */
+	int reclaimed;
+	util_atomic_load_explicit32(&h->zone_reclaimed_map[zone_id],
+		&reclaimed, memory_order_acquire);
+	if (reclaimed == 0 && z->header.magic != ZONE_HEADER_MAGIC &&
+	    heap_zone_backing_grow(heap, zone_id) == 0) {
+		heap_zone_init(heap, zone_id, 0);
+		heap_zone_retire_badblocks(heap, zone_id);
+		maintenance_bw_account(heap->maint,
+			sizeof(z->header) + sizeof(z->chunk_headers));
+	}
+
+	heap_bucket_release(defb);
+}
+
+/*
+ * heap_zone_preinit_task -- (internal) body of the "zone_preinit"
+ *	maintenance task
+ */
+static int
+heap_zone_preinit_task(void *arg)
+{
+	heap_zone_preinit_step(arg);
+
+	return 0;
+}
+
+/*
+ * heap_get_zone_preinit_enabled -- returns whether the background zone
+ *	pre-initialization task is enabled
+ */
+int
+heap_get_zone_preinit_enabled(struct palloc_heap *heap)
+{
+	return heap->maint != NULL &&
+		maintenance_task_get_enabled(heap->maint, "zone_preinit");
+}
+
+/*
+ * heap_set_zone_preinit_enabled -- enables or disables the background zone
+ *	pre-initialization task
+ */
+int
+heap_set_zone_preinit_enabled(struct palloc_heap *heap, int enabled)
+{
+	if (heap->maint == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return maintenance_task_set_enabled(heap->maint, "zone_preinit",
+		enabled);
+}
+
+/*
+ * heap_recycle_task -- (internal) body of the "recycle" maintenance task
+ *
+ * Coalesces completely empty runs back into free chunks in the background,
+ * so the space becomes available to other size classes without waiting for
+ * an allocation to exhaust its bucket first.
+ */
+static int
+heap_recycle_task(void *arg)
+{
+	heap_reclaim_garbage(arg, NULL);
+
+	return 0;
+}
+
+/*
+ * heap_get_recycle_enabled -- returns whether the background run
+ *	recycling task is enabled
+ */
+int
+heap_get_recycle_enabled(struct palloc_heap *heap)
+{
+	return heap->maint != NULL &&
+		maintenance_task_get_enabled(heap->maint, "recycle");
+}
+
+/*
+ * heap_set_recycle_enabled -- enables or disables the background run
+ *	recycling task
+ */
+int
+heap_set_recycle_enabled(struct palloc_heap *heap, int enabled)
+{
+	if (heap->maint == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return maintenance_task_set_enabled(heap->maint, "recycle", enabled);
+}
+
+/*
+ * heap_get_latency_budget -- returns the foreground latency budget in
+ *	microseconds, 0 when unbounded
+ */
+unsigned
+heap_get_latency_budget(struct palloc_heap *heap)
+{
+	return heap->latency_budget;
+}
+
+/*
+ * heap_set_latency_budget -- sets the foreground latency budget
+ *
+ * A non-zero budget puts the heap into bounded-latency mode: deferrable
+ * foreground work moves to the maintenance thread and the background tasks
+ * that take allocator work off the critical path (zone pre-initialization,
+ * run recycling, pre-zeroing) are enabled. Setting the budget back to 0
+ * leaves the task enablement as-is, so explicit per-task settings survive.
+ */
+int
+heap_set_latency_budget(struct palloc_heap *heap, unsigned budget)
+{
+	if (heap->maint == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	heap->latency_budget = budget;
+
+	if (budget != 0) {
+		maintenance_task_set_enabled(heap->maint, "zone_preinit", 1);
+		maintenance_task_set_enabled(heap->maint, "recycle", 1);
+		maintenance_task_set_enabled(heap->maint, "prezero", 1);
+		maintenance_wake(heap->maint);
+	}
+
+	return 0;
+}
+
+/*
+ * heap_maintenance_boot -- creates the maintenance thread state and
+ *	registers the built-in background tasks
+ */
+int
+heap_maintenance_boot(struct palloc_heap *heap)
+{
+	struct maintenance *m = maintenance_new();
+	if (m == NULL)
+		return ENOMEM;
+
+	if (maintenance_task_register(m, "zone_preinit",
+			heap_zone_preinit_task, heap) != 0 ||
+	    maintenance_task_register(m, "recycle",
+			heap_recycle_task, heap) != 0 ||
+	    maintenance_task_register(m, "prezero",
+			palloc_prezero_task, heap) != 0 ||
+	    maintenance_task_register(m, "watermark",
+			palloc_watermark_task, heap) != 0) {
+		int err = errno;
+		maintenance_delete(m);
+		return err;
+	}
+
+	heap->maint = m;
+
+	return 0;
 }
 
 /*
- * heap_discard_run -- puts the memory block back into the global heap.
+ * heap_maintenance_cleanup -- stops the maintenance thread and frees its
+ *	state
+ *
+ * Must be called before the heap's runtime state is torn down, as the tasks
+ * operate on it.
  */
 void
-heap_discard_run(struct palloc_heap *heap, struct memory_block *m)
+heap_maintenance_cleanup(struct palloc_heap *heap)
 {
-	if (heap_reclaim_run(heap, m, 0)) {
-		struct bucket *b =
-			heap_bucket_acquire(heap,
-			DEFAULT_ALLOC_CLASS_ID, 0);
-
-		heap_run_into_free_chunk(heap, b, m);
-
-		heap_bucket_release(b);
-	}
+	maintenance_delete(heap->maint);
+	heap->maint = NULL;
 }
 
 /*
@@ -1008,6 +2434,28 @@ heap_detach_and_try_discard_run(struct palloc_heap *heap, struct bucket *b)
 	return 0;
 }
 
+/*
+ * heap_arena_quiesce -- (internal) discards the runs cached in the buckets
+ *	of an arena that lost its last thread
+ *
+ * Called when automatic arena scaling is enabled, so that arenas left idle
+ * by a shrinking thread pool do not pin partially used runs that the busy
+ * arenas could reuse. Must be called with arenas lock taken.
+ */
+static void
+heap_arena_quiesce(struct palloc_heap *heap, struct arena *a)
+{
+	for (int i = 0; i < MAX_ALLOCATION_CLASSES; ++i) {
+		struct bucket_locked *locked = a->buckets[i];
+		if (locked == NULL)
+			continue;
+
+		struct bucket *b = bucket_acquire(locked);
+		heap_detach_and_try_discard_run(heap, b);
+		bucket_release(b);
+	}
+}
+
 /*
  * heap_force_recycle -- detaches all memory from arenas, and forces global
  *	recycling of all memory blocks
@@ -1032,6 +2480,34 @@ heap_force_recycle(struct palloc_heap *heap)
 	heap_reclaim_garbage(heap, NULL);
 }
 
+/*
+ * The zone preferred for run reuse by the current thread, set for the
+ * duration of an allocation that carries a placement hint. UINT32_MAX means
+ * no preference.
+ */
+static __thread uint32_t Zone_preference = UINT32_MAX;
+
+/*
+ * heap_set_zone_preference -- sets the zone the current thread prefers to
+ *	reuse runs from, UINT32_MAX clears the preference
+ */
+void
+heap_set_zone_preference(uint32_t zone_id)
+{
+	Zone_preference = zone_id;
+}
+
+/*
+ * heap_off_to_zone_id -- returns the id of the zone the offset belongs to
+ */
+uint32_t
+heap_off_to_zone_id(struct palloc_heap *heap, uint64_t off)
+{
+	off -= HEAP_PTR_TO_OFF(heap, &heap->layout->zone0);
+
+	return (uint32_t)(off / ZONE_MAX_SIZE);
+}
+
 /*
  * heap_reuse_from_recycler -- (internal) try reusing runs that are currently
  *	in the recycler
@@ -1053,12 +2529,16 @@ heap_reuse_from_recycler(struct palloc_heap *heap,
 		return 0;
 	}
 
-	if (!force && recycler_get(recycler, &m) == 0)
+	const struct recycler_run_hint *hints = bucket_recent_runs(b);
+
+	if (!force && recycler_get_preferred(recycler, &m, Zone_preference,
+			hints, BUCKET_RECENT_RUNS) == 0)
 		return bucket_attach_run(b, &m);
 
 	heap_recycle_unused(heap, recycler, NULL, force);
 
-	if (recycler_get(recycler, &m) == 0)
+	if (recycler_get_preferred(recycler, &m, Zone_preference,
+			hints, BUCKET_RECENT_RUNS) == 0)
 		return bucket_attach_run(b, &m);
 
 	return ENOMEM;
@@ -1078,6 +2558,8 @@ heap_run_create(struct palloc_heap *heap, struct bucket *b,
 
 	STATS_INC(heap->stats, transient, heap_run_active,
 		m->size_idx * CHUNKSIZE);
+	heap_zone_occupancy_run_active(heap, m->zone_id,
+		m->size_idx * CHUNKSIZE, 1);
 
 	return 0;
 }
@@ -1140,11 +2622,16 @@ out:
 }
 
 /*
- * heap_memblock_on_free -- bookkeeping actions executed at every free of a
- *	block
+ * heap_memblock_on_free_units -- bookkeeping actions executed when a given
+ *	number of units is freed from one run
+ *
+ * The run lookup and the recycler accounting are done once for the whole
+ * batch, so callers freeing many blocks from one run can merge them into a
+ * single call.
  */
 void
-heap_memblock_on_free(struct palloc_heap *heap, const struct memory_block *m)
+heap_memblock_on_free_units(struct palloc_heap *heap,
+	const struct memory_block *m, uint32_t units)
 {
 	if (m->type != MEMORY_BLOCK_RUN)
 		return;
@@ -1167,10 +2654,20 @@ heap_memblock_on_free(struct palloc_heap *heap, const struct memory_block *m)
 		ERR_WO_ERRNO("lost runtime tracking info of %u run due to OOM",
 			c->id);
 	} else {
-		recycler_inc_unaccounted(recycler, m);
+		recycler_inc_unaccounted_units(recycler, m->chunk_id, units);
 	}
 }
 
+/*
+ * heap_memblock_on_free -- bookkeeping actions executed at every free of a
+ *	block
+ */
+void
+heap_memblock_on_free(struct palloc_heap *heap, const struct memory_block *m)
+{
+	heap_memblock_on_free_units(heap, m, m->size_idx);
+}
+
 /*
  * heap_split_block -- (internal) splits unused part of the memory block
  */
@@ -1274,6 +2771,8 @@ heap_arena_create(struct palloc_heap *heap)
 		goto err_push_back;
 
 	int ret = (int)VEC_SIZE(&h->arenas.vec);
+	if (h->numa_nodes != 0)
+		arena->numa_node = ((unsigned)ret - 1) % h->numa_nodes;
 	util_mutex_unlock(&h->arenas.lock);
 
 	return ret;
@@ -1340,6 +2839,67 @@ out:
 	return ret;
 }
 
+/*
+ * heap_get_arena_auto_scale -- returns whether automatic arena scaling is
+ *	enabled
+ */
+int
+heap_get_arena_auto_scale(struct palloc_heap *heap)
+{
+	return heap->rt->arenas.auto_scale;
+}
+
+/*
+ * heap_set_arena_auto_scale -- enables or disables automatic arena scaling
+ */
+void
+heap_set_arena_auto_scale(struct palloc_heap *heap, int enabled)
+{
+	util_atomic_store_explicit32(&heap->rt->arenas.auto_scale, enabled,
+		memory_order_relaxed);
+}
+
+/*
+ * heap_get_numa_nodes -- returns the number of numa nodes the arenas are
+ *	partitioned across
+ */
+unsigned
+heap_get_numa_nodes(struct palloc_heap *heap)
+{
+	struct heap_rt *h = heap->rt;
+
+	util_mutex_lock(&h->arenas.lock);
+	unsigned nnodes = h->numa_nodes;
+	util_mutex_unlock(&h->arenas.lock);
+
+	return nnodes;
+}
+
+/*
+ * heap_set_numa_nodes -- partitions the arenas across the given number of
+ *	numa nodes, assigning the preferred node of each arena round-robin
+ *
+ * Passing 0 makes the assignment of threads to arenas numa-unaware again.
+ */
+void
+heap_set_numa_nodes(struct palloc_heap *heap, unsigned nnodes)
+{
+	struct heap_rt *h = heap->rt;
+
+	util_mutex_lock(&h->arenas.lock);
+
+	h->numa_nodes = nnodes;
+
+	unsigned i = 0;
+	struct arena *a;
+	VEC_FOREACH(a, &h->arenas.vec) {
+		a->numa_node = nnodes == 0 ? 0 : i % nnodes;
+		i++;
+	}
+
+	util_mutex_unlock(&h->arenas.lock);
+}
+
 /*
  * heap_get_narenas_auto -- returns the number of all automatic arenas
  */
@@ -1539,6 +3099,10 @@ heap_extend(struct palloc_heap *heap, struct bucket *b, size_t size)
 	uint32_t zone_id = nzones - 1;
 	struct zone *z = ZID_TO_ZONE(heap->layout, zone_id);
 	uint32_t chunk_id = heap->rt->nzones == nzones ? z->header.size_idx : 0;
+
+	if (heap_zone_backing_grow(heap, zone_id) != 0)
+		return -1;
+
 	heap_zone_init(heap, zone_id, chunk_id);
 
 	if (heap->rt->nzones != nzones) {
@@ -1560,6 +3124,179 @@ heap_extend(struct palloc_heap *heap, struct bucket *b, size_t size)
 	return 1;
 }
 
+/*
+ * heap_punch_zone_hole -- (internal) returns the backing of a pool-relative
+ *	range to the filesystem, in every replica
+ */
+static int
+heap_punch_zone_hole(struct pool_set *set, uint64_t off, uint64_t len)
+{
+	/* header size for all headers but the first one */
+	size_t hdrsize = (set->options & (OPTION_SINGLEHDR | OPTION_NOHDRS)) ?
+		0 : Mmap_align;
+	int ret = 0;
+
+	for (unsigned r = 0; r < set->nreplicas; ++r) {
+		struct pool_replica *rep = REP(set, r);
+		for (unsigned p = 0; p < rep->nparts; ++p) {
+			struct pool_set_part *part = PART(rep, p);
+			uint64_t pstart = (uint64_t)((char *)part->addr -
+				(char *)rep->part[0].addr);
+
+			/* clip the range to the part */
+			uint64_t start = off > pstart ? off : pstart;
+			uint64_t end = off + len < pstart + part->size ?
+				off + len : pstart + part->size;
+			if (start >= end)
+				continue;
+
+			os_off_t file_off = (os_off_t)(start - pstart) +
+				(os_off_t)(p > 0 ? hdrsize : 0);
+
+			if (util_file_punch_hole(part->path, file_off,
+			    end - start) != 0)
+				ret = -1;
+		}
+	}
+
+	return ret;
+}
+
+/*
+ * heap_reclaim_backing -- returns the backing storage of fully free zones to
+ *	the filesystem
+ *
+ * Only zones without any volatile state are considered - once a zone has been
+ * scanned into the buckets, its free chunks are owned by the allocator and
+ * taking them away would require draining all the containers. A punched zone
+ * reverts to the uninitialized state and is not touched again until the
+ * allocator actually runs out of memory in the zones that precede it, at
+ * which point it is rebuilt and its backing gets faulted back in on demand.
+ */
+int
+heap_reclaim_backing(struct palloc_heap *heap, size_t *reclaimed)
+{
+	struct pool_set *set = heap->set;
+	size_t bytes = 0;
+
+	if (set == NULL) {
+		errno = ENOTSUP;
+		return -1;
+	}
+
+	for (unsigned r = 0; r < set->nreplicas; ++r) {
+		for (unsigned p = 0; p < REP(set, r)->nparts; ++p) {
+			if (PART(REP(set, r), p)->is_dev_dax) {
+				errno = ENOTSUP;
+				return -1;
+			}
+		}
+	}
+
+	uint64_t heap_off = (uint64_t)((char *)heap->layout -
+		(char *)heap->base);
+
+	struct bucket *defb = heap_bucket_acquire(heap,
+		DEFAULT_ALLOC_CLASS_ID, HEAP_ARENA_PER_THREAD);
+
+	for (uint32_t zone_id = 0; zone_id < heap->rt->nzones; ++zone_id) {
+		int zone_reclaimed;
+		util_atomic_load_explicit32(
+			&heap->rt->zone_reclaimed_map[zone_id],
+			&zone_reclaimed, memory_order_acquire);
+		if (zone_reclaimed)
+			continue;
+
+		struct zone *z = ZID_TO_ZONE(heap->layout, zone_id);
+		uint64_t zstart = (uint64_t)((char *)z -
+			(char *)heap->layout);
+		uint64_t zend = zstart + ZONE_MAX_SIZE;
+		if (zend > *heap->sizep)
+			zend = *heap->sizep;
+		if (zstart >= zend)
+			break;
+
+		int was_initialized = z->header.magic == ZONE_HEADER_MAGIC;
+
+		if (was_initialized) {
+			int free_zone = 1;
+			for (uint32_t i = 0;
+			    free_zone && i < z->header.size_idx; ) {
+				struct chunk_header *hdr =
+					&z->chunk_headers[i];
+
+				switch (hdr->type) {
+					case CHUNK_TYPE_FREE:
+						break;
+					case CHUNK_TYPE_RUN: {
+						/*
+						 * A run without a single
+						 * live block is as good as
+						 * a free chunk.
+						 */
+						struct memory_block m =
+							MEMORY_BLOCK_NONE;
+						m.zone_id = zone_id;
+						m.chunk_id = i;
+						m.size_idx = hdr->size_idx;
+						memblock_rebuild_state(heap,
+							&m);
+
+						struct run_bitmap b;
+						m.m_ops->get_bitmap(&m, &b);
+
+						uint32_t free_space = 0;
+						uint32_t max_block = 0;
+						m.m_ops->calc_free(&m,
+							&free_space,
+							&max_block);
+						if (free_space != b.nbits)
+							free_zone = 0;
+						break;
+					}
+					default:
+						free_zone = 0;
+						break;
+				}
+
+				i += hdr->size_idx;
+			}
+			if (!free_zone)
+				continue;
+
+			/*
+			 * Persistently invalidate the zone before punching,
+			 * so that an interrupted reclaim always leaves an
+			 * uninitialized zone that is simply rebuilt on the
+			 * next use.
+			 */
+			pmemops_memset(&heap->p_ops, &z->header, 0,
+				sizeof(z->header), 0);
+		}
+
+		if (heap_punch_zone_hole(set, heap_off + zstart,
+		    zend - zstart) != 0)
+			continue;
+
+		/*
+		 * Zones that were never initialized are punched too, in case
+		 * the pool file was preallocated, but only zones that
+		 * actually reverted to the uninitialized state count as
+		 * reclaimed - repeated calls would otherwise report the same
+		 * holes over and over.
+		 */
+		if (was_initialized)
+			bytes += zend - zstart;
+	}
+
+	heap_bucket_release(defb);
+
+	if (reclaimed != NULL)
+		*reclaimed = bytes;
+
+	return 0;
+}
+
 /*
  * heap_zone_update_if_needed -- updates the zone metadata if the pool has been
  *	extended.
@@ -1584,6 +3321,98 @@ heap_zone_update_if_needed(struct palloc_heap *heap)
 	}
 }
 
+/*
+ * heap_gather_badblocks -- (internal) collects the media error ranges of all
+ *	pool parts and stores them with offsets relative to the heap start
+ *
+ * Best effort - a pool with unreadable badblock info simply keeps the old
+ * behavior of faulting on access to a bad page.
+ */
+static void
+heap_gather_badblocks(struct palloc_heap *heap)
+{
+	struct pool_set *set = heap->set;
+	struct badblocks *out = &heap->rt->badblocks;
+
+	/* the open-time badblock check is the only trigger for the scan */
+	if (set == NULL || !set->has_bad_blocks)
+		return;
+
+	/* header size for all headers but the first one */
+	size_t hdrsize = (set->options & (OPTION_SINGLEHDR | OPTION_NOHDRS)) ?
+		0 : Mmap_align;
+	uint64_t heap_off = (uint64_t)((char *)heap->layout -
+		(char *)heap->base);
+
+	struct badblocks bbs;
+
+	for (unsigned r = 0; r < set->nreplicas; ++r) {
+		struct pool_replica *rep = REP(set, r);
+		for (unsigned p = 0; p < rep->nparts; ++p) {
+			struct pool_set_part *part = PART(rep, p);
+
+			/* skip parts with no bad blocks */
+			if (!part->has_bad_blocks)
+				continue;
+
+			if (badblocks_get(part->path, &bbs) != 0) {
+				CORE_LOG_WARNING(
+					"cannot read bad blocks of %s",
+					part->path);
+				continue;
+			}
+
+			for (unsigned b = 0; b < bbs.bb_cnt; ++b) {
+				size_t off = bbs.bbv[b].offset;
+				size_t len = bbs.bbv[b].length;
+
+				/* parts #>0 are mapped without the header */
+				if (p > 0 && hdrsize > 0) {
+					if (off >= hdrsize) {
+						off -= hdrsize;
+					} else if (len > hdrsize - off) {
+						len -= hdrsize - off;
+						off = 0;
+					} else {
+						continue;
+					}
+				}
+				off += (size_t)((char *)part->addr -
+					(char *)rep->part[0].addr);
+
+				/* clip the range to the heap */
+				if (off + len <= heap_off)
+					continue;
+				if (off < heap_off) {
+					len -= heap_off - off;
+					off = heap_off;
+				}
+				off -= heap_off;
+				if (off >= *heap->sizep)
+					continue;
+				if (len > *heap->sizep - off)
+					len = *heap->sizep - off;
+
+				struct bad_block *bbv = Realloc(out->bbv,
+					(out->bb_cnt + 1) * sizeof(*bbv));
+				if (bbv == NULL) {
+					CORE_LOG_WARNING(
+						"no memory to track bad blocks");
+					Free(bbs.bbv);
+					return;
+				}
+				bbv[out->bb_cnt].offset = off;
+				bbv[out->bb_cnt].length = len;
+				bbv[out->bb_cnt].nhealthy = NO_HEALTHY_REPLICA;
+				out->bbv = bbv;
+				out->bb_cnt++;
+			}
+
+			Free(bbs.bbv);
+		}
+	}
+}
+
 /*
  * heap_boot -- opens the heap region of the pmemobj pool
  *
@@ -1592,7 +3421,8 @@ heap_zone_update_if_needed(struct palloc_heap *heap)
 int
 heap_boot(struct palloc_heap *heap, void *heap_start, uint64_t heap_size,
 		uint64_t *sizep, void *base, struct pmem_ops *p_ops,
-		struct stats *stats, struct pool_set *set)
+		struct stats *stats, struct pool_set *set,
+		uint32_t compat_features)
 {
 	/*
 	 * The size can be 0 if interrupted during heap_init or this is the
@@ -1622,11 +3452,38 @@ heap_boot(struct palloc_heap *heap, void *heap_start, uint64_t heap_size,
 		goto err_reclaimed_map_malloc;
 	}
 
+	/* aligned so that no two zones' entries share a cache line */
+	h->zone_rt = util_aligned_malloc(CACHELINE_SIZE,
+		sizeof(struct zone_rt) * h->nzones);
+	if (h->zone_rt == NULL) {
+		err = ENOMEM;
+		goto err_zone_rt_malloc;
+	}
+	memset(h->zone_rt, 0, sizeof(struct zone_rt) * h->nzones);
+
+	h->zone_access_clock = (uint64_t)time(NULL);
+	h->zone_access_ops = 0;
+
+	h->snapshot = NULL;
+	h->snapshot_nentries = 0;
+
+	h->badblocks.bb_cnt = 0;
+	h->badblocks.bbv = NULL;
+
 	if ((err = arena_thread_assignment_init(&h->arenas.assignment,
 		Default_arenas_assignment_type)) != 0) {
 		goto error_assignment_init;
 	}
 
+	h->part_grow = set != NULL &&
+		(compat_features & POOL_FEAT_PART_GROW) != 0;
+
+	h->magazines_enabled = 0;
+	if ((err = os_tls_key_create(&h->magazines,
+		heap_magazines_destructor)) != 0) {
+		goto error_magazines_init;
+	}
+
 	h->alloc_classes = alloc_class_collection_new();
 	if (h->alloc_classes == NULL) {
 		err = ENOMEM;
@@ -1636,7 +3493,7 @@ heap_boot(struct palloc_heap *heap, void *heap_start, uint64_t heap_size,
 	unsigned narenas_default = Default_arenas_max == 0 ?
 		heap_get_procs() : (unsigned)Default_arenas_max;
 
-	if (heap_arenas_init(&h->arenas) != 0) {
+	if (heap_arenas_init(heap, &h->arenas) != 0) {
 		err = errno;
 		goto error_arenas_malloc;
 	}
@@ -1654,6 +3511,15 @@ heap_boot(struct palloc_heap *heap, void *heap_start, uint64_t heap_size,
 	heap->set = set;
 	heap->growsize = HEAP_DEFAULT_GROW_SIZE;
 	heap->alloc_pattern = PALLOC_CTL_DEBUG_NO_PATTERN;
+	heap->snapshot_enabled = 0;
+	heap->nt_headers_enabled = 0;
+	heap->maint = NULL;
+	heap->latency_budget = 0;
+	/*
+	 * Exact as long as stats were enabled for the pool's whole life,
+	 * and tracks this session's net allocations either way.
+	 */
+	heap->allocated = stats ? stats->persistent->heap_curr_allocated : 0;
 	VALGRIND_DO_CREATE_MEMPOOL(heap->layout, 0, 0);
 
 	for (unsigned i = 0; i < narenas_default; ++i) {
@@ -1668,6 +3534,12 @@ heap_boot(struct palloc_heap *heap, void *heap_start, uint64_t heap_size,
 
 	heap_zone_update_if_needed(heap);
 
+	heap_gather_badblocks(heap);
+	if (h->badblocks.bb_cnt != 0) {
+		for (unsigned i = 0; i < h->nzones; ++i)
+			heap_zone_retire_badblocks(heap, i);
+	}
+
 	return 0;
 
 error_vec_reserve:
@@ -1675,8 +3547,12 @@ error_vec_reserve:
 error_arenas_malloc:
 	alloc_class_collection_delete(h->alloc_classes);
 error_alloc_classes_new:
+	os_tls_key_delete(h->magazines);
+error_magazines_init:
 	arena_thread_assignment_fini(&h->arenas.assignment);
 error_assignment_init:
+	util_aligned_free(h->zone_rt);
+err_zone_rt_malloc:
 	Free(h->zone_reclaimed_map);
 err_reclaimed_map_malloc:
 	Free(h);
@@ -1751,8 +3627,12 @@ heap_cleanup(struct palloc_heap *heap)
 {
 	struct heap_rt *rt = heap->rt;
 
+	/* the maintenance thread must be gone before its tasks' state is */
+	ASSERTeq(heap->maint, NULL);
+
 	alloc_class_collection_delete(rt->alloc_classes);
 
+	os_tls_key_delete(rt->magazines);
 	arena_thread_assignment_fini(&rt->arenas.assignment);
 	bucket_locked_delete(rt->default_bucket);
 
@@ -1774,6 +3654,9 @@ heap_cleanup(struct palloc_heap *heap)
 
 	VALGRIND_DO_DESTROY_MEMPOOL(heap->layout);
 
+	Free(rt->badblocks.bbv);
+	Free(rt->snapshot);
+	util_aligned_free(rt->zone_rt);
 	Free(rt->zone_reclaimed_map);
 	Free(rt);
 	heap->rt = NULL;
@@ -1843,9 +3726,12 @@ heap_verify_chunk_header(struct chunk_header *hdr)
 
 /*
  * heap_verify_zone -- (internal) verifies if the zone is consistent
+ *
+ * In the quick mode only the zone header is verified; the chunk header
+ * walk, which has to fault in every metadata page of the zone, is skipped.
  */
 static int
-heap_verify_zone(struct zone *zone)
+heap_verify_zone(struct zone *zone, int quick)
 {
 	if (zone->header.magic == 0)
 		return 0; /* not initialized, and that is OK */
@@ -1858,6 +3744,9 @@ heap_verify_zone(struct zone *zone)
 	if (heap_verify_zone_header(&zone->header))
 		return -1;
 
+	if (quick)
+		return 0;
+
 	uint32_t i;
 	for (i = 0; i < zone->header.size_idx; ) {
 		if (heap_verify_chunk_header(&zone->chunk_headers[i]))
@@ -1874,13 +3763,56 @@ heap_verify_zone(struct zone *zone)
 	return 0;
 }
 
+/* upper bound on the number of zone verification workers */
+#define HEAP_CHECK_MAX_THREADS 16
+
 /*
- * heap_check -- verifies if the heap is consistent and can be opened properly
+ * heap_check_zones_ctx -- (internal) state shared by the zone verification
+ *	workers
+ */
+struct heap_check_zones_ctx {
+	struct heap_layout *layout;
+	unsigned nzones;
+	int quick;
+	uint64_t next; /* next zone to claim, advanced with fetch-and-add */
+	uint64_t bad_zone; /* zone id + 1 of a failed zone, 0 when all ok */
+};
+
+/*
+ * heap_check_zones_worker -- (internal) claims and verifies zones until
+ *	none are left or another worker has found an inconsistency
+ */
+static void *
+heap_check_zones_worker(void *arg)
+{
+	struct heap_check_zones_ctx *ctx = arg;
+
+	uint64_t zone_id;
+	while ((zone_id = util_fetch_and_add64(&ctx->next, 1)) <
+	    ctx->nzones) {
+		if (ctx->bad_zone != 0)
+			break;
+
+		if (heap_verify_zone(ZID_TO_ZONE(ctx->layout,
+		    (uint32_t)zone_id), ctx->quick)) {
+			ctx->bad_zone = zone_id + 1;
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * heap_check_common -- (internal) verifies if the heap is consistent
  *
- * If successful function returns zero. Otherwise an error number is returned.
+ * The zones are independent of each other, so they are split between a
+ * pool of worker threads; the caller's thread doubles as one of the
+ * workers. Thread creation failures just leave more zones for the
+ * remaining workers.
  */
-int
-heap_check(void *heap_start, uint64_t heap_size)
+static int
+heap_check_common(void *heap_start, uint64_t heap_size, int quick)
 {
 	if (heap_size < HEAP_MIN_SIZE) {
 		ERR_WO_ERRNO("heap: invalid heap size");
@@ -1892,14 +3824,63 @@ heap_check(void *heap_start, uint64_t heap_size)
 	if (heap_verify_header(&layout->header))
 		return -1;
 
-	for (unsigned i = 0; i < heap_max_zone(heap_size); ++i) {
-		if (heap_verify_zone(ZID_TO_ZONE(layout, i)))
-			return -1;
+	struct heap_check_zones_ctx ctx;
+	ctx.layout = layout;
+	ctx.nzones = heap_max_zone(heap_size);
+	ctx.quick = quick;
+	ctx.next = 0;
+	ctx.bad_zone = 0;
+
+	unsigned nthreads = heap_get_procs();
+	if (nthreads > ctx.nzones)
+		nthreads = ctx.nzones;
+	if (nthreads > HEAP_CHECK_MAX_THREADS)
+		nthreads = HEAP_CHECK_MAX_THREADS;
+
+	os_thread_t threads[HEAP_CHECK_MAX_THREADS];
+	unsigned spawned = 0;
+	for (unsigned i = 1; i < nthreads; ++i) {
+		if (os_thread_create(&threads[spawned], NULL,
+		    heap_check_zones_worker, &ctx) != 0)
+			break;
+		spawned++;
+	}
+
+	heap_check_zones_worker(&ctx);
+
+	for (unsigned i = 0; i < spawned; ++i)
+		os_thread_join(&threads[i], NULL);
+
+	if (ctx.bad_zone != 0) {
+		ERR_WO_ERRNO("heap: inconsistent zone %u",
+			(unsigned)(ctx.bad_zone - 1));
+		return -1;
 	}
 
 	return 0;
 }
 
+/*
+ * heap_check -- verifies if the heap is consistent and can be opened properly
+ *
+ * If successful function returns zero. Otherwise an error number is returned.
+ */
+int
+heap_check(void *heap_start, uint64_t heap_size)
+{
+	return heap_check_common(heap_start, heap_size, 0);
+}
+
+/*
+ * heap_check_quick -- verifies the heap metadata checksums and headers,
+ *	without walking the chunks
+ */
+int
+heap_check_quick(void *heap_start, uint64_t heap_size)
+{
+	return heap_check_common(heap_start, heap_size, 1);
+}
+
 /*
  * heap_zone_foreach_object -- (internal) iterates through objects in a zone
  */
@@ -1941,6 +3922,55 @@ heap_foreach_object(struct palloc_heap *heap, object_callback cb, void *arg,
 	}
 }
 
+/*
+ * heap_sparse_run_foreach -- iterates through live objects of sparse runs
+ *
+ * A run is sparse when the percentage of its allocated units is strictly
+ * below max_occupancy_pct. Such runs pin whole chunks for a handful of
+ * live blocks, which makes those blocks the cheapest defragmentation
+ * targets - relocating them returns the entire chunk to the heap.
+ * A non-zero return value of the callback stops the traversal.
+ */
+void
+heap_sparse_run_foreach(struct palloc_heap *heap, unsigned max_occupancy_pct,
+	object_callback cb, void *arg)
+{
+	struct memory_block m = MEMORY_BLOCK_NONE;
+
+	for (; m.zone_id < heap->rt->nzones; ++m.zone_id) {
+		struct zone *zone = ZID_TO_ZONE(heap->layout, m.zone_id);
+		if (zone->header.magic == 0)
+			continue;
+
+		for (m.chunk_id = 0; m.chunk_id < zone->header.size_idx;
+				m.chunk_id += m.size_idx) {
+			struct chunk_header *hdr = heap_get_chunk_hdr(heap,
+				&m);
+			memblock_rebuild_state(heap, &m);
+			m.size_idx = hdr->size_idx;
+			m.block_off = 0;
+
+			if (m.type != MEMORY_BLOCK_RUN)
+				continue;
+
+			struct run_bitmap b;
+			m.m_ops->get_bitmap(&m, &b);
+
+			uint32_t free_space = 0;
+			uint32_t max_free_block = 0;
+			m.m_ops->calc_free(&m, &free_space, &max_free_block);
+
+			uint64_t used = b.nbits - free_space;
+			if (used == 0 || used * 100 >=
+					(uint64_t)b.nbits * max_occupancy_pct)
+				continue;
+
+			if (m.m_ops->iterate_used(&m, cb, arg) != 0)
+				return;
+		}
+	}
+}
+
 #if VG_MEMCHECK_ENABLED
 
 /*
@@ -16,6 +16,7 @@
 #include "memops.h"
 #include "palloc.h"
 #include "os_thread.h"
+#include "recycler.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -23,6 +24,7 @@ extern "C" {
 
 extern enum pobj_arenas_assignment_type Default_arenas_assignment_type;
 extern size_t Default_arenas_max;
+extern size_t Default_boot_scan_threads;
 
 #define HEAP_OFF_TO_PTR(heap, off) ((void *)((char *)((heap)->base) + (off)))
 #define HEAP_PTR_TO_OFF(heap, ptr)\
@@ -34,11 +36,13 @@ extern size_t Default_arenas_max;
 int heap_boot(struct palloc_heap *heap, void *heap_start, uint64_t heap_size,
 		uint64_t *sizep,
 		void *base, struct pmem_ops *p_ops,
-		struct stats *stats, struct pool_set *set);
+		struct stats *stats, struct pool_set *set,
+		uint32_t compat_features);
 int heap_init(void *heap_start, uint64_t heap_size, uint64_t *sizep,
 	struct pmem_ops *p_ops);
 void heap_cleanup(struct palloc_heap *heap);
 int heap_check(void *heap_start, uint64_t heap_size);
+int heap_check_quick(void *heap_start, uint64_t heap_size);
 
 int heap_buckets_init(struct palloc_heap *heap);
 int heap_create_alloc_class_buckets(struct palloc_heap *heap,
@@ -46,6 +50,7 @@ int heap_create_alloc_class_buckets(struct palloc_heap *heap,
 
 int heap_extend(struct palloc_heap *heap, struct bucket *defb,
 	size_t size);
+int heap_reclaim_backing(struct palloc_heap *heap, size_t *reclaimed);
 
 struct alloc_class *
 heap_get_best_class(struct palloc_heap *heap, size_t size);
@@ -59,6 +64,18 @@ heap_bucket_release(struct bucket *b);
 
 int heap_get_bestfit_block(struct palloc_heap *heap, struct bucket *b,
 	struct memory_block *m);
+int heap_magazine_alloc_block(struct palloc_heap *heap, struct alloc_class *c,
+	struct memory_block *m, struct memory_block_reserved **mresv);
+int heap_get_magazines_enabled(struct palloc_heap *heap);
+void heap_set_magazines_enabled(struct palloc_heap *heap, int enabled);
+int heap_get_zone_preinit_enabled(struct palloc_heap *heap);
+int heap_set_zone_preinit_enabled(struct palloc_heap *heap, int enabled);
+int heap_get_recycle_enabled(struct palloc_heap *heap);
+int heap_set_recycle_enabled(struct palloc_heap *heap, int enabled);
+unsigned heap_get_latency_budget(struct palloc_heap *heap);
+int heap_set_latency_budget(struct palloc_heap *heap, unsigned budget);
+int heap_maintenance_boot(struct palloc_heap *heap);
+void heap_maintenance_cleanup(struct palloc_heap *heap);
 os_mutex_t *heap_get_run_lock(struct palloc_heap *heap,
 		uint32_t chunk_id);
 
@@ -71,15 +88,78 @@ heap_discard_run(struct palloc_heap *heap, struct memory_block *m);
 void
 heap_memblock_on_free(struct palloc_heap *heap, const struct memory_block *m);
 
+void
+heap_memblock_on_free_units(struct palloc_heap *heap,
+	const struct memory_block *m, uint32_t units);
+
 void
 heap_ensure_zone_reclaimed(struct palloc_heap *heap, uint32_t zone_id);
 
+void
+heap_set_zone_preference(uint32_t zone_id);
+
+uint32_t
+heap_off_to_zone_id(struct palloc_heap *heap, uint64_t off);
+
+/*
+ * Per-zone occupancy counters, maintained incrementally alongside chunk state
+ * transitions so that monitoring can read a live fragmentation summary without
+ * ever walking the chunk headers.
+ */
+struct zone_occupancy {
+	uint64_t capacity;	/* usable bytes of the zone */
+	uint64_t allocated;	/* bytes currently allocated */
+	uint64_t run_allocated;	/* bytes currently allocated out of runs */
+	uint64_t run_active;	/* bytes of chunks currently holding runs */
+};
+
+void heap_zone_occupancy_update(struct palloc_heap *heap,
+	const struct memory_block *m, int alloc);
+int heap_zone_occupancy_get(struct palloc_heap *heap, uint32_t zone_id,
+	struct zone_occupancy *occ);
+unsigned heap_zone_count(struct palloc_heap *heap);
+int heap_zone_idle(struct palloc_heap *heap, uint32_t zone_id, uint64_t *idle);
+int heap_zone_advise_cold(struct palloc_heap *heap, uint64_t min_idle,
+	int advice, unsigned *nadvised);
+int heap_zone_prewarm(struct palloc_heap *heap, uint32_t zone_id,
+	size_t offset, size_t length, size_t *touched);
+int heap_zone_resident(struct palloc_heap *heap, uint32_t zone_id,
+	uint64_t *resident);
+void heap_heat_record(struct palloc_heap *heap, uint64_t off);
+int heap_zone_heat(struct palloc_heap *heap, uint32_t zone_id,
+	uint64_t *heat);
+int heap_report_badblock(struct palloc_heap *heap, uint64_t offset,
+	size_t length);
+
+/*
+ * A persistent snapshot of the volatile run state, written at a clean pool
+ * close so that the lazy zone reclamation scans after the next open can use
+ * the recorded run occupancies instead of walking the run bitmaps. The
+ * snapshot is stored in a regular heap allocation and is valid only if its
+ * run_id matches the previous instance of the pool and the checksum of the
+ * entire structure verifies.
+ */
+struct heap_snapshot {
+	uint64_t run_id;	/* run id of the instance that wrote it */
+	uint64_t nentries;
+	uint64_t checksum;	/* checksum of the header and the entries */
+	struct recycler_element entries[];
+};
+
+size_t heap_snapshot_gather(struct palloc_heap *heap,
+	struct recycler_element *entries, size_t capacity);
+int heap_snapshot_load(struct palloc_heap *heap,
+	const struct recycler_element *entries, size_t nentries);
+void heap_boot_scan_parallel(struct palloc_heap *heap, unsigned nthreads);
+
 int
 heap_free_chunk_reuse(struct palloc_heap *heap,
 	struct bucket *bucket, struct memory_block *m);
 
 void heap_foreach_object(struct palloc_heap *heap, object_callback cb,
 	void *arg, struct memory_block start);
+void heap_sparse_run_foreach(struct palloc_heap *heap,
+	unsigned max_occupancy_pct, object_callback cb, void *arg);
 
 struct alloc_class_collection *heap_alloc_classes(struct palloc_heap *heap);
 
@@ -93,6 +173,14 @@ unsigned heap_get_narenas_max(struct palloc_heap *heap);
 
 int heap_set_narenas_max(struct palloc_heap *heap, unsigned size);
 
+int heap_get_arena_auto_scale(struct palloc_heap *heap);
+
+void heap_set_arena_auto_scale(struct palloc_heap *heap, int enabled);
+
+unsigned heap_get_numa_nodes(struct palloc_heap *heap);
+
+void heap_set_numa_nodes(struct palloc_heap *heap, unsigned nnodes);
+
 unsigned heap_get_narenas_auto(struct palloc_heap *heap);
 
 unsigned heap_get_thread_arena_id(struct palloc_heap *heap);
@@ -84,6 +84,7 @@ enum chunk_type {
 	CHUNK_TYPE_USED,
 	CHUNK_TYPE_RUN,
 	CHUNK_TYPE_RUN_DATA,
+	CHUNK_TYPE_BADBLOCK, /* permanently retired due to a media error */
 
 	MAX_CHUNK_TYPE
 };
@@ -13,6 +13,7 @@
 #include <errno.h>
 #include <limits.h>
 #include <sched.h>
+#include <unistd.h>
 
 #include "libpmemobj.h"
 #include "critnib.h"
@@ -207,6 +208,7 @@ lane_init(PMEMobjpool *pop, struct lane *lane, struct lane_layout *layout)
 	ASSERTne(lane, NULL);
 
 	lane->layout = layout;
+	memset(&lane->tx_stats, 0, sizeof(lane->tx_stats));
 
 	lane->internal = operation_new((struct ulog *)&layout->internal,
 		LANE_REDO_INTERNAL_SIZE,
@@ -229,6 +231,8 @@ lane_init(PMEMobjpool *pop, struct lane *lane, struct lane_layout *layout)
 	if (lane->undo == NULL)
 		goto error_undo_new;
 
+	lane->undo_needs_recovery = 0;
+
 	return 0;
 
 error_undo_new:
@@ -259,6 +263,9 @@ lane_destroy(PMEMobjpool *pop, struct lane *lane)
 int
 lane_boot(PMEMobjpool *pop)
 {
+	/* runtime lane descriptors must not share cache lines */
+	COMPILE_ERROR_ON(sizeof(struct lane) % CACHELINE_SIZE != 0);
+
 	int err = 0;
 
 	pop->lanes_desc.lane = Malloc(sizeof(struct lane) * pop->nlanes);
@@ -269,6 +276,7 @@ lane_boot(PMEMobjpool *pop)
 	}
 
 	pop->lanes_desc.next_lane_idx = 0;
+	pop->lanes_desc.undo_sweeper_started = 0;
 
 	pop->lanes_desc.lane_locks =
 		Zalloc(sizeof(*pop->lanes_desc.lane_locks) * pop->nlanes);
@@ -345,6 +353,119 @@ lane_cleanup(PMEMobjpool *pop)
 	lane_info_cleanup(pop);
 }
 
+/*
+ * lane_undo_recover -- (internal) process and discard the undo log of a
+ * single lane
+ *
+ * The caller must have exclusive ownership of the lane.  The flag is
+ * cleared before processing so that the nested lane holds done by the
+ * deallocations of the extension ulogs do not descend into recovery again.
+ */
+static void
+lane_undo_recover(struct lane *lane)
+{
+	lane->undo_needs_recovery = 0;
+
+	struct operation_context *ctx = lane->undo;
+	operation_resume(ctx);
+	operation_process(ctx);
+	operation_finish(ctx, ULOG_INC_FIRST_GEN_NUM |
+			ULOG_FREE_AFTER_FIRST);
+}
+
+/*
+ * lane_is_gated -- (internal) returns whether the lane's undo log belongs to
+ * an unresolved coupled transaction and must not be recovered yet
+ *
+ * See pmemobj_tx_begin_multi() in tx.c. The gated lane is resolved by
+ * lane_gated_resolve() once the peer pool's commit record is available.
+ */
+static int
+lane_is_gated(PMEMobjpool *pop, uint64_t idx)
+{
+	return pop->multi_commit.gate_txid != 0 &&
+		pop->multi_commit.gate_lane == idx;
+}
+
+/*
+ * lane_gated_resolve -- settles the undo log of the lane gated by a coupled
+ * transaction, once the peer pool's verdict is known
+ *
+ * The lane was locked at boot, so no thread uses it. If the transaction
+ * committed, the snapshot is stale and is only discarded; otherwise the lane
+ * is rolled back like any other dirty lane.
+ */
+void
+lane_gated_resolve(PMEMobjpool *pop, int committed)
+{
+	uint64_t idx = pop->multi_commit.gate_lane;
+	struct lane *lane = &pop->lanes_desc.lane[idx];
+
+	LOG(3, "pop %p lane %" PRIu64 " committed %d", pop, idx, committed);
+
+	lane->undo_needs_recovery = 0;
+
+	struct operation_context *ctx = lane->undo;
+	operation_resume(ctx);
+	if (!committed)
+		operation_process(ctx);
+	operation_finish(ctx, ULOG_INC_FIRST_GEN_NUM |
+			ULOG_FREE_AFTER_FIRST);
+
+	pop->multi_commit.gate_txid = 0;
+	pmemops_persist(&pop->p_ops, &pop->multi_commit.gate_txid,
+		sizeof(pop->multi_commit.gate_txid));
+
+	if (idx < pop->lanes_desc.runtime_nlanes &&
+	    !util_bool_compare_and_swap64(
+			&pop->lanes_desc.lane_locks[idx], 1, 0))
+		CORE_LOG_FATAL("util_bool_compare_and_swap64");
+}
+
+/*
+ * lane_undo_sweeper -- (internal) background recovery of the lanes that no
+ * thread has claimed yet
+ *
+ * Lanes are claimed the same way lane_hold() does it, so the sweep never
+ * races with a thread using the lane.  A lane that is already taken is
+ * simply skipped - its holder has recovered it.
+ */
+static void *
+lane_undo_sweeper(void *arg)
+{
+	PMEMobjpool *pop = arg;
+
+	LOG(3, "pop %p", pop);
+
+	for (uint64_t i = 0; i < pop->nlanes; ++i) {
+		struct lane *lane = &pop->lanes_desc.lane[i];
+		if (!lane->undo_needs_recovery)
+			continue;
+
+		if (lane_is_gated(pop, i))
+			continue;
+
+		if (i < pop->lanes_desc.runtime_nlanes) {
+			if (!util_bool_compare_and_swap64(
+					&pop->lanes_desc.lane_locks[i], 0, 1))
+				continue;
+
+			if (lane->undo_needs_recovery)
+				lane_undo_recover(lane);
+
+			if (!util_bool_compare_and_swap64(
+					&pop->lanes_desc.lane_locks[i], 1, 0))
+				CORE_LOG_FATAL(
+					"util_bool_compare_and_swap64");
+		} else {
+			/* not reachable through lane_hold() */
+			lane_undo_recover(lane);
+		}
+	}
+
+	return NULL;
+}
+
 /*
  * lane_recover_and_section_boot -- performs initialization and recovery of all
  * lanes
@@ -379,13 +500,58 @@ lane_recover_and_section_boot(PMEMobjpool *pop)
 	/*
 	 * Undo logs must be processed after the heap is initialized since
 	 * a undo recovery might require deallocation of the next ulogs.
+	 *
+	 * A lane whose undo log holds a snapshot must be rolled back here -
+	 * once the open returns, the application can read the snapshotted
+	 * objects without ever claiming a lane, so deferring the rollback
+	 * would expose uncommitted data. Checking the log header is cheap,
+	 * and only the lanes that were actually dirty at the crash cost
+	 * processing. The verifiably-empty logs take the lazy path: their
+	 * remaining maintenance (the generation bump and the release of
+	 * leftover extensions) is deferred to the first claim in
+	 * lane_hold() or to the background sweep.
 	 */
 	for (i = 0; i < pop->nlanes; ++i) {
-		struct operation_context *ctx = pop->lanes_desc.lane[i].undo;
-		operation_resume(ctx);
-		operation_process(ctx);
-		operation_finish(ctx, ULOG_INC_FIRST_GEN_NUM |
-				ULOG_FREE_AFTER_FIRST);
+		struct lane *lane = &pop->lanes_desc.lane[i];
+		layout = lane_get_layout(pop, i);
+
+		lane->undo_needs_recovery = 1;
+
+		if (lane_is_gated(pop, i))
+			continue;
+
+		if (ulog_recovery_needed((struct ulog *)&layout->undo, 0))
+			lane_undo_recover(lane);
+	}
+
+	/*
+	 * A lane gated by an unresolved coupled transaction must keep its
+	 * undo log intact until the peer pool's commit record settles it,
+	 * see pmemobj_tx_begin_multi() in tx.c. Locking the lane keeps both
+	 * lane_hold() and the sweep away until lane_gated_resolve().
+	 */
+	if (pop->multi_commit.gate_txid != 0 &&
+	    pop->multi_commit.gate_lane < pop->lanes_desc.runtime_nlanes)
+		pop->lanes_desc.lane_locks[pop->multi_commit.gate_lane] = 1;
+
+	pop->lanes_desc.undo_sweeper_started = 0;
+	if (pop->lanes_desc.runtime_nlanes > 1 &&
+			os_thread_create(&pop->lanes_desc.undo_sweeper, NULL,
+				lane_undo_sweeper, pop) == 0) {
+		pop->lanes_desc.undo_sweeper_started = 1;
+	} else {
+		/*
+		 * With a single runtime lane the sweep could not take a
+		 * lane without starving its own deallocations, so recover
+		 * everything up front (likewise when the thread cannot be
+		 * created).
+		 */
+		for (i = 0; i < pop->nlanes; ++i) {
+			struct lane *lane = &pop->lanes_desc.lane[i];
+			if (lane->undo_needs_recovery &&
+			    !lane_is_gated(pop, i))
+				lane_undo_recover(lane);
+		}
 	}
 
 	return 0;
@@ -397,30 +563,93 @@ lane_recover_and_section_boot(PMEMobjpool *pop)
 int
 lane_section_cleanup(PMEMobjpool *pop)
 {
+	/* the sweep deallocates through the heap, wait for it first */
+	if (pop->lanes_desc.undo_sweeper_started) {
+		os_thread_join(&pop->lanes_desc.undo_sweeper, NULL);
+		pop->lanes_desc.undo_sweeper_started = 0;
+	}
+
 	return pmalloc_cleanup(pop);
 }
 
 /*
- * lane_check -- performs check of all lanes
+ * lane_check_ctx -- (internal) state shared by the lane verification workers
  */
-int
-lane_check(PMEMobjpool *pop)
+struct lane_check_ctx {
+	PMEMobjpool *pop;
+	uint64_t next; /* next lane to claim, advanced with fetch-and-add */
+	uint64_t bad_lane; /* lane idx + 1 of a failed lane, 0 when all ok */
+};
+
+/* upper bound on the number of lane verification workers */
+#define LANE_CHECK_MAX_THREADS 16
+
+/*
+ * lane_check_worker -- (internal) claims and verifies lanes until none are
+ *	left or another worker has found an inconsistency
+ */
+static void *
+lane_check_worker(void *arg)
 {
-	int err = 0;
-	uint64_t j; /* lane index */
-	struct lane_layout *layout;
+	struct lane_check_ctx *ctx = arg;
+	PMEMobjpool *pop = ctx->pop;
+
+	uint64_t j;
+	while ((j = util_fetch_and_add64(&ctx->next, 1)) < pop->nlanes) {
+		if (ctx->bad_lane != 0)
+			break;
 
-	for (j = 0; j < pop->nlanes; ++j) {
-		layout = lane_get_layout(pop, j);
+		struct lane_layout *layout = lane_get_layout(pop, j);
 		if (ulog_check((struct ulog *)&layout->internal,
 		    OBJ_OFF_IS_VALID_FROM_CTX, &pop->p_ops) != 0) {
-			CORE_LOG_ERROR(
-				"lane %" PRIu64 " internal redo failed: %d",
-				j, err);
-			return err;
+			ctx->bad_lane = j + 1;
+			break;
 		}
 	}
 
+	return NULL;
+}
+
+/*
+ * lane_check -- performs check of all lanes
+ *
+ * The internal redo logs are independent of each other, so they are split
+ * between a pool of worker threads; the caller's thread doubles as one of
+ * the workers. Thread creation failures just leave more lanes for the
+ * remaining workers.
+ */
+int
+lane_check(PMEMobjpool *pop)
+{
+	struct lane_check_ctx ctx = {pop, 0, 0};
+
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	uint64_t nthreads = cpus < 1 ? 1 : (uint64_t)cpus;
+	if (nthreads > pop->nlanes)
+		nthreads = pop->nlanes;
+	if (nthreads > LANE_CHECK_MAX_THREADS)
+		nthreads = LANE_CHECK_MAX_THREADS;
+
+	os_thread_t threads[LANE_CHECK_MAX_THREADS];
+	unsigned spawned = 0;
+	for (uint64_t i = 1; i < nthreads; ++i) {
+		if (os_thread_create(&threads[spawned], NULL,
+		    lane_check_worker, &ctx) != 0)
+			break;
+		spawned++;
+	}
+
+	lane_check_worker(&ctx);
+
+	for (unsigned i = 0; i < spawned; ++i)
+		os_thread_join(&threads[i], NULL);
+
+	if (ctx.bad_lane != 0) {
+		CORE_LOG_ERROR("lane %" PRIu64 " internal redo failed",
+			ctx.bad_lane - 1);
+		return EINVAL;
+	}
+
 	return 0;
 }
 
@@ -504,6 +733,57 @@ get_lane_info_record(PMEMobjpool *pop)
 	return info;
 }
 
+/*
+ * lane_select_primary -- (internal) pick the initial primary lane for the
+ * calling thread
+ *
+ * Lanes are partitioned between the CPUs, so threads running on different
+ * cores (including hyperthread siblings, which have distinct CPU ids)
+ * start in disjoint groups of lanes and do not contend for the same lane
+ * lock cache lines.  Within a partition the old cache-line stride is
+ * kept.  Falls back to the plain global stride when the topology cannot
+ * be queried or the partitions would be smaller than the stride.
+ */
+static uint64_t
+lane_select_primary(PMEMobjpool *pop)
+{
+	static long cpus;
+
+	if (cpus == 0)
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	uint64_t stride = util_fetch_and_add32(
+		&pop->lanes_desc.next_lane_idx, LANE_JUMP);
+
+	int cpu = sched_getcpu();
+	if (cpus < 2 || cpu < 0)
+		return stride;
+
+	uint64_t psize = pop->lanes_desc.runtime_nlanes / (uint64_t)cpus;
+	if (psize < LANE_JUMP)
+		return stride;
+
+	uint64_t pstart = ((uint64_t)cpu % (uint64_t)cpus) * psize;
+	return pstart + stride % psize;
+}
+
+/*
+ * lane_big_nlanes -- (internal) number of lanes currently reserved for the
+ * large-transaction class, taken from the top of the runtime lane range
+ *
+ * The count is a plain ctl-settable parameter, so it may change while lanes
+ * are held; the lane locks keep that safe and only the classification of a
+ * lane blurs for a moment.
+ */
+static unsigned
+lane_big_nlanes(PMEMobjpool *pop)
+{
+	unsigned big = pop->tx_params->big_lanes;
+	unsigned limit = pop->lanes_desc.runtime_nlanes / 2;
+
+	return big < limit ? big : limit;
+}
+
 /*
  * lane_hold -- grabs a per-thread lane in a round-robin fashion
  */
@@ -513,18 +793,78 @@ lane_hold(PMEMobjpool *pop, struct lane **lanep)
 	struct lane_info *lane = get_lane_info_record(pop);
 	while (unlikely(lane->lane_idx == UINT64_MAX)) {
 		/* initial wrap to next CL */
-		lane->primary = lane->lane_idx = util_fetch_and_add32(
-			&pop->lanes_desc.next_lane_idx, LANE_JUMP);
+		lane->primary = lane->lane_idx = lane_select_primary(pop);
 	} /* handles wraparound */
 
 	uint64_t *llocks = pop->lanes_desc.lane_locks;
 	/* grab next free lane from lanes available at runtime */
 	if (!lane->nest_count++) {
-		get_lane(llocks, lane, pop->lanes_desc.runtime_nlanes);
+		get_lane(llocks, lane, pop->lanes_desc.runtime_nlanes -
+			lane_big_nlanes(pop));
+	}
+
+	struct lane *l = &pop->lanes_desc.lane[lane->lane_idx];
+
+	/* the first claim of a lane left dirty by the boot recovers it */
+	if (unlikely(l->undo_needs_recovery) && lane->nest_count == 1)
+		lane_undo_recover(l);
+
+	/* reinitialize lane's content only if in outermost hold */
+	if (lanep && lane->nest_count == 1) {
+		VALGRIND_ANNOTATE_NEW_MEMORY(l, sizeof(*l));
+		VALGRIND_ANNOTATE_NEW_MEMORY(l->layout, sizeof(*l->layout));
+		operation_init(l->external);
+		operation_init(l->internal);
+		operation_init(l->undo);
+	}
+
+	if (lanep)
+		*lanep = l;
+
+	return (unsigned)lane->lane_idx;
+}
+
+/*
+ * lane_hold_big -- grabs a lane from the class reserved for large
+ * transactions, falling back to the common class when none is configured
+ *
+ * Large transactions are long-lived, so the claim makes no attempt at the
+ * primary-lane affinity of lane_hold() and simply scans the reserved range.
+ * A nested hold attaches to whatever lane the thread already owns, the
+ * class only matters for the outermost one.
+ */
+unsigned
+lane_hold_big(PMEMobjpool *pop, struct lane **lanep)
+{
+	unsigned big = lane_big_nlanes(pop);
+	if (big == 0)
+		return lane_hold(pop, lanep);
+
+	struct lane_info *lane = get_lane_info_record(pop);
+	while (unlikely(lane->lane_idx == UINT64_MAX)) {
+		/* initial wrap to next CL */
+		lane->primary = lane->lane_idx = lane_select_primary(pop);
+	} /* handles wraparound */
+
+	uint64_t *llocks = pop->lanes_desc.lane_locks;
+	if (!lane->nest_count++) {
+		uint64_t base = pop->lanes_desc.runtime_nlanes - big;
+		uint64_t idx = base;
+		while (!util_bool_compare_and_swap64(&llocks[idx], 0, 1)) {
+			if (++idx == pop->lanes_desc.runtime_nlanes) {
+				idx = base;
+				sched_yield();
+			}
+		}
+		lane->lane_idx = idx;
 	}
 
 	struct lane *l = &pop->lanes_desc.lane[lane->lane_idx];
 
+	/* the first claim of a lane left dirty by the boot recovers it */
+	if (unlikely(l->undo_needs_recovery) && lane->nest_count == 1)
+		lane_undo_recover(l);
+
 	/* reinitialize lane's content only if in outermost hold */
 	if (lanep && lane->nest_count == 1) {
 		VALGRIND_ANNOTATE_NEW_MEMORY(l, sizeof(*l));
@@ -9,6 +9,7 @@
 #define LIBPMEMOBJ_LANE_H 1
 
 #include <stdint.h>
+#include "os_thread.h"
 #include "ulog.h"
 #include "libpmemobj.h"
 
@@ -80,11 +81,54 @@ struct lane_layout {
 	struct ULOG(LANE_UNDO_SIZE) undo;
 };
 
+/* power-of-two nanosecond buckets of transaction commit latency */
+#define LANE_TX_LAT_BUCKETS 32
+
+/*
+ * Per-lane transaction counters. A lane is held exclusively for the whole
+ * duration of a transaction, so the owning thread updates these with plain
+ * stores; the stats.tx ctl aggregation reads them lock-free and tolerates
+ * slightly stale values, the same way the transient stats shards do.
+ */
+struct lane_tx_stats {
+	uint64_t commits;	/* committed outermost transactions */
+	uint64_t aborts;	/* aborted outermost transactions */
+	uint64_t bytes_logged;	/* payload bytes snapshotted to the logs */
+	/* commit critical path latency, power-of-two ns buckets */
+	uint64_t commit_ns[LANE_TX_LAT_BUCKETS];
+};
+
 struct lane {
 	struct lane_layout *layout; /* pointer to persistent layout */
 	struct operation_context *internal; /* context for internal ulog */
 	struct operation_context *external; /* context for external ulog */
 	struct operation_context *undo; /* context for undo ulog */
+
+	/*
+	 * The undo log still holds a snapshot from before the crash and
+	 * must be processed before the lane is used.  Set for all lanes at
+	 * boot, cleared by whoever recovers the lane first - either the
+	 * thread claiming it or the background sweep.
+	 */
+	int undo_needs_recovery;
+
+	/*
+	 * Pad the runtime descriptor out to a full cache line so that
+	 * neighbouring lanes never share one.  The persistent layout needs
+	 * no such padding - its size is already a multiple of the cache
+	 * line - and could not be padded anyway without a format change.
+	 */
+	char pad[CACHELINE_SIZE -
+		(4 * sizeof(void *) + sizeof(int)) % CACHELINE_SIZE];
+
+	/*
+	 * The statistics sit past the padding so that the hot pointers
+	 * above keep a cache line of their own, and carry their own pad
+	 * so that the lanes stay a cache-line multiple apart.
+	 */
+	struct lane_tx_stats tx_stats;
+	char stats_pad[CACHELINE_SIZE -
+		sizeof(struct lane_tx_stats) % CACHELINE_SIZE];
 };
 
 struct lane_descriptor {
@@ -97,6 +141,10 @@ struct lane_descriptor {
 	unsigned next_lane_idx;
 	uint64_t *lane_locks;
 	struct lane *lane;
+
+	/* background thread sweeping the lanes left dirty after a boot */
+	os_thread_t undo_sweeper;
+	int undo_sweeper_started;
 };
 
 typedef int (*section_layout_op)(PMEMobjpool *pop, void *data, unsigned length);
@@ -137,9 +185,11 @@ int lane_boot(PMEMobjpool *pop);
 void lane_cleanup(PMEMobjpool *pop);
 int lane_recover_and_section_boot(PMEMobjpool *pop);
 int lane_section_cleanup(PMEMobjpool *pop);
+void lane_gated_resolve(PMEMobjpool *pop, int committed);
 int lane_check(PMEMobjpool *pop);
 
 unsigned lane_hold(PMEMobjpool *pop, struct lane **lane);
+unsigned lane_hold_big(PMEMobjpool *pop, struct lane **lane);
 void lane_release(PMEMobjpool *pop);
 
 #ifdef __cplusplus
@@ -134,6 +134,9 @@ list_mutexes_unlock(PMEMobjpool *pop,
  * If the input dest is not OID_NULL returns dest.
  * If the input dest is OID_NULL and before is set returns first element.
  * If the input dest is OID_NULL and before is no set returns last element.
+ *
+ * The list is circular, so the last element is reached with a single read
+ * of first->pe_prev - tail pushes never traverse the list.
  */
 static inline PMEMoid
 list_get_dest(PMEMobjpool *pop, struct list_head *head, PMEMoid dest,
@@ -0,0 +1,547 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2024, Intel Corporation */
+
+/*
+ * maintenance.c -- pool background maintenance thread
+ *
+ * A single worker thread per pool services all registered background
+ * tasks - zone pre-initialization, run recycling, reservation pre-zeroing
+ * and the like - so subsystems that need deferred work share one scheduler
+ * instead of each spawning a thread of its own. The worker wakes up
+ * periodically (or when kicked with maintenance_wake()) and steps every
+ * enabled task; a task reporting immediately pending work is stepped again
+ * up to the configured budget before the worker moves on.
+ *
+ * The thread runs only while at least one task is enabled and is
+ * configurable through the heap.maintenance ctl namespace.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "maintenance.h"
+#include "alloc.h"
+#include "os.h"
+#include "os_thread.h"
+#include "out.h"
+#include "sys_util.h"
+
+/* registered tasks; grows as subsystems gain background work */
+#define MAINTENANCE_MAX_TASKS 8
+
+/* how long the worker sleeps when no task has pending work */
+#define MAINTENANCE_INTERVAL_NS (100 * 1000 * 1000) /* 100 ms */
+
+/* default number of steps a task with pending work gets per cycle */
+#define MAINTENANCE_DEFAULT_BUDGET 16
+
+/* the token bucket never saves up more than one second worth of bandwidth */
+#define MAINTENANCE_BW_BURST_NS 1000000000ULL
+
+struct maintenance_task {
+	const char *name;
+	maintenance_task_fn fn;
+	void *arg;
+	int enabled;
+};
+
+struct maintenance {
+	os_mutex_t lock;
+	os_cond_t cond;
+	os_thread_t thread;
+	int running; /* the worker thread exists */
+	int stop;
+	unsigned budget; /* max task steps per cycle, heap.maintenance.budget */
+	int cpu; /* worker cpu affinity, -1 means unrestricted */
+	unsigned ntasks;
+	struct maintenance_task tasks[MAINTENANCE_MAX_TASKS];
+
+	/*
+	 * Bandwidth governor, a token bucket shared by every background
+	 * byte mover of the pool - the tasks above as well as threads that
+	 * run outside of the worker, like the warmup walk. It sits behind
+	 * its own lock so that a caller sleeping off bandwidth debt never
+	 * stalls the control plane above.
+	 */
+	os_mutex_t bw_lock;
+	uint64_t bw_limit;	/* bytes per second, 0 means unthrottled */
+	uint64_t bw_tokens;	/* bytes the bucket currently allows */
+	struct timespec bw_refill;	/* last token refill */
+	uint64_t bw_window_bytes;	/* bytes seen in the current window */
+	struct timespec bw_window;	/* start of the measurement window */
+	uint64_t bw_measured;	/* bytes per second over the last window */
+};
+
+/*
+ * maintenance_ns_since -- (internal) nanoseconds elapsed since a timestamp,
+ *	clamped at zero as the refill clock may sit in the future
+ */
+static uint64_t
+maintenance_ns_since(const struct timespec *since, const struct timespec *now)
+{
+	int64_t ns = (now->tv_sec - since->tv_sec) * 1000000000LL +
+		(now->tv_nsec - since->tv_nsec);
+
+	return ns > 0 ? (uint64_t)ns : 0;
+}
+
+/*
+ * maintenance_worker -- (internal) body of the maintenance thread
+ */
+static void *
+maintenance_worker(void *arg)
+{
+	struct maintenance *m = arg;
+
+	util_mutex_lock(&m->lock);
+	while (!m->stop) {
+		unsigned budget = m->budget;
+		int pending = 0;
+
+		for (unsigned i = 0; i < m->ntasks && !m->stop; ++i) {
+			struct maintenance_task *t = &m->tasks[i];
+			if (!t->enabled)
+				continue;
+
+			util_mutex_unlock(&m->lock);
+
+			int more;
+			unsigned steps = 0;
+			do {
+				more = t->fn(t->arg);
+			} while (more && ++steps < budget);
+			pending += more;
+
+			util_mutex_lock(&m->lock);
+		}
+
+		if (m->stop)
+			break;
+
+		if (pending)
+			continue;
+
+		struct timespec ts;
+		os_clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += MAINTENANCE_INTERVAL_NS;
+		if (ts.tv_nsec >= 1000000000) {
+			ts.tv_sec += 1;
+			ts.tv_nsec -= 1000000000;
+		}
+		os_cond_timedwait(&m->cond, &m->lock, &ts);
+	}
+	util_mutex_unlock(&m->lock);
+
+	return NULL;
+}
+
+/*
+ * maintenance_apply_affinity -- (internal) pins the worker to the configured
+ *	cpu, or to all online cpus when the affinity is cleared
+ */
+static void
+maintenance_apply_affinity(struct maintenance *m)
+{
+	os_cpu_set_t set;
+	os_cpu_zero(&set);
+
+	if (m->cpu >= 0) {
+		os_cpu_set((size_t)m->cpu, &set);
+	} else {
+		long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+		for (long i = 0; i < ncpus; ++i)
+			os_cpu_set((size_t)i, &set);
+	}
+
+	/* best effort, an invalid cpu simply leaves the affinity unchanged */
+	(void) os_thread_setaffinity_np(&m->thread, sizeof(set), &set);
+}
+
+/*
+ * maintenance_thread_start -- (internal) starts the worker thread
+ *
+ * Must be called with the lock held.
+ */
+static int
+maintenance_thread_start(struct maintenance *m)
+{
+	m->stop = 0;
+	int ret = os_thread_create(&m->thread, NULL, maintenance_worker, m);
+	if (ret != 0) {
+		errno = ret;
+		ERR_W_ERRNO("failed to create maintenance thread");
+		return -1;
+	}
+
+	m->running = 1;
+	maintenance_apply_affinity(m);
+
+	return 0;
+}
+
+/*
+ * maintenance_thread_stop -- (internal) stops and joins the worker thread
+ *
+ * Must be called with the lock held; drops and reacquires it for the join.
+ */
+static void
+maintenance_thread_stop(struct maintenance *m)
+{
+	m->stop = 1;
+	os_cond_signal(&m->cond);
+	util_mutex_unlock(&m->lock);
+
+	os_thread_join(&m->thread, NULL);
+
+	util_mutex_lock(&m->lock);
+	m->running = 0;
+}
+
+/*
+ * maintenance_nenabled -- (internal) number of currently enabled tasks
+ *
+ * Must be called with the lock held.
+ */
+static unsigned
+maintenance_nenabled(struct maintenance *m)
+{
+	unsigned n = 0;
+	for (unsigned i = 0; i < m->ntasks; ++i)
+		n += m->tasks[i].enabled != 0;
+
+	return n;
+}
+
+/*
+ * maintenance_task_find -- (internal) looks up a task by name
+ *
+ * Must be called with the lock held.
+ */
+static struct maintenance_task *
+maintenance_task_find(struct maintenance *m, const char *name)
+{
+	for (unsigned i = 0; i < m->ntasks; ++i) {
+		if (strcmp(m->tasks[i].name, name) == 0)
+			return &m->tasks[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * maintenance_new -- allocates the maintenance state with no tasks
+ */
+struct maintenance *
+maintenance_new(void)
+{
+	struct maintenance *m = Zalloc(sizeof(*m));
+	if (m == NULL)
+		return NULL;
+
+	util_mutex_init(&m->lock);
+	util_cond_init(&m->cond);
+	m->budget = MAINTENANCE_DEFAULT_BUDGET;
+	m->cpu = -1;
+
+	util_mutex_init(&m->bw_lock);
+	os_clock_gettime(CLOCK_MONOTONIC, &m->bw_refill);
+	m->bw_window = m->bw_refill;
+
+	return m;
+}
+
+/*
+ * maintenance_delete -- stops the worker thread and frees the state
+ *
+ * The registered tasks must remain callable until this returns.
+ */
+void
+maintenance_delete(struct maintenance *m)
+{
+	if (m == NULL)
+		return;
+
+	util_mutex_lock(&m->lock);
+	if (m->running)
+		maintenance_thread_stop(m);
+	util_mutex_unlock(&m->lock);
+
+	util_mutex_destroy(&m->bw_lock);
+	util_cond_destroy(&m->cond);
+	util_mutex_destroy(&m->lock);
+	Free(m);
+}
+
+/*
+ * maintenance_task_register -- registers a named task, initially disabled
+ *
+ * The name must be a string literal (or otherwise outlive the maintenance
+ * state) - it is not copied.
+ */
+int
+maintenance_task_register(struct maintenance *m, const char *name,
+	maintenance_task_fn fn, void *arg)
+{
+	int ret = 0;
+
+	util_mutex_lock(&m->lock);
+
+	ASSERTeq(maintenance_task_find(m, name), NULL);
+
+	if (m->ntasks == MAINTENANCE_MAX_TASKS) {
+		errno = ENOSPC;
+		ret = -1;
+	} else {
+		struct maintenance_task *t = &m->tasks[m->ntasks++];
+		t->name = name;
+		t->fn = fn;
+		t->arg = arg;
+		t->enabled = 0;
+	}
+
+	util_mutex_unlock(&m->lock);
+
+	return ret;
+}
+
+/*
+ * maintenance_task_set_enabled -- enables or disables a task, starting the
+ *	worker thread with the first enabled task and stopping it with the
+ *	last disabled one
+ */
+int
+maintenance_task_set_enabled(struct maintenance *m, const char *name,
+	int enabled)
+{
+	int ret = 0;
+
+	util_mutex_lock(&m->lock);
+
+	struct maintenance_task *t = maintenance_task_find(m, name);
+	if (t == NULL) {
+		errno = EINVAL;
+		ret = -1;
+		goto out;
+	}
+
+	if (t->enabled == !!enabled)
+		goto out;
+
+	if (enabled && !m->running && maintenance_thread_start(m) != 0) {
+		ret = -1;
+		goto out;
+	}
+
+	t->enabled = !!enabled;
+
+	if (!enabled && m->running && maintenance_nenabled(m) == 0)
+		maintenance_thread_stop(m);
+	else if (enabled)
+		os_cond_signal(&m->cond);
+
+out:
+	util_mutex_unlock(&m->lock);
+
+	return ret;
+}
+
+/*
+ * maintenance_task_get_enabled -- returns whether a task is enabled
+ */
+int
+maintenance_task_get_enabled(struct maintenance *m, const char *name)
+{
+	util_mutex_lock(&m->lock);
+	struct maintenance_task *t = maintenance_task_find(m, name);
+	int enabled = t != NULL && t->enabled;
+	util_mutex_unlock(&m->lock);
+
+	return enabled;
+}
+
+/*
+ * maintenance_wake -- kicks the worker out of its periodic sleep
+ */
+void
+maintenance_wake(struct maintenance *m)
+{
+	os_cond_signal(&m->cond);
+}
+
+/*
+ * maintenance_set_budget -- sets the per-cycle step budget of busy tasks
+ */
+int
+maintenance_set_budget(struct maintenance *m, unsigned budget)
+{
+	if (budget == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	util_mutex_lock(&m->lock);
+	m->budget = budget;
+	util_mutex_unlock(&m->lock);
+
+	return 0;
+}
+
+/*
+ * maintenance_get_budget -- returns the per-cycle step budget
+ */
+unsigned
+maintenance_get_budget(struct maintenance *m)
+{
+	util_mutex_lock(&m->lock);
+	unsigned budget = m->budget;
+	util_mutex_unlock(&m->lock);
+
+	return budget;
+}
+
+/*
+ * maintenance_set_cpu -- pins the worker thread to the given cpu,
+ *	-1 clears the affinity
+ */
+int
+maintenance_set_cpu(struct maintenance *m, int cpu)
+{
+	if (cpu < -1) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	util_mutex_lock(&m->lock);
+	m->cpu = cpu;
+	if (m->running)
+		maintenance_apply_affinity(m);
+	util_mutex_unlock(&m->lock);
+
+	return 0;
+}
+
+/*
+ * maintenance_get_cpu -- returns the configured worker cpu affinity
+ */
+int
+maintenance_get_cpu(struct maintenance *m)
+{
+	util_mutex_lock(&m->lock);
+	int cpu = m->cpu;
+	util_mutex_unlock(&m->lock);
+
+	return cpu;
+}
+
+/*
+ * maintenance_bw_account -- charges background byte traffic to the governor
+ *
+ * The bytes always feed the measurement window; when a limit is set they
+ * are additionally drawn from the token bucket and any debt is slept off
+ * before returning, which caps the caller's sustained rate at the limit.
+ * The sleep happens outside of the lock, so concurrent callers are only
+ * serialized for the bookkeeping itself.
+ */
+void
+maintenance_bw_account(struct maintenance *m, size_t bytes)
+{
+	if (m == NULL || bytes == 0)
+		return;
+
+	struct timespec now;
+	os_clock_gettime(CLOCK_MONOTONIC, &now);
+
+	util_mutex_lock(&m->bw_lock);
+
+	m->bw_window_bytes += bytes;
+	uint64_t window_ns = maintenance_ns_since(&m->bw_window, &now);
+	if (window_ns >= MAINTENANCE_BW_BURST_NS) {
+		m->bw_measured = (uint64_t)((double)m->bw_window_bytes *
+			1000000000.0 / (double)window_ns);
+		m->bw_window_bytes = 0;
+		m->bw_window = now;
+	}
+
+	uint64_t sleep_ns = 0;
+	uint64_t limit = m->bw_limit;
+	if (limit != 0) {
+		uint64_t refill_ns = maintenance_ns_since(&m->bw_refill, &now);
+		uint64_t refill = (uint64_t)((double)refill_ns / 1000000000.0 *
+			(double)limit);
+		m->bw_tokens = m->bw_tokens + refill > limit ?
+			limit : m->bw_tokens + refill;
+		m->bw_refill = now;
+
+		if (m->bw_tokens >= bytes) {
+			m->bw_tokens -= bytes;
+		} else {
+			uint64_t debt = bytes - m->bw_tokens;
+			m->bw_tokens = 0;
+			sleep_ns = (uint64_t)((double)debt * 1000000000.0 /
+				(double)limit);
+
+			/*
+			 * The sleep itself must not mint new tokens, or the
+			 * debt would be refunded on the next refill and the
+			 * effective rate would double - so the refill clock
+			 * is moved past the sleep up front.
+			 */
+			m->bw_refill.tv_sec += (time_t)(sleep_ns / 1000000000);
+			m->bw_refill.tv_nsec += (long)(sleep_ns % 1000000000);
+			if (m->bw_refill.tv_nsec >= 1000000000) {
+				m->bw_refill.tv_sec += 1;
+				m->bw_refill.tv_nsec -= 1000000000;
+			}
+		}
+	}
+
+	util_mutex_unlock(&m->bw_lock);
+
+	if (sleep_ns != 0)
+		usleep((useconds_t)(sleep_ns / 1000));
+}
+
+/*
+ * maintenance_set_bw_limit -- caps the background bandwidth at the given
+ *	bytes per second, 0 lifts the cap
+ */
+int
+maintenance_set_bw_limit(struct maintenance *m, uint64_t limit)
+{
+	util_mutex_lock(&m->bw_lock);
+	m->bw_limit = limit;
+	/* a new limit starts with an empty bucket, not an inherited burst */
+	m->bw_tokens = 0;
+	os_clock_gettime(CLOCK_MONOTONIC, &m->bw_refill);
+	util_mutex_unlock(&m->bw_lock);
+
+	return 0;
+}
+
+/*
+ * maintenance_get_bw_limit -- returns the background bandwidth cap
+ */
+uint64_t
+maintenance_get_bw_limit(struct maintenance *m)
+{
+	util_mutex_lock(&m->bw_lock);
+	uint64_t limit = m->bw_limit;
+	util_mutex_unlock(&m->bw_lock);
+
+	return limit;
+}
+
+/*
+ * maintenance_get_bw_measured -- returns the background bandwidth observed
+ *	over the last full measurement window, in bytes per second
+ */
+uint64_t
+maintenance_get_bw_measured(struct maintenance *m)
+{
+	util_mutex_lock(&m->bw_lock);
+	uint64_t measured = m->bw_measured;
+	util_mutex_unlock(&m->bw_lock);
+
+	return measured;
+}
@@ -0,0 +1,59 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright 2024, Intel Corporation */
+
+/*
+ * maintenance.h -- pool background maintenance thread
+ */
+
+#ifndef LIBPMEMOBJ_MAINTENANCE_H
+#define LIBPMEMOBJ_MAINTENANCE_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct maintenance;
+
+/*
+ * A task step does a bounded chunk of work and returns nonzero when more
+ * work is immediately pending, in which case the worker keeps stepping the
+ * task (up to the configured budget) before moving on instead of going
+ * back to sleep.
+ */
+typedef int (*maintenance_task_fn)(void *arg);
+
+struct maintenance *maintenance_new(void);
+void maintenance_delete(struct maintenance *m);
+
+int maintenance_task_register(struct maintenance *m, const char *name,
+	maintenance_task_fn fn, void *arg);
+int maintenance_task_set_enabled(struct maintenance *m, const char *name,
+	int enabled);
+int maintenance_task_get_enabled(struct maintenance *m, const char *name);
+
+void maintenance_wake(struct maintenance *m);
+
+int maintenance_set_budget(struct maintenance *m, unsigned budget);
+unsigned maintenance_get_budget(struct maintenance *m);
+int maintenance_set_cpu(struct maintenance *m, int cpu);
+int maintenance_get_cpu(struct maintenance *m);
+
+/*
+ * Background work that moves bytes to or from the pool reports the amount
+ * here; when a bandwidth limit is configured the call sleeps off any debt,
+ * so the caller's rate is bounded from above by the limit.
+ */
+void maintenance_bw_account(struct maintenance *m, size_t bytes);
+
+int maintenance_set_bw_limit(struct maintenance *m, uint64_t limit);
+uint64_t maintenance_get_bw_limit(struct maintenance *m);
+uint64_t maintenance_get_bw_measured(struct maintenance *m);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -18,6 +18,10 @@
 
 #include <string.h>
 
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
 #include "obj.h"
 #include "heap.h"
 #include "memblock.h"
@@ -615,6 +619,30 @@ chunk_get_chunk_hdr_value(uint16_t type, uint16_t flags, uint32_t size_idx)
 	return val;
 }
 
+/*
+ * chunk_write_chunk_hdr -- (internal) atomically writes and persists a new
+ *	chunk header value
+ *
+ * By default the header is written with a regular store and then flushed.
+ * With heap.nt_headers.enabled the store bypasses the CPU cache entirely,
+ * which avoids repeatedly flushing the frequently rewritten header lines on
+ * platforms where the flush instruction is expensive.
+ */
+static void
+chunk_write_chunk_hdr(struct palloc_heap *heap, struct chunk_header *hdr,
+	uint64_t val)
+{
+	if (heap->nt_headers_enabled &&
+	    pmemops_store_8b_nt(&heap->p_ops, hdr, &val)) {
+		pmemops_drain(&heap->p_ops);
+		return;
+	}
+
+	util_atomic_store_explicit64((uint64_t *)hdr, val,
+		memory_order_relaxed);
+	pmemops_persist(&heap->p_ops, hdr, sizeof(*hdr));
+}
+
 /*
  * huge_prep_operation_hdr -- prepares the new value of a chunk header that will
  *	be set after the operation concludes.
@@ -635,9 +663,7 @@ huge_prep_operation_hdr(const struct memory_block *m, enum memblock_state op,
 		m->size_idx);
 
 	if (ctx == NULL) {
-		util_atomic_store_explicit64((uint64_t *)hdr, val,
-			memory_order_relaxed);
-		pmemops_persist(&m->heap->p_ops, hdr, sizeof(*hdr));
+		chunk_write_chunk_hdr(m->heap, hdr, val);
 	} else {
 		operation_add_entry(ctx, hdr, val, ULOG_OPERATION_SET);
 	}
@@ -717,6 +743,23 @@ run_prep_operation_hdr(const struct memory_block *m, enum memblock_state op,
 	struct run_bitmap b;
 	run_get_bitmap(m, &b);
 
+	/*
+	 * Without an operation context the bit mask is applied in place with a
+	 * single atomic modification of the bitmap value - the sole effect of
+	 * the operation is that one 8 byte store, so no redo log is needed.
+	 */
+	if (ctx == NULL) {
+		if (op == MEMBLOCK_ALLOCATED)
+			util_fetch_and_or64(&b.values[bpos], bmask);
+		else if (op == MEMBLOCK_FREE)
+			util_fetch_and_and64(&b.values[bpos], ~bmask);
+		else
+			ASSERT(0);
+		pmemops_persist(&m->heap->p_ops, &b.values[bpos],
+			sizeof(b.values[bpos]));
+		return;
+	}
+
 	/* the bit mask is applied immediately by the add entry operations */
 	if (op == MEMBLOCK_ALLOCATED) {
 		operation_add_entry(ctx, &b.values[bpos],
@@ -810,9 +853,7 @@ huge_ensure_header_type(const struct memory_block *m,
 		uint16_t f = ((uint16_t)header_type_to_flag[t]);
 		uint64_t nhdr = chunk_get_chunk_hdr_value(hdr->type,
 			hdr->flags | f, hdr->size_idx);
-		util_atomic_store_explicit64((uint64_t *)hdr,
-			nhdr, memory_order_relaxed);
-		pmemops_persist(&m->heap->p_ops, hdr, sizeof(*hdr));
+		chunk_write_chunk_hdr(m->heap, hdr, nhdr);
 		VALGRIND_REMOVE_FROM_TX(hdr, sizeof(*hdr));
 	}
 }
@@ -978,6 +1019,86 @@ run_process_bitmap_value(const struct memory_block *m,
 	return 0;
 }
 
+/*
+ * run_skip_full_values -- (internal) returns the index of the first bitmap
+ *	value with at least one clear (free) bit, starting the search at i
+ */
+static unsigned
+run_skip_full_values(const uint64_t *values, unsigned i, unsigned nvalues)
+{
+	while (i < nvalues && values[i] == UINT64_MAX)
+		++i;
+
+	return i;
+}
+
+#ifdef __x86_64__
+/*
+ * run_skip_full_values_avx2 -- (internal) variant of run_skip_full_values
+ *	that compares four bitmap values at a time
+ */
+__attribute__((target("avx2")))
+static unsigned
+run_skip_full_values_avx2(const uint64_t *values, unsigned i, unsigned nvalues)
+{
+	__m256i full = _mm256_set1_epi64x(-1);
+
+	while (i + 4 <= nvalues) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)&values[i]);
+		__m256i eq = _mm256_cmpeq_epi64(v, full);
+		if (_mm256_movemask_epi8(eq) != -1)
+			break;
+		i += 4;
+	}
+
+	return run_skip_full_values(values, i, nvalues);
+}
+
+/*
+ * run_skip_full_values_avx512f -- (internal) variant of run_skip_full_values
+ *	that compares eight bitmap values at a time
+ */
+__attribute__((target("avx512f")))
+static unsigned
+run_skip_full_values_avx512f(const uint64_t *values, unsigned i,
+	unsigned nvalues)
+{
+	__m512i full = _mm512_set1_epi64(-1);
+
+	while (i + 8 <= nvalues) {
+		__m512i v = _mm512_loadu_si512((const void *)&values[i]);
+		if (_mm512_cmpeq_epi64_mask(v, full) != UINT8_MAX)
+			break;
+		i += 8;
+	}
+
+	return run_skip_full_values(values, i, nvalues);
+}
+#endif
+
+static unsigned (*Run_skip_full_values)(const uint64_t *values,
+	unsigned i, unsigned nvalues) = run_skip_full_values;
+
+/*
+ * memblock_run_scan_init -- picks the fastest available bitmap scanning
+ *	variant supported by the cpu
+ *
+ * Called from the library constructor, the same way libpmem2 picks its
+ * memcpy variants at startup.
+ */
+void
+memblock_run_scan_init(void)
+{
+	LOG(3, NULL);
+
+#ifdef __x86_64__
+	if (__builtin_cpu_supports("avx512f"))
+		Run_skip_full_values = run_skip_full_values_avx512f;
+	else if (__builtin_cpu_supports("avx2"))
+		Run_skip_full_values = run_skip_full_values_avx2;
+#endif
+}
+
 /*
  * run_iterate_free -- iterates over free blocks in a run
  */
@@ -992,6 +1113,11 @@ run_iterate_free(const struct memory_block *m, object_callback cb, void *arg)
 
 	struct memory_block nm = *m;
 	for (unsigned i = 0; i < b.nvalues; ++i) {
+		/* skip over fully occupied parts of the bitmap */
+		i = Run_skip_full_values(b.values, i, b.nvalues);
+		if (i == b.nvalues)
+			break;
+
 		uint64_t v = b.values[i];
 		ASSERT((uint64_t)RUN_BITS_PER_VALUE * (uint64_t)i
 			<= UINT32_MAX);
@@ -1185,7 +1311,7 @@ static void
 huge_reinit_chunk(const struct memory_block *m)
 {
 	struct chunk_header *hdr = heap_get_chunk_hdr(m->heap, m);
-	if (hdr->type == CHUNK_TYPE_USED)
+	if (hdr->type == CHUNK_TYPE_USED || hdr->type == CHUNK_TYPE_BADBLOCK)
 		huge_write_footer(hdr, hdr->size_idx);
 }
 
@@ -1342,10 +1468,41 @@ memblock_huge_init(struct palloc_heap *heap,
 
 	uint64_t nhdr = chunk_get_chunk_hdr_value(CHUNK_TYPE_FREE,
 		0, size_idx);
-	util_atomic_store_explicit64((uint64_t *)hdr,
-		nhdr, memory_order_relaxed);
+	chunk_write_chunk_hdr(heap, hdr, nhdr);
 
-	pmemops_persist(&heap->p_ops, hdr, sizeof(*hdr));
+	huge_write_footer(hdr, size_idx);
+
+	memblock_rebuild_state(heap, &m);
+
+	return m;
+}
+
+/*
+ * memblock_badblock_init -- permanently retires a chunk that overlaps a
+ *	media error
+ *
+ * Retired chunks are never put into any bucket, are skipped by the zone
+ * reclamation scan and do not coalesce with neighboring free chunks, so
+ * the bad pages are simply taken out of circulation.
+ */
+struct memory_block
+memblock_badblock_init(struct palloc_heap *heap,
+	uint32_t chunk_id, uint32_t zone_id, uint32_t size_idx)
+{
+	struct memory_block m = MEMORY_BLOCK_NONE;
+	m.chunk_id = chunk_id;
+	m.zone_id = zone_id;
+	m.size_idx = size_idx;
+	m.heap = heap;
+
+	struct chunk_header *hdr = heap_get_chunk_hdr(heap, &m);
+
+	VALGRIND_DO_MAKE_MEM_UNDEFINED(hdr, sizeof(*hdr));
+	VALGRIND_ANNOTATE_NEW_MEMORY(hdr, sizeof(*hdr));
+
+	uint64_t nhdr = chunk_get_chunk_hdr_value(CHUNK_TYPE_BADBLOCK,
+		0, size_idx);
+	chunk_write_chunk_hdr(heap, hdr, nhdr);
 
 	huge_write_footer(hdr, size_idx);
 
@@ -1386,22 +1543,38 @@ memblock_run_init(struct palloc_heap *heap,
 	b.values = (uint64_t *)run->content;
 
 	size_t bitmap_size = b.size;
+	size_t nzeroed = sizeof(*b.values) * (b.nvalues - 1);
 
-	/* set all the bits */
-	memset(b.values, 0xFF, bitmap_size);
-
-	/* clear only the bits available for allocations from this bucket */
-	memset(b.values, 0, sizeof(*b.values) * (b.nvalues - 1));
+	/*
+	 * The bits available for allocations from this bucket are cleared
+	 * and everything else is set, with the last actual value mixing
+	 * both. Non-temporal stores need no flush of their own, so only the
+	 * run header and the line with the last value are flushed; the
+	 * drain is left to the chunk headers' persist below.
+	 */
+	pmemops_memset(&heap->p_ops, b.values, 0, nzeroed,
+		PMEMOBJ_F_MEM_NONTEMPORAL |
+		PMEMOBJ_F_MEM_NODRAIN |
+		PMEMOBJ_F_RELAXED);
 
 	unsigned trailing_bits = b.nbits % RUN_BITS_PER_VALUE;
 	uint64_t last_value = UINT64_MAX << trailing_bits;
 	b.values[b.nvalues - 1] = last_value;
 
+	if (bitmap_size > nzeroed + sizeof(*b.values))
+		pmemops_memset(&heap->p_ops,
+			&b.values[b.nvalues], 0xFF,
+			bitmap_size - nzeroed - sizeof(*b.values),
+			PMEMOBJ_F_MEM_NONTEMPORAL |
+			PMEMOBJ_F_MEM_NODRAIN |
+			PMEMOBJ_F_RELAXED);
+
 	VALGRIND_REMOVE_FROM_TX(run, runsize);
 
 	pmemops_flush(&heap->p_ops, run,
-		sizeof(struct chunk_run_header) +
-		bitmap_size);
+		sizeof(struct chunk_run_header));
+	pmemops_flush(&heap->p_ops, &b.values[b.nvalues - 1],
+		sizeof(*b.values));
 
 	struct chunk_header run_data_hdr;
 	run_data_hdr.type = CHUNK_TYPE_RUN_DATA;
@@ -1429,9 +1602,7 @@ memblock_run_init(struct palloc_heap *heap,
 
 	uint64_t run_hdr = chunk_get_chunk_hdr_value(CHUNK_TYPE_RUN,
 		rdsc->flags, hdr->size_idx);
-	util_atomic_store_explicit64((uint64_t *)hdr,
-		run_hdr, memory_order_relaxed);
-	pmemops_persist(&heap->p_ops, hdr, sizeof(*hdr));
+	chunk_write_chunk_hdr(heap, hdr, run_hdr);
 
 	VALGRIND_REMOVE_FROM_TX(&z->chunk_headers[chunk_id],
 		sizeof(struct chunk_header) * size_idx);
@@ -1459,6 +1630,7 @@ memblock_detect_type(struct palloc_heap *heap, const struct memory_block *m)
 		case CHUNK_TYPE_FREE:
 		case CHUNK_TYPE_USED:
 		case CHUNK_TYPE_FOOTER:
+		case CHUNK_TYPE_BADBLOCK:
 			ret = MEMORY_BLOCK_HUGE;
 			break;
 		default:
@@ -292,6 +292,9 @@ void memblock_rebuild_state(struct palloc_heap *heap, struct memory_block *m);
 struct memory_block memblock_huge_init(struct palloc_heap *heap,
 	uint32_t chunk_id, uint32_t zone_id, uint32_t size_idx);
 
+struct memory_block memblock_badblock_init(struct palloc_heap *heap,
+	uint32_t chunk_id, uint32_t zone_id, uint32_t size_idx);
+
 struct memory_block memblock_run_init(struct palloc_heap *heap,
 	uint32_t chunk_id, uint32_t zone_id, struct run_descriptor *rdsc);
 
@@ -299,6 +302,8 @@ void memblock_run_bitmap(uint32_t *size_idx, uint16_t flags,
 	uint64_t unit_size, uint64_t alignment, void *content,
 	struct run_bitmap *b);
 
+void memblock_run_scan_init(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -17,6 +17,7 @@
 #include "memops.h"
 #include "obj.h"
 #include "out.h"
+#include "persist_epoch.h"
 #include "ravl.h"
 #include "ulog.h"
 #include "valgrind_internal.h"
@@ -55,6 +56,8 @@ struct operation_context {
 	size_t ulog_curr_gen_num; /* transaction counter in the current log */
 	struct ulog *ulog_curr; /* current persistent log */
 	size_t total_logged; /* total amount of buffer stores in the logs */
+	size_t extend_count; /* number of on-demand ulog extensions */
+	size_t flush_count; /* number of persistent log entries flushed */
 
 	struct ulog *ulog; /* pointer to the persistent ulog log */
 	size_t ulog_base_nbytes; /* available bytes in initial ulog log */
@@ -352,6 +355,36 @@ operation_merge_entry_add(struct operation_context *ctx,
 	}
 }
 
+/*
+ * operation_log_ensure_space -- (internal) grows the shadow log when less
+ *	than one spare cacheline would be left for the next entry creation,
+ *	which needs the extra room for zeroing
+ */
+static int
+operation_log_ensure_space(struct operation_context *ctx,
+	struct operation_log *oplog)
+{
+	if (oplog->offset + CACHELINE_SIZE < oplog->capacity)
+		return 0;
+
+	size_t ncapacity = oplog->capacity + ULOG_BASE_SIZE;
+	struct ulog *ulog = Realloc(oplog->ulog,
+		SIZEOF_ULOG(ncapacity));
+	if (ulog == NULL)
+		return -1;
+	oplog->capacity += ULOG_BASE_SIZE;
+	oplog->ulog = ulog;
+	oplog->ulog->capacity = oplog->capacity;
+
+	/*
+	 * Realloc invalidated the ulog entries that are inside of this
+	 * vector, need to clear it to avoid use after free.
+	 */
+	VECQ_CLEAR(&ctx->merge_entries);
+
+	return 0;
+}
+
 /*
  * operation_add_typed_value -- adds new entry to the current operation, if the
  *	same ptr address already exists and the operation type is set,
@@ -365,26 +398,8 @@ operation_add_typed_entry(struct operation_context *ctx,
 	struct operation_log *oplog = log_type == LOG_PERSISTENT ?
 		&ctx->pshadow_ops : &ctx->transient_ops;
 
-	/*
-	 * Always make sure to have one extra spare cacheline so that the
-	 * ulog log entry creation has enough room for zeroing.
-	 */
-	if (oplog->offset + CACHELINE_SIZE == oplog->capacity) {
-		size_t ncapacity = oplog->capacity + ULOG_BASE_SIZE;
-		struct ulog *ulog = Realloc(oplog->ulog,
-			SIZEOF_ULOG(ncapacity));
-		if (ulog == NULL)
-			return -1;
-		oplog->capacity += ULOG_BASE_SIZE;
-		oplog->ulog = ulog;
-		oplog->ulog->capacity = oplog->capacity;
-
-		/*
-		 * Realloc invalidated the ulog entries that are inside of this
-		 * vector, need to clear it to avoid use after free.
-		 */
-		VECQ_CLEAR(&ctx->merge_entries);
-	}
+	if (operation_log_ensure_space(ctx, oplog) != 0)
+		return -1;
 
 	if (log_type == LOG_PERSISTENT &&
 		operation_try_merge_entry(ctx, ptr, value, type) != 0)
@@ -420,6 +435,38 @@ operation_add_entry(struct operation_context *ctx, void *ptr, uint64_t value,
 		from_pool ? LOG_PERSISTENT : LOG_TRANSIENT);
 }
 
+/*
+ * operation_add_range_entry -- adds an inline byte-range entry of up to
+ *	16 bytes to the current operation
+ *
+ * Unlike buffer operations, the data travels packed inside the log entry,
+ * so small unaligned or 9..16 byte modifications avoid the full,
+ * cacheline-aligned buffer entry header.
+ */
+int
+operation_add_range_entry(struct operation_context *ctx, void *ptr,
+	const void *src, size_t size)
+{
+	const struct pmem_ops *p_ops = ctx->p_ops;
+	PMEMobjpool *pop = (PMEMobjpool *)p_ops->base;
+
+	int from_pool = OBJ_OFF_IS_VALID(pop,
+		(uintptr_t)ptr - (uintptr_t)p_ops->base);
+	struct operation_log *oplog = from_pool ?
+		&ctx->pshadow_ops : &ctx->transient_ops;
+
+	if (operation_log_ensure_space(ctx, oplog) != 0)
+		return -1;
+
+	struct ulog_entry_val16 *entry = ulog_entry_val16_create(
+		oplog->ulog, oplog->offset, ptr, src, size,
+		from_pool ? &ctx->s_ops : &ctx->t_ops);
+
+	oplog->offset += ulog_entry_size(&entry->base);
+
+	return 0;
+}
+
 /*
  * operation_add_buffer -- adds a buffer operation to the log
  */
@@ -476,6 +523,7 @@ operation_add_buffer(struct operation_context *ctx,
 	ASSERT(entry_size == ulog_entry_size(&e->base));
 	ASSERT(entry_size <= ctx->ulog_curr_capacity);
 
+	ctx->flush_count++;
 	ctx->total_logged += entry_size;
 	ctx->ulog_curr_offset += entry_size;
 	ctx->ulog_curr_capacity -= entry_size;
@@ -649,6 +697,26 @@ operation_get_any_user_buffer(struct operation_context *ctx)
 	return ctx->ulog_any_user_buffer;
 }
 
+/*
+ * operation_get_extend_count -- get the number of times the persistent log
+ *	was extended on demand since the operation started
+ */
+size_t
+operation_get_extend_count(const struct operation_context *ctx)
+{
+	return ctx->extend_count;
+}
+
+/*
+ * operation_get_flush_count -- get the number of persistent log entries
+ *	flushed since the operation started
+ */
+size_t
+operation_get_flush_count(const struct operation_context *ctx)
+{
+	return ctx->flush_count;
+}
+
 /*
  * operation_process_persistent_redo -- (internal) process using ulog
  */
@@ -662,10 +730,29 @@ operation_process_persistent_redo(struct operation_context *ctx)
 		ctx->ulog_capacity,
 		&ctx->next, ctx->p_ops);
 
+	/* the log must be durable before any of it is applied */
+	persist_epoch_assert_ordered(ctx->ulog,
+		SIZEOF_ULOG(ctx->ulog_base_nbytes),
+		"redo log store before apply");
+
+	uint64_t apply_epoch = persist_epoch_current();
+
 	ulog_process(ctx->pshadow_ops.ulog, OBJ_OFF_IS_VALID_FROM_CTX,
 		ctx->p_ops);
 
-	ulog_clobber(ctx->ulog, &ctx->next, ctx->p_ops);
+	/* the applied data must be durable before the log is invalidated */
+	if (ctx->pshadow_ops.offset != 0)
+		persist_epoch_assert_advanced(apply_epoch,
+			"redo apply before invalidate");
+
+	/*
+	 * The processed log needs to be invalidated so that recovery does
+	 * not apply it again. Instead of clobbering the entire header with
+	 * zeros, only the generation number is bumped - the stored checksum
+	 * no longer verifies and recovery skips the log, while the write
+	 * shrinks from a full header cacheline to 8 bytes.
+	 */
+	ulog_invalidate(ctx->ulog, ctx->p_ops);
 }
 
 /*
@@ -699,6 +786,7 @@ operation_reserve(struct operation_context *ctx, size_t new_capacity)
 		    &ctx->next, ctx->p_ops) != 0)
 			return -1;
 		ctx->ulog_capacity = new_capacity;
+		ctx->extend_count++;
 	}
 
 	return 0;
@@ -727,6 +815,8 @@ operation_init(struct operation_context *ctx)
 	ctx->ulog_curr_gen_num = 0;
 	ctx->ulog_curr = NULL;
 	ctx->total_logged = 0;
+	ctx->extend_count = 0;
+	ctx->flush_count = 0;
 	ctx->ulog_auto_reserve = 1;
 	ctx->ulog_any_user_buffer = 0;
 }
@@ -756,6 +846,18 @@ operation_resume(struct operation_context *ctx)
 	}
 }
 
+/*
+ * operation_is_empty -- returns whether the operation context has no entries
+ *	registered
+ */
+int
+operation_is_empty(const struct operation_context *ctx)
+{
+	return ctx->pshadow_ops.offset == 0 &&
+		ctx->transient_ops.offset == 0 &&
+		ctx->total_logged == 0;
+}
+
 /*
  * operation_cancel -- cancels a running operation
  */
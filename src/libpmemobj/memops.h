@@ -64,6 +64,8 @@ int operation_add_entry(struct operation_context *ctx,
 int operation_add_typed_entry(struct operation_context *ctx,
 	void *ptr, uint64_t value,
 	ulog_operation_type type, enum operation_log_type log_type);
+int operation_add_range_entry(struct operation_context *ctx,
+	void *ptr, const void *src, size_t size);
 int operation_user_buffer_verify_align(struct operation_context *ctx,
 		struct user_buffer_def *userbuf);
 void operation_add_user_buffer(struct operation_context *ctx,
@@ -73,12 +75,15 @@ void operation_set_auto_reserve(struct operation_context *ctx,
 void operation_set_any_user_buffer(struct operation_context *ctx,
 	int any_user_buffer);
 int operation_get_any_user_buffer(struct operation_context *ctx);
+size_t operation_get_extend_count(const struct operation_context *ctx);
+size_t operation_get_flush_count(const struct operation_context *ctx);
 int operation_user_buffer_range_cmp(const void *lhs, const void *rhs);
 
 int operation_reserve(struct operation_context *ctx, size_t new_capacity);
 void operation_process(struct operation_context *ctx);
 void operation_finish(struct operation_context *ctx, unsigned flags);
 void operation_cancel(struct operation_context *ctx);
+int operation_is_empty(const struct operation_context *ctx);
 
 #ifdef __cplusplus
 }
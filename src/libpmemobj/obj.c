@@ -4,10 +4,15 @@
 /*
  * obj.c -- transactional object store implementation
  */
+#include <fcntl.h>
 #include <inttypes.h>
 #include <limits.h>
+#include <setjmp.h>
+#include <signal.h>
 #include <wchar.h>
 #include <stdbool.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include "valgrind_internal.h"
 #include "libpmem.h"
@@ -17,9 +22,12 @@
 #include "mmap.h"
 #include "obj.h"
 #include "ctl_global.h"
+#include "heap.h"
 #include "ravl.h"
 
 #include "heap_layout.h"
+#include "file.h"
+#include "maintenance.h"
 #include "os.h"
 #include "os_thread.h"
 #include "pmemops.h"
@@ -68,6 +76,32 @@ static os_mutex_t pools_mutex;
 
 __thread struct _pobj_pcache _pobj_cached_pool;
 
+struct _pobj_sole_pool _pobj_sole_pool;
+
+unsigned _pobj_heat_period;
+__thread unsigned _pobj_heat_countdown;
+
+/*
+ * _pobj_heat_record -- slow path of the translation sampling, called once
+ *	per _pobj_heat_period oid translations
+ *
+ * Resolves the pool of the sampled oid and bumps the heat counter of the
+ * zone the oid points into. The counters only drive tiering heuristics, so
+ * oids that do not resolve to a heap offset of an open pool are dropped
+ * without any logging.
+ */
+void
+_pobj_heat_record(PMEMoid oid)
+{
+	_pobj_heat_countdown = _pobj_heat_period;
+
+	PMEMobjpool *pop = pmemobj_pool_by_oid(oid);
+	if (pop == NULL || !OBJ_OFF_FROM_HEAP(pop, oid.off))
+		return;
+
+	heap_heat_record(&pop->heap, oid.off);
+}
+
 /*
  * pmemobj_direct -- returns the direct pointer of an object
  */
@@ -77,6 +111,91 @@ pmemobj_direct(PMEMoid oid)
 	return pmemobj_direct_inline(oid);
 }
 
+/*
+ * pmemobj_prefetch_oids -- issues software prefetches for a batch of objects
+ *
+ * Pointer-chasing iterators serialize on media latency once per hop; calling
+ * this with the next few oids of the chain lets the CPU overlap those
+ * fetches with the processing of the current node. This is purely a
+ * performance hint - oids that do not resolve are skipped and no state is
+ * modified, so the helper is deliberately free of logging and validation.
+ */
+void
+pmemobj_prefetch_oids(const PMEMoid *oidv, size_t noids)
+{
+	for (size_t i = 0; i < noids; ++i) {
+		void *ptr = pmemobj_direct(oidv[i]);
+		if (ptr == NULL)
+			continue;
+
+		__builtin_prefetch(ptr, 0, 3);
+	}
+}
+
+/*
+ * pmemobj_direct_multi -- translates an array of oids into direct pointers
+ *
+ * Unlike per-element pmemobj_direct() calls, the pool is resolved once from
+ * the pop argument, so the loop is a stream of independent base + offset
+ * additions. Each translated object is prefetched as soon as its address
+ * is known, letting the fetches of later elements overlap the caller's
+ * processing of earlier ones. Oids equal to OID_NULL or belonging to a
+ * different pool translate to NULL.
+ */
+void
+pmemobj_direct_multi(PMEMobjpool *pop, const PMEMoid *oidv, void **ptrv,
+	size_t noids)
+{
+	uintptr_t base = (uintptr_t)pop;
+	uint64_t uuid_lo = pop->uuid_lo;
+
+	for (size_t i = 0; i < noids; ++i) {
+		PMEMoid oid = oidv[i];
+		void *ptr = NULL;
+
+		if (oid.off != 0 && oid.pool_uuid_lo == uuid_lo) {
+			ptr = (void *)(base + oid.off);
+			__builtin_prefetch(ptr, 0, 3);
+			_pobj_heat_sample(oid);
+		}
+
+		ptrv[i] = ptr;
+	}
+}
+
+/*
+ * pmemobj_set_sole_pool -- registers the only open pool of the process for
+ *	the lookup-free pmemobj_direct_sole(), or unregisters it when NULL
+ */
+void
+pmemobj_set_sole_pool(PMEMobjpool *pop)
+{
+	LOG(3, "pop %p", pop);
+
+	if (pop == NULL) {
+		_pobj_sole_pool.uuid_lo = 0;
+		_pobj_sole_pool.pop = NULL;
+	} else {
+		_pobj_sole_pool.pop = pop;
+		_pobj_sole_pool.uuid_lo = pop->uuid_lo;
+	}
+}
+
+static void obj_shadow_ctl_register(PMEMobjpool *pop);
+static void obj_warmup_cleanup(PMEMobjpool *pop);
+static void obj_base_hint_ctl_register(PMEMobjpool *pop);
+static void obj_pmem_ctl_register(PMEMobjpool *pop);
+static void obj_audit_ctl_register(PMEMobjpool *pop);
+static void obj_audit_sample(PMEMobjpool *pop, const void *addr, size_t len);
+static int obj_audit_boot(PMEMobjpool *pop);
+static void obj_audit_cleanup(PMEMobjpool *pop);
+static void obj_scrub_ctl_register(PMEMobjpool *pop);
+static int obj_scrub_boot(PMEMobjpool *pop);
+static void obj_scrub_cleanup(PMEMobjpool *pop);
+static int obj_oid32_boot(PMEMobjpool *pop);
+static void obj_oid32_cleanup(PMEMobjpool *pop);
+static void obj_shadow_disable(PMEMobjpool *pop);
+
 /*
  * obj_ctl_init_and_load -- (static) initializes CTL and loads configuration
  *	from env variable and file
@@ -96,6 +215,11 @@ obj_ctl_init_and_load(PMEMobjpool *pop)
 		pmalloc_ctl_register(pop);
 		stats_ctl_register(pop);
 		debug_ctl_register(pop);
+		obj_shadow_ctl_register(pop);
+		obj_base_hint_ctl_register(pop);
+		obj_pmem_ctl_register(pop);
+		obj_audit_ctl_register(pop);
+		obj_scrub_ctl_register(pop);
 	}
 
 	char *env_config = os_getenv(OBJ_CONFIG_ENV_VARIABLE);
@@ -175,6 +299,84 @@ pmemobj_oid(const void *addr)
 	return oid;
 }
 
+/*
+ * CTL_READ_HANDLER(pending_deleted) -- returns the number of entries removed
+ *	from the pool indexes but still within their reclamation grace period
+ */
+static int
+CTL_READ_HANDLER(pending_deleted)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(ctx, source, indexes);
+
+	uint64_t *arg_out = arg;
+	uint64_t p, r;
+
+	*arg_out = 0;
+
+	if (pools_ht) {
+		critnib_gc_stats(pools_ht, &p, &r);
+		*arg_out += p;
+	}
+
+	if (pools_tree) {
+		critnib_gc_stats(pools_tree, &p, &r);
+		*arg_out += p;
+	}
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(recyclable) -- returns the number of index entries that
+ *	survived their grace period and await reuse
+ */
+static int
+CTL_READ_HANDLER(recyclable)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(ctx, source, indexes);
+
+	uint64_t *arg_out = arg;
+	uint64_t p, r;
+
+	*arg_out = 0;
+
+	if (pools_ht) {
+		critnib_gc_stats(pools_ht, &p, &r);
+		*arg_out += r;
+	}
+
+	if (pools_tree) {
+		critnib_gc_stats(pools_tree, &p, &r);
+		*arg_out += r;
+	}
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(index_global)[] = {
+	CTL_LEAF_RO(pending_deleted),
+	CTL_LEAF_RO(recyclable),
+
+	CTL_NODE_END
+};
+
+/*
+ * obj_global_ctl_register -- (internal) register global ctl entries exposing
+ *	the reclamation state of the pool indexes
+ */
+static void
+obj_global_ctl_register(void)
+{
+	ctl_register_module_node(NULL, "index",
+		(struct ctl_node *)CTL_NODE(index_global));
+}
+
 /*
  * obj_init -- initialization of obj
  *
@@ -206,10 +408,15 @@ obj_init(void)
 	 */
 	ctl_global_register();
 	pmalloc_global_ctl_register();
+	obj_global_ctl_register();
 
 	if (obj_ctl_init_and_load(NULL))
 		CORE_LOG_FATAL("error: %s", pmemobj_errormsg());
 
+	memblock_run_scan_init();
+
+	sync_boot();
+
 	lane_info_boot();
 }
 
@@ -348,6 +555,43 @@ obj_norep_memset(void *ctx, void *dest, int c, size_t len, unsigned flags)
 	return pop->memset_local(dest, c, len, flags & PMEM_F_MEM_VALID_FLAGS);
 }
 
+/*
+ * obj_norep_store_line -- (internal) single cache line store w/o replication
+ */
+static void
+obj_norep_store_line(void *ctx, void *dest, const void *src)
+{
+	PMEMobjpool *pop = ctx;
+	LOG(15, "pop %p dest %p src %p", pop, dest, src);
+
+	pmem_store_line(dest, src);
+}
+
+/*
+ * obj_norep_store_16b -- (internal) atomic 16-byte store w/o replication
+ */
+static void
+obj_norep_store_16b(void *ctx, void *dest, const void *src)
+{
+	PMEMobjpool *pop = ctx;
+	LOG(15, "pop %p dest %p src %p", pop, dest, src);
+
+	pmem_store_16b(dest, src);
+}
+
+/*
+ * obj_norep_store_8b_nt -- (internal) non-temporal 8-byte store w/o
+ *	replication
+ */
+static void
+obj_norep_store_8b_nt(void *ctx, void *dest, const void *src)
+{
+	PMEMobjpool *pop = ctx;
+	LOG(15, "pop %p dest %p src %p", pop, dest, src);
+
+	pmem_store_8b_nt(dest, src);
+}
+
 /*
  * obj_norep_persist -- (internal) persist w/o replication
  */
@@ -362,6 +606,8 @@ obj_norep_persist(void *ctx, const void *addr, size_t len, unsigned flags)
 
 	pop->persist_local(addr, len);
 
+	obj_audit_sample(pop, addr, len);
+
 	return 0;
 }
 
@@ -394,7 +640,77 @@ obj_norep_drain(void *ctx)
 	pop->drain_local();
 }
 
+/*
+ * obj_norep_persist_noflush -- (internal) persist w/o replication on
+ * platforms with the automatic cache flush - stores are power-fail safe
+ * once globally visible, so only the ordering point remains
+ */
+static int
+obj_norep_persist_noflush(void *ctx, const void *addr, size_t len,
+		unsigned flags)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(flags);
+
+	PMEMobjpool *pop = ctx;
+	LOG(15, "pop %p addr %p len %zu", pop, addr, len);
+
+	VALGRIND_DO_FLUSH(addr, len);
+	pop->drain_local();
+
+	obj_audit_sample(pop, addr, len);
+
+	return 0;
+}
+
+/*
+ * obj_norep_flush_noflush -- (internal) flush w/o replication on platforms
+ * with the automatic cache flush - the CPU cache does not have to be
+ * flushed at all
+ */
+static int
+obj_norep_flush_noflush(void *ctx, const void *addr, size_t len,
+		unsigned flags)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(flags);
+
+	PMEMobjpool *pop = ctx;
+	LOG(15, "pop %p addr %p len %zu", pop, addr, len);
+
+	VALGRIND_DO_FLUSH(addr, len);
+
+	return 0;
+}
+
+/*
+ * obj_auto_flush_enabled -- (internal) check whether flushing can be elided
+ * because the platform flushes the CPU cache on power failure, honoring the
+ * same PMEM_NO_FLUSH override as libpmem
+ */
+static int
+obj_auto_flush_enabled(void)
+{
+	char *e = os_getenv("PMEM_NO_FLUSH");
+	if (e && strcmp(e, "1") == 0)
+		return 1;
+	if (e && strcmp(e, "0") == 0)
+		return 0;
+
+	return pmem_has_auto_flush() == 1;
+}
+
 static void obj_pool_cleanup(PMEMobjpool *pop);
+static void obj_rep_drain(void *ctx);
+
+/*
+ * The stores to each replica are issued with the drain deferred, so the
+ * flushes of all the replicas are in flight at the same time and a single
+ * combined drain at the end completes them all.  This way replication
+ * costs roughly the latency of the slowest replica instead of the sum
+ * of all of them.  Replicas backed by regular files still msync inline,
+ * so only pmem replicas benefit from the overlap.
+ */
 
 /*
  * obj_rep_memcpy -- (internal) memcpy with replication
@@ -407,16 +723,25 @@ obj_rep_memcpy(void *ctx, void *dest, const void *src, size_t len,
 	LOG(15, "pop %p dest %p src %p len %zu flags 0x%x", pop, dest, src, len,
 			flags);
 
-	void *ret = pop->memcpy_local(dest, src, len, flags);
+	void *ret = pop->memcpy_local(dest, src, len,
+		flags | PMEM_F_MEM_NODRAIN);
 
 	PMEMobjpool *rep = pop->replica;
 	while (rep) {
 		void *rdest = (char *)rep + (uintptr_t)dest - (uintptr_t)pop;
 		rep->memcpy_local(rdest, src, len,
-			flags & PMEM_F_MEM_VALID_FLAGS);
+			(flags & PMEM_F_MEM_VALID_FLAGS) |
+			PMEM_F_MEM_NODRAIN);
 		rep = rep->replica;
 	}
 
+	if (pop->replica_ops)
+		pop->replica_ops->write(pop->replica_ctx,
+			(size_t)((char *)dest - (char *)pop), dest, len);
+
+	if (!(flags & PMEM_F_MEM_NODRAIN))
+		obj_rep_drain(pop);
+
 	return ret;
 }
 
@@ -431,16 +756,26 @@ obj_rep_memmove(void *ctx, void *dest, const void *src, size_t len,
 	LOG(15, "pop %p dest %p src %p len %zu flags 0x%x", pop, dest, src, len,
 			flags);
 
-	void *ret = pop->memmove_local(dest, src, len, flags);
+	void *ret = pop->memmove_local(dest, src, len,
+		flags | PMEM_F_MEM_NODRAIN);
 
 	PMEMobjpool *rep = pop->replica;
 	while (rep) {
 		void *rdest = (char *)rep + (uintptr_t)dest - (uintptr_t)pop;
 		rep->memmove_local(rdest, src, len,
-			flags & PMEM_F_MEM_VALID_FLAGS);
+			(flags & PMEM_F_MEM_VALID_FLAGS) |
+			PMEM_F_MEM_NODRAIN);
 		rep = rep->replica;
 	}
 
+	/* dest already holds the moved content, safe even when overlapping */
+	if (pop->replica_ops)
+		pop->replica_ops->write(pop->replica_ctx,
+			(size_t)((char *)dest - (char *)pop), dest, len);
+
+	if (!(flags & PMEM_F_MEM_NODRAIN))
+		obj_rep_drain(pop);
+
 	return ret;
 }
 
@@ -454,16 +789,25 @@ obj_rep_memset(void *ctx, void *dest, int c, size_t len, unsigned flags)
 	LOG(15, "pop %p dest %p c 0x%02x len %zu flags 0x%x", pop, dest, c, len,
 			flags);
 
-	void *ret = pop->memset_local(dest, c, len, flags);
+	void *ret = pop->memset_local(dest, c, len,
+		flags | PMEM_F_MEM_NODRAIN);
 
 	PMEMobjpool *rep = pop->replica;
 	while (rep) {
 		void *rdest = (char *)rep + (uintptr_t)dest - (uintptr_t)pop;
 		rep->memset_local(rdest, c, len,
-			flags & PMEM_F_MEM_VALID_FLAGS);
+			(flags & PMEM_F_MEM_VALID_FLAGS) |
+			PMEM_F_MEM_NODRAIN);
 		rep = rep->replica;
 	}
 
+	if (pop->replica_ops)
+		pop->replica_ops->write(pop->replica_ctx,
+			(size_t)((char *)dest - (char *)pop), dest, len);
+
+	if (!(flags & PMEM_F_MEM_NODRAIN))
+		obj_rep_drain(pop);
+
 	return ret;
 }
 
@@ -479,15 +823,23 @@ obj_rep_persist(void *ctx, const void *addr, size_t len, unsigned flags)
 	PMEMobjpool *pop = ctx;
 	LOG(15, "pop %p addr %p len %zu", pop, addr, len);
 
-	pop->persist_local(addr, len);
+	pop->flush_local(addr, len);
 
 	PMEMobjpool *rep = pop->replica;
 	while (rep) {
 		void *raddr = (char *)rep + (uintptr_t)addr - (uintptr_t)pop;
-		rep->memcpy_local(raddr, addr, len, 0);
+		rep->memcpy_local(raddr, addr, len, PMEM_F_MEM_NODRAIN);
 		rep = rep->replica;
 	}
 
+	if (pop->replica_ops)
+		pop->replica_ops->write(pop->replica_ctx,
+			(size_t)((char *)addr - (char *)pop), addr, len);
+
+	obj_rep_drain(pop);
+
+	obj_audit_sample(pop, addr, len);
+
 	return 0;
 }
 
@@ -512,6 +864,10 @@ obj_rep_flush(void *ctx, const void *addr, size_t len, unsigned flags)
 		rep = rep->replica;
 	}
 
+	if (pop->replica_ops)
+		pop->replica_ops->write(pop->replica_ctx,
+			(size_t)((char *)addr - (char *)pop), addr, len);
+
 	return 0;
 }
 
@@ -531,6 +887,10 @@ obj_rep_drain(void *ctx)
 		rep->drain_local();
 		rep = rep->replica;
 	}
+
+	/* the completion barrier of the user transport */
+	if (pop->replica_ops)
+		pop->replica_ops->drain(pop->replica_ctx);
 }
 
 #if VG_MEMCHECK_ENABLED
@@ -668,6 +1028,11 @@ obj_runtime_init_common(PMEMobjpool *pop)
 		return errno;
 	}
 
+	if ((errno = heap_maintenance_boot(&pop->heap)) != 0) {
+		ERR_W_ERRNO("heap_maintenance_boot");
+		return errno;
+	}
+
 	pop->conversion_flags = 0;
 	pmemops_persist(&pop->p_ops,
 		&pop->conversion_flags, sizeof(pop->conversion_flags));
@@ -683,6 +1048,10 @@ obj_runtime_init_common(PMEMobjpool *pop)
 static void
 obj_runtime_cleanup_common(PMEMobjpool *pop)
 {
+	heap_maintenance_cleanup(&pop->heap);
+	obj_audit_cleanup(pop);
+	obj_scrub_cleanup(pop);
+	obj_oid32_cleanup(pop);
 	lane_section_cleanup(pop);
 	lane_cleanup(pop);
 }
@@ -749,6 +1118,22 @@ obj_descr_create(PMEMobjpool *pop, const char *layout, size_t poolsize)
 	pmemops_persist(p_ops, &pop->conversion_flags,
 		sizeof(pop->conversion_flags));
 
+	pop->heap_snapshot_offset = 0;
+	pmemops_persist(p_ops, &pop->heap_snapshot_offset,
+		sizeof(pop->heap_snapshot_offset));
+
+	pop->mapping_hint = 0;
+	pmemops_persist(p_ops, &pop->mapping_hint,
+		sizeof(pop->mapping_hint));
+
+	pop->oid32_dir_offset = 0;
+	pmemops_persist(p_ops, &pop->oid32_dir_offset,
+		sizeof(pop->oid32_dir_offset));
+
+	memset(&pop->multi_commit, 0, sizeof(pop->multi_commit));
+	pmemops_persist(p_ops, &pop->multi_commit,
+		sizeof(pop->multi_commit));
+
 	/*
 	 * It's safe to use PMEMOBJ_F_RELAXED flag because the reserved
 	 * area must be entirely zeroed.
@@ -836,6 +1221,66 @@ obj_replica_init_local(PMEMobjpool *rep, int is_pmem, size_t resvsize)
 	return 0;
 }
 
+/*
+ * obj_master_ops_init -- (internal) select the store dispatch of the master
+ * replica, which fans out to the other replicas and to the user-pluggable
+ * transport when either is present
+ */
+static void
+obj_master_ops_init(PMEMobjpool *rep, struct pool_set *set)
+{
+	struct pool_replica *repset = set->replica[0];
+
+	rep->p_ops.store_line = NULL;
+	rep->p_ops.store_16b = NULL;
+	rep->p_ops.store_8b_nt = NULL;
+
+	if (set->nreplicas > 1 || rep->replica_ops != NULL) {
+		rep->p_ops.persist = obj_rep_persist;
+		rep->p_ops.flush = obj_rep_flush;
+		rep->p_ops.drain = obj_rep_drain;
+		rep->p_ops.memcpy = obj_rep_memcpy;
+		rep->p_ops.memmove = obj_rep_memmove;
+		rep->p_ops.memset = obj_rep_memset;
+	} else {
+		rep->p_ops.persist = obj_norep_persist;
+		rep->p_ops.flush = obj_norep_flush;
+		rep->p_ops.drain = obj_norep_drain;
+		rep->p_ops.memcpy = obj_norep_memcpy;
+		rep->p_ops.memmove = obj_norep_memmove;
+		rep->p_ops.memset = obj_norep_memset;
+
+		/*
+		 * With the automatic cache flush there is nothing for
+		 * persist and flush to do besides ordering, so the
+		 * flush call chain is cut right at the dispatch.
+		 */
+		if (repset->is_pmem && obj_auto_flush_enabled()) {
+			rep->p_ops.persist = obj_norep_persist_noflush;
+			rep->p_ops.flush = obj_norep_flush_noflush;
+		}
+
+		/*
+		 * A direct store writes the line in place, so it
+		 * cannot be offered when the data has to be
+		 * replicated or msynced.
+		 */
+		if (repset->is_pmem && pmem_has_store_line())
+			rep->p_ops.store_line = obj_norep_store_line;
+
+		/*
+		 * The atomic 16-byte store is persisted in place too,
+		 * so the same restriction applies.
+		 */
+		if (repset->is_pmem && pmem_has_store_16b())
+			rep->p_ops.store_16b = obj_norep_store_16b;
+
+		if (repset->is_pmem && pmem_has_store_8b_nt())
+			rep->p_ops.store_8b_nt =
+				obj_norep_store_8b_nt;
+	}
+}
+
 /*
  * obj_replica_init -- (internal) initialize runtime part of the replica
  */
@@ -848,21 +1293,8 @@ obj_replica_init(PMEMobjpool *rep, struct pool_set *set, unsigned repidx)
 		/* master replica */
 		rep->is_master_replica = 1;
 
-		if (set->nreplicas > 1) {
-			rep->p_ops.persist = obj_rep_persist;
-			rep->p_ops.flush = obj_rep_flush;
-			rep->p_ops.drain = obj_rep_drain;
-			rep->p_ops.memcpy = obj_rep_memcpy;
-			rep->p_ops.memmove = obj_rep_memmove;
-			rep->p_ops.memset = obj_rep_memset;
-		} else {
-			rep->p_ops.persist = obj_norep_persist;
-			rep->p_ops.flush = obj_norep_flush;
-			rep->p_ops.drain = obj_norep_drain;
-			rep->p_ops.memcpy = obj_norep_memcpy;
-			rep->p_ops.memmove = obj_norep_memmove;
-			rep->p_ops.memset = obj_norep_memset;
-		}
+		obj_master_ops_init(rep, set);
+
 		rep->p_ops.base = rep;
 	} else {
 		/* non-master replicas */
@@ -874,6 +1306,9 @@ obj_replica_init(PMEMobjpool *rep, struct pool_set *set, unsigned repidx)
 		rep->p_ops.memcpy = NULL;
 		rep->p_ops.memmove = NULL;
 		rep->p_ops.memset = NULL;
+		rep->p_ops.store_line = NULL;
+		rep->p_ops.store_16b = NULL;
+		rep->p_ops.store_8b_nt = NULL;
 
 		rep->p_ops.base = NULL;
 	}
@@ -922,6 +1357,7 @@ obj_runtime_init(PMEMobjpool *pop, int rdonly, int boot, unsigned nlanes)
 	pop->rdonly = rdonly;
 
 	pop->uuid_lo = pmemobj_get_uuid_lo(pop);
+	pop->feat_compat = pop->hdr.features.compat;
 
 	pop->lanes_desc.runtime_nlanes = nlanes;
 
@@ -934,6 +1370,22 @@ obj_runtime_init(PMEMobjpool *pop, int rdonly, int boot, unsigned nlanes)
 		goto err_stat;
 
 	pop->user_data = NULL;
+	pop->root_desc = NULL;
+	pop->shadow = NULL;
+	pop->warmup = NULL;
+	pop->audit = NULL;
+
+	/*
+	 * A stored base address hint heals itself: whenever the pool lands
+	 * at a different address the hint is refreshed, so that the next
+	 * open tries the current base.
+	 */
+	if (pop->mapping_hint != 0 &&
+	    pop->mapping_hint != (uint64_t)(uintptr_t)pop->addr) {
+		pop->mapping_hint = (uint64_t)(uintptr_t)pop->addr;
+		pmemops_persist(p_ops, &pop->mapping_hint,
+			sizeof(pop->mapping_hint));
+	}
 
 	VALGRIND_REMOVE_PMEM_MAPPING(&pop->mutex_head,
 		sizeof(pop->mutex_head));
@@ -949,6 +1401,21 @@ obj_runtime_init(PMEMobjpool *pop, int rdonly, int boot, unsigned nlanes)
 		if ((errno = obj_runtime_init_common(pop)) != 0)
 			goto err_boot;
 
+		if (obj_audit_boot(pop) != 0) {
+			errno = ENOMEM;
+			goto err_critnib_insert;
+		}
+
+		if (obj_scrub_boot(pop) != 0) {
+			errno = ENOMEM;
+			goto err_critnib_insert;
+		}
+
+		if (obj_oid32_boot(pop) != 0) {
+			errno = ENOMEM;
+			goto err_critnib_insert;
+		}
+
 #if VG_MEMCHECK_ENABLED
 		if (On_memcheck) {
 			/* mark unused part of the pool as not accessible */
@@ -1174,9 +1641,9 @@ pmemobj_create(const char *path, const char *layout,
  *                              of a local replica
  */
 static int
-obj_check_basic_local(PMEMobjpool *pop, size_t mapped_size)
+obj_check_basic_local(PMEMobjpool *pop, size_t mapped_size, int quick)
 {
-	LOG(3, "pop %p mapped_size %zu", pop, mapped_size);
+	LOG(3, "pop %p mapped_size %zu quick %d", pop, mapped_size, quick);
 
 	int consistent = 1;
 
@@ -1192,8 +1659,11 @@ obj_check_basic_local(PMEMobjpool *pop, size_t mapped_size)
 
 	/* pop->heap_size can still be 0 at this point */
 	size_t heap_size = mapped_size - pop->heap_offset;
-	errno = palloc_heap_check((char *)pop + pop->heap_offset,
-		heap_size);
+	errno = quick ?
+		palloc_heap_check_quick((char *)pop + pop->heap_offset,
+			heap_size) :
+		palloc_heap_check((char *)pop + pop->heap_offset,
+			heap_size);
 	if (errno != 0) {
 		CORE_LOG_ERROR_W_ERRNO("heap_check");
 		consistent = 0;
@@ -1212,7 +1682,7 @@ obj_check_basic(PMEMobjpool *pop, size_t mapped_size)
 {
 	LOG(3, "pop %p mapped_size %zu", pop, mapped_size);
 
-	return obj_check_basic_local(pop, mapped_size);
+	return obj_check_basic_local(pop, mapped_size, 0);
 }
 
 /*
@@ -1226,6 +1696,30 @@ obj_pool_close(struct pool_set *set)
 	errno = oerrno;
 }
 
+/*
+ * obj_mapping_hint_read -- (internal) reads the stored base address hint
+ *	from the pool descriptor of a not-yet-mapped pool
+ *
+ * Only single-file pools are handled - for a poolset file the descriptor
+ * location would have to be resolved by parsing the set, at which point the
+ * mapping is already being set up. Any read failure simply means no hint;
+ * a bogus value is rejected by the mapping fallback.
+ */
+static void *
+obj_mapping_hint_read(const char *path)
+{
+	if (util_is_poolset_file(path) != 0)
+		return NULL;
+
+	uint64_t hint = 0;
+	if (util_file_pread(path, &hint, sizeof(hint),
+	    (os_off_t)offsetof(struct pmemobjpool, mapping_hint)) !=
+	    (ssize_t)sizeof(hint))
+		return NULL;
+
+	return (void *)hint;
+}
+
 /*
  * obj_pool_open -- (internal) open the given pool
  */
@@ -1234,7 +1728,8 @@ obj_pool_open(struct pool_set **set, const char *path, unsigned flags,
 	unsigned *nlanes)
 {
 	if (util_pool_open(set, path, PMEMOBJ_MIN_PART, &Obj_open_attr,
-				nlanes, NULL, flags) != 0) {
+				nlanes, obj_mapping_hint_read(path),
+				flags) != 0) {
 		CORE_LOG_ERROR("cannot open pool or pool set");
 		return -1;
 	}
@@ -1498,6 +1993,47 @@ obj_pool_lock_cleanup(PMEMobjpool *pop)
 	}
 	pop->cond_head = NULL;
 }
+/*
+ * obj_root_desc_publish -- (internal) publishes the current root descriptor
+ *	for the lock-free readers, must be called under rootlock
+ */
+static void
+obj_root_desc_publish(PMEMobjpool *pop)
+{
+	struct obj_root_desc *cur = pop->root_desc;
+
+	if (cur != NULL && cur->off == pop->root_offset &&
+	    cur->size == pop->root_size)
+		return;
+
+	struct obj_root_desc *desc = Malloc(sizeof(*desc));
+	if (desc == NULL)
+		return; /* readers simply keep falling back to rootlock */
+
+	desc->off = pop->root_offset;
+	desc->size = pop->root_size;
+	desc->prev = cur;
+
+	util_atomic_store_explicit64(&pop->root_desc, desc,
+		memory_order_release);
+}
+
+/*
+ * obj_root_desc_delete -- (internal) frees all published root descriptors
+ */
+static void
+obj_root_desc_delete(PMEMobjpool *pop)
+{
+	struct obj_root_desc *desc = pop->root_desc;
+	pop->root_desc = NULL;
+
+	while (desc != NULL) {
+		struct obj_root_desc *prev = desc->prev;
+		Free(desc);
+		desc = prev;
+	}
+}
+
 /*
  * obj_pool_cleanup -- (internal) cleanup the pool and unmap
  */
@@ -1512,9 +2048,16 @@ obj_pool_cleanup(PMEMobjpool *pop)
 	stats_delete(pop, pop->stats);
 	tx_params_delete(pop->tx_params);
 	ctl_delete(pop->ctl);
+	obj_root_desc_delete(pop);
 
 	obj_pool_lock_cleanup(pop);
 
+	obj_warmup_cleanup(pop);
+	obj_shadow_disable(pop);
+	heap_maintenance_cleanup(&pop->heap);
+	obj_audit_cleanup(pop);
+	obj_scrub_cleanup(pop);
+	obj_oid32_cleanup(pop);
 	lane_section_cleanup(pop);
 	lane_cleanup(pop);
 
@@ -1545,6 +2088,11 @@ pmemobj_close(PMEMobjpool *pop)
 		_pobj_cached_pool.uuid_lo = 0;
 	}
 
+	if (_pobj_sole_pool.pop == pop) {
+		_pobj_sole_pool.uuid_lo = 0;
+		_pobj_sole_pool.pop = NULL;
+	}
+
 	VALGRIND_HG_DRD_DISABLE_CHECKING(&_pobj_cache_invalidate,
 		sizeof(_pobj_cache_invalidate));
 	_pobj_cache_invalidate++;
@@ -1555,13 +2103,16 @@ pmemobj_close(PMEMobjpool *pop)
 }
 
 /*
- * pmemobj_checkU -- transactional memory pool consistency check
+ * obj_check_common -- (internal) transactional memory pool consistency check
+ *
+ * In the quick mode only the metadata checksums, the heap headers and the
+ * lane logs are verified - the chunk walk and the runtime boot, which
+ * dominate the cost on large pools, are skipped.
  */
-static inline
-int
-pmemobj_checkU(const char *path, const char *layout)
+static int
+obj_check_common(const char *path, const char *layout, int quick)
 {
-	LOG(3, "path %s layout %s", path, layout);
+	LOG(3, "path %s layout %s quick %d", path, layout, quick);
 
 	PMEMobjpool *pop = obj_open_common(path, layout, POOL_OPEN_COW, 0);
 	if (pop == NULL)
@@ -1574,14 +2125,16 @@ pmemobj_checkU(const char *path, const char *layout)
 	 * in obj_open_common().
 	 */
 	if (pop->replica == NULL)
-		consistent = obj_check_basic(pop, pop->set->poolsize);
+		consistent = obj_check_basic_local(pop, pop->set->poolsize,
+			quick);
 
-	if (consistent && (errno = obj_runtime_init_common(pop)) != 0) {
+	if (!quick && consistent &&
+	    (errno = obj_runtime_init_common(pop)) != 0) {
 		LOG(3, "!obj_boot");
 		consistent = 0;
 	}
 
-	if (consistent) {
+	if (!quick && consistent) {
 		obj_pool_cleanup(pop);
 	} else {
 		stats_delete(pop, pop->stats);
@@ -1606,22 +2159,190 @@ pmemobj_check(const char *path, const char *layout)
 {
 	PMEMOBJ_API_START();
 
-	int ret = pmemobj_checkU(path, layout);
+	int ret = obj_check_common(path, layout, 0);
 
 	PMEMOBJ_API_END();
 	return ret;
 }
 
 /*
- * pmemobj_pool_by_oid -- returns the pool handle associated with the oid
+ * pmemobj_check_quick -- fast memory pool consistency check, verifying only
+ * the metadata checksums and the lane consistency
  */
-PMEMobjpool *
-pmemobj_pool_by_oid(PMEMoid oid)
+int
+pmemobj_check_quick(const char *path, const char *layout)
 {
-	LOG(3, "oid.off 0x%016" PRIx64, oid.off);
+	PMEMOBJ_API_START();
 
-	/* XXX this is a temporary fix, to be fixed properly later */
-	if (pools_ht == NULL)
+	int ret = obj_check_common(path, layout, 1);
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * obj_probe_pread -- (internal) reads from a pool file without taking the
+ *	pool file lock
+ *
+ * util_file_pread() opens regular files through util_file_open(), which
+ * takes the exclusive file lock - a probe must neither fail nor interfere
+ * just because the pool is open in some process, so regular files are read
+ * through a plain descriptor here.
+ */
+static ssize_t
+obj_probe_pread(const char *path, void *buf, size_t size, os_off_t offset)
+{
+	enum file_type type = util_file_get_type(path);
+	if (type < 0)
+		return -1;
+
+	if (type != TYPE_NORMAL)
+		return util_file_pread(path, buf, size, offset);
+
+	int fd = os_open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	ssize_t read_len = pread(fd, buf, size, offset);
+	int olderrno = errno;
+	(void) os_close(fd);
+	errno = olderrno;
+
+	return read_len;
+}
+
+/*
+ * obj_probe_file -- (internal) validates the pool header and descriptor of
+ *	a single pool file, reading only those two pages
+ */
+static int
+obj_probe_file(const char *path, struct pmemobj_probe_info *info)
+{
+	struct pool_hdr hdr;
+	if (obj_probe_pread(path, &hdr, sizeof(hdr), 0) !=
+	    (ssize_t)sizeof(hdr)) {
+		ERR_WO_ERRNO("cannot read the pool header of %s", path);
+		errno = EINVAL;
+		return -1;
+	}
+
+	util_convert2h_hdr_nocheck(&hdr);
+
+	if (memcmp(hdr.signature, OBJ_HDR_SIG, POOL_HDR_SIG_LEN) != 0) {
+		ERR_WO_ERRNO("wrong pool type: \"%.8s\"", hdr.signature);
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (hdr.major != OBJ_FORMAT_MAJOR) {
+		ERR_WO_ERRNO("pool version %d (library expects %d)",
+			hdr.major, OBJ_FORMAT_MAJOR);
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (util_feature_check(&hdr, obj_format_feat_default) < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!util_checksum(&hdr, sizeof(hdr), &hdr.checksum, 0,
+	    POOL_HDR_CSUM_END_OFF(&hdr))) {
+		ERR_WO_ERRNO("invalid checksum of pool header");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (util_check_arch_flags(&hdr.arch_flags)) {
+		ERR_WO_ERRNO("wrong architecture flags");
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* the persistent descriptor sits right behind the header */
+	char dsc[OBJ_DSC_P_SIZE];
+	if (obj_probe_pread(path, dsc, sizeof(dsc),
+	    (os_off_t)sizeof(struct pool_hdr)) != (ssize_t)sizeof(dsc)) {
+		ERR_WO_ERRNO("cannot read the pool descriptor of %s", path);
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* the checksum is the last field of the persistent descriptor */
+	uint64_t *csump = (uint64_t *)
+		(dsc + OBJ_DSC_P_SIZE - sizeof(uint64_t));
+	if (!util_checksum(dsc, OBJ_DSC_P_SIZE, csump, 0, 0)) {
+		ERR_WO_ERRNO("invalid checksum of pool descriptor");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (info != NULL) {
+		/* the layout name is the first descriptor field */
+		memcpy(info->layout, dsc, PMEMOBJ_MAX_LAYOUT);
+		info->layout[PMEMOBJ_MAX_LAYOUT - 1] = '\0';
+		info->major = hdr.major;
+		info->compat_features = hdr.features.compat;
+		info->incompat_features = hdr.features.incompat;
+		info->ro_compat_features = hdr.features.ro_compat;
+		info->created = hdr.crtime;
+	}
+
+	return 0;
+}
+
+/*
+ * pmemobj_probe -- checks whether a file or poolset holds a compatible obj
+ *	pool, reading only the pool header and descriptor
+ */
+int
+pmemobj_probe(const char *path, struct pmemobj_probe_info *info)
+{
+	LOG(3, "path %s info %p", path, info);
+	PMEMOBJ_API_START();
+
+	int ret;
+
+	if (util_is_poolset_file(path) == 1) {
+		/*
+		 * The attributes probed for live in the first part of the
+		 * first replica - the set file is parsed only to find it.
+		 */
+		int fd = os_open(path, O_RDONLY);
+		if (fd < 0) {
+			ERR_W_ERRNO("os_open %s", path);
+			PMEMOBJ_API_END();
+			return -1;
+		}
+
+		struct pool_set *set;
+		if (util_poolset_parse(&set, path, fd) != 0) {
+			(void) os_close(fd);
+			PMEMOBJ_API_END();
+			return -1;
+		}
+		(void) os_close(fd);
+
+		ret = obj_probe_file(set->replica[0]->part[0].path, info);
+		util_poolset_free(set);
+	} else {
+		ret = obj_probe_file(path, info);
+	}
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * pmemobj_pool_by_oid -- returns the pool handle associated with the oid
+ */
+PMEMobjpool *
+pmemobj_pool_by_oid(PMEMoid oid)
+{
+	LOG(3, "oid.off 0x%016" PRIx64, oid.off);
+
+	/* XXX this is a temporary fix, to be fixed properly later */
+	if (pools_ht == NULL)
 		return NULL;
 
 	return critnib_get(pools_ht, oid.pool_uuid_lo);
@@ -1680,971 +2401,3660 @@ pmemobj_get_user_data(PMEMobjpool *pop)
 	return pop->user_data;
 }
 
-/* arguments for constructor_alloc */
-struct constr_args {
-	int zero_init;
-	pmemobj_constr constructor;
-	void *arg;
-};
-
 /*
- * constructor_alloc -- (internal) constructor for obj_alloc_construct
+ * pmemobj_replica_attach -- routes every store through a user transport, in
+ * addition to the local replicas
  */
-static int
-constructor_alloc(void *ctx, void *ptr, size_t usable_size, void *arg)
+int
+pmemobj_replica_attach(PMEMobjpool *pop, const struct pobj_replica_ops *ops,
+	void *ctx)
 {
-	PMEMobjpool *pop = ctx;
-	LOG(3, "pop %p ptr %p arg %p", pop, ptr, arg);
-	struct pmem_ops *p_ops = &pop->p_ops;
+	LOG(3, "pop %p ops %p ctx %p", pop, ops, ctx);
 
-	ASSERTne(ptr, NULL);
-	ASSERTne(arg, NULL);
+	if (ops == NULL || ops->write == NULL || ops->drain == NULL) {
+		ERR_WO_ERRNO("both write and drain callbacks are required");
+		errno = EINVAL;
+		return -1;
+	}
 
-	struct constr_args *carg = arg;
+	if (pop->replica_ops != NULL) {
+		ERR_WO_ERRNO("a replica transport is already attached");
+		errno = EEXIST;
+		return -1;
+	}
 
-	if (carg->zero_init)
-		pmemops_memset(p_ops, ptr, 0, usable_size, 0);
+	pop->replica_ctx = ctx;
+	pop->replica_ops = ops;
 
-	int ret = 0;
-	if (carg->constructor)
-		ret = carg->constructor(pop, ptr, carg->arg);
+	obj_master_ops_init(pop, pop->set);
 
-	return ret;
+	/* the heap keeps its own copy of the store dispatch */
+	pop->heap.p_ops = pop->p_ops;
+
+	return 0;
 }
 
 /*
- * obj_alloc_construct -- (internal) allocates a new object with constructor
+ * pmemobj_replica_detach -- detaches the user transport and restores the
+ * direct store dispatch
  */
-static int
-obj_alloc_construct(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
-	type_num_t type_num, uint64_t flags,
-	pmemobj_constr constructor, void *arg)
+void
+pmemobj_replica_detach(PMEMobjpool *pop)
 {
-	if (size > PMEMOBJ_MAX_ALLOC_SIZE) {
-		ERR_WO_ERRNO("requested size too large");
-		errno = ENOMEM;
-		return -1;
-	}
-
-	struct constr_args carg;
+	LOG(3, "pop %p", pop);
 
-	carg.zero_init = flags & POBJ_FLAG_ZERO;
-	carg.constructor = constructor;
-	carg.arg = arg;
+	pop->replica_ops = NULL;
+	pop->replica_ctx = NULL;
 
-	struct operation_context *ctx = pmalloc_operation_hold(pop);
+	obj_master_ops_init(pop, pop->set);
 
-	if (oidp)
-		operation_add_entry(ctx, &oidp->pool_uuid_lo, pop->uuid_lo,
-				ULOG_OPERATION_SET);
+	pop->heap.p_ops = pop->p_ops;
+}
 
-	int ret = palloc_operation(&pop->heap, 0,
-			oidp != NULL ? &oidp->off : NULL, size,
-			constructor_alloc, &carg, type_num, 0,
-			CLASS_ID_FROM_FLAG(flags), ARENA_ID_FROM_FLAG(flags),
-			ctx);
+/*
+ * The DRAM shadow is a volatile, write-through mirror of the pool kept at
+ * the same offsets, so a shadowed object lives at base + oid.off. It is
+ * maintained through the replica transport: every range the library writes
+ * to the master replica is also copied into the mapping, with the same
+ * coalescing as the local stores. The mapping is anonymous and
+ * MAP_NORESERVE, so DRAM is consumed only for pages that actually get
+ * written (or hold live objects copied when the shadow is enabled).
+ */
+struct obj_shadow {
+	void *base;
+	size_t size;
+};
 
-	pmalloc_operation_release(pop);
+/*
+ * obj_shadow_write -- (internal) replica transport write callback of the
+ *	shadow, mirrors the range into DRAM
+ */
+static void
+obj_shadow_write(void *ctx, size_t offset, const void *data, size_t len)
+{
+	struct obj_shadow *s = ctx;
 
-	return ret;
+	memcpy((char *)s->base + offset, data, len);
 }
 
 /*
- * pmemobj_alloc -- allocates a new object
+ * obj_shadow_drain -- (internal) replica transport drain callback of the
+ *	shadow, a no-op since DRAM stores need no completion barrier
  */
-int
-pmemobj_alloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
-	uint64_t type_num, pmemobj_constr constructor, void *arg)
+static void
+obj_shadow_drain(void *ctx)
 {
-	LOG(3, "pop %p oidp %p size %zu type_num %llx constructor %p arg %p",
-		pop, oidp, size, (unsigned long long)type_num,
-		constructor, arg);
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(ctx);
+}
 
-	/* log notice message if used inside a transaction */
-	_POBJ_DEBUG_NOTICE_IN_TX();
+static const struct pobj_replica_ops obj_shadow_replica_ops = {
+	.write = obj_shadow_write,
+	.drain = obj_shadow_drain,
+};
 
-	if (size == 0) {
-		ERR_WO_ERRNO("allocation with size 0");
-		errno = EINVAL;
-		return -1;
-	}
+/*
+ * obj_shadow_copy_object -- (internal) copies one live object into the
+ *	shadow mapping
+ */
+static int
+obj_shadow_copy_object(uint64_t off, void *arg)
+{
+	PMEMobjpool *pop = arg;
+	struct obj_shadow *s = pop->shadow;
 
-	PMEMOBJ_API_START();
-	int ret = obj_alloc_construct(pop, oidp, size, type_num,
-			0, constructor, arg);
+	size_t size = palloc_usable_size(&pop->heap, off);
+	memcpy((char *)s->base + off, (char *)pop + off, size);
 
-	PMEMOBJ_API_END();
-	return ret;
+	return 0;
 }
 
 /*
- * pmemobj_xalloc -- allocates with flags
+ * obj_shadow_enable -- (internal) maps the shadow, copies the live objects
+ *	into it and attaches the mirroring transport
+ *
+ * May only be called when no other thread operates on the pool, like
+ * pmemobj_replica_attach.
  */
-int
-pmemobj_xalloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
-	uint64_t type_num, uint64_t flags,
-	pmemobj_constr constructor, void *arg)
+static int
+obj_shadow_enable(PMEMobjpool *pop)
 {
-	LOG(3, "pop %p oidp %p size %zu type_num %llx flags %llx "
-		"constructor %p arg %p",
-		pop, oidp, size, (unsigned long long)type_num,
-		(unsigned long long)flags,
-		constructor, arg);
-
-	/* log notice message if used inside a transaction */
-	_POBJ_DEBUG_NOTICE_IN_TX();
+	if (pop->shadow != NULL)
+		return 0;
 
-	if (size == 0) {
-		ERR_WO_ERRNO("allocation with size 0");
-		errno = EINVAL;
+	if (pop->replica_ops != NULL) {
+		ERR_WO_ERRNO("a replica transport is already attached");
+		errno = EEXIST;
 		return -1;
 	}
 
-	if (flags & ~POBJ_TX_XALLOC_VALID_FLAGS) {
-		ERR_WO_ERRNO("unknown flags 0x%" PRIx64,
-				flags & ~POBJ_TX_XALLOC_VALID_FLAGS);
-		errno = EINVAL;
+	struct obj_shadow *s = Malloc(sizeof(*s));
+	if (s == NULL)
+		return -1;
+
+	s->size = pop->set->poolsize;
+	s->base = mmap(NULL, s->size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (s->base == MAP_FAILED) {
+		ERR_W_ERRNO("mmap shadow");
+		Free(s);
 		return -1;
 	}
 
-	PMEMOBJ_API_START();
-	int ret = obj_alloc_construct(pop, oidp, size, type_num,
-			flags, constructor, arg);
+	pop->shadow = s;
 
-	PMEMOBJ_API_END();
-	return ret;
-}
+	/* seed the mirror before any new store can reach it */
+	palloc_foreach(&pop->heap, obj_shadow_copy_object, pop);
 
-/* arguments for constructor_realloc and constructor_zrealloc */
-struct carg_realloc {
-	void *ptr;
-	size_t old_size;
-	size_t new_size;
-	int zero_init;
-	type_num_t user_type;
-	pmemobj_constr constructor;
-	void *arg;
-};
+	pop->replica_ctx = s;
+	pop->replica_ops = &obj_shadow_replica_ops;
+
+	obj_master_ops_init(pop, pop->set);
+	pop->heap.p_ops = pop->p_ops;
+
+	return 0;
+}
 
 /*
- * pmemobj_zalloc -- allocates a new zeroed object
+ * obj_shadow_disable -- (internal) detaches the mirroring transport and
+ *	unmaps the shadow, under the same quiescence requirement
  */
-int
-pmemobj_zalloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
-		uint64_t type_num)
+static void
+obj_shadow_disable(PMEMobjpool *pop)
 {
-	LOG(3, "pop %p oidp %p size %zu type_num %llx",
-			pop, oidp, size, (unsigned long long)type_num);
-
-	/* log notice message if used inside a transaction */
-	_POBJ_DEBUG_NOTICE_IN_TX();
-
-	if (size == 0) {
-		ERR_WO_ERRNO("allocation with size 0");
-		errno = EINVAL;
-		return -1;
-	}
+	struct obj_shadow *s = pop->shadow;
+	if (s == NULL)
+		return;
 
-	PMEMOBJ_API_START();
-	int ret = obj_alloc_construct(pop, oidp, size, type_num, POBJ_FLAG_ZERO,
-		NULL, NULL);
+	if (pop->replica_ops == &obj_shadow_replica_ops)
+		pmemobj_replica_detach(pop);
 
-	PMEMOBJ_API_END();
-	return ret;
+	pop->shadow = NULL;
+	munmap(s->base, s->size);
+	Free(s);
 }
 
 /*
- * obj_free -- (internal) free an object
+ * pmemobj_direct_shadow -- translates an oid into a pointer to the DRAM
+ *	mirror of the object, or into the regular direct pointer when the
+ *	pool has no shadow
  */
-static void
-obj_free(PMEMobjpool *pop, PMEMoid *oidp)
+void *
+pmemobj_direct_shadow(PMEMoid oid)
 {
-	ASSERTne(oidp, NULL);
-
-	struct operation_context *ctx = pmalloc_operation_hold(pop);
+	if (oid.off == 0 || oid.pool_uuid_lo == 0)
+		return NULL;
 
-	operation_add_entry(ctx, &oidp->pool_uuid_lo, 0, ULOG_OPERATION_SET);
+	PMEMobjpool *pop = pmemobj_pool_by_oid(oid);
+	if (pop == NULL)
+		return NULL;
 
-	palloc_operation(&pop->heap, oidp->off, &oidp->off, 0, NULL, NULL,
-			0, 0, 0, 0, ctx);
+	struct obj_shadow *s = pop->shadow;
+	if (s == NULL)
+		return (char *)pop + oid.off;
 
-	pmalloc_operation_release(pop);
+	return (char *)s->base + oid.off;
 }
 
 /*
- * constructor_realloc -- (internal) constructor for pmemobj_realloc
+ * CTL_READ_HANDLER(enabled, shadow) -- returns whether the pool has an
+ *	active DRAM shadow
  */
 static int
-constructor_realloc(void *ctx, void *ptr, size_t usable_size, void *arg)
+CTL_READ_HANDLER(enabled, shadow)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
 {
-	PMEMobjpool *pop = ctx;
-	LOG(3, "pop %p ptr %p arg %p", pop, ptr, arg);
-	struct pmem_ops *p_ops = &pop->p_ops;
-
-	ASSERTne(ptr, NULL);
-	ASSERTne(arg, NULL);
-
-	struct carg_realloc *carg = arg;
-
-	if (!carg->zero_init)
-		return 0;
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
 
-	if (usable_size > carg->old_size) {
-		size_t grow_len = usable_size - carg->old_size;
-		void *new_data_ptr = (void *)((uintptr_t)ptr + carg->old_size);
+	PMEMobjpool *pop = ctx;
+	int *arg_out = arg;
 
-		pmemops_memset(p_ops, new_data_ptr, 0, grow_len, 0);
-	}
+	*arg_out = pop->shadow != NULL;
 
 	return 0;
 }
 
 /*
- * obj_realloc_common -- (internal) common routine for resizing
- *                          existing objects
+ * CTL_WRITE_HANDLER(enabled, shadow) -- enables or disables the DRAM shadow
  */
 static int
-obj_realloc_common(PMEMobjpool *pop,
-	PMEMoid *oidp, size_t size, type_num_t type_num, int zero_init)
+CTL_WRITE_HANDLER(enabled, shadow)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
 {
-	/* if OID is NULL just allocate memory */
-	if (OBJ_OID_IS_NULL(*oidp)) {
-		/* if size is 0 - do nothing */
-		if (size == 0)
-			return 0;
-
-		return obj_alloc_construct(pop, oidp, size, type_num,
-				POBJ_FLAG_ZERO, NULL, NULL);
-	}
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
 
-	if (size > PMEMOBJ_MAX_ALLOC_SIZE) {
-		ERR_WO_ERRNO("requested size too large");
-		errno = ENOMEM;
-		return -1;
-	}
+	PMEMobjpool *pop = ctx;
+	int arg_in = *(int *)arg;
 
-	/* if size is 0 just free */
-	if (size == 0) {
-		obj_free(pop, oidp);
+	if (arg_in) {
+		return obj_shadow_enable(pop);
+	} else {
+		obj_shadow_disable(pop);
 		return 0;
 	}
+}
 
-	struct carg_realloc carg;
-	carg.ptr = OBJ_OFF_TO_PTR(pop, oidp->off);
-	carg.new_size = size;
-	carg.old_size = pmemobj_alloc_usable_size(*oidp);
-	carg.user_type = type_num;
-	carg.constructor = NULL;
-	carg.arg = NULL;
-	carg.zero_init = zero_init;
-
-	struct operation_context *ctx = pmalloc_operation_hold(pop);
+static const struct ctl_argument CTL_ARG(enabled) = CTL_ARG_BOOLEAN;
 
-	int ret = palloc_operation(&pop->heap, oidp->off, &oidp->off,
-			size, constructor_realloc, &carg, type_num,
-			0, 0, 0, ctx);
+static const struct ctl_node CTL_NODE(shadow)[] = {
+	CTL_LEAF_RW(enabled, shadow),
 
-	pmalloc_operation_release(pop);
+	CTL_NODE_END
+};
 
-	return ret;
+/*
+ * obj_shadow_ctl_register -- (internal) registers ctl nodes for the
+ *	"shadow" module
+ */
+static void
+obj_shadow_ctl_register(PMEMobjpool *pop)
+{
+	CTL_REGISTER_MODULE(pop->ctl, shadow);
 }
 
 /*
- * constructor_zrealloc_root -- (internal) constructor for pmemobj_root
+ * CTL_READ_HANDLER(enabled, base_hint) -- returns whether the pool has a
+ *	stored base address hint
  */
 static int
-constructor_zrealloc_root(void *ctx, void *ptr, size_t usable_size, void *arg)
+CTL_READ_HANDLER(enabled, base_hint)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
 {
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
 	PMEMobjpool *pop = ctx;
-	LOG(3, "pop %p ptr %p arg %p", pop, ptr, arg);
+	int *arg_out = arg;
 
-	ASSERTne(ptr, NULL);
-	ASSERTne(arg, NULL);
+	*arg_out = pop->mapping_hint != 0;
 
-	VALGRIND_ADD_TO_TX(ptr, usable_size);
+	return 0;
+}
 
-	struct carg_realloc *carg = arg;
+/*
+ * CTL_WRITE_HANDLER(enabled, base_hint) -- stores the current base address
+ *	of the pool as the mapping hint for the next open, or clears it
+ */
+static int
+CTL_WRITE_HANDLER(enabled, base_hint)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
 
-	constructor_realloc(pop, ptr, usable_size, arg);
-	int ret = 0;
-	if (carg->constructor)
-		ret = carg->constructor(pop, ptr, carg->arg);
+	PMEMobjpool *pop = ctx;
+	int arg_in = *(int *)arg;
 
-	VALGRIND_REMOVE_FROM_TX(ptr, usable_size);
+	pop->mapping_hint = arg_in ? (uint64_t)(uintptr_t)pop->addr : 0;
+	pmemops_persist(&pop->p_ops, &pop->mapping_hint,
+		sizeof(pop->mapping_hint));
 
-	return ret;
+	return 0;
 }
 
+static const struct ctl_node CTL_NODE(base_hint)[] = {
+	CTL_LEAF_RW(enabled, base_hint),
+
+	CTL_NODE_END
+};
+
 /*
- * pmemobj_realloc -- resizes an existing object
+ * obj_base_hint_ctl_register -- (internal) registers ctl nodes for the
+ *	"base_hint" module
  */
-int
-pmemobj_realloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
-		uint64_t type_num)
+static void
+obj_base_hint_ctl_register(PMEMobjpool *pop)
 {
-	ASSERTne(oidp, NULL);
+	CTL_REGISTER_MODULE(pop->ctl, base_hint);
+}
 
-	LOG(3, "pop %p oid.off 0x%016" PRIx64 " size %zu type_num %" PRIu64,
-		pop, oidp->off, size, type_num);
+/*
+ * CTL_READ_HANDLER(memcpy_impl, pmem) -- returns the name of the
+ *	memcpy/memset kernel family the process dispatched to
+ */
+static int
+CTL_READ_HANDLER(memcpy_impl, pmem)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(ctx, source, indexes);
 
-	PMEMOBJ_API_START();
-	/* log notice message if used inside a transaction */
-	_POBJ_DEBUG_NOTICE_IN_TX();
-	ASSERT(OBJ_OID_IS_VALID(pop, *oidp));
+	const char **arg_out = arg;
 
-	int ret = obj_realloc_common(pop, oidp, size, (type_num_t)type_num, 0);
+	*arg_out = pmem_memcpy_impl();
 
-	PMEMOBJ_API_END();
-	return ret;
+	return 0;
 }
 
 /*
- * pmemobj_zrealloc -- resizes an existing object, any new space is zeroed.
+ * CTL_READ_HANDLER(flush_impl, pmem) -- returns the name of the cache
+ *	flush instruction the process dispatched to
  */
-int
-pmemobj_zrealloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
-		uint64_t type_num)
+static int
+CTL_READ_HANDLER(flush_impl, pmem)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
 {
-	ASSERTne(oidp, NULL);
-
-	LOG(3, "pop %p oid.off 0x%016" PRIx64 " size %zu type_num %" PRIu64,
-		pop, oidp->off, size, type_num);
-
-	PMEMOBJ_API_START();
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(ctx, source, indexes);
 
-	/* log notice message if used inside a transaction */
-	_POBJ_DEBUG_NOTICE_IN_TX();
-	ASSERT(OBJ_OID_IS_VALID(pop, *oidp));
+	const char **arg_out = arg;
 
-	int ret = obj_realloc_common(pop, oidp, size, (type_num_t)type_num, 1);
+	*arg_out = pmem_flush_impl();
 
-	PMEMOBJ_API_END();
-	return ret;
+	return 0;
 }
 
-/* arguments for constructor_strdup */
-struct carg_strdup {
-	size_t size;
-	const char *s;
-};
-
 /*
- * constructor_strdup -- (internal) constructor of pmemobj_strdup
+ * CTL_READ_HANDLER(movnt_threshold, pmem) -- returns the copy size from
+ *	which the memory operations switch to non-temporal stores
  */
 static int
-constructor_strdup(PMEMobjpool *pop, void *ptr, void *arg)
+CTL_READ_HANDLER(movnt_threshold, pmem)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
 {
-	LOG(3, "pop %p ptr %p arg %p", pop, ptr, arg);
-
-	ASSERTne(ptr, NULL);
-	ASSERTne(arg, NULL);
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(ctx, source, indexes);
 
-	struct carg_strdup *carg = arg;
+	long long *arg_out = arg;
 
-	/* copy string */
-	pmemops_memcpy(&pop->p_ops, ptr, carg->s, carg->size, 0);
+	*arg_out = (long long)pmem_movnt_threshold();
 
 	return 0;
 }
 
 /*
- * pmemobj_strdup -- allocates a new object with duplicate of the string s.
+ * CTL_WRITE_HANDLER(movnt_threshold, pmem) -- overrides the non-temporal
+ *	store threshold (process-global, like the kernel dispatch itself)
  */
-int
-pmemobj_strdup(PMEMobjpool *pop, PMEMoid *oidp, const char *s,
-		uint64_t type_num)
+static int
+CTL_WRITE_HANDLER(movnt_threshold, pmem)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
 {
-	LOG(3, "pop %p oidp %p string %s type_num %" PRIu64,
-	    pop, oidp, s, type_num);
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(ctx, source, indexes);
 
-	/* log notice message if used inside a transaction */
-	_POBJ_DEBUG_NOTICE_IN_TX();
+	long long arg_in = *(long long *)arg;
 
-	if (NULL == s) {
+	if (arg_in < 0) {
 		errno = EINVAL;
 		return -1;
 	}
 
-	PMEMOBJ_API_START();
-	struct carg_strdup carg;
-	carg.size = (strlen(s) + 1) * sizeof(char);
-	carg.s = s;
-
-	int ret = obj_alloc_construct(pop, oidp, carg.size,
-		(type_num_t)type_num, 0, constructor_strdup, &carg);
+	pmem_movnt_threshold_set((size_t)arg_in);
 
-	PMEMOBJ_API_END();
-	return ret;
+	return 0;
 }
 
-/* arguments for constructor_wcsdup */
-struct carg_wcsdup {
-	size_t size;
-	const wchar_t *s;
+static const struct ctl_argument CTL_ARG(movnt_threshold) = CTL_ARG_LONG_LONG;
+
+static const struct ctl_node CTL_NODE(pmem)[] = {
+	CTL_LEAF_RO(memcpy_impl, pmem),
+	CTL_LEAF_RO(flush_impl, pmem),
+	CTL_LEAF_RW(movnt_threshold, pmem),
+
+	CTL_NODE_END
 };
 
 /*
- * constructor_wcsdup -- (internal) constructor of pmemobj_wcsdup
+ * obj_pmem_ctl_register -- (internal) registers ctl nodes for the "pmem"
+ *	module, which exposes the memcpy/memset dispatch of the process
  */
-static int
-constructor_wcsdup(PMEMobjpool *pop, void *ptr, void *arg)
+static void
+obj_pmem_ctl_register(PMEMobjpool *pop)
 {
-	LOG(3, "pop %p ptr %p arg %p", pop, ptr, arg);
+	CTL_REGISTER_MODULE(pop->ctl, pmem);
+}
 
-	ASSERTne(ptr, NULL);
-	ASSERTne(arg, NULL);
+/*
+ * The persist audit samples every Nth persist operation: the sampled range
+ * is snapshotted right after it was made persistent and the maintenance
+ * thread later reads the range back from the pool and compares it against
+ * the snapshot, so a flush silently lost by the platform shows up as a
+ * counter within seconds instead of as corruption days later. Before the
+ * comparison the range is flushed once more - on platforms whose flush
+ * instruction also evicts the line (clflush, clflushopt) the read-back
+ * then comes from the media itself.
+ *
+ * Persists into the lane region are never sampled - the lane logs are
+ * rewritten by the owning operation as part of its commit, so a sample
+ * taken there is stale by design before the read-back can run. Any other
+ * range that is legitimately rewritten between the sample and the
+ * read-back also compares unequal, so a lone mismatch is not a proof of
+ * flush loss - sustained growth of the mismatch counter is.
+ */
 
-	struct carg_wcsdup *carg = arg;
+/* bytes snapshotted from a sampled persist */
+#define OBJ_AUDIT_MAX_SAMPLE 64
+/* capacity of the pending read-back ring, must be a power of two */
+#define OBJ_AUDIT_RING_SIZE 64
 
-	/* copy string */
-	pmemops_memcpy(&pop->p_ops, ptr, carg->s, carg->size, 0);
+struct obj_audit_sample {
+	uint64_t off;	/* pool offset of the sampled range */
+	uint64_t len;	/* sampled length */
+	uint8_t data[OBJ_AUDIT_MAX_SAMPLE];
+};
 
-	return 0;
-}
+struct obj_audit {
+	uint32_t rate;		/* sample every Nth persist, 0 disables */
+	uint64_t clock;		/* persist counter driving the sampling */
+
+	uint64_t sampled;	/* snapshots taken */
+	uint64_t dropped;	/* samples lost to a full ring */
+	uint64_t verified;	/* read-backs that matched */
+	uint64_t mismatched;	/* read-backs that did not match */
+
+	/* MPSC ring of pending read-backs, consumed by the maintenance task */
+	uint64_t head;
+	uint64_t tail;
+	/* position + 1 once the sample at that position is complete */
+	uint64_t seq[OBJ_AUDIT_RING_SIZE];
+	struct obj_audit_sample ring[OBJ_AUDIT_RING_SIZE];
+};
 
 /*
- * pmemobj_wcsdup -- allocates a new object with duplicate of the wide character
- * string s.
+ * obj_audit_sample -- (internal) samples a persisted range for a later
+ *	read-back, called from the persist entry points
  */
-int
-pmemobj_wcsdup(PMEMobjpool *pop, PMEMoid *oidp, const wchar_t *s,
-	uint64_t type_num)
+static void
+obj_audit_sample(PMEMobjpool *pop, const void *addr, size_t len)
 {
-	LOG(3, "pop %p oidp %p string %S type_num %" PRIu64,
-		    pop, oidp, s, type_num);
+	struct obj_audit *a = pop->audit;
+	if (a == NULL)
+		return;
 
-	/* log notice message if used inside a transaction */
-	_POBJ_DEBUG_NOTICE_IN_TX();
+	uint32_t rate;
+	util_atomic_load_explicit32(&a->rate, &rate, memory_order_relaxed);
+	if (rate == 0)
+		return;
 
-	if (NULL == s) {
-		errno = EINVAL;
-		return -1;
+	uint64_t off = OBJ_PTR_TO_OFF(pop, addr);
+	if (OBJ_OFF_FROM_LANES(pop, off))
+		return;
+
+	if (util_fetch_and_add64(&a->clock, 1) % rate != 0)
+		return;
+
+	uint64_t pos;
+	for (;;) {
+		util_atomic_load_explicit64(&a->head, &pos,
+			memory_order_relaxed);
+
+		uint64_t tail;
+		util_atomic_load_explicit64(&a->tail, &tail,
+			memory_order_acquire);
+		if (pos - tail >= OBJ_AUDIT_RING_SIZE) {
+			util_fetch_and_add64(&a->dropped, 1);
+			return;
+		}
+
+		if (util_bool_compare_and_swap64(&a->head, pos, pos + 1))
+			break;
 	}
 
-	PMEMOBJ_API_START();
-	struct carg_wcsdup carg;
-	carg.size = (wcslen(s) + 1) * sizeof(wchar_t);
-	carg.s = s;
+	struct obj_audit_sample *s = &a->ring[pos % OBJ_AUDIT_RING_SIZE];
+	s->off = off;
+	s->len = len > OBJ_AUDIT_MAX_SAMPLE ? OBJ_AUDIT_MAX_SAMPLE : len;
+	memcpy(s->data, addr, s->len);
 
-	int ret = obj_alloc_construct(pop, oidp, carg.size,
-		(type_num_t)type_num, 0, constructor_wcsdup, &carg);
+	util_atomic_store_explicit64(&a->seq[pos % OBJ_AUDIT_RING_SIZE],
+		pos + 1, memory_order_release);
+	util_fetch_and_add64(&a->sampled, 1);
 
-	PMEMOBJ_API_END();
-	return ret;
+	maintenance_wake(pop->heap.maint);
 }
 
 /*
- * pmemobj_free -- frees an existing object
+ * obj_audit_task -- (internal) maintenance task draining the read-back ring
  */
-void
-pmemobj_free(PMEMoid *oidp)
+static int
+obj_audit_task(void *arg)
 {
-	ASSERTne(oidp, NULL);
+	PMEMobjpool *pop = arg;
+	struct obj_audit *a = pop->audit;
 
-	LOG(3, "oid.off 0x%016" PRIx64, oidp->off);
+	uint64_t tail = a->tail;
 
-	/* log notice message if used inside a transaction */
-	_POBJ_DEBUG_NOTICE_IN_TX();
+	uint64_t seq;
+	util_atomic_load_explicit64(&a->seq[tail % OBJ_AUDIT_RING_SIZE],
+		&seq, memory_order_acquire);
+	if (seq != tail + 1)
+		return 0;
 
-	if (oidp->off == 0)
-		return;
+	struct obj_audit_sample *s = &a->ring[tail % OBJ_AUDIT_RING_SIZE];
+	void *addr = OBJ_OFF_TO_PTR(pop, s->off);
 
-	PMEMOBJ_API_START();
-	PMEMobjpool *pop = pmemobj_pool_by_oid(*oidp);
+	/* evict the range where the flush instruction allows it */
+	pop->flush_local(addr, s->len);
+	pop->drain_local();
 
-	ASSERTne(pop, NULL);
-	ASSERT(OBJ_OID_IS_VALID(pop, *oidp));
+	if (memcmp(addr, s->data, s->len) == 0) {
+		util_fetch_and_add64(&a->verified, 1);
+	} else {
+		util_fetch_and_add64(&a->mismatched, 1);
+		CORE_LOG_ERROR(
+			"persist audit mismatch at offset 0x%" PRIx64
+			" len %" PRIu64, s->off, s->len);
+	}
 
-	obj_free(pop, oidp);
-	PMEMOBJ_API_END();
-}
+	maintenance_bw_account(pop->heap.maint, s->len);
 
-/*
- * pmemobj_alloc_usable_size -- returns usable size of object
- */
-size_t
-pmemobj_alloc_usable_size(PMEMoid oid)
-{
-	LOG(3, "oid.off 0x%016" PRIx64, oid.off);
-
-	if (oid.off == 0)
-		return 0;
-
-	PMEMobjpool *pop = pmemobj_pool_by_oid(oid);
+	util_atomic_store_explicit64(&a->seq[tail % OBJ_AUDIT_RING_SIZE],
+		0, memory_order_release);
+	util_atomic_store_explicit64(&a->tail, tail + 1,
+		memory_order_release);
 
-	ASSERTne(pop, NULL);
-	ASSERT(OBJ_OID_IS_VALID(pop, oid));
+	util_atomic_load_explicit64(&a->seq[(tail + 1) % OBJ_AUDIT_RING_SIZE],
+		&seq, memory_order_acquire);
 
-	return (palloc_usable_size(&pop->heap, oid.off));
+	return seq == tail + 2;
 }
 
 /*
- * pmemobj_memcpy_persist -- pmemobj version of memcpy
+ * obj_audit_boot -- (internal) allocates the audit state and registers its
+ *	maintenance task, which stays disabled until a rate is set
  */
-void *
-pmemobj_memcpy_persist(PMEMobjpool *pop, void *dest, const void *src,
-	size_t len)
+static int
+obj_audit_boot(PMEMobjpool *pop)
 {
-	LOG(15, "pop %p dest %p src %p len %zu", pop, dest, src, len);
-	PMEMOBJ_API_START();
+	struct obj_audit *a = Zalloc(sizeof(*a));
+	if (a == NULL) {
+		ERR_W_ERRNO("Zalloc");
+		return -1;
+	}
 
-	void *ptr = pmemops_memcpy(&pop->p_ops, dest, src, len, 0);
+	if (maintenance_task_register(pop->heap.maint, "audit",
+			obj_audit_task, pop) != 0) {
+		Free(a);
+		return -1;
+	}
 
-	PMEMOBJ_API_END();
-	return ptr;
+	pop->audit = a;
+
+	return 0;
 }
 
 /*
- * pmemobj_memset_persist -- pmemobj version of memset
+ * obj_audit_cleanup -- (internal) frees the audit state, called once the
+ *	maintenance thread is stopped
  */
-void *
-pmemobj_memset_persist(PMEMobjpool *pop, void *dest, int c, size_t len)
+static void
+obj_audit_cleanup(PMEMobjpool *pop)
 {
-	LOG(15, "pop %p dest %p c 0x%02x len %zu", pop, dest, c, len);
-	PMEMOBJ_API_START();
-
-	void *ptr = pmemops_memset(&pop->p_ops, dest, c, len, 0);
-
-	PMEMOBJ_API_END();
-	return ptr;
+	Free(pop->audit);
+	pop->audit = NULL;
 }
 
 /*
- * pmemobj_memcpy -- pmemobj version of memcpy
+ * CTL_READ_HANDLER(rate, audit) -- returns the persist sampling rate
  */
-void *
-pmemobj_memcpy(PMEMobjpool *pop, void *dest, const void *src, size_t len,
-		unsigned flags)
+static int
+CTL_READ_HANDLER(rate, audit)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
 {
-	LOG(15, "pop %p dest %p src %p len %zu flags 0x%x", pop, dest, src, len,
-			flags);
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
 
-	PMEMOBJ_API_START();
+	PMEMobjpool *pop = ctx;
+	long long *arg_out = arg;
 
-	void *ptr = pmemops_memcpy(&pop->p_ops, dest, src, len, flags);
+	*arg_out = pop->audit == NULL ? 0 : (long long)pop->audit->rate;
 
-	PMEMOBJ_API_END();
-	return ptr;
+	return 0;
 }
 
 /*
- * pmemobj_memmove -- pmemobj version of memmove
+ * CTL_WRITE_HANDLER(rate, audit) -- sets the persist sampling rate; every
+ *	Nth persist is scheduled for a read-back, 0 disables the audit
  */
-void *
-pmemobj_memmove(PMEMobjpool *pop, void *dest, const void *src, size_t len,
-		unsigned flags)
+static int
+CTL_WRITE_HANDLER(rate, audit)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
 {
-	LOG(15, "pop %p dest %p src %p len %zu flags 0x%x", pop, dest, src, len,
-			flags);
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
 
-	PMEMOBJ_API_START();
+	PMEMobjpool *pop = ctx;
+	long long arg_in = *(long long *)arg;
 
-	void *ptr = pmemops_memmove(&pop->p_ops, dest, src, len, flags);
+	if (arg_in < 0 || arg_in > UINT32_MAX || pop->audit == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
 
-	PMEMOBJ_API_END();
-	return ptr;
+	util_atomic_store_explicit32(&pop->audit->rate, (uint32_t)arg_in,
+		memory_order_relaxed);
+	maintenance_task_set_enabled(pop->heap.maint, "audit", arg_in > 0);
+
+	return 0;
 }
 
+static const struct ctl_argument CTL_ARG(rate) = CTL_ARG_LONG_LONG;
+
+#define OBJ_AUDIT_COUNTER_READ(name)\
+static int \
+CTL_READ_HANDLER(name, audit)(void *ctx,\
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)\
+{\
+	SUPPRESS_UNUSED(source, indexes);\
+\
+	PMEMobjpool *pop = ctx;\
+	long long *arg_out = arg;\
+	uint64_t value = 0;\
+\
+	if (pop->audit != NULL)\
+		util_atomic_load_explicit64(&pop->audit->name, &value,\
+			memory_order_relaxed);\
+	*arg_out = (long long)value;\
+\
+	return 0;\
+}
+
+OBJ_AUDIT_COUNTER_READ(sampled)
+OBJ_AUDIT_COUNTER_READ(dropped)
+OBJ_AUDIT_COUNTER_READ(verified)
+OBJ_AUDIT_COUNTER_READ(mismatched)
+
+#undef OBJ_AUDIT_COUNTER_READ
+
+static const struct ctl_node CTL_NODE(audit)[] = {
+	CTL_LEAF_RW(rate, audit),
+	CTL_LEAF_RO(sampled, audit),
+	CTL_LEAF_RO(dropped, audit),
+	CTL_LEAF_RO(verified, audit),
+	CTL_LEAF_RO(mismatched, audit),
+
+	CTL_NODE_END
+};
+
 /*
- * pmemobj_memset -- pmemobj version of memset
+ * obj_audit_ctl_register -- (internal) registers ctl nodes for the "audit"
+ *	module
  */
-void *
-pmemobj_memset(PMEMobjpool *pop, void *dest, int c, size_t len, unsigned flags)
+static void
+obj_audit_ctl_register(PMEMobjpool *pop)
 {
-	LOG(15, "pop %p dest %p c 0x%02x len %zu flags 0x%x", pop, dest, c, len,
-			flags);
+	CTL_REGISTER_MODULE(pop->ctl, audit);
+}
 
-	PMEMOBJ_API_START();
+/*
+ * The scrubber reads the pool's heap sequentially from the maintenance
+ * thread at a configured rate, so media degradation surfaces as a counter
+ * within one pass instead of as a SIGBUS on the foreground path months
+ * later. Reads go through the pool mapping page by page under a SIGBUS
+ * trampoline - the same technique the pmem2 machine-safe reads use - so a
+ * page with consumed poison is recorded instead of killing the process:
+ * the range is counted, reported to the registered callback and handed to
+ * heap_report_badblock(), which takes the free chunks it overlaps out of
+ * circulation.
+ *
+ * Like in pmem2, the trampoline temporarily takes over the process-wide
+ * SIGBUS disposition for the duration of a slice; an application that
+ * installs its own SIGBUS handler should leave the scrubber disabled.
+ */
 
-	void *ptr = pmemops_memset(&pop->p_ops, dest, c, len, flags);
+/* the most the scrubber reads in one maintenance step */
+#define OBJ_SCRUB_MAX_STEP (4UL << 20)
 
-	PMEMOBJ_API_END();
-	return ptr;
+struct obj_scrub {
+	uint64_t rate;		/* bytes per second, 0 disables the task */
+	uint64_t cursor;	/* heap offset of the next unread byte */
+	struct timespec last;	/* end of the previous step, paces the rate */
+
+	uint64_t scanned;	/* bytes read since the pool was opened */
+	uint64_t passes;	/* completed full passes over the heap */
+	uint64_t errors;	/* unreadable pages discovered */
+
+	pmemobj_scrub_cb cb;	/* bad page callback, may be NULL */
+	void *cb_arg;
+};
+
+/*
+ * Volatile, unlike its pmem2 counterpart - the guarded reads are inlined
+ * right next to the stores here, so without it the compiler would be free
+ * to sink the arming store past the reads it guards.
+ */
+static __thread sigjmp_buf *volatile Scrub_jmp;
+
+/*
+ * obj_scrub_sigbus -- (internal) SIGBUS handler active during a scrub read
+ */
+static void
+obj_scrub_sigbus(int sig)
+{
+	if (sig == SIGBUS && Scrub_jmp != NULL)
+		siglongjmp(*Scrub_jmp, 1);
 }
 
 /*
- * pmemobj_persist -- pmemobj version of pmem_persist
+ * obj_scrub_read_page -- (internal) reads one page through the trampoline,
+ *	returns nonzero when the read faulted
  */
-void
-pmemobj_persist(PMEMobjpool *pop, const void *addr, size_t len)
+static int
+obj_scrub_read_page(const void *addr)
 {
-	LOG(15, "pop %p addr %p len %zu", pop, addr, len);
+	sigjmp_buf jmp;
 
-	pmemops_persist(&pop->p_ops, addr, len);
+	if (sigsetjmp(jmp, 1)) {
+		Scrub_jmp = NULL;
+		return 1;
+	}
+	Scrub_jmp = &jmp;
+
+	/* volatile loads so the walk cannot be optimized away */
+	const volatile uint64_t *p = addr;
+	uint64_t sum = 0;
+	for (size_t i = 0; i < Pagesize / sizeof(*p); ++i)
+		sum += p[i];
+	(void) sum;
+
+	Scrub_jmp = NULL;
+
+	return 0;
 }
 
 /*
- * pmemobj_flush -- pmemobj version of pmem_flush
+ * obj_scrub_task -- (internal) maintenance task body of the scrubber
+ *
+ * Reads the slice the configured rate has earned since the previous step -
+ * the task self-paces by timestamps, so the rate holds regardless of how
+ * often the maintenance thread cycles.
  */
-void
-pmemobj_flush(PMEMobjpool *pop, const void *addr, size_t len)
+static int
+obj_scrub_task(void *arg)
 {
-	LOG(15, "pop %p addr %p len %zu", pop, addr, len);
+	PMEMobjpool *pop = arg;
+	struct obj_scrub *s = pop->scrub;
 
-	pmemops_flush(&pop->p_ops, addr, len);
+	uint64_t rate;
+	util_atomic_load_explicit64(&s->rate, &rate, memory_order_relaxed);
+	if (rate == 0)
+		return 0;
+
+	struct timespec now;
+	os_clock_gettime(CLOCK_MONOTONIC, &now);
+	uint64_t elapsed_ns = (uint64_t)(now.tv_sec - s->last.tv_sec) *
+		1000000000ULL + (uint64_t)(now.tv_nsec - s->last.tv_nsec);
+	uint64_t earned = (uint64_t)((double)elapsed_ns / 1000000000.0 *
+		(double)rate);
+	if (earned < Pagesize)
+		return 0;
+	uint64_t budget = earned;
+	if (budget > OBJ_SCRUB_MAX_STEP)
+		budget = OBJ_SCRUB_MAX_STEP;
+	if (budget > pop->heap_size - s->cursor)
+		budget = pop->heap_size - s->cursor;
+	/* keep the cursor page-aligned so a read never crosses the pool end */
+	budget &= ~((uint64_t)Pagesize - 1);
+	if (budget == 0) {
+		/* an unaligned heap tail is skipped rather than overread */
+		if (pop->heap_size - s->cursor < Pagesize) {
+			s->cursor = 0;
+			util_fetch_and_add64(&s->passes, 1);
+		}
+		return 0;
+	}
+	s->last = now;
+
+	struct sigaction custom_act;
+	sigemptyset(&custom_act.sa_mask);
+	custom_act.sa_flags = 0;
+	custom_act.sa_handler = obj_scrub_sigbus;
+
+	struct sigaction old_act;
+	if (sigaction(SIGBUS, &custom_act, &old_act) == -1)
+		return 0;
+
+	char *heap_start = (char *)pop + pop->heap_offset;
+	for (uint64_t off = s->cursor; off < s->cursor + budget;
+			off += Pagesize) {
+		if (obj_scrub_read_page(heap_start + off) == 0)
+			continue;
+
+		util_fetch_and_add64(&s->errors, 1);
+		CORE_LOG_ERROR(
+			"scrub found an unreadable page at pool offset 0x%"
+			PRIx64, pop->heap_offset + off);
+
+		if (s->cb != NULL)
+			s->cb(pop, pop->heap_offset + off, Pagesize,
+				s->cb_arg);
+
+		(void) heap_report_badblock(&pop->heap, off, Pagesize);
+	}
+
+	(void) sigaction(SIGBUS, &old_act, NULL);
+
+	util_fetch_and_add64(&s->scanned, budget);
+	maintenance_bw_account(pop->heap.maint, budget);
+
+	s->cursor += budget;
+	if (s->cursor >= pop->heap_size) {
+		s->cursor = 0;
+		util_fetch_and_add64(&s->passes, 1);
+	}
+
+	/* a step clamped below what the rate earned has work left over */
+	return earned > budget;
 }
 
 /*
- * pmemobj_xpersist -- pmemobj version of pmem_persist with additional flags
- * argument
+ * pmemobj_scrub_callback -- registers the bad page callback of the
+ *	background scrubber, NULL unregisters
  */
 int
-pmemobj_xpersist(PMEMobjpool *pop, const void *addr, size_t len, unsigned flags)
+pmemobj_scrub_callback(PMEMobjpool *pop, pmemobj_scrub_cb cb, void *arg)
 {
-	LOG(15, "pop %p addr %p len %zu", pop, addr, len);
+	LOG(3, "pop %p cb %p arg %p", pop, cb, arg);
+	PMEMOBJ_API_START();
 
-	if (flags & ~OBJ_X_VALID_FLAGS) {
+	struct obj_scrub *s = pop->scrub;
+	if (s == NULL) {
 		errno = EINVAL;
-		ERR_WO_ERRNO("invalid flags 0x%x", flags);
+		ERR_W_ERRNO("no scrubber state");
+		PMEMOBJ_API_END();
 		return -1;
 	}
 
-	return pmemops_xpersist(&pop->p_ops, addr, len, flags);
+	s->cb_arg = arg;
+	s->cb = cb;
+
+	PMEMOBJ_API_END();
+	return 0;
 }
 
 /*
- * pmemobj_xflush -- pmemobj version of pmem_flush with additional flags
- * argument
+ * pmemobj_watermark_callback -- registers the heap occupancy watermark
+ *	callback, NULL unregisters
  */
 int
-pmemobj_xflush(PMEMobjpool *pop, const void *addr, size_t len, unsigned flags)
+pmemobj_watermark_callback(PMEMobjpool *pop, pmemobj_watermark_cb cb,
+	void *arg)
 {
-	LOG(15, "pop %p addr %p len %zu", pop, addr, len);
+	LOG(3, "pop %p cb %p arg %p", pop, cb, arg);
+	PMEMOBJ_API_START();
 
-	if (flags & ~OBJ_X_VALID_FLAGS) {
-		errno = EINVAL;
-		ERR_WO_ERRNO("invalid flags 0x%x", flags);
-		return -1;
-	}
+	int ret = palloc_watermark_callback(&pop->heap, cb, arg);
 
-	return pmemops_xflush(&pop->p_ops, addr, len, flags);
+	PMEMOBJ_API_END();
+	return ret;
 }
 
 /*
- * pmemobj_drain -- pmemobj version of pmem_drain
+ * obj_scrub_boot -- (internal) allocates the scrubber state and registers
+ *	its maintenance task, which stays disabled until a rate is set
  */
-void
-pmemobj_drain(PMEMobjpool *pop)
+static int
+obj_scrub_boot(PMEMobjpool *pop)
 {
-	LOG(15, "pop %p", pop);
+	struct obj_scrub *s = Zalloc(sizeof(*s));
+	if (s == NULL) {
+		ERR_W_ERRNO("Zalloc");
+		return -1;
+	}
 
-	pmemops_drain(&pop->p_ops);
+	if (maintenance_task_register(pop->heap.maint, "scrub",
+			obj_scrub_task, pop) != 0) {
+		Free(s);
+		return -1;
+	}
+
+	pop->scrub = s;
+
+	return 0;
 }
 
 /*
- * pmemobj_type_num -- returns type number of object
+ * obj_scrub_cleanup -- (internal) frees the scrubber state, called once the
+ *	maintenance thread is stopped
  */
-uint64_t
-pmemobj_type_num(PMEMoid oid)
+static void
+obj_scrub_cleanup(PMEMobjpool *pop)
 {
-	LOG(3, "oid.off 0x%016" PRIx64, oid.off);
+	Free(pop->scrub);
+	pop->scrub = NULL;
+}
 
-	ASSERT(!OID_IS_NULL(oid));
+/*
+ * CTL_READ_HANDLER(rate, scrub) -- returns the scrub rate in bytes per
+ *	second
+ */
+static int
+CTL_READ_HANDLER(rate, scrub)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
 
-	PMEMobjpool *pop = pmemobj_pool_by_oid(oid);
+	PMEMobjpool *pop = ctx;
+	long long *arg_out = arg;
 
-	ASSERTne(pop, NULL);
-	ASSERT(OBJ_OID_IS_VALID(pop, oid));
+	*arg_out = pop->scrub == NULL ? 0 : (long long)pop->scrub->rate;
 
-	return palloc_extra(&pop->heap, oid.off);
+	return 0;
 }
 
-/* arguments for constructor_alloc_root */
-struct carg_root {
-	size_t size;
-	pmemobj_constr constructor;
-	void *arg;
-};
-
 /*
- * obj_realloc_root -- (internal) reallocate root object
+ * CTL_WRITE_HANDLER(rate, scrub) -- sets the scrub rate in bytes per
+ *	second, 0 disables the scrubber
  */
 static int
-obj_alloc_root(PMEMobjpool *pop, size_t size,
-	pmemobj_constr constructor, void *arg)
+CTL_WRITE_HANDLER(rate, scrub)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
 {
-	LOG(3, "pop %p size %zu", pop, size);
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
 
-	struct carg_realloc carg;
+	PMEMobjpool *pop = ctx;
+	long long arg_in = *(long long *)arg;
 
-	carg.ptr = OBJ_OFF_TO_PTR(pop, pop->root_offset);
-	carg.old_size = pop->root_size;
-	carg.new_size = size;
-	carg.user_type = POBJ_ROOT_TYPE_NUM;
-	carg.constructor = constructor;
-	carg.zero_init = 1;
-	carg.arg = arg;
+	if (arg_in < 0 || pop->scrub == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
 
-	struct operation_context *ctx = pmalloc_operation_hold(pop);
+	os_clock_gettime(CLOCK_MONOTONIC, &pop->scrub->last);
+	util_atomic_store_explicit64(&pop->scrub->rate, (uint64_t)arg_in,
+		memory_order_relaxed);
+	maintenance_task_set_enabled(pop->heap.maint, "scrub", arg_in > 0);
 
-	operation_add_entry(ctx, &pop->root_size, size, ULOG_OPERATION_SET);
+	return 0;
+}
 
-	int ret = palloc_operation(&pop->heap, pop->root_offset,
-			&pop->root_offset, size,
-			constructor_zrealloc_root, &carg,
-			POBJ_ROOT_TYPE_NUM, OBJ_INTERNAL_OBJECT_MASK,
-			0, 0, ctx);
+#define OBJ_SCRUB_COUNTER_READ(name)\
+static int \
+CTL_READ_HANDLER(name, scrub)(void *ctx,\
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)\
+{\
+	SUPPRESS_UNUSED(source, indexes);\
+\
+	PMEMobjpool *pop = ctx;\
+	long long *arg_out = arg;\
+	uint64_t value = 0;\
+\
+	if (pop->scrub != NULL)\
+		util_atomic_load_explicit64(&pop->scrub->name, &value,\
+			memory_order_relaxed);\
+	*arg_out = (long long)value;\
+\
+	return 0;\
+}
 
-	pmalloc_operation_release(pop);
+OBJ_SCRUB_COUNTER_READ(scanned)
+OBJ_SCRUB_COUNTER_READ(passes)
+OBJ_SCRUB_COUNTER_READ(errors)
 
-	return ret;
-}
+#undef OBJ_SCRUB_COUNTER_READ
+
+static const struct ctl_node CTL_NODE(scrub)[] = {
+	CTL_LEAF_RW(rate, scrub),
+	CTL_LEAF_RO(scanned, scrub),
+	CTL_LEAF_RO(passes, scrub),
+	CTL_LEAF_RO(errors, scrub),
+
+	CTL_NODE_END
+};
 
 /*
- * pmemobj_root_size -- returns size of the root object
+ * obj_scrub_ctl_register -- (internal) registers ctl nodes for the "scrub"
+ *	module
  */
-size_t
-pmemobj_root_size(PMEMobjpool *pop)
+static void
+obj_scrub_ctl_register(PMEMobjpool *pop)
 {
-	LOG(3, "pop %p", pop);
-
-	if (pop->root_offset && pop->root_size) {
-		return pop->root_size;
-	} else
-		return 0;
+	CTL_REGISTER_MODULE(pop->ctl, scrub);
 }
 
 /*
- * pmemobj_root_construct -- returns root object
+ * The obj_oid32 module implements compressed persistent pointers: a per-pool
+ * object table that maps 32-bit handles to object offsets, so that
+ * pointer-heavy structures can store a 4-byte handle where a 16-byte PMEMoid
+ * would go. The table is a persistent two-level array - a directory of
+ * segments, each segment a flat array of offsets - rooted in the pool
+ * descriptor, so handles stay valid across pool opens. Translation through
+ * pmemobj_oid32_direct() is two dependent loads and takes no locks; handle
+ * assignment and release are serialized on a mutex and keep a volatile
+ * critnib mapping offsets back to handles, so registering the same object
+ * twice yields the same handle.
+ *
+ * Every table update is a single 8-byte store followed by a persist, so a
+ * crash can at worst leak a handle, never corrupt the table. Releasing a
+ * handle does not free the object, and freeing an object does not release
+ * its handles - the same lifetime contract OIDs have.
  */
-PMEMoid
-pmemobj_root_construct(PMEMobjpool *pop, size_t size,
-	pmemobj_constr constructor, void *arg)
-{
-	LOG(3, "pop %p size %zu constructor %p args %p", pop, size, constructor,
-		arg);
+
+/* the number of segment slots in the handle directory */
+#define OBJ32_DIR_ENTRIES 1024
+/* the number of handles mapped by a single segment */
+#define OBJ32_SEG_ENTRIES 4096
+
+#define OBJ32_MAX_HANDLES ((uint64_t)OBJ32_DIR_ENTRIES * OBJ32_SEG_ENTRIES)
+
+struct obj_oid32 {
+	os_mutex_t lock; /* serializes handle assignment and release */
+
+	/* volatile reverse map, object offset -> handle */
+	struct critnib *rev;
+
+	/* stack of released handles, reused before fresh ones */
+	uint32_t *free_stack;
+	size_t nfree;
+	size_t free_capacity;
+
+	/* the lowest handle index never assigned */
+	uint64_t next;
+};
+
+/*
+ * obj_oid32_dir -- (internal) returns the handle directory, or NULL when no
+ *	handle has ever been registered in this pool
+ */
+static uint64_t *
+obj_oid32_dir(PMEMobjpool *pop)
+{
+	uint64_t off = pop->oid32_dir_offset;
+
+	return off == 0 ? NULL : (uint64_t *)OBJ_OFF_TO_PTR(pop, off);
+}
+
+/*
+ * constructor_oid32_zero -- (internal) constructor zeroing a handle table
+ *	node; a zero entry means the slot is free
+ */
+static int
+constructor_oid32_zero(void *ctx, void *ptr, size_t usable_size, void *arg)
+{
+	PMEMobjpool *pop = ctx;
+
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(arg);
+
+	pmemops_memset(&pop->p_ops, ptr, 0, usable_size, 0);
+
+	return 0;
+}
+
+/*
+ * obj_oid32_rebuild -- (internal) rebuilds the volatile reverse map and the
+ *	free handle stack from the persistent table on pool open
+ */
+static int
+obj_oid32_rebuild(PMEMobjpool *pop)
+{
+	struct obj_oid32 *t = pop->oid32;
+	uint64_t *dir = obj_oid32_dir(pop);
+	if (dir == NULL)
+		return 0;
+
+	for (uint64_t s = 0; s < OBJ32_DIR_ENTRIES; ++s) {
+		if (dir[s] == 0)
+			continue;
+
+		uint64_t *seg = OBJ_OFF_TO_PTR(pop, dir[s]);
+		for (uint64_t i = 0; i < OBJ32_SEG_ENTRIES; ++i) {
+			if (seg[i] == 0)
+				continue;
+
+			uint64_t idx = s * OBJ32_SEG_ENTRIES + i;
+			if (critnib_insert(t->rev, seg[i],
+					(void *)(uintptr_t)(idx + 1)) != 0)
+				return -1;
+			if (idx >= t->next)
+				t->next = idx + 1;
+		}
+	}
+
+	/*
+	 * Gaps below the high watermark are released handles; put them back
+	 * on the free stack so the handle space does not grow on reopen.
+	 */
+	for (uint64_t idx = 0; idx < t->next; ++idx) {
+		uint64_t s = idx / OBJ32_SEG_ENTRIES;
+		uint64_t i = idx % OBJ32_SEG_ENTRIES;
+		uint64_t *seg = dir[s] == 0 ? NULL :
+			(uint64_t *)OBJ_OFF_TO_PTR(pop, dir[s]);
+		if (seg != NULL && seg[i] != 0)
+			continue;
+
+		if (t->nfree == t->free_capacity) {
+			size_t ncap = t->free_capacity == 0 ?
+				64 : t->free_capacity * 2;
+			uint32_t *nstack = Realloc(t->free_stack,
+				ncap * sizeof(*nstack));
+			if (nstack == NULL)
+				return -1;
+			t->free_stack = nstack;
+			t->free_capacity = ncap;
+		}
+		t->free_stack[t->nfree++] = (uint32_t)(idx + 1);
+	}
+
+	return 0;
+}
+
+/*
+ * obj_oid32_boot -- (internal) allocates the handle table runtime state and
+ *	rebuilds it from the persistent table, if one exists
+ */
+static int
+obj_oid32_boot(PMEMobjpool *pop)
+{
+	struct obj_oid32 *t = Zalloc(sizeof(*t));
+	if (t == NULL) {
+		ERR_W_ERRNO("Zalloc");
+		return -1;
+	}
+
+	t->rev = critnib_new();
+	if (t->rev == NULL) {
+		Free(t);
+		return -1;
+	}
+
+	util_mutex_init(&t->lock);
+	pop->oid32 = t;
+
+	if (obj_oid32_rebuild(pop) != 0) {
+		obj_oid32_cleanup(pop);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * obj_oid32_cleanup -- (internal) frees the handle table runtime state
+ */
+static void
+obj_oid32_cleanup(PMEMobjpool *pop)
+{
+	struct obj_oid32 *t = pop->oid32;
+	if (t == NULL)
+		return;
+
+	util_mutex_destroy(&t->lock);
+	critnib_delete(t->rev);
+	Free(t->free_stack);
+	Free(t);
+	pop->oid32 = NULL;
+}
+
+/*
+ * pmemobj_oid32 -- returns the 32-bit handle of the given object, assigning
+ *	one if the object has none yet; returns 0 on error
+ */
+uint32_t
+pmemobj_oid32(PMEMobjpool *pop, PMEMoid oid)
+{
+	LOG(3, "pop %p oid.off 0x%016" PRIx64, pop, oid.off);
+
+	struct obj_oid32 *t = pop->oid32;
+
+	if (oid.pool_uuid_lo != pop->uuid_lo ||
+	    !OBJ_OFF_FROM_HEAP(pop, oid.off)) {
+		ERR_WO_ERRNO("object not from this pool");
+		errno = EINVAL;
+		return 0;
+	}
+
+	util_mutex_lock(&t->lock);
+
+	void *existing = critnib_get(t->rev, oid.off);
+	if (existing != NULL) {
+		util_mutex_unlock(&t->lock);
+		return (uint32_t)(uintptr_t)existing;
+	}
+
+	uint64_t idx;
+	int reused = 0;
+	if (t->nfree > 0) {
+		idx = t->free_stack[t->nfree - 1] - 1;
+		reused = 1;
+	} else if (t->next < OBJ32_MAX_HANDLES) {
+		idx = t->next;
+	} else {
+		ERR_WO_ERRNO("handle space exhausted");
+		errno = ENOMEM;
+		goto err;
+	}
+
+	if (pop->oid32_dir_offset == 0 &&
+	    pmalloc_construct(pop, &pop->oid32_dir_offset,
+			OBJ32_DIR_ENTRIES * sizeof(uint64_t),
+			constructor_oid32_zero, NULL,
+			0, OBJ_INTERNAL_OBJECT_MASK, 0) != 0)
+		goto err;
+
+	uint64_t *dir = obj_oid32_dir(pop);
+	uint64_t s = idx / OBJ32_SEG_ENTRIES;
+	if (dir[s] == 0 &&
+	    pmalloc_construct(pop, &dir[s],
+			OBJ32_SEG_ENTRIES * sizeof(uint64_t),
+			constructor_oid32_zero, NULL,
+			0, OBJ_INTERNAL_OBJECT_MASK, 0) != 0)
+		goto err;
+
+	uint32_t handle = (uint32_t)(idx + 1);
+	if (critnib_insert(t->rev, oid.off,
+			(void *)(uintptr_t)handle) != 0) {
+		errno = ENOMEM;
+		goto err;
+	}
+
+	uint64_t *seg = OBJ_OFF_TO_PTR(pop, dir[s]);
+	uint64_t i = idx % OBJ32_SEG_ENTRIES;
+	seg[i] = oid.off;
+	pmemops_persist(&pop->p_ops, &seg[i], sizeof(seg[i]));
+
+	/* the handle is published, consume the slot it came from */
+	if (reused)
+		t->nfree--;
+	else
+		t->next++;
+
+	util_mutex_unlock(&t->lock);
+
+	return handle;
+
+err:
+	util_mutex_unlock(&t->lock);
+	return 0;
+}
+
+/*
+ * pmemobj_oid32_direct -- returns the direct pointer behind a 32-bit handle,
+ *	or NULL when the handle maps no object
+ */
+void *
+pmemobj_oid32_direct(PMEMobjpool *pop, uint32_t handle)
+{
+	if (handle == 0 || handle > OBJ32_MAX_HANDLES)
+		return NULL;
+
+	uint64_t *dir = obj_oid32_dir(pop);
+	if (dir == NULL)
+		return NULL;
+
+	uint64_t idx = handle - 1;
+	uint64_t seg_off = dir[idx / OBJ32_SEG_ENTRIES];
+	if (seg_off == 0)
+		return NULL;
+
+	uint64_t *seg = OBJ_OFF_TO_PTR(pop, seg_off);
+	uint64_t off = seg[idx % OBJ32_SEG_ENTRIES];
+
+	return off == 0 ? NULL : OBJ_OFF_TO_PTR(pop, off);
+}
+
+/*
+ * pmemobj_oid32_release -- releases a 32-bit handle; the object itself is
+ *	not freed
+ */
+void
+pmemobj_oid32_release(PMEMobjpool *pop, uint32_t handle)
+{
+	LOG(3, "pop %p handle %u", pop, handle);
+
+	struct obj_oid32 *t = pop->oid32;
+
+	if (handle == 0 || handle > OBJ32_MAX_HANDLES)
+		return;
+
+	util_mutex_lock(&t->lock);
+
+	uint64_t idx = handle - 1;
+	uint64_t *dir = obj_oid32_dir(pop);
+	uint64_t seg_off = dir == NULL ? 0 : dir[idx / OBJ32_SEG_ENTRIES];
+	if (seg_off == 0) {
+		util_mutex_unlock(&t->lock);
+		return;
+	}
+
+	uint64_t *seg = OBJ_OFF_TO_PTR(pop, seg_off);
+	uint64_t i = idx % OBJ32_SEG_ENTRIES;
+	if (seg[i] == 0) {
+		util_mutex_unlock(&t->lock);
+		return;
+	}
+
+	if (t->nfree == t->free_capacity) {
+		size_t ncap = t->free_capacity == 0 ?
+			64 : t->free_capacity * 2;
+		uint32_t *nstack = Realloc(t->free_stack,
+			ncap * sizeof(*nstack));
+		if (nstack == NULL) {
+			/* the handle stays live, nothing is lost */
+			util_mutex_unlock(&t->lock);
+			return;
+		}
+		t->free_stack = nstack;
+		t->free_capacity = ncap;
+	}
+
+	critnib_remove(t->rev, seg[i]);
+	seg[i] = 0;
+	pmemops_persist(&pop->p_ops, &seg[i], sizeof(seg[i]));
+	t->free_stack[t->nfree++] = handle;
+
+	util_mutex_unlock(&t->lock);
+}
+
+/*
+ * The warmup walks the heap zones hottest-first - ordered by the sampled
+ * heat counters, falling back to a sequential walk on a standby that has no
+ * samples yet - and faults their chunk payload in from a background thread,
+ * optionally throttled to a configurable bandwidth. It is a controlled
+ * alternative to the all-at-once prefault done through the "prefault" ctl.
+ */
+
+/* the number of bytes the warmup thread faults between throttle sleeps */
+#define OBJ_WARMUP_SLICE (1 << 20)
+
+struct obj_warmup {
+	PMEMobjpool *pop;
+	unsigned rate_mbps; /* bandwidth cap, 0 means unthrottled */
+	os_thread_t thread;
+	int stop; /* asks the thread to quit between slices */
+	int done; /* set by the thread once the walk finished */
+};
+
+struct obj_warmup_zone {
+	uint32_t zone_id;
+	uint64_t heat;
+};
+
+/*
+ * obj_warmup_zone_cmp -- (internal) orders warmup zones hottest-first, ties
+ *	resolved by ascending zone id so that a cold walk stays sequential
+ */
+static int
+obj_warmup_zone_cmp(const void *lhs, const void *rhs)
+{
+	const struct obj_warmup_zone *l = lhs;
+	const struct obj_warmup_zone *r = rhs;
+
+	if (l->heat != r->heat)
+		return l->heat > r->heat ? -1 : 1;
+
+	return l->zone_id < r->zone_id ? -1 : (l->zone_id > r->zone_id);
+}
+
+/*
+ * obj_warmup_stopped -- (internal) reads the stop request flag
+ */
+static int
+obj_warmup_stopped(struct obj_warmup *w)
+{
+	int stop;
+	util_atomic_load_explicit32(&w->stop, &stop, memory_order_relaxed);
+
+	return stop;
+}
+
+/*
+ * obj_warmup_thread -- (internal) worker of the pool warmup
+ */
+static void *
+obj_warmup_thread(void *arg)
+{
+	struct obj_warmup *w = arg;
+	PMEMobjpool *pop = w->pop;
+
+	unsigned nzones = heap_zone_count(&pop->heap);
+	struct obj_warmup_zone *zones = Malloc(sizeof(*zones) * nzones);
+	if (zones == NULL)
+		goto out;
+
+	for (uint32_t i = 0; i < nzones; ++i) {
+		zones[i].zone_id = i;
+		if (heap_zone_heat(&pop->heap, i, &zones[i].heat) != 0)
+			zones[i].heat = 0;
+	}
+	qsort(zones, nzones, sizeof(*zones), obj_warmup_zone_cmp);
+
+	for (unsigned i = 0; i < nzones && !obj_warmup_stopped(w); ++i) {
+		size_t offset = 0;
+		size_t touched;
+		do {
+			if (heap_zone_prewarm(&pop->heap, zones[i].zone_id,
+				offset, OBJ_WARMUP_SLICE, &touched) != 0)
+				break;
+			offset += touched;
+
+			/*
+			 * The faulted bytes also count against the shared
+			 * bandwidth governor, so a pool-wide cap bounds the
+			 * warmup even when its own rate is unrestricted.
+			 */
+			maintenance_bw_account(pop->heap.maint, touched);
+
+			/*
+			 * Sleeping out the entire slice budget caps the rate
+			 * at rate_mbps from above; the fault time itself only
+			 * slows the walk down further.
+			 */
+			if (w->rate_mbps != 0 && touched != 0)
+				usleep((useconds_t)
+					(touched / w->rate_mbps));
+		} while (touched != 0 && !obj_warmup_stopped(w));
+	}
+
+	Free(zones);
+
+out:
+	util_atomic_store_explicit32(&w->done, 1, memory_order_release);
+
+	return NULL;
+}
+
+/*
+ * pmemobj_warmup -- starts a background walk that faults the pool's heap
+ *	into memory, hottest zones first, at the given bandwidth
+ */
+int
+pmemobj_warmup(PMEMobjpool *pop, unsigned rate_mbps)
+{
+	LOG(3, "pop %p rate_mbps %u", pop, rate_mbps);
+	PMEMOBJ_API_START();
+
+	int ret = 0;
+
+	struct obj_warmup *w = pop->warmup;
+	if (w != NULL) {
+		int done;
+		util_atomic_load_explicit32(&w->done, &done,
+			memory_order_acquire);
+		if (!done) {
+			ERR_WO_ERRNO("a warmup is already running");
+			errno = EBUSY;
+			ret = -1;
+			goto out;
+		}
+		os_thread_join(&w->thread, NULL);
+		Free(w);
+		pop->warmup = NULL;
+	}
+
+	w = Malloc(sizeof(*w));
+	if (w == NULL) {
+		ret = -1;
+		goto out;
+	}
+
+	w->pop = pop;
+	w->rate_mbps = rate_mbps;
+	w->stop = 0;
+	w->done = 0;
+
+	if ((errno = os_thread_create(&w->thread, NULL,
+			obj_warmup_thread, w)) != 0) {
+		ERR_W_ERRNO("os_thread_create warmup");
+		Free(w);
+		ret = -1;
+		goto out;
+	}
+
+	pop->warmup = w;
+
+out:
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * obj_warmup_cleanup -- (internal) stops and joins an in-flight warmup
+ */
+static void
+obj_warmup_cleanup(PMEMobjpool *pop)
+{
+	struct obj_warmup *w = pop->warmup;
+	if (w == NULL)
+		return;
+
+	util_atomic_store_explicit32(&w->stop, 1, memory_order_relaxed);
+	os_thread_join(&w->thread, NULL);
+	pop->warmup = NULL;
+	Free(w);
+}
+
+/* arguments for constructor_alloc */
+struct constr_args {
+	int zero_init;
+	int generation;
+	pmemobj_constr constructor;
+	void *arg;
+};
+
+/*
+ * constructor_alloc -- (internal) constructor for obj_alloc_construct
+ */
+static int
+constructor_alloc(void *ctx, void *ptr, size_t usable_size, void *arg)
+{
+	PMEMobjpool *pop = ctx;
+	LOG(3, "pop %p ptr %p arg %p", pop, ptr, arg);
+	struct pmem_ops *p_ops = &pop->p_ops;
+
+	ASSERTne(ptr, NULL);
+	ASSERTne(arg, NULL);
+
+	struct constr_args *carg = arg;
+
+	if (carg->zero_init)
+		pmemops_memset(p_ops, ptr, 0, usable_size, 0);
+	else if (carg->generation)
+		pmemops_memset(p_ops, (char *)ptr + usable_size -
+			sizeof(uint64_t), 0, sizeof(uint64_t), 0);
+
+	int ret = 0;
+	if (carg->constructor)
+		ret = carg->constructor(pop, ptr, carg->arg);
+
+	return ret;
+}
+
+/*
+ * obj_alloc_construct -- (internal) allocates a new object with constructor
+ */
+static int
+obj_alloc_construct(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
+	type_num_t type_num, uint64_t flags,
+	pmemobj_constr constructor, void *arg)
+{
+	if (size > PMEMOBJ_MAX_ALLOC_SIZE) {
+		ERR_DEFER_WO_ERRNO("requested size too large");
+		errno = ENOMEM;
+		return -1;
+	}
+
+	struct constr_args carg;
+
+	carg.zero_init = flags & POBJ_FLAG_ZERO;
+	carg.generation = (flags & POBJ_FLAG_GENERATION) != 0;
+	carg.constructor = constructor;
+	carg.arg = arg;
+
+	uint16_t object_flags = 0;
+	if (carg.generation) {
+		/* the generation counter lives past the usable space */
+		size += sizeof(uint64_t);
+		object_flags |= OBJ_GENERATION_MASK;
+	}
+
+	struct operation_context *ctx = pmalloc_operation_hold(pop);
+
+	if (oidp)
+		operation_add_entry(ctx, &oidp->pool_uuid_lo, pop->uuid_lo,
+				ULOG_OPERATION_SET);
+
+	/*
+	 * Zeroing allocations with no constructor and no placement
+	 * requirements can be served from the pre-zeroed parked reservations,
+	 * skipping the memset of the object on the allocating thread.
+	 */
+	if (carg.zero_init && constructor == NULL &&
+	    CLASS_ID_FROM_FLAG(flags) == 0 && ARENA_ID_FROM_FLAG(flags) == 0 &&
+	    palloc_prezero_alloc(&pop->heap,
+			oidp != NULL ? &oidp->off : NULL, size,
+			type_num, object_flags, ctx) == 0) {
+		pmalloc_operation_release(pop);
+
+		return 0;
+	}
+
+	int ret = palloc_operation(&pop->heap, 0,
+			oidp != NULL ? &oidp->off : NULL, size,
+			constructor_alloc, &carg, type_num, object_flags,
+			CLASS_ID_FROM_FLAG(flags), ARENA_ID_FROM_FLAG(flags),
+			ctx);
+
+	pmalloc_operation_release(pop);
+
+	return ret;
+}
+
+/*
+ * pmemobj_alloc -- allocates a new object
+ */
+int
+pmemobj_alloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
+	uint64_t type_num, pmemobj_constr constructor, void *arg)
+{
+	LOG(3, "pop %p oidp %p size %zu type_num %llx constructor %p arg %p",
+		pop, oidp, size, (unsigned long long)type_num,
+		constructor, arg);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	if (size == 0) {
+		ERR_WO_ERRNO("allocation with size 0");
+		errno = EINVAL;
+		return -1;
+	}
+
+	PMEMOBJ_API_START();
+	int ret = obj_alloc_construct(pop, oidp, size, type_num,
+			0, constructor, arg);
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * pmemobj_xalloc -- allocates with flags
+ */
+int
+pmemobj_xalloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
+	uint64_t type_num, uint64_t flags,
+	pmemobj_constr constructor, void *arg)
+{
+	LOG(3, "pop %p oidp %p size %zu type_num %llx flags %llx "
+		"constructor %p arg %p",
+		pop, oidp, size, (unsigned long long)type_num,
+		(unsigned long long)flags,
+		constructor, arg);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	if (size == 0) {
+		ERR_WO_ERRNO("allocation with size 0");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (flags & ~POBJ_TX_XALLOC_VALID_FLAGS) {
+		ERR_WO_ERRNO("unknown flags 0x%" PRIx64,
+				flags & ~POBJ_TX_XALLOC_VALID_FLAGS);
+		errno = EINVAL;
+		return -1;
+	}
+
+	PMEMOBJ_API_START();
+	int ret = obj_alloc_construct(pop, oidp, size, type_num,
+			flags, constructor, arg);
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * pmemobj_xalloc_near -- allocates with flags and a placement hint
+ *
+ * The allocation is biased toward the heap zone that contains the hint
+ * object, so that objects accessed together share as few zones as possible.
+ * Runs are per allocation class, so the hint cannot select an exact run - it
+ * only narrows down the zone a run is reused from, and it is best-effort:
+ * when the preferred zone has no suitable run, the allocation proceeds as if
+ * no hint was given.
+ */
+int
+pmemobj_xalloc_near(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
+	uint64_t type_num, uint64_t flags, PMEMoid hint,
+	pmemobj_constr constructor, void *arg)
+{
+	LOG(3, "pop %p oidp %p size %zu type_num %llx flags %llx "
+		"hint.off 0x%016" PRIx64 " constructor %p arg %p",
+		pop, oidp, size, (unsigned long long)type_num,
+		(unsigned long long)flags, hint.off, constructor, arg);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	if (size == 0) {
+		ERR_WO_ERRNO("allocation with size 0");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (flags & ~POBJ_TX_XALLOC_VALID_FLAGS) {
+		ERR_WO_ERRNO("unknown flags 0x%" PRIx64,
+				flags & ~POBJ_TX_XALLOC_VALID_FLAGS);
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!OBJ_OID_IS_VALID(pop, hint)) {
+		ERR_WO_ERRNO("invalid hint oid");
+		errno = EINVAL;
+		return -1;
+	}
+
+	PMEMOBJ_API_START();
+
+	if (!OBJ_OID_IS_NULL(hint))
+		heap_set_zone_preference(
+			heap_off_to_zone_id(&pop->heap, hint.off));
+
+	int ret = obj_alloc_construct(pop, oidp, size, type_num,
+			flags, constructor, arg);
+
+	heap_set_zone_preference(UINT32_MAX);
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * obj_alloc_multi_small -- (internal) allocates a batch of objects without
+ *	touching the DRAM allocator
+ */
+static int
+obj_alloc_multi_small(PMEMobjpool *pop, PMEMoid *oidv, size_t noids,
+	size_t size, type_num_t type_num, uint64_t flags)
+{
+	struct constr_args carg;
+
+	carg.zero_init = flags & POBJ_FLAG_ZERO;
+	carg.generation = 0;
+	carg.constructor = NULL;
+	carg.arg = NULL;
+
+	/*
+	 * Compact actions keep the batch on the stack; the full actions are
+	 * transiently rebuilt by palloc at publish time.
+	 */
+	struct pobj_action_compact cactv[PALLOC_COMPACT_ACTIONS_MAX];
+	struct pobj_action act;
+
+	size_t nreserved;
+	for (nreserved = 0; nreserved < noids; ++nreserved) {
+		if (palloc_reserve(&pop->heap, size, constructor_alloc, &carg,
+			type_num, 0, CLASS_ID_FROM_FLAG(flags),
+			ARENA_ID_FROM_FLAG(flags), &act) != 0)
+			goto err_reserve;
+		palloc_action_compact(&pop->heap, &act, &cactv[nreserved]);
+	}
+
+	struct operation_context *ctx = pmalloc_operation_hold(pop);
+
+	/*
+	 * Each published action translates into a single metadata entry, and
+	 * one inline byte-range entry - the size of two value entries - sets
+	 * each PMEMoid.
+	 */
+	size_t entries_size = noids * 3 * sizeof(struct ulog_entry_val);
+	if (operation_reserve(ctx, entries_size) != 0) {
+		pmalloc_operation_release(pop);
+		goto err_reserve;
+	}
+
+	for (size_t i = 0; i < noids; ++i) {
+		PMEMoid oid = {pop->uuid_lo, cactv[i].offset};
+		operation_add_range_entry(ctx, &oidv[i], &oid, sizeof(oid));
+	}
+
+	palloc_publish_compact(&pop->heap, cactv, noids, ctx);
+
+	pmalloc_operation_release(pop);
+
+	return 0;
+
+err_reserve:
+	palloc_cancel_compact(&pop->heap, cactv, nreserved);
+	return -1;
+}
+
+/*
+ * obj_alloc_multi -- (internal) atomically allocates a batch of objects
+ *
+ * All objects are first reserved in the transient state and only then
+ * published together, so the redo log is persisted and processed once for
+ * the whole batch instead of once per object.
+ */
+static int
+obj_alloc_multi(PMEMobjpool *pop, PMEMoid *oidv, size_t noids, size_t size,
+	type_num_t type_num, uint64_t flags)
+{
+	if (noids <= PALLOC_COMPACT_ACTIONS_MAX)
+		return obj_alloc_multi_small(pop, oidv, noids, size,
+			type_num, flags);
+
+	struct constr_args carg;
+
+	carg.zero_init = flags & POBJ_FLAG_ZERO;
+	carg.generation = 0;
+	carg.constructor = NULL;
+	carg.arg = NULL;
+
+	struct pobj_action *actv = Malloc(noids * sizeof(*actv));
+	if (actv == NULL)
+		return -1;
+
+	size_t nreserved;
+	for (nreserved = 0; nreserved < noids; ++nreserved) {
+		if (palloc_reserve(&pop->heap, size, constructor_alloc, &carg,
+			type_num, 0, CLASS_ID_FROM_FLAG(flags),
+			ARENA_ID_FROM_FLAG(flags), &actv[nreserved]) != 0)
+			goto err_reserve;
+	}
+
+	struct operation_context *ctx = pmalloc_operation_hold(pop);
+
+	/*
+	 * Each published action translates into a single metadata entry, and
+	 * one inline byte-range entry - the size of two value entries - sets
+	 * each PMEMoid.
+	 */
+	size_t entries_size = noids * 3 * sizeof(struct ulog_entry_val);
+	if (operation_reserve(ctx, entries_size) != 0) {
+		pmalloc_operation_release(pop);
+		goto err_reserve;
+	}
+
+	for (size_t i = 0; i < noids; ++i) {
+		PMEMoid oid = {pop->uuid_lo, actv[i].heap.offset};
+		operation_add_range_entry(ctx, &oidv[i], &oid, sizeof(oid));
+	}
+
+	palloc_publish(&pop->heap, actv, noids, ctx);
+
+	pmalloc_operation_release(pop);
+
+	Free(actv);
+
+	return 0;
+
+err_reserve:
+	palloc_cancel(&pop->heap, actv, nreserved);
+	Free(actv);
+	return -1;
+}
+
+/*
+ * pmemobj_alloc_multi -- atomically allocates a batch of objects of the same
+ *	size and type
+ */
+int
+pmemobj_alloc_multi(PMEMobjpool *pop, PMEMoid *oidv, size_t noids, size_t size,
+	uint64_t type_num, uint64_t flags)
+{
+	LOG(3, "pop %p oidv %p noids %zu size %zu type_num %llx flags %llx",
+		pop, oidv, noids, size, (unsigned long long)type_num,
+		(unsigned long long)flags);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	if (size == 0) {
+		ERR_WO_ERRNO("allocation with size 0");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (noids == 0 || oidv == NULL) {
+		ERR_WO_ERRNO("no objects to allocate");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (size > PMEMOBJ_MAX_ALLOC_SIZE) {
+		ERR_DEFER_WO_ERRNO("requested size too large");
+		errno = ENOMEM;
+		return -1;
+	}
+
+	if (flags & ~POBJ_ACTION_XRESERVE_VALID_FLAGS) {
+		ERR_WO_ERRNO("unknown flags 0x%" PRIx64,
+				flags & ~POBJ_ACTION_XRESERVE_VALID_FLAGS);
+		errno = EINVAL;
+		return -1;
+	}
+
+	PMEMOBJ_API_START();
+	int ret = obj_alloc_multi(pop, oidv, noids, size, type_num, flags);
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * Persistent layout of an array allocation: one header followed by nslots
+ * fixed-stride slots. A single allocation header serves the entire array.
+ */
+struct pobj_array_hdr {
+	uint64_t nslots;
+	uint64_t stride;
+};
+
+/* distance, in bytes, the array iteration prefetches ahead of the callback */
+#define OBJ_ARRAY_PREFETCH_DISTANCE 512
+
+/* arguments for constructor_array */
+struct carg_array {
+	uint64_t nslots;
+	uint64_t stride;
+};
+
+/*
+ * constructor_array -- (internal) constructor of a persistent array
+ */
+static int
+constructor_array(PMEMobjpool *pop, void *ptr, void *arg)
+{
+	LOG(3, "pop %p ptr %p arg %p", pop, ptr, arg);
+
+	struct carg_array *carg = arg;
+	struct pobj_array_hdr *hdr = ptr;
+
+	hdr->nslots = carg->nslots;
+	hdr->stride = carg->stride;
+	pmemops_persist(&pop->p_ops, hdr, sizeof(*hdr));
+
+	return 0;
+}
+
+/*
+ * obj_array_hdr -- (internal) returns the array header the oid points to
+ */
+static struct pobj_array_hdr *
+obj_array_hdr(PMEMoid array)
+{
+	if (array.off == 0 || array.pool_uuid_lo == 0)
+		return NULL;
+
+	return pmemobj_direct(array);
+}
+
+/*
+ * pmemobj_array_alloc -- allocates a persistent array of fixed-stride slots
+ */
+int
+pmemobj_array_alloc(PMEMobjpool *pop, PMEMoid *oidp, size_t nslots,
+	size_t stride, uint64_t type_num, uint64_t flags)
+{
+	LOG(3, "pop %p oidp %p nslots %zu stride %zu type_num %llx flags %llx",
+		pop, oidp, nslots, stride, (unsigned long long)type_num,
+		(unsigned long long)flags);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	if (nslots == 0 || stride == 0) {
+		ERR_WO_ERRNO("allocation with size 0");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (nslots > (PMEMOBJ_MAX_ALLOC_SIZE -
+			sizeof(struct pobj_array_hdr)) / stride) {
+		ERR_DEFER_WO_ERRNO("requested size too large");
+		errno = ENOMEM;
+		return -1;
+	}
+
+	if (flags & ~POBJ_ACTION_XRESERVE_VALID_FLAGS) {
+		ERR_WO_ERRNO("unknown flags 0x%" PRIx64,
+				flags & ~POBJ_ACTION_XRESERVE_VALID_FLAGS);
+		errno = EINVAL;
+		return -1;
+	}
+
+	struct carg_array carg;
+	carg.nslots = nslots;
+	carg.stride = stride;
+
+	PMEMOBJ_API_START();
+	int ret = obj_alloc_construct(pop, oidp,
+			sizeof(struct pobj_array_hdr) + nslots * stride,
+			type_num, flags, constructor_array, &carg);
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * pmemobj_array_at -- returns the oid of the idx-th slot of the array
+ */
+PMEMoid
+pmemobj_array_at(PMEMoid array, size_t idx)
+{
+	struct pobj_array_hdr *hdr = obj_array_hdr(array);
+	if (hdr == NULL || idx >= hdr->nslots)
+		return OID_NULL;
+
+	PMEMoid slot;
+	slot.pool_uuid_lo = array.pool_uuid_lo;
+	slot.off = array.off + sizeof(*hdr) + idx * hdr->stride;
+
+	return slot;
+}
+
+/*
+ * pmemobj_array_nslots -- returns the number of slots of the array
+ */
+size_t
+pmemobj_array_nslots(PMEMoid array)
+{
+	struct pobj_array_hdr *hdr = obj_array_hdr(array);
+
+	return hdr != NULL ? hdr->nslots : 0;
+}
+
+/*
+ * pmemobj_array_stride -- returns the stride of the array
+ */
+size_t
+pmemobj_array_stride(PMEMoid array)
+{
+	struct pobj_array_hdr *hdr = obj_array_hdr(array);
+
+	return hdr != NULL ? hdr->stride : 0;
+}
+
+/*
+ * pmemobj_array_foreach -- iterates over all slots of the array in index
+ *	order, prefetching ahead of the callback
+ */
+int
+pmemobj_array_foreach(PMEMoid array, pmemobj_array_cb cb, void *arg)
+{
+	LOG(3, "array.off 0x%016" PRIx64 " cb %p arg %p", array.off, cb, arg);
+
+	struct pobj_array_hdr *hdr = obj_array_hdr(array);
+	if (hdr == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	char *slot = (char *)(hdr + 1);
+	char *end = slot + hdr->nslots * hdr->stride;
+
+	for (size_t i = 0; i < hdr->nslots; ++i, slot += hdr->stride) {
+		if (slot + OBJ_ARRAY_PREFETCH_DISTANCE < end)
+			__builtin_prefetch(slot + OBJ_ARRAY_PREFETCH_DISTANCE,
+				0, 3);
+
+		int ret = cb(i, slot, arg);
+		if (ret != 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+/* arguments for constructor_realloc and constructor_zrealloc */
+struct carg_realloc {
+	void *ptr;
+	size_t old_size;
+	size_t new_size;
+	int zero_init;
+	type_num_t user_type;
+	pmemobj_constr constructor;
+	void *arg;
+};
+
+/*
+ * pmemobj_zalloc -- allocates a new zeroed object
+ */
+int
+pmemobj_zalloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
+		uint64_t type_num)
+{
+	LOG(3, "pop %p oidp %p size %zu type_num %llx",
+			pop, oidp, size, (unsigned long long)type_num);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	if (size == 0) {
+		ERR_WO_ERRNO("allocation with size 0");
+		errno = EINVAL;
+		return -1;
+	}
+
+	PMEMOBJ_API_START();
+	int ret = obj_alloc_construct(pop, oidp, size, type_num, POBJ_FLAG_ZERO,
+		NULL, NULL);
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * obj_free -- (internal) free an object
+ */
+static void
+obj_free(PMEMobjpool *pop, PMEMoid *oidp)
+{
+	ASSERTne(oidp, NULL);
+
+	struct operation_context *ctx = pmalloc_operation_hold(pop);
+
+	operation_add_entry(ctx, &oidp->pool_uuid_lo, 0, ULOG_OPERATION_SET);
+
+	palloc_operation(&pop->heap, oidp->off, &oidp->off, 0, NULL, NULL,
+			0, 0, 0, 0, ctx);
+
+	pmalloc_operation_release(pop);
+}
+
+/*
+ * constructor_realloc -- (internal) constructor for pmemobj_realloc
+ */
+static int
+constructor_realloc(void *ctx, void *ptr, size_t usable_size, void *arg)
+{
+	PMEMobjpool *pop = ctx;
+	LOG(3, "pop %p ptr %p arg %p", pop, ptr, arg);
+	struct pmem_ops *p_ops = &pop->p_ops;
+
+	ASSERTne(ptr, NULL);
+	ASSERTne(arg, NULL);
+
+	struct carg_realloc *carg = arg;
+
+	if (!carg->zero_init)
+		return 0;
+
+	if (usable_size > carg->old_size) {
+		size_t grow_len = usable_size - carg->old_size;
+		void *new_data_ptr = (void *)((uintptr_t)ptr + carg->old_size);
+
+		pmemops_memset(p_ops, new_data_ptr, 0, grow_len, 0);
+	}
+
+	return 0;
+}
+
+/*
+ * obj_realloc_common -- (internal) common routine for resizing
+ *                          existing objects
+ */
+static int
+obj_realloc_common(PMEMobjpool *pop,
+	PMEMoid *oidp, size_t size, type_num_t type_num, int zero_init)
+{
+	/* if OID is NULL just allocate memory */
+	if (OBJ_OID_IS_NULL(*oidp)) {
+		/* if size is 0 - do nothing */
+		if (size == 0)
+			return 0;
+
+		return obj_alloc_construct(pop, oidp, size, type_num,
+				POBJ_FLAG_ZERO, NULL, NULL);
+	}
+
+	if (size > PMEMOBJ_MAX_ALLOC_SIZE) {
+		ERR_DEFER_WO_ERRNO("requested size too large");
+		errno = ENOMEM;
+		return -1;
+	}
+
+	/* if size is 0 just free */
+	if (size == 0) {
+		obj_free(pop, oidp);
+		return 0;
+	}
+
+	struct carg_realloc carg;
+	carg.ptr = OBJ_OFF_TO_PTR(pop, oidp->off);
+	carg.new_size = size;
+	carg.old_size = pmemobj_alloc_usable_size(*oidp);
+	carg.user_type = type_num;
+	carg.constructor = NULL;
+	carg.arg = NULL;
+	carg.zero_init = zero_init;
+
+	struct operation_context *ctx = pmalloc_operation_hold(pop);
+
+	int ret = palloc_operation(&pop->heap, oidp->off, &oidp->off,
+			size, constructor_realloc, &carg, type_num,
+			0, 0, 0, ctx);
+
+	pmalloc_operation_release(pop);
+
+	return ret;
+}
+
+/*
+ * constructor_zrealloc_root -- (internal) constructor for pmemobj_root
+ */
+static int
+constructor_zrealloc_root(void *ctx, void *ptr, size_t usable_size, void *arg)
+{
+	PMEMobjpool *pop = ctx;
+	LOG(3, "pop %p ptr %p arg %p", pop, ptr, arg);
+
+	ASSERTne(ptr, NULL);
+	ASSERTne(arg, NULL);
+
+	VALGRIND_ADD_TO_TX(ptr, usable_size);
+
+	struct carg_realloc *carg = arg;
+
+	constructor_realloc(pop, ptr, usable_size, arg);
+	int ret = 0;
+	if (carg->constructor)
+		ret = carg->constructor(pop, ptr, carg->arg);
+
+	VALGRIND_REMOVE_FROM_TX(ptr, usable_size);
+
+	return ret;
+}
+
+/*
+ * pmemobj_realloc -- resizes an existing object
+ */
+int
+pmemobj_realloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
+		uint64_t type_num)
+{
+	ASSERTne(oidp, NULL);
+
+	LOG(3, "pop %p oid.off 0x%016" PRIx64 " size %zu type_num %" PRIu64,
+		pop, oidp->off, size, type_num);
+
+	PMEMOBJ_API_START();
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+	ASSERT(OBJ_OID_IS_VALID(pop, *oidp));
+
+	int ret = obj_realloc_common(pop, oidp, size, (type_num_t)type_num, 0);
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * pmemobj_zrealloc -- resizes an existing object, any new space is zeroed.
+ */
+int
+pmemobj_zrealloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
+		uint64_t type_num)
+{
+	ASSERTne(oidp, NULL);
+
+	LOG(3, "pop %p oid.off 0x%016" PRIx64 " size %zu type_num %" PRIu64,
+		pop, oidp->off, size, type_num);
+
+	PMEMOBJ_API_START();
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+	ASSERT(OBJ_OID_IS_VALID(pop, *oidp));
+
+	int ret = obj_realloc_common(pop, oidp, size, (type_num_t)type_num, 1);
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/* arguments for constructor_strdup */
+struct carg_strdup {
+	size_t size;
+	const char *s;
+};
+
+/*
+ * constructor_strdup -- (internal) constructor of pmemobj_strdup
+ */
+static int
+constructor_strdup(PMEMobjpool *pop, void *ptr, void *arg)
+{
+	LOG(3, "pop %p ptr %p arg %p", pop, ptr, arg);
+
+	ASSERTne(ptr, NULL);
+	ASSERTne(arg, NULL);
+
+	struct carg_strdup *carg = arg;
+
+	/* copy string */
+	pmemops_memcpy(&pop->p_ops, ptr, carg->s, carg->size, 0);
+
+	return 0;
+}
+
+/*
+ * pmemobj_strdup -- allocates a new object with duplicate of the string s.
+ */
+int
+pmemobj_strdup(PMEMobjpool *pop, PMEMoid *oidp, const char *s,
+		uint64_t type_num)
+{
+	LOG(3, "pop %p oidp %p string %s type_num %" PRIu64,
+	    pop, oidp, s, type_num);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	if (NULL == s) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	PMEMOBJ_API_START();
+	struct carg_strdup carg;
+	carg.size = (strlen(s) + 1) * sizeof(char);
+	carg.s = s;
+
+	int ret = obj_alloc_construct(pop, oidp, carg.size,
+		(type_num_t)type_num, 0, constructor_strdup, &carg);
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/* arguments for constructor_wcsdup */
+struct carg_wcsdup {
+	size_t size;
+	const wchar_t *s;
+};
+
+/*
+ * constructor_wcsdup -- (internal) constructor of pmemobj_wcsdup
+ */
+static int
+constructor_wcsdup(PMEMobjpool *pop, void *ptr, void *arg)
+{
+	LOG(3, "pop %p ptr %p arg %p", pop, ptr, arg);
+
+	ASSERTne(ptr, NULL);
+	ASSERTne(arg, NULL);
+
+	struct carg_wcsdup *carg = arg;
+
+	/* copy string */
+	pmemops_memcpy(&pop->p_ops, ptr, carg->s, carg->size, 0);
+
+	return 0;
+}
+
+/*
+ * pmemobj_wcsdup -- allocates a new object with duplicate of the wide character
+ * string s.
+ */
+int
+pmemobj_wcsdup(PMEMobjpool *pop, PMEMoid *oidp, const wchar_t *s,
+	uint64_t type_num)
+{
+	LOG(3, "pop %p oidp %p string %S type_num %" PRIu64,
+		    pop, oidp, s, type_num);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	if (NULL == s) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	PMEMOBJ_API_START();
+	struct carg_wcsdup carg;
+	carg.size = (wcslen(s) + 1) * sizeof(wchar_t);
+	carg.s = s;
+
+	int ret = obj_alloc_construct(pop, oidp, carg.size,
+		(type_num_t)type_num, 0, constructor_wcsdup, &carg);
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * pmemobj_free -- frees an existing object
+ */
+void
+pmemobj_free(PMEMoid *oidp)
+{
+	ASSERTne(oidp, NULL);
+
+	LOG(3, "oid.off 0x%016" PRIx64, oidp->off);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	if (oidp->off == 0)
+		return;
+
+	PMEMOBJ_API_START();
+	PMEMobjpool *pop = pmemobj_pool_by_oid(*oidp);
+
+	ASSERTne(pop, NULL);
+	ASSERT(OBJ_OID_IS_VALID(pop, *oidp));
+
+	obj_free(pop, oidp);
+	PMEMOBJ_API_END();
+}
+
+/*
+ * pmemobj_alloc_usable_size -- returns usable size of object
+ */
+size_t
+pmemobj_alloc_usable_size(PMEMoid oid)
+{
+	LOG(3, "oid.off 0x%016" PRIx64, oid.off);
+
+	if (oid.off == 0)
+		return 0;
+
+	PMEMobjpool *pop = pmemobj_pool_by_oid(oid);
+
+	ASSERTne(pop, NULL);
+	ASSERT(OBJ_OID_IS_VALID(pop, oid));
+
+	size_t size = palloc_usable_size(&pop->heap, oid.off);
+
+	/* the generation counter is not part of the user-visible object */
+	if (palloc_flags(&pop->heap, oid.off) & OBJ_GENERATION_MASK)
+		size -= sizeof(uint64_t);
+
+	return size;
+}
+
+/*
+ * pmemobj_memcpy_persist -- pmemobj version of memcpy
+ */
+void *
+pmemobj_memcpy_persist(PMEMobjpool *pop, void *dest, const void *src,
+	size_t len)
+{
+	LOG(15, "pop %p dest %p src %p len %zu", pop, dest, src, len);
+	PMEMOBJ_API_START();
+
+	void *ptr = pmemops_memcpy(&pop->p_ops, dest, src, len, 0);
+
+	PMEMOBJ_API_END();
+	return ptr;
+}
+
+/*
+ * pmemobj_memset_persist -- pmemobj version of memset
+ */
+void *
+pmemobj_memset_persist(PMEMobjpool *pop, void *dest, int c, size_t len)
+{
+	LOG(15, "pop %p dest %p c 0x%02x len %zu", pop, dest, c, len);
+	PMEMOBJ_API_START();
+
+	void *ptr = pmemops_memset(&pop->p_ops, dest, c, len, 0);
+
+	PMEMOBJ_API_END();
+	return ptr;
+}
+
+/*
+ * pmemobj_memcpy -- pmemobj version of memcpy
+ */
+void *
+pmemobj_memcpy(PMEMobjpool *pop, void *dest, const void *src, size_t len,
+		unsigned flags)
+{
+	LOG(15, "pop %p dest %p src %p len %zu flags 0x%x", pop, dest, src, len,
+			flags);
+
+	PMEMOBJ_API_START();
+
+	void *ptr = pmemops_memcpy(&pop->p_ops, dest, src, len, flags);
+
+	PMEMOBJ_API_END();
+	return ptr;
+}
+
+/*
+ * pmemobj_memmove -- pmemobj version of memmove
+ */
+void *
+pmemobj_memmove(PMEMobjpool *pop, void *dest, const void *src, size_t len,
+		unsigned flags)
+{
+	LOG(15, "pop %p dest %p src %p len %zu flags 0x%x", pop, dest, src, len,
+			flags);
+
+	PMEMOBJ_API_START();
+
+	void *ptr = pmemops_memmove(&pop->p_ops, dest, src, len, flags);
+
+	PMEMOBJ_API_END();
+	return ptr;
+}
+
+/*
+ * pmemobj_memset -- pmemobj version of memset
+ */
+void *
+pmemobj_memset(PMEMobjpool *pop, void *dest, int c, size_t len, unsigned flags)
+{
+	LOG(15, "pop %p dest %p c 0x%02x len %zu flags 0x%x", pop, dest, c, len,
+			flags);
+
+	PMEMOBJ_API_START();
+
+	void *ptr = pmemops_memset(&pop->p_ops, dest, c, len, flags);
+
+	PMEMOBJ_API_END();
+	return ptr;
+}
+
+/*
+ * Depth of the thread's drain group, see pmemobj_drain_group_begin().
+ */
+static __thread unsigned Drain_group_level;
+
+/*
+ * obj_drain_deferrable -- (internal) checks whether the drain of an explicit
+ *	persist can be deferred to the end of the thread's drain group
+ *
+ * Only pmem pools qualify - for non-pmem pools the persist is an msync and
+ * there is nothing to batch.
+ */
+static int
+obj_drain_deferrable(PMEMobjpool *pop)
+{
+	return Drain_group_level != 0 && pop->is_pmem;
+}
+
+/*
+ * pmemobj_drain_group_begin -- start deferring drains of explicit persists
+ *
+ * Until the matching pmemobj_drain_group_end(), pmemobj_persist(),
+ * pmemobj_xpersist() and pmemobj_drain() called by this thread on pmem pools
+ * only flush the data. The single drain issued at the end of the group
+ * orders all of them, no matter how many pools the writes spanned. Groups
+ * nest; only the outermost end drains.
+ */
+void
+pmemobj_drain_group_begin(void)
+{
+	LOG(15, NULL);
+
+	Drain_group_level++;
+}
+
+/*
+ * pmemobj_drain_group_end -- conclude the drain group with a single drain
+ */
+void
+pmemobj_drain_group_end(void)
+{
+	LOG(15, NULL);
+
+	ASSERTne(Drain_group_level, 0);
+
+	if (--Drain_group_level == 0)
+		pmem_drain();
+}
+
+/*
+ * Capacity of the thread's epoch range buffer. When it overflows, the
+ * recorded ranges are flushed early and recording starts over - the epoch
+ * stays correct, only less amortized.
+ */
+#define EPOCH_MAX_RANGES 128
+
+/*
+ * Per-thread flush epoch, see pmemobj_epoch_begin().
+ */
+static __thread struct {
+	PMEMobjpool *pop;	/* the pool the epoch was opened on */
+	unsigned level;		/* nesting depth */
+	size_t nranges;
+	struct {
+		uintptr_t addr;
+		size_t len;
+	} ranges[EPOCH_MAX_RANGES];
+} Epoch;
+
+/*
+ * obj_epoch_active -- (internal) checks whether the calling thread defers
+ *	explicit persists of the given pool to the end of its epoch
+ */
+static int
+obj_epoch_active(PMEMobjpool *pop)
+{
+	return Epoch.level != 0 && Epoch.pop == pop;
+}
+
+/*
+ * obj_epoch_flush -- (internal) flush all the ranges recorded in the
+ *	thread's epoch and empty the buffer; does not drain
+ */
+static void
+obj_epoch_flush(void)
+{
+	PMEMobjpool *pop = Epoch.pop;
+
+	for (size_t i = 0; i < Epoch.nranges; ++i)
+		pmemops_flush(&pop->p_ops, (void *)Epoch.ranges[i].addr,
+				Epoch.ranges[i].len);
+
+	Epoch.nranges = 0;
+}
+
+/*
+ * obj_epoch_record -- (internal) record a range in the thread's epoch,
+ *	merging it with an adjacent or overlapping one when possible
+ */
+static void
+obj_epoch_record(const void *addr, size_t len)
+{
+	uintptr_t beg = (uintptr_t)addr;
+	uintptr_t end = beg + len;
+
+	for (size_t i = 0; i < Epoch.nranges; ++i) {
+		uintptr_t rbeg = Epoch.ranges[i].addr;
+		uintptr_t rend = rbeg + Epoch.ranges[i].len;
+		if (beg > rend || end < rbeg)
+			continue;
+
+		rbeg = rbeg < beg ? rbeg : beg;
+		rend = rend > end ? rend : end;
+		Epoch.ranges[i].addr = rbeg;
+		Epoch.ranges[i].len = rend - rbeg;
+		return;
+	}
+
+	if (Epoch.nranges == EPOCH_MAX_RANGES)
+		obj_epoch_flush();
+
+	Epoch.ranges[Epoch.nranges].addr = beg;
+	Epoch.ranges[Epoch.nranges].len = len;
+	Epoch.nranges++;
+}
+
+/*
+ * pmemobj_epoch_begin -- start a flush epoch on the pool
+ *
+ * Until the matching pmemobj_epoch_end(), explicit persists, flushes and
+ * drains issued by this thread on this pool are not executed - the ranges
+ * are recorded and merged instead, and the end of the epoch flushes them
+ * with a single concluding drain. The data is therefore not durable until
+ * the epoch ends. Transactional and allocator metadata persists are not
+ * affected; they keep their ordering so an interrupted epoch loses at most
+ * the user data written within it. Epochs nest; only the outermost end
+ * flushes. A thread can have an epoch open on one pool at a time.
+ */
+int
+pmemobj_epoch_begin(PMEMobjpool *pop)
+{
+	LOG(15, "pop %p", pop);
+
+	if (Epoch.level != 0 && Epoch.pop != pop) {
+		errno = EINVAL;
+		ERR_WO_ERRNO(
+			"an epoch on a different pool is already open");
+		return -1;
+	}
+
+	Epoch.pop = pop;
+	Epoch.level++;
+
+	return 0;
+}
+
+/*
+ * pmemobj_epoch_end -- flush the ranges recorded in the epoch and conclude
+ *	it with a single drain
+ */
+void
+pmemobj_epoch_end(PMEMobjpool *pop)
+{
+	LOG(15, "pop %p", pop);
+
+	ASSERTne(Epoch.level, 0);
+	ASSERTeq(Epoch.pop, pop);
+
+	if (--Epoch.level != 0)
+		return;
+
+	obj_epoch_flush();
+	pmemops_drain(&pop->p_ops);
+	Epoch.pop = NULL;
+}
+
+/*
+ * pmemobj_persist -- pmemobj version of pmem_persist
+ */
+void
+pmemobj_persist(PMEMobjpool *pop, const void *addr, size_t len)
+{
+	LOG(15, "pop %p addr %p len %zu", pop, addr, len);
+
+	if (obj_epoch_active(pop)) {
+		obj_epoch_record(addr, len);
+		return;
+	}
+
+	if (obj_drain_deferrable(pop)) {
+		pmemops_flush(&pop->p_ops, addr, len);
+		return;
+	}
+
+	pmemops_persist(&pop->p_ops, addr, len);
+}
+
+/*
+ * pmemobj_flush -- pmemobj version of pmem_flush
+ */
+void
+pmemobj_flush(PMEMobjpool *pop, const void *addr, size_t len)
+{
+	LOG(15, "pop %p addr %p len %zu", pop, addr, len);
+
+	if (obj_epoch_active(pop)) {
+		obj_epoch_record(addr, len);
+		return;
+	}
+
+	pmemops_flush(&pop->p_ops, addr, len);
+}
+
+/*
+ * pmemobj_xpersist -- pmemobj version of pmem_persist with additional flags
+ * argument
+ */
+int
+pmemobj_xpersist(PMEMobjpool *pop, const void *addr, size_t len, unsigned flags)
+{
+	LOG(15, "pop %p addr %p len %zu", pop, addr, len);
+
+	if (flags & ~OBJ_X_VALID_FLAGS) {
+		errno = EINVAL;
+		ERR_WO_ERRNO("invalid flags 0x%x", flags);
+		return -1;
+	}
+
+	if (obj_epoch_active(pop)) {
+		obj_epoch_record(addr, len);
+		return 0;
+	}
+
+	if (obj_drain_deferrable(pop))
+		return pmemops_xflush(&pop->p_ops, addr, len, flags);
+
+	return pmemops_xpersist(&pop->p_ops, addr, len, flags);
+}
+
+/*
+ * pmemobj_xflush -- pmemobj version of pmem_flush with additional flags
+ * argument
+ */
+int
+pmemobj_xflush(PMEMobjpool *pop, const void *addr, size_t len, unsigned flags)
+{
+	LOG(15, "pop %p addr %p len %zu", pop, addr, len);
+
+	if (flags & ~OBJ_X_VALID_FLAGS) {
+		errno = EINVAL;
+		ERR_WO_ERRNO("invalid flags 0x%x", flags);
+		return -1;
+	}
+
+	if (obj_epoch_active(pop)) {
+		obj_epoch_record(addr, len);
+		return 0;
+	}
+
+	return pmemops_xflush(&pop->p_ops, addr, len, flags);
+}
+
+/*
+ * pmemobj_drain -- pmemobj version of pmem_drain
+ */
+void
+pmemobj_drain(PMEMobjpool *pop)
+{
+	LOG(15, "pop %p", pop);
+
+	if (obj_epoch_active(pop))
+		return;
+
+	if (obj_drain_deferrable(pop))
+		return;
+
+	pmemops_drain(&pop->p_ops);
+}
+
+/*
+ * pmemobj_type_num -- returns type number of object
+ */
+uint64_t
+pmemobj_type_num(PMEMoid oid)
+{
+	LOG(3, "oid.off 0x%016" PRIx64, oid.off);
+
+	ASSERT(!OID_IS_NULL(oid));
+
+	PMEMobjpool *pop = pmemobj_pool_by_oid(oid);
+
+	ASSERTne(pop, NULL);
+	ASSERT(OBJ_OID_IS_VALID(pop, oid));
+
+	return palloc_extra(&pop->heap, oid.off);
+}
+
+/*
+ * pmemobj_generation -- reads the generation counter of a stamped object
+ */
+int
+pmemobj_generation(PMEMoid oid, uint64_t *genp)
+{
+	LOG(3, "oid.off 0x%016" PRIx64 " genp %p", oid.off, genp);
+
+	if (OID_IS_NULL(oid)) {
+		ERR_WO_ERRNO("NULL oid");
+		errno = EINVAL;
+		return -1;
+	}
+
+	PMEMobjpool *pop = pmemobj_pool_by_oid(oid);
+
+	ASSERTne(pop, NULL);
+	ASSERT(OBJ_OID_IS_VALID(pop, oid));
+
+	if ((palloc_flags(&pop->heap, oid.off) & OBJ_GENERATION_MASK) == 0) {
+		ERR_WO_ERRNO(
+			"object not allocated with POBJ_XALLOC_GENERATION");
+		errno = EINVAL;
+		return -1;
+	}
+
+	uint64_t gen_off = oid.off +
+		palloc_usable_size(&pop->heap, oid.off) - sizeof(uint64_t);
+
+	*genp = *(uint64_t *)((char *)pop + gen_off);
+
+	return 0;
+}
+
+/* arguments for constructor_alloc_root */
+struct carg_root {
+	size_t size;
+	pmemobj_constr constructor;
+	void *arg;
+};
+
+/*
+ * obj_realloc_root -- (internal) reallocate root object
+ */
+static int
+obj_alloc_root(PMEMobjpool *pop, size_t size,
+	pmemobj_constr constructor, void *arg)
+{
+	LOG(3, "pop %p size %zu", pop, size);
+
+	struct carg_realloc carg;
+
+	carg.ptr = OBJ_OFF_TO_PTR(pop, pop->root_offset);
+	carg.old_size = pop->root_size;
+	carg.new_size = size;
+	carg.user_type = POBJ_ROOT_TYPE_NUM;
+	carg.constructor = constructor;
+	carg.zero_init = 1;
+	carg.arg = arg;
+
+	struct operation_context *ctx = pmalloc_operation_hold(pop);
+
+	operation_add_entry(ctx, &pop->root_size, size, ULOG_OPERATION_SET);
+
+	int ret = palloc_operation(&pop->heap, pop->root_offset,
+			&pop->root_offset, size,
+			constructor_zrealloc_root, &carg,
+			POBJ_ROOT_TYPE_NUM, OBJ_INTERNAL_OBJECT_MASK,
+			0, 0, ctx);
+
+	pmalloc_operation_release(pop);
+
+	return ret;
+}
+
+/*
+ * pmemobj_root_size -- returns size of the root object
+ */
+size_t
+pmemobj_root_size(PMEMobjpool *pop)
+{
+	LOG(3, "pop %p", pop);
+
+	if (pop->root_offset && pop->root_size) {
+		return pop->root_size;
+	} else
+		return 0;
+}
+
+/*
+ * pmemobj_root_construct -- returns root object
+ */
+PMEMoid
+pmemobj_root_construct(PMEMobjpool *pop, size_t size,
+	pmemobj_constr constructor, void *arg)
+{
+	LOG(3, "pop %p size %zu constructor %p args %p", pop, size, constructor,
+		arg);
 
 	if (size > PMEMOBJ_MAX_ALLOC_SIZE) {
-		ERR_WO_ERRNO("requested size too large");
+		ERR_DEFER_WO_ERRNO("requested size too large");
 		errno = ENOMEM;
 		return OID_NULL;
 	}
 
-	if (size == 0 && pop->root_offset == 0) {
-		ERR_WO_ERRNO("requested size cannot equals zero");
-		errno = EINVAL;
-		return OID_NULL;
+	if (size == 0 && pop->root_offset == 0) {
+		ERR_WO_ERRNO("requested size cannot equals zero");
+		errno = EINVAL;
+		return OID_NULL;
+	}
+
+	PMEMOBJ_API_START();
+
+	PMEMoid root;
+
+	/*
+	 * The happy path - the root object already exists and is big enough -
+	 * is resolved with plain loads from the published descriptor. The
+	 * fields of a published version never change, so no locking or
+	 * retrying is needed; any resize publishes a new version.
+	 */
+	struct obj_root_desc *desc;
+	util_atomic_load_explicit64(&pop->root_desc, &desc,
+		memory_order_acquire);
+	if (desc != NULL && desc->off != 0 && size <= desc->size) {
+		root.pool_uuid_lo = pop->uuid_lo;
+		root.off = desc->off;
+
+		PMEMOBJ_API_END();
+		return root;
+	}
+
+	pmemobj_mutex_lock_nofail(pop, &pop->rootlock);
+
+	if (size > pop->root_size &&
+		obj_alloc_root(pop, size, constructor, arg)) {
+		pmemobj_mutex_unlock_nofail(pop, &pop->rootlock);
+		CORE_LOG_ERROR("obj_realloc_root failed");
+		PMEMOBJ_API_END();
+		return OID_NULL;
+	}
+
+	root.pool_uuid_lo = pop->uuid_lo;
+	root.off = pop->root_offset;
+
+	obj_root_desc_publish(pop);
+
+	pmemobj_mutex_unlock_nofail(pop, &pop->rootlock);
+
+	PMEMOBJ_API_END();
+	return root;
+}
+
+/*
+ * pmemobj_root -- returns root object
+ */
+PMEMoid
+pmemobj_root(PMEMobjpool *pop, size_t size)
+{
+	LOG(3, "pop %p size %zu", pop, size);
+
+	PMEMOBJ_API_START();
+	PMEMoid oid = pmemobj_root_construct(pop, size, NULL, NULL);
+	PMEMOBJ_API_END();
+	return oid;
+}
+
+/*
+ * pmemobj_first - returns first object of specified type
+ */
+PMEMoid
+pmemobj_first(PMEMobjpool *pop)
+{
+	LOG(3, "pop %p", pop);
+
+	PMEMoid ret = {0, 0};
+
+	uint64_t off = palloc_first(&pop->heap);
+	if (off != 0) {
+		ret.off = off;
+		ret.pool_uuid_lo = pop->uuid_lo;
+
+		if (palloc_flags(&pop->heap, off) & OBJ_INTERNAL_OBJECT_MASK) {
+			return pmemobj_next(ret);
+		}
+	}
+
+	return ret;
+}
+
+/*
+ * pmemobj_next - returns next object of specified type
+ */
+PMEMoid
+pmemobj_next(PMEMoid oid)
+{
+	LOG(3, "oid.off 0x%016" PRIx64, oid.off);
+
+	PMEMoid curr = oid;
+	if (curr.off == 0)
+		return OID_NULL;
+
+	PMEMobjpool *pop = pmemobj_pool_by_oid(curr);
+	ASSERTne(pop, NULL);
+
+	do {
+		ASSERT(OBJ_OID_IS_VALID(pop, curr));
+		uint64_t next_off = palloc_next(&pop->heap, curr.off);
+
+		if (next_off == 0)
+			return OID_NULL;
+
+		/* next object exists */
+		curr.off = next_off;
+
+	} while (palloc_flags(&pop->heap, curr.off) & OBJ_INTERNAL_OBJECT_MASK);
+
+	return curr;
+}
+
+/* the upper bound of the pmemobj_scan() lookahead ring */
+#define OBJ_SCAN_PREFETCH_MAX 64
+
+struct obj_scan_ctx {
+	PMEMobjpool *pop;
+	pmemobj_scan_cb *cb;
+	void *arg;
+
+	unsigned prefetch; /* lookahead distance (ring size) */
+	unsigned count;	   /* offsets buffered in the ring */
+	unsigned pos;	   /* ring position of the oldest offset */
+	uint64_t ring[OBJ_SCAN_PREFETCH_MAX];
+
+	int ret; /* the first non-zero callback return value */
+};
+
+/*
+ * obj_scan_invoke -- (internal) invokes the user callback for an object
+ */
+static int
+obj_scan_invoke(struct obj_scan_ctx *ctx, uint64_t off)
+{
+	PMEMoid oid = {ctx->pop->uuid_lo, off};
+
+	return ctx->ret = ctx->cb(oid, ctx->arg);
+}
+
+/*
+ * obj_scan_cb -- (internal) per-object callback of pmemobj_scan
+ *
+ * With prefetching enabled the freshly discovered object only has its
+ * data fetch issued here; the callback is invoked for it once another
+ * "prefetch" objects have been discovered, by which time the data
+ * should have arrived in the cache.
+ */
+static int
+obj_scan_cb(uint64_t off, void *arg)
+{
+	struct obj_scan_ctx *ctx = arg;
+
+	if (palloc_flags(&ctx->pop->heap, off) & OBJ_INTERNAL_OBJECT_MASK)
+		return 0;
+
+	if (ctx->prefetch == 0)
+		return obj_scan_invoke(ctx, off);
+
+	__builtin_prefetch((char *)ctx->pop + off, 0, 3);
+
+	uint64_t out = ctx->ring[ctx->pos];
+	ctx->ring[ctx->pos] = off;
+	ctx->pos = (ctx->pos + 1) % ctx->prefetch;
+
+	if (ctx->count < ctx->prefetch) {
+		ctx->count++;
+		return 0;
 	}
 
+	return obj_scan_invoke(ctx, out);
+}
+
+/*
+ * pmemobj_scan -- invokes the callback for every object in the pool in
+ *	physical order
+ */
+int
+pmemobj_scan(PMEMobjpool *pop, pmemobj_scan_cb *cb, void *arg,
+	unsigned prefetch)
+{
+	LOG(3, "pop %p cb %p arg %p prefetch %u", pop, cb, arg, prefetch);
+
 	PMEMOBJ_API_START();
 
-	PMEMoid root;
+	struct obj_scan_ctx ctx;
+	ctx.pop = pop;
+	ctx.cb = cb;
+	ctx.arg = arg;
+	ctx.prefetch = prefetch < OBJ_SCAN_PREFETCH_MAX ?
+		prefetch : OBJ_SCAN_PREFETCH_MAX;
+	ctx.count = 0;
+	ctx.pos = 0;
+	ctx.ret = 0;
+
+	palloc_foreach(&pop->heap, obj_scan_cb, &ctx);
+
+	/* objects still in flight when the heap ran out, in discovery order */
+	unsigned pos = (ctx.pos + ctx.prefetch - ctx.count) %
+		(ctx.prefetch == 0 ? 1 : ctx.prefetch);
+	while (ctx.ret == 0 && ctx.count > 0) {
+		if (obj_scan_invoke(&ctx, ctx.ring[pos]) != 0)
+			break;
+		pos = (pos + 1) % ctx.prefetch;
+		ctx.count--;
+	}
 
-	pmemobj_mutex_lock_nofail(pop, &pop->rootlock);
+	PMEMOBJ_API_END();
+	return ctx.ret;
+}
 
-	if (size > pop->root_size &&
-		obj_alloc_root(pop, size, constructor, arg)) {
-		pmemobj_mutex_unlock_nofail(pop, &pop->rootlock);
-		CORE_LOG_ERROR("obj_realloc_root failed");
+/*
+ * pmemobj_reserve -- reserves a single object
+ */
+PMEMoid
+pmemobj_reserve(PMEMobjpool *pop, struct pobj_action *act,
+	size_t size, uint64_t type_num)
+{
+	LOG(3, "pop %p act %p size %zu type_num %llx",
+		pop, act, size,
+		(unsigned long long)type_num);
+
+	PMEMOBJ_API_START();
+	PMEMoid oid = OID_NULL;
+
+	if (palloc_reserve(&pop->heap, size, NULL, NULL, type_num,
+		0, 0, 0, act) != 0) {
 		PMEMOBJ_API_END();
-		return OID_NULL;
+		return oid;
 	}
 
-	root.pool_uuid_lo = pop->uuid_lo;
-	root.off = pop->root_offset;
-
-	pmemobj_mutex_unlock_nofail(pop, &pop->rootlock);
+	oid.off = act->heap.offset;
+	oid.pool_uuid_lo = pop->uuid_lo;
 
 	PMEMOBJ_API_END();
-	return root;
+	return oid;
 }
 
 /*
- * pmemobj_root -- returns root object
+ * pmemobj_xreserve -- reserves a single object
  */
 PMEMoid
-pmemobj_root(PMEMobjpool *pop, size_t size)
+pmemobj_xreserve(PMEMobjpool *pop, struct pobj_action *act,
+	size_t size, uint64_t type_num, uint64_t flags)
 {
-	LOG(3, "pop %p size %zu", pop, size);
+	LOG(3, "pop %p act %p size %zu type_num %llx flags %llx",
+		pop, act, size,
+		(unsigned long long)type_num, (unsigned long long)flags);
+
+	PMEMoid oid = OID_NULL;
+
+	if (flags & ~POBJ_ACTION_XRESERVE_VALID_FLAGS) {
+		ERR_WO_ERRNO("unknown flags 0x%" PRIx64,
+				flags & ~POBJ_ACTION_XRESERVE_VALID_FLAGS);
+		errno = EINVAL;
+		return oid;
+	}
 
 	PMEMOBJ_API_START();
-	PMEMoid oid = pmemobj_root_construct(pop, size, NULL, NULL);
+	struct constr_args carg;
+
+	carg.zero_init = flags & POBJ_FLAG_ZERO;
+	carg.generation = 0;
+	carg.constructor = NULL;
+	carg.arg = NULL;
+
+	if (palloc_reserve(&pop->heap, size, constructor_alloc, &carg,
+		type_num, 0, CLASS_ID_FROM_FLAG(flags),
+		ARENA_ID_FROM_FLAG(flags), act) != 0) {
+		PMEMOBJ_API_END();
+		return oid;
+	}
+
+	oid.off = act->heap.offset;
+	oid.pool_uuid_lo = pop->uuid_lo;
+
 	PMEMOBJ_API_END();
 	return oid;
 }
 
 /*
- * pmemobj_first - returns first object of specified type
+ * pmemobj_set_value -- creates an action to set a value
  */
-PMEMoid
-pmemobj_first(PMEMobjpool *pop)
+void
+pmemobj_set_value(PMEMobjpool *pop, struct pobj_action *act,
+	uint64_t *ptr, uint64_t value)
 {
-	LOG(3, "pop %p", pop);
+	palloc_set_value(&pop->heap, act, ptr, value);
+}
 
-	PMEMoid ret = {0, 0};
+/*
+ * pmemobj_defer_free -- creates a deferred free action
+ */
+void
+pmemobj_defer_free(PMEMobjpool *pop, PMEMoid oid, struct pobj_action *act)
+{
+	ASSERT(!OID_IS_NULL(oid));
+	palloc_defer_free(&pop->heap, oid.off, act);
+}
 
-	uint64_t off = palloc_first(&pop->heap);
-	if (off != 0) {
-		ret.off = off;
-		ret.pool_uuid_lo = pop->uuid_lo;
+/*
+ * pmemobj_publish -- publishes a collection of actions
+ */
+int
+pmemobj_publish(PMEMobjpool *pop, struct pobj_action *actv, size_t actvcnt)
+{
+	PMEMOBJ_API_START();
+	struct operation_context *ctx = pmalloc_operation_hold(pop);
 
-		if (palloc_flags(&pop->heap, off) & OBJ_INTERNAL_OBJECT_MASK) {
-			return pmemobj_next(ret);
+	size_t entries_size = actvcnt * sizeof(struct ulog_entry_val);
+
+	if (operation_reserve(ctx, entries_size) != 0) {
+		PMEMOBJ_API_END();
+		return -1;
+	}
+
+	palloc_publish(&pop->heap, actv, actvcnt, ctx);
+
+	pmalloc_operation_release(pop);
+
+	PMEMOBJ_API_END();
+	return 0;
+}
+
+/*
+ * pmemobj_action_publish_after -- orders an action after another one for
+ *	pmemobj_publish_graph()
+ */
+void
+pmemobj_action_publish_after(struct pobj_action *act, uint32_t dep_index)
+{
+	palloc_action_publish_after(act, dep_index);
+}
+
+/*
+ * pmemobj_publish_graph -- publishes a collection of actions honoring their
+ *	publish-after annotations
+ *
+ * The actions are grouped into dependency levels - an unannotated action is
+ * at level zero, an annotated one directly above its dependency - and each
+ * level is published as one batch. Within a level the flushes of all actions
+ * overlap and a single drain covers them, while a level does not start until
+ * the previous one is durable, so every publish-after relationship holds.
+ *
+ * On failure -1 is returned; levels published before the failing one remain
+ * published, which is safe precisely because lower levels never depend on
+ * higher ones.
+ */
+int
+pmemobj_publish_graph(PMEMobjpool *pop, struct pobj_action *actv,
+	size_t actvcnt)
+{
+	PMEMOBJ_API_START();
+
+	/* an empty action vector is a no-op, as in pmemobj_publish() */
+	if (actvcnt == 0) {
+		PMEMOBJ_API_END();
+		return 0;
+	}
+
+	int ret = -1;
+
+	uint32_t *levelv = Malloc(actvcnt * sizeof(*levelv));
+	struct pobj_action *stage = Malloc(actvcnt * sizeof(*stage));
+	if (levelv == NULL || stage == NULL) {
+		ERR_W_ERRNO("Malloc");
+		goto out;
+	}
+
+	uint32_t max_level = 0;
+	for (size_t i = 0; i < actvcnt; ++i) {
+		uint32_t dep = palloc_action_publish_dep(&actv[i]);
+		if (dep == 0) {
+			levelv[i] = 0;
+			continue;
+		}
+
+		/* an action may only depend on an earlier one */
+		if ((size_t)dep > i) {
+			ERR_WO_ERRNO(
+				"action %zu depends on a non-preceding action",
+				i);
+			errno = EINVAL;
+			goto out;
+		}
+
+		levelv[i] = levelv[dep - 1] + 1;
+		if (levelv[i] > max_level)
+			max_level = levelv[i];
+	}
+
+	for (uint32_t l = 0; l <= max_level; ++l) {
+		size_t n = 0;
+		for (size_t i = 0; i < actvcnt; ++i) {
+			if (levelv[i] == l)
+				stage[n++] = actv[i];
 		}
+		ASSERTne(n, 0);
+
+		if (pmemobj_publish(pop, stage, n) != 0)
+			goto out;
 	}
 
+	ret = 0;
+out:
+	Free(stage);
+	Free(levelv);
+	PMEMOBJ_API_END();
 	return ret;
 }
 
 /*
- * pmemobj_next - returns next object of specified type
+ * pmemobj_cancel -- cancels collection of actions
+ */
+void
+pmemobj_cancel(PMEMobjpool *pop, struct pobj_action *actv, size_t actvcnt)
+{
+	PMEMOBJ_API_START();
+	palloc_cancel(&pop->heap, actv, actvcnt);
+	PMEMOBJ_API_END();
+}
+
+/*
+ * pmemobj_migrate -- migrates an object from one pool to another
+ *
+ * The new object is reserved in the destination pool and the data is copied
+ * directly between the two mapped pools with non-temporal stores, so no
+ * user-space bounce buffer is involved. The destination publish and the
+ * source free are each committed through their own pool's redo log; the
+ * publish happens first, so a crash between the two commits leaves the object
+ * present in both pools, never in neither.
+ */
+int
+pmemobj_migrate(PMEMobjpool *src, PMEMobjpool *dst, PMEMoid oid,
+	PMEMoid *oidp)
+{
+	LOG(3, "src %p dst %p oid.off 0x%016" PRIx64 " oidp %p",
+		src, dst, oid.off, oidp);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	if (oid.off == 0 || !OBJ_OID_IS_VALID(src, oid)) {
+		ERR_WO_ERRNO("invalid source object");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (src == dst) {
+		ERR_WO_ERRNO("source and destination are the same pool");
+		errno = EINVAL;
+		return -1;
+	}
+
+	PMEMOBJ_API_START();
+
+	size_t size = palloc_usable_size(&src->heap, oid.off);
+	uint64_t type_num = palloc_extra(&src->heap, oid.off);
+
+	struct pobj_action act;
+	if (palloc_reserve(&dst->heap, size, NULL, NULL, type_num,
+			0, 0, 0, &act) != 0) {
+		PMEMOBJ_API_END();
+		return -1;
+	}
+
+	pmemops_memcpy(&dst->p_ops, OBJ_OFF_TO_PTR(dst, act.heap.offset),
+		OBJ_OFF_TO_PTR(src, oid.off), size,
+		PMEMOBJ_F_MEM_NONTEMPORAL);
+
+	struct operation_context *ctx = pmalloc_operation_hold(dst);
+
+	if (operation_reserve(ctx, sizeof(struct ulog_entry_val)) != 0) {
+		pmalloc_operation_release(dst);
+		palloc_cancel(&dst->heap, &act, 1);
+		PMEMOBJ_API_END();
+		return -1;
+	}
+
+	palloc_publish(&dst->heap, &act, 1, ctx);
+
+	pmalloc_operation_release(dst);
+
+	PMEMoid soid = oid;
+	obj_free(src, &soid);
+
+	if (oidp != NULL) {
+		oidp->pool_uuid_lo = dst->uuid_lo;
+		oidp->off = act.heap.offset;
+	}
+
+	PMEMOBJ_API_END();
+	return 0;
+}
+
+/* nonzero tag marking a blob value stored inline in the handle */
+#define OBJ_BLOB_TAG_INLINE 1
+
+/* arguments for constructor_blob */
+struct carg_blob {
+	const void *data;
+	size_t size;
+};
+
+/*
+ * constructor_blob -- (internal) copies the blob value into the allocation
  */
-PMEMoid
-pmemobj_next(PMEMoid oid)
+static int
+constructor_blob(void *ctx, void *ptr, size_t usable_size, void *arg)
 {
-	LOG(3, "oid.off 0x%016" PRIx64, oid.off);
-
-	PMEMoid curr = oid;
-	if (curr.off == 0)
-		return OID_NULL;
-
-	PMEMobjpool *pop = pmemobj_pool_by_oid(curr);
-	ASSERTne(pop, NULL);
-
-	do {
-		ASSERT(OBJ_OID_IS_VALID(pop, curr));
-		uint64_t next_off = palloc_next(&pop->heap, curr.off);
+	PMEMobjpool *pop = ctx;
 
-		if (next_off == 0)
-			return OID_NULL;
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(usable_size);
 
-		/* next object exists */
-		curr.off = next_off;
+	struct carg_blob *carg = arg;
 
-	} while (palloc_flags(&pop->heap, curr.off) & OBJ_INTERNAL_OBJECT_MASK);
+	pmemops_memcpy(&pop->p_ops, ptr, carg->data, carg->size, 0);
 
-	return curr;
+	return 0;
 }
 
 /*
- * pmemobj_reserve -- reserves a single object
+ * obj_blob_publish -- (internal) publishes a blob update in one redo pass
  */
-PMEMoid
-pmemobj_reserve(PMEMobjpool *pop, struct pobj_action *act,
-	size_t size, uint64_t type_num)
+static int
+obj_blob_publish(PMEMobjpool *pop, struct pobj_action *actv, size_t actvcnt)
 {
-	LOG(3, "pop %p act %p size %zu type_num %llx",
-		pop, act, size,
-		(unsigned long long)type_num);
-
-	PMEMOBJ_API_START();
-	PMEMoid oid = OID_NULL;
+	struct operation_context *ctx = pmalloc_operation_hold(pop);
 
-	if (palloc_reserve(&pop->heap, size, NULL, NULL, type_num,
-		0, 0, 0, act) != 0) {
-		PMEMOBJ_API_END();
-		return oid;
+	if (operation_reserve(ctx,
+			actvcnt * sizeof(struct ulog_entry_val)) != 0) {
+		pmalloc_operation_release(pop);
+		return -1;
 	}
 
-	oid.off = act->heap.offset;
-	oid.pool_uuid_lo = pop->uuid_lo;
+	palloc_publish(&pop->heap, actv, actvcnt, ctx);
 
-	PMEMOBJ_API_END();
-	return oid;
+	pmalloc_operation_release(pop);
+
+	return 0;
 }
 
 /*
- * pmemobj_xreserve -- reserves a single object
+ * pmemobj_blob_set -- sets the value of a blob, replacing the previous one
+ *
+ * The new handle contents, the allocation of a new external value and the
+ * free of the old one are all published in a single redo log pass, so the
+ * handle atomically refers to either the old or the new value.
  */
-PMEMoid
-pmemobj_xreserve(PMEMobjpool *pop, struct pobj_action *act,
-	size_t size, uint64_t type_num, uint64_t flags)
+int
+pmemobj_blob_set(PMEMobjpool *pop, PMEMblob *blobp, const void *data,
+	size_t size)
 {
-	LOG(3, "pop %p act %p size %zu type_num %llx flags %llx",
-		pop, act, size,
-		(unsigned long long)type_num, (unsigned long long)flags);
+	LOG(3, "pop %p blobp %p data %p size %zu", pop, blobp, data, size);
 
-	PMEMoid oid = OID_NULL;
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
 
-	if (flags & ~POBJ_ACTION_XRESERVE_VALID_FLAGS) {
-		ERR_WO_ERRNO("unknown flags 0x%" PRIx64,
-				flags & ~POBJ_ACTION_XRESERVE_VALID_FLAGS);
+	if (blobp == NULL || !OBJ_PTR_IS_VALID(pop, blobp)) {
+		ERR_WO_ERRNO("blob handle not from the pool");
 		errno = EINVAL;
-		return oid;
+		return -1;
+	}
+
+	if (size != 0 && data == NULL) {
+		ERR_WO_ERRNO("NULL data with a nonzero size");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (size > PMEMOBJ_MAX_ALLOC_SIZE) {
+		ERR_DEFER_WO_ERRNO("requested size too large");
+		errno = ENOMEM;
+		return -1;
 	}
 
 	PMEMOBJ_API_START();
-	struct constr_args carg;
 
-	carg.zero_init = flags & POBJ_FLAG_ZERO;
-	carg.constructor = NULL;
-	carg.arg = NULL;
+	uint64_t old_off = blobp->inline_value.tag == 0 ?
+		blobp->external_value.off : 0;
 
-	if (palloc_reserve(&pop->heap, size, constructor_alloc, &carg,
-		type_num, 0, CLASS_ID_FROM_FLAG(flags),
-		ARENA_ID_FROM_FLAG(flags), act) != 0) {
-		PMEMOBJ_API_END();
-		return oid;
+	struct pobj_action actv[4];
+	size_t actvcnt = 0;
+
+	PMEMblob nb;
+	nb.data[0] = 0;
+	nb.data[1] = 0;
+
+	if (size > PMEMOBJ_BLOB_INLINE_MAX) {
+		struct carg_blob carg = {data, size};
+
+		if (palloc_reserve(&pop->heap, size, constructor_blob, &carg,
+				0, 0, 0, 0, &actv[actvcnt]) != 0) {
+			PMEMOBJ_API_END();
+			return -1;
+		}
+
+		nb.external_value.off = actv[actvcnt].heap.offset;
+		nb.external_value.size = size;
+		actvcnt++;
+	} else if (size != 0) {
+		memcpy(nb.inline_value.data, data, size);
+		nb.inline_value.size = (uint8_t)size;
+		nb.inline_value.tag = OBJ_BLOB_TAG_INLINE;
 	}
 
-	oid.off = act->heap.offset;
-	oid.pool_uuid_lo = pop->uuid_lo;
+	palloc_set_value(&pop->heap, &actv[actvcnt++], &blobp->data[0],
+		nb.data[0]);
+	palloc_set_value(&pop->heap, &actv[actvcnt++], &blobp->data[1],
+		nb.data[1]);
+
+	if (old_off != 0)
+		palloc_defer_free(&pop->heap, old_off, &actv[actvcnt++]);
+
+	int ret = obj_blob_publish(pop, actv, actvcnt);
+	if (ret != 0)
+		palloc_cancel(&pop->heap, actv, actvcnt);
 
 	PMEMOBJ_API_END();
-	return oid;
+	return ret;
 }
 
 /*
- * pmemobj_set_value -- creates an action to set a value
+ * pmemobj_blob_data -- returns the address of the blob's value
  */
-void
-pmemobj_set_value(PMEMobjpool *pop, struct pobj_action *act,
-	uint64_t *ptr, uint64_t value)
+void *
+pmemobj_blob_data(PMEMobjpool *pop, const PMEMblob *blobp)
 {
-	palloc_set_value(&pop->heap, act, ptr, value);
+	if (blobp->inline_value.tag != 0)
+		return (void *)(uintptr_t)blobp->inline_value.data;
+
+	if (blobp->external_value.off == 0)
+		return NULL;
+
+	return OBJ_OFF_TO_PTR(pop, blobp->external_value.off);
 }
 
 /*
- * pmemobj_defer_free -- creates a deferred free action
+ * pmemobj_blob_size -- returns the size of the blob's value
  */
-void
-pmemobj_defer_free(PMEMobjpool *pop, PMEMoid oid, struct pobj_action *act)
+size_t
+pmemobj_blob_size(const PMEMblob *blobp)
 {
-	ASSERT(!OID_IS_NULL(oid));
-	palloc_defer_free(&pop->heap, oid.off, act);
+	if (blobp->inline_value.tag != 0)
+		return blobp->inline_value.size;
+
+	return blobp->external_value.size;
 }
 
 /*
- * pmemobj_publish -- publishes a collection of actions
+ * pmemobj_blob_free -- clears the blob and frees its external value, if any
  */
 int
-pmemobj_publish(PMEMobjpool *pop, struct pobj_action *actv, size_t actvcnt)
+pmemobj_blob_free(PMEMobjpool *pop, PMEMblob *blobp)
+{
+	LOG(3, "pop %p blobp %p", pop, blobp);
+
+	return pmemobj_blob_set(pop, blobp, NULL, 0);
+}
+
+/*
+ * pmemobj_defrag -- reallocates provided PMEMoids so that the underlying memory
+ *	is efficiently arranged.
+ */
+int
+pmemobj_defrag(PMEMobjpool *pop, PMEMoid **oidv, size_t oidcnt,
+	struct pobj_defrag_result *result)
 {
 	PMEMOBJ_API_START();
-	struct operation_context *ctx = pmalloc_operation_hold(pop);
 
-	size_t entries_size = actvcnt * sizeof(struct ulog_entry_val);
+	if (result) {
+		result->relocated = 0;
+		result->total = 0;
+	}
 
-	if (operation_reserve(ctx, entries_size) != 0) {
-		PMEMOBJ_API_END();
+	uint64_t **objv = Malloc(sizeof(uint64_t *) * oidcnt);
+	if (objv == NULL)
 		return -1;
+
+	int ret = 0;
+
+	size_t j = 0;
+	for (size_t i = 0; i < oidcnt; ++i) {
+		if (OID_IS_NULL(*oidv[i]))
+			continue;
+		if (oidv[i]->pool_uuid_lo != pop->uuid_lo) {
+			ret = -1;
+			ERR_WO_ERRNO(
+				"Not all PMEMoids belong to the provided pool");
+			goto out;
+		}
+		objv[j++] = &oidv[i]->off;
 	}
 
-	palloc_publish(&pop->heap, actv, actvcnt, ctx);
+	struct operation_context *ctx = pmalloc_operation_hold(pop);
+
+	ret = palloc_defrag(&pop->heap, objv, j, ctx, result);
 
 	pmalloc_operation_release(pop);
 
-	PMEMOBJ_API_END();
-	return 0;
-}
+out:
+	Free(objv);
 
-/*
- * pmemobj_cancel -- cancels collection of actions
- */
-void
-pmemobj_cancel(PMEMobjpool *pop, struct pobj_action *actv, size_t actvcnt)
-{
-	PMEMOBJ_API_START();
-	palloc_cancel(&pop->heap, actv, actvcnt);
 	PMEMOBJ_API_END();
+	return ret;
 }
 
 /*
- * pmemobj_defrag -- reallocates provided PMEMoids so that the underlying memory
- *	is efficiently arranged.
+ * pmemobj_defrag_incremental -- performs a single budget-bound pass of
+ *	defragmentation over the provided PMEMoids
+ *
+ * At most max_objects objects are processed and no new object is started
+ * once max_usecs microseconds have elapsed; zero means no limit. The cursor
+ * must be zeroed before the first pass and is treated as an opaque progress
+ * marker afterwards; the caller may store it persistently to resume the
+ * defragmentation after a restart, provided the oid array is rebuilt in the
+ * same order. Returns 1 if there are objects left to process, 0 once the
+ * entire array has been defragmented, and -1 on error.
  */
 int
-pmemobj_defrag(PMEMobjpool *pop, PMEMoid **oidv, size_t oidcnt,
+pmemobj_defrag_incremental(PMEMobjpool *pop, PMEMoid **oidv, size_t oidcnt,
+	size_t max_objects, uint64_t max_usecs, size_t *cursor,
 	struct pobj_defrag_result *result)
 {
 	PMEMOBJ_API_START();
@@ -2654,9 +6064,18 @@ pmemobj_defrag(PMEMobjpool *pop, PMEMoid **oidv, size_t oidcnt,
 		result->total = 0;
 	}
 
+	if (cursor == NULL) {
+		ERR_WO_ERRNO("cursor cannot be NULL");
+		errno = EINVAL;
+		PMEMOBJ_API_END();
+		return -1;
+	}
+
 	uint64_t **objv = Malloc(sizeof(uint64_t *) * oidcnt);
-	if (objv == NULL)
+	if (objv == NULL) {
+		PMEMOBJ_API_END();
 		return -1;
+	}
 
 	int ret = 0;
 
@@ -2675,7 +6094,8 @@ pmemobj_defrag(PMEMobjpool *pop, PMEMoid **oidv, size_t oidcnt,
 
 	struct operation_context *ctx = pmalloc_operation_hold(pop);
 
-	ret = palloc_defrag(&pop->heap, objv, j, ctx, result);
+	ret = palloc_defrag_incremental(&pop->heap, objv, j, max_objects,
+		max_usecs, cursor, ctx, result);
 
 	pmalloc_operation_release(pop);
 
@@ -2686,6 +6106,71 @@ out:
 	return ret;
 }
 
+struct obj_defrag_candidates_ctx {
+	PMEMobjpool *pop;
+	pmemobj_scan_cb *cb;
+	void *arg;
+	int ret;
+};
+
+/*
+ * obj_defrag_candidates_cb -- (internal) per-object callback of
+ *	pmemobj_defrag_candidates
+ */
+static int
+obj_defrag_candidates_cb(uint64_t off, void *arg)
+{
+	struct obj_defrag_candidates_ctx *ctx = arg;
+
+	if (palloc_flags(&ctx->pop->heap, off) & OBJ_INTERNAL_OBJECT_MASK)
+		return 0;
+
+	PMEMoid oid = {ctx->pop->uuid_lo, off};
+
+	return ctx->ret = ctx->cb(oid, ctx->arg);
+}
+
+/*
+ * pmemobj_defrag_candidates -- invokes the callback for every object that
+ *	resides in a run filled below max_occupancy_pct
+ *
+ * The library cannot relocate those objects on its own: only the
+ * application knows where the references to an object live, and
+ * pmemobj_defrag() needs those references so it can update them after the
+ * move. This function bridges the gap - the application maps each reported
+ * oid back to its own reference and feeds the resulting array to
+ * pmemobj_defrag() or pmemobj_defrag_incremental(), turning a full-pool
+ * defragmentation into a targeted pass over the chunks where it pays off
+ * the most.
+ */
+int
+pmemobj_defrag_candidates(PMEMobjpool *pop, unsigned max_occupancy_pct,
+	pmemobj_scan_cb *cb, void *arg)
+{
+	LOG(3, "pop %p max_occupancy_pct %u cb %p arg %p",
+		pop, max_occupancy_pct, cb, arg);
+
+	if (max_occupancy_pct > 100) {
+		ERR_WO_ERRNO("occupancy threshold must not exceed 100%%");
+		errno = EINVAL;
+		return -1;
+	}
+
+	PMEMOBJ_API_START();
+
+	struct obj_defrag_candidates_ctx ctx;
+	ctx.pop = pop;
+	ctx.cb = cb;
+	ctx.arg = arg;
+	ctx.ret = 0;
+
+	palloc_sparse_foreach(&pop->heap, max_occupancy_pct,
+		obj_defrag_candidates_cb, &ctx);
+
+	PMEMOBJ_API_END();
+	return ctx.ret;
+}
+
 /*
  * pmemobj_list_insert -- adds object to a list
  */
@@ -2736,7 +6221,7 @@ pmemobj_list_insert_new(PMEMobjpool *pop, size_t pe_offset, void *head,
 	ASSERT(pe_offset <= size - sizeof(struct list_entry));
 
 	if (size > PMEMOBJ_MAX_ALLOC_SIZE) {
-		ERR_WO_ERRNO("requested size too large");
+		ERR_DEFER_WO_ERRNO("requested size too large");
 		errno = ENOMEM;
 		return OID_NULL;
 	}
@@ -2747,6 +6232,7 @@ pmemobj_list_insert_new(PMEMobjpool *pop, size_t pe_offset, void *head,
 	carg.constructor = constructor;
 	carg.arg = arg;
 	carg.zero_init = 0;
+	carg.generation = 0;
 
 	PMEMoid retoid = OID_NULL;
 	list_insert_new_user(pop, pe_offset, head, dest, before, size, type_num,
@@ -2895,6 +6381,79 @@ pmemobj_ctl_exec(PMEMobjpool *pop, const char *name, void *arg)
 	return ret;
 }
 
+/*
+ * pmemobj_ctl_handle_new -- compiles a ctl query name into a reusable handle
+ */
+struct pobj_ctl_handle *
+pmemobj_ctl_handle_new(PMEMobjpool *pop, const char *name)
+{
+	LOG(3, "pop %p name %s", pop, name);
+
+	return (struct pobj_ctl_handle *)ctl_handle_new(
+		pop == NULL ? NULL : pop->ctl, name);
+}
+
+/*
+ * pmemobj_ctl_handle_delete -- frees a compiled ctl query handle
+ */
+void
+pmemobj_ctl_handle_delete(struct pobj_ctl_handle *handle)
+{
+	LOG(3, "handle %p", handle);
+
+	ctl_handle_delete((struct ctl_handle *)handle);
+}
+
+/*
+ * pmemobj_ctl_get_handle -- executes a compiled read ctl query
+ */
+int
+pmemobj_ctl_get_handle(PMEMobjpool *pop, struct pobj_ctl_handle *handle,
+	void *arg)
+{
+	LOG(3, "pop %p handle %p arg %p", pop, handle, arg);
+
+	return ctl_query_handle((struct ctl_handle *)handle, pop,
+		CTL_QUERY_PROGRAMMATIC, CTL_QUERY_READ, arg);
+}
+
+/*
+ * pmemobj_ctl_set_handle -- executes a compiled write ctl query
+ */
+int
+pmemobj_ctl_set_handle(PMEMobjpool *pop, struct pobj_ctl_handle *handle,
+	void *arg)
+{
+	PMEMOBJ_API_START();
+	LOG(3, "pop %p handle %p arg %p", pop, handle, arg);
+
+	int ret = ctl_query_handle((struct ctl_handle *)handle, pop,
+		CTL_QUERY_PROGRAMMATIC, CTL_QUERY_WRITE, arg);
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * pmemobj_ctl_get_multi -- executes a batch of compiled read ctl queries,
+ *	stopping at the first one that fails
+ */
+int
+pmemobj_ctl_get_multi(PMEMobjpool *pop, struct pobj_ctl_handle **handles,
+	void **args, size_t nqueries)
+{
+	LOG(3, "pop %p handles %p args %p nqueries %zu",
+			pop, handles, args, nqueries);
+
+	for (size_t i = 0; i < nqueries; ++i) {
+		if (ctl_query_handle((struct ctl_handle *)handles[i], pop,
+			CTL_QUERY_PROGRAMMATIC, CTL_QUERY_READ, args[i]) != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
 /*
  * _pobj_debug_notice -- logs notice message if used inside a transaction
  */
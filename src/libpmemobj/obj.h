@@ -72,6 +72,7 @@ static const features_t obj_format_feat_default = OBJ_FORMAT_FEAT_CHECK;
 	(OBJ_OFF_FROM_HEAP(pop, off) ||\
 	(OBJ_PTR_TO_OFF(pop, &(pop)->root_offset) == (off)) ||\
 	(OBJ_PTR_TO_OFF(pop, &(pop)->root_size) == (off)) ||\
+	(OBJ_PTR_TO_OFF(pop, &(pop)->multi_commit.committed_txid) == (off)) ||\
 	(OBJ_OFF_FROM_LANES(pop, off)))
 
 #define OBJ_PTR_IS_VALID(pop, ptr)\
@@ -92,11 +93,47 @@ typedef uint64_t type_num_t;
 #define CONVERSION_FLAG_OLD_SET_CACHE ((1ULL) << 0)
 
 /* PMEM_OBJ_POOL_HEAD_SIZE Without the unused and unused2 arrays */
-#define PMEM_OBJ_POOL_HEAD_SIZE 2110
+#define PMEM_OBJ_POOL_HEAD_SIZE 2334
 #define PMEM_OBJ_POOL_UNUSED2_SIZE (PMEM_PAGESIZE \
 					- OBJ_DSC_P_UNUSED\
 					- PMEM_OBJ_POOL_HEAD_SIZE)
 
+struct lat_trace;
+struct obj_shadow;
+struct obj_warmup;
+struct obj_audit;
+struct obj_oid32;
+
+/*
+ * A published version of the root object descriptor. The pointer in the pool
+ * is replaced under rootlock whenever the root object is (re)allocated, and
+ * the fields of a published version are immutable, so readers can resolve the
+ * root with plain loads and no locking. Superseded versions stay on the prev
+ * list until the pool is closed, as concurrent readers might still use them.
+ */
+struct obj_root_desc {
+	uint64_t off;
+	uint64_t size;
+	struct obj_root_desc *prev;
+};
+
+/*
+ * Persistent record of the coupled two-pool commit protocol, see
+ * pmemobj_tx_begin_multi() in tx.c. On the primary pool only
+ * committed_txid is used: it is set through the transaction's redo log,
+ * so it becomes durable atomically with the rest of the commit. On the
+ * secondary pool the gate fields are written right before the primary
+ * commits and cleared right after - while they are set, the undo log of
+ * gate_lane must not be recovered until the peer's committed_txid tells
+ * whether the transaction made it.
+ */
+struct obj_multi_commit {
+	uint64_t committed_txid; /* last coupled tx committed as primary */
+	uint64_t gate_txid; /* nonzero while awaiting the peer's decision */
+	uint64_t gate_peer; /* uuid_lo of that transaction's primary pool */
+	uint64_t gate_lane; /* lane whose undo log is gated */
+};
+
 struct pmemobjpool {
 	struct pool_hdr hdr;	/* memory pool header */
 
@@ -126,7 +163,35 @@ struct pmemobjpool {
 
 	struct stats_persistent stats_persistent;
 
-	char pmem_reserved[496]; /* must be zeroed */
+	/*
+	 * Offset of the clean shutdown snapshot of the volatile heap state,
+	 * see heap_snapshot in heap.h. Zero if no snapshot has been written.
+	 */
+	uint64_t heap_snapshot_offset;
+
+	/*
+	 * Base address of a previous mapping of the pool, stored on request
+	 * through the "base_hint.enabled" ctl; zero when no hint was stored.
+	 * The next open tries to map the pool at this address first, so that
+	 * absolute pointers cached by the application revalidate with a
+	 * single base compare instead of a full rebuild.
+	 */
+	uint64_t mapping_hint;
+
+	/*
+	 * Offset of the compressed-pointer handle directory, see the obj_oid32
+	 * module in obj.c. Zero until the first handle is registered.
+	 */
+	uint64_t oid32_dir_offset;
+
+	/*
+	 * Commit record of transactions coupled with another pool, see
+	 * pmemobj_tx_begin_multi in tx.c. All zero when no coupled
+	 * transaction has ever involved this pool.
+	 */
+	struct obj_multi_commit multi_commit;
+
+	char pmem_reserved[440]; /* must be zeroed */
 
 	/* some run-time state, allocated out of memory pool... */
 	void *addr;		/* mapped region */
@@ -136,9 +201,25 @@ struct pmemobjpool {
 	struct lane_descriptor lanes_desc;
 	uint64_t uuid_lo;
 	int is_dev_dax;		/* true if mapped on device dax */
+	uint32_t feat_compat;	/* copy of hdr compat features; the header
+				   page itself may be protected */
 
 	struct ctl *ctl;	/* top level node of the ctl tree structure */
 	struct stats *stats;
+	struct lat_trace *lat_trace; /* allocation latency tracer state */
+	struct obj_shadow *shadow; /* write-through DRAM mirror, shadow ctl */
+	struct obj_warmup *warmup; /* background pool warmup state */
+	struct obj_audit *audit; /* sampled persist verification state */
+	struct obj_scrub *scrub; /* background media scrubber state */
+	struct obj_oid32 *oid32; /* compressed-pointer handle table state */
+
+	/*
+	 * Nonzero while a coupled transaction involves this pool; the
+	 * commit records in multi_commit are per pool, so a second coupled
+	 * transaction must fail with EBUSY instead of overwriting them,
+	 * see pmemobj_tx_begin_multi in tx.c.
+	 */
+	uint64_t multi_in_flight;
 
 	struct pool_set *set;		/* pool set info */
 	struct pmemobjpool *replica;	/* next replica */
@@ -155,6 +236,7 @@ struct pmemobjpool {
 	struct pmem_ops p_ops;
 
 	PMEMmutex rootlock;	/* root object lock */
+	struct obj_root_desc *root_desc; /* published root, see obj_root_desc */
 	int is_master_replica;
 
 	int vg_boot;
@@ -185,6 +267,14 @@ struct pmemobjpool {
 
 	void *user_data;
 
+	/*
+	 * User-pluggable replica transport; when attached, every range the
+	 * library writes to the master replica is also handed to these
+	 * callbacks, with the same coalescing as the local stores.
+	 */
+	const struct pobj_replica_ops *replica_ops;
+	void *replica_ctx;
+
 	/* padding to align size of this structure to page boundary */
 	/* sizeof(unused2) == 8192 - offsetof(struct pmemobjpool, unused2) */
 	char unused2[PMEM_OBJ_POOL_UNUSED2_SIZE];
@@ -197,6 +287,13 @@ struct pmemobjpool {
  */
 #define OBJ_INTERNAL_OBJECT_MASK ((1ULL) << 15)
 
+/*
+ * Stored in the 'size' field of oobh header, determines whether the last
+ * 8 bytes of the object's usable space hold a generation counter bumped on
+ * every transactional range snapshot of the object.
+ */
+#define OBJ_GENERATION_MASK ((1ULL) << 14)
+
 #define CLASS_ID_FROM_FLAG(flag)\
 ((uint16_t)((flag) >> 48))
 
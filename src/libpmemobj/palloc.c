@@ -33,14 +33,19 @@
  *	3. memory blocks (sorted by lock address)
  */
 
+#include <fcntl.h>
+
 #include "bucket.h"
 #include "valgrind_internal.h"
 #include "heap_layout.h"
 #include "heap.h"
 #include "alloc_class.h"
+#include "file.h"
+#include "os.h"
 #include "out.h"
 #include "sys_util.h"
 #include "palloc.h"
+#include "maintenance.h"
 #include "ravl.h"
 #include "vec.h"
 
@@ -48,8 +53,12 @@ struct pobj_action_internal {
 	/* type of operation (alloc/free vs set) */
 	enum pobj_action_type type;
 
-	/* not used */
-	uint32_t padding;
+	/*
+	 * Optional publish ordering annotation: when nonzero, the action at
+	 * index (publish_after - 1) of the published array must be durable
+	 * before this action is made visible. Consumed by publish_graph.
+	 */
+	uint32_t publish_after;
 
 	/*
 	 * Action-specific lock that needs to be taken for the duration of
@@ -79,6 +88,10 @@ struct pobj_action_internal {
 	};
 };
 
+static void
+palloc_reservation_clear(struct palloc_heap *heap,
+	struct pobj_action_internal *act, int publish);
+
 /*
  * palloc_set_value -- creates a new set memory action
  */
@@ -92,6 +105,7 @@ palloc_set_value(struct palloc_heap *heap, struct pobj_action *act,
 	act->type = POBJ_ACTION_TYPE_MEM;
 
 	struct pobj_action_internal *actp = (struct pobj_action_internal *)act;
+	actp->publish_after = 0;
 	actp->ptr = ptr;
 	actp->value = value;
 	actp->lock = NULL;
@@ -185,6 +199,9 @@ palloc_reservation_create(struct palloc_heap *heap, size_t size,
 
 	struct memory_block *new_block = &out->m;
 	out->type = POBJ_ACTION_TYPE_HEAP;
+	out->publish_after = 0;
+
+	stats_alloc_histogram_record(heap->stats, size);
 
 	ASSERT(class_id < UINT8_MAX);
 	struct alloc_class *c = class_id == 0 ?
@@ -193,7 +210,8 @@ palloc_reservation_create(struct palloc_heap *heap, size_t size,
 			(uint8_t)class_id);
 
 	if (c == NULL) {
-		ERR_WO_ERRNO("no allocation class for size %lu bytes", size);
+		ERR_DEFER_ARG_WO_ERRNO("no allocation class for size %lu bytes",
+			size);
 		errno = EINVAL;
 		return -1;
 	}
@@ -208,7 +226,8 @@ palloc_reservation_create(struct palloc_heap *heap, size_t size,
 	 */
 	ssize_t size_idx = alloc_class_calc_size_idx(c, size);
 	if (size_idx < 0) {
-		ERR_WO_ERRNO("allocation class not suitable for size %lu bytes",
+		ERR_DEFER_ARG_WO_ERRNO(
+			"allocation class not suitable for size %lu bytes",
 			size);
 		errno = EINVAL;
 		return -1;
@@ -217,6 +236,33 @@ palloc_reservation_create(struct palloc_heap *heap, size_t size,
 	*new_block = MEMORY_BLOCK_NONE;
 	new_block->size_idx = (uint32_t)size_idx;
 
+	/*
+	 * Single-unit blocks, which is what the vast majority of workloads
+	 * allocate, can be served from the per-thread magazine without
+	 * touching any shared bucket. If the magazine cannot provide a block,
+	 * fall through to the regular bucket path.
+	 */
+	if (size_idx == 1 && arena_id == HEAP_ARENA_PER_THREAD &&
+	    heap_magazine_alloc_block(heap, c, new_block,
+	    &out->mresv) == 0) {
+		/*
+		 * The run reservation held by the magazine on behalf of this
+		 * block is transferred onto the action, so no additional
+		 * reference needs to be taken here.
+		 */
+		if (alloc_prep_block(heap, new_block, constructor, arg,
+			extra_field, object_flags, out) != 0) {
+			palloc_reservation_clear(heap, out, 0 /* publish */);
+			errno = ECANCELED;
+			return -1;
+		}
+
+		out->lock = new_block->m_ops->get_lock(new_block);
+		out->new_state = MEMBLOCK_ALLOCATED;
+
+		return 0;
+	}
+
 	struct bucket *b = heap_bucket_acquire(heap, c->id, arena_id);
 
 	err = heap_get_bestfit_block(heap, b, new_block);
@@ -382,6 +428,9 @@ palloc_heap_action_on_cancel(struct palloc_heap *heap,
 	palloc_reservation_clear(heap, act, 0 /* publish */);
 }
 
+/* defined with the rest of the watermark module below */
+static void palloc_watermark_note(struct palloc_heap *heap, int alloc);
+
 /*
  * palloc_heap_action_on_process -- performs finalization steps under a lock
  *	on the persistent state
@@ -397,6 +446,10 @@ palloc_heap_action_on_process(struct palloc_heap *heap,
 			STATS_INC(heap->stats, transient, heap_run_allocated,
 				act->m.m_ops->get_real_size(&act->m));
 		}
+		util_fetch_and_add64(&heap->allocated,
+			act->m.m_ops->get_real_size(&act->m));
+		palloc_watermark_note(heap, 1);
+		heap_zone_occupancy_update(heap, &act->m, 1);
 	} else if (act->new_state == MEMBLOCK_FREE) {
 #if VG_MEMCHECK_ENABLED
 		if (On_memcheck) {
@@ -429,7 +482,10 @@ palloc_heap_action_on_process(struct palloc_heap *heap,
 			STATS_SUB(heap->stats, transient, heap_run_allocated,
 				act->m.m_ops->get_real_size(&act->m));
 		}
-		heap_memblock_on_free(heap, &act->m);
+		util_fetch_and_sub64(&heap->allocated,
+			act->m.m_ops->get_real_size(&act->m));
+		palloc_watermark_note(heap, 0);
+		heap_zone_occupancy_update(heap, &act->m, 0);
 	}
 }
 
@@ -503,173 +559,1199 @@ static const struct {
 		.on_process = palloc_mem_action_noop,
 		.on_unlock = palloc_mem_action_noop,
 	}
-};
+};
+
+/*
+ * palloc_action_compare -- compares two actions based on lock address
+ *
+ * Heap actions under one lock are additionally ordered by the chunk they
+ * operate on, so that frees from one run end up adjacent and their recycler
+ * bookkeeping can be merged into a single pass.
+ */
+static int
+palloc_action_compare(const void *lhs, const void *rhs)
+{
+	const struct pobj_action_internal *mlhs = lhs;
+	const struct pobj_action_internal *mrhs = rhs;
+	uintptr_t vlhs = (uintptr_t)(mlhs->lock);
+	uintptr_t vrhs = (uintptr_t)(mrhs->lock);
+
+	if (vlhs < vrhs)
+		return -1;
+	if (vlhs > vrhs)
+		return 1;
+
+	if (mlhs->type == POBJ_ACTION_TYPE_HEAP &&
+	    mrhs->type == POBJ_ACTION_TYPE_HEAP) {
+		if (mlhs->m.zone_id != mrhs->m.zone_id)
+			return mlhs->m.zone_id < mrhs->m.zone_id ? -1 : 1;
+		if (mlhs->m.chunk_id != mrhs->m.chunk_id)
+			return mlhs->m.chunk_id < mrhs->m.chunk_id ? -1 : 1;
+	}
+
+	return 0;
+}
+
+/*
+ * palloc_action_is_run_free -- (internal) checks if an action frees a block
+ *	that is a part of a run
+ */
+static int
+palloc_action_is_run_free(const struct pobj_action_internal *act)
+{
+	return act->type == POBJ_ACTION_TYPE_HEAP &&
+		act->new_state == MEMBLOCK_FREE &&
+		act->m.type == MEMORY_BLOCK_RUN;
+}
+
+/*
+ * palloc_action_same_run -- (internal) checks if the next action frees a block
+ *	from the same run as the given one
+ */
+static int
+palloc_action_same_run(const struct pobj_action_internal *act,
+	const struct pobj_action_internal *next)
+{
+	return palloc_action_is_run_free(next) &&
+		act->m.zone_id == next->m.zone_id &&
+		act->m.chunk_id == next->m.chunk_id;
+}
+
+/*
+ * palloc_exec_actions -- perform the provided free/alloc operations
+ */
+static void
+palloc_exec_actions(struct palloc_heap *heap,
+	struct operation_context *ctx,
+	struct pobj_action_internal *actv,
+	size_t actvcnt)
+{
+	/*
+	 * The operations array is sorted so that proper lock ordering is
+	 * ensured.
+	 */
+	if (actv) {
+		qsort(actv, actvcnt, sizeof(struct pobj_action_internal),
+			palloc_action_compare);
+	} else {
+		ASSERTeq(actvcnt, 0);
+	}
+
+	struct pobj_action_internal *act;
+	for (size_t i = 0; i < actvcnt; ++i) {
+		act = &actv[i];
+
+		/*
+		 * This lock must be held for the duration between the creation
+		 * of the allocation metadata updates in the operation context
+		 * and the operation processing. This is because a different
+		 * thread might operate on the same 8-byte value of the run
+		 * bitmap and override allocation performed by this thread.
+		 */
+		if (i == 0 || act->lock != actv[i - 1].lock) {
+			if (act->lock)
+				util_mutex_lock(act->lock);
+		}
+
+		/* translate action to some number of operation_entry'ies */
+		action_funcs[act->type].exec(heap, act, ctx);
+	}
+
+	/* wait for all allocated object headers to be persistent */
+	pmemops_drain(&heap->p_ops);
+
+	/* perform all persistent memory operations */
+	operation_process(ctx);
+
+	uint32_t run_free_units = 0;
+	for (size_t i = 0; i < actvcnt; ++i) {
+		act = &actv[i];
+
+		action_funcs[act->type].on_process(heap, act);
+
+		/*
+		 * The sort above makes frees from one run adjacent, so the
+		 * recycler bookkeeping can be done with one container pass
+		 * per run instead of one per freed object. All the batched
+		 * actions share the run lock held right now.
+		 */
+		if (palloc_action_is_run_free(act)) {
+			run_free_units += act->m.size_idx;
+			if (i == actvcnt - 1 ||
+			    !palloc_action_same_run(act, &actv[i + 1])) {
+				heap_memblock_on_free_units(heap, &act->m,
+					run_free_units);
+				run_free_units = 0;
+			}
+		}
+
+		if (i == actvcnt - 1 || act->lock != actv[i + 1].lock) {
+			if (act->lock)
+				util_mutex_unlock(act->lock);
+		}
+	}
+
+	for (size_t i = 0; i < actvcnt; ++i) {
+		act = &actv[i];
+
+		action_funcs[act->type].on_unlock(heap, act);
+	}
+
+	operation_finish(ctx, 0);
+}
+
+/*
+ * palloc_reserve -- creates a single reservation
+ */
+int
+palloc_reserve(struct palloc_heap *heap, size_t size,
+	palloc_constr constructor, void *arg,
+	uint64_t extra_field, uint16_t object_flags,
+	uint16_t class_id, uint16_t arena_id,
+	struct pobj_action *act)
+{
+	COMPILE_ERROR_ON(sizeof(struct pobj_action) !=
+		sizeof(struct pobj_action_internal));
+
+	return palloc_reservation_create(heap, size, constructor, arg,
+		extra_field, object_flags, class_id, arena_id,
+		(struct pobj_action_internal *)act);
+}
+
+/*
+ * palloc_defer_free -- creates an internal deferred free action
+ */
+static void
+palloc_defer_free_create(struct palloc_heap *heap, uint64_t off,
+	struct pobj_action_internal *out)
+{
+	COMPILE_ERROR_ON(sizeof(struct pobj_action) !=
+		sizeof(struct pobj_action_internal));
+
+	out->type = POBJ_ACTION_TYPE_HEAP;
+	out->publish_after = 0;
+	out->offset = off;
+	out->m = memblock_from_offset(heap, off);
+
+	heap_ensure_zone_reclaimed(heap, out->m.zone_id);
+
+	/*
+	 * For the duration of free we may need to protect surrounding
+	 * metadata from being modified.
+	 */
+	out->lock = out->m.m_ops->get_lock(&out->m);
+	out->mresv = NULL;
+	out->new_state = MEMBLOCK_FREE;
+}
+
+/*
+ * palloc_defer_free -- creates a deferred free action
+ */
+void
+palloc_defer_free(struct palloc_heap *heap, uint64_t off,
+	struct pobj_action *act)
+{
+	COMPILE_ERROR_ON(sizeof(struct pobj_action) !=
+		sizeof(struct pobj_action_internal));
+
+	palloc_defer_free_create(heap, off, (struct pobj_action_internal *)act);
+}
+
+/*
+ * palloc_action_publish_after -- annotates an action with the index of the
+ *	action it must be published after
+ */
+void
+palloc_action_publish_after(struct pobj_action *act, uint32_t dep_index)
+{
+	COMPILE_ERROR_ON(sizeof(struct pobj_action) !=
+		sizeof(struct pobj_action_internal));
+
+	((struct pobj_action_internal *)act)->publish_after = dep_index + 1;
+}
+
+/*
+ * palloc_action_publish_dep -- reads the publish ordering annotation
+ *
+ * Returns 0 when the action carries no dependency, dep_index + 1 otherwise.
+ */
+uint32_t
+palloc_action_publish_dep(const struct pobj_action *act)
+{
+	return ((const struct pobj_action_internal *)act)->publish_after;
+}
+
+/*
+ * palloc_cancel -- cancels all reservations in the array
+ */
+void
+palloc_cancel(struct palloc_heap *heap,
+	struct pobj_action *actv, size_t actvcnt)
+{
+	struct pobj_action_internal *act;
+	for (size_t i = 0; i < actvcnt; ++i) {
+		act = (struct pobj_action_internal *)&actv[i];
+		action_funcs[act->type].on_cancel(heap, act);
+	}
+}
+
+/*
+ * palloc_publish_single -- (internal) publishes a single action without
+ *	involving the redo log
+ *
+ * The persistent effect of a single action is exactly one 8-byte
+ * modification - either of a run bitmap value, a chunk header, or a
+ * user-provided destination - which is atomic on its own, so the operation
+ * can be applied with a direct store and flush.
+ */
+static void
+palloc_publish_single(struct palloc_heap *heap,
+	struct pobj_action_internal *act, struct operation_context *ctx)
+{
+	if (act->type == POBJ_ACTION_TYPE_MEM) {
+		util_atomic_store_explicit64(act->ptr, act->value,
+			memory_order_relaxed);
+		pmemops_persist(&heap->p_ops, act->ptr, sizeof(*act->ptr));
+		operation_cancel(ctx);
+		return;
+	}
+
+	ASSERTeq(act->type, POBJ_ACTION_TYPE_HEAP);
+
+	if (act->lock)
+		util_mutex_lock(act->lock);
+
+	/* wait for the allocated object header to be persistent */
+	pmemops_drain(&heap->p_ops);
+
+	act->m.m_ops->prep_hdr(&act->m, act->new_state, NULL);
+
+	palloc_heap_action_on_process(heap, act);
+
+	if (act->new_state == MEMBLOCK_FREE)
+		heap_memblock_on_free(heap, &act->m);
+
+	if (act->lock)
+		util_mutex_unlock(act->lock);
+
+	palloc_heap_action_on_unlock(heap, act);
+
+	operation_cancel(ctx);
+}
+
+/*
+ * palloc_publish_pair -- (internal) publishes two adjacent set actions with
+ *	one atomic 16-byte store instead of a redo log cycle
+ *
+ * Two palloc_set_value() actions targeting one naturally aligned 16-byte
+ * region - e.g. both words of an OID or of a blob handle - have a combined
+ * persistent effect that the CPU can apply atomically, provided it offers a
+ * 16-byte atomic store. Returns 0 when the actions do not form such a pair
+ * or the primitive is unavailable, in which case the caller falls back to
+ * the redo log.
+ */
+static int
+palloc_publish_pair(struct palloc_heap *heap,
+	struct pobj_action_internal *actv, struct operation_context *ctx)
+{
+	if (actv[0].type != POBJ_ACTION_TYPE_MEM ||
+	    actv[1].type != POBJ_ACTION_TYPE_MEM)
+		return 0;
+
+	struct pobj_action_internal *lo = &actv[0];
+	struct pobj_action_internal *hi = &actv[1];
+	if (lo->ptr > hi->ptr) {
+		lo = &actv[1];
+		hi = &actv[0];
+	}
+
+	if (hi->ptr != lo->ptr + 1 || ((uintptr_t)lo->ptr & 15) != 0)
+		return 0;
+
+	uint64_t v[2] = {lo->value, hi->value};
+	if (pmemops_store_16b(&heap->p_ops, lo->ptr, v) == 0)
+		return 0;
+
+	operation_cancel(ctx);
+
+	return 1;
+}
+
+/*
+ * palloc_publish -- publishes all reservations in the array
+ */
+void
+palloc_publish(struct palloc_heap *heap,
+	struct pobj_action *actv, size_t actvcnt,
+	struct operation_context *ctx)
+{
+	/*
+	 * A single action with no other entries registered in the operation
+	 * context can skip the redo machinery altogether.
+	 */
+	if (actvcnt == 1 && operation_is_empty(ctx)) {
+		palloc_publish_single(heap,
+			(struct pobj_action_internal *)&actv[0], ctx);
+		return;
+	}
+
+	if (actvcnt == 2 && operation_is_empty(ctx) &&
+	    palloc_publish_pair(heap,
+			(struct pobj_action_internal *)actv, ctx))
+		return;
+
+	palloc_exec_actions(heap, ctx,
+		(struct pobj_action_internal *)actv, actvcnt);
+}
+
+/*
+ * palloc_action_compact -- stores an action in its compact representation
+ */
+void
+palloc_action_compact(struct palloc_heap *heap, const struct pobj_action *act,
+	struct pobj_action_compact *cact)
+{
+	COMPILE_ERROR_ON(sizeof(struct pobj_action_compact) > 32);
+
+	const struct pobj_action_internal *actp =
+		(const struct pobj_action_internal *)act;
+
+	cact->type = (uint32_t)actp->type;
+
+	if (actp->type == POBJ_ACTION_TYPE_MEM) {
+		cact->new_state = 0;
+		cact->offset = HEAP_PTR_TO_OFF(heap, actp->ptr);
+		cact->value = actp->value;
+		cact->mresv = NULL;
+	} else {
+		cact->new_state = (uint32_t)actp->new_state;
+		cact->offset = actp->offset;
+		cact->value = actp->usable_size;
+		cact->mresv = actp->mresv;
+	}
+}
+
+/*
+ * palloc_action_restore -- (internal) rebuilds a full action from its compact
+ *	representation
+ *
+ * The memory block and its lock are derived from the offset alone; this is
+ * valid because the allocation header of a reserved block is already written
+ * at reservation time.
+ */
+static void
+palloc_action_restore(struct palloc_heap *heap,
+	const struct pobj_action_compact *cact,
+	struct pobj_action_internal *out)
+{
+	out->type = (enum pobj_action_type)cact->type;
+	out->publish_after = 0;
+
+	if (out->type == POBJ_ACTION_TYPE_MEM) {
+		out->lock = NULL;
+		out->ptr = HEAP_OFF_TO_PTR(heap, cact->offset);
+		out->value = cact->value;
+	} else {
+		out->offset = cact->offset;
+		out->usable_size = cact->value;
+		out->new_state = (enum memblock_state)cact->new_state;
+		out->mresv = cact->mresv;
+		out->m = memblock_from_offset(heap, cact->offset);
+		out->lock = out->m.m_ops->get_lock(&out->m);
+	}
+}
+
+/*
+ * palloc_publish_compact -- publishes all reservations in a compact array
+ *
+ * Full actions are rebuilt in a transient array on the stack, hence the
+ * PALLOC_COMPACT_ACTIONS_MAX cap on the batch size.
+ */
+void
+palloc_publish_compact(struct palloc_heap *heap,
+	const struct pobj_action_compact *cactv, size_t cactvcnt,
+	struct operation_context *ctx)
+{
+	ASSERT(cactvcnt <= PALLOC_COMPACT_ACTIONS_MAX);
+
+	struct pobj_action_internal actv[PALLOC_COMPACT_ACTIONS_MAX];
+	for (size_t i = 0; i < cactvcnt; ++i)
+		palloc_action_restore(heap, &cactv[i], &actv[i]);
+
+	palloc_publish(heap, (struct pobj_action *)actv, cactvcnt, ctx);
+}
+
+/*
+ * palloc_cancel_compact -- cancels all reservations in a compact array
+ */
+void
+palloc_cancel_compact(struct palloc_heap *heap,
+	const struct pobj_action_compact *cactv, size_t cactvcnt)
+{
+	for (size_t i = 0; i < cactvcnt; ++i) {
+		struct pobj_action_internal act;
+		palloc_action_restore(heap, &cactv[i], &act);
+		action_funcs[act.type].on_cancel(heap, &act);
+	}
+}
+
+/* number of trace entries buffered in memory between file writes */
+#define PALLOC_TRACE_BUF_ENTRIES 4096
+
+/*
+ * palloc_trace -- (internal) volatile state of the allocation trace recorder
+ *
+ * The recorder state is allocated on the first heap.trace.start and lives
+ * until the heap is cleaned up, so concurrent operations never observe it
+ * being freed - they only check the enabled flag under the lock.
+ */
+struct palloc_trace {
+	os_mutex_t lock;
+	int fd;
+	int enabled;
+	struct timespec last;
+	size_t nentries;
+	struct palloc_trace_entry buf[PALLOC_TRACE_BUF_ENTRIES];
+};
+
+/*
+ * palloc_trace_flush -- (internal) writes out the buffered trace entries
+ */
+static int
+palloc_trace_flush(struct palloc_trace *trace)
+{
+	int ret = util_write_all(trace->fd, (const char *)trace->buf,
+		trace->nentries * sizeof(struct palloc_trace_entry));
+	trace->nentries = 0;
+
+	return ret;
+}
+
+/*
+ * palloc_trace_record -- (internal) appends one entry to the allocation trace
+ */
+static void
+palloc_trace_record(struct palloc_heap *heap, enum palloc_trace_op op,
+	size_t size, uint16_t class_id)
+{
+	struct palloc_trace *trace = heap->trace;
+	if (trace == NULL)
+		return;
+
+	util_mutex_lock(&trace->lock);
+
+	if (!trace->enabled)
+		goto out;
+
+	struct timespec now;
+	os_clock_gettime(CLOCK_MONOTONIC, &now);
+	uint64_t delay = (uint64_t)(now.tv_sec - trace->last.tv_sec) *
+		1000000000ULL + (uint64_t)(now.tv_nsec - trace->last.tv_nsec);
+	trace->last = now;
+
+	struct palloc_trace_entry *e = &trace->buf[trace->nentries++];
+	e->op = (uint8_t)op;
+	e->class_id = (uint8_t)class_id;
+	e->thread = (uint16_t)heap_get_thread_arena_id(heap);
+	e->delay = delay > UINT32_MAX ? UINT32_MAX : (uint32_t)delay;
+	e->size = size;
+
+	if (trace->nentries == PALLOC_TRACE_BUF_ENTRIES &&
+	    palloc_trace_flush(trace) < 0) {
+		CORE_LOG_WARNING("allocation trace write failed - recording "
+			"stopped");
+		trace->enabled = 0;
+	}
+
+out:
+	util_mutex_unlock(&trace->lock);
+}
+
+/*
+ * palloc_trace_start -- starts recording the allocation trace to a file
+ */
+int
+palloc_trace_start(struct palloc_heap *heap, const char *path)
+{
+	if (heap->trace == NULL) {
+		struct palloc_trace *trace = Zalloc(sizeof(*trace));
+		if (trace == NULL)
+			return -1;
+
+		trace->fd = -1;
+		util_mutex_init(&trace->lock);
+		heap->trace = trace;
+	}
+
+	struct palloc_trace *trace = heap->trace;
+	int ret = 0;
+
+	util_mutex_lock(&trace->lock);
+
+	if (trace->enabled) {
+		errno = EBUSY;
+		ret = -1;
+		goto out;
+	}
+
+	trace->fd = os_open(path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+	if (trace->fd < 0) {
+		ret = -1;
+		goto out;
+	}
+
+	trace->nentries = 0;
+	os_clock_gettime(CLOCK_MONOTONIC, &trace->last);
+	trace->enabled = 1;
+
+out:
+	util_mutex_unlock(&trace->lock);
+
+	return ret;
+}
+
+/*
+ * palloc_trace_stop -- stops recording, flushes and closes the trace file
+ */
+int
+palloc_trace_stop(struct palloc_heap *heap)
+{
+	struct palloc_trace *trace = heap->trace;
+	if (trace == NULL)
+		return 0;
+
+	int ret = 0;
+
+	util_mutex_lock(&trace->lock);
+
+	if (trace->enabled) {
+		ret = palloc_trace_flush(trace);
+		(void) os_close(trace->fd);
+		trace->fd = -1;
+		trace->enabled = 0;
+	}
+
+	util_mutex_unlock(&trace->lock);
+
+	return ret;
+}
+
+/*
+ * palloc_trace_enabled -- returns whether the allocation trace is recording
+ */
+int
+palloc_trace_enabled(struct palloc_heap *heap)
+{
+	struct palloc_trace *trace = heap->trace;
+	if (trace == NULL)
+		return 0;
+
+	util_mutex_lock(&trace->lock);
+	int enabled = trace->enabled;
+	util_mutex_unlock(&trace->lock);
+
+	return enabled;
+}
+
+/*
+ * palloc_trace_delete -- (internal) releases the trace recorder state
+ */
+static void
+palloc_trace_delete(struct palloc_heap *heap)
+{
+	struct palloc_trace *trace = heap->trace;
+	if (trace == NULL)
+		return;
+
+	palloc_trace_stop(heap);
+	util_mutex_destroy(&trace->lock);
+	Free(trace);
+	heap->trace = NULL;
+}
+
+/* maximal number of parked pre-zeroed reservations */
+#define PREZERO_MAX_SLOTS 64
+
+enum prezero_slot_state {
+	PREZERO_SLOT_EMPTY,	/* no size assigned yet */
+	PREZERO_SLOT_WANTED,	/* waiting for the worker to fill it */
+	PREZERO_SLOT_FILLING,	/* the worker is creating the reservation */
+	PREZERO_SLOT_READY,	/* holds a zeroed block of the given size */
+};
+
+struct palloc_prezero_slot {
+	enum prezero_slot_state state;
+	uint64_t size; /* the request size this slot caters to */
+	struct pobj_action_internal act;
+};
+
+/*
+ * palloc_prezero -- (internal) volatile state of the pre-zeroing worker
+ *
+ * Slots hold ordinary transient reservations whose user data has already
+ * been zeroed and persisted by a background thread, so a zeroing allocation
+ * with a matching size only has to publish the parked action instead of
+ * writing out the object. The slot sizes are learned from the misses: the
+ * first requests that find no matching block claim empty slots for their
+ * size and the worker refills a taken slot with the same size. Like the
+ * trace recorder above, the state is allocated on the first nonzero budget
+ * write and lives until the heap is cleaned up. The slots are refilled by
+ * the "prezero" task of the pool's maintenance thread.
+ */
+struct palloc_prezero {
+	os_mutex_t lock;
+	unsigned budget; /* number of slots in use, heap.prezero.budget */
+	struct palloc_heap *heap;
+	struct palloc_prezero_slot slots[PREZERO_MAX_SLOTS];
+};
+
+/*
+ * palloc_prezero_constructor -- (internal) zeroes out the reserved block
+ *
+ * The block is only transiently reserved here, so the zeroing is crash-safe
+ * for the same reason writing the allocation header is (see alloc_prep_block).
+ */
+static int
+palloc_prezero_constructor(void *base, void *ptr, size_t usable_size, void *arg)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(base);
+
+	struct palloc_heap *heap = arg;
+
+	pmemops_memset(&heap->p_ops, ptr, 0, usable_size, 0);
+	maintenance_bw_account(heap->maint, usable_size);
+
+	return 0;
+}
+
+/*
+ * palloc_prezero_task -- body of the "prezero" maintenance task
+ *
+ * Fills one wanted slot per step and reports whether more slots are
+ * waiting, so a burst of misses is refilled within a single cycle of the
+ * maintenance thread.
+ */
+int
+palloc_prezero_task(void *arg)
+{
+	struct palloc_heap *heap = arg;
+	struct palloc_prezero *pz = heap->prezero;
+	if (pz == NULL)
+		return 0;
+
+	util_mutex_lock(&pz->lock);
+
+	struct palloc_prezero_slot *s = NULL;
+	int more = 0;
+	for (unsigned i = 0; i < pz->budget; ++i) {
+		if (pz->slots[i].state != PREZERO_SLOT_WANTED)
+			continue;
+		if (s == NULL)
+			s = &pz->slots[i];
+		else
+			more = 1;
+	}
+
+	if (s == NULL) {
+		util_mutex_unlock(&pz->lock);
+		return 0;
+	}
+
+	uint64_t size = s->size;
+	s->state = PREZERO_SLOT_FILLING;
+	util_mutex_unlock(&pz->lock);
+
+	struct pobj_action_internal act;
+	int ret = palloc_reservation_create(pz->heap, size,
+		palloc_prezero_constructor, pz->heap, 0, 0, 0, 0,
+		&act);
+
+	util_mutex_lock(&pz->lock);
+	if (ret != 0) {
+		/*
+		 * Out of space for now - park the slot until the next
+		 * miss of this size re-arms it, so the task does not
+		 * spin on a full pool.
+		 */
+		s->state = PREZERO_SLOT_EMPTY;
+		s->size = 0;
+	} else if (s >= &pz->slots[pz->budget]) {
+		/* the budget shrunk while filling */
+		util_mutex_unlock(&pz->lock);
+		action_funcs[act.type].on_cancel(pz->heap, &act);
+		util_mutex_lock(&pz->lock);
+		s->state = PREZERO_SLOT_EMPTY;
+		s->size = 0;
+	} else {
+		s->act = act;
+		s->state = PREZERO_SLOT_READY;
+	}
+	util_mutex_unlock(&pz->lock);
+
+	return more;
+}
+
+/*
+ * palloc_prezero_take -- (internal) claims a parked zeroed reservation of
+ *	exactly the given size, learning the size on a miss
+ */
+static int
+palloc_prezero_take(struct palloc_prezero *pz, size_t size,
+	struct pobj_action_internal *out)
+{
+	int taken = 0;
+
+	util_mutex_lock(&pz->lock);
+
+	for (unsigned i = 0; i < pz->budget; ++i) {
+		struct palloc_prezero_slot *s = &pz->slots[i];
+		if (s->state == PREZERO_SLOT_READY && s->size == size) {
+			*out = s->act;
+			s->state = PREZERO_SLOT_WANTED;
+			taken = 1;
+			break;
+		}
+	}
+
+	if (!taken) {
+		for (unsigned i = 0; i < pz->budget; ++i) {
+			struct palloc_prezero_slot *s = &pz->slots[i];
+			if (s->state == PREZERO_SLOT_EMPTY) {
+				s->state = PREZERO_SLOT_WANTED;
+				s->size = size;
+				break;
+			}
+		}
+	}
+
+	util_mutex_unlock(&pz->lock);
+
+	maintenance_wake(pz->heap->maint);
+
+	return taken ? 0 : -1;
+}
+
+/*
+ * palloc_prezero_alloc -- allocates an already zeroed object from the parked
+ *	reservations
+ *
+ * Returns nonzero without touching the operation context when no parked
+ * block of the given size is available; the caller is expected to fall back
+ * to palloc_operation(). The fallback is the only path for constructors,
+ * explicit allocation classes and explicit arenas, so the fast path does not
+ * have to replicate any of the reservation policy.
+ */
+int
+palloc_prezero_alloc(struct palloc_heap *heap, uint64_t *dest_off, size_t size,
+	uint64_t extra_field, uint16_t object_flags,
+	struct operation_context *ctx)
+{
+	struct palloc_prezero *pz = heap->prezero;
+	if (pz == NULL)
+		return -1;
+
+	struct pobj_action_internal act;
+	if (palloc_prezero_take(pz, size, &act) != 0)
+		return -1;
+
+	/*
+	 * The parked reservation was made before its caller was known, so the
+	 * allocation header has to be rewritten with the caller's metadata.
+	 * The block is still only transiently reserved, which makes this as
+	 * safe as the original header write in alloc_prep_block().
+	 */
+	act.m.m_ops->write_header(&act.m, extra_field, object_flags);
+
+	/*
+	 * The compact header write pads the store out to a full cache line
+	 * with garbage to avoid a partial line write. On the regular path the
+	 * constructor runs afterwards and covers that up, but here the
+	 * padding lands in the already zeroed user data, so the prefix has to
+	 * be zeroed again.
+	 */
+	void *uptr = act.m.m_ops->get_user_data(&act.m);
+	pmemops_memset(&heap->p_ops, uptr, 0,
+		CACHELINE_SIZE < act.usable_size ?
+			CACHELINE_SIZE : act.usable_size, 0);
+
+	if (dest_off) {
+		operation_add_entry(ctx, dest_off, act.offset,
+			ULOG_OPERATION_SET);
+	}
+
+	palloc_exec_actions(heap, ctx, &act, 1);
+
+	if (heap->trace != NULL)
+		palloc_trace_record(heap, PALLOC_TRACE_ALLOC, size, 0);
+
+	return 0;
+}
+
+/*
+ * palloc_prezero_get_budget -- returns the number of parked reservation slots
+ */
+unsigned
+palloc_prezero_get_budget(struct palloc_heap *heap)
+{
+	struct palloc_prezero *pz = heap->prezero;
+	if (pz == NULL)
+		return 0;
+
+	util_mutex_lock(&pz->lock);
+	unsigned budget = pz->budget;
+	util_mutex_unlock(&pz->lock);
+
+	return budget;
+}
+
+/*
+ * palloc_prezero_set_budget -- sets the number of parked reservation slots,
+ *	starting the pre-zeroing thread on the first nonzero budget
+ */
+int
+palloc_prezero_set_budget(struct palloc_heap *heap, unsigned budget)
+{
+	if (budget > PREZERO_MAX_SLOTS) {
+		ERR_WO_ERRNO("prezero budget too large (max %u)",
+			PREZERO_MAX_SLOTS);
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (heap->maint == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	struct palloc_prezero *pz = heap->prezero;
+	if (pz == NULL) {
+		if (budget == 0)
+			return 0;
+
+		pz = Zalloc(sizeof(*pz));
+		if (pz == NULL)
+			return -1;
+
+		pz->heap = heap;
+		util_mutex_init(&pz->lock);
+
+		heap->prezero = pz;
+	}
+
+	util_mutex_lock(&pz->lock);
+
+	pz->budget = budget;
+
+	/* release the blocks parked in the slots that fell out of the budget */
+	for (unsigned i = budget; i < PREZERO_MAX_SLOTS; ++i) {
+		struct palloc_prezero_slot *s = &pz->slots[i];
+		if (s->state == PREZERO_SLOT_READY)
+			action_funcs[s->act.type].on_cancel(heap, &s->act);
+		if (s->state != PREZERO_SLOT_FILLING) {
+			s->state = PREZERO_SLOT_EMPTY;
+			s->size = 0;
+		}
+	}
+
+	util_mutex_unlock(&pz->lock);
+
+	return maintenance_task_set_enabled(heap->maint, "prezero",
+		budget != 0);
+}
+
+/*
+ * palloc_prezero_delete -- (internal) releases the parked reservations
+ *
+ * Must be called after the maintenance thread is stopped and before
+ * heap_cleanup(), so that the canceled blocks can still reach the heap's
+ * runtime state.
+ */
+static void
+palloc_prezero_delete(struct palloc_heap *heap)
+{
+	struct palloc_prezero *pz = heap->prezero;
+	if (pz == NULL)
+		return;
+
+	for (unsigned i = 0; i < PREZERO_MAX_SLOTS; ++i) {
+		struct palloc_prezero_slot *s = &pz->slots[i];
+		if (s->state == PREZERO_SLOT_READY)
+			action_funcs[s->act.type].on_cancel(heap, &s->act);
+	}
+
+	util_mutex_destroy(&pz->lock);
+	Free(pz);
+	heap->prezero = NULL;
+}
+
+/*
+ * palloc_watermark -- (internal) occupancy watermark state
+ *
+ * Turns the allocator's occupancy accounting into a proactive signal: once
+ * net occupancy crosses the configured high threshold the registered
+ * callback is told the heap is filling up, so a caching layer can start
+ * evicting before allocations fail with ENOMEM and the retry storms begin.
+ * The second, lower threshold adds hysteresis - the all-clear only fires
+ * once occupancy falls back below it. The allocation path pays only for a
+ * comparison; the callback is delivered by the "watermark" task of the
+ * maintenance thread, as user code called from under the allocator locks
+ * could not even free objects to make room. Like the trace recorder and
+ * the pre-zero worker above, the state is allocated on first use and lives
+ * until the heap is cleaned up.
+ */
+struct palloc_watermark {
+	os_mutex_t lock; /* guards the thresholds and the callback */
+	unsigned high_pct; /* percent of the heap size, 0 disables checks */
+	unsigned low_pct; /* percent of the heap size the all-clear is at */
+	int state; /* above the high mark, flipped with atomics */
+	int pending; /* a crossing awaits delivery, accessed with atomics */
+	int reported; /* last level delivered, touched only by the task */
+	pmemobj_watermark_cb cb;
+	void *cb_arg;
+	struct palloc_heap *heap;
+};
+
+/*
+ * palloc_watermark_note -- (internal) cheap occupancy check on the
+ *	allocation path
+ *
+ * Runs under the heap's persistent-state lock, so it only flips the state
+ * with atomics and wakes the maintenance thread; the callback itself is
+ * delivered by palloc_watermark_task.
+ */
+static void
+palloc_watermark_note(struct palloc_heap *heap, int alloc)
+{
+	struct palloc_watermark *wm = heap->wm;
+	if (wm == NULL || wm->high_pct == 0)
+		return;
+
+	uint64_t allocated;
+	util_atomic_load_explicit64(&heap->allocated, &allocated,
+		memory_order_relaxed);
+	uint64_t pct = *heap->sizep / 100;
+
+	if (alloc) {
+		if (allocated >= pct * wm->high_pct &&
+		    util_bool_compare_and_swap32(&wm->state, 0, 1)) {
+			util_atomic_store_explicit32(&wm->pending, 1,
+				memory_order_release);
+			maintenance_wake(heap->maint);
+		}
+	} else {
+		if (allocated <= pct * wm->low_pct &&
+		    util_bool_compare_and_swap32(&wm->state, 1, 0)) {
+			util_atomic_store_explicit32(&wm->pending, 1,
+				memory_order_release);
+			maintenance_wake(heap->maint);
+		}
+	}
+}
 
 /*
- * palloc_action_compare -- compares two actions based on lock address
+ * palloc_watermark_task -- body of the "watermark" maintenance task
+ *
+ * Delivers the callback for the latest crossing. Crossings that cancel out
+ * before the task gets to run are folded away - the callback only ever
+ * observes an actual change of level.
  */
-static int
-palloc_action_compare(const void *lhs, const void *rhs)
+int
+palloc_watermark_task(void *arg)
 {
-	const struct pobj_action_internal *mlhs = lhs;
-	const struct pobj_action_internal *mrhs = rhs;
-	uintptr_t vlhs = (uintptr_t)(mlhs->lock);
-	uintptr_t vrhs = (uintptr_t)(mrhs->lock);
+	struct palloc_heap *heap = arg;
+	struct palloc_watermark *wm = heap->wm;
+	if (wm == NULL)
+		return 0;
 
-	if (vlhs < vrhs)
-		return -1;
-	if (vlhs > vrhs)
-		return 1;
+	int pending;
+	util_atomic_load_explicit32(&wm->pending, &pending,
+		memory_order_acquire);
+	if (!pending)
+		return 0;
+
+	util_mutex_lock(&wm->lock);
+	util_atomic_store_explicit32(&wm->pending, 0, memory_order_relaxed);
+	int level = wm->state;
+	pmemobj_watermark_cb cb = wm->cb;
+	void *cb_arg = wm->cb_arg;
+	util_mutex_unlock(&wm->lock);
+
+	if (level == wm->reported)
+		return 0;
+	wm->reported = level;
+
+	if (cb != NULL)
+		cb((PMEMobjpool *)heap->base, level ? POBJ_WATERMARK_HIGH :
+			POBJ_WATERMARK_NORMAL, cb_arg);
 
 	return 0;
 }
 
 /*
- * palloc_exec_actions -- perform the provided free/alloc operations
+ * palloc_watermark_new -- (internal) allocates the watermark state on
+ *	first use
  */
-static void
-palloc_exec_actions(struct palloc_heap *heap,
-	struct operation_context *ctx,
-	struct pobj_action_internal *actv,
-	size_t actvcnt)
+static struct palloc_watermark *
+palloc_watermark_new(struct palloc_heap *heap)
 {
-	/*
-	 * The operations array is sorted so that proper lock ordering is
-	 * ensured.
-	 */
-	if (actv) {
-		qsort(actv, actvcnt, sizeof(struct pobj_action_internal),
-			palloc_action_compare);
-	} else {
-		ASSERTeq(actvcnt, 0);
-	}
-
-	struct pobj_action_internal *act;
-	for (size_t i = 0; i < actvcnt; ++i) {
-		act = &actv[i];
-
-		/*
-		 * This lock must be held for the duration between the creation
-		 * of the allocation metadata updates in the operation context
-		 * and the operation processing. This is because a different
-		 * thread might operate on the same 8-byte value of the run
-		 * bitmap and override allocation performed by this thread.
-		 */
-		if (i == 0 || act->lock != actv[i - 1].lock) {
-			if (act->lock)
-				util_mutex_lock(act->lock);
-		}
-
-		/* translate action to some number of operation_entry'ies */
-		action_funcs[act->type].exec(heap, act, ctx);
-	}
+	struct palloc_watermark *wm = heap->wm;
+	if (wm != NULL)
+		return wm;
 
-	/* wait for all allocated object headers to be persistent */
-	pmemops_drain(&heap->p_ops);
+	wm = Zalloc(sizeof(*wm));
+	if (wm == NULL)
+		return NULL;
 
-	/* perform all persistent memory operations */
-	operation_process(ctx);
+	wm->heap = heap;
+	util_mutex_init(&wm->lock);
+	heap->wm = wm;
 
-	for (size_t i = 0; i < actvcnt; ++i) {
-		act = &actv[i];
+	return wm;
+}
 
-		action_funcs[act->type].on_process(heap, act);
+/*
+ * palloc_watermark_set_high -- sets the high watermark as a percentage of
+ *	the heap size, 0 disables the checks and resets the hysteresis
+ */
+int
+palloc_watermark_set_high(struct palloc_heap *heap, unsigned pct)
+{
+	if (heap->maint == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
 
-		if (i == actvcnt - 1 || act->lock != actv[i + 1].lock) {
-			if (act->lock)
-				util_mutex_unlock(act->lock);
-		}
+	unsigned low = heap->wm == NULL ? 0 : heap->wm->low_pct;
+	if (pct > 100 || (pct != 0 && pct <= low)) {
+		ERR_WO_ERRNO(
+			"high watermark must be a percentage above the low watermark");
+		errno = EINVAL;
+		return -1;
 	}
 
-	for (size_t i = 0; i < actvcnt; ++i) {
-		act = &actv[i];
+	if (pct == 0 && heap->wm == NULL)
+		return 0;
 
-		action_funcs[act->type].on_unlock(heap, act);
+	struct palloc_watermark *wm = palloc_watermark_new(heap);
+	if (wm == NULL)
+		return -1;
+
+	util_mutex_lock(&wm->lock);
+	wm->high_pct = pct;
+	if (pct == 0) {
+		wm->state = 0;
+		wm->pending = 0;
+		wm->reported = 0;
 	}
+	util_mutex_unlock(&wm->lock);
 
-	operation_finish(ctx, 0);
+	return maintenance_task_set_enabled(heap->maint, "watermark",
+		pct != 0);
 }
 
 /*
- * palloc_reserve -- creates a single reservation
+ * palloc_watermark_set_low -- sets the low watermark the all-clear fires at
  */
 int
-palloc_reserve(struct palloc_heap *heap, size_t size,
-	palloc_constr constructor, void *arg,
-	uint64_t extra_field, uint16_t object_flags,
-	uint16_t class_id, uint16_t arena_id,
-	struct pobj_action *act)
+palloc_watermark_set_low(struct palloc_heap *heap, unsigned pct)
 {
-	COMPILE_ERROR_ON(sizeof(struct pobj_action) !=
-		sizeof(struct pobj_action_internal));
+	if (heap->maint == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
 
-	return palloc_reservation_create(heap, size, constructor, arg,
-		extra_field, object_flags, class_id, arena_id,
-		(struct pobj_action_internal *)act);
+	unsigned high = heap->wm == NULL ? 0 : heap->wm->high_pct;
+	if (pct > 100 || (high != 0 && pct >= high)) {
+		ERR_WO_ERRNO(
+			"low watermark must be a percentage below the high watermark");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (pct == 0 && heap->wm == NULL)
+		return 0;
+
+	struct palloc_watermark *wm = palloc_watermark_new(heap);
+	if (wm == NULL)
+		return -1;
+
+	util_mutex_lock(&wm->lock);
+	wm->low_pct = pct;
+	util_mutex_unlock(&wm->lock);
+
+	return 0;
 }
 
 /*
- * palloc_defer_free -- creates an internal deferred free action
+ * palloc_watermark_get_high -- returns the high watermark percentage
  */
-static void
-palloc_defer_free_create(struct palloc_heap *heap, uint64_t off,
-	struct pobj_action_internal *out)
+unsigned
+palloc_watermark_get_high(struct palloc_heap *heap)
 {
-	COMPILE_ERROR_ON(sizeof(struct pobj_action) !=
-		sizeof(struct pobj_action_internal));
-
-	out->type = POBJ_ACTION_TYPE_HEAP;
-	out->offset = off;
-	out->m = memblock_from_offset(heap, off);
+	struct palloc_watermark *wm = heap->wm;
+	if (wm == NULL)
+		return 0;
 
-	heap_ensure_zone_reclaimed(heap, out->m.zone_id);
+	util_mutex_lock(&wm->lock);
+	unsigned pct = wm->high_pct;
+	util_mutex_unlock(&wm->lock);
 
-	/*
-	 * For the duration of free we may need to protect surrounding
-	 * metadata from being modified.
-	 */
-	out->lock = out->m.m_ops->get_lock(&out->m);
-	out->mresv = NULL;
-	out->new_state = MEMBLOCK_FREE;
+	return pct;
 }
 
 /*
- * palloc_defer_free -- creates a deferred free action
+ * palloc_watermark_get_low -- returns the low watermark percentage
  */
-void
-palloc_defer_free(struct palloc_heap *heap, uint64_t off,
-	struct pobj_action *act)
+unsigned
+palloc_watermark_get_low(struct palloc_heap *heap)
 {
-	COMPILE_ERROR_ON(sizeof(struct pobj_action) !=
-		sizeof(struct pobj_action_internal));
+	struct palloc_watermark *wm = heap->wm;
+	if (wm == NULL)
+		return 0;
 
-	palloc_defer_free_create(heap, off, (struct pobj_action_internal *)act);
+	util_mutex_lock(&wm->lock);
+	unsigned pct = wm->low_pct;
+	util_mutex_unlock(&wm->lock);
+
+	return pct;
 }
 
 /*
- * palloc_cancel -- cancels all reservations in the array
+ * palloc_watermark_callback -- registers the watermark callback, NULL
+ *	unregisters
  */
-void
-palloc_cancel(struct palloc_heap *heap,
-	struct pobj_action *actv, size_t actvcnt)
+int
+palloc_watermark_callback(struct palloc_heap *heap,
+	pmemobj_watermark_cb cb, void *arg)
 {
-	struct pobj_action_internal *act;
-	for (size_t i = 0; i < actvcnt; ++i) {
-		act = (struct pobj_action_internal *)&actv[i];
-		action_funcs[act->type].on_cancel(heap, act);
-	}
+	struct palloc_watermark *wm = palloc_watermark_new(heap);
+	if (wm == NULL)
+		return -1;
+
+	util_mutex_lock(&wm->lock);
+	wm->cb_arg = arg;
+	wm->cb = cb;
+	util_mutex_unlock(&wm->lock);
+
+	return 0;
 }
 
 /*
- * palloc_publish -- publishes all reservations in the array
+ * palloc_watermark_delete -- (internal) releases the watermark state
+ *
+ * Must be called after the maintenance thread is stopped.
  */
-void
-palloc_publish(struct palloc_heap *heap,
-	struct pobj_action *actv, size_t actvcnt,
-	struct operation_context *ctx)
+static void
+palloc_watermark_delete(struct palloc_heap *heap)
 {
-	palloc_exec_actions(heap, ctx,
-		(struct pobj_action_internal *)actv, actvcnt);
+	struct palloc_watermark *wm = heap->wm;
+	if (wm == NULL)
+		return;
+
+	util_mutex_destroy(&wm->lock);
+	Free(wm);
+	heap->wm = NULL;
 }
 
 /*
@@ -779,6 +1861,15 @@ palloc_operation(struct palloc_heap *heap,
 	/* and now actually perform the requested operation! */
 	palloc_exec_actions(heap, ctx, ops, nops);
 
+	if (heap->trace != NULL) {
+		enum palloc_trace_op top = PALLOC_TRACE_ALLOC;
+		if (alloc != NULL && dealloc != NULL)
+			top = PALLOC_TRACE_REALLOC;
+		else if (dealloc != NULL)
+			top = PALLOC_TRACE_FREE;
+		palloc_trace_record(heap, top, size, class_id);
+	}
+
 	return 0;
 }
 
@@ -849,14 +1940,49 @@ pobj_actions_add(struct pobj_actions *actv)
 }
 
 /*
- * palloc_defrag -- forces recycling of all available memory, and reallocates
- *	provided objects so that they have the lowest possible address.
+ * palloc_defrag_budget_exhausted -- (internal) checks whether the incremental
+ *	defragmentation budget has been used up
+ *
+ * Zero value of either limit means that the limit is not enforced.
  */
-int
-palloc_defrag(struct palloc_heap *heap, uint64_t **objv, size_t objcnt,
+static int
+palloc_defrag_budget_exhausted(size_t nprocessed, size_t max_objects,
+	const struct timespec *start, uint64_t max_usecs)
+{
+	if (max_objects != 0 && nprocessed >= max_objects)
+		return 1;
+
+	if (max_usecs != 0) {
+		struct timespec now;
+		os_clock_gettime(CLOCK_MONOTONIC, &now);
+		uint64_t elapsed = (uint64_t)(now.tv_sec - start->tv_sec) *
+			1000000ULL +
+			(uint64_t)(now.tv_nsec - start->tv_nsec) / 1000;
+		if (elapsed >= max_usecs)
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * palloc_defrag_run -- (internal) reallocates objects from the provided array,
+ *	starting at the given position, so that they have the lowest possible
+ *	address, stopping once the object or time budget is exhausted
+ */
+static int
+palloc_defrag_run(struct palloc_heap *heap, uint64_t **objv, size_t objcnt,
+	size_t start_pos, size_t max_objects, uint64_t max_usecs, size_t *next,
 	struct operation_context *ctx, struct pobj_defrag_result *result)
 {
 	int ret = -1;
+	size_t nprocessed = 0;
+	size_t stop_pos = objcnt;
+
+	struct timespec budget_start;
+	if (max_usecs != 0)
+		os_clock_gettime(CLOCK_MONOTONIC, &budget_start);
+
 	/*
 	 * Offsets pointers need to be sorted by the offset of the object in
 	 * descending order. This gives us two things, a) the defragmentation
@@ -938,7 +2064,7 @@ palloc_defrag(struct palloc_heap *heap, uint64_t **objv, size_t objcnt,
 
 	struct pobj_action *prev_reserve = NULL;
 	uint64_t prev_offset = 0;
-	for (size_t i = 0; i < objcnt; ++i) {
+	for (size_t i = start_pos; i < objcnt; ++i) {
 		uint64_t *offsetp = objv[i];
 		uint64_t offset = *offsetp;
 
@@ -1020,6 +2146,18 @@ palloc_defrag(struct palloc_heap *heap, uint64_t **objv, size_t objcnt,
 			continue;
 		}
 
+		/*
+		 * The budget is evaluated only on object boundaries, so that
+		 * all pointers to an object relocated in this pass are updated
+		 * before the loop stops.
+		 */
+		if (palloc_defrag_budget_exhausted(nprocessed, max_objects,
+				&budget_start, max_usecs)) {
+			stop_pos = i;
+			break;
+		}
+		nprocessed++;
+
 		if (result)
 			result->total++;
 
@@ -1144,6 +2282,9 @@ palloc_defrag(struct palloc_heap *heap, uint64_t **objv, size_t objcnt,
 		operation_cancel(ctx);
 	}
 
+	if (next)
+		*next = stop_pos;
+
 	ret = 0;
 
 err:
@@ -1159,6 +2300,52 @@ err_ravl:
 	return ret;
 }
 
+/*
+ * palloc_defrag -- forces recycling of all available memory, and reallocates
+ *	provided objects so that they have the lowest possible address.
+ */
+int
+palloc_defrag(struct palloc_heap *heap, uint64_t **objv, size_t objcnt,
+	struct operation_context *ctx, struct pobj_defrag_result *result)
+{
+	return palloc_defrag_run(heap, objv, objcnt, 0, 0, 0, NULL,
+		ctx, result);
+}
+
+/*
+ * palloc_defrag_incremental -- performs a single budget-bound pass of
+ *	defragmentation, resumable through the provided cursor
+ *
+ * Returns 1 if there are objects left to process, 0 if the entire array has
+ * been defragmented, and -1 on error.
+ */
+int
+palloc_defrag_incremental(struct palloc_heap *heap, uint64_t **objv,
+	size_t objcnt, size_t max_objects, uint64_t max_usecs, size_t *cursor,
+	struct operation_context *ctx, struct pobj_defrag_result *result)
+{
+	size_t start_pos = *cursor;
+	if (start_pos >= objcnt) {
+		operation_cancel(ctx);
+		*cursor = 0;
+		return 0;
+	}
+
+	size_t next = objcnt;
+	if (palloc_defrag_run(heap, objv, objcnt, start_pos, max_objects,
+	    max_usecs, &next, ctx, result) != 0)
+		return -1;
+
+	if (next >= objcnt) {
+		*cursor = 0;
+		return 0;
+	}
+
+	*cursor = next;
+
+	return 1;
+}
+
 /*
  * palloc_usable_size -- returns the number of bytes in the memory block
  */
@@ -1247,6 +2434,56 @@ palloc_next(struct palloc_heap *heap, uint64_t off)
 	return HEAP_PTR_TO_OFF(heap, uptr);
 }
 
+struct palloc_foreach_args {
+	struct palloc_heap *heap;
+	palloc_object_callback cb;
+	void *arg;
+};
+
+/*
+ * palloc_foreach_cb -- (internal) foreach callback translating memory
+ *	blocks into object offsets
+ */
+static int
+palloc_foreach_cb(const struct memory_block *m, void *arg)
+{
+	struct palloc_foreach_args *args = arg;
+
+	void *uptr = m->m_ops->get_user_data(m);
+
+	return args->cb(HEAP_PTR_TO_OFF(args->heap, uptr), args->arg);
+}
+
+/*
+ * palloc_foreach -- invokes the callback for every object in the heap
+ *
+ * Unlike a palloc_first()/palloc_next() loop, which re-walks the zone
+ * metadata on every step to locate the current object again, this is
+ * a single traversal in physical (zone/chunk/run) order. A non-zero
+ * return value of the callback stops the traversal.
+ */
+void
+palloc_foreach(struct palloc_heap *heap, palloc_object_callback cb, void *arg)
+{
+	struct palloc_foreach_args args = {heap, cb, arg};
+
+	heap_foreach_object(heap, palloc_foreach_cb, &args, MEMORY_BLOCK_NONE);
+}
+
+/*
+ * palloc_sparse_foreach -- invokes the callback for every object residing
+ *	in a run filled below max_occupancy_pct
+ */
+void
+palloc_sparse_foreach(struct palloc_heap *heap, unsigned max_occupancy_pct,
+	palloc_object_callback cb, void *arg)
+{
+	struct palloc_foreach_args args = {heap, cb, arg};
+
+	heap_sparse_run_foreach(heap, max_occupancy_pct, palloc_foreach_cb,
+		&args);
+}
+
 /*
  * palloc_boot -- initializes allocator section
  */
@@ -1254,10 +2491,13 @@ int
 palloc_boot(struct palloc_heap *heap, void *heap_start,
 		uint64_t heap_size, uint64_t *sizep,
 		void *base, struct pmem_ops *p_ops, struct stats *stats,
-		struct pool_set *set)
+		struct pool_set *set, uint32_t compat_features)
 {
+	heap->trace = NULL;
+	heap->wm = NULL;
+
 	return heap_boot(heap, heap_start, heap_size, sizep,
-		base, p_ops, stats, set);
+		base, p_ops, stats, set, compat_features);
 }
 
 /*
@@ -1299,12 +2539,24 @@ palloc_heap_check(void *heap_start, uint64_t heap_size)
 	return heap_check(heap_start, heap_size);
 }
 
+/*
+ * palloc_heap_check_quick -- verifies heap metadata checksums and headers
+ */
+int
+palloc_heap_check_quick(void *heap_start, uint64_t heap_size)
+{
+	return heap_check_quick(heap_start, heap_size);
+}
+
 /*
  * palloc_heap_cleanup -- cleanups the volatile heap state
  */
 void
 palloc_heap_cleanup(struct palloc_heap *heap)
 {
+	palloc_prezero_delete(heap);
+	palloc_watermark_delete(heap);
+	palloc_trace_delete(heap);
 	heap_cleanup(heap);
 }
 
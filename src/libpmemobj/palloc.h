@@ -23,6 +23,11 @@ extern "C" {
 
 #define PALLOC_CTL_DEBUG_NO_PATTERN (-1)
 
+struct palloc_trace;
+struct palloc_prezero;
+struct palloc_watermark;
+struct maintenance;
+
 struct palloc_heap {
 	struct pmem_ops p_ops;
 	struct heap_layout *layout;
@@ -36,8 +41,82 @@ struct palloc_heap {
 	void *base;
 
 	int alloc_pattern;
+
+	/* write a clean shutdown snapshot on close, heap.snapshot.enabled */
+	int snapshot_enabled;
+
+	/*
+	 * write chunk headers with non-temporal stores instead of cached
+	 * stores followed by a flush, heap.nt_headers.enabled
+	 */
+	int nt_headers_enabled;
+
+	struct palloc_trace *trace;
+
+	/* pre-zeroed parked reservations, heap.prezero.budget */
+	struct palloc_prezero *prezero;
+
+	/* the pool's background maintenance thread, see maintenance.h */
+	struct maintenance *maint;
+
+	/*
+	 * Net bytes allocated. Unlike the persistent statistics counter,
+	 * which only moves while stats are enabled, this one is maintained
+	 * unconditionally; it is seeded from the persistent counter on boot.
+	 */
+	uint64_t allocated;
+
+	/* occupancy watermark thresholds and callback, heap.watermark.* */
+	struct palloc_watermark *wm;
+
+	/*
+	 * Foreground latency budget in microseconds, policy.latency_budget.
+	 * Any non-zero budget makes the allocator defer work with an
+	 * unbounded worst case (huge chunk coalescing) to the maintenance
+	 * thread instead of doing it on the calling thread; the value itself
+	 * is advisory and lets callers express their SLO directly.
+	 */
+	unsigned latency_budget;
+};
+
+/*
+ * The allocation trace is a flat binary file built from fixed-size records,
+ * one per completed palloc operation, meant to be replayed by benchmarks
+ * against allocator changes. Recording is off by default and controlled
+ * through the heap.trace ctl namespace.
+ */
+enum palloc_trace_op {
+	PALLOC_TRACE_ALLOC,
+	PALLOC_TRACE_FREE,
+	PALLOC_TRACE_REALLOC,
+
+	MAX_PALLOC_TRACE_OP
+};
+
+struct palloc_trace_entry {
+	uint8_t op;	  /* enum palloc_trace_op */
+	uint8_t class_id; /* requested allocation class, 0 for automatic */
+	uint16_t thread;  /* arena id of the calling thread */
+	uint32_t delay;	  /* nanoseconds since the previous record */
+	uint64_t size;	  /* requested size, 0 for free */
 };
 
+int palloc_trace_start(struct palloc_heap *heap, const char *path);
+int palloc_trace_stop(struct palloc_heap *heap);
+int palloc_trace_enabled(struct palloc_heap *heap);
+
+int palloc_prezero_set_budget(struct palloc_heap *heap, unsigned budget);
+unsigned palloc_prezero_get_budget(struct palloc_heap *heap);
+int palloc_prezero_task(void *arg);
+
+int palloc_watermark_set_high(struct palloc_heap *heap, unsigned pct);
+int palloc_watermark_set_low(struct palloc_heap *heap, unsigned pct);
+unsigned palloc_watermark_get_high(struct palloc_heap *heap);
+unsigned palloc_watermark_get_low(struct palloc_heap *heap);
+int palloc_watermark_callback(struct palloc_heap *heap,
+	pmemobj_watermark_cb cb, void *arg);
+int palloc_watermark_task(void *arg);
+
 struct memory_block;
 
 typedef int (*palloc_constr)(void *base, void *ptr,
@@ -49,6 +128,10 @@ int palloc_operation(struct palloc_heap *heap, uint64_t off, uint64_t *dest_off,
 	uint16_t class_id, uint16_t arena_id,
 	struct operation_context *ctx);
 
+int palloc_prezero_alloc(struct palloc_heap *heap, uint64_t *dest_off,
+	size_t size, uint64_t extra_field, uint16_t object_flags,
+	struct operation_context *ctx);
+
 int
 palloc_reserve(struct palloc_heap *heap, size_t size,
 	palloc_constr constructor, void *arg,
@@ -60,6 +143,12 @@ void
 palloc_defer_free(struct palloc_heap *heap, uint64_t off,
 	struct pobj_action *act);
 
+void
+palloc_action_publish_after(struct pobj_action *act, uint32_t dep_index);
+
+uint32_t
+palloc_action_publish_dep(const struct pobj_action *act);
+
 void
 palloc_cancel(struct palloc_heap *heap,
 	struct pobj_action *actv, size_t actvcnt);
@@ -69,6 +158,46 @@ palloc_publish(struct palloc_heap *heap,
 	struct pobj_action *actv, size_t actvcnt,
 	struct operation_context *ctx);
 
+struct memory_block_reserved;
+
+/*
+ * pobj_action_compact -- a trimmed-down action representation
+ *
+ * Alloc/free and set actions carry only the state that cannot be cheaply
+ * recomputed from the block offset, which makes them a quarter of the size
+ * of struct pobj_action. An array of up to PALLOC_COMPACT_ACTIONS_MAX
+ * compact actions is small enough to live on the stack, so batch
+ * reserve/publish paths don't have to allocate their action arrays from
+ * DRAM in the hot loop.
+ */
+struct pobj_action_compact {
+	uint32_t type; /* enum pobj_action_type */
+	uint32_t new_state; /* enum memblock_state, heap actions only */
+	uint64_t offset; /* offset of the block (or of the word to be set) */
+	uint64_t value; /* usable size of the block / value to be set */
+	struct memory_block_reserved *mresv; /* active run reservation */
+};
+
+/*
+ * Largest batch of compact actions that palloc_publish_compact() and
+ * palloc_cancel_compact() accept; caps the transient array rebuilt on the
+ * stack at publish time to 8kB.
+ */
+#define PALLOC_COMPACT_ACTIONS_MAX 64
+
+void
+palloc_action_compact(struct palloc_heap *heap, const struct pobj_action *act,
+	struct pobj_action_compact *cact);
+
+void
+palloc_publish_compact(struct palloc_heap *heap,
+	const struct pobj_action_compact *cactv, size_t cactvcnt,
+	struct operation_context *ctx);
+
+void
+palloc_cancel_compact(struct palloc_heap *heap,
+	const struct pobj_action_compact *cactv, size_t cactvcnt);
+
 void
 palloc_set_value(struct palloc_heap *heap, struct pobj_action *act,
 	uint64_t *ptr, uint64_t value);
@@ -76,6 +205,12 @@ palloc_set_value(struct palloc_heap *heap, struct pobj_action *act,
 uint64_t palloc_first(struct palloc_heap *heap);
 uint64_t palloc_next(struct palloc_heap *heap, uint64_t off);
 
+typedef int (*palloc_object_callback)(uint64_t off, void *arg);
+void palloc_foreach(struct palloc_heap *heap, palloc_object_callback cb,
+	void *arg);
+void palloc_sparse_foreach(struct palloc_heap *heap,
+	unsigned max_occupancy_pct, palloc_object_callback cb, void *arg);
+
 size_t palloc_usable_size(struct palloc_heap *heap, uint64_t off);
 uint64_t palloc_extra(struct palloc_heap *heap, uint64_t off);
 uint16_t palloc_flags(struct palloc_heap *heap, uint64_t off);
@@ -83,7 +218,8 @@ uint16_t palloc_flags(struct palloc_heap *heap, uint64_t off);
 int palloc_boot(struct palloc_heap *heap, void *heap_start,
 		uint64_t heap_size, uint64_t *sizep,
 		void *base, struct pmem_ops *p_ops,
-		struct stats *stats, struct pool_set *set);
+		struct stats *stats, struct pool_set *set,
+		uint32_t compat_features);
 
 int palloc_buckets_init(struct palloc_heap *heap);
 
@@ -93,11 +229,15 @@ int palloc_init(void *heap_start, uint64_t heap_size, uint64_t *sizep,
 void *palloc_heap_end(struct palloc_heap *h);
 #endif /* VG_MEMCHECK_ENABLED */
 int palloc_heap_check(void *heap_start, uint64_t heap_size);
+int palloc_heap_check_quick(void *heap_start, uint64_t heap_size);
 void palloc_heap_cleanup(struct palloc_heap *heap);
 size_t palloc_heap(void *heap_start);
 
 int palloc_defrag(struct palloc_heap *heap, uint64_t **objv, size_t objcnt,
 	struct operation_context *ctx, struct pobj_defrag_result *result);
+int palloc_defrag_incremental(struct palloc_heap *heap, uint64_t **objv,
+	size_t objcnt, size_t max_objects, uint64_t max_usecs, size_t *cursor,
+	struct operation_context *ctx, struct pobj_defrag_result *result);
 
 /* foreach callback, terminates iteration if return value is non-zero */
 typedef int (*object_callback)(const struct memory_block *m, void *arg);
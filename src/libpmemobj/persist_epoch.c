@@ -0,0 +1,139 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2026, Intel Corporation */
+
+/*
+ * persist_epoch.c -- runtime persist-ordering assertions, see persist_epoch.h
+ */
+
+#include <inttypes.h>
+
+#include "persist_epoch.h"
+#include "core_assert.h"
+#include "log_internal.h"
+#include "rand.h"
+
+#ifdef PMEMOBJ_PERSIST_EPOCHS
+
+/*
+ * The number of slots in the line-to-epoch hash. Power of two; at 1M slots
+ * the table weighs 16MB and collisions - which only ever skip a check - stay
+ * rare for working sets in the tens of gigabytes.
+ */
+#define PERSIST_EPOCH_SLOTS (1ULL << 20)
+
+struct persist_epoch_slot {
+	uint64_t line; /* cache-line-aligned address, 0 when empty */
+	uint64_t epoch;
+};
+
+static struct persist_epoch_slot Epoch_table[PERSIST_EPOCH_SLOTS];
+
+/* the global epoch, advanced by every drain */
+static uint64_t Epoch = 1;
+
+/*
+ * persist_epoch_slot_of -- (internal) hashes a line address into the table
+ */
+static struct persist_epoch_slot *
+persist_epoch_slot_of(uint64_t line)
+{
+	return &Epoch_table[hash64(line) % PERSIST_EPOCH_SLOTS];
+}
+
+/*
+ * persist_epoch_current -- reads the current global epoch
+ */
+uint64_t
+persist_epoch_current(void)
+{
+	uint64_t e;
+	util_atomic_load_explicit64(&Epoch, &e, memory_order_relaxed);
+
+	return e;
+}
+
+/*
+ * persist_epoch_record -- records the current epoch as the last-persist
+ *	epoch of every cache line in the range
+ *
+ * Concurrent updates of one slot can interleave the line and epoch stores;
+ * the worst outcome is a line paired with a neighbouring epoch, which can
+ * skip or weaken a later check but never fabricate a violation worse than
+ * one the interleaved writers could have hit themselves.
+ */
+void
+persist_epoch_record(const void *addr, size_t len)
+{
+	uint64_t e = persist_epoch_current();
+	uint64_t first = (uint64_t)addr & ~((uint64_t)CACHELINE_SIZE - 1);
+	uint64_t last = ((uint64_t)addr + (len ? len - 1 : 0)) &
+		~((uint64_t)CACHELINE_SIZE - 1);
+
+	for (uint64_t line = first; line <= last; line += CACHELINE_SIZE) {
+		struct persist_epoch_slot *s = persist_epoch_slot_of(line);
+		util_atomic_store_explicit64(&s->line, line,
+			memory_order_relaxed);
+		util_atomic_store_explicit64(&s->epoch, e,
+			memory_order_relaxed);
+	}
+}
+
+/*
+ * persist_epoch_drain -- advances the global epoch; called after every drain
+ */
+void
+persist_epoch_drain(void)
+{
+	util_fetch_and_add64(&Epoch, 1);
+}
+
+/*
+ * persist_epoch_assert_ordered -- asserts that every tracked cache line in
+ *	the range was persisted in an earlier epoch, i.e. that a drain
+ *	separates its persist from the stores now in flight
+ */
+void
+persist_epoch_assert_ordered(const void *addr, size_t len, const char *what)
+{
+	uint64_t e = persist_epoch_current();
+	uint64_t first = (uint64_t)addr & ~((uint64_t)CACHELINE_SIZE - 1);
+	uint64_t last = ((uint64_t)addr + (len ? len - 1 : 0)) &
+		~((uint64_t)CACHELINE_SIZE - 1);
+
+	for (uint64_t line = first; line <= last; line += CACHELINE_SIZE) {
+		struct persist_epoch_slot *s = persist_epoch_slot_of(line);
+
+		uint64_t sline;
+		util_atomic_load_explicit64(&s->line, &sline,
+			memory_order_relaxed);
+		if (sline != line)
+			continue; /* never persisted or evicted, skip */
+
+		uint64_t sepoch;
+		util_atomic_load_explicit64(&s->epoch, &sepoch,
+			memory_order_relaxed);
+		if (sepoch >= e)
+			CORE_LOG_FATAL(
+				"persist ordering violation: %s: line 0x%" PRIx64
+				" persisted in epoch %" PRIu64
+				" with no drain before epoch %" PRIu64,
+				what, line, sepoch, e);
+	}
+}
+
+/*
+ * persist_epoch_assert_advanced -- asserts that at least one drain was
+ *	issued since the given epoch was read
+ */
+void
+persist_epoch_assert_advanced(uint64_t epoch, const char *what)
+{
+	uint64_t e = persist_epoch_current();
+
+	if (e <= epoch)
+		CORE_LOG_FATAL(
+			"persist ordering violation: %s: no drain since epoch %"
+			PRIu64, what, epoch);
+}
+
+#endif
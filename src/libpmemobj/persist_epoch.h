@@ -0,0 +1,81 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright 2026, Intel Corporation */
+
+/*
+ * persist_epoch.h -- runtime persist-ordering assertions
+ *
+ * An opt-in debug layer, enabled by building with
+ * PMEMOBJ_PERSIST_EPOCHS=y, that catches persist-ordering bugs online
+ * rather than offline under pmreorder. Every drain issued through
+ * pmemops advances a global epoch; every persisted cache line records
+ * the epoch of its last persist in a sparse hash. Code that relies on
+ * an ordering invariant - the redo log must be durable before it is
+ * applied, the applied data before the log is invalidated - asserts it
+ * by checking that the relied-upon lines were persisted in an earlier
+ * epoch, i.e. that a drain separates them from the current stores.
+ *
+ * Hash collisions evict the previous line, so a check of an evicted
+ * line is silently skipped: collisions can hide a violation, never
+ * report a false one. When the flag is off everything here compiles
+ * to nothing.
+ */
+
+#ifndef LIBPMEMOBJ_PERSIST_EPOCH_H
+#define LIBPMEMOBJ_PERSIST_EPOCH_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "util.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef PMEMOBJ_PERSIST_EPOCHS
+
+void persist_epoch_record(const void *addr, size_t len);
+void persist_epoch_drain(void);
+uint64_t persist_epoch_current(void);
+void persist_epoch_assert_ordered(const void *addr, size_t len,
+	const char *what);
+void persist_epoch_assert_advanced(uint64_t epoch, const char *what);
+
+#else
+
+static force_inline void
+persist_epoch_record(const void *addr, size_t len)
+{
+	SUPPRESS_UNUSED(addr, len);
+}
+
+static force_inline void
+persist_epoch_drain(void)
+{
+}
+
+static force_inline uint64_t
+persist_epoch_current(void)
+{
+	return 0;
+}
+
+static force_inline void
+persist_epoch_assert_ordered(const void *addr, size_t len, const char *what)
+{
+	SUPPRESS_UNUSED(addr, len, what);
+}
+
+static force_inline void
+persist_epoch_assert_advanced(uint64_t epoch, const char *what)
+{
+	SUPPRESS_UNUSED(epoch, what);
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -10,6 +10,7 @@
  */
 
 #include <inttypes.h>
+#include <limits.h>
 #include "bucket.h"
 #include "ctl.h"
 #include "libpmemobj/ctl.h"
@@ -22,7 +23,10 @@
 #include "out.h"
 #include "palloc.h"
 #include "pmalloc.h"
+#include "maintenance.h"
+#include "alloc.h"
 #include "alloc_class.h"
+#include "os.h"
 #include "set.h"
 #include "mmap.h"
 
@@ -85,6 +89,110 @@ pmalloc_operation_release(PMEMobjpool *pop)
 	lane_release(pop);
 }
 
+/*
+ * The allocation latency tracer records a sample for every allocator
+ * operation that takes longer than the configured threshold. Samples go
+ * into per-lane rings - a lane is held exclusively for the duration of an
+ * operation, so each ring has at most one producer at any given time - and
+ * are drained by a reader through the heap.lat_trace.samples ctl query.
+ * With the threshold unset the tracer costs a single branch per operation.
+ */
+
+/* length of a single per-lane sample ring, must be a power of two */
+#define LAT_TRACE_RING_LEN 1024
+
+struct lat_trace_ring {
+	uint64_t head; /* advanced by the lane holder */
+	uint64_t tail; /* advanced by the draining reader */
+	struct pobj_lat_sample buf[LAT_TRACE_RING_LEN];
+};
+
+struct lat_trace {
+	uint64_t threshold; /* minimal duration to record, 0 disables */
+	uint64_t dropped;   /* samples lost to full rings */
+	unsigned nrings;
+	struct lat_trace_ring ring[];
+};
+
+/*
+ * lat_trace_now -- (internal) reads the monotonic clock in nanoseconds
+ */
+static inline uint64_t
+lat_trace_now(void)
+{
+	struct timespec ts;
+	os_clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * lat_trace_threshold -- (internal) reads the sampling threshold, 0 when the
+ *	tracer is disabled
+ */
+static inline uint64_t
+lat_trace_threshold(PMEMobjpool *pop)
+{
+	struct lat_trace *lt = pop->lat_trace;
+	if (lt == NULL)
+		return 0;
+
+	uint64_t threshold;
+	util_atomic_load_explicit64(&lt->threshold, &threshold,
+		memory_order_acquire);
+
+	return threshold;
+}
+
+/*
+ * lat_trace_record -- (internal) stores one sample in the ring of the lane
+ *	held by the calling thread
+ */
+static void
+lat_trace_record(PMEMobjpool *pop, int op, size_t size,
+	uint64_t start, uint64_t nsecs)
+{
+	struct lat_trace *lt = pop->lat_trace;
+
+	struct lane *lane;
+	lane_hold(pop, &lane);
+
+	unsigned idx = (unsigned)(lane - pop->lanes_desc.lane);
+	if (idx >= lt->nrings) {
+		lane_release(pop);
+		return;
+	}
+
+	struct lat_trace_ring *r = &lt->ring[idx];
+
+	uint64_t tail;
+	util_atomic_load_explicit64(&r->tail, &tail, memory_order_acquire);
+	if (r->head - tail == LAT_TRACE_RING_LEN) {
+		util_fetch_and_add64(&lt->dropped, 1);
+	} else {
+		struct pobj_lat_sample *s =
+			&r->buf[r->head % LAT_TRACE_RING_LEN];
+		s->timestamp = start;
+		s->size = size;
+		s->nsecs = nsecs;
+		s->op = op;
+		util_atomic_store_explicit64(&r->head, r->head + 1,
+			memory_order_release);
+	}
+
+	lane_release(pop);
+}
+
+/*
+ * pmalloc_lat_trace_delete -- releases the latency tracer state
+ */
+void
+pmalloc_lat_trace_delete(PMEMobjpool *pop)
+{
+	Free(pop->lat_trace);
+	pop->lat_trace = NULL;
+}
+
 /*
  * pmalloc -- allocates a new block of memory
  *
@@ -96,6 +204,9 @@ int
 pmalloc(PMEMobjpool *pop, uint64_t *off, size_t size,
 	uint64_t extra_field, uint16_t object_flags)
 {
+	uint64_t threshold = lat_trace_threshold(pop);
+	uint64_t start = threshold ? lat_trace_now() : 0;
+
 	struct operation_context *ctx =
 		pmalloc_operation_hold_type(pop, OPERATION_INTERNAL, 1);
 
@@ -104,6 +215,13 @@ pmalloc(PMEMobjpool *pop, uint64_t *off, size_t size,
 
 	pmalloc_operation_release(pop);
 
+	if (threshold) {
+		uint64_t nsecs = lat_trace_now() - start;
+		if (nsecs >= threshold)
+			lat_trace_record(pop, PALLOC_TRACE_ALLOC, size,
+				start, nsecs);
+	}
+
 	return ret;
 }
 
@@ -120,6 +238,9 @@ pmalloc_construct(PMEMobjpool *pop, uint64_t *off, size_t size,
 	palloc_constr constructor, void *arg,
 	uint64_t extra_field, uint16_t object_flags, uint16_t class_id)
 {
+	uint64_t threshold = lat_trace_threshold(pop);
+	uint64_t start = threshold ? lat_trace_now() : 0;
+
 	struct operation_context *ctx =
 		pmalloc_operation_hold_type(pop, OPERATION_INTERNAL, 1);
 
@@ -128,6 +249,13 @@ pmalloc_construct(PMEMobjpool *pop, uint64_t *off, size_t size,
 
 	pmalloc_operation_release(pop);
 
+	if (threshold) {
+		uint64_t nsecs = lat_trace_now() - start;
+		if (nsecs >= threshold)
+			lat_trace_record(pop, PALLOC_TRACE_ALLOC, size,
+				start, nsecs);
+	}
+
 	return ret;
 }
 
@@ -142,6 +270,9 @@ int
 prealloc(PMEMobjpool *pop, uint64_t *off, size_t size,
 	uint64_t extra_field, uint16_t object_flags)
 {
+	uint64_t threshold = lat_trace_threshold(pop);
+	uint64_t start = threshold ? lat_trace_now() : 0;
+
 	struct operation_context *ctx =
 		pmalloc_operation_hold_type(pop, OPERATION_INTERNAL, 1);
 
@@ -150,6 +281,13 @@ prealloc(PMEMobjpool *pop, uint64_t *off, size_t size,
 
 	pmalloc_operation_release(pop);
 
+	if (threshold) {
+		uint64_t nsecs = lat_trace_now() - start;
+		if (nsecs >= threshold)
+			lat_trace_record(pop, PALLOC_TRACE_REALLOC, size,
+				start, nsecs);
+	}
+
 	return ret;
 }
 
@@ -163,6 +301,9 @@ prealloc(PMEMobjpool *pop, uint64_t *off, size_t size,
 void
 pfree(PMEMobjpool *pop, uint64_t *off)
 {
+	uint64_t threshold = lat_trace_threshold(pop);
+	uint64_t start = threshold ? lat_trace_now() : 0;
+
 	struct operation_context *ctx =
 		pmalloc_operation_hold_type(pop, OPERATION_INTERNAL, 1);
 
@@ -174,6 +315,98 @@ pfree(PMEMobjpool *pop, uint64_t *off)
 	ASSERTeq(ret, 0);
 
 	pmalloc_operation_release(pop);
+
+	if (threshold) {
+		uint64_t nsecs = lat_trace_now() - start;
+		if (nsecs >= threshold)
+			lat_trace_record(pop, PALLOC_TRACE_FREE, 0,
+				start, nsecs);
+	}
+}
+
+/*
+ * pmalloc_snapshot_restore -- (internal) loads the clean shutdown snapshot of
+ *	the volatile heap state, if a valid one exists
+ *
+ * The snapshot is only trusted if it was written by the immediately preceding
+ * instance of the pool (its run id is exactly one instance behind ours) and
+ * its checksum verifies; anything else means the pool was not closed cleanly
+ * and the zone reclamation scans must rebuild the state from the bitmaps.
+ */
+static int
+pmalloc_snapshot_restore(PMEMobjpool *pop)
+{
+	uint64_t off = pop->heap_snapshot_offset;
+	if (off == 0)
+		return -1;
+
+	if (!OBJ_OFF_FROM_HEAP(pop, off) ||
+	    !OBJ_OFF_FROM_HEAP(pop, off + sizeof(struct heap_snapshot) - 1)) {
+		CORE_LOG_ERROR("invalid heap snapshot offset");
+		return -1;
+	}
+
+	struct heap_snapshot *s = OBJ_OFF_TO_PTR(pop, off);
+
+	if (s->run_id != pop->run_id - 2)
+		return -1; /* the previous shutdown was not clean */
+
+	uint64_t heap_end = pop->heap_offset + pop->heap_size;
+	if (s->nentries > (heap_end - off - sizeof(*s)) /
+	    sizeof(struct recycler_element)) {
+		CORE_LOG_ERROR("invalid heap snapshot length");
+		return -1;
+	}
+
+	size_t size = sizeof(*s) +
+		s->nentries * sizeof(struct recycler_element);
+	if (util_checksum(s, size, &s->checksum, 0, 0) != 1) {
+		CORE_LOG_ERROR("invalid heap snapshot checksum");
+		return -1;
+	}
+
+	return heap_snapshot_load(&pop->heap, s->entries, s->nentries);
+}
+
+/*
+ * pmalloc_snapshot_write -- (internal) persists the volatile run state so
+ *	that a clean open can skip the run bitmap scans
+ */
+static void
+pmalloc_snapshot_write(PMEMobjpool *pop)
+{
+	if (pop->rdonly)
+		return;
+
+	if (pop->heap_snapshot_offset != 0)
+		pfree(pop, &pop->heap_snapshot_offset);
+
+	if (!pop->heap.snapshot_enabled)
+		return;
+
+	size_t nruns = heap_snapshot_gather(&pop->heap, NULL, 0);
+	size_t size = sizeof(struct heap_snapshot) +
+		nruns * sizeof(struct recycler_element);
+
+	if (pmalloc(pop, &pop->heap_snapshot_offset, size, 0, 0) != 0) {
+		CORE_LOG_WARNING("failed to allocate the heap state snapshot");
+		return;
+	}
+
+	struct heap_snapshot *s =
+		OBJ_OFF_TO_PTR(pop, pop->heap_snapshot_offset);
+
+	/*
+	 * The allocation above could have turned a free chunk into a new run,
+	 * in which case that run simply doesn't make it into the snapshot and
+	 * gets scanned on open like any unrecorded one.
+	 */
+	s->run_id = pop->run_id;
+	s->nentries = heap_snapshot_gather(&pop->heap, s->entries, nruns);
+
+	size = sizeof(*s) + s->nentries * sizeof(struct recycler_element);
+	util_checksum(s, size, &s->checksum, 1, 0);
+	pmemops_persist(&pop->p_ops, s, size);
 }
 
 /*
@@ -182,10 +415,12 @@ pfree(PMEMobjpool *pop, uint64_t *off)
 int
 pmalloc_boot(PMEMobjpool *pop)
 {
+	pop->lat_trace = NULL;
+
 	int ret = palloc_boot(&pop->heap, (char *)pop + pop->heap_offset,
 			pop->set->poolsize - pop->heap_offset, &pop->heap_size,
 			pop, &pop->p_ops,
-			pop->stats, pop->set);
+			pop->stats, pop->set, pop->feat_compat);
 	if (ret)
 		return ret;
 
@@ -195,10 +430,22 @@ pmalloc_boot(PMEMobjpool *pop)
 #endif
 
 	ret = palloc_buckets_init(&pop->heap);
-	if (ret)
+	if (ret) {
 		palloc_heap_cleanup(&pop->heap);
+		return ret;
+	}
 
-	return ret;
+	/*
+	 * Without a clean shutdown snapshot the run occupancies can optionally
+	 * be precomputed by a pool of worker threads, so that the reclamation
+	 * scans don't walk the run bitmaps one by one later on.
+	 */
+	if (pmalloc_snapshot_restore(pop) != 0 &&
+	    Default_boot_scan_threads > 0)
+		heap_boot_scan_parallel(&pop->heap,
+			(unsigned)Default_boot_scan_threads);
+
+	return 0;
 }
 
 /*
@@ -207,6 +454,8 @@ pmalloc_boot(PMEMobjpool *pop)
 int
 pmalloc_cleanup(PMEMobjpool *pop)
 {
+	pmalloc_lat_trace_delete(pop);
+	pmalloc_snapshot_write(pop);
 	palloc_heap_cleanup(&pop->heap);
 
 	return 0;
@@ -435,9 +684,121 @@ static const struct ctl_node CTL_NODE(new)[] = {
 	CTL_NODE_END
 };
 
+/*
+ * Only histogram buckets holding at least 1/20th (5%) of all recorded
+ * allocations are considered dominant enough to deserve a dedicated
+ * allocation class.
+ */
+#define ALLOC_HIST_AUTOTUNE_DIVISOR 20
+
+/*
+ * CTL_RUNNABLE_HANDLER(autotune) -- creates allocation classes tailored to
+ *	the sizes that dominate the recorded allocation size histogram
+ */
+static int
+CTL_RUNNABLE_HANDLER(autotune)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	struct alloc_class_collection *ac = heap_alloc_classes(&pop->heap);
+	uint64_t hist[STATS_ALLOC_HIST_BUCKETS];
+
+	uint64_t total = 0;
+	for (int i = 0; i < STATS_ALLOC_HIST_BUCKETS; ++i) {
+		hist[i] = stats_transient_sum(pop->stats,
+			offsetof(struct stats_transient,
+			alloc_size_histogram[i]));
+		total += hist[i];
+	}
+
+	if (total == 0) {
+		ERR_WO_ERRNO("allocation size histogram is empty");
+		errno = EINVAL;
+		return -1;
+	}
+
+	unsigned ntuned = 0;
+	/* the last bucket is a catch-all with no meaningful upper bound */
+	for (int i = 0; i < STATS_ALLOC_HIST_BUCKETS - 1; ++i) {
+		if (hist[i] * ALLOC_HIST_AUTOTUNE_DIVISOR < total)
+			continue;
+
+		size_t size = ((size_t)i + 1) * STATS_ALLOC_HIST_UNIT;
+		struct alloc_class *c = alloc_class_tune_for_size(ac, size);
+		if (c == NULL)
+			continue;
+
+		if (heap_create_alloc_class_buckets(&pop->heap, c) != 0)
+			return -1;
+
+		ntuned++;
+	}
+
+	if (arg != NULL)
+		*(unsigned *)arg = ntuned;
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(enabled) = CTL_ARG_BOOLEAN;
+
+/*
+ * CTL_READ_HANDLER(enabled, headerless) -- reads whether classes tuned for a
+ *	fixed allocation size use headerless runs
+ */
+static int
+CTL_READ_HANDLER(enabled, headerless)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	int *arg_out = arg;
+
+	*arg_out = alloc_class_get_headerless_runs(
+		heap_alloc_classes(&pop->heap));
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(enabled, headerless) -- enables or disables headerless
+ *	runs for classes tuned for a fixed allocation size
+ *
+ * Objects allocated from a headerless run carry no allocation header at all,
+ * so their type number reads back as zero; the capacity the headers would
+ * have consumed serves allocations instead.
+ */
+static int
+CTL_WRITE_HANDLER(enabled, headerless)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	alloc_class_set_headerless_runs(heap_alloc_classes(&pop->heap),
+		*(int *)arg);
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(headerless)[] = {
+	CTL_LEAF_RW(enabled, headerless),
+
+	CTL_NODE_END
+};
+
 static const struct ctl_node CTL_NODE(alloc_class)[] = {
 	CTL_INDEXED(class_id),
 	CTL_INDEXED(new),
+	CTL_LEAF_RUNNABLE(autotune),
+	CTL_CHILD(headerless),
 
 	CTL_NODE_END
 };
@@ -600,6 +961,46 @@ CTL_READ_HANDLER(automatic, narenas)(void *ctx,
 	return 0;
 }
 
+/*
+ * CTL_READ_HANDLER(auto_scale) -- reads whether the heap grows the number of
+ *	arenas in response to bucket contention
+ */
+static int
+CTL_READ_HANDLER(auto_scale)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	int *arg_out = arg;
+
+	*arg_out = heap_get_arena_auto_scale(&pop->heap);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(auto_scale) -- enables or disables automatic arena
+ *	scaling
+ */
+static int
+CTL_WRITE_HANDLER(auto_scale)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	int arg_in = *(int *)arg;
+
+	heap_set_arena_auto_scale(&pop->heap, arg_in);
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(auto_scale) = CTL_ARG_BOOLEAN;
+
 /*
  * CTL_READ_HANDLER(arena_id) -- reads the id of the arena
  * assigned to the calling thread
@@ -729,85 +1130,817 @@ CTL_READ_HANDLER(automatic)(void *ctx,
 
 static struct ctl_argument CTL_ARG(automatic) = CTL_ARG_BOOLEAN;
 
-static const struct ctl_node CTL_NODE(size)[] = {
-	CTL_LEAF_RW(granularity),
-	CTL_LEAF_RUNNABLE(extend),
-
-	CTL_NODE_END
-};
-
 /*
- * CTL_READ_HANDLER(size) -- reads usable size of specified arena
+ * CTL_READ_HANDLER(enabled) -- reads whether per-thread allocation magazines
+ *	are enabled
  */
 static int
-CTL_READ_HANDLER(size)(void *ctx,
+CTL_READ_HANDLER(enabled)(void *ctx,
 	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
 {
 	/* suppress unused-parameter errors */
-	SUPPRESS_UNUSED(source);
+	SUPPRESS_UNUSED(source, indexes);
 
 	PMEMobjpool *pop = ctx;
-	unsigned arena_id;
-	unsigned narenas;
-	size_t *arena_size = arg;
-
-	struct ctl_index *idx = PMDK_SLIST_FIRST(indexes);
-	ASSERTeq(strcmp(idx->name, "arena_id"), 0);
-
-	/* take index of arena */
-	arena_id = (unsigned)idx->value;
-	/* take number of arenas */
-	narenas = heap_get_narenas_total(&pop->heap);
-
-	/*
-	 * check if index is not bigger than number of arenas
-	 * or if it is not equal zero
-	 */
-	if (arena_id < 1 || arena_id > narenas) {
-		ERR_WO_ERRNO("arena id outside of the allowed range: <1,%u>",
-			narenas);
-		errno = ERANGE;
-		return -1;
-	}
-
-	/* take buckets for arena */
-	struct bucket_locked **buckets;
-	buckets = heap_get_arena_buckets(&pop->heap, arena_id);
-
-	/* calculate number of reservation for arena using buckets */
-	unsigned size = 0;
-	for (int i = 0; i < MAX_ALLOCATION_CLASSES; ++i) {
-		if (buckets[i] != NULL) {
-			struct bucket *b = bucket_acquire(buckets[i]);
-			struct memory_block_reserved *active =
-				bucket_active_block(b);
-
-			size += active ? active->m.size_idx : 0;
-			bucket_release(b);
-		}
-	}
+	int *arg_out = arg;
 
-	*arena_size = size * CHUNKSIZE;
+	*arg_out = heap_get_magazines_enabled(&pop->heap);
 
 	return 0;
 }
 
 /*
- * CTL_RUNNABLE_HANDLER(create) -- create new arena in the heap
+ * CTL_WRITE_HANDLER(enabled) -- enables or disables per-thread allocation
+ *	magazines
  */
 static int
-CTL_RUNNABLE_HANDLER(create)(void *ctx,
+CTL_WRITE_HANDLER(enabled)(void *ctx,
 	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
 {
 	/* suppress unused-parameter errors */
-	SUPPRESS_UNUSED(ctx, source, indexes);
+	SUPPRESS_UNUSED(source, indexes);
 
 	PMEMobjpool *pop = ctx;
-	unsigned *arena_id = arg;
-	struct palloc_heap *heap = &pop->heap;
+	int arg_in = *(int *)arg;
 
-	int ret = heap_arena_create(heap);
-	if (ret < 0)
+	heap_set_magazines_enabled(&pop->heap, arg_in);
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(magazines)[] = {
+	CTL_LEAF_RW(enabled),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_READ_HANDLER(enabled, zone_preinit) -- reads whether the background
+ *	zone pre-initialization thread is running
+ */
+static int
+CTL_READ_HANDLER(enabled, zone_preinit)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	int *arg_out = arg;
+
+	*arg_out = heap_get_zone_preinit_enabled(&pop->heap);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(enabled, zone_preinit) -- starts or stops the background
+ *	zone pre-initialization thread
+ */
+static int
+CTL_WRITE_HANDLER(enabled, zone_preinit)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	int arg_in = *(int *)arg;
+
+	return heap_set_zone_preinit_enabled(&pop->heap, arg_in);
+}
+
+static const struct ctl_node CTL_NODE(zone_preinit)[] = {
+	CTL_LEAF_RW(enabled, zone_preinit),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_READ_HANDLER(budget, prezero) -- reads the number of parked pre-zeroed
+ *	reservation slots
+ */
+static int
+CTL_READ_HANDLER(budget, prezero)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	long long *arg_out = arg;
+
+	*arg_out = (long long)palloc_prezero_get_budget(&pop->heap);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(budget, prezero) -- sets the number of parked pre-zeroed
+ *	reservation slots, 0 disables the fast path
+ */
+static int
+CTL_WRITE_HANDLER(budget, prezero)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	long long arg_in = *(long long *)arg;
+
+	if (arg_in < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return palloc_prezero_set_budget(&pop->heap, (unsigned)arg_in);
+}
+
+static const struct ctl_argument CTL_ARG(budget) = CTL_ARG_LONG_LONG;
+
+static const struct ctl_node CTL_NODE(prezero)[] = {
+	CTL_LEAF_RW(budget, prezero),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_READ_HANDLER(high, watermark) -- reads the high occupancy watermark
+ *	percentage
+ */
+static int
+CTL_READ_HANDLER(high, watermark)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	long long *arg_out = arg;
+
+	*arg_out = (long long)palloc_watermark_get_high(&pop->heap);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(high, watermark) -- sets the high occupancy watermark
+ *	as a percentage of the heap size, 0 disables the checks
+ */
+static int
+CTL_WRITE_HANDLER(high, watermark)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	long long arg_in = *(long long *)arg;
+
+	if (arg_in < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return palloc_watermark_set_high(&pop->heap, (unsigned)arg_in);
+}
+
+/*
+ * CTL_READ_HANDLER(low, watermark) -- reads the low occupancy watermark
+ *	percentage
+ */
+static int
+CTL_READ_HANDLER(low, watermark)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	long long *arg_out = arg;
+
+	*arg_out = (long long)palloc_watermark_get_low(&pop->heap);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(low, watermark) -- sets the low occupancy watermark the
+ *	all-clear fires at
+ */
+static int
+CTL_WRITE_HANDLER(low, watermark)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	long long arg_in = *(long long *)arg;
+
+	if (arg_in < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return palloc_watermark_set_low(&pop->heap, (unsigned)arg_in);
+}
+
+static const struct ctl_argument CTL_ARG(high) = CTL_ARG_LONG_LONG;
+static const struct ctl_argument CTL_ARG(low) = CTL_ARG_LONG_LONG;
+
+static const struct ctl_node CTL_NODE(watermark)[] = {
+	CTL_LEAF_RW(high, watermark),
+	CTL_LEAF_RW(low, watermark),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_READ_HANDLER(enabled, recycle) -- reads whether the background run
+ *	recycling task is enabled
+ */
+static int
+CTL_READ_HANDLER(enabled, recycle)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	int *arg_out = arg;
+
+	*arg_out = heap_get_recycle_enabled(&pop->heap);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(enabled, recycle) -- enables or disables the background
+ *	run recycling task
+ */
+static int
+CTL_WRITE_HANDLER(enabled, recycle)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	int arg_in = *(int *)arg;
+
+	return heap_set_recycle_enabled(&pop->heap, arg_in);
+}
+
+static const struct ctl_node CTL_NODE(recycle)[] = {
+	CTL_LEAF_RW(enabled, recycle),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_READ_HANDLER(period, heatmap) -- reads the oid translation sampling
+ *	period of the access heatmap
+ */
+static int
+CTL_READ_HANDLER(period, heatmap)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(ctx, source, indexes);
+
+	long long *arg_out = arg;
+
+	*arg_out = (long long)_pobj_heat_period;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(period, heatmap) -- sets the oid translation sampling
+ *	period of the access heatmap, 0 disables the sampling
+ *
+ * The sampling hook lives in the inlined translation fast path, so the
+ * period is necessarily process-global rather than per-pool; the recorded
+ * samples still land in the per-zone counters of the pool each sampled oid
+ * belongs to, readable through stats.heap.zone.<zone_id>.heat.
+ */
+static int
+CTL_WRITE_HANDLER(period, heatmap)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(ctx, source, indexes);
+
+	long long arg_in = *(long long *)arg;
+
+	if (arg_in < 0 || arg_in > UINT_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	_pobj_heat_period = (unsigned)arg_in;
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(period) = CTL_ARG_LONG_LONG;
+
+static const struct ctl_node CTL_NODE(heatmap)[] = {
+	CTL_LEAF_RW(period, heatmap),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_READ_HANDLER(budget, maintenance) -- reads the per-cycle step budget
+ *	of the pool maintenance thread
+ */
+static int
+CTL_READ_HANDLER(budget, maintenance)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	long long *arg_out = arg;
+
+	if (pop->heap.maint == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	*arg_out = (long long)maintenance_get_budget(pop->heap.maint);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(budget, maintenance) -- sets the per-cycle step budget
+ *	of the pool maintenance thread
+ */
+static int
+CTL_WRITE_HANDLER(budget, maintenance)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	long long arg_in = *(long long *)arg;
+
+	if (pop->heap.maint == NULL || arg_in <= 0 || arg_in > UINT_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return maintenance_set_budget(pop->heap.maint, (unsigned)arg_in);
+}
+
+/*
+ * CTL_READ_HANDLER(cpu, maintenance) -- reads the cpu the maintenance
+ *	thread is pinned to, -1 means unrestricted
+ */
+static int
+CTL_READ_HANDLER(cpu, maintenance)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	long long *arg_out = arg;
+
+	if (pop->heap.maint == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	*arg_out = (long long)maintenance_get_cpu(pop->heap.maint);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(cpu, maintenance) -- pins the maintenance thread to the
+ *	given cpu, -1 clears the affinity
+ */
+static int
+CTL_WRITE_HANDLER(cpu, maintenance)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	long long arg_in = *(long long *)arg;
+
+	if (pop->heap.maint == NULL || arg_in < -1 || arg_in > INT_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return maintenance_set_cpu(pop->heap.maint, (int)arg_in);
+}
+
+static const struct ctl_argument CTL_ARG(cpu) = CTL_ARG_LONG_LONG;
+
+/*
+ * CTL_READ_HANDLER(bw_limit, maintenance) -- reads the background bandwidth
+ *	cap in bytes per second, 0 means unthrottled
+ */
+static int
+CTL_READ_HANDLER(bw_limit, maintenance)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	long long *arg_out = arg;
+
+	if (pop->heap.maint == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	*arg_out = (long long)maintenance_get_bw_limit(pop->heap.maint);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(bw_limit, maintenance) -- caps the bandwidth of the
+ *	pool's background work at the given bytes per second, 0 lifts the cap
+ */
+static int
+CTL_WRITE_HANDLER(bw_limit, maintenance)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	long long arg_in = *(long long *)arg;
+
+	if (pop->heap.maint == NULL || arg_in < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return maintenance_set_bw_limit(pop->heap.maint, (uint64_t)arg_in);
+}
+
+static const struct ctl_argument CTL_ARG(bw_limit) = CTL_ARG_LONG_LONG;
+
+/*
+ * CTL_READ_HANDLER(bw_measured, maintenance) -- reads the bandwidth the
+ *	background work consumed over the last measurement window, in bytes
+ *	per second
+ */
+static int
+CTL_READ_HANDLER(bw_measured, maintenance)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	long long *arg_out = arg;
+
+	if (pop->heap.maint == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	*arg_out = (long long)maintenance_get_bw_measured(pop->heap.maint);
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(maintenance)[] = {
+	CTL_LEAF_RW(budget, maintenance),
+	CTL_LEAF_RW(cpu, maintenance),
+	CTL_LEAF_RW(bw_limit, maintenance),
+	CTL_LEAF_RO(bw_measured, maintenance),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_READ_HANDLER(enabled, snapshot) -- reads whether a clean shutdown
+ *	snapshot of the heap state will be written on close
+ */
+static int
+CTL_READ_HANDLER(enabled, snapshot)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	int *arg_out = arg;
+
+	*arg_out = pop->heap.snapshot_enabled;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(enabled, snapshot) -- enables or disables writing a clean
+ *	shutdown snapshot of the heap state on close
+ */
+static int
+CTL_WRITE_HANDLER(enabled, snapshot)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	pop->heap.snapshot_enabled = *(int *)arg;
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(snapshot)[] = {
+	CTL_LEAF_RW(enabled, snapshot),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_READ_HANDLER(enabled, nt_headers) -- reads whether chunk headers are
+ *	written with non-temporal stores
+ */
+static int
+CTL_READ_HANDLER(enabled, nt_headers)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	int *arg_out = arg;
+
+	*arg_out = pop->heap.nt_headers_enabled;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(enabled, nt_headers) -- enables or disables writing chunk
+ *	headers with non-temporal stores
+ *
+ * The frequently rewritten header lines then bypass the CPU cache and only
+ * have to be drained, which can be cheaper than a store and a flush on
+ * platforms with a slow flush instruction.
+ */
+static int
+CTL_WRITE_HANDLER(enabled, nt_headers)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	pop->heap.nt_headers_enabled = *(int *)arg;
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(nt_headers)[] = {
+	CTL_LEAF_RW(enabled, nt_headers),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_READ_HANDLER(nodes) -- reads the number of numa nodes the arenas are
+ *	partitioned across
+ */
+static int
+CTL_READ_HANDLER(nodes)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	unsigned *arg_out = arg;
+
+	*arg_out = heap_get_numa_nodes(&pop->heap);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(nodes) -- partitions the arenas across the given number
+ *	of numa nodes, 0 disables numa-aware thread assignment
+ */
+static int
+CTL_WRITE_HANDLER(nodes)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	int arg_in = *(int *)arg;
+
+	if (arg_in < 0) {
+		ERR_WO_ERRNO("invalid number of numa nodes");
+		errno = EINVAL;
+		return -1;
+	}
+
+	heap_set_numa_nodes(&pop->heap, (unsigned)arg_in);
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(nodes) = CTL_ARG_INT;
+
+static const struct ctl_node CTL_NODE(numa)[] = {
+	CTL_LEAF_RW(nodes),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_WRITE_HANDLER(advise, cold) -- marks every zone with no allocator
+ *	activity for at least the given number of seconds as cold
+ */
+static int
+CTL_WRITE_HANDLER(advise, cold)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	long long arg_in = *(long long *)arg;
+	if (arg_in < 0) {
+		ERR_WO_ERRNO("invalid idle time threshold");
+		errno = EINVAL;
+		return -1;
+	}
+
+	return heap_zone_advise_cold(&pop->heap, (uint64_t)arg_in,
+		MADV_COLD, NULL);
+}
+
+/*
+ * CTL_WRITE_HANDLER(pageout, cold) -- asks the kernel to reclaim the pages
+ *	of every zone with no allocator activity for at least the given number
+ *	of seconds
+ */
+static int
+CTL_WRITE_HANDLER(pageout, cold)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	long long arg_in = *(long long *)arg;
+	if (arg_in < 0) {
+		ERR_WO_ERRNO("invalid idle time threshold");
+		errno = EINVAL;
+		return -1;
+	}
+
+	return heap_zone_advise_cold(&pop->heap, (uint64_t)arg_in,
+		MADV_PAGEOUT, NULL);
+}
+
+static const struct ctl_argument CTL_ARG(advise) = CTL_ARG_LONG_LONG;
+static const struct ctl_argument CTL_ARG(pageout) = CTL_ARG_LONG_LONG;
+
+static const struct ctl_node CTL_NODE(cold)[] = {
+	CTL_LEAF_WO(advise, cold),
+	CTL_LEAF_WO(pageout, cold),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_WRITE_HANDLER(repair, hugepages) -- collapses the pool mapping back
+ *	into huge pages
+ *
+ * Memory pressure can split the huge page mappings of the pool into base
+ * pages and the kernel never reassembles them on its own.  The collapse is
+ * synchronous, so this is best triggered during quiet periods.
+ */
+static int
+CTL_WRITE_HANDLER(repair, hugepages)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	int arg_in = *(int *)arg;
+	if (!arg_in)
+		return 0;
+
+	return util_range_hugepage_repair(pop->addr, pop->set->poolsize);
+}
+
+static const struct ctl_argument CTL_ARG(repair) = CTL_ARG_BOOLEAN;
+
+static const struct ctl_node CTL_NODE(hugepages)[] = {
+	CTL_LEAF_WO(repair, hugepages),
+
+	CTL_NODE_END
+};
+
+static const struct ctl_node CTL_NODE(size)[] = {
+	CTL_LEAF_RW(granularity),
+	CTL_LEAF_RUNNABLE(extend),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_READ_HANDLER(size) -- reads usable size of specified arena
+ */
+static int
+CTL_READ_HANDLER(size)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source);
+
+	PMEMobjpool *pop = ctx;
+	unsigned arena_id;
+	unsigned narenas;
+	size_t *arena_size = arg;
+
+	struct ctl_index *idx = PMDK_SLIST_FIRST(indexes);
+	ASSERTeq(strcmp(idx->name, "arena_id"), 0);
+
+	/* take index of arena */
+	arena_id = (unsigned)idx->value;
+	/* take number of arenas */
+	narenas = heap_get_narenas_total(&pop->heap);
+
+	/*
+	 * check if index is not bigger than number of arenas
+	 * or if it is not equal zero
+	 */
+	if (arena_id < 1 || arena_id > narenas) {
+		ERR_WO_ERRNO("arena id outside of the allowed range: <1,%u>",
+			narenas);
+		errno = ERANGE;
+		return -1;
+	}
+
+	/* take buckets for arena */
+	struct bucket_locked **buckets;
+	buckets = heap_get_arena_buckets(&pop->heap, arena_id);
+
+	/* calculate number of reservation for arena using buckets */
+	unsigned size = 0;
+	for (int i = 0; i < MAX_ALLOCATION_CLASSES; ++i) {
+		if (buckets[i] != NULL) {
+			struct bucket *b = bucket_acquire(buckets[i]);
+			struct memory_block_reserved *active =
+				bucket_active_block(b);
+
+			size += active ? active->m.size_idx : 0;
+			bucket_release(b);
+		}
+	}
+
+	*arena_size = size * CHUNKSIZE;
+
+	return 0;
+}
+
+/*
+ * CTL_RUNNABLE_HANDLER(create) -- create new arena in the heap
+ */
+static int
+CTL_RUNNABLE_HANDLER(create)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(ctx, source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	unsigned *arena_id = arg;
+	struct palloc_heap *heap = &pop->heap;
+
+	int ret = heap_arena_create(heap);
+	if (ret < 0)
 		return -1;
 
 	*arena_id = (unsigned)ret;
@@ -833,6 +1966,7 @@ static const struct ctl_node CTL_NODE(narenas)[] = {
 	CTL_LEAF_RO(automatic, narenas),
 	CTL_LEAF_RO(total),
 	CTL_LEAF_RW(max),
+	CTL_LEAF_RW(auto_scale),
 
 	CTL_NODE_END
 };
@@ -843,23 +1977,313 @@ static const struct ctl_node CTL_NODE(thread)[] = {
 	CTL_NODE_END
 };
 
+/* maximum length of the allocation trace file path accepted by the ctl */
+#define PALLOC_TRACE_PATH_MAX 512
+
+/*
+ * CTL_WRITE_HANDLER(start, trace) -- starts recording the allocation trace
+ *	to the given file
+ */
+static int
+CTL_WRITE_HANDLER(start, trace)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	const char *path = arg;
+
+	return palloc_trace_start(&pop->heap, path);
+}
+
+static const struct ctl_argument CTL_ARG(start) =
+	CTL_ARG_STRING(PALLOC_TRACE_PATH_MAX);
+
+/*
+ * CTL_RUNNABLE_HANDLER(stop, trace) -- stops recording the allocation trace
+ *	and flushes it to the file
+ */
+static int
+CTL_RUNNABLE_HANDLER(stop, trace)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, arg, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	return palloc_trace_stop(&pop->heap);
+}
+
+/*
+ * CTL_READ_HANDLER(enabled, trace) -- reads whether the allocation trace is
+ *	being recorded
+ */
+static int
+CTL_READ_HANDLER(enabled, trace)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	int *arg_out = arg;
+
+	*arg_out = palloc_trace_enabled(&pop->heap);
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(threshold, lat_trace) -- reads the latency tracer
+ *	sampling threshold
+ */
+static int
+CTL_READ_HANDLER(threshold, lat_trace)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	long long *arg_out = arg;
+
+	*arg_out = (long long)lat_trace_threshold(pop);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(threshold, lat_trace) -- sets the latency tracer
+ *	sampling threshold in nanoseconds, 0 disables the tracer
+ */
+static int
+CTL_WRITE_HANDLER(threshold, lat_trace)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	long long arg_in = *(long long *)arg;
+
+	if (arg_in < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (pop->lat_trace == NULL) {
+		unsigned nrings = pop->lanes_desc.runtime_nlanes;
+		struct lat_trace *lt = Zalloc(sizeof(*lt) +
+			nrings * sizeof(struct lat_trace_ring));
+		if (lt == NULL)
+			return -1;
+
+		lt->nrings = nrings;
+		pop->lat_trace = lt;
+	}
+
+	util_atomic_store_explicit64(&pop->lat_trace->threshold,
+		(uint64_t)arg_in, memory_order_release);
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(threshold) = CTL_ARG_LONG_LONG;
+
+/*
+ * CTL_READ_HANDLER(samples, lat_trace) -- drains the recorded latency
+ *	samples into the user-provided buffer
+ */
+static int
+CTL_READ_HANDLER(samples, lat_trace)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	struct pobj_lat_samples *req = arg;
+
+	req->drained = 0;
+
+	struct lat_trace *lt = pop->lat_trace;
+	if (lt == NULL)
+		return 0;
+
+	for (unsigned i = 0; i < lt->nrings && req->drained < req->max; ++i) {
+		struct lat_trace_ring *r = &lt->ring[i];
+
+		uint64_t head;
+		util_atomic_load_explicit64(&r->head, &head,
+			memory_order_acquire);
+
+		uint64_t tail = r->tail;
+		while (tail != head && req->drained < req->max) {
+			req->samples[req->drained++] =
+				r->buf[tail % LAT_TRACE_RING_LEN];
+			tail++;
+		}
+		util_atomic_store_explicit64(&r->tail, tail,
+			memory_order_release);
+	}
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(dropped, lat_trace) -- reads the number of samples lost
+ *	to full rings
+ */
+static int
+CTL_READ_HANDLER(dropped, lat_trace)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	uint64_t *arg_out = arg;
+
+	struct lat_trace *lt = pop->lat_trace;
+	*arg_out = 0;
+	if (lt != NULL)
+		util_atomic_load_explicit64(&lt->dropped, arg_out,
+			memory_order_acquire);
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(lat_trace)[] = {
+	CTL_LEAF_RW(threshold, lat_trace),
+	CTL_LEAF_RO(samples, lat_trace),
+	CTL_LEAF_RO(dropped, lat_trace),
+
+	CTL_NODE_END
+};
+
+static const struct ctl_node CTL_NODE(trace)[] = {
+	CTL_LEAF_WO(start, trace),
+	CTL_LEAF_RUNNABLE(stop, trace),
+	CTL_LEAF_RO(enabled, trace),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_RUNNABLE_HANDLER(reclaim) -- returns the backing storage of fully free
+ *	zones to the filesystem
+ *
+ * The optional argument receives the number of reclaimed bytes.
+ */
+static int
+CTL_RUNNABLE_HANDLER(reclaim)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	size_t reclaimed;
+	if (heap_reclaim_backing(&pop->heap, &reclaimed) != 0)
+		return -1;
+
+	if (arg != NULL)
+		*(size_t *)arg = reclaimed;
+
+	return 0;
+}
+
 static const struct ctl_node CTL_NODE(heap)[] = {
+	CTL_CHILD(trace),
+	CTL_CHILD(lat_trace),
 	CTL_CHILD(alloc_class),
 	CTL_CHILD(arena),
 	CTL_CHILD(size),
 	CTL_CHILD(thread),
 	CTL_CHILD(narenas),
+	CTL_CHILD(magazines),
+	CTL_CHILD(zone_preinit),
+	CTL_CHILD(prezero),
+	CTL_CHILD(watermark),
+	CTL_CHILD(recycle),
+	CTL_CHILD(maintenance),
+	CTL_CHILD(heatmap),
+	CTL_CHILD(snapshot),
+	CTL_CHILD(nt_headers),
+	CTL_CHILD(numa),
+	CTL_CHILD(cold),
+	CTL_CHILD(hugepages),
+	CTL_LEAF_RUNNABLE(reclaim),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_READ_HANDLER(latency_budget, policy) -- reads the foreground latency
+ *	budget in microseconds, 0 when unbounded
+ */
+static int
+CTL_READ_HANDLER(latency_budget, policy)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	long long *arg_out = arg;
+
+	*arg_out = (long long)heap_get_latency_budget(&pop->heap);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(latency_budget, policy) -- sets the foreground latency
+ *	budget in microseconds
+ *
+ * A non-zero budget defers non-essential allocator work (huge chunk
+ * coalescing) to the pool maintenance thread and enables the background
+ * tasks that pre-stage work off the critical path; 0 restores unbounded
+ * foreground operation.
+ */
+static int
+CTL_WRITE_HANDLER(latency_budget, policy)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+	long long arg_in = *(long long *)arg;
+
+	if (arg_in < 0 || arg_in > UINT_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return heap_set_latency_budget(&pop->heap, (unsigned)arg_in);
+}
+
+static const struct ctl_argument CTL_ARG(latency_budget) = CTL_ARG_LONG_LONG;
+
+static const struct ctl_node CTL_NODE(policy)[] = {
+	CTL_LEAF_RW(latency_budget, policy),
 
 	CTL_NODE_END
 };
 
 /*
- * pmalloc_ctl_register -- registers ctl nodes for "heap" module
+ * pmalloc_ctl_register -- registers ctl nodes for the "heap" and "policy"
+ *	modules
  */
 void
 pmalloc_ctl_register(PMEMobjpool *pop)
 {
 	CTL_REGISTER_MODULE(pop->ctl, heap);
+	CTL_REGISTER_MODULE(pop->ctl, policy);
 }
 
 /*
@@ -978,9 +2402,47 @@ CTL_WRITE_HANDLER(arenas_default_max)(void *ctx,
 static const struct ctl_argument CTL_ARG(arenas_default_max) =
 	CTL_ARG_LONG_LONG;
 
+/*
+ * CTL_READ_HANDLER(boot_scan_threads) -- reads the number of threads used to
+ *	precompute run occupancies on open
+ */
+static int
+CTL_READ_HANDLER(boot_scan_threads)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(ctx, source, indexes);
+
+	unsigned *threads = arg;
+
+	*threads = (unsigned)Default_boot_scan_threads;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(boot_scan_threads) -- writes the number of threads used
+ *	to precompute run occupancies on open, 0 disables the scan
+ */
+static int
+CTL_WRITE_HANDLER(boot_scan_threads)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(ctx, source, indexes);
+
+	Default_boot_scan_threads = *(unsigned *)arg;
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(boot_scan_threads) =
+	CTL_ARG_LONG_LONG;
+
 static const struct ctl_node CTL_NODE(heap_global)[] = {
 	CTL_LEAF_RW(arenas_assignment_type),
 	CTL_LEAF_RW(arenas_default_max),
+	CTL_LEAF_RW(boot_scan_threads),
 
 	CTL_NODE_END
 };
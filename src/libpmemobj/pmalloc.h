@@ -43,6 +43,7 @@ void pmalloc_ctl_register(PMEMobjpool *pop);
 void pmalloc_global_ctl_register(void);
 
 int pmalloc_cleanup(PMEMobjpool *pop);
+void pmalloc_lat_trace_delete(PMEMobjpool *pop);
 int pmalloc_boot(PMEMobjpool *pop);
 
 #ifdef __cplusplus
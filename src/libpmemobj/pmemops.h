@@ -7,6 +7,9 @@
 #include <stddef.h>
 #include <stdint.h>
 #include "util.h"
+#include "libpmemobj/base.h"
+#include "persist_epoch.h"
+#include "resctrl.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -23,6 +26,10 @@ typedef void *(*memmove_fn)(void *base, void *dest, const void *src, size_t len,
 typedef void *(*memset_fn)(void *base, void *dest, int c, size_t len,
 		unsigned flags);
 
+typedef void (*store_line_fn)(void *base, void *dest, const void *src);
+typedef void (*store_16b_fn)(void *base, void *dest, const void *src);
+typedef void (*store_8b_nt_fn)(void *base, void *dest, const void *src);
+
 struct pmem_ops {
 	/* for 'master' replica: with or without data replication */
 	persist_fn persist;	/* persist function */
@@ -31,6 +38,12 @@ struct pmem_ops {
 	memcpy_fn memcpy; /* persistent memcpy function */
 	memmove_fn memmove; /* persistent memmove function */
 	memset_fn memset; /* persistent memset function */
+	/* atomic direct store of one cache line, NULL when unavailable */
+	store_line_fn store_line;
+	/* atomic persistent store of 16 bytes, NULL when unavailable */
+	store_16b_fn store_16b;
+	/* atomic cache-bypassing store of 8 bytes, NULL when unavailable */
+	store_8b_nt_fn store_8b_nt;
 	void *base;
 };
 
@@ -38,7 +51,10 @@ static force_inline int
 pmemops_xpersist(const struct pmem_ops *p_ops, const void *d, size_t s,
 		unsigned flags)
 {
-	return p_ops->persist(p_ops->base, d, s, flags);
+	persist_epoch_record(d, s);
+	int ret = p_ops->persist(p_ops->base, d, s, flags);
+	persist_epoch_drain();
+	return ret;
 }
 
 static force_inline void
@@ -51,6 +67,7 @@ static force_inline int
 pmemops_xflush(const struct pmem_ops *p_ops, const void *d, size_t s,
 		unsigned flags)
 {
+	persist_epoch_record(d, s);
 	return p_ops->flush(p_ops->base, d, s, flags);
 }
 
@@ -64,27 +81,98 @@ static force_inline void
 pmemops_drain(const struct pmem_ops *p_ops)
 {
 	p_ops->drain(p_ops->base);
+	persist_epoch_drain();
 }
 
 static force_inline void *
 pmemops_memcpy(const struct pmem_ops *p_ops, void *dest,
 		const void *src, size_t len, unsigned flags)
 {
-	return p_ops->memcpy(p_ops->base, dest, src, len, flags);
+	int clos = unlikely(Resctrl_active) ? resctrl_enter(len) : 0;
+	persist_epoch_record(dest, len);
+	void *ret = p_ops->memcpy(p_ops->base, dest, src, len, flags);
+	if (!(flags & PMEMOBJ_F_MEM_NODRAIN))
+		persist_epoch_drain();
+	if (unlikely(clos))
+		resctrl_exit();
+	return ret;
 }
 
 static force_inline void *
 pmemops_memmove(const struct pmem_ops *p_ops, void *dest,
 		const void *src, size_t len, unsigned flags)
 {
-	return p_ops->memmove(p_ops->base, dest, src, len, flags);
+	int clos = unlikely(Resctrl_active) ? resctrl_enter(len) : 0;
+	persist_epoch_record(dest, len);
+	void *ret = p_ops->memmove(p_ops->base, dest, src, len, flags);
+	if (!(flags & PMEMOBJ_F_MEM_NODRAIN))
+		persist_epoch_drain();
+	if (unlikely(clos))
+		resctrl_exit();
+	return ret;
 }
 
 static force_inline void *
 pmemops_memset(const struct pmem_ops *p_ops, void *dest, int c,
 		size_t len, unsigned flags)
 {
-	return p_ops->memset(p_ops->base, dest, c, len, flags);
+	int clos = unlikely(Resctrl_active) ? resctrl_enter(len) : 0;
+	persist_epoch_record(dest, len);
+	void *ret = p_ops->memset(p_ops->base, dest, c, len, flags);
+	if (!(flags & PMEMOBJ_F_MEM_NODRAIN))
+		persist_epoch_drain();
+	if (unlikely(clos))
+		resctrl_exit();
+	return ret;
+}
+
+/*
+ * pmemops_store_line -- persist one full cache line atomically with a
+ * direct store; returns 0 when no such primitive is available and the
+ * caller has to fall back to a regular copy
+ */
+static force_inline int
+pmemops_store_line(const struct pmem_ops *p_ops, void *dest, const void *src)
+{
+	if (p_ops->store_line == NULL)
+		return 0;
+
+	p_ops->store_line(p_ops->base, dest, src);
+
+	return 1;
+}
+
+/*
+ * pmemops_store_16b -- store and persist one 16-byte-aligned, 16-byte value
+ * atomically; returns 0 when no such primitive is available and the caller
+ * has to fall back to logging
+ */
+static force_inline int
+pmemops_store_16b(const struct pmem_ops *p_ops, void *dest, const void *src)
+{
+	if (p_ops->store_16b == NULL)
+		return 0;
+
+	p_ops->store_16b(p_ops->base, dest, src);
+
+	return 1;
+}
+
+/*
+ * pmemops_store_8b_nt -- store one 8-byte-aligned, 8-byte value atomically,
+ * bypassing the CPU cache; the store is persistent once drained, no flush
+ * needed; returns 0 when no such primitive is available and the caller has
+ * to fall back to a regular store and flush
+ */
+static force_inline int
+pmemops_store_8b_nt(const struct pmem_ops *p_ops, void *dest, const void *src)
+{
+	if (p_ops->store_8b_nt == NULL)
+		return 0;
+
+	p_ops->store_8b_nt(p_ops->base, dest, src);
+
+	return 1;
 }
 
 #ifdef __cplusplus
@@ -16,6 +16,19 @@
 
 #define THRESHOLD_MUL 4
 
+/*
+ * Number of staging slots for incoming runs. Must be large enough so that
+ * concurrent free-heavy threads rarely contend on the same slot.
+ */
+#define RECYCLER_PENDING_SLOTS 64
+
+/* possible states of a single staging slot */
+enum recycler_pending_state {
+	PENDING_EMPTY,	/* slot is free to claim */
+	PENDING_BUSY,	/* slot is being written to or drained */
+	PENDING_FULL,	/* slot contains a valid element */
+};
+
 /*
  * recycler_element_cmp -- compares two recycler elements
  */
@@ -64,6 +77,15 @@ struct recycler {
 
 	VEC(, struct recycler_element) recalc;
 
+	/*
+	 * Lock-free staging area for inserted runs. Inserts claim a slot with
+	 * a compare-and-swap instead of taking the main lock, and the slots
+	 * are drained into the ravl by whoever takes that lock next. This
+	 * prevents free-heavy phases from convoying on the recycler mutex.
+	 */
+	struct recycler_element pending[RECYCLER_PENDING_SLOTS];
+	int pending_state[RECYCLER_PENDING_SLOTS];
+
 	os_mutex_t lock;
 };
 
@@ -87,6 +109,7 @@ recycler_new(struct palloc_heap *heap, size_t nallocs, size_t *peak_arenas)
 	r->peak_arenas = peak_arenas;
 	r->unaccounted_total = 0;
 	memset(&r->unaccounted_units, 0, sizeof(r->unaccounted_units));
+	memset(&r->pending_state, 0, sizeof(r->pending_state));
 
 	VEC_INIT(&r->recalc);
 
@@ -147,14 +170,69 @@ recycler_element_new(struct palloc_heap *heap, const struct memory_block *m)
 	return e;
 }
 
+/*
+ * recycler_pending_drain -- (internal) moves all staged elements into the ravl
+ *
+ * Must be called with the recycler lock held.
+ */
+static void
+recycler_pending_drain(struct recycler *r)
+{
+	for (int i = 0; i < RECYCLER_PENDING_SLOTS; ++i) {
+		int state;
+		util_atomic_load_explicit32(&r->pending_state[i], &state,
+			memory_order_acquire);
+		if (state != PENDING_FULL)
+			continue;
+
+		if (!util_bool_compare_and_swap32(&r->pending_state[i],
+			PENDING_FULL, PENDING_BUSY))
+			continue;
+
+		struct recycler_element e = r->pending[i];
+		util_atomic_store_explicit32(&r->pending_state[i],
+			PENDING_EMPTY, memory_order_release);
+
+		if (ravl_emplace_copy(r->runs, &e) != 0)
+			ERR_WO_ERRNO(
+				"lost runtime tracking info of a run due to OOM");
+	}
+}
+
 /*
  * recycler_put -- inserts new run into the recycler
+ *
+ * The insert is staged in a lock-free slot whenever possible, so that
+ * concurrent frees do not serialize on the recycler lock. Staged elements
+ * become visible to readers the next time the recycler lock is taken.
  */
 int
 recycler_put(struct recycler *r, struct recycler_element element)
 {
 	int ret = 0;
 
+	for (unsigned i = 0; i < RECYCLER_PENDING_SLOTS; ++i) {
+		unsigned slot = (element.chunk_id + i) %
+			RECYCLER_PENDING_SLOTS;
+
+		int state;
+		util_atomic_load_explicit32(&r->pending_state[slot], &state,
+			memory_order_relaxed);
+		if (state != PENDING_EMPTY)
+			continue;
+
+		if (!util_bool_compare_and_swap32(&r->pending_state[slot],
+			PENDING_EMPTY, PENDING_BUSY))
+			continue;
+
+		r->pending[slot] = element;
+		util_atomic_store_explicit32(&r->pending_state[slot],
+			PENDING_FULL, memory_order_release);
+
+		return 0;
+	}
+
+	/* all staging slots were occupied, insert directly into the tree */
 	util_mutex_lock(&r->lock);
 
 	ret = ravl_emplace_copy(r->runs, &element);
@@ -165,15 +243,50 @@ recycler_put(struct recycler *r, struct recycler_element element)
 }
 
 /*
- * recycler_get -- retrieves a chunk from the recycler
+ * Number of tree entries inspected when looking for a run from a preferred
+ * zone. Bounded so that a placement hint can never turn the lookup into a
+ * full scan of the recycler.
+ */
+#define ZONE_PREF_SEARCH_LIMIT 16
+
+/*
+ * recycler_hint_match -- (internal) checks whether an element is one of the
+ *	caller's recently used runs
+ */
+static int
+recycler_hint_match(const struct recycler_element *e,
+	const struct recycler_run_hint *hints, unsigned nhints)
+{
+	for (unsigned i = 0; i < nhints; ++i) {
+		if (hints[i].valid && hints[i].zone_id == e->zone_id &&
+		    hints[i].chunk_id == e->chunk_id)
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * recycler_get_preferred -- retrieves a chunk from the recycler, preferring
+ *	runs the caller used recently, then runs located in the given zone
+ *
+ * Both preferences are only hints applied to the first few best-fit
+ * candidates - if none of them match, the overall best-fit run is returned
+ * instead. A recently used run beats a zone match, since its metadata and
+ * translations are the most likely to still be cache-resident on the
+ * requesting thread. UINT32_MAX means no zone preference.
  */
 int
-recycler_get(struct recycler *r, struct memory_block *m)
+recycler_get_preferred(struct recycler *r, struct memory_block *m,
+	uint32_t zone_id, const struct recycler_run_hint *hints,
+	unsigned nhints)
 {
 	int ret = 0;
 
 	util_mutex_lock(&r->lock);
 
+	recycler_pending_drain(r);
+
 	struct recycler_element e = { .max_free_block = m->size_idx, 0, 0, 0};
 	struct ravl_node *n = ravl_find(r->runs, &e,
 		RAVL_PREDICATE_GREATER_EQUAL);
@@ -182,6 +295,29 @@ recycler_get(struct recycler *r, struct memory_block *m)
 		goto out;
 	}
 
+	if (zone_id != UINT32_MAX || nhints != 0) {
+		struct ravl_node *c = n;
+		struct ravl_node *zone_match = NULL;
+		for (int i = 0; c != NULL && i < ZONE_PREF_SEARCH_LIMIT; ++i) {
+			struct recycler_element *ce = ravl_data(c);
+			if (recycler_hint_match(ce, hints, nhints)) {
+				n = c;
+				zone_match = NULL;
+				break;
+			}
+			if (zone_match == NULL && ce->zone_id == zone_id) {
+				zone_match = c;
+				/* without hints there is nothing better */
+				if (nhints == 0)
+					break;
+			}
+			e = *ce;
+			c = ravl_find(r->runs, &e, RAVL_PREDICATE_GREATER);
+		}
+		if (zone_match != NULL)
+			n = zone_match;
+	}
+
 	struct recycler_element *ne = ravl_data(n);
 	m->chunk_id = ne->chunk_id;
 	m->zone_id = ne->zone_id;
@@ -199,6 +335,25 @@ out:
 	return ret;
 }
 
+/*
+ * recycler_get_zone -- retrieves a chunk from the recycler, preferring runs
+ *	located in the given zone
+ */
+int
+recycler_get_zone(struct recycler *r, struct memory_block *m, uint32_t zone_id)
+{
+	return recycler_get_preferred(r, m, zone_id, NULL, 0);
+}
+
+/*
+ * recycler_get -- retrieves a chunk from the recycler
+ */
+int
+recycler_get(struct recycler *r, struct memory_block *m)
+{
+	return recycler_get_preferred(r, m, UINT32_MAX, NULL, 0);
+}
+
 /*
  * recycler_recalc -- recalculates the scores of runs in the recycler to match
  *	the updated persistent state
@@ -223,6 +378,8 @@ recycler_recalc(struct recycler *r, int force)
 	if (util_mutex_trylock(&r->lock) != 0)
 		return runs;
 
+	recycler_pending_drain(r);
+
 	/* If the search is forced, recalculate everything */
 	uint64_t search_limit = force ? UINT64_MAX : units;
 
@@ -299,7 +456,17 @@ recycler_recalc(struct recycler *r, int force)
 void
 recycler_inc_unaccounted(struct recycler *r, const struct memory_block *m)
 {
-	util_fetch_and_add64(&r->unaccounted_total, m->size_idx);
-	util_fetch_and_add64(&r->unaccounted_units[m->chunk_id],
-		m->size_idx);
+	recycler_inc_unaccounted_units(r, m->chunk_id, m->size_idx);
+}
+
+/*
+ * recycler_inc_unaccounted_units -- increases the number of unaccounted units
+ *	in the recycler by an arbitrary amount
+ */
+void
+recycler_inc_unaccounted_units(struct recycler *r, uint32_t chunk_id,
+	uint32_t units)
+{
+	util_fetch_and_add64(&r->unaccounted_total, units);
+	util_fetch_and_add64(&r->unaccounted_units[chunk_id], units);
 }
@@ -29,6 +29,16 @@ struct recycler_element {
 	uint32_t zone_id;
 };
 
+/*
+ * A cache-warmth hint: the identity of a run that was recently active in
+ * the requesting bucket. Hints with the valid flag unset never match.
+ */
+struct recycler_run_hint {
+	uint32_t zone_id;
+	uint32_t chunk_id;
+	int valid;
+};
+
 struct recycler *recycler_new(struct palloc_heap *layout,
 	size_t nallocs, size_t *peak_arenas);
 void recycler_delete(struct recycler *r);
@@ -39,11 +49,21 @@ int recycler_put(struct recycler *r, struct recycler_element element);
 
 int recycler_get(struct recycler *r, struct memory_block *m);
 
+int recycler_get_zone(struct recycler *r, struct memory_block *m,
+	uint32_t zone_id);
+
+int recycler_get_preferred(struct recycler *r, struct memory_block *m,
+	uint32_t zone_id, const struct recycler_run_hint *hints,
+	unsigned nhints);
+
 struct empty_runs recycler_recalc(struct recycler *r, int force);
 
 void recycler_inc_unaccounted(struct recycler *r,
 	const struct memory_block *m);
 
+void recycler_inc_unaccounted_units(struct recycler *r, uint32_t chunk_id,
+	uint32_t units);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,299 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2024, Intel Corporation */
+
+/*
+ * ringbuf.c -- implementation of the persistent ring buffer module
+ *
+ * The ring buffer is a non-transactional multi-producer single-consumer
+ * queue of fixed-capacity records, meant for log-like workloads that
+ * otherwise pay the full allocator or transaction overhead per append.
+ *
+ * Producers claim a position with a compare-and-swap on a volatile cursor,
+ * write out the record and then commit it with a single atomic store of the
+ * slot sequence number - the same 8-byte publish that memops relies on for
+ * single entry processing. Producers never block each other and a producer
+ * crash leaves at most a gap of uncommitted slots which is trimmed away on
+ * recovery.
+ *
+ * The consumer walks the committed slots in order and makes an entire batch
+ * consumed with one atomic update of the persistent consumer position.
+ */
+
+#include <inttypes.h>
+
+#include "ringbuf.h"
+#include "lane.h"
+#include "memops.h"
+#include "obj.h"
+#include "out.h"
+#include "palloc.h"
+#include "sys_util.h"
+#include "valgrind_internal.h"
+
+/*
+ * ringbuf_slot_at -- (internal) returns the slot assigned to an absolute
+ *	position
+ */
+static struct ringbuf_slot *
+ringbuf_slot_at(struct ringbuf *rb, uint64_t pos)
+{
+	size_t stride = sizeof(struct ringbuf_slot) +
+		ALIGN_UP((size_t)rb->entry_size, sizeof(uint64_t));
+
+	return (struct ringbuf_slot *)(rb->slots +
+		(pos & (rb->nentries - 1)) * stride);
+}
+
+/* arguments for ringbuf_head_recover */
+struct ringbuf_recover_args {
+	PMEMobjpool *pop;
+	struct ringbuf *rb;
+};
+
+/*
+ * ringbuf_head_recover -- (internal) recovers the volatile producer position
+ *
+ * The first position without a committed record becomes the new head.
+ * Records committed after a gap left by a producer interrupted mid-append
+ * were never observable by the consumer and are dropped by ending the scan
+ * at the gap. Their commit markers have to be released as well - otherwise
+ * they would become reachable again, and hand the consumer already dropped
+ * records, once new appends recommit the gap slots.
+ */
+static int
+ringbuf_head_recover(void *ptr, void *arg)
+{
+	uint64_t *headp = ptr;
+	struct ringbuf_recover_args *rargs = arg;
+	struct ringbuf *rb = rargs->rb;
+
+	uint64_t pos = rb->tail;
+	while (pos - rb->tail < rb->nentries &&
+	    ringbuf_slot_at(rb, pos)->seq == pos + 1)
+		pos++;
+
+	for (uint64_t above = pos + 1; above - rb->tail < rb->nentries;
+	    above++) {
+		struct ringbuf_slot *slot = ringbuf_slot_at(rb, above);
+		if (slot->seq != above + 1)
+			continue;
+
+		slot->seq = 0;
+		pmemops_persist(&rargs->pop->p_ops, &slot->seq,
+			sizeof(slot->seq));
+	}
+
+	*headp = pos;
+
+	return 0;
+}
+
+/* arguments for ringbuf_constructor */
+struct ringbuf_constr_args {
+	uint64_t nentries;
+	uint64_t entry_size;
+};
+
+/*
+ * ringbuf_constructor -- (internal) constructor of the ring buffer object
+ */
+static int
+ringbuf_constructor(void *base, void *ptr, size_t usable_size, void *arg)
+{
+	PMEMobjpool *pop = base;
+	struct pmem_ops *p_ops = &pop->p_ops;
+	struct ringbuf_constr_args *rargs = arg;
+	struct ringbuf *rb = ptr;
+
+	/* every slot must start out with a zeroed commit marker */
+	pmemops_memset(p_ops, rb, 0, usable_size, PMEMOBJ_F_MEM_NODRAIN);
+
+	rb->nentries = rargs->nentries;
+	rb->entry_size = rargs->entry_size;
+	pmemops_persist(p_ops, rb, sizeof(*rb));
+
+	return 0;
+}
+
+/*
+ * pmemobj_ringbuf_new -- allocates and initializes a new ring buffer
+ */
+int
+pmemobj_ringbuf_new(PMEMobjpool *pop, PMEMoid *oidp, size_t entry_size,
+	size_t nentries, uint64_t type_num)
+{
+	LOG(3, "pop %p oidp %p entry_size %zu nentries %zu type_num %" PRIu64,
+		pop, oidp, entry_size, nentries, type_num);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	if (oidp == NULL || entry_size == 0 || nentries == 0) {
+		ERR_WO_ERRNO("invalid ring buffer parameters");
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* the position masking requires a power of two capacity */
+	uint64_t n = 1;
+	while (n < nentries)
+		n <<= 1;
+
+	size_t stride = sizeof(struct ringbuf_slot) +
+		ALIGN_UP(entry_size, sizeof(uint64_t));
+	if (n > (PMEMOBJ_MAX_ALLOC_SIZE - sizeof(struct ringbuf)) / stride) {
+		ERR_WO_ERRNO("requested size too large");
+		errno = ENOMEM;
+		return -1;
+	}
+	size_t size = sizeof(struct ringbuf) + n * stride;
+
+	int ret = 0;
+
+	struct lane *lane;
+	lane_hold(pop, &lane);
+
+	struct ringbuf_constr_args rargs;
+	rargs.nentries = n;
+	rargs.entry_size = entry_size;
+
+	struct pobj_action reserved;
+	if (palloc_reserve(&pop->heap, size, ringbuf_constructor, &rargs,
+		type_num, 0, 0, 0, &reserved) != 0) {
+		ERR_W_ERRNO("palloc_reserve");
+		ret = -1;
+		goto err_reserve;
+	}
+
+	struct operation_context *ctx = lane->external;
+	operation_start(ctx);
+
+	operation_add_entry(ctx, &oidp->pool_uuid_lo, pop->uuid_lo,
+		ULOG_OPERATION_SET);
+	operation_add_entry(ctx, &oidp->off, reserved.heap.offset,
+		ULOG_OPERATION_SET);
+
+	palloc_publish(&pop->heap, &reserved, 1, ctx);
+
+err_reserve:
+	lane_release(pop);
+
+	return ret;
+}
+
+/*
+ * pmemobj_ringbuf_enqueue -- appends a record to the ring buffer
+ */
+int
+pmemobj_ringbuf_enqueue(PMEMobjpool *pop, PMEMoid rb_oid, const void *data,
+	size_t len)
+{
+	LOG(3, "pop %p rb_oid.off 0x%016" PRIx64 " data %p len %zu",
+		pop, rb_oid.off, data, len);
+
+	ASSERT(OBJ_OID_IS_VALID(pop, rb_oid));
+
+	struct pmem_ops *p_ops = &pop->p_ops;
+	struct ringbuf *rb = OBJ_OFF_TO_PTR(pop, rb_oid.off);
+
+	if (len == 0 || len > rb->entry_size) {
+		ERR_WO_ERRNO("invalid record length %zu", len);
+		errno = EINVAL;
+		return -1;
+	}
+
+	struct ringbuf_recover_args rargs;
+	rargs.pop = pop;
+	rargs.rb = rb;
+
+	uint64_t *headp = pmemobj_volatile(pop, &rb->head.vlt,
+		&rb->head.value, sizeof(rb->head.value),
+		ringbuf_head_recover, &rargs);
+	if (headp == NULL)
+		return -1;
+
+	uint64_t pos;
+	for (;;) {
+		util_atomic_load_explicit64(headp, &pos,
+			memory_order_relaxed);
+
+		uint64_t tail;
+		util_atomic_load_explicit64(&rb->tail, &tail,
+			memory_order_acquire);
+		if (pos - tail >= rb->nentries) {
+			errno = EAGAIN;
+			return -1;
+		}
+
+		if (util_bool_compare_and_swap64(headp, pos, pos + 1))
+			break;
+	}
+
+	struct ringbuf_slot *slot = ringbuf_slot_at(rb, pos);
+
+	/*
+	 * The record must be persistent in its entirety before the sequence
+	 * number commits it, otherwise a committed slot could hold a torn
+	 * record after an interruption.
+	 */
+	slot->len = len;
+	pmemops_flush(p_ops, &slot->len, sizeof(slot->len));
+	pmemops_memcpy(p_ops, slot->data, data, len, PMEMOBJ_F_MEM_NODRAIN);
+	pmemops_drain(p_ops);
+
+	util_atomic_store_explicit64(&slot->seq, pos + 1,
+		memory_order_release);
+	pmemops_persist(p_ops, &slot->seq, sizeof(slot->seq));
+
+	return 0;
+}
+
+/*
+ * pmemobj_ringbuf_dequeue -- consumes a batch of records from the ring buffer
+ *
+ * Records are handed to the callback in commit order. A nonzero callback
+ * return value ends the batch after the current record; max limits the batch
+ * length, 0 means no limit. The entire batch is consumed with one atomic
+ * update of the consumer position, so after an interruption either all of
+ * its records are still in the buffer or none of them are.
+ */
+size_t
+pmemobj_ringbuf_dequeue(PMEMobjpool *pop, PMEMoid rb_oid, size_t max,
+	pmemobj_ringbuf_cb cb, void *arg)
+{
+	LOG(3, "pop %p rb_oid.off 0x%016" PRIx64 " max %zu cb %p arg %p",
+		pop, rb_oid.off, max, cb, arg);
+
+	ASSERT(OBJ_OID_IS_VALID(pop, rb_oid));
+
+	struct pmem_ops *p_ops = &pop->p_ops;
+	struct ringbuf *rb = OBJ_OFF_TO_PTR(pop, rb_oid.off);
+
+	uint64_t tail = rb->tail;
+	size_t consumed = 0;
+	while (max == 0 || consumed < max) {
+		struct ringbuf_slot *slot = ringbuf_slot_at(rb, tail);
+
+		uint64_t seq;
+		util_atomic_load_explicit64(&slot->seq, &seq,
+			memory_order_acquire);
+		if (seq != tail + 1)
+			break;
+
+		int stop = cb(slot->data, slot->len, arg);
+
+		tail++;
+		consumed++;
+
+		if (stop)
+			break;
+	}
+
+	if (consumed > 0) {
+		util_atomic_store_explicit64(&rb->tail, tail,
+			memory_order_release);
+		pmemops_persist(p_ops, &rb->tail, sizeof(rb->tail));
+	}
+
+	return consumed;
+}
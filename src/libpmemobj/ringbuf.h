@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright 2024, Intel Corporation */
+
+/*
+ * ringbuf.h -- internal definitions for persistent ring buffer module
+ */
+
+#ifndef LIBPMEMOBJ_RINGBUF_H
+#define LIBPMEMOBJ_RINGBUF_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libpmemobj.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A single slot of the ring. The sequence number is the commit marker of the
+ * record: a slot holds a consumable record at an absolute position only when
+ * its sequence number equals that position plus one. Sequence numbers left
+ * over from previous laps around the ring never match the current position,
+ * so slots do not have to be cleaned between reuses.
+ */
+struct ringbuf_slot {
+	uint64_t seq;	/* position + 1 once the record is committed */
+	uint64_t len;	/* length of the record data */
+	uint8_t data[];
+};
+
+/*
+ * Layout of the persistent ring buffer object. Both positions grow
+ * monotonically and only their difference is bounded by the capacity. The
+ * consumer position is persistent - a batch of records is consumed with one
+ * atomic update of it. The producer position is valid for a single run of
+ * the pool and is recovered by scanning for the first uncommitted slot.
+ */
+struct ringbuf {
+	uint64_t nentries;	/* capacity, always a power of two */
+	uint64_t entry_size;	/* data bytes available in every slot */
+	uint64_t tail;		/* consumer position, persistent */
+	uint64_t unused[5];
+	PMEMvlt(uint64_t) head;	/* producer position, volatile */
+	uint8_t slots[];
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
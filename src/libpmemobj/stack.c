@@ -0,0 +1,313 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2024, Intel Corporation */
+
+/*
+ * stack.c -- implementation of the persistent stack module
+ *
+ * The stack is the LIFO companion of the ring buffer: a non-transactional
+ * bounded array of fixed-capacity records for workloads that push and pop
+ * from the same end and otherwise pay the full transaction overhead per
+ * operation.
+ *
+ * Both directions serialize on a single volatile top position advanced and
+ * retreated with compare-and-swap. The slot sequence number is the commit
+ * marker and at the same time the ownership hand-off: a pusher waits for
+ * the claimed slot to be released (zeroed) by a previous popper, and a
+ * popper that claimed a slot ahead of an in-flight pusher waits for the
+ * record to be committed before reading it. Threads therefore never block
+ * on a lock, only on the bounded progress of the single peer touching the
+ * same slot.
+ *
+ * The volatile top is recovered by scanning for the first uncommitted
+ * slot. Records committed above a gap left by a pusher interrupted
+ * mid-operation are discarded, exactly like the ring buffer drops records
+ * committed after such a gap.
+ */
+
+#include <inttypes.h>
+
+#include "stack.h"
+#include "lane.h"
+#include "memops.h"
+#include "obj.h"
+#include "out.h"
+#include "palloc.h"
+#include "sys_util.h"
+#include "valgrind_internal.h"
+
+/*
+ * stack_slot_at -- (internal) returns the slot at the given position
+ */
+static struct stack_slot *
+stack_slot_at(struct pstack *st, uint64_t pos)
+{
+	size_t stride = sizeof(struct stack_slot) +
+		ALIGN_UP((size_t)st->entry_size, sizeof(uint64_t));
+
+	return (struct stack_slot *)(st->slots + pos * stride);
+}
+
+/* arguments for stack_top_recover */
+struct stack_recover_args {
+	PMEMobjpool *pop;
+	struct pstack *st;
+};
+
+/*
+ * stack_top_recover -- (internal) recovers the volatile top position
+ *
+ * The first position without a committed record becomes the new top.
+ * Records committed above a gap left by an interrupted pusher are
+ * unreachable through LIFO order, so their slots are released.
+ */
+static int
+stack_top_recover(void *ptr, void *arg)
+{
+	uint64_t *topp = ptr;
+	struct stack_recover_args *rargs = arg;
+	struct pstack *st = rargs->st;
+	struct pmem_ops *p_ops = &rargs->pop->p_ops;
+
+	uint64_t pos = 0;
+	while (pos < st->nentries && stack_slot_at(st, pos)->seq == pos + 1)
+		pos++;
+
+	for (uint64_t i = pos; i < st->nentries; ++i) {
+		struct stack_slot *slot = stack_slot_at(st, i);
+		if (slot->seq != 0) {
+			slot->seq = 0;
+			pmemops_persist(p_ops, &slot->seq, sizeof(slot->seq));
+		}
+	}
+
+	*topp = pos;
+
+	return 0;
+}
+
+/* arguments for stack_constructor */
+struct stack_constr_args {
+	uint64_t nentries;
+	uint64_t entry_size;
+};
+
+/*
+ * stack_constructor -- (internal) constructor of the stack object
+ */
+static int
+stack_constructor(void *base, void *ptr, size_t usable_size, void *arg)
+{
+	PMEMobjpool *pop = base;
+	struct pmem_ops *p_ops = &pop->p_ops;
+	struct stack_constr_args *sargs = arg;
+	struct pstack *st = ptr;
+
+	/* every slot must start out with a zeroed commit marker */
+	pmemops_memset(p_ops, st, 0, usable_size, PMEMOBJ_F_MEM_NODRAIN);
+
+	st->nentries = sargs->nentries;
+	st->entry_size = sargs->entry_size;
+	pmemops_persist(p_ops, st, sizeof(*st));
+
+	return 0;
+}
+
+/*
+ * pmemobj_stack_new -- allocates and initializes a new stack
+ */
+int
+pmemobj_stack_new(PMEMobjpool *pop, PMEMoid *oidp, size_t entry_size,
+	size_t nentries, uint64_t type_num)
+{
+	LOG(3, "pop %p oidp %p entry_size %zu nentries %zu type_num %" PRIu64,
+		pop, oidp, entry_size, nentries, type_num);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	if (oidp == NULL || entry_size == 0 || nentries == 0) {
+		ERR_WO_ERRNO("invalid stack parameters");
+		errno = EINVAL;
+		return -1;
+	}
+
+	size_t stride = sizeof(struct stack_slot) +
+		ALIGN_UP(entry_size, sizeof(uint64_t));
+	if (nentries > (PMEMOBJ_MAX_ALLOC_SIZE - sizeof(struct pstack)) /
+			stride) {
+		ERR_WO_ERRNO("requested size too large");
+		errno = ENOMEM;
+		return -1;
+	}
+	size_t size = sizeof(struct pstack) + nentries * stride;
+
+	int ret = 0;
+
+	struct lane *lane;
+	lane_hold(pop, &lane);
+
+	struct stack_constr_args sargs;
+	sargs.nentries = nentries;
+	sargs.entry_size = entry_size;
+
+	struct pobj_action reserved;
+	if (palloc_reserve(&pop->heap, size, stack_constructor, &sargs,
+		type_num, 0, 0, 0, &reserved) != 0) {
+		ERR_W_ERRNO("palloc_reserve");
+		ret = -1;
+		goto err_reserve;
+	}
+
+	struct operation_context *ctx = lane->external;
+	operation_start(ctx);
+
+	operation_add_entry(ctx, &oidp->pool_uuid_lo, pop->uuid_lo,
+		ULOG_OPERATION_SET);
+	operation_add_entry(ctx, &oidp->off, reserved.heap.offset,
+		ULOG_OPERATION_SET);
+
+	palloc_publish(&pop->heap, &reserved, 1, ctx);
+
+err_reserve:
+	lane_release(pop);
+
+	return ret;
+}
+
+/*
+ * stack_top -- (internal) returns the recovered volatile top position
+ */
+static uint64_t *
+stack_top(PMEMobjpool *pop, struct pstack *st)
+{
+	struct stack_recover_args rargs;
+	rargs.pop = pop;
+	rargs.st = st;
+
+	return pmemobj_volatile(pop, &st->top.vlt, &st->top.value,
+		sizeof(st->top.value), stack_top_recover, &rargs);
+}
+
+/*
+ * pmemobj_stack_push -- pushes a record onto the stack
+ */
+int
+pmemobj_stack_push(PMEMobjpool *pop, PMEMoid st_oid, const void *data,
+	size_t len)
+{
+	LOG(3, "pop %p st_oid.off 0x%016" PRIx64 " data %p len %zu",
+		pop, st_oid.off, data, len);
+
+	ASSERT(OBJ_OID_IS_VALID(pop, st_oid));
+
+	struct pmem_ops *p_ops = &pop->p_ops;
+	struct pstack *st = OBJ_OFF_TO_PTR(pop, st_oid.off);
+
+	if (len == 0 || len > st->entry_size) {
+		ERR_WO_ERRNO("invalid record length %zu", len);
+		errno = EINVAL;
+		return -1;
+	}
+
+	uint64_t *topp = stack_top(pop, st);
+	if (topp == NULL)
+		return -1;
+
+	uint64_t pos;
+	for (;;) {
+		util_atomic_load_explicit64(topp, &pos, memory_order_relaxed);
+
+		if (pos >= st->nentries) {
+			errno = EAGAIN;
+			return -1;
+		}
+
+		if (util_bool_compare_and_swap64(topp, pos, pos + 1))
+			break;
+	}
+
+	struct stack_slot *slot = stack_slot_at(st, pos);
+
+	/* wait for the popper that claimed this slot to release it */
+	uint64_t seq;
+	do {
+		util_atomic_load_explicit64(&slot->seq, &seq,
+			memory_order_acquire);
+	} while (seq != 0);
+
+	/*
+	 * The record must be persistent in its entirety before the sequence
+	 * number commits it, otherwise a committed slot could hold a torn
+	 * record after an interruption.
+	 */
+	slot->len = len;
+	pmemops_flush(p_ops, &slot->len, sizeof(slot->len));
+	pmemops_memcpy(p_ops, slot->data, data, len, PMEMOBJ_F_MEM_NODRAIN);
+	pmemops_drain(p_ops);
+
+	util_atomic_store_explicit64(&slot->seq, pos + 1,
+		memory_order_release);
+	pmemops_persist(p_ops, &slot->seq, sizeof(slot->seq));
+
+	return 0;
+}
+
+/*
+ * pmemobj_stack_pop -- pops a batch of records off the stack
+ *
+ * Records are handed to the callback newest-first. A nonzero callback
+ * return value ends the batch after the current record; max limits the
+ * batch length, 0 means no limit. Every record is released individually
+ * after its callback returns, so an interruption replays at most the
+ * record whose callback was already running.
+ */
+size_t
+pmemobj_stack_pop(PMEMobjpool *pop, PMEMoid st_oid, size_t max,
+	pmemobj_stack_cb cb, void *arg)
+{
+	LOG(3, "pop %p st_oid.off 0x%016" PRIx64 " max %zu cb %p arg %p",
+		pop, st_oid.off, max, cb, arg);
+
+	ASSERT(OBJ_OID_IS_VALID(pop, st_oid));
+
+	struct pmem_ops *p_ops = &pop->p_ops;
+	struct pstack *st = OBJ_OFF_TO_PTR(pop, st_oid.off);
+
+	uint64_t *topp = stack_top(pop, st);
+	if (topp == NULL)
+		return 0;
+
+	size_t consumed = 0;
+	while (max == 0 || consumed < max) {
+		uint64_t pos;
+		util_atomic_load_explicit64(topp, &pos, memory_order_relaxed);
+		if (pos == 0)
+			break;
+
+		if (!util_bool_compare_and_swap64(topp, pos, pos - 1))
+			continue;
+
+		struct stack_slot *slot = stack_slot_at(st, pos - 1);
+
+		/* wait for the pusher that claimed this slot to commit */
+		uint64_t seq;
+		do {
+			util_atomic_load_explicit64(&slot->seq, &seq,
+				memory_order_acquire);
+		} while (seq != pos);
+
+		int stop = cb(slot->data, slot->len, arg);
+
+		/* release the slot for reuse by the next pusher */
+		util_atomic_store_explicit64(&slot->seq, 0,
+			memory_order_release);
+		pmemops_persist(p_ops, &slot->seq, sizeof(slot->seq));
+
+		consumed++;
+
+		if (stop)
+			break;
+	}
+
+	return consumed;
+}
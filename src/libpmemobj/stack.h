@@ -0,0 +1,51 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright 2024, Intel Corporation */
+
+/*
+ * stack.h -- internal definitions for persistent stack module
+ */
+
+#ifndef LIBPMEMOBJ_STACK_H
+#define LIBPMEMOBJ_STACK_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libpmemobj.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A single slot of the stack. The sequence number is the commit marker and
+ * the ownership hand-off of the slot: position + 1 once the record at that
+ * position is committed, zero once the slot is released for reuse. Unlike
+ * the ring buffer positions, stack positions are reused, so a popped slot
+ * must be explicitly released.
+ */
+struct stack_slot {
+	uint64_t seq;	/* position + 1 when committed, 0 when free */
+	uint64_t len;	/* length of the record data */
+	uint8_t data[];
+};
+
+/*
+ * Layout of the persistent stack object. There is no persistent cursor:
+ * the set of committed sequence numbers alone describes the stack content.
+ * The top position is valid for a single run of the pool and is recovered
+ * by scanning for the first uncommitted slot.
+ */
+struct pstack {
+	uint64_t nentries;	/* capacity */
+	uint64_t entry_size;	/* data bytes available in every slot */
+	uint64_t unused[6];
+	PMEMvlt(uint64_t) top;	/* first free position, volatile */
+	uint8_t slots[];
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
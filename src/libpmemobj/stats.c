@@ -5,19 +5,665 @@
  * stats.c -- implementation of statistics
  */
 
+#include <fcntl.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
 #include "obj.h"
+#include "heap.h"
+#include "mmap.h"
+#include "os.h"
+#include "set.h"
 #include "stats.h"
 #include "core_assert.h"
 
+/* round-robin assignment of threads to transient statistics shards */
+static __thread unsigned Stats_shard = UINT_MAX;
+static uint64_t Stats_shard_next;
+
+/*
+ * stats_transient_shard -- returns the transient statistics shard of the
+ *	calling thread
+ */
+struct stats_transient *
+stats_transient_shard(struct stats *stats)
+{
+	if (Stats_shard == UINT_MAX)
+		Stats_shard = (unsigned)util_fetch_and_add64(
+			&Stats_shard_next, 1) % STATS_NSHARDS;
+
+	return &stats->transient[Stats_shard];
+}
+
+/*
+ * stats_transient_sum -- aggregates a single transient counter, given by its
+ *	offset inside of the shard structure, across all shards
+ */
+uint64_t
+stats_transient_sum(const struct stats *stats, size_t field_offset)
+{
+	uint64_t sum = 0;
+
+	for (unsigned i = 0; i < STATS_NSHARDS; ++i) {
+		uint64_t v;
+		util_atomic_load_explicit64((uint64_t *)((char *)
+			&stats->transient[i] + field_offset),
+			&v, memory_order_acquire);
+		sum += v;
+	}
+
+	return sum;
+}
+
 STATS_CTL_HANDLER(persistent, curr_allocated, heap_curr_allocated);
 
-STATS_CTL_HANDLER(transient, run_allocated, heap_run_allocated);
-STATS_CTL_HANDLER(transient, run_active, heap_run_active);
+STATS_CTL_HANDLER_TRANSIENT(run_allocated, heap_run_allocated);
+STATS_CTL_HANDLER_TRANSIENT(run_active, heap_run_active);
+
+/*
+ * CTL_READ_HANDLER(recording) -- returns whether the allocation size
+ *	histogram is being recorded
+ */
+static int
+CTL_READ_HANDLER(recording)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	int *arg_out = arg;
+
+	*arg_out = pop->stats->alloc_histogram_recording;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(recording) -- enables or disables recording of the
+ *	allocation size histogram
+ */
+static int
+CTL_WRITE_HANDLER(recording)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	pop->stats->alloc_histogram_recording = *(int *)arg;
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(recording) = CTL_ARG_BOOLEAN;
+
+/*
+ * stats_histogram_bucket -- (internal) retrieves and validates the histogram
+ *	bucket index from the ctl query
+ */
+static ssize_t
+stats_histogram_bucket(struct ctl_indexes *indexes)
+{
+	struct ctl_index *idx = PMDK_SLIST_FIRST(indexes);
+	ASSERTeq(strcmp(idx->name, "bucket_id"), 0);
+
+	if (idx->value < 0 || idx->value >= STATS_ALLOC_HIST_BUCKETS) {
+		ERR_WO_ERRNO("bucket id outside of the allowed range");
+		errno = ERANGE;
+		return -1;
+	}
+
+	return idx->value;
+}
+
+/*
+ * CTL_READ_HANDLER(count) -- reads the number of allocations recorded in the
+ *	given histogram bucket
+ */
+static int
+CTL_READ_HANDLER(count)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source);
+
+	PMEMobjpool *pop = ctx;
+
+	ssize_t bucket = stats_histogram_bucket(indexes);
+	if (bucket < 0)
+		return -1;
+
+	uint64_t *argv = arg;
+	*argv = stats_transient_sum(pop->stats,
+		offsetof(struct stats_transient,
+		alloc_size_histogram[bucket]));
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(size) -- reads the upper bound of allocation sizes that
+ *	fall into the given histogram bucket
+ */
+static int
+CTL_READ_HANDLER(size)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(ctx, source);
+
+	ssize_t bucket = stats_histogram_bucket(indexes);
+	if (bucket < 0)
+		return -1;
+
+	uint64_t *argv = arg;
+	*argv = ((uint64_t)bucket + 1) * STATS_ALLOC_HIST_UNIT;
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(bucket_id)[] = {
+	CTL_LEAF_RO(count),
+	CTL_LEAF_RO(size),
+
+	CTL_NODE_END
+};
+
+static const struct ctl_node CTL_NODE(histogram)[] = {
+	CTL_LEAF_RW(recording),
+	CTL_INDEXED(bucket_id),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_READ_HANDLER(recording, tx) -- returns whether the per-transaction
+ *	snapshot size histogram is being recorded
+ */
+static int
+CTL_READ_HANDLER(recording, tx)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	int *arg_out = arg;
+
+	*arg_out = pop->stats->tx_histogram_recording;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(recording, tx) -- enables or disables recording of the
+ *	per-transaction snapshot size histogram
+ */
+static int
+CTL_WRITE_HANDLER(recording, tx)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	pop->stats->tx_histogram_recording = *(int *)arg;
+
+	return 0;
+}
+
+/*
+ * stats_tx_histogram_bucket -- (internal) retrieves and validates the
+ *	transaction histogram bucket index from the ctl query
+ */
+static ssize_t
+stats_tx_histogram_bucket(struct ctl_indexes *indexes)
+{
+	struct ctl_index *idx = PMDK_SLIST_FIRST(indexes);
+	ASSERTeq(strcmp(idx->name, "bucket_id"), 0);
+
+	if (idx->value < 0 || idx->value >= STATS_TX_HIST_BUCKETS) {
+		ERR_WO_ERRNO("bucket id outside of the allowed range");
+		errno = ERANGE;
+		return -1;
+	}
+
+	return idx->value;
+}
+
+/*
+ * CTL_READ_HANDLER(count, tx) -- reads the number of transactions recorded in
+ *	the given histogram bucket
+ */
+static int
+CTL_READ_HANDLER(count, tx)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source);
+
+	PMEMobjpool *pop = ctx;
+
+	ssize_t bucket = stats_tx_histogram_bucket(indexes);
+	if (bucket < 0)
+		return -1;
+
+	uint64_t *argv = arg;
+	*argv = stats_transient_sum(pop->stats,
+		offsetof(struct stats_transient,
+		tx_snapshot_histogram[bucket]));
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(size, tx) -- reads the upper bound of snapshotted bytes
+ *	that fall into the given histogram bucket
+ */
+static int
+CTL_READ_HANDLER(size, tx)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(ctx, source);
+
+	ssize_t bucket = stats_tx_histogram_bucket(indexes);
+	if (bucket < 0)
+		return -1;
+
+	uint64_t *argv = arg;
+	*argv = UINT64_C(1) << bucket;
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(bucket_id, tx)[] = {
+	CTL_LEAF_RO(count, tx),
+	CTL_LEAF_RO(size, tx),
+
+	CTL_NODE_END
+};
+
+static const struct ctl_node CTL_NODE(histogram, tx)[] = {
+	CTL_LEAF_RW(recording, tx),
+	CTL_INDEXED(bucket_id, tx),
+
+	CTL_NODE_END
+};
+
+/*
+ * stats_tx_lane_sum -- (internal) aggregates a single per-lane transaction
+ *	counter, given by its offset inside of struct lane_tx_stats, across
+ *	all lanes
+ */
+static uint64_t
+stats_tx_lane_sum(PMEMobjpool *pop, size_t field_offset)
+{
+	uint64_t sum = 0;
+
+	for (unsigned i = 0; i < pop->nlanes; ++i) {
+		uint64_t v;
+		util_atomic_load_explicit64((uint64_t *)((char *)
+			&pop->lanes_desc.lane[i].tx_stats + field_offset),
+			&v, memory_order_relaxed);
+		sum += v;
+	}
+
+	return sum;
+}
+
+/*
+ * STATS_TX_LANE_CTL_HANDLER -- generates a read handler for a single
+ *	per-lane transaction counter, aggregated across all lanes
+ */
+#define STATS_TX_LANE_CTL_HANDLER(name)\
+static int CTL_READ_HANDLER(name, tx)(void *ctx,\
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)\
+{\
+	/* suppress unused-parameter errors */\
+	SUPPRESS_UNUSED(source, indexes);\
+\
+	PMEMobjpool *pop = ctx;\
+	uint64_t *argv = arg;\
+	*argv = stats_tx_lane_sum(pop,\
+		offsetof(struct lane_tx_stats, name));\
+	return 0;\
+}
+
+STATS_TX_LANE_CTL_HANDLER(commits)
+STATS_TX_LANE_CTL_HANDLER(aborts)
+STATS_TX_LANE_CTL_HANDLER(bytes_logged)
+
+/*
+ * CTL_READ_HANDLER(recording, tx_latency) -- returns whether the commit
+ *	latency histogram is being recorded
+ */
+static int
+CTL_READ_HANDLER(recording, tx_latency)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	int *arg_out = arg;
+
+	*arg_out = pop->stats->tx_latency_recording;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(recording, tx_latency) -- enables or disables recording
+ *	of the commit latency histogram
+ */
+static int
+CTL_WRITE_HANDLER(recording, tx_latency)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	pop->stats->tx_latency_recording = *(int *)arg;
+
+	return 0;
+}
+
+/*
+ * stats_tx_latency_bucket -- (internal) retrieves and validates the commit
+ *	latency bucket index from the ctl query
+ */
+static ssize_t
+stats_tx_latency_bucket(struct ctl_indexes *indexes)
+{
+	struct ctl_index *idx = PMDK_SLIST_FIRST(indexes);
+	ASSERTeq(strcmp(idx->name, "bucket_id"), 0);
+
+	if (idx->value < 0 || idx->value >= LANE_TX_LAT_BUCKETS) {
+		ERR_WO_ERRNO("bucket id outside of the allowed range");
+		errno = ERANGE;
+		return -1;
+	}
+
+	return idx->value;
+}
+
+/*
+ * CTL_READ_HANDLER(count, tx_latency) -- reads the number of commits
+ *	recorded in the given latency bucket
+ */
+static int
+CTL_READ_HANDLER(count, tx_latency)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source);
+
+	PMEMobjpool *pop = ctx;
+
+	ssize_t bucket = stats_tx_latency_bucket(indexes);
+	if (bucket < 0)
+		return -1;
+
+	uint64_t *argv = arg;
+	*argv = stats_tx_lane_sum(pop,
+		offsetof(struct lane_tx_stats, commit_ns[bucket]));
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(max_ns, tx_latency) -- reads the upper bound of commit
+ *	latencies that fall into the given latency bucket
+ */
+static int
+CTL_READ_HANDLER(max_ns, tx_latency)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(ctx, source);
+
+	ssize_t bucket = stats_tx_latency_bucket(indexes);
+	if (bucket < 0)
+		return -1;
+
+	uint64_t *argv = arg;
+	*argv = UINT64_C(1) << bucket;
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(bucket_id, tx_latency)[] = {
+	CTL_LEAF_RO(count, tx_latency),
+	CTL_LEAF_RO(max_ns, tx_latency),
+
+	CTL_NODE_END
+};
+
+static const struct ctl_node CTL_NODE(latency, tx)[] = {
+	CTL_LEAF_RW(recording, tx_latency),
+	CTL_INDEXED(bucket_id, tx_latency),
+
+	CTL_NODE_END
+};
+
+static const struct ctl_node CTL_NODE(tx)[] = {
+	CTL_CHILD(histogram, tx),
+	CTL_CHILD(latency, tx),
+	CTL_LEAF_RO(commits, tx),
+	CTL_LEAF_RO(aborts, tx),
+	CTL_LEAF_RO(bytes_logged, tx),
+
+	CTL_NODE_END
+};
+
+/*
+ * stats_zone_id -- (internal) retrieves and validates the zone index from the
+ *	ctl query
+ */
+static ssize_t
+stats_zone_id(PMEMobjpool *pop, struct ctl_indexes *indexes)
+{
+	struct ctl_index *idx = PMDK_SLIST_FIRST(indexes);
+	ASSERTeq(strcmp(idx->name, "zone_id"), 0);
+
+	if (idx->value < 0 ||
+	    idx->value >= (ssize_t)heap_zone_count(&pop->heap)) {
+		ERR_WO_ERRNO("zone id outside of the allowed range");
+		errno = ERANGE;
+		return -1;
+	}
+
+	return idx->value;
+}
+
+/*
+ * STATS_ZONE_CTL_HANDLER -- generates a read handler for a single field of
+ *	the per-zone occupancy summary
+ */
+#define STATS_ZONE_CTL_HANDLER(name)\
+static int CTL_READ_HANDLER(name, zone)(void *ctx,\
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)\
+{\
+	/* suppress unused-parameter errors */\
+	SUPPRESS_UNUSED(source);\
+\
+	PMEMobjpool *pop = ctx;\
+\
+	ssize_t zone_id = stats_zone_id(pop, indexes);\
+	if (zone_id < 0)\
+		return -1;\
+\
+	struct zone_occupancy occ;\
+	if (heap_zone_occupancy_get(&pop->heap, (uint32_t)zone_id, &occ) != 0)\
+		return -1;\
+\
+	uint64_t *argv = arg;\
+	*argv = occ.name;\
+	return 0;\
+}
+
+STATS_ZONE_CTL_HANDLER(capacity)
+STATS_ZONE_CTL_HANDLER(allocated)
+STATS_ZONE_CTL_HANDLER(run_allocated)
+STATS_ZONE_CTL_HANDLER(run_active)
+
+/*
+ * CTL_READ_HANDLER(idle, zone) -- reads the seconds since the last allocator
+ *	activity in the zone
+ */
+static int
+CTL_READ_HANDLER(idle, zone)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source);
+
+	PMEMobjpool *pop = ctx;
+
+	ssize_t zone_id = stats_zone_id(pop, indexes);
+	if (zone_id < 0)
+		return -1;
+
+	uint64_t *argv = arg;
+
+	return heap_zone_idle(&pop->heap, (uint32_t)zone_id, argv);
+}
+
+/*
+ * CTL_READ_HANDLER(resident, zone) -- reads the number of bytes of the zone
+ *	that are resident in physical memory
+ */
+static int
+CTL_READ_HANDLER(resident, zone)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source);
+
+	PMEMobjpool *pop = ctx;
+
+	ssize_t zone_id = stats_zone_id(pop, indexes);
+	if (zone_id < 0)
+		return -1;
+
+	uint64_t *argv = arg;
+
+	return heap_zone_resident(&pop->heap, (uint32_t)zone_id, argv);
+}
+
+/*
+ * CTL_READ_HANDLER(heat, zone) -- reads the number of sampled oid
+ *	translations that resolved into the zone
+ */
+static int
+CTL_READ_HANDLER(heat, zone)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source);
+
+	PMEMobjpool *pop = ctx;
+
+	ssize_t zone_id = stats_zone_id(pop, indexes);
+	if (zone_id < 0)
+		return -1;
+
+	uint64_t *argv = arg;
+
+	return heap_zone_heat(&pop->heap, (uint32_t)zone_id, argv);
+}
+
+/*
+ * CTL_READ_HANDLER(hugepage_mapped) -- reads the number of bytes of the pool
+ *	that are currently mapped with huge pages
+ */
+static int
+CTL_READ_HANDLER(hugepage_mapped)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	size_t hugepage;
+	if (util_range_hugepages(pop->addr, pop->set->poolsize, &hugepage) != 0)
+		return -1;
+
+	uint64_t *argv = arg;
+	*argv = hugepage;
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(count, zone) -- reads the number of zones of the heap
+ */
+static int
+CTL_READ_HANDLER(count, zone)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	uint64_t *argv = arg;
+	*argv = heap_zone_count(&pop->heap);
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(zone_id)[] = {
+	CTL_LEAF_RO(capacity, zone),
+	CTL_LEAF_RO(allocated, zone),
+	CTL_LEAF_RO(run_allocated, zone),
+	CTL_LEAF_RO(run_active, zone),
+	CTL_LEAF_RO(idle, zone),
+	CTL_LEAF_RO(resident, zone),
+	CTL_LEAF_RO(heat, zone),
+
+	CTL_NODE_END
+};
+
+static const struct ctl_node CTL_NODE(zone)[] = {
+	CTL_LEAF_RO(count, zone),
+	CTL_INDEXED(zone_id),
+
+	CTL_NODE_END
+};
 
 static const struct ctl_node CTL_NODE(heap)[] = {
 	STATS_CTL_LEAF(persistent, curr_allocated),
 	STATS_CTL_LEAF(transient, run_allocated),
 	STATS_CTL_LEAF(transient, run_active),
+	CTL_LEAF_RO(hugepage_mapped),
+	CTL_CHILD(histogram),
+	CTL_CHILD(zone),
 
 	CTL_NODE_END
 };
@@ -100,14 +746,226 @@ CTL_WRITE_HANDLER(enabled)(void *ctx,
 static const struct ctl_argument CTL_ARG(enabled) = {
 	.dest_size = sizeof(enum pobj_stats_enabled),
 	.parsers = {
-		CTL_ARG_PARSER(sizeof(enum pobj_stats_enabled),
+		CTL_ARG_PARSER(enum pobj_stats_enabled,
 			stats_enabled_parser),
 		CTL_ARG_PARSER_END
 	}
 };
 
+/*
+ * stats_export_name -- (internal) computes the shared memory segment name
+ *	under which this pool's statistics block is published
+ */
+static int
+stats_export_name(PMEMobjpool *pop, char *buf, size_t len)
+{
+	if (util_snprintf(buf, len, "/pmemobj-stats.%d.%016" PRIx64,
+	    getpid(), pop->uuid_lo) < 0) {
+		ERR_W_ERRNO("snprintf");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * stats_export_enable -- (internal) starts publishing the statistics block
+ *
+ * The freshly mapped segment takes over the role of the transient shard
+ * array, so the hot-path counter updates publish themselves at no extra cost.
+ * Updates racing with the pointer switch may still land in the old array and
+ * not be reflected in the export; the counters are monitoring data and are
+ * approximate by nature, so this is acceptable.
+ */
+static int
+stats_export_enable(PMEMobjpool *pop)
+{
+	struct stats *s = pop->stats;
+
+	if (s->export_hdr != NULL)
+		return 0;
+
+	char name[POBJ_STATS_EXPORT_NAME_MAX];
+	if (stats_export_name(pop, name, sizeof(name)) != 0)
+		return -1;
+
+	size_t shards_size = sizeof(struct stats_transient) * STATS_NSHARDS;
+	size_t size = sizeof(struct pobj_stats_export) + shards_size;
+
+	/* a stale segment might be left over after a crash */
+	shm_unlink(name);
+
+	int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd < 0) {
+		ERR_W_ERRNO("shm_open");
+		return -1;
+	}
+
+	if (os_ftruncate(fd, (os_off_t)size) != 0) {
+		ERR_W_ERRNO("ftruncate");
+		goto error_segment;
+	}
+
+	struct pobj_stats_export *hdr = mmap(NULL, size,
+		PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (hdr == MAP_FAILED) {
+		ERR_W_ERRNO("mmap");
+		goto error_segment;
+	}
+	os_close(fd);
+
+	struct stats_transient *shards = (struct stats_transient *)(hdr + 1);
+	memcpy(shards, s->transient, shards_size);
+
+	hdr->version = POBJ_STATS_EXPORT_VERSION;
+	hdr->size = size;
+	hdr->pid = (uint64_t)getpid();
+	hdr->shards_offset = sizeof(*hdr);
+	hdr->nshards = STATS_NSHARDS;
+	hdr->shard_size = sizeof(struct stats_transient);
+	hdr->run_allocated_offset =
+		offsetof(struct stats_transient, heap_run_allocated);
+	hdr->run_active_offset =
+		offsetof(struct stats_transient, heap_run_active);
+	hdr->alloc_histogram_offset =
+		offsetof(struct stats_transient, alloc_size_histogram);
+	hdr->alloc_histogram_unit = STATS_ALLOC_HIST_UNIT;
+	hdr->alloc_histogram_buckets = STATS_ALLOC_HIST_BUCKETS;
+	hdr->tx_histogram_offset =
+		offsetof(struct stats_transient, tx_snapshot_histogram);
+	hdr->tx_histogram_buckets = STATS_TX_HIST_BUCKETS;
+	hdr->heap_curr_allocated = s->persistent->heap_curr_allocated;
+
+	/* the signature goes in last - readers key off of it */
+	uint64_t sig;
+	memcpy(&sig, POBJ_STATS_EXPORT_SIGNATURE, sizeof(sig));
+	util_atomic_store_explicit64((uint64_t *)hdr->signature, sig,
+		memory_order_release);
+
+	s->transient = shards;
+	s->export_hdr = hdr;
+
+	LOG(3, "pool %p statistics published at %s", pop, name);
+
+	return 0;
+
+error_segment:
+	os_close(fd);
+	shm_unlink(name);
+	return -1;
+}
+
+/*
+ * stats_export_disable -- (internal) stops publishing the statistics block
+ *
+ * The shard contents migrate back into the heap-allocated array, so no counts
+ * are lost across an enable/disable cycle. Since the segment is unmapped,
+ * this must not race with pool operations that update statistics.
+ */
+static void
+stats_export_disable(PMEMobjpool *pop)
+{
+	struct stats *s = pop->stats;
+
+	if (s->export_hdr == NULL)
+		return;
+
+	struct pobj_stats_export *hdr = s->export_hdr;
+
+	memcpy(s->transient_heap, s->transient,
+		sizeof(struct stats_transient) * STATS_NSHARDS);
+	s->transient = s->transient_heap;
+	s->export_hdr = NULL;
+
+	char name[POBJ_STATS_EXPORT_NAME_MAX];
+	if (stats_export_name(pop, name, sizeof(name)) == 0)
+		shm_unlink(name);
+
+	munmap(hdr, hdr->size);
+}
+
+/*
+ * CTL_READ_HANDLER(enabled, export) -- returns whether the statistics block
+ *	is currently published
+ */
+static int
+CTL_READ_HANDLER(enabled, export)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	int *argv = arg;
+	*argv = pop->stats->export_hdr != NULL;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(enabled, export) -- starts or stops publishing the
+ *	statistics block
+ */
+static int
+CTL_WRITE_HANDLER(enabled, export)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	int arg_in = *(int *)arg;
+	if (!arg_in) {
+		stats_export_disable(pop);
+		return 0;
+	}
+
+	return stats_export_enable(pop);
+}
+
+/*
+ * CTL_READ_HANDLER(name, export) -- reads the name of the shared memory
+ *	segment; the argument must be a buffer of at least
+ *	POBJ_STATS_EXPORT_NAME_MAX bytes
+ */
+static int
+CTL_READ_HANDLER(name, export)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	return stats_export_name(pop, arg, POBJ_STATS_EXPORT_NAME_MAX);
+}
+
+static const struct ctl_argument CTL_ARG(export_enabled) = CTL_ARG_BOOLEAN;
+
+static const struct ctl_node CTL_NODE(export)[] = {
+	/*
+	 * Spelled out instead of CTL_LEAF_RW(enabled, export) because the
+	 * CTL_ARG(enabled) symbol is taken by the stats.enabled argument,
+	 * which parses the enable type rather than a boolean.
+	 */
+	{"enabled", CTL_NODE_LEAF,
+	{CTL_READ_HANDLER(enabled, export),
+	CTL_WRITE_HANDLER(enabled, export), NULL},
+	&CTL_ARG(export_enabled), NULL},
+	CTL_LEAF_RO(name, export),
+
+	CTL_NODE_END
+};
+
 static const struct ctl_node CTL_NODE(stats)[] = {
 	CTL_CHILD(heap),
+	CTL_CHILD(tx),
+	CTL_CHILD(export),
 	CTL_LEAF_RW(enabled),
 
 	CTL_NODE_END
@@ -126,11 +984,16 @@ stats_new(PMEMobjpool *pop)
 	}
 
 	s->enabled = POBJ_STATS_ENABLED_TRANSIENT;
+	s->alloc_histogram_recording = 0;
+	s->tx_histogram_recording = 0;
+	s->tx_latency_recording = 0;
 	s->persistent = &pop->stats_persistent;
 	VALGRIND_ADD_TO_GLOBAL_TX_IGNORE(s->persistent, sizeof(*s->persistent));
-	s->transient = Zalloc(sizeof(struct stats_transient));
+	s->transient = Zalloc(sizeof(struct stats_transient) * STATS_NSHARDS);
 	if (s->transient == NULL)
 		goto error_transient_alloc;
+	s->transient_heap = s->transient;
+	s->export_hdr = NULL;
 
 	return s;
 
@@ -145,6 +1008,8 @@ error_transient_alloc:
 void
 stats_delete(PMEMobjpool *pop, struct stats *s)
 {
+	stats_export_disable(pop);
+
 	pmemops_persist(&pop->p_ops, s->persistent,
 	sizeof(struct stats_persistent));
 	Free(s->transient);
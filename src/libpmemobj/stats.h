@@ -10,14 +10,39 @@
 
 #include "ctl.h"
 #include "libpmemobj/ctl.h"
+#include "util.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/*
+ * The allocation size histogram tracks requested sizes in
+ * STATS_ALLOC_HIST_UNIT byte wide buckets, with the last bucket being a
+ * catch-all for everything larger.
+ */
+#define STATS_ALLOC_HIST_UNIT 32
+#define STATS_ALLOC_HIST_BUCKETS 64
+
+/*
+ * The transaction histogram tracks the total number of bytes snapshotted by
+ * each completed transaction in power-of-two buckets, with the last bucket
+ * being a catch-all for everything larger.
+ */
+#define STATS_TX_HIST_BUCKETS 40
+
+/*
+ * The number of shards the transient statistics are split into. Each thread
+ * updates only its own shard, avoiding cache-line contention on the hot
+ * allocation paths; readers lazily aggregate all shards.
+ */
+#define STATS_NSHARDS 64
+
 struct stats_transient {
 	uint64_t heap_run_allocated;
 	uint64_t heap_run_active;
+	uint64_t alloc_size_histogram[STATS_ALLOC_HIST_BUCKETS];
+	uint64_t tx_snapshot_histogram[STATS_TX_HIST_BUCKETS];
 };
 
 struct stats_persistent {
@@ -26,10 +51,67 @@ struct stats_persistent {
 
 struct stats {
 	enum pobj_stats_enabled enabled;
+	int alloc_histogram_recording;
+	int tx_histogram_recording;
+	int tx_latency_recording;
+	/* an array of STATS_NSHARDS shards */
 	struct stats_transient *transient;
 	struct stats_persistent *persistent;
+
+	/*
+	 * When statistics export is enabled, the transient shard array lives
+	 * inside a shared memory segment headed by the export block, so the
+	 * regular shard updates are published as-is; transient_heap keeps the
+	 * original malloc'd array for when the export is torn down. The
+	 * persistent counter, which must keep residing in the pool, is
+	 * additionally mirrored into the export header by the macros below.
+	 */
+	struct pobj_stats_export *export_hdr;
+	struct stats_transient *transient_heap;
 };
 
+struct stats_transient *stats_transient_shard(struct stats *stats);
+uint64_t stats_transient_sum(const struct stats *stats, size_t field_offset);
+
+/*
+ * stats_alloc_histogram_record -- records an allocation size in the histogram
+ */
+static inline void
+stats_alloc_histogram_record(struct stats *stats, size_t size)
+{
+	if (!stats->alloc_histogram_recording)
+		return;
+
+	size_t bucket = (size - 1) / STATS_ALLOC_HIST_UNIT;
+	if (bucket >= STATS_ALLOC_HIST_BUCKETS)
+		bucket = STATS_ALLOC_HIST_BUCKETS - 1;
+
+	util_fetch_and_add64(
+		&stats_transient_shard(stats)->alloc_size_histogram[bucket],
+		1);
+}
+
+/*
+ * stats_tx_histogram_record -- records the total number of bytes snapshotted
+ *	by a completed transaction
+ */
+static inline void
+stats_tx_histogram_record(struct stats *stats, uint64_t bytes)
+{
+	if (!stats->tx_histogram_recording)
+		return;
+
+	size_t bucket = 0;
+	if (bytes != 0)
+		bucket = (size_t)util_mssb_index64(bytes) + 1;
+	if (bucket >= STATS_TX_HIST_BUCKETS)
+		bucket = STATS_TX_HIST_BUCKETS - 1;
+
+	util_fetch_and_add64(
+		&stats_transient_shard(stats)->tx_snapshot_histogram[bucket],
+		1);
+}
+
 #define STATS_INC(stats, type, name, value) do {\
 	STATS_INC_##type(stats, name, value);\
 } while (0)
@@ -37,29 +119,43 @@ struct stats {
 #define STATS_INC_transient(stats, name, value) do {\
 	if ((stats)->enabled == POBJ_STATS_ENABLED_TRANSIENT ||\
 	(stats)->enabled == POBJ_STATS_ENABLED_BOTH)\
-		util_fetch_and_add64((&(stats)->transient->name), (value));\
+		util_fetch_and_add64(\
+		(&stats_transient_shard(stats)->name), (value));\
 } while (0)
 
 #define STATS_INC_persistent(stats, name, value) do {\
 	if ((stats)->enabled == POBJ_STATS_ENABLED_PERSISTENT ||\
-	(stats)->enabled == POBJ_STATS_ENABLED_BOTH)\
+	(stats)->enabled == POBJ_STATS_ENABLED_BOTH) {\
 		util_fetch_and_add64((&(stats)->persistent->name), (value));\
+		if ((stats)->export_hdr != NULL)\
+			util_fetch_and_add64((&(stats)->export_hdr->name),\
+			(value));\
+	}\
 } while (0)
 
 #define STATS_SUB(stats, type, name, value) do {\
 	STATS_SUB_##type(stats, name, value);\
 } while (0)
 
+/*
+ * Subtraction from a sharded counter may transiently underflow a single
+ * shard; the aggregate remains correct because the summation is modular.
+ */
 #define STATS_SUB_transient(stats, name, value) do {\
 	if ((stats)->enabled == POBJ_STATS_ENABLED_TRANSIENT ||\
 	(stats)->enabled == POBJ_STATS_ENABLED_BOTH)\
-		util_fetch_and_sub64((&(stats)->transient->name), (value));\
+		util_fetch_and_sub64(\
+		(&stats_transient_shard(stats)->name), (value));\
 } while (0)
 
 #define STATS_SUB_persistent(stats, name, value) do {\
 	if ((stats)->enabled == POBJ_STATS_ENABLED_PERSISTENT ||\
-	(stats)->enabled == POBJ_STATS_ENABLED_BOTH)\
+	(stats)->enabled == POBJ_STATS_ENABLED_BOTH) {\
 		util_fetch_and_sub64((&(stats)->persistent->name), (value));\
+		if ((stats)->export_hdr != NULL)\
+			util_fetch_and_sub64((&(stats)->export_hdr->name),\
+			(value));\
+	}\
 } while (0)
 
 #define STATS_SET(stats, type, name, value) do {\
@@ -69,15 +165,21 @@ struct stats {
 #define STATS_SET_transient(stats, name, value) do {\
 	if ((stats)->enabled == POBJ_STATS_ENABLED_TRANSIENT ||\
 	(stats)->enabled == POBJ_STATS_ENABLED_BOTH)\
-		util_atomic_store_explicit64((&(stats)->transient->name),\
+		util_atomic_store_explicit64(\
+		(&stats_transient_shard(stats)->name),\
 		(value), memory_order_release);\
 } while (0)
 
 #define STATS_SET_persistent(stats, name, value) do {\
 	if ((stats)->enabled == POBJ_STATS_ENABLED_PERSISTENT ||\
-	(stats)->enabled == POBJ_STATS_ENABLED_BOTH)\
+	(stats)->enabled == POBJ_STATS_ENABLED_BOTH) {\
 		util_atomic_store_explicit64((&(stats)->persistent->name),\
 		(value), memory_order_release);\
+		if ((stats)->export_hdr != NULL)\
+			util_atomic_store_explicit64(\
+			(&(stats)->export_hdr->name),\
+			(value), memory_order_release);\
+	}\
 } while (0)
 
 #define STATS_CTL_LEAF(type, name)\
@@ -99,6 +201,20 @@ static int CTL_READ_HANDLER(type##_##name)(void *ctx,\
 	return 0;\
 }
 
+#define STATS_CTL_HANDLER_TRANSIENT(name, varname)\
+static int CTL_READ_HANDLER(transient_##name)(void *ctx,\
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)\
+{\
+	/* suppress unused-parameter errors */\
+	SUPPRESS_UNUSED(source, indexes);\
+\
+	PMEMobjpool *pop = ctx;\
+	uint64_t *argv = arg;\
+	*argv = stats_transient_sum(pop->stats,\
+		offsetof(struct stats_transient, varname));\
+	return 0;\
+}
+
 void stats_ctl_register(PMEMobjpool *pop);
 
 struct stats *stats_new(PMEMobjpool *pop);
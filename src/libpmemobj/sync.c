@@ -6,8 +6,14 @@
  */
 
 #include <inttypes.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #include "obj.h"
+#include "os.h"
 #include "out.h"
 #include "util.h"
 #include "sync.h"
@@ -17,6 +23,182 @@
 
 #define RECORD_LOCK(init, type, p)
 
+/*
+ * Number of optimistic acquisition attempts before an rwlock acquisition
+ * blocks in the kernel.  Read-mostly workloads hold the lock for a few
+ * dozen cycles, so a short spin usually succeeds and saves the futex
+ * round trip; once the attempts are exhausted the contention is real and
+ * blocking is the right thing to do.
+ */
+#define RWLOCK_SPIN_ATTEMPTS 64
+
+/*
+ * When enabled with PMEMOBJ_FUTEX_LOCKS, PMEMmutex and PMEMcond are backed
+ * by bare futex words instead of pthread primitives, skipping the
+ * bookkeeping pthread performs on every lock and unlock. The futex word
+ * occupies the same runtime-initialized slot as the pthread object and its
+ * validity is governed by the same runid scheme. A pool can be opened by
+ * only one process at a time, so process-private futexes are sufficient;
+ * the price is that none of the pthread error checking (EPERM on unlocking
+ * a mutex owned by another thread, EDEADLK detection) is performed.
+ */
+static int Futex_locks;
+
+/* futex mutex word states */
+#define FUTEX_MUTEX_FREE 0
+#define FUTEX_MUTEX_LOCKED 1
+#define FUTEX_MUTEX_CONTENDED 2
+
+/*
+ * sync_boot -- initializes the synchronization primitives machinery
+ */
+void
+sync_boot(void)
+{
+	char *e = os_getenv("PMEMOBJ_FUTEX_LOCKS");
+	if (e != NULL && strcmp(e, "0") != 0)
+		Futex_locks = 1;
+}
+
+/*
+ * sync_futex -- (internal) wrapper around the futex syscall
+ *
+ * All waiting is done on process-private futexes; timeouts are absolute
+ * CLOCK_REALTIME values, matching the pthread timedlock/timedwait
+ * interfaces the callers implement.
+ */
+static long
+sync_futex(uint32_t *word, int op, uint32_t val,
+	const struct timespec *abs_timeout)
+{
+	uint32_t val3 = 0;
+
+	if (abs_timeout != NULL) {
+		ASSERT(op == FUTEX_WAIT);
+		op = FUTEX_WAIT_BITSET | FUTEX_CLOCK_REALTIME;
+		val3 = FUTEX_BITSET_MATCH_ANY;
+	}
+
+	return syscall(SYS_futex, word, op | FUTEX_PRIVATE_FLAG, val,
+		abs_timeout, NULL, val3);
+}
+
+/*
+ * futex_word_init -- (internal) initialize a futex lock word
+ */
+static int
+futex_word_init(void *word, void *arg)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(arg);
+
+	*(uint32_t *)word = FUTEX_MUTEX_FREE;
+
+	return 0;
+}
+
+/*
+ * futex_mutex_trylock -- (internal) acquire a futex mutex if it is free
+ */
+static int
+futex_mutex_trylock(uint32_t *word)
+{
+	if (util_bool_compare_and_swap32(word, FUTEX_MUTEX_FREE,
+			FUTEX_MUTEX_LOCKED))
+		return 0;
+
+	return EBUSY;
+}
+
+/*
+ * futex_mutex_lock -- (internal) acquire a futex mutex
+ *
+ * A thread that has to sleep leaves the word in the contended state, so
+ * the eventual unlock knows it must issue a wakeup. Returns ETIMEDOUT
+ * when the optional absolute timeout expires while waiting.
+ */
+static int
+futex_mutex_lock(uint32_t *word, const struct timespec *abs_timeout)
+{
+	if (util_bool_compare_and_swap32(word, FUTEX_MUTEX_FREE,
+			FUTEX_MUTEX_LOCKED))
+		return 0;
+
+	for (;;) {
+		uint32_t val;
+		util_atomic_load_explicit32(word, &val, memory_order_relaxed);
+
+		if (val == FUTEX_MUTEX_LOCKED &&
+		    !util_bool_compare_and_swap32(word, FUTEX_MUTEX_LOCKED,
+				FUTEX_MUTEX_CONTENDED))
+			continue;
+
+		if (val != FUTEX_MUTEX_FREE) {
+			long r = sync_futex(word, FUTEX_WAIT,
+				FUTEX_MUTEX_CONTENDED, abs_timeout);
+			if (r == -1 && errno == ETIMEDOUT)
+				return ETIMEDOUT;
+		}
+
+		if (util_bool_compare_and_swap32(word, FUTEX_MUTEX_FREE,
+				FUTEX_MUTEX_CONTENDED))
+			return 0;
+	}
+}
+
+/*
+ * futex_mutex_unlock -- (internal) release a futex mutex
+ */
+static int
+futex_mutex_unlock(uint32_t *word)
+{
+	if (util_fetch_and_sub32(word, 1) != FUTEX_MUTEX_LOCKED) {
+		util_atomic_store_explicit32(word, FUTEX_MUTEX_FREE,
+			memory_order_release);
+		sync_futex(word, FUTEX_WAKE, 1, NULL);
+	}
+
+	return 0;
+}
+
+/*
+ * futex_cond_wait -- (internal) wait for a wakeup of a futex condition
+ * variable
+ *
+ * The condition word is a wakeup counter bumped by every signal and
+ * broadcast; sleeping on its sampled value guarantees that a wakeup
+ * issued after the mutex is released is never missed. Spurious wakeups
+ * are allowed, as with the pthread counterpart.
+ */
+static int
+futex_cond_wait(uint32_t *cond, uint32_t *mutex,
+	const struct timespec *abs_timeout)
+{
+	uint32_t val;
+	util_atomic_load_explicit32(cond, &val, memory_order_acquire);
+
+	futex_mutex_unlock(mutex);
+
+	long r = sync_futex(cond, FUTEX_WAIT, val, abs_timeout);
+	int ret = (r == -1 && errno == ETIMEDOUT) ? ETIMEDOUT : 0;
+
+	futex_mutex_lock(mutex, NULL);
+
+	return ret;
+}
+
+/*
+ * futex_cond_wake -- (internal) wake waiters of a futex condition variable
+ */
+static int
+futex_cond_wake(uint32_t *cond, uint32_t nwaiters)
+{
+	util_fetch_and_add32(cond, 1);
+	sync_futex(cond, FUTEX_WAKE, nwaiters, NULL);
+
+	return 0;
+}
+
 /*
  * _get_value -- (internal) atomically initialize and return a value.
  *	Returns -1 on error, 0 if the caller is not the value
@@ -87,6 +269,32 @@ get_mutex(PMEMobjpool *pop, PMEMmutex_internal *imp)
 	return &imp->PMEMmutex_lock;
 }
 
+/*
+ * get_futex_mutex -- (internal) atomically initialize and return the futex
+ *	word backing a mutex
+ */
+static inline uint32_t *
+get_futex_mutex(PMEMobjpool *pop, PMEMmutex_internal *imp)
+{
+	if (likely(imp->pmemmutex.runid == pop->run_id))
+		return &imp->PMEMmutex_futex;
+
+	volatile uint64_t *runid = &imp->pmemmutex.runid;
+
+	LOG(5, "PMEMmutex %p pop->run_id %" PRIu64 " pmemmutex.runid %" PRIu64,
+		imp, pop->run_id, *runid);
+
+	ASSERTeq((uintptr_t)runid % util_alignof(uint64_t), 0);
+
+	VALGRIND_REMOVE_PMEM_MAPPING(imp, _POBJ_CL_SIZE);
+
+	if (_get_value(pop->run_id, runid, &imp->PMEMmutex_futex, NULL,
+			futex_word_init) == -1)
+		return NULL;
+
+	return &imp->PMEMmutex_futex;
+}
+
 /*
  * get_rwlock -- (internal) atomically initialize, record and return a rwlock
  */
@@ -154,6 +362,32 @@ get_cond(PMEMobjpool *pop, PMEMcond_internal *icp)
 	return &icp->PMEMcond_cond;
 }
 
+/*
+ * get_futex_cond -- (internal) atomically initialize and return the futex
+ *	word backing a condition variable
+ */
+static inline uint32_t *
+get_futex_cond(PMEMobjpool *pop, PMEMcond_internal *icp)
+{
+	if (likely(icp->pmemcond.runid == pop->run_id))
+		return &icp->PMEMcond_futex;
+
+	volatile uint64_t *runid = &icp->pmemcond.runid;
+
+	LOG(5, "PMEMcond %p pop->run_id %" PRIu64 " pmemcond.runid %" PRIu64,
+		icp, pop->run_id, *runid);
+
+	ASSERTeq((uintptr_t)runid % util_alignof(uint64_t), 0);
+
+	VALGRIND_REMOVE_PMEM_MAPPING(icp, _POBJ_CL_SIZE);
+
+	if (_get_value(pop->run_id, runid, &icp->PMEMcond_futex, NULL,
+			futex_word_init) == -1)
+		return NULL;
+
+	return &icp->PMEMcond_futex;
+}
+
 /*
  * pmemobj_mutex_zero -- zero-initialize a pmem resident mutex
  *
@@ -186,6 +420,15 @@ pmemobj_mutex_lock(PMEMobjpool *pop, PMEMmutex *mutexp)
 	ASSERTeq(pop, pmemobj_pool_by_ptr(mutexp));
 
 	PMEMmutex_internal *mutexip = (PMEMmutex_internal *)mutexp;
+
+	if (Futex_locks) {
+		uint32_t *fm = get_futex_mutex(pop, mutexip);
+		if (fm == NULL)
+			return EINVAL;
+
+		return futex_mutex_lock(fm, NULL);
+	}
+
 	os_mutex_t *mutex = get_mutex(pop, mutexip);
 
 	if (mutex == NULL)
@@ -209,6 +452,19 @@ pmemobj_mutex_assert_locked(PMEMobjpool *pop, PMEMmutex *mutexp)
 	ASSERTeq(pop, pmemobj_pool_by_ptr(mutexp));
 
 	PMEMmutex_internal *mutexip = (PMEMmutex_internal *)mutexp;
+
+	if (Futex_locks) {
+		uint32_t *fm = get_futex_mutex(pop, mutexip);
+		if (fm == NULL)
+			return EINVAL;
+
+		if (futex_mutex_trylock(fm) == EBUSY)
+			return 0;
+
+		futex_mutex_unlock(fm);
+		return ENODEV;
+	}
+
 	os_mutex_t *mutex = get_mutex(pop, mutexip);
 	if (mutex == NULL)
 		return EINVAL;
@@ -244,6 +500,15 @@ pmemobj_mutex_timedlock(PMEMobjpool *pop, PMEMmutex *__restrict mutexp,
 	ASSERTeq(pop, pmemobj_pool_by_ptr(mutexp));
 
 	PMEMmutex_internal *mutexip = (PMEMmutex_internal *)mutexp;
+
+	if (Futex_locks) {
+		uint32_t *fm = get_futex_mutex(pop, mutexip);
+		if (fm == NULL)
+			return EINVAL;
+
+		return futex_mutex_lock(fm, abs_timeout);
+	}
+
 	os_mutex_t *mutex = get_mutex(pop, mutexip);
 	if (mutex == NULL)
 		return EINVAL;
@@ -267,6 +532,15 @@ pmemobj_mutex_trylock(PMEMobjpool *pop, PMEMmutex *mutexp)
 	ASSERTeq(pop, pmemobj_pool_by_ptr(mutexp));
 
 	PMEMmutex_internal *mutexip = (PMEMmutex_internal *)mutexp;
+
+	if (Futex_locks) {
+		uint32_t *fm = get_futex_mutex(pop, mutexip);
+		if (fm == NULL)
+			return EINVAL;
+
+		return futex_mutex_trylock(fm);
+	}
+
 	os_mutex_t *mutex = get_mutex(pop, mutexip);
 	if (mutex == NULL)
 		return EINVAL;
@@ -288,6 +562,15 @@ pmemobj_mutex_unlock(PMEMobjpool *pop, PMEMmutex *mutexp)
 
 	/* XXX potential performance improvement - move GET to debug version */
 	PMEMmutex_internal *mutexip = (PMEMmutex_internal *)mutexp;
+
+	if (Futex_locks) {
+		uint32_t *fm = get_futex_mutex(pop, mutexip);
+		if (fm == NULL)
+			return EINVAL;
+
+		return futex_mutex_unlock(fm);
+	}
+
 	os_mutex_t *mutex = get_mutex(pop, mutexip);
 	if (mutex == NULL)
 		return EINVAL;
@@ -335,6 +618,13 @@ pmemobj_rwlock_rdlock(PMEMobjpool *pop, PMEMrwlock *rwlockp)
 
 	ASSERTeq((uintptr_t)rwlock % util_alignof(os_rwlock_t), 0);
 
+	/* brief optimistic spin before blocking */
+	for (int i = 0; i < RWLOCK_SPIN_ATTEMPTS; ++i) {
+		int ret = os_rwlock_tryrdlock(rwlock);
+		if (ret != EBUSY)
+			return ret;
+	}
+
 	return os_rwlock_rdlock(rwlock);
 }
 
@@ -358,6 +648,13 @@ pmemobj_rwlock_wrlock(PMEMobjpool *pop, PMEMrwlock *rwlockp)
 
 	ASSERTeq((uintptr_t)rwlock % util_alignof(os_rwlock_t), 0);
 
+	/* brief optimistic spin before blocking */
+	for (int i = 0; i < RWLOCK_SPIN_ATTEMPTS; ++i) {
+		int ret = os_rwlock_trywrlock(rwlock);
+		if (ret != EBUSY)
+			return ret;
+	}
+
 	return os_rwlock_wrlock(rwlock);
 }
 
@@ -510,6 +807,15 @@ pmemobj_cond_broadcast(PMEMobjpool *pop, PMEMcond *condp)
 	ASSERTeq(pop, pmemobj_pool_by_ptr(condp));
 
 	PMEMcond_internal *condip = (PMEMcond_internal *)condp;
+
+	if (Futex_locks) {
+		uint32_t *fc = get_futex_cond(pop, condip);
+		if (fc == NULL)
+			return EINVAL;
+
+		return futex_cond_wake(fc, INT_MAX);
+	}
+
 	os_cond_t *cond = get_cond(pop, condip);
 	if (cond == NULL)
 		return EINVAL;
@@ -533,6 +839,15 @@ pmemobj_cond_signal(PMEMobjpool *pop, PMEMcond *condp)
 	ASSERTeq(pop, pmemobj_pool_by_ptr(condp));
 
 	PMEMcond_internal *condip = (PMEMcond_internal *)condp;
+
+	if (Futex_locks) {
+		uint32_t *fc = get_futex_cond(pop, condip);
+		if (fc == NULL)
+			return EINVAL;
+
+		return futex_cond_wake(fc, 1);
+	}
+
 	os_cond_t *cond = get_cond(pop, condip);
 	if (cond == NULL)
 		return EINVAL;
@@ -561,6 +876,16 @@ pmemobj_cond_timedwait(PMEMobjpool *pop, PMEMcond *__restrict condp,
 
 	PMEMcond_internal *condip = (PMEMcond_internal *)condp;
 	PMEMmutex_internal *mutexip = (PMEMmutex_internal *)mutexp;
+
+	if (Futex_locks) {
+		uint32_t *fc = get_futex_cond(pop, condip);
+		uint32_t *fm = get_futex_mutex(pop, mutexip);
+		if ((fc == NULL) || (fm == NULL))
+			return EINVAL;
+
+		return futex_cond_wait(fc, fm, abs_timeout);
+	}
+
 	os_cond_t *cond = get_cond(pop, condip);
 	os_mutex_t *mutex = get_mutex(pop, mutexip);
 	if ((cond == NULL) || (mutex == NULL))
@@ -589,6 +914,16 @@ pmemobj_cond_wait(PMEMobjpool *pop, PMEMcond *condp,
 
 	PMEMcond_internal *condip = (PMEMcond_internal *)condp;
 	PMEMmutex_internal *mutexip = (PMEMmutex_internal *)mutexp;
+
+	if (Futex_locks) {
+		uint32_t *fc = get_futex_cond(pop, condip);
+		uint32_t *fm = get_futex_mutex(pop, mutexip);
+		if ((fc == NULL) || (fm == NULL))
+			return EINVAL;
+
+		return futex_cond_wait(fc, fm, NULL);
+	}
+
 	os_cond_t *cond = get_cond(pop, condip);
 	os_mutex_t *mutex = get_mutex(pop, mutexip);
 	if ((cond == NULL) || (mutex == NULL))
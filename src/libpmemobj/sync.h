@@ -28,6 +28,7 @@ typedef union padded_pmemmutex {
 		uint64_t runid;
 		union {
 			os_mutex_t mutex;
+			uint32_t futex;
 			struct {
 				void *bsd_mutex_p;
 				union padded_pmemmutex *next;
@@ -36,6 +37,7 @@ typedef union padded_pmemmutex {
 	} pmemmutex;
 } PMEMmutex_internal;
 #define PMEMmutex_lock pmemmutex.mutex_u.mutex
+#define PMEMmutex_futex pmemmutex.mutex_u.futex
 #define PMEMmutex_bsd_mutex_p pmemmutex.mutex_u.bsd_u.bsd_mutex_p
 #define PMEMmutex_next pmemmutex.mutex_u.bsd_u.next
 
@@ -62,6 +64,7 @@ typedef union padded_pmemcond {
 		uint64_t runid;
 		union {
 			os_cond_t cond;
+			uint32_t futex;
 			struct {
 				void *bsd_cond_p;
 				union padded_pmemcond *next;
@@ -70,6 +73,7 @@ typedef union padded_pmemcond {
 	} pmemcond;
 } PMEMcond_internal;
 #define PMEMcond_cond pmemcond.cond_u.cond
+#define PMEMcond_futex pmemcond.cond_u.futex
 #define PMEMcond_bsd_cond_p pmemcond.cond_u.bsd_u.bsd_cond_p
 #define PMEMcond_next pmemcond.cond_u.bsd_u.next
 
@@ -105,6 +109,8 @@ pmemobj_mutex_unlock_nofail(PMEMobjpool *pop, PMEMmutex *mutexp)
 
 int pmemobj_mutex_assert_locked(PMEMobjpool *pop, PMEMmutex *mutexp);
 
+void sync_boot(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -12,11 +12,13 @@
 #include "queue.h"
 #include "ravl.h"
 #include "obj.h"
+#include "os.h"
 #include "core_assert.h"
 #include "pmalloc.h"
 #include "tx.h"
 #include "valgrind_internal.h"
 #include "memops.h"
+#include "sys_util.h"
 
 struct tx_data {
 	PMDK_SLIST_ENTRY(tx_data) tx_entry;
@@ -24,6 +26,19 @@ struct tx_data {
 	enum pobj_tx_failure_behavior failure_behavior;
 };
 
+struct tx_range_def {
+	uint64_t offset;
+	uint64_t size;
+	uint64_t flags;
+};
+
+/* number of recently snapshotted ranges kept in front of the ranges tree */
+#define TX_COVERED_CACHE_SIZE 8
+
+/* granularity of the snapshotted pages bitmap */
+#define TX_SNAPSHOT_PAGE_SHIFT 12
+#define TX_SNAPSHOT_PAGE_SIZE (1ULL << TX_SNAPSHOT_PAGE_SHIFT)
+
 struct tx {
 	PMEMobjpool *pop;
 	enum pobj_tx_stage stage;
@@ -32,8 +47,35 @@ struct tx {
 	PMDK_SLIST_HEAD(txl, tx_lock_data) tx_locks;
 	PMDK_SLIST_HEAD(txd, tx_data) tx_entries;
 
+	/*
+	 * The number of nested transaction levels flattened into the
+	 * enclosing one. A nested pmemobj_tx_begin with no jmp_buf needs no
+	 * per-level state - there is nothing to longjmp to on abort and all
+	 * the other bookkeeping is shared with the outermost transaction
+	 * anyway - so it only bumps this counter instead of allocating a
+	 * tx_data entry.
+	 */
+	unsigned flat_nesting;
+
+	/*
+	 * Failure behaviors of the enclosing levels, saved when flattened
+	 * levels begin and restored when they end, so that a behavior set
+	 * inside a flattened level does not outlive it - just as with
+	 * jmp_buf-based nesting, where the inner tx_data is discarded.
+	 */
+	VEC(, enum pobj_tx_failure_behavior) flat_behaviors;
+
 	struct ravl *ranges;
 
+	/*
+	 * Ranges registered with POBJ_XADD_READ_ONLY, kept apart from the
+	 * write ranges - they are never snapshotted or flushed, only handed
+	 * to the read validator when the outermost transaction commits.
+	 */
+	struct ravl *read_ranges;
+	pmemobj_tx_read_validator read_validator;
+	void *read_validator_arg;
+
 	VEC(, struct pobj_action) actions;
 	VEC(, struct user_buffer_def) redo_userbufs;
 	size_t redo_userbufs_capacity;
@@ -43,6 +85,54 @@ struct tx {
 
 	int first_snapshot;
 
+	/*
+	 * Front cache of recently snapshotted ranges, consulted before
+	 * descending into the ranges tree.
+	 */
+	struct tx_range_def covered_cache[TX_COVERED_CACHE_SIZE];
+	unsigned covered_cache_next;
+
+	/*
+	 * Page-granular bitmap of fully snapshotted pages, allocated lazily
+	 * when a snapshot first covers a whole page. A set bit means the
+	 * entire page is already in the undo log and will be flushed on
+	 * commit, so adds falling inside it can be skipped without touching
+	 * the ranges tree.
+	 */
+	uint64_t *snapshot_pages;
+	size_t snapshot_pages_nbits;
+
+	/*
+	 * Lane of a committed transaction whose log cleanup was deferred
+	 * by pmemobj_tx_commit_async(), along with its pool. The lane is
+	 * still held and must be released on this thread.
+	 */
+	struct lane *deferred_lane;
+	PMEMobjpool *deferred_pop;
+
+	/*
+	 * State of a transaction coupled with a second pool, started with
+	 * pmemobj_tx_begin_multi(). The held lane of the secondary pool
+	 * carries the undo log for the ranges snapshotted there, which are
+	 * tracked in multi_ranges so that later adds do not re-snapshot
+	 * memory the transaction has already modified. The txid ties the
+	 * commit records of the two pools together.
+	 */
+	PMEMobjpool *multi_pop;
+	struct lane *multi_lane;
+	uint64_t multi_lane_idx;
+	VEC(, struct tx_range_def) multi_ranges;
+	uint64_t multi_txid;
+
+	/*
+	 * Resource usage counters, reset when the outermost transaction
+	 * starts. The undo log counters are deltas against the lane's
+	 * operation context and are folded in before the lane is released.
+	 */
+	struct pobj_tx_stats stats;
+	size_t undo_extend_base;
+	size_t undo_flush_base;
+
 	void *user_data;
 };
 
@@ -79,12 +169,6 @@ struct tx_alloc_args {
 #define ALLOC_ARGS(flags)\
 (struct tx_alloc_args){flags, NULL, 0}
 
-struct tx_range_def {
-	uint64_t offset;
-	uint64_t size;
-	uint64_t flags;
-};
-
 /*
  * tx_range_def_cmp -- compares two snapshot ranges
  */
@@ -114,6 +198,16 @@ tx_params_new(void)
 		return NULL;
 
 	tx_params->cache_size = TX_DEFAULT_RANGE_CACHE_SIZE;
+	tx_params->log_size = 0;
+	tx_params->big_lanes = 0;
+	tx_params->big_log_size = 0;
+
+	tx_params->group_commit = 0;
+	util_mutex_init(&tx_params->gc_lock);
+	util_cond_init(&tx_params->gc_cond);
+	tx_params->gc_requested = 0;
+	tx_params->gc_completed = 0;
+	tx_params->gc_leader = 0;
 
 	return tx_params;
 }
@@ -124,6 +218,8 @@ tx_params_new(void)
 void
 tx_params_delete(struct tx_parameters *tx_params)
 {
+	util_cond_destroy(&tx_params->gc_cond);
+	util_mutex_destroy(&tx_params->gc_lock);
 	Free(tx_params);
 }
 
@@ -231,6 +327,9 @@ constructor_tx_alloc(void *ctx, void *ptr, size_t usable_size, void *arg)
 
 	if (args->flags & POBJ_FLAG_ZERO)
 		memset(ptr, 0, usable_size);
+	else if (args->flags & POBJ_FLAG_GENERATION)
+		memset((char *)ptr + usable_size - sizeof(uint64_t), 0,
+			sizeof(uint64_t));
 
 	if (args->copy_ptr && args->copy_size != 0) {
 		memcpy(ptr, args->copy_ptr, args->copy_size);
@@ -401,19 +500,151 @@ tx_abort_set(PMEMobjpool *pop, struct lane *lane)
 }
 
 /*
- * tx_flush_range -- (internal) flush one range
+ * tx_multi_release -- (internal) releases a pool's coupled-transaction claim
+ */
+static void
+tx_multi_release(PMEMobjpool *pop)
+{
+	if (!util_bool_compare_and_swap64(&pop->multi_in_flight, 1, 0))
+		CORE_LOG_FATAL("util_bool_compare_and_swap64");
+}
+
+/*
+ * tx_multi_abort -- (internal) rolls back and releases the secondary pool of
+ *	a coupled transaction
+ *
+ * The gate of the secondary pool is only armed during commit, so an abort
+ * has nothing to disarm - the undo log is simply applied and retired the
+ * same way the primary's is.
+ */
+static void
+tx_multi_abort(struct tx *tx)
+{
+	PMEMobjpool *pop2 = tx->multi_pop;
+
+	ulog_foreach_entry((struct ulog *)&tx->multi_lane->layout->undo,
+		tx_undo_entry_apply, NULL, &pop2->p_ops);
+	pmemops_drain(&pop2->p_ops);
+	operation_finish(tx->multi_lane->undo, ULOG_INC_FIRST_GEN_NUM);
+
+	lane_release(pop2);
+
+	tx_multi_release(tx->pop);
+	tx_multi_release(pop2);
+
+	VEC_DELETE(&tx->multi_ranges);
+	tx->multi_pop = NULL;
+	tx->multi_lane = NULL;
+}
+
+/*
+ * tx_multi_pre_commit -- (internal) makes the secondary pool's new data
+ *	durable and gates its undo log on the primary's commit record
+ *
+ * Once the gate is persistent, the fate of the secondary pool is decided
+ * solely by whether the primary's commit record ends up holding this
+ * transaction's txid - which it does atomically with the primary commit,
+ * through the redo log entry set up in pmemobj_tx_begin_multi().
+ */
+static void
+tx_multi_pre_commit(struct tx *tx)
+{
+	PMEMobjpool *pop2 = tx->multi_pop;
+
+	struct tx_range_def *r;
+	VEC_FOREACH_BY_PTR(r, &tx->multi_ranges) {
+		if (!(r->flags & POBJ_XADD_NO_FLUSH))
+			pmemops_xflush(&pop2->p_ops,
+				OBJ_OFF_TO_PTR(pop2, r->offset), r->size,
+				PMEMOBJ_F_RELAXED);
+	}
+
+	pop2->multi_commit.gate_peer = tx->pop->uuid_lo;
+	pop2->multi_commit.gate_lane = tx->multi_lane_idx;
+	pmemops_persist(&pop2->p_ops, &pop2->multi_commit.gate_peer,
+		sizeof(pop2->multi_commit.gate_peer) +
+		sizeof(pop2->multi_commit.gate_lane));
+
+	/* the txid arms the gate, it must become durable last */
+	pop2->multi_commit.gate_txid = tx->multi_txid;
+	pmemops_persist(&pop2->p_ops, &pop2->multi_commit.gate_txid,
+		sizeof(pop2->multi_commit.gate_txid));
+}
+
+/*
+ * tx_multi_post_commit -- (internal) retires the secondary pool's undo log
+ *	and disarms the gate after the primary has committed
+ */
+static void
+tx_multi_post_commit(struct tx *tx)
+{
+	PMEMobjpool *pop2 = tx->multi_pop;
+
+	operation_finish(tx->multi_lane->undo, ULOG_INC_FIRST_GEN_NUM);
+
+	pop2->multi_commit.gate_txid = 0;
+	pmemops_persist(&pop2->p_ops, &pop2->multi_commit.gate_txid,
+		sizeof(pop2->multi_commit.gate_txid));
+
+	lane_release(pop2);
+
+	tx_multi_release(tx->pop);
+	tx_multi_release(pop2);
+
+	VEC_DELETE(&tx->multi_ranges);
+	tx->multi_pop = NULL;
+	tx->multi_lane = NULL;
+}
+
+/*
+ * tx_flush_ctx -- (internal) state of the coalesced commit-time flush
+ */
+struct tx_flush_ctx {
+	PMEMobjpool *pop;
+	uint64_t offset; /* cacheline-aligned start of the pending flush */
+	uint64_t size; /* its length, 0 when no flush is pending */
+	uint64_t nflushes; /* number of flushes issued so far */
+};
+
+/*
+ * tx_flush_range -- (internal) flush one range, coalesced with its neighbors
+ *
+ * The ranges tree is traversed in offset order and flushing operates on whole
+ * cachelines anyway, so instead of flushing every range separately, which
+ * would hit the same cachelines repeatedly for ranges within one struct, each
+ * range only extends the pending flush for as long as no cacheline in between
+ * would be flushed needlessly. The last pending flush is issued by the caller.
  */
 static void
 tx_flush_range(void *data, void *ctx)
 {
-	PMEMobjpool *pop = ctx;
+	struct tx_flush_ctx *f = ctx;
+	PMEMobjpool *pop = f->pop;
 	struct tx_range_def *range = data;
-	if (!(range->flags & POBJ_FLAG_NO_FLUSH)) {
-		pmemops_xflush(&pop->p_ops, OBJ_OFF_TO_PTR(pop, range->offset),
-				range->size, PMEMOBJ_F_RELAXED);
-	}
+
 	VALGRIND_REMOVE_FROM_TX(OBJ_OFF_TO_PTR(pop, range->offset),
 		range->size);
+
+	if (range->flags & POBJ_FLAG_NO_FLUSH)
+		return;
+
+	uint64_t begin = ALIGN_DOWN(range->offset, CACHELINE_SIZE);
+	uint64_t end = ALIGN_UP(range->offset + range->size, CACHELINE_SIZE);
+
+	if (f->size != 0 && begin <= f->offset + f->size) {
+		if (end > f->offset + f->size)
+			f->size = end - f->offset;
+		return;
+	}
+
+	if (f->size != 0) {
+		pmemops_xflush(&pop->p_ops, OBJ_OFF_TO_PTR(pop, f->offset),
+				f->size, PMEMOBJ_F_RELAXED);
+		f->nflushes++;
+	}
+
+	f->offset = begin;
+	f->size = end - begin;
 }
 
 /*
@@ -429,6 +660,22 @@ tx_clean_range(void *data, void *ctx)
 	VALGRIND_SET_CLEAN(OBJ_OFF_TO_PTR(pop, range->offset), range->size);
 }
 
+/*
+ * tx_fold_undo_stats -- (internal) folds the undo log counters of the held
+ *	lane into the transaction statistics
+ */
+static void
+tx_fold_undo_stats(struct tx *tx)
+{
+	size_t extends = operation_get_extend_count(tx->lane->undo);
+	size_t flushes = operation_get_flush_count(tx->lane->undo);
+
+	tx->stats.ulog_extensions += extends - tx->undo_extend_base;
+	tx->stats.flushes += flushes - tx->undo_flush_base;
+	tx->undo_extend_base = extends;
+	tx->undo_flush_base = flushes;
+}
+
 /*
  * tx_pre_commit -- (internal) do pre-commit operations
  */
@@ -437,9 +684,23 @@ tx_pre_commit(struct tx *tx)
 {
 	LOG(5, NULL);
 
+	struct tx_flush_ctx f = {tx->pop, 0, 0, 0};
+
 	/* Flush all regions and destroy the whole tree. */
-	ravl_delete_cb(tx->ranges, tx_flush_range, tx->pop);
+	ravl_delete_cb(tx->ranges, tx_flush_range, &f);
 	tx->ranges = NULL;
+
+	if (f.size != 0) {
+		pmemops_xflush(&tx->pop->p_ops,
+				OBJ_OFF_TO_PTR(tx->pop, f.offset),
+				f.size, PMEMOBJ_F_RELAXED);
+		f.nflushes++;
+	}
+
+	tx->stats.flushes += f.nflushes;
+
+	ravl_delete(tx->read_ranges);
+	tx->read_ranges = NULL;
 }
 
 /*
@@ -458,6 +719,9 @@ tx_abort(PMEMobjpool *pop, struct lane *lane)
 	palloc_cancel(&pop->heap,
 		VEC_ARR(&tx->actions), VEC_SIZE(&tx->actions));
 	tx->ranges = NULL;
+
+	ravl_delete(tx->read_ranges);
+	tx->read_ranges = NULL;
 }
 
 /*
@@ -586,7 +850,7 @@ tx_alloc_common(struct tx *tx, size_t size, type_num_t type_num,
 	LOG(3, NULL);
 
 	if (size > PMEMOBJ_MAX_ALLOC_SIZE) {
-		ERR_WO_ERRNO("requested size too large");
+		ERR_DEFER_WO_ERRNO("requested size too large");
 		return obj_tx_fail_null(ENOMEM, args.flags);
 	}
 
@@ -596,8 +860,15 @@ tx_alloc_common(struct tx *tx, size_t size, type_num_t type_num,
 	if (action == NULL)
 		return obj_tx_fail_null(ENOMEM, args.flags);
 
-	if (palloc_reserve(&pop->heap, size, constructor, &args, type_num, 0,
-		CLASS_ID_FROM_FLAG(args.flags),
+	uint16_t object_flags = 0;
+	if (args.flags & POBJ_FLAG_GENERATION) {
+		/* the generation counter lives past the usable space */
+		size += sizeof(uint64_t);
+		object_flags |= OBJ_GENERATION_MASK;
+	}
+
+	if (palloc_reserve(&pop->heap, size, constructor, &args, type_num,
+		object_flags, CLASS_ID_FROM_FLAG(args.flags),
 		ARENA_ID_FROM_FLAG(args.flags), action) != 0)
 		goto err_oom;
 
@@ -615,7 +886,7 @@ tx_alloc_common(struct tx *tx, size_t size, type_num_t type_num,
 
 err_oom:
 	tx_action_remove(tx);
-	ERR_WO_ERRNO("out of memory");
+	ERR_DEFER_WO_ERRNO("out of memory");
 	return obj_tx_fail_null(ENOMEM, args.flags);
 }
 
@@ -631,7 +902,7 @@ tx_realloc_common(struct tx *tx, PMEMoid oid, size_t size, uint64_t type_num,
 	LOG(3, NULL);
 
 	if (size > PMEMOBJ_MAX_ALLOC_SIZE) {
-		ERR_WO_ERRNO("requested size too large");
+		ERR_DEFER_WO_ERRNO("requested size too large");
 		return obj_tx_fail_null(ENOMEM, flags);
 	}
 
@@ -722,16 +993,74 @@ err:
 }
 
 /*
- * pmemobj_tx_begin -- initializes new transaction
+ * tx_deferred_commit_complete -- (internal) finishes the log cleanup of a
+ *	commit deferred by pmemobj_tx_commit_async() and releases the lane
  */
-int
-pmemobj_tx_begin(PMEMobjpool *pop, jmp_buf env, ...)
+static void
+tx_deferred_commit_complete(struct tx *tx)
+{
+	if (tx->deferred_lane == NULL)
+		return;
+
+	operation_finish(tx->deferred_lane->undo, 0);
+
+	lane_release(tx->deferred_pop);
+
+	tx->deferred_lane = NULL;
+	tx->deferred_pop = NULL;
+}
+
+/*
+ * tx_switch_to_big_lane -- (internal) moves a TX_PARAM_LARGE transaction
+ *	onto a lane of the class reserved for large transactions
+ *
+ * The regular lane was already held by the time the parameters were
+ * parsed, so it is dropped and a lane from the reserved class is taken
+ * instead, pre-sized to the configured undo log capacity. The capacity
+ * sticks to the lane between transactions, so once the class is warmed
+ * up, large transactions stop extending their logs mid-flight - and
+ * never allocate from under the small ones.
+ */
+static void
+tx_switch_to_big_lane(struct tx *tx)
+{
+	PMEMobjpool *pop = tx->pop;
+
+	if (pop->tx_params->big_lanes == 0)
+		return;
+
+	operation_cancel(tx->lane->undo);
+	lane_release(pop);
+
+	lane_hold_big(pop, &tx->lane);
+	operation_start(tx->lane->undo);
+
+	size_t log_size = pop->tx_params->big_log_size;
+	if (log_size != 0 &&
+	    operation_reserve(tx->lane->undo, log_size) != 0)
+		CORE_LOG_WARNING("unable to pre-size the transaction log");
+
+	tx->undo_extend_base = operation_get_extend_count(tx->lane->undo);
+	tx->undo_flush_base = operation_get_flush_count(tx->lane->undo);
+}
+
+/*
+ * obj_tx_begin_common -- (internal) initializes new transaction, with the
+ *	variadic parameters of pmemobj_tx_begin() already collected
+ */
+static int
+obj_tx_begin_common(PMEMobjpool *pop, jmp_buf env, va_list argp)
 {
 	LOG(3, NULL);
 
 	int err = 0;
+	int flatten = 0;
+	int large = 0;
 	struct tx *tx = get_tx();
 
+	/* only an outermost transaction can pick its lane class */
+	int fresh = tx->stage == TX_STAGE_NONE;
+
 	enum pobj_tx_failure_behavior failure_behavior = POBJ_TX_FAILURE_ABORT;
 
 	if (tx->stage == TX_STAGE_WORK) {
@@ -745,13 +1074,39 @@ pmemobj_tx_begin(PMEMobjpool *pop, jmp_buf env, ...)
 		struct tx_data *txd = PMDK_SLIST_FIRST(&tx->tx_entries);
 		failure_behavior = txd->failure_behavior;
 
+		/*
+		 * A nested level with no jmp_buf is flattened into the
+		 * enclosing one, so it shares the failure behavior of the
+		 * enclosing level for its whole duration.
+		 */
+		if (env == NULL)
+			flatten = 1;
+
 		VALGRIND_START_TX;
 	} else if (tx->stage == TX_STAGE_NONE) {
 		VALGRIND_START_TX;
 
+		/*
+		 * The previous transaction on this thread might still own
+		 * the lane, finish its deferred cleanup first.
+		 */
+		tx_deferred_commit_complete(tx);
+
 		lane_hold(pop, &tx->lane);
 		operation_start(tx->lane->undo);
 
+		/*
+		 * Pre-size the undo log so that long transactions do not
+		 * have to extend it mid-flight. If the reservation fails
+		 * the transaction can still proceed, extending the log on
+		 * demand as before.
+		 */
+		if (pop->tx_params->log_size != 0 &&
+		    operation_reserve(tx->lane->undo,
+		    pop->tx_params->log_size) != 0)
+			CORE_LOG_WARNING(
+				"unable to pre-size the transaction log");
+
 		VEC_INIT(&tx->actions);
 		VEC_INIT(&tx->redo_userbufs);
 		tx->redo_userbufs_capacity = 0;
@@ -760,39 +1115,67 @@ pmemobj_tx_begin(PMEMobjpool *pop, jmp_buf env, ...)
 
 		tx->ranges = ravl_new_sized(tx_range_def_cmp,
 			sizeof(struct tx_range_def));
+		tx->read_ranges = ravl_new_sized(tx_range_def_cmp,
+			sizeof(struct tx_range_def));
+		tx->read_validator = NULL;
+		tx->read_validator_arg = NULL;
 
 		tx->pop = pop;
 
+		tx->flat_nesting = 0;
+		VEC_INIT(&tx->flat_behaviors);
+
 		tx->first_snapshot = 1;
 
+		memset(tx->covered_cache, 0, sizeof(tx->covered_cache));
+		tx->covered_cache_next = 0;
+
+		memset(&tx->stats, 0, sizeof(tx->stats));
+		tx->undo_extend_base =
+			operation_get_extend_count(tx->lane->undo);
+		tx->undo_flush_base =
+			operation_get_flush_count(tx->lane->undo);
+
+		tx->multi_pop = NULL;
+		tx->multi_lane = NULL;
+		tx->multi_txid = 0;
+
 		tx->user_data = NULL;
 	} else {
 		CORE_LOG_FATAL("Invalid stage %d to begin new transaction",
 			tx->stage);
 	}
 
-	struct tx_data *txd = Malloc(sizeof(*txd));
-	if (txd == NULL) {
-		err = errno;
-		ERR_W_ERRNO("Malloc");
-		goto err_abort;
-	}
+	if (flatten) {
+		/* the enclosing level's behavior is restored at level end */
+		if (VEC_PUSH_BACK(&tx->flat_behaviors, failure_behavior)) {
+			err = errno;
+			ERR_W_ERRNO("VEC_PUSH_BACK");
+			goto err_abort;
+		}
+		tx->flat_nesting++;
+	} else {
+		struct tx_data *txd = Malloc(sizeof(*txd));
+		if (txd == NULL) {
+			err = errno;
+			ERR_W_ERRNO("Malloc");
+			goto err_abort;
+		}
 
-	tx->last_errnum = 0;
-	if (env != NULL)
-		memcpy(txd->env, env, sizeof(jmp_buf));
-	else
-		memset(txd->env, 0, sizeof(jmp_buf));
+		if (env != NULL)
+			memcpy(txd->env, env, sizeof(jmp_buf));
+		else
+			memset(txd->env, 0, sizeof(jmp_buf));
 
-	txd->failure_behavior = failure_behavior;
+		txd->failure_behavior = failure_behavior;
 
-	PMDK_SLIST_INSERT_HEAD(&tx->tx_entries, txd, tx_entry);
+		PMDK_SLIST_INSERT_HEAD(&tx->tx_entries, txd, tx_entry);
+	}
 
+	tx->last_errnum = 0;
 	tx->stage = TX_STAGE_WORK;
 
 	/* handle locks */
-	va_list argp;
-	va_start(argp, env);
 	enum pobj_tx_param param_type;
 
 	while ((param_type = va_arg(argp, enum pobj_tx_param)) !=
@@ -813,16 +1196,18 @@ pmemobj_tx_begin(PMEMobjpool *pop, jmp_buf env, ...)
 
 			tx->stage_callback = cb;
 			tx->stage_callback_arg = arg;
+		} else if (param_type == TX_PARAM_LARGE) {
+			large = 1;
 		} else {
 			err = add_to_tx_and_lock(tx, param_type,
 				va_arg(argp, void *));
-			if (err) {
-				va_end(argp);
+			if (err)
 				goto err_abort;
-			}
 		}
 	}
-	va_end(argp);
+
+	if (large && fresh)
+		tx_switch_to_big_lane(tx);
 
 	ASSERT(err == 0);
 	return 0;
@@ -835,6 +1220,158 @@ err_abort:
 	return err;
 }
 
+/*
+ * pmemobj_tx_begin -- initializes new transaction
+ */
+int
+pmemobj_tx_begin(PMEMobjpool *pop, jmp_buf env, ...)
+{
+	va_list argp;
+	va_start(argp, env);
+	int ret = obj_tx_begin_common(pop, env, argp);
+	va_end(argp);
+
+	return ret;
+}
+
+/* sequence number making the coupled-transaction ids unique within a run */
+static uint64_t Multi_txid_next;
+
+/*
+ * pmemobj_tx_multi_recover -- settles the coupled transaction a crash left
+ *	gated in 'pop' against the commit record of its primary pool 'peer'
+ *
+ * Returns 0 when nothing is gated or the gate was resolved; fails when the
+ * gated transaction belongs to a different peer pool.
+ */
+int
+pmemobj_tx_multi_recover(PMEMobjpool *pop, PMEMobjpool *peer)
+{
+	LOG(3, "pop %p peer %p", pop, peer);
+
+	if (pop->multi_commit.gate_txid == 0)
+		return 0;
+
+	if (peer == NULL || pop->multi_commit.gate_peer != peer->uuid_lo) {
+		ERR_WO_ERRNO(
+			"pool gated by a coupled transaction with a different peer");
+		errno = EINVAL;
+		return -1;
+	}
+
+	int committed = peer->multi_commit.committed_txid ==
+		pop->multi_commit.gate_txid;
+
+	lane_gated_resolve(pop, committed);
+
+	return 0;
+}
+
+/*
+ * pmemobj_tx_begin_multi -- initializes a new transaction coupled with a
+ *	second pool
+ *
+ * Ranges of both pools may be added to such a transaction and either all of
+ * them or none become durable, decided by a single atomic commit record in
+ * the primary pool - no ordering between the pools has to be enforced by
+ * the application. The secondary pool contributes snapshots only;
+ * allocations, locks and the read validator stay with the primary. A pool
+ * can be part of one coupled transaction at a time, and a transaction a
+ * crash left undecided is settled against the peer before the new one
+ * starts.
+ */
+int
+pmemobj_tx_begin_multi(PMEMobjpool *pop, PMEMobjpool *pop2, jmp_buf env, ...)
+{
+	LOG(3, NULL);
+
+	struct tx *tx = get_tx();
+
+	if (tx->stage != TX_STAGE_NONE) {
+		ERR_WO_ERRNO("coupled transaction must be outermost");
+		errno = EINVAL;
+		return EINVAL;
+	}
+
+	if (pop2 == NULL || pop2 == pop) {
+		ERR_WO_ERRNO("invalid secondary pool");
+		errno = EINVAL;
+		return EINVAL;
+	}
+
+	/*
+	 * A pool can take part in only one coupled transaction at a time -
+	 * the commit records in multi_commit are per pool. Claim both pools
+	 * up front, so that a concurrent pmemobj_tx_begin_multi fails
+	 * instead of overwriting the records of a transaction in flight.
+	 */
+	if (!util_bool_compare_and_swap64(&pop->multi_in_flight, 0, 1)) {
+		ERR_WO_ERRNO(
+			"a coupled transaction already involves the pool");
+		errno = EBUSY;
+		return EBUSY;
+	}
+
+	if (!util_bool_compare_and_swap64(&pop2->multi_in_flight, 0, 1)) {
+		tx_multi_release(pop);
+		ERR_WO_ERRNO(
+			"a coupled transaction already involves the secondary pool");
+		errno = EBUSY;
+		return EBUSY;
+	}
+
+	/* settle anything a crash left between these two pools */
+	if (pmemobj_tx_multi_recover(pop, pop2) != 0 ||
+	    pmemobj_tx_multi_recover(pop2, pop) != 0) {
+		int err = errno;
+		tx_multi_release(pop);
+		tx_multi_release(pop2);
+		return err;
+	}
+
+	va_list argp;
+	va_start(argp, env);
+	int err = obj_tx_begin_common(pop, env, argp);
+	va_end(argp);
+	if (err) {
+		tx_multi_release(pop);
+		tx_multi_release(pop2);
+		return err;
+	}
+
+	tx->multi_lane_idx = lane_hold(pop2, &tx->multi_lane);
+	operation_start(tx->multi_lane->undo);
+
+	VEC_INIT(&tx->multi_ranges);
+	tx->multi_pop = pop2;
+
+	/*
+	 * The txid only has to differ from whatever the pools may still
+	 * hold in their commit records from earlier runs, so it mixes the
+	 * primary's run_id with a per-run sequence number.
+	 */
+	tx->multi_txid = (pop->run_id << 20) +
+		util_fetch_and_add64(&Multi_txid_next, 1) + 1;
+	if (tx->multi_txid == 0)
+		tx->multi_txid = 1;
+
+	/*
+	 * The commit record of the primary is set through the redo log, so
+	 * the verdict on the coupled transaction becomes durable atomically
+	 * with the primary commit itself.
+	 */
+	struct pobj_action *action = tx_action_add(tx);
+	if (action == NULL) {
+		obj_tx_abort(ENOMEM, 0);
+		return ENOMEM;
+	}
+
+	palloc_set_value(&pop->heap, action,
+		&pop->multi_commit.committed_txid, tx->multi_txid);
+
+	return 0;
+}
+
 /*
  * tx_abort_on_failure_flag -- (internal) return 0 or POBJ_FLAG_TX_NO_ABORT
  * based on transaction setting
@@ -895,7 +1432,7 @@ obj_tx_callback(struct tx *tx)
 	struct tx_data *txd = PMDK_SLIST_FIRST(&tx->tx_entries);
 
 	/* is this the outermost transaction? */
-	if (PMDK_SLIST_NEXT(txd, tx_entry) == NULL)
+	if (tx->flat_nesting == 0 && PMDK_SLIST_NEXT(txd, tx_entry) == NULL)
 		tx->stage_callback(tx->pop, tx->stage, tx->stage_callback_arg);
 }
 
@@ -930,12 +1467,22 @@ obj_tx_abort(int errnum, int user)
 	tx->stage = TX_STAGE_ONABORT;
 	struct tx_data *txd = PMDK_SLIST_FIRST(&tx->tx_entries);
 
-	if (PMDK_SLIST_NEXT(txd, tx_entry) == NULL) {
+	if (tx->flat_nesting == 0 &&
+	    PMDK_SLIST_NEXT(txd, tx_entry) == NULL) {
 		/* this is the outermost transaction */
 
+		tx_fold_undo_stats(tx);
+
 		/* process the undo log */
 		tx_abort(tx->pop, tx->lane);
 
+		if (tx->multi_pop != NULL)
+			tx_multi_abort(tx);
+
+		struct lane_tx_stats *txs = &tx->lane->tx_stats;
+		txs->aborts++;
+		txs->bytes_logged += tx->stats.snapshot_bytes;
+
 		lane_release(tx->pop);
 		tx->lane = NULL;
 	}
@@ -947,7 +1494,13 @@ obj_tx_abort(int errnum, int user)
 	/* ONABORT */
 	obj_tx_callback(tx);
 
-	if (!util_is_zeroed(txd->env, sizeof(jmp_buf)))
+	/*
+	 * A flattened level was begun with no jmp_buf, so the env at the
+	 * head of the list belongs to an enclosing level and must not be
+	 * jumped to until the error waterfalls down to it.
+	 */
+	if (tx->flat_nesting == 0 &&
+	    !util_is_zeroed(txd->env, sizeof(jmp_buf)))
 		longjmp(txd->env, errnum);
 }
 
@@ -982,19 +1535,100 @@ tx_post_commit(struct tx *tx)
 }
 
 /*
- * pmemobj_tx_commit -- commits current transaction
+ * tx_group_drain -- (internal) the ordering point between flushing the
+ *	transaction's ranges and publishing the redo log
+ *
+ * With group commit enabled, concurrently committing threads rendezvous here
+ * and a single leader issues one drain on behalf of the whole batch. Each
+ * thread takes a ticket under the lock, after its flushes, so a drain whose
+ * batch was snapshotted at or past that ticket is known to have started only
+ * once the thread's stores were flushed. Threads whose ticket was missed by
+ * an in-flight drain either promote themselves to lead the next batch or
+ * wait for another arriving thread to do so.
  */
-void
-pmemobj_tx_commit(void)
+static void
+tx_group_drain(PMEMobjpool *pop)
 {
-	LOG(3, NULL);
+	struct tx_parameters *params = pop->tx_params;
 
-	PMEMOBJ_API_START();
-	struct tx *tx = get_tx();
+	if (!params->group_commit) {
+		pmemops_drain(&pop->p_ops);
+		return;
+	}
 
-	ASSERT_IN_TX(tx);
-	ASSERT_TX_STAGE_WORK(tx);
+	util_mutex_lock(&params->gc_lock);
+
+	uint64_t ticket = ++params->gc_requested;
+
+	while (params->gc_completed < ticket) {
+		if (!params->gc_leader) {
+			/* drain on behalf of everyone registered so far */
+			params->gc_leader = 1;
+			uint64_t batch = params->gc_requested;
+			util_mutex_unlock(&params->gc_lock);
+
+			pmemops_drain(&pop->p_ops);
+
+			util_mutex_lock(&params->gc_lock);
+			params->gc_completed = batch;
+			params->gc_leader = 0;
+			os_cond_broadcast(&params->gc_cond);
+		} else {
+			os_cond_wait(&params->gc_cond, &params->gc_lock);
+		}
+	}
+
+	util_mutex_unlock(&params->gc_lock);
+}
+
+struct tx_read_validate_ctx {
+	struct tx *tx;
+	int invalid;
+};
+
+/*
+ * tx_validate_read_range -- (internal) hands a single read-set range over to
+ *	the registered validator
+ */
+static void
+tx_validate_read_range(void *data, void *ctx)
+{
+	struct tx_read_validate_ctx *v = ctx;
+	struct tx_range_def *range = data;
+	struct tx *tx = v->tx;
+
+	if (v->invalid)
+		return;
 
+	if (tx->read_validator(tx->pop,
+	    OBJ_OFF_TO_PTR(tx->pop, range->offset), range->size,
+	    tx->read_validator_arg) != 0)
+		v->invalid = 1;
+}
+
+/*
+ * tx_read_set_invalid -- (internal) runs the registered read validator over
+ *	all ranges added with POBJ_XADD_READ_ONLY
+ */
+static int
+tx_read_set_invalid(struct tx *tx)
+{
+	if (tx->read_validator == NULL)
+		return 0;
+
+	struct tx_read_validate_ctx v = {tx, 0};
+	ravl_foreach(tx->read_ranges, tx_validate_read_range, &v);
+
+	return v.invalid;
+}
+
+/*
+ * tx_commit_common -- (internal) commits the current transaction, optionally
+ *	deferring the undo log cleanup until tx_deferred_commit_complete()
+ */
+static void
+tx_commit_common(struct tx *tx, int defer_cleanup)
+{
 	/* WORK */
 	obj_tx_callback(tx);
 
@@ -1002,15 +1636,34 @@ pmemobj_tx_commit(void)
 
 	struct tx_data *txd = PMDK_SLIST_FIRST(&tx->tx_entries);
 
-	if (PMDK_SLIST_NEXT(txd, tx_entry) == NULL) {
+	if (tx->flat_nesting == 0 &&
+	    PMDK_SLIST_NEXT(txd, tx_entry) == NULL) {
 		/* this is the outermost transaction */
 
 		PMEMobjpool *pop = tx->pop;
 
+		struct timespec commit_start;
+		int record_latency = pop->stats->tx_latency_recording;
+		if (record_latency)
+			os_clock_gettime(CLOCK_MONOTONIC, &commit_start);
+
+		/*
+		 * Let the application validate its read-set before any of
+		 * the changes are made durable. A conflict turns the commit
+		 * into an abort.
+		 */
+		if (tx_read_set_invalid(tx)) {
+			obj_tx_abort(ECANCELED, 0);
+			return;
+		}
+
 		/* pre-commit phase */
 		tx_pre_commit(tx);
 
-		pmemops_drain(&pop->p_ops);
+		if (tx->multi_pop != NULL)
+			tx_multi_pre_commit(tx);
+
+		tx_group_drain(pop);
 
 		operation_start(tx->lane->external);
 
@@ -1021,9 +1674,48 @@ pmemobj_tx_commit(void)
 		palloc_publish(&pop->heap, VEC_ARR(&tx->actions),
 			VEC_SIZE(&tx->actions), tx->lane->external);
 
-		tx_post_commit(tx);
+		/*
+		 * The primary's commit record now holds this transaction's
+		 * txid, the secondary's gate can be disarmed.
+		 */
+		if (tx->multi_pop != NULL)
+			tx_multi_post_commit(tx);
+
+		tx_fold_undo_stats(tx);
+
+		/* the transaction is durable - account it to the lane */
+		struct lane_tx_stats *txs = &tx->lane->tx_stats;
+		txs->commits++;
+		txs->bytes_logged += tx->stats.snapshot_bytes;
+
+		if (record_latency) {
+			struct timespec now;
+			os_clock_gettime(CLOCK_MONOTONIC, &now);
+			uint64_t ns = (uint64_t)((now.tv_sec -
+				commit_start.tv_sec) * 1000000000LL +
+				(now.tv_nsec - commit_start.tv_nsec));
+
+			size_t bucket = 0;
+			if (ns != 0)
+				bucket = (size_t)util_mssb_index64(ns) + 1;
+			if (bucket >= LANE_TX_LAT_BUCKETS)
+				bucket = LANE_TX_LAT_BUCKETS - 1;
+			txs->commit_ns[bucket]++;
+		}
+
+		/*
+		 * The transaction is durable at this point, what remains is
+		 * the maintenance of the undo log, which can be taken off
+		 * of the commit critical path.
+		 */
+		if (defer_cleanup) {
+			tx->deferred_lane = tx->lane;
+			tx->deferred_pop = pop;
+		} else {
+			tx_post_commit(tx);
 
-		lane_release(pop);
+			lane_release(pop);
+		}
 
 		tx->lane = NULL;
 	}
@@ -1032,6 +1724,68 @@ pmemobj_tx_commit(void)
 
 	/* ONCOMMIT */
 	obj_tx_callback(tx);
+}
+
+/*
+ * pmemobj_tx_commit -- commits current transaction
+ */
+void
+pmemobj_tx_commit(void)
+{
+	LOG(3, NULL);
+
+	PMEMOBJ_API_START();
+	struct tx *tx = get_tx();
+
+	ASSERT_IN_TX(tx);
+	ASSERT_TX_STAGE_WORK(tx);
+
+	tx_commit_common(tx, 0);
+
+	PMEMOBJ_API_END();
+}
+
+/*
+ * pmemobj_tx_commit_async -- commits current transaction, deferring the undo
+ *	log cleanup until pmemobj_tx_commit_complete()
+ *
+ * The transaction is durable once this function returns - only the log
+ * maintenance, which does not affect the outcome of the transaction, is
+ * taken off of the commit critical path. The deferred work is performed by
+ * pmemobj_tx_commit_complete(), or automatically at the beginning of the
+ * next transaction on this thread. The lane of the transaction stays held
+ * in the meantime, so the cleanup has to be completed on the same thread
+ * and before the pool is closed.
+ */
+void
+pmemobj_tx_commit_async(void)
+{
+	LOG(3, NULL);
+
+	PMEMOBJ_API_START();
+	struct tx *tx = get_tx();
+
+	ASSERT_IN_TX(tx);
+	ASSERT_TX_STAGE_WORK(tx);
+
+	tx_commit_common(tx, 1);
+
+	PMEMOBJ_API_END();
+}
+
+/*
+ * pmemobj_tx_commit_complete -- completes the deferred cleanup of a
+ *	transaction committed with pmemobj_tx_commit_async(), if any
+ */
+void
+pmemobj_tx_commit_complete(void)
+{
+	LOG(3, NULL);
+
+	PMEMOBJ_API_START();
+
+	tx_deferred_commit_complete(get_tx());
+
 	PMEMOBJ_API_END();
 }
 
@@ -1060,6 +1814,28 @@ pmemobj_tx_end(void)
 		obj_tx_callback(tx);
 	}
 
+	if (tx->flat_nesting > 0) {
+		/* a flattened level - just unwind the nesting counter */
+		tx->flat_nesting--;
+
+		/* restore the enclosing level's failure behavior */
+		struct tx_data *txd = PMDK_SLIST_FIRST(&tx->tx_entries);
+		txd->failure_behavior = VEC_BACK(&tx->flat_behaviors);
+		VEC_POP_BACK(&tx->flat_behaviors);
+
+		VALGRIND_END_TX;
+		int ret = tx->last_errnum;
+
+		/* resume the enclosing transaction */
+		tx->stage = TX_STAGE_WORK;
+
+		/* abort called within inner transaction, waterfall the error */
+		if (tx->last_errnum)
+			obj_tx_abort(tx->last_errnum, 0);
+
+		return ret;
+	}
+
 	struct tx_data *txd = PMDK_SLIST_FIRST(&tx->tx_entries);
 	PMDK_SLIST_REMOVE_HEAD(&tx->tx_entries, tx_entry);
 
@@ -1071,11 +1847,18 @@ pmemobj_tx_end(void)
 	if (PMDK_SLIST_EMPTY(&tx->tx_entries)) {
 		ASSERTeq(tx->lane, NULL);
 
+		stats_tx_histogram_record(tx->pop->stats,
+			tx->stats.snapshot_bytes);
+
 		release_and_free_tx_locks(tx);
 		tx->pop = NULL;
 		tx->stage = TX_STAGE_NONE;
 		VEC_DELETE(&tx->actions);
 		VEC_DELETE(&tx->redo_userbufs);
+		VEC_DELETE(&tx->flat_behaviors);
+		Free(tx->snapshot_pages);
+		tx->snapshot_pages = NULL;
+		tx->snapshot_pages_nbits = 0;
 
 		if (tx->stage_callback) {
 			pmemobj_tx_callback cb = tx->stage_callback;
@@ -1202,8 +1985,14 @@ pmemobj_tx_add_snapshot(struct tx *tx, struct tx_range_def *snapshot)
 		tx->first_snapshot = 0;
 	}
 
-	return operation_add_buffer(tx->lane->undo, ptr, ptr, snapshot->size,
-		ULOG_OPERATION_BUF_CPY);
+	int ret = operation_add_buffer(tx->lane->undo, ptr, ptr,
+		snapshot->size, ULOG_OPERATION_BUF_CPY);
+	if (ret == 0) {
+		tx->stats.snapshots++;
+		tx->stats.snapshot_bytes += snapshot->size;
+	}
+
+	return ret;
 }
 
 /*
@@ -1223,6 +2012,92 @@ pmemobj_tx_merge_flags(struct tx_range_def *dest, struct tx_range_def *merged)
 	}
 }
 
+/*
+ * tx_snapshot_pages_covered -- (internal) checks whether the range falls
+ *	entirely on pages that have already been fully snapshotted
+ */
+static int
+tx_snapshot_pages_covered(struct tx *tx, const struct tx_range_def *args)
+{
+	if (tx->snapshot_pages == NULL)
+		return 0;
+
+	size_t first = args->offset >> TX_SNAPSHOT_PAGE_SHIFT;
+	size_t last = (args->offset + args->size - 1) >>
+		TX_SNAPSHOT_PAGE_SHIFT;
+
+	if (last >= tx->snapshot_pages_nbits)
+		return 0;
+
+	for (size_t p = first; p <= last; ++p) {
+		if (!(tx->snapshot_pages[p / 64] & (1ULL << (p % 64))))
+			return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * tx_snapshot_pages_mark -- (internal) marks the pages fully covered by a
+ *	snapshotted range, allocating the bitmap on first use
+ *
+ * The bitmap is an optimization only - if the allocation fails the adds
+ * simply keep going through the ranges tree.
+ */
+static void
+tx_snapshot_pages_mark(struct tx *tx, const struct tx_range_def *args)
+{
+	/* pages whose flush might be skipped must not short-circuit adds */
+	if (args->flags & POBJ_XADD_NO_FLUSH)
+		return;
+
+	size_t first = (args->offset + TX_SNAPSHOT_PAGE_SIZE - 1) >>
+		TX_SNAPSHOT_PAGE_SHIFT;
+	size_t end = (args->offset + args->size) >> TX_SNAPSHOT_PAGE_SHIFT;
+
+	if (first >= end)
+		return;
+
+	if (tx->snapshot_pages == NULL) {
+		size_t nbits = (tx->pop->heap_offset + tx->pop->heap_size +
+			TX_SNAPSHOT_PAGE_SIZE - 1) >> TX_SNAPSHOT_PAGE_SHIFT;
+		uint64_t *map = Zalloc(((nbits + 63) / 64) *
+			sizeof(uint64_t));
+		if (map == NULL)
+			return;
+
+		tx->snapshot_pages = map;
+		tx->snapshot_pages_nbits = nbits;
+	}
+
+	for (size_t p = first; p < end; ++p)
+		tx->snapshot_pages[p / 64] |= 1ULL << (p % 64);
+}
+
+/*
+ * tx_snapshot_pages_clear -- (internal) clears every page overlapping a range
+ *	whose snapshot no longer covers it
+ *
+ * Unlike the marking, which rounds inward, this rounds outward - a page that
+ * lost any part of its coverage must go back through the ranges tree.
+ */
+static void
+tx_snapshot_pages_clear(struct tx *tx, const struct tx_range_def *args)
+{
+	if (tx->snapshot_pages == NULL)
+		return;
+
+	size_t first = args->offset >> TX_SNAPSHOT_PAGE_SHIFT;
+	size_t end = (args->offset + args->size + TX_SNAPSHOT_PAGE_SIZE - 1) >>
+		TX_SNAPSHOT_PAGE_SHIFT;
+
+	if (end > tx->snapshot_pages_nbits)
+		end = tx->snapshot_pages_nbits;
+
+	for (size_t p = first; p < end; ++p)
+		tx->snapshot_pages[p / 64] &= ~(1ULL << (p % 64));
+}
+
 /*
  * pmemobj_tx_add_common -- (internal) common code for adding persistent memory
  * into the transaction
@@ -1233,7 +2108,7 @@ pmemobj_tx_add_common(struct tx *tx, struct tx_range_def *args)
 	LOG(15, NULL);
 
 	if (args->size > PMEMOBJ_MAX_ALLOC_SIZE) {
-		ERR_WO_ERRNO("snapshot size too large");
+		ERR_DEFER_WO_ERRNO("snapshot size too large");
 		return obj_tx_fail_err(EINVAL, args->flags);
 	}
 
@@ -1244,6 +2119,51 @@ pmemobj_tx_add_common(struct tx *tx, struct tx_range_def *args)
 		return obj_tx_fail_err(EINVAL, args->flags);
 	}
 
+	if (args->flags & POBJ_XADD_READ_ONLY) {
+		/*
+		 * Read-set registration only - the range is not snapshotted
+		 * and does not interact with the write ranges. Overlapping
+		 * entries are harmless, only ranges starting at the same
+		 * offset are collapsed into one.
+		 */
+		struct ravl_node *n = ravl_find(tx->read_ranges, args,
+			RAVL_PREDICATE_EQUAL);
+		if (n != NULL) {
+			struct tx_range_def *f = ravl_data(n);
+			if (args->size > f->size)
+				f->size = args->size;
+			return 0;
+		}
+
+		if (ravl_emplace_copy(tx->read_ranges, args) != 0) {
+			ERR_DEFER_WO_ERRNO("out of memory");
+			return obj_tx_fail_err(ENOMEM, args->flags);
+		}
+
+		return 0;
+	}
+
+	/*
+	 * Repeatedly snapshotting the same small region, e.g. a counter
+	 * incremented many times within one transaction, is common enough
+	 * to warrant a constant-time check against recently added ranges
+	 * before descending into the tree. A cached range is known to be
+	 * fully covered, so the add can be skipped entirely, unless the
+	 * existing range might carry the no-flush flag that this add would
+	 * have to clear.
+	 */
+	for (unsigned i = 0; i < TX_COVERED_CACHE_SIZE; ++i) {
+		struct tx_range_def *c = &tx->covered_cache[i];
+		if (args->offset >= c->offset &&
+		    args->offset + args->size <= c->offset + c->size &&
+		    (!(c->flags & POBJ_XADD_NO_FLUSH) ||
+		    (args->flags & POBJ_XADD_NO_FLUSH)))
+			return 0;
+	}
+
+	if (tx_snapshot_pages_covered(tx, args))
+		return 0;
+
 	int ret = 0;
 
 	/*
@@ -1380,10 +2300,101 @@ pmemobj_tx_add_common(struct tx *tx, struct tx_range_def *args)
 	}
 
 	if (ret != 0) {
-		ERR_WO_ERRNO("out of memory");
+		ERR_DEFER_WO_ERRNO("out of memory");
 		return obj_tx_fail_err(ENOMEM, args->flags);
 	}
 
+	/* the requested range is now covered, remember it in the cache */
+	tx->covered_cache[tx->covered_cache_next++ %
+		TX_COVERED_CACHE_SIZE] = *args;
+
+	tx_snapshot_pages_mark(tx, args);
+
+	return 0;
+}
+
+/*
+ * tx_multi_add_range -- (internal) snapshots the parts of a secondary-pool
+ *	range that earlier snapshots do not cover yet
+ *
+ * A second copy of already snapshotted memory, taken mid-transaction, would
+ * be replayed over the original one on abort, so overlaps must be clipped
+ * away. The recursion is bounded by the number of tracked ranges.
+ */
+static int
+tx_multi_add_range(struct tx *tx, uint64_t offset, uint64_t size,
+	uint64_t flags)
+{
+	uint64_t end = offset + size;
+
+	struct tx_range_def *r;
+	VEC_FOREACH_BY_PTR(r, &tx->multi_ranges) {
+		if (offset >= r->offset + r->size || end <= r->offset)
+			continue;
+
+		/* keep only the parts this range does not cover */
+		int ret = 0;
+		if (offset < r->offset)
+			ret = tx_multi_add_range(tx, offset,
+				r->offset - offset, flags);
+		if (ret == 0 && end > r->offset + r->size)
+			ret = tx_multi_add_range(tx, r->offset + r->size,
+				end - (r->offset + r->size), flags);
+		return ret;
+	}
+
+	struct tx_range_def range = {offset, size, flags};
+	if (VEC_PUSH_BACK(&tx->multi_ranges, range) != 0)
+		return -1;
+
+	if (flags & POBJ_XADD_NO_SNAPSHOT)
+		return 0;
+
+	void *ptr = OBJ_OFF_TO_PTR(tx->multi_pop, offset);
+	int ret = operation_add_buffer(tx->multi_lane->undo, ptr, ptr, size,
+		ULOG_OPERATION_BUF_CPY);
+	if (ret == 0) {
+		tx->stats.snapshots++;
+		tx->stats.snapshot_bytes += size;
+	}
+
+	return ret;
+}
+
+/*
+ * tx_multi_add_common -- (internal) common code for adding a range of the
+ *	secondary pool into a coupled transaction
+ *
+ * The secondary is expected to contribute a handful of ranges per
+ * transaction, so they are tracked in a plain vector instead of the
+ * machinery the primary ranges get.
+ */
+static int
+tx_multi_add_common(struct tx *tx, uint64_t offset, uint64_t size,
+	uint64_t flags)
+{
+	LOG(15, NULL);
+
+	if (size == 0)
+		return 0;
+
+	if (size > PMEMOBJ_MAX_ALLOC_SIZE) {
+		ERR_DEFER_WO_ERRNO("snapshot size too large");
+		return obj_tx_fail_err(EINVAL, flags);
+	}
+
+	if (offset < tx->multi_pop->heap_offset ||
+	    offset + size > tx->multi_pop->heap_offset +
+	    tx->multi_pop->heap_size) {
+		ERR_WO_ERRNO("object outside of heap");
+		return obj_tx_fail_err(EINVAL, flags);
+	}
+
+	if (tx_multi_add_range(tx, offset, size, flags) != 0) {
+		ERR_DEFER_WO_ERRNO("out of memory");
+		return obj_tx_fail_err(ENOMEM, flags);
+	}
+
 	return 0;
 }
 
@@ -1407,6 +2418,14 @@ pmemobj_tx_add_range_direct(const void *ptr, size_t size)
 	uint64_t flags = tx_abort_on_failure_flag(tx);
 
 	if (!OBJ_PTR_FROM_POOL(tx->pop, ptr)) {
+		if (tx->multi_pop != NULL &&
+		    OBJ_PTR_FROM_POOL(tx->multi_pop, ptr)) {
+			ret = tx_multi_add_common(tx,
+				(uint64_t)((char *)ptr -
+				(char *)tx->multi_pop), size, flags);
+			PMEMOBJ_API_END();
+			return ret;
+		}
 		ERR_WO_ERRNO("object outside of pool");
 		ret = obj_tx_fail_err(EINVAL, flags);
 		PMEMOBJ_API_END();
@@ -1453,6 +2472,14 @@ pmemobj_tx_xadd_range_direct(const void *ptr, size_t size, uint64_t flags)
 	}
 
 	if (!OBJ_PTR_FROM_POOL(tx->pop, ptr)) {
+		if (tx->multi_pop != NULL &&
+		    OBJ_PTR_FROM_POOL(tx->multi_pop, ptr)) {
+			ret = tx_multi_add_common(tx,
+				(uint64_t)((char *)ptr -
+				(char *)tx->multi_pop), size, flags);
+			PMEMOBJ_API_END();
+			return ret;
+		}
 		ERR_WO_ERRNO("object outside of pool");
 		ret = obj_tx_fail_err(EINVAL, flags);
 		PMEMOBJ_API_END();
@@ -1471,6 +2498,192 @@ pmemobj_tx_xadd_range_direct(const void *ptr, size_t size, uint64_t flags)
 	return ret;
 }
 
+/*
+ * tx_add_range_direct_small -- (internal) common path of the size-specialized
+ *	range adds
+ *
+ * The size is a compile-time constant at every call site, so the covered
+ * cache check unrolls into straight-line code with no size-dependent
+ * branching; only a cache miss descends into the generic machinery.
+ */
+static inline int
+tx_add_range_direct_small(const void *ptr, size_t size)
+{
+	PMEMOBJ_API_START();
+	struct tx *tx = get_tx();
+
+	ASSERT_IN_TX(tx);
+	ASSERT_TX_STAGE_WORK(tx);
+
+	int ret;
+
+	uint64_t flags = tx_abort_on_failure_flag(tx);
+
+	if (!OBJ_PTR_FROM_POOL(tx->pop, ptr)) {
+		if (tx->multi_pop != NULL &&
+		    OBJ_PTR_FROM_POOL(tx->multi_pop, ptr)) {
+			ret = tx_multi_add_common(tx,
+				(uint64_t)((char *)ptr -
+				(char *)tx->multi_pop), size, flags);
+			PMEMOBJ_API_END();
+			return ret;
+		}
+		ERR_WO_ERRNO("object outside of pool");
+		ret = obj_tx_fail_err(EINVAL, flags);
+		PMEMOBJ_API_END();
+		return ret;
+	}
+
+	uint64_t offset = (uint64_t)((char *)ptr - (char *)tx->pop);
+
+	for (unsigned i = 0; i < TX_COVERED_CACHE_SIZE; ++i) {
+		struct tx_range_def *c = &tx->covered_cache[i];
+		if (offset >= c->offset &&
+		    offset + size <= c->offset + c->size &&
+		    !(c->flags & POBJ_XADD_NO_FLUSH)) {
+			PMEMOBJ_API_END();
+			return 0;
+		}
+	}
+
+	struct tx_range_def args = {
+		.offset = offset,
+		.size = size,
+		.flags = flags,
+	};
+
+	ret = pmemobj_tx_add_common(tx, &args);
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * pmemobj_tx_add_range_direct8 -- adds an 8-byte persistent memory range
+ *	into the transaction
+ */
+int
+pmemobj_tx_add_range_direct8(const void *ptr)
+{
+	LOG(3, NULL);
+
+	return tx_add_range_direct_small(ptr, 8);
+}
+
+/*
+ * pmemobj_tx_add_range_direct16 -- adds a 16-byte persistent memory range
+ *	into the transaction
+ */
+int
+pmemobj_tx_add_range_direct16(const void *ptr)
+{
+	LOG(3, NULL);
+
+	return tx_add_range_direct_small(ptr, 16);
+}
+
+/*
+ * pmemobj_tx_add_range_direct32 -- adds a 32-byte persistent memory range
+ *	into the transaction
+ */
+int
+pmemobj_tx_add_range_direct32(const void *ptr)
+{
+	LOG(3, NULL);
+
+	return tx_add_range_direct_small(ptr, 32);
+}
+
+/*
+ * pmemobj_tx_add_range_direct64 -- adds a 64-byte persistent memory range
+ *	into the transaction
+ */
+int
+pmemobj_tx_add_range_direct64(const void *ptr)
+{
+	LOG(3, NULL);
+
+	return tx_add_range_direct_small(ptr, 64);
+}
+
+/*
+ * tx_expand_small_snapshot -- (internal) expands a small snapshot to fill the
+ *	inline data capacity of a single ulog buffer entry
+ *
+ * A buffer entry in the undo log always occupies at least one cacheline, of
+ * which only the header is metadata - snapshotting fewer bytes than fit
+ * alongside the header wastes the remainder of that cacheline. Expanding the
+ * range up to the entry's inline capacity is free in terms of persisted bytes
+ * and lets snapshots of directly adjacent small ranges, common when object
+ * fields are modified one at a time, coalesce into the already existing log
+ * entry instead of each paying a full cacheline for a few bytes of data.
+ *
+ * The expansion never extends past the end of the object, as the adjacent
+ * memory might belong to an object that is being modified concurrently by
+ * a different transaction.
+ */
+static size_t
+tx_expand_small_snapshot(struct tx *tx, PMEMoid oid, uint64_t hoff,
+	size_t size, uint64_t flags)
+{
+	size_t entry_data = CACHELINE_SIZE - TX_SNAPSHOT_LOG_ENTRY_OVERHEAD;
+
+	if (size == 0 || size >= entry_data)
+		return size;
+
+	/* the range might be tracked without a snapshot, don't grow it */
+	if (flags & (POBJ_XADD_NO_SNAPSHOT | POBJ_XADD_READ_ONLY))
+		return size;
+
+#if VG_MEMCHECK_ENABLED
+	/* the expanded part of the range might be uninitialized */
+	if (On_memcheck)
+		return size;
+#endif
+
+	size_t usable = palloc_usable_size(&tx->pop->heap, oid.off);
+	if (hoff >= usable)
+		return size;
+
+	size_t expanded = MIN(entry_data, usable - hoff);
+
+	return expanded > size ? expanded : size;
+}
+
+/*
+ * tx_generation_bump -- (internal) increments the generation counter of an
+ *	object allocated with POBJ_XALLOC_GENERATION
+ *
+ * The counter word is snapshotted like any other range, so an aborted
+ * transaction rolls the increment back along with the object's data.
+ */
+static int
+tx_generation_bump(struct tx *tx, PMEMoid oid, uint64_t flags)
+{
+	PMEMobjpool *pop = tx->pop;
+
+	if ((palloc_flags(&pop->heap, oid.off) & OBJ_GENERATION_MASK) == 0)
+		return 0;
+
+	uint64_t gen_off = oid.off +
+		palloc_usable_size(&pop->heap, oid.off) - sizeof(uint64_t);
+
+	struct tx_range_def args = {
+		.offset = gen_off,
+		.size = sizeof(uint64_t),
+		.flags = flags & POBJ_FLAG_TX_NO_ABORT,
+	};
+
+	int ret = pmemobj_tx_add_common(tx, &args);
+	if (ret != 0)
+		return ret;
+
+	uint64_t *genp = (uint64_t *)((char *)pop + gen_off);
+	*genp += 1;
+
+	return 0;
+}
+
 /*
  * pmemobj_tx_add_range -- adds persistent memory range into the transaction
  */
@@ -1490,6 +2703,13 @@ pmemobj_tx_add_range(PMEMoid oid, uint64_t hoff, size_t size)
 	uint64_t flags = tx_abort_on_failure_flag(tx);
 
 	if (oid.pool_uuid_lo != tx->pop->uuid_lo) {
+		if (tx->multi_pop != NULL &&
+		    oid.pool_uuid_lo == tx->multi_pop->uuid_lo) {
+			ret = tx_multi_add_common(tx, oid.off + hoff, size,
+				flags);
+			PMEMOBJ_API_END();
+			return ret;
+		}
 		ERR_WO_ERRNO("invalid pool uuid");
 		ret = obj_tx_fail_err(EINVAL, flags);
 		PMEMOBJ_API_END();
@@ -1499,11 +2719,13 @@ pmemobj_tx_add_range(PMEMoid oid, uint64_t hoff, size_t size)
 
 	struct tx_range_def args = {
 		.offset = oid.off + hoff,
-		.size = size,
+		.size = tx_expand_small_snapshot(tx, oid, hoff, size, flags),
 		.flags = flags,
 	};
 
 	ret = pmemobj_tx_add_common(tx, &args);
+	if (ret == 0)
+		ret = tx_generation_bump(tx, oid, flags);
 
 	PMEMOBJ_API_END();
 	return ret;
@@ -1536,6 +2758,13 @@ pmemobj_tx_xadd_range(PMEMoid oid, uint64_t hoff, size_t size, uint64_t flags)
 	}
 
 	if (oid.pool_uuid_lo != tx->pop->uuid_lo) {
+		if (tx->multi_pop != NULL &&
+		    oid.pool_uuid_lo == tx->multi_pop->uuid_lo) {
+			ret = tx_multi_add_common(tx, oid.off + hoff, size,
+				flags);
+			PMEMOBJ_API_END();
+			return ret;
+		}
 		ERR_WO_ERRNO("invalid pool uuid");
 		ret = obj_tx_fail_err(EINVAL, flags);
 		PMEMOBJ_API_END();
@@ -1545,11 +2774,13 @@ pmemobj_tx_xadd_range(PMEMoid oid, uint64_t hoff, size_t size, uint64_t flags)
 
 	struct tx_range_def args = {
 		.offset = oid.off + hoff,
-		.size = size,
+		.size = tx_expand_small_snapshot(tx, oid, hoff, size, flags),
 		.flags = flags,
 	};
 
 	ret = pmemobj_tx_add_common(tx, &args);
+	if (ret == 0)
+		ret = tx_generation_bump(tx, oid, flags);
 
 	PMEMOBJ_API_END();
 	return ret;
@@ -1641,58 +2872,160 @@ pmemobj_tx_xalloc(size_t size, uint64_t type_num, uint64_t flags)
 		return oid;
 	}
 
-	if (flags & ~POBJ_TX_XALLOC_VALID_FLAGS) {
-		ERR_WO_ERRNO("unknown flags 0x%" PRIx64, flags
-			& ~(POBJ_TX_XALLOC_VALID_FLAGS));
+	if (flags & ~POBJ_TX_XALLOC_VALID_FLAGS) {
+		ERR_WO_ERRNO("unknown flags 0x%" PRIx64, flags
+			& ~(POBJ_TX_XALLOC_VALID_FLAGS));
+		oid = obj_tx_fail_null(EINVAL, flags);
+		PMEMOBJ_API_END();
+		return oid;
+	}
+
+	oid = tx_alloc_common(tx, size, (type_num_t)type_num,
+			constructor_tx_alloc, ALLOC_ARGS(flags));
+
+	PMEMOBJ_API_END();
+	return oid;
+}
+
+/*
+ * pmemobj_tx_realloc -- resizes an existing object
+ */
+PMEMoid
+pmemobj_tx_realloc(PMEMoid oid, size_t size, uint64_t type_num)
+{
+	LOG(3, NULL);
+	struct tx *tx = get_tx();
+
+	ASSERT_IN_TX(tx);
+	ASSERT_TX_STAGE_WORK(tx);
+
+	PMEMOBJ_API_START();
+	PMEMoid ret = tx_realloc_common(tx, oid, size, type_num,
+			constructor_tx_alloc, constructor_tx_alloc, 0);
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * pmemobj_zrealloc -- resizes an existing object, any new space is zeroed.
+ */
+PMEMoid
+pmemobj_tx_zrealloc(PMEMoid oid, size_t size, uint64_t type_num)
+{
+	LOG(3, NULL);
+	struct tx *tx = get_tx();
+
+	ASSERT_IN_TX(tx);
+	ASSERT_TX_STAGE_WORK(tx);
+
+	PMEMOBJ_API_START();
+	PMEMoid ret = tx_realloc_common(tx, oid, size, type_num,
+			constructor_tx_alloc, constructor_tx_alloc,
+			POBJ_FLAG_ZERO);
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * pmemobj_tx_xreplace -- transactionally replaces the object referenced by
+ * dest with a new allocation, splicing it in without snapshotting the data
+ *
+ * The new value is written exactly once: either copied from src during the
+ * allocation, or, when src is NULL, directly by the caller before the commit.
+ * The destination reference is updated through the redo log at commit time,
+ * so neither it nor the old object's contents need an undo snapshot - the
+ * old object is simply freed once the transaction is certain to succeed.
+ */
+PMEMoid
+pmemobj_tx_xreplace(PMEMoid *dest, const void *src, size_t size,
+	uint64_t type_num, uint64_t flags)
+{
+	LOG(3, NULL);
+
+	struct tx *tx = get_tx();
+
+	ASSERT_IN_TX(tx);
+	ASSERT_TX_STAGE_WORK(tx);
+
+	flags |= tx_abort_on_failure_flag(tx);
+
+	if (flags & ~POBJ_TX_XALLOC_VALID_FLAGS) {
+		ERR_WO_ERRNO("unknown flags 0x%" PRIx64,
+				flags & ~POBJ_TX_XALLOC_VALID_FLAGS);
+		return obj_tx_fail_null(EINVAL, flags);
+	}
+
+	PMEMOBJ_API_START();
+	PMEMobjpool *pop = tx->pop;
+
+	PMEMoid oid;
+	if (size == 0) {
+		ERR_WO_ERRNO("allocation with size 0");
+		oid = obj_tx_fail_null(EINVAL, flags);
+		PMEMOBJ_API_END();
+		return oid;
+	}
+
+	if (!OBJ_PTR_FROM_POOL(pop, dest)) {
+		ERR_WO_ERRNO("destination outside of pool");
 		oid = obj_tx_fail_null(EINVAL, flags);
 		PMEMOBJ_API_END();
 		return oid;
 	}
 
+	PMEMoid old = *dest;
+
 	oid = tx_alloc_common(tx, size, (type_num_t)type_num,
-			constructor_tx_alloc, ALLOC_ARGS(flags));
+		constructor_tx_alloc, COPY_ARGS(flags, src, src ? size : 0));
+	if (OBJ_OID_IS_NULL(oid)) {
+		PMEMOBJ_API_END();
+		return oid;
+	}
 
-	PMEMOBJ_API_END();
-	return oid;
-}
+	struct pobj_action *action = tx_action_add(tx);
+	if (action == NULL)
+		goto err_action;
 
-/*
- * pmemobj_tx_realloc -- resizes an existing object
- */
-PMEMoid
-pmemobj_tx_realloc(PMEMoid oid, size_t size, uint64_t type_num)
-{
-	LOG(3, NULL);
-	struct tx *tx = get_tx();
+	palloc_set_value(&pop->heap, action, &dest->pool_uuid_lo,
+		oid.pool_uuid_lo);
 
-	ASSERT_IN_TX(tx);
-	ASSERT_TX_STAGE_WORK(tx);
+	action = tx_action_add(tx);
+	if (action == NULL) {
+		tx_action_remove(tx);
+		goto err_action;
+	}
+
+	palloc_set_value(&pop->heap, action, &dest->off, oid.off);
+
+	if (!OBJ_OID_IS_NULL(old) &&
+	    pmemobj_tx_xfree(old, flags & POBJ_XFREE_VALID_FLAGS) != 0) {
+		/* the free failed with no-abort, take the splice back */
+		tx_action_remove(tx);
+		tx_action_remove(tx);
+		pmemobj_tx_xfree(oid, POBJ_XFREE_NO_ABORT);
+		oid = OID_NULL;
+	}
 
-	PMEMOBJ_API_START();
-	PMEMoid ret = tx_realloc_common(tx, oid, size, type_num,
-			constructor_tx_alloc, constructor_tx_alloc, 0);
 	PMEMOBJ_API_END();
-	return ret;
+	return oid;
+
+err_action:
+	pmemobj_tx_xfree(oid, POBJ_XFREE_NO_ABORT);
+	ERR_DEFER_WO_ERRNO("out of memory");
+	oid = obj_tx_fail_null(ENOMEM, flags);
+	PMEMOBJ_API_END();
+	return oid;
 }
 
 /*
- * pmemobj_zrealloc -- resizes an existing object, any new space is zeroed.
+ * pmemobj_tx_replace -- transactionally replaces the object referenced by
+ * dest with a new allocation holding a copy of src
  */
 PMEMoid
-pmemobj_tx_zrealloc(PMEMoid oid, size_t size, uint64_t type_num)
+pmemobj_tx_replace(PMEMoid *dest, const void *src, size_t size,
+	uint64_t type_num)
 {
-	LOG(3, NULL);
-	struct tx *tx = get_tx();
-
-	ASSERT_IN_TX(tx);
-	ASSERT_TX_STAGE_WORK(tx);
-
-	PMEMOBJ_API_START();
-	PMEMoid ret = tx_realloc_common(tx, oid, size, type_num,
-			constructor_tx_alloc, constructor_tx_alloc,
-			POBJ_FLAG_ZERO);
-	PMEMOBJ_API_END();
-	return ret;
+	return pmemobj_tx_xreplace(dest, src, size, type_num, 0);
 }
 
 /*
@@ -1865,7 +3198,18 @@ pmemobj_tx_xfree(PMEMoid oid, uint64_t flags)
 				void *ptr = OBJ_OFF_TO_PTR(pop, r->offset);
 				VALGRIND_SET_CLEAN(ptr, r->size);
 				VALGRIND_REMOVE_FROM_TX(ptr, r->size);
+				struct tx_range_def freed = *r;
 				ravl_remove(tx->ranges, n);
+				/*
+				 * Coverage of the ranges tree shrunk, the
+				 * covered ranges cache can no longer be
+				 * trusted, and neither can the page bitmap
+				 * for the freed range - a later allocation
+				 * at this offset must snapshot anew.
+				 */
+				memset(tx->covered_cache, 0,
+					sizeof(tx->covered_cache));
+				tx_snapshot_pages_clear(tx, &freed);
 				palloc_cancel(&pop->heap, action, 1);
 				VEC_ERASE_BY_PTR(&tx->actions, action);
 				PMEMOBJ_API_END();
@@ -1966,6 +3310,7 @@ pmemobj_tx_xlog_append_buffer(enum pobj_log_type type, void *addr, size_t size,
 
 	struct tx_data *td = PMDK_SLIST_FIRST(&tx->tx_entries);
 	err = tx_construct_user_buffer(tx, addr, size, type,
+			tx->flat_nesting == 0 &&
 			PMDK_SLIST_NEXT(td, tx_entry) == NULL, flags);
 
 	PMEMOBJ_API_END();
@@ -1981,6 +3326,25 @@ pmemobj_tx_log_append_buffer(enum pobj_log_type type, void *addr, size_t size)
 	return pmemobj_tx_xlog_append_buffer(type, addr, size, 0);
 }
 
+/*
+ * pmemobj_tx_log_reserve -- ensures that the given transaction log has the
+ *	requested capacity, extending it immediately if needed
+ *
+ * Meant to be called right after the transaction begins, so that subsequent
+ * operations never have to allocate additional log space in-flight.
+ */
+int
+pmemobj_tx_log_reserve(enum pobj_log_type type, size_t size)
+{
+	struct tx *tx = get_tx();
+	ASSERT_TX_STAGE_WORK(tx);
+
+	struct operation_context *ctx = type == TX_LOG_TYPE_INTENT ?
+		tx->lane->external : tx->lane->undo;
+
+	return operation_reserve(ctx, size);
+}
+
 /*
  * pmemobj_tx_log_auto_alloc -- enable/disable automatic ulog allocation
  */
@@ -2116,6 +3480,24 @@ pmemobj_tx_set_user_data(void *data)
 	tx->user_data = data;
 }
 
+/*
+ * pmemobj_tx_set_read_validator -- sets the read-set validation callback of
+ * the current transaction
+ */
+void
+pmemobj_tx_set_read_validator(pmemobj_tx_read_validator validator, void *arg)
+{
+	LOG(3, "validator %p arg %p", validator, arg);
+
+	struct tx *tx = get_tx();
+
+	ASSERT_IN_TX(tx);
+	ASSERT_TX_STAGE_WORK(tx);
+
+	tx->read_validator = validator;
+	tx->read_validator_arg = arg;
+}
+
 /*
  * pmemobj_tx_get_user_data -- gets volatile pointer to the user data associated
  * with the current transaction
@@ -2132,6 +3514,31 @@ pmemobj_tx_get_user_data(void)
 	return tx->user_data;
 }
 
+/*
+ * pmemobj_tx_get_stats -- retrieves the resource usage counters of the
+ * current transaction
+ */
+int
+pmemobj_tx_get_stats(struct pobj_tx_stats *stats)
+{
+	LOG(3, "stats %p", stats);
+
+	struct tx *tx = get_tx();
+
+	if (tx->stage == TX_STAGE_NONE) {
+		ERR_WO_ERRNO("no transaction in progress in this thread");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (tx->lane != NULL)
+		tx_fold_undo_stats(tx);
+
+	*stats = tx->stats;
+
+	return 0;
+}
+
 /*
  * pmemobj_tx_set_failure_behavior -- enables or disables automatic transaction
  * abort in case of an error
@@ -2258,6 +3665,208 @@ static const struct ctl_node CTL_NODE(cache)[] = {
 	CTL_NODE_END
 };
 
+/*
+ * CTL_READ_HANDLER(size, log) -- gets the default transaction log size
+ */
+static int
+CTL_READ_HANDLER(size, log)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	ssize_t *arg_out = arg;
+
+	*arg_out = (ssize_t)pop->tx_params->log_size;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(size, log) -- sets the default transaction log size,
+ *	applied to the undo log at the start of every outermost transaction
+ */
+static int
+CTL_WRITE_HANDLER(size, log)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	ssize_t arg_in = *(long long *)arg;
+
+	if (arg_in < 0 || arg_in > (ssize_t)PMEMOBJ_MAX_ALLOC_SIZE) {
+		errno = EINVAL;
+		ERR_WO_ERRNO(
+			"invalid log size, must be between 0 and max alloc size");
+		return -1;
+	}
+
+	pop->tx_params->log_size = (size_t)arg_in;
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(log)[] = {
+	CTL_LEAF_RW(size, log),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_READ_HANDLER(count, big_lanes) -- gets the number of lanes reserved
+ *	for large transactions
+ */
+static int
+CTL_READ_HANDLER(count, big_lanes)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	int *arg_out = arg;
+
+	*arg_out = (int)pop->tx_params->big_lanes;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(count, big_lanes) -- sets the number of lanes reserved
+ *	for large transactions, clamped at runtime to half the lane range
+ */
+static int
+CTL_WRITE_HANDLER(count, big_lanes)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	int arg_in = *(int *)arg;
+
+	if (arg_in < 0) {
+		errno = EINVAL;
+		ERR_WO_ERRNO("invalid lane count, must not be negative");
+		return -1;
+	}
+
+	pop->tx_params->big_lanes = (unsigned)arg_in;
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(count) = CTL_ARG_INT;
+
+/*
+ * CTL_READ_HANDLER(log_size, big_lanes) -- gets the undo log capacity the
+ *	large-transaction lanes are pre-sized to
+ */
+static int
+CTL_READ_HANDLER(log_size, big_lanes)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	ssize_t *arg_out = arg;
+
+	*arg_out = (ssize_t)pop->tx_params->big_log_size;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(log_size, big_lanes) -- sets the undo log capacity the
+ *	large-transaction lanes are pre-sized to when first claimed
+ */
+static int
+CTL_WRITE_HANDLER(log_size, big_lanes)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	ssize_t arg_in = *(long long *)arg;
+
+	if (arg_in < 0 || arg_in > (ssize_t)PMEMOBJ_MAX_ALLOC_SIZE) {
+		errno = EINVAL;
+		ERR_WO_ERRNO(
+			"invalid log size, must be between 0 and max alloc size");
+		return -1;
+	}
+
+	pop->tx_params->big_log_size = (size_t)arg_in;
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(log_size) = CTL_ARG_LONG_LONG;
+
+static const struct ctl_node CTL_NODE(big_lanes)[] = {
+	CTL_LEAF_RW(count, big_lanes),
+	CTL_LEAF_RW(log_size, big_lanes),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_READ_HANDLER(enabled, group_commit) -- returns whether transaction
+ *	group commit is enabled
+ */
+static int
+CTL_READ_HANDLER(enabled, group_commit)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	int *arg_out = arg;
+
+	*arg_out = pop->tx_params->group_commit;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(enabled, group_commit) -- enables or disables transaction
+ *	group commit
+ */
+static int
+CTL_WRITE_HANDLER(enabled, group_commit)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	/* suppress unused-parameter errors */
+	SUPPRESS_UNUSED(source, indexes);
+
+	PMEMobjpool *pop = ctx;
+
+	pop->tx_params->group_commit = *(int *)arg != 0;
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(enabled) = CTL_ARG_BOOLEAN;
+
+static const struct ctl_node CTL_NODE(group_commit)[] = {
+	CTL_LEAF_RW(enabled, group_commit),
+
+	CTL_NODE_END
+};
+
 /*
  * CTL_READ_HANDLER(skip_expensive_checks) -- returns "skip_expensive_checks"
  * var from pool ctl
@@ -2414,6 +4023,9 @@ static const struct ctl_node CTL_NODE(post_commit)[] = {
 static const struct ctl_node CTL_NODE(tx)[] = {
 	CTL_CHILD(debug),
 	CTL_CHILD(cache),
+	CTL_CHILD(log),
+	CTL_CHILD(big_lanes),
+	CTL_CHILD(group_commit),
 	CTL_CHILD(post_commit),
 
 	CTL_NODE_END
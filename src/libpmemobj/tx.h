@@ -10,6 +10,7 @@
 
 #include <stdint.h>
 #include "obj.h"
+#include "os_thread.h"
 #include "ulog.h"
 
 #ifdef __cplusplus
@@ -34,6 +35,35 @@ extern "C" {
 
 struct tx_parameters {
 	size_t cache_size;
+
+	/*
+	 * Capacity the undo log is pre-sized to at the start of every
+	 * outermost transaction, 0 means no pre-sizing.
+	 */
+	size_t log_size;
+
+	/*
+	 * Number of runtime lanes, taken from the top of the lane range,
+	 * reserved for transactions begun with TX_PARAM_LARGE, and the undo
+	 * log capacity those lanes are pre-sized to when first claimed.
+	 * Keeping large transactions on their own pre-provisioned lanes
+	 * isolates small-transaction latency from their log growth. Zero
+	 * lanes means no segregation.
+	 */
+	unsigned big_lanes;
+	size_t big_log_size;
+
+	/*
+	 * Group commit: when enabled, concurrently committing threads
+	 * rendezvous at the commit ordering point so that one drain covers
+	 * the whole batch.
+	 */
+	int group_commit;
+	os_mutex_t gc_lock;
+	os_cond_t gc_cond;
+	uint64_t gc_requested; /* tickets handed out to committing threads */
+	uint64_t gc_completed; /* highest ticket covered by a drain */
+	int gc_leader; /* set while a thread drains for the batch */
 };
 
 /*
@@ -85,6 +85,8 @@ ulog_entry_size(const struct ulog_entry_base *entry)
 		case ULOG_OPERATION_OR:
 		case ULOG_OPERATION_SET:
 			return sizeof(struct ulog_entry_val);
+		case ULOG_OPERATION_SET_RANGE:
+			return sizeof(struct ulog_entry_val16);
 		case ULOG_OPERATION_BUF_SET:
 		case ULOG_OPERATION_BUF_CPY:
 			eb = (struct ulog_entry_buf *)entry;
@@ -394,8 +396,83 @@ ulog_entry_val_create(struct ulog *ulog, size_t offset, uint64_t *dest,
 	data.v.base.offset |= ULOG_OPERATION(type);
 	data.v.value = value;
 
-	pmemops_memcpy(p_ops, e, &data, sizeof(data),
-		PMEMOBJ_F_MEM_NOFLUSH | PMEMOBJ_F_RELAXED);
+	/*
+	 * When the entry starts a cache line and the platform can store one
+	 * atomically, emit the entry and the clobbering zeroes (extended to
+	 * the end of the line) with a single direct store, skipping the
+	 * flush of the freshly written entry. Everything past the entry
+	 * would be clobbered by subsequent entries anyway and the caller
+	 * guarantees a full cache line of space.
+	 */
+	if (p_ops->store_line != NULL &&
+			((uintptr_t)e & (CACHELINE_SIZE - 1)) == 0) {
+		union {
+			char line[CACHELINE_SIZE];
+			struct ulog_entry_val v;
+		} buf;
+
+		memset(buf.line, 0, sizeof(buf.line));
+		buf.v = data.v;
+
+		pmemops_store_line(p_ops, e, buf.line);
+	} else {
+		pmemops_memcpy(p_ops, e, &data, sizeof(data),
+			PMEMOBJ_F_MEM_NOFLUSH | PMEMOBJ_F_RELAXED);
+	}
+
+	return e;
+}
+
+/*
+ * ulog_entry_val16_create -- creates a new inline byte-range entry in the
+ *	ulog
+ *
+ * This function requires at least a cacheline of space to be available in the
+ * ulog.
+ */
+struct ulog_entry_val16 *
+ulog_entry_val16_create(struct ulog *ulog, size_t offset, void *dest,
+	const void *src, size_t size, const struct pmem_ops *p_ops)
+{
+	struct ulog_entry_val16 *e =
+		(struct ulog_entry_val16 *)(ulog->data + offset);
+
+	ASSERT(size > 0 && size <= sizeof(e->data));
+
+	struct {
+		struct ulog_entry_val16 v;
+		struct ulog_entry_base zeroes;
+	} data;
+	COMPILE_ERROR_ON(sizeof(data) != sizeof(data.v) + sizeof(data.zeroes));
+
+	/*
+	 * Write a little bit more to the buffer so that the next entry that
+	 * resides in the log is erased. This will prevent leftovers from
+	 * a previous, clobbered, log from being incorrectly applied.
+	 */
+	data.zeroes.offset = 0;
+	data.v.base.offset = (uint64_t)(dest) - (uint64_t)p_ops->base;
+	data.v.base.offset |= ULOG_OPERATION(ULOG_OPERATION_SET_RANGE);
+	data.v.size = size;
+	memset(data.v.data, 0, sizeof(data.v.data));
+	memcpy(data.v.data, src, size);
+
+	/* the same single-line direct store shortcut as for value entries */
+	if (p_ops->store_line != NULL &&
+			((uintptr_t)e & (CACHELINE_SIZE - 1)) == 0) {
+		union {
+			char line[CACHELINE_SIZE];
+			struct ulog_entry_val16 v;
+		} buf;
+
+		memset(buf.line, 0, sizeof(buf.line));
+		buf.v = data.v;
+
+		pmemops_store_line(p_ops, e, buf.line);
+	} else {
+		pmemops_memcpy(p_ops, e, &data, sizeof(data),
+			PMEMOBJ_F_MEM_NOFLUSH | PMEMOBJ_F_RELAXED);
+	}
 
 	return e;
 }
@@ -535,6 +612,7 @@ ulog_entry_apply(const struct ulog_entry_base *e, int persist,
 	uint64_t *dst = (uint64_t *)((uintptr_t)p_ops->base + offset);
 
 	struct ulog_entry_val *ev;
+	struct ulog_entry_val16 *ev16;
 	struct ulog_entry_buf *eb;
 
 	flush_fn f = persist ? p_ops->persist : p_ops->flush;
@@ -564,6 +642,15 @@ ulog_entry_apply(const struct ulog_entry_base *e, int persist,
 			f(p_ops->base, dst, sizeof(uint64_t),
 				PMEMOBJ_F_RELAXED);
 		break;
+		case ULOG_OPERATION_SET_RANGE:
+			ev16 = (struct ulog_entry_val16 *)e;
+
+			dst_size = ev16->size;
+			VALGRIND_ADD_TO_TX(dst, dst_size);
+			memcpy(dst, ev16->data, dst_size);
+			f(p_ops->base, dst, dst_size,
+				PMEMOBJ_F_RELAXED);
+		break;
 		case ULOG_OPERATION_BUF_SET:
 			eb = (struct ulog_entry_buf *)e;
 
@@ -619,6 +706,21 @@ ulog_inc_gen_num(struct ulog *ulog, const struct pmem_ops *p_ops)
 	VALGRIND_REMOVE_FROM_TX(&ulog->gen_num, gns);
 }
 
+/*
+ * ulog_invalidate -- invalidates the log by bumping its generation number
+ *
+ * The checksum stored in the header covers the generation number, so after
+ * the bump the checksum verification fails and recovery ignores the log,
+ * just as if the header was clobbered. Unlike a clobber, only the number
+ * itself is written - the rest of the header, including the next pointer,
+ * stays intact and is simply overwritten by the next log store.
+ */
+void
+ulog_invalidate(struct ulog *ulog, const struct pmem_ops *p_ops)
+{
+	ulog_inc_gen_num(ulog, p_ops);
+}
+
 /*
  * ulog_free_by_ptr_next -- free all ulogs starting from the indicated one.
  * Function returns 1 if any ulog have been freed or unpinned, 0 otherwise.
@@ -26,6 +26,19 @@ struct ulog_entry_val {
 	uint64_t value; /* value to be applied */
 };
 
+/*
+ * ulog_entry_val16 -- log entry with an inline byte range of up to 16 bytes
+ *
+ * Sized at two value entries, it packs small unaligned or 9..16 byte
+ * modifications four times denser than the smallest, cacheline-aligned,
+ * buffer entry would.
+ */
+struct ulog_entry_val16 {
+	struct ulog_entry_base base;
+	uint64_t size; /* number of data bytes, 1..16 */
+	uint8_t data[16]; /* bytes to be applied at the offset */
+};
+
 /*
  * ulog_entry_buf - ulog buffer entry
  */
@@ -76,6 +89,7 @@ typedef uint64_t ulog_operation_type;
 #define ULOG_OPERATION_SET		(0b000ULL << 61ULL)
 #define ULOG_OPERATION_AND		(0b001ULL << 61ULL)
 #define ULOG_OPERATION_OR		(0b010ULL << 61ULL)
+#define ULOG_OPERATION_SET_RANGE	(0b011ULL << 61ULL)
 #define ULOG_OPERATION_BUF_SET		(0b101ULL << 61ULL)
 #define ULOG_OPERATION_BUF_CPY		(0b110ULL << 61ULL)
 
@@ -122,6 +136,7 @@ void ulog_store(struct ulog *dest,
 int ulog_free_next(struct ulog *u, const struct pmem_ops *p_ops,
 		ulog_free_fn ulog_free, ulog_rm_user_buffer_fn user_buff_remove,
 		uint64_t flags);
+void ulog_invalidate(struct ulog *ulog, const struct pmem_ops *p_ops);
 void ulog_clobber(struct ulog *dest, struct ulog_next *next,
 	const struct pmem_ops *p_ops);
 int ulog_clobber_data(struct ulog *dest,
@@ -147,6 +162,10 @@ struct ulog_entry_val *ulog_entry_val_create(struct ulog *ulog,
 	ulog_operation_type type,
 	const struct pmem_ops *p_ops);
 
+struct ulog_entry_val16 *ulog_entry_val16_create(struct ulog *ulog,
+	size_t offset, void *dest, const void *src, size_t size,
+	const struct pmem_ops *p_ops);
+
 struct ulog_entry_buf *
 ulog_entry_buf_create(struct ulog *ulog, size_t offset,
 	uint64_t gen_num, uint64_t *dest, const void *src, uint64_t size,
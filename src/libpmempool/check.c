@@ -24,6 +24,18 @@ struct step {
 	void (*func)(PMEMpoolcheck *);
 	enum pool_type type;
 	bool part;
+
+	/*
+	 * Parallel-safety annotation.  A read-only step does not modify the
+	 * pool and could in principle run concurrently with other read-only
+	 * steps.  The steps are nevertheless executed one at a time: the
+	 * check is an interactive, resumable state machine -- a step may
+	 * emit questions, the caller's answers steer the repairs, and the
+	 * repairs done by one step feed the checks of the next one.  What
+	 * is parallelized instead are the data scans inside the steps
+	 * (e.g. the per-part copy done by the backup step).
+	 */
+	bool ro;
 };
 
 static const struct step steps[] = {
@@ -31,26 +43,36 @@ static const struct step steps[] = {
 		.type		= POOL_TYPE_ANY,
 		.func		= check_bad_blocks,
 		.part		= true,
+		/* only queries the bad block count of each part */
+		.ro		= true,
 	},
 	{
 		.type		= POOL_TYPE_ANY,
 		.func		= check_backup,
 		.part		= true,
+		/* reads the pool, but creates and writes the backup */
+		.ro		= false,
 	},
 	{
 		.type		= POOL_TYPE_OBJ,
 		.func		= check_sds,
 		.part		= true,
+		/* may repair the shutdown state */
+		.ro		= false,
 	},
 	{
 		.type		= POOL_TYPE_OBJ | POOL_TYPE_UNKNOWN,
 		.func		= check_pool_hdr,
 		.part		= true,
+		/* may repair the part headers */
+		.ro		= false,
 	},
 	{
 		.type		= POOL_TYPE_OBJ | POOL_TYPE_UNKNOWN,
 		.func		= check_pool_hdr_uuids,
 		.part		= true,
+		/* may rewrite the uuid links, depends on check_pool_hdr */
+		.ro		= false,
 	},
 	{
 		.func		= NULL,
@@ -18,6 +18,7 @@
 #include "pool.h"
 #include "set.h"
 #include "check_util.h"
+#include "usc.h"
 
 enum question {
 	Q_RESET_SDS,
@@ -65,12 +66,19 @@ sds_check_replica(location *loc)
 
 	shutdown_state_init(&curr_sds, NULL);
 
+	/* one device context walk serves all parts of the replica */
+	struct pmem2_usc_ctx *usc_ctx = NULL;
+	(void) pmem2_usc_ctx_new(&usc_ctx);
+
 	/* get current shutdown state */
 	for (unsigned p = 0; p < rep->nparts; ++p) {
-		if (shutdown_state_add_part(&curr_sds,
-				PART(rep, p)->fd, NULL))
+		if (shutdown_state_add_part(&curr_sds, usc_ctx,
+				PART(rep, p)->fd, NULL)) {
+			pmem2_usc_ctx_delete(&usc_ctx);
 			return -1;
+		}
 	}
+	pmem2_usc_ctx_delete(&usc_ctx);
 
 	/* compare current and old shutdown state */
 	return shutdown_state_check(&curr_sds, &old_sds, NULL);
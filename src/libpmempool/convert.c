@@ -0,0 +1,347 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2024, Intel Corporation */
+
+/*
+ * convert.c -- parallel, resumable range-conversion engine
+ *
+ * Layout migrations and replica rebuilds move pool-sized amounts of data,
+ * so running them single-threaded at full speed is either too slow or too
+ * disruptive for a pool that is still serving traffic. This engine splits
+ * a conversion into chunk-sized work items claimed by worker threads from
+ * a shared cursor, records completed items in a progress file so an
+ * interrupted conversion resumes instead of restarting, and paces all
+ * workers against a common bandwidth budget read from the
+ * PMEMPOOL_CONVERT_BANDWIDTH environment variable (MB/s, 0 or unset
+ * means unlimited).
+ *
+ * The progress file stores the job cookie, the chunk size and the total
+ * length next to the byte-per-chunk completion map; a leftover file that
+ * does not match the job exactly is discarded, so stale progress can
+ * never cause a chunk to be skipped against a recreated target.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "convert.h"
+#include "alloc.h"
+#include "core_assert.h"
+#include "log_internal.h"
+#include "os.h"
+#include "os_thread.h"
+#include "out.h"
+#include "util.h"
+
+/* fan-out limit, matching the striped pool copy in pool.c */
+#define CONVERT_MAX_THREADS 16U
+
+/* work items converted by one worker between progress file syncs */
+#define CONVERT_SYNC_INTERVAL 16
+
+/* longest single pacing sleep, keeps workers responsive to an abort */
+#define CONVERT_SLEEP_MAX_US 100000
+
+#define CONVERT_BW_ENV "PMEMPOOL_CONVERT_BANDWIDTH"
+
+#define CONVERT_PROGRESS_MAGIC 0x47524f5056504d50ULL /* PMPVPROG */
+
+struct convert_progress_hdr {
+	uint64_t magic;
+	uint64_t cookie;
+	uint64_t chunk;
+	uint64_t len;
+};
+
+struct convert_ctx {
+	struct convert_job *job;
+	size_t nchunks;
+	uint8_t *done;		/* byte-per-chunk completion map */
+	int progress_fd;	/* -1 when the job is one-shot */
+
+	uint64_t next;		/* shared work item cursor */
+	uint64_t bytes;		/* bytes converted, drives the pacing */
+	size_t bandwidth;	/* bytes per second, 0 means unlimited */
+	struct timespec start;
+
+	uint32_t error;		/* set by the first failed work item */
+};
+
+struct convert_worker {
+	os_thread_t thread;
+	struct convert_ctx *ctx;
+};
+
+/*
+ * convert_bandwidth -- (internal) read the bandwidth budget from the
+ *	environment, in MB/s, converted to bytes per second
+ */
+static size_t
+convert_bandwidth(void)
+{
+	char *env = os_getenv(CONVERT_BW_ENV);
+	if (env == NULL)
+		return 0;
+
+	char *endp;
+	errno = 0;
+	unsigned long long mbps = strtoull(env, &endp, 10);
+	if (errno != 0 || *endp != '\0') {
+		CORE_LOG_ERROR("invalid " CONVERT_BW_ENV " value -- '%s'",
+			env);
+		return 0;
+	}
+
+	return (size_t)mbps << 20;
+}
+
+/*
+ * convert_progress_load -- (internal) open the progress file and load the
+ *	completion map of a matching interrupted conversion
+ *
+ * A file with a mismatched header is truncated and reinitialized rather
+ * than trusted - resuming is an optimization, correctness never depends
+ * on the leftover state.
+ */
+static int
+convert_progress_load(struct convert_ctx *ctx)
+{
+	struct convert_job *job = ctx->job;
+
+	if (job->progress_path == NULL) {
+		ctx->progress_fd = -1;
+		return 0;
+	}
+
+	int fd = os_open(job->progress_path, O_RDWR | O_CREAT, 0600);
+	if (fd < 0) {
+		ERR_W_ERRNO("opening conversion progress file failed -- '%s'",
+			job->progress_path);
+		return -1;
+	}
+
+	struct convert_progress_hdr hdr;
+	if (pread(fd, &hdr, sizeof(hdr), 0) == (ssize_t)sizeof(hdr) &&
+			hdr.magic == CONVERT_PROGRESS_MAGIC &&
+			hdr.cookie == job->cookie &&
+			hdr.chunk == job->chunk && hdr.len == job->len) {
+		ssize_t ret = pread(fd, ctx->done, ctx->nchunks,
+			(off_t)sizeof(hdr));
+		if (ret == (ssize_t)ctx->nchunks) {
+			LOG(3, "resuming conversion -- '%s'",
+				job->progress_path);
+			ctx->progress_fd = fd;
+			return 0;
+		}
+
+		/* short map - fall through and start from scratch */
+		memset(ctx->done, 0, ctx->nchunks);
+	}
+
+	hdr.magic = CONVERT_PROGRESS_MAGIC;
+	hdr.cookie = job->cookie;
+	hdr.chunk = job->chunk;
+	hdr.len = job->len;
+
+	if (os_ftruncate(fd, (os_off_t)(sizeof(hdr) + ctx->nchunks)) != 0 ||
+			pwrite(fd, &hdr, sizeof(hdr), 0) !=
+			(ssize_t)sizeof(hdr) || os_fsync(fd) != 0) {
+		ERR_W_ERRNO(
+			"initializing conversion progress file failed -- '%s'",
+			job->progress_path);
+		os_close(fd);
+		return -1;
+	}
+
+	ctx->progress_fd = fd;
+	return 0;
+}
+
+/*
+ * convert_throttle -- (internal) pace all workers against the shared
+ *	bandwidth budget
+ */
+static void
+convert_throttle(struct convert_ctx *ctx)
+{
+	if (ctx->bandwidth == 0)
+		return;
+
+	uint64_t bytes;
+	util_atomic_load_explicit64(&ctx->bytes, &bytes,
+		memory_order_relaxed);
+
+	uint64_t budget_us = bytes * 1000000 / ctx->bandwidth;
+
+	struct timespec now;
+	os_clock_gettime(CLOCK_MONOTONIC, &now);
+	uint64_t elapsed_us = (uint64_t)(now.tv_sec - ctx->start.tv_sec) *
+		1000000 + (uint64_t)(now.tv_nsec - ctx->start.tv_nsec) / 1000;
+
+	while (elapsed_us < budget_us) {
+		uint32_t error;
+		util_atomic_load_explicit32(&ctx->error, &error,
+			memory_order_relaxed);
+		if (error)
+			return;
+
+		uint64_t wait_us = budget_us - elapsed_us;
+		if (wait_us > CONVERT_SLEEP_MAX_US)
+			wait_us = CONVERT_SLEEP_MAX_US;
+		usleep((useconds_t)wait_us);
+
+		os_clock_gettime(CLOCK_MONOTONIC, &now);
+		elapsed_us = (uint64_t)(now.tv_sec - ctx->start.tv_sec) *
+			1000000 +
+			(uint64_t)(now.tv_nsec - ctx->start.tv_nsec) / 1000;
+	}
+}
+
+/*
+ * convert_worker_run -- (internal) claim and convert work items until the
+ *	job is done or aborted
+ */
+static void *
+convert_worker_run(void *arg)
+{
+	struct convert_worker *w = arg;
+	struct convert_ctx *ctx = w->ctx;
+	struct convert_job *job = ctx->job;
+	int unsynced = 0;
+
+	for (;;) {
+		uint32_t error;
+		util_atomic_load_explicit32(&ctx->error, &error,
+			memory_order_relaxed);
+		if (error)
+			break;
+
+		uint64_t idx = util_fetch_and_add64(&ctx->next, 1);
+		if (idx >= ctx->nchunks)
+			break;
+
+		if (ctx->done[idx])
+			continue;
+
+		size_t off = (size_t)idx * job->chunk;
+		size_t len = job->len - off;
+		if (len > job->chunk)
+			len = job->chunk;
+
+		if (job->apply((char *)job->dst + off,
+				(const char *)job->src + off, len,
+				job->arg) != 0) {
+			util_atomic_store_explicit32(&ctx->error, 1,
+				memory_order_relaxed);
+			break;
+		}
+
+		ctx->done[idx] = 1;
+		if (ctx->progress_fd != -1) {
+			if (pwrite(ctx->progress_fd, &ctx->done[idx], 1,
+					(off_t)(sizeof(struct
+					convert_progress_hdr) + idx)) != 1)
+				CORE_LOG_WARNING(
+					"recording conversion progress failed");
+			else if (++unsynced >= CONVERT_SYNC_INTERVAL) {
+				(void) os_fsync(ctx->progress_fd);
+				unsynced = 0;
+			}
+		}
+
+		util_fetch_and_add64(&ctx->bytes, len);
+		convert_throttle(ctx);
+	}
+
+	return NULL;
+}
+
+/*
+ * convert_run -- run a conversion job, fanned out across worker threads
+ *
+ * Returns 0 when every work item was converted; on failure the progress
+ * file is kept, so a rerun picks up where this one stopped.
+ */
+int
+convert_run(struct convert_job *job)
+{
+	LOG(3, "job %p dst %p src %p len %zu chunk %zu progress %s",
+		job, job->dst, job->src, job->len, job->chunk,
+		job->progress_path ? job->progress_path : "(none)");
+
+	ASSERTne(job->apply, NULL);
+	ASSERTne(job->chunk, 0);
+
+	if (job->len == 0)
+		return 0;
+
+	struct convert_ctx ctx;
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.job = job;
+	ctx.nchunks = (job->len + job->chunk - 1) / job->chunk;
+	ctx.bandwidth = convert_bandwidth();
+
+	ctx.done = Zalloc(ctx.nchunks);
+	if (ctx.done == NULL) {
+		ERR_W_ERRNO("Zalloc");
+		return -1;
+	}
+
+	if (convert_progress_load(&ctx) != 0) {
+		Free(ctx.done);
+		return -1;
+	}
+
+	os_clock_gettime(CLOCK_MONOTONIC, &ctx.start);
+
+	static long cpus;
+	if (cpus == 0)
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	unsigned nthreads = cpus < 2 ? 1 : (unsigned)cpus;
+	if (nthreads > CONVERT_MAX_THREADS)
+		nthreads = CONVERT_MAX_THREADS;
+	if (nthreads > ctx.nchunks)
+		nthreads = (unsigned)ctx.nchunks;
+
+	struct convert_worker workers[CONVERT_MAX_THREADS];
+	unsigned started = 0;
+
+	/* the caller's thread is the last worker */
+	for (unsigned i = 0; i < nthreads - 1; i++) {
+		workers[i].ctx = &ctx;
+		if (os_thread_create(&workers[i].thread, NULL,
+				convert_worker_run, &workers[i]))
+			break;
+		started++;
+	}
+
+	struct convert_worker self;
+	self.ctx = &ctx;
+	convert_worker_run(&self);
+
+	for (unsigned i = 0; i < started; i++)
+		os_thread_join(&workers[i].thread, NULL);
+
+	int ret = 0;
+	if (ctx.error) {
+		CORE_LOG_ERROR("conversion aborted");
+		errno = EIO;
+		ret = -1;
+	}
+
+	if (ctx.progress_fd != -1) {
+		(void) os_fsync(ctx.progress_fd);
+		os_close(ctx.progress_fd);
+		if (ret == 0 && os_unlink(job->progress_path) != 0)
+			CORE_LOG_WARNING(
+				"removing conversion progress file failed -- '%s'",
+				job->progress_path);
+	}
+
+	Free(ctx.done);
+	return ret;
+}
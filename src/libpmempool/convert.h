@@ -0,0 +1,56 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright 2024, Intel Corporation */
+
+/*
+ * convert.h -- parallel, resumable range-conversion engine
+ */
+
+#ifndef CONVERT_H
+#define CONVERT_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A conversion job rewrites the range [src, src + len) into
+ * [dst, dst + len) through the apply callback, one chunk-sized work item
+ * at a time. Work items are claimed by worker threads, so apply must be
+ * safe to call concurrently for disjoint chunks, and it must be
+ * idempotent - a chunk whose completion was not recorded before a crash
+ * is converted again on resume.
+ */
+struct convert_job {
+	void *dst;		/* destination base address */
+	const void *src;	/* source base address, may equal dst */
+	size_t len;		/* total length in bytes */
+	size_t chunk;		/* work item granularity */
+
+	/*
+	 * Progress file recording completed work items, so an interrupted
+	 * conversion resumes where it stopped. NULL makes the job one-shot.
+	 */
+	const char *progress_path;
+
+	/*
+	 * Identity of the conversion target, stored in the progress file.
+	 * A leftover file whose cookie does not match (the target was
+	 * recreated, resized or the job parameters changed) is discarded.
+	 */
+	uint64_t cookie;
+
+	/* convert one work item; nonzero return aborts the job */
+	int (*apply)(void *dst, const void *src, size_t len, void *arg);
+	void *arg;
+};
+
+int convert_run(struct convert_job *job);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
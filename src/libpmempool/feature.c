@@ -27,6 +27,7 @@ static const features_t f_singlehdr = FEAT_INCOMPAT(SINGLEHDR);
 static const features_t f_cksum_2k = FEAT_INCOMPAT(CKSUM_2K);
 static const features_t f_sds = FEAT_INCOMPAT(SDS);
 static const features_t f_chkbb = FEAT_COMPAT(CHECK_BAD_BLOCKS);
+static const features_t f_partgrow = FEAT_COMPAT(PART_GROW);
 
 #define FEAT_INVALID \
 	{UINT32_MAX, UINT32_MAX, UINT32_MAX};
@@ -571,6 +572,53 @@ query_badblocks_checking(const char *path)
 	return query_feature(path, f_chkbb);
 }
 
+/*
+ * enable_part_grow -- (internal) enable POOL_FEAT_PART_GROW
+ */
+static int
+enable_part_grow(const char *path)
+{
+	struct pool_set *set = poolset_open(path, RW);
+	if (!set)
+		return -1;
+
+	if (require_feature_is(set, f_partgrow, DISABLED))
+		feature_set(set, f_partgrow, ENABLED);
+
+	poolset_close(set);
+
+	return 0;
+}
+
+/*
+ * disable_part_grow -- (internal) disable POOL_FEAT_PART_GROW
+ */
+static int
+disable_part_grow(const char *path)
+{
+	struct pool_set *set = poolset_open(path, RW);
+	if (!set)
+		return -1;
+
+	if (!require_feature_is(set, f_partgrow, ENABLED))
+		goto exit;
+
+	feature_set(set, f_partgrow, DISABLED);
+exit:
+	poolset_close(set);
+
+	return 0;
+}
+
+/*
+ * query_part_grow -- (internal) query POOL_FEAT_PART_GROW
+ */
+static int
+query_part_grow(const char *path)
+{
+	return query_feature(path, f_partgrow);
+}
+
 struct feature_funcs {
 	int (*enable)(const char *);
 	int (*disable)(const char *);
@@ -598,6 +646,11 @@ static struct feature_funcs features[] = {
 			.disable = disable_badblocks_checking,
 			.query = query_badblocks_checking
 		},
+		{
+			.enable = enable_part_grow,
+			.disable = disable_part_grow,
+			.query = query_part_grow
+		},
 };
 
 #define FEATURE_FUNCS_MAX ARRAY_SIZE(features)
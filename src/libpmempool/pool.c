@@ -29,6 +29,88 @@
 #include "check_util.h"
 #include "util_pmem.h"
 #include "mmap.h"
+#include "os_thread.h"
+
+/*
+ * minimum size worth splitting the pool copy across worker threads,
+ * the boundary the stripes are aligned to and the fan-out limit
+ */
+#define POOL_COPY_MIN_LEN (8UL << 20)
+#define POOL_COPY_ALIGN 4096UL
+#define POOL_COPY_MAX_THREADS 16U
+
+struct pool_copy_worker {
+	os_thread_t thread;
+	void *dst;
+	const void *src;
+	size_t len;
+};
+
+/*
+ * pool_copy_worker -- (internal) copy one stripe of the pool
+ */
+static void *
+pool_copy_worker(void *arg)
+{
+	struct pool_copy_worker *w = arg;
+
+	memcpy(w->dst, w->src, w->len);
+
+	return NULL;
+}
+
+/*
+ * pool_copy_data -- (internal) copy pool data, striped across worker
+ * threads when the pool is large enough to be worth it
+ */
+static void
+pool_copy_data(void *dst, const void *src, size_t len)
+{
+	static long cpus;
+
+	if (cpus == 0)
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	unsigned nthreads = cpus < 2 ? 1 : (unsigned)cpus;
+	if (nthreads > POOL_COPY_MAX_THREADS)
+		nthreads = POOL_COPY_MAX_THREADS;
+
+	if (len < POOL_COPY_MIN_LEN || nthreads < 2) {
+		memcpy(dst, src, len);
+		return;
+	}
+
+	struct pool_copy_worker workers[POOL_COPY_MAX_THREADS];
+	size_t stripe = (len / nthreads) & ~(POOL_COPY_ALIGN - 1);
+	unsigned started = 0;
+
+	for (unsigned i = 0; i < nthreads; i++) {
+		struct pool_copy_worker *w = &workers[i];
+
+		w->dst = (char *)dst + i * stripe;
+		w->src = (const char *)src + i * stripe;
+		w->len = stripe;
+
+		if (i == nthreads - 1) {
+			/* the last stripe is copied by this thread */
+			w->len = len - i * stripe;
+			pool_copy_worker(w);
+			break;
+		}
+
+		if (os_thread_create(&w->thread, NULL, pool_copy_worker, w)) {
+			/* on error copy everything left on this thread */
+			w->len = len - i * stripe;
+			pool_copy_worker(w);
+			break;
+		}
+
+		started++;
+	}
+
+	for (unsigned i = 0; i < started; i++)
+		os_thread_join(&workers[i].thread, NULL);
+}
 
 /*
  * pool_set_read_header -- (internal) read a header of a pool set
@@ -534,7 +616,7 @@ pool_copy(struct pool_data *pool, const char *dst_path, int overwrite)
 	}
 
 	void *saddr = pool_set_file_map(file, 0);
-	memcpy(daddr, saddr, file->size);
+	pool_copy_data(daddr, saddr, file->size);
 	munmap(daddr, file->size);
 
 out_close:
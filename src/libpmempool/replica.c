@@ -25,6 +25,7 @@
 #include "pool_hdr.h"
 #include "set.h"
 #include "util.h"
+#include "usc.h"
 #include "uuid.h"
 #include "shutdown_state.h"
 #include "badblocks.h"
@@ -1382,6 +1383,11 @@ check_shutdown_state(struct pool_set *set,
 	struct poolset_health_status *set_hs)
 {
 	LOG(3, "set %p, set_hs %p", set, set_hs);
+
+	/* one device context walk serves all parts of all replicas */
+	struct pmem2_usc_ctx *usc_ctx = NULL;
+	(void) pmem2_usc_ctx_new(&usc_ctx);
+
 	for (unsigned r = 0; r < set->nreplicas; ++r) {\
 		struct pool_replica *rep = set->replica[r];
 		struct replica_health_status *rep_hs = set_hs->replica[r];
@@ -1399,7 +1405,7 @@ check_shutdown_state(struct pool_set *set,
 			if (PART(rep, p)->fd < 0)
 				continue;
 
-			if (shutdown_state_add_part(&curr_sds,
+			if (shutdown_state_add_part(&curr_sds, usc_ctx,
 					PART(rep, p)->fd, NULL)) {
 				rep_hs->flags |= IS_BROKEN;
 				break;
@@ -1416,6 +1422,7 @@ check_shutdown_state(struct pool_set *set,
 			rep_hs->flags |= IS_BROKEN;
 
 	}
+	pmem2_usc_ctx_delete(&usc_ctx);
 	return 0;
 }
 
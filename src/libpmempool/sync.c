@@ -15,6 +15,7 @@
 
 #include "libpmem.h"
 #include "replica.h"
+#include "convert.h"
 #include "out.h"
 #include "os.h"
 #include "util_pmem.h"
@@ -22,6 +23,9 @@
 
 #define BB_DATA_STR "offset 0x%zx, length 0x%zx, nhealthy %i"
 
+/* granularity of the dirty-region diffing done by sync_copy_data() */
+#define SYNC_COPY_CHUNK (4UL << 20)
+
 /* defines 'struct bb_vec' - the vector of the 'struct bad_block' structures */
 VEC(bb_vec, struct bad_block);
 
@@ -61,14 +65,77 @@ err:
 	return -1;
 }
 
+/*
+ * sync_progress_file_alloc -- (internal) allocate the name of the copy
+ *                             progress file of one part, following the
+ *                             naming of the bad block recovery files;
+ *                             the name has to be freed using Free()
+ */
+static char *
+sync_progress_file_alloc(const char *file, unsigned rep, unsigned part)
+{
+	LOG(3, "file %s rep %u part %u", file, rep, part);
+
+	char suffix[64];
+	sprintf(suffix, "_r%u_p%u_sync-progress", rep, part);
+
+	char *path = Malloc(strlen(file) + strlen(suffix) + 1);
+	if (path == NULL) {
+		ERR_W_ERRNO("Malloc");
+		return NULL;
+	}
+
+	strcpy(path, file);
+	strcat(path, suffix);
+
+	return path;
+}
+
+struct sync_copy_ctx {
+	const struct pool_set_part *part;
+	uint64_t copied;
+};
+
+/*
+ * sync_copy_chunk -- (internal) copy one work item, skipping chunks that
+ *                    already match
+ *
+ * After a transient failure the stale replica still holds most of the
+ * data, and reading both sides is much cheaper than writing and
+ * persisting everything, so diffing turns a full-pool resync into a copy
+ * of the regions modified since the replica went away.  Freshly created
+ * parts are zero-filled, so for them the comparison only skips the
+ * zeroed regions of the source.
+ */
+static int
+sync_copy_chunk(void *dst, const void *src, size_t len, void *arg)
+{
+	struct sync_copy_ctx *ctx = arg;
+
+	if (memcmp(dst, src, len) == 0)
+		return 0;
+
+	memcpy(dst, src, len);
+	util_persist(ctx->part->is_dev_dax, dst, len);
+	util_fetch_and_add64(&ctx->copied, len);
+
+	return 0;
+}
+
 /*
  * sync_copy_data -- (internal) copy data from the healthy replica
  *                   to the broken one
+ *
+ * The copy runs through the conversion engine: chunk-sized work items
+ * fanned out across worker threads, paced by PMEMPOOL_CONVERT_BANDWIDTH
+ * and, when progress_path is not NULL, recorded in a progress file so an
+ * interrupted sync of a large pool resumes instead of starting over.
  */
 static int
 sync_copy_data(void *src_addr, void *dst_addr, size_t off, size_t len,
 		struct pool_replica *rep_h,
-		struct pool_replica *rep, const struct pool_set_part *part)
+		struct pool_replica *rep, const struct pool_set_part *part,
+		const char *progress_path)
 {
 	LOG(3, "src_addr %p dst_addr %p off %zu len %zu "
 		"rep_h %p rep %p part %p",
@@ -78,9 +145,35 @@ sync_copy_data(void *src_addr, void *dst_addr, size_t off, size_t len,
 		"copying data (offset 0x%zx length 0x%zx) from local replica -- '%s'",
 		off, len, rep_h->part[0].path);
 
-	/* copy all data */
-	memcpy(dst_addr, src_addr, len);
-	util_persist(part->is_dev_dax, dst_addr, len);
+	struct sync_copy_ctx ctx;
+	ctx.part = part;
+	ctx.copied = 0;
+
+	struct convert_job job;
+	memset(&job, 0, sizeof(job));
+	job.dst = dst_addr;
+	job.src = src_addr;
+	job.len = len;
+	job.chunk = SYNC_COPY_CHUNK;
+	job.apply = sync_copy_chunk;
+	job.arg = &ctx;
+
+	/*
+	 * The destination part file's identity ties leftover progress to
+	 * this very file - a part recreated since the interrupted sync
+	 * gets a fresh start.
+	 */
+	os_stat_t st;
+	if (progress_path != NULL && os_stat(part->path, &st) == 0) {
+		job.progress_path = progress_path;
+		job.cookie = (uint64_t)st.st_ino ^
+			((uint64_t)st.st_dev << 32) ^ off;
+	}
+
+	if (convert_run(&job) != 0)
+		return -1;
+
+	LOG(10, "copied 0x%zx out of 0x%zx bytes", (size_t)ctx.copied, len);
 
 	return 0;
 }
@@ -803,7 +896,8 @@ sync_badblocks_data(struct pool_set *set, struct poolset_health_status *set_hs)
 
 				if (sync_copy_data(src_addr, dst_addr,
 							part_off + off, len,
-							rep_h, rep, part))
+							rep_h, rep, part,
+							NULL))
 					return -1;
 			}
 
@@ -1090,8 +1184,14 @@ copy_data_to_broken_parts(struct pool_set *set, unsigned healthy_replica,
 			void *src_addr = ADDR_SUM(rep_h->part[0].addr, off);
 			void *dst_addr = ADDR_SUM(part->addr, fpoff);
 
-			if (sync_copy_data(src_addr, dst_addr, off, len,
-						rep_h, rep, part))
+			char *progress_path =
+				sync_progress_file_alloc(set->path, r, p);
+
+			int ret = sync_copy_data(src_addr, dst_addr, off, len,
+						rep_h, rep, part,
+						progress_path);
+			Free(progress_path);
+			if (ret)
 				return -1;
 		}
 	}
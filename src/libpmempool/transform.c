@@ -22,6 +22,31 @@
 #include "libpmem.h"
 #include "util_pmem.h"
 
+/* how often the data copy reports its progress */
+#define TRANSFORM_PROGRESS_STEP (1ULL << 30)
+
+/*
+ * transform_copy_report -- (internal) log progress and throughput of the
+ *                          data copy
+ */
+static void
+transform_copy_report(size_t copied, size_t len,
+		const struct timespec *start)
+{
+	struct timespec now;
+	if (os_clock_gettime(CLOCK_MONOTONIC, &now))
+		return;
+
+	double elapsed = (double)(now.tv_sec - start->tv_sec) +
+		(double)(now.tv_nsec - start->tv_nsec) / 1e9;
+	if (elapsed <= 0)
+		return;
+
+	LOG(2, "transform copy: %zu MiB of %zu MiB (%.0f MiB/s)",
+		copied >> 20, len >> 20,
+		(double)copied / ((1 << 20) * elapsed));
+}
+
 /*
  * poolset_compare_status - a helping structure for gathering corresponding
  *                          replica numbers when comparing poolsets
@@ -515,11 +540,32 @@ copy_replica_data_fw(struct pool_set *set_dst, struct pool_set *set_src,
 	void *src = PART(REP(set_src, repn), 1)->addr;
 	void *dst = PART(REP(set_dst, repn), 1)->addr;
 	size_t count = len / POOL_HDR_SIZE;
+
+	/*
+	 * The regions may overlap (both poolsets can be backed by the same
+	 * part files shifted by the headers), so the chunk order and size
+	 * must stay as they are.  The stores bypass the CPU cache and all
+	 * the chunks are completed with a single drain at the end - there
+	 * is no durability ordering to maintain between the chunks.
+	 */
+	struct timespec start;
+	int have_start = (os_clock_gettime(CLOCK_MONOTONIC, &start) == 0);
+	size_t copied = 0;
+	size_t next_report = TRANSFORM_PROGRESS_STEP;
+
 	while (count-- > 0) {
-		pmem_memcpy_persist(dst, src, POOL_HDR_SIZE);
+		pmem_memcpy(dst, src, POOL_HDR_SIZE,
+			PMEM_F_MEM_NONTEMPORAL | PMEM_F_MEM_NODRAIN);
 		src = ADDR_SUM(src, POOL_HDR_SIZE);
 		dst = ADDR_SUM(dst, POOL_HDR_SIZE);
+
+		copied += POOL_HDR_SIZE;
+		if (have_start && copied >= next_report) {
+			transform_copy_report(copied, len, &start);
+			next_report += TRANSFORM_PROGRESS_STEP;
+		}
 	}
+	pmem_drain();
 }
 
 /*
@@ -543,11 +589,26 @@ copy_replica_data_bw(struct pool_set *set_dst, struct pool_set *set_src,
 	size_t count = len / POOL_HDR_SIZE;
 	void *src = ADDR_SUM(PART(REP(set_src, repn), 1)->addr, len);
 	void *dst = ADDR_SUM(PART(REP(set_dst, repn), 1)->addr, len);
+
+	/* see the comment in copy_replica_data_fw() */
+	struct timespec start;
+	int have_start = (os_clock_gettime(CLOCK_MONOTONIC, &start) == 0);
+	size_t copied = 0;
+	size_t next_report = TRANSFORM_PROGRESS_STEP;
+
 	while (count-- > 0) {
 		src = ADDR_SUM(src, -(ssize_t)POOL_HDR_SIZE);
 		dst = ADDR_SUM(dst, -(ssize_t)POOL_HDR_SIZE);
-		pmem_memcpy_persist(dst, src, POOL_HDR_SIZE);
+		pmem_memcpy(dst, src, POOL_HDR_SIZE,
+			PMEM_F_MEM_NONTEMPORAL | PMEM_F_MEM_NODRAIN);
+
+		copied += POOL_HDR_SIZE;
+		if (have_start && copied >= next_report) {
+			transform_copy_report(copied, len, &start);
+			next_report += TRANSFORM_PROGRESS_STEP;
+		}
 	}
+	pmem_drain();
 }
 
 /*
@@ -244,6 +244,92 @@ test_le_basic()
 	critnib_delete(c);
 }
 
+static void
+test_ge_basic()
+{
+	struct critnib *c = critnib_new();
+#define INS(x) critnib_insert(c, (x), (void *)(x))
+	INS(1);
+	INS(2);
+	INS(3);
+	INS(4);
+	INS(0xf);
+	INS(0xe);
+	INS(0x11);
+	INS(0x12);
+	INS(0x20);
+#define GE(x, y) UT_ASSERTeq(critnib_find_ge(c, (x)), (void *)(y))
+	GE(1, 1);
+	GE(2, 2);
+	GE(5, 0xe);
+	GE(0x10, 0x11);
+	GE(0x12, 0x12);
+	GE(0x13, 0x20);
+	GE(0x20, 0x20);
+	GE(0x21, 0);
+#undef INS
+#undef GE
+	critnib_delete(c);
+}
+
+struct range_ctx {
+	uint64_t visited[64];
+	int nvisited;
+	uint64_t stop_after;
+};
+
+static int
+range_collect(uint64_t key, void *value, void *arg)
+{
+	struct range_ctx *ctx = arg;
+
+	UT_ASSERTeq((uint64_t)value, key);
+	ctx->visited[ctx->nvisited++] = key;
+
+	return ctx->stop_after != 0 && key >= ctx->stop_after;
+}
+
+static void
+test_range()
+{
+	struct critnib *c = critnib_new();
+	struct range_ctx ctx;
+#define INS(x) critnib_insert(c, (x), (void *)(x))
+	INS(1);
+	INS(3);
+	INS(0xe);
+	INS(0x11);
+	INS(0x20);
+	INS(0xFfffffffFFFFFFFF);
+
+	/* bounded range: only keys within [min, max], in ascending order */
+	memset(&ctx, 0, sizeof(ctx));
+	UT_ASSERTeq(critnib_range(c, 2, 0x11, range_collect, &ctx), 0);
+	UT_ASSERTeq(ctx.nvisited, 3);
+	UT_ASSERTeq(ctx.visited[0], 3);
+	UT_ASSERTeq(ctx.visited[1], 0xe);
+	UT_ASSERTeq(ctx.visited[2], 0x11);
+
+	/* full range, including the topmost key */
+	memset(&ctx, 0, sizeof(ctx));
+	UT_ASSERTeq(critnib_range(c, 0, UINT64_MAX, range_collect, &ctx), 0);
+	UT_ASSERTeq(ctx.nvisited, 6);
+	UT_ASSERTeq(ctx.visited[5], 0xFfffffffFFFFFFFF);
+
+	/* a nonzero callback return stops the iteration */
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.stop_after = 3;
+	UT_ASSERTeq(critnib_range(c, 0, UINT64_MAX, range_collect, &ctx), 1);
+	UT_ASSERTeq(ctx.nvisited, 2);
+
+	/* empty range */
+	memset(&ctx, 0, sizeof(ctx));
+	UT_ASSERTeq(critnib_range(c, 0x21, 0xff, range_collect, &ctx), 0);
+	UT_ASSERTeq(ctx.nvisited, 0);
+#undef INS
+	critnib_delete(c);
+}
+
 /*
  * Spread the bits somehow -- more than a few (4 here) children per node
  * is unlikely to bring interested cases.  This function leaves two bits
@@ -287,6 +373,12 @@ test_le_brute()
 				(uint64_t)critnib_find_le(c, expand_bits(w));
 			uint64_t exp = (v >= 0) ? expand_bits(v) : 0;
 			UT_ASSERTeq(res, exp);
+
+			for (v = w; v <= 0xffff && !ws[v]; v++)
+				;
+			res = (uint64_t)critnib_find_ge(c, expand_bits(w));
+			exp = (v <= 0xffff) ? expand_bits(v) : 0;
+			UT_ASSERTeq(res, exp);
 		}
 	}
 
@@ -385,6 +477,8 @@ main(int argc, char *argv[])
 	test_ffffffff_and_friends();
 	test_insert_delete_random();
 	test_le_basic();
+	test_ge_basic();
+	test_range();
 	test_le_brute();
 	test_same_only();
 	test_same_two();
@@ -227,7 +227,7 @@ do_fault_injection_heap_boot()
 	pmemobj_inject_fault_at(PMEM_MALLOC, 1, "heap_boot");
 
 	int r = heap_boot(NULL, NULL, heap_size, &pop->heap_size, NULL, p_ops,
-			NULL, NULL);
+			NULL, NULL, 0);
 	UT_ASSERTne(r, 0);
 	UT_ASSERTeq(errno, ENOMEM);
 }
@@ -303,6 +303,7 @@ test_heap(void)
 
 	struct stats *s = stats_new(pop);
 	UT_ASSERTne(s, NULL);
+	pop->stats = s;
 
 	void *heap_start = (char *)pop + pop->heap_offset;
 	uint64_t heap_size = MOCK_POOL_SIZE - sizeof(PMEMobjpool);
@@ -314,7 +315,7 @@ test_heap(void)
 		&pop->heap_size, p_ops) == 0);
 	UT_ASSERT(heap_boot(heap, heap_start, heap_size,
 		&pop->heap_size,
-		pop, p_ops, s, pop->set) == 0);
+		pop, p_ops, s, pop->set, 0) == 0);
 	UT_ASSERT(heap_buckets_init(heap) == 0);
 	UT_ASSERT(pop->heap.rt != NULL);
 
@@ -417,7 +418,7 @@ test_heap_with_size()
 		&pop->heap_size, p_ops) == 0);
 	UT_ASSERT(heap_boot(heap, heap_start, heap_size,
 		&pop->heap_size,
-		pop, p_ops, NULL, pop->set) == 0);
+		pop, p_ops, NULL, pop->set, 0) == 0);
 	UT_ASSERT(heap_buckets_init(heap) == 0);
 	UT_ASSERT(pop->heap.rt != NULL);
 
@@ -473,13 +474,14 @@ test_recycler(void)
 
 	struct stats *s = stats_new(pop);
 	UT_ASSERTne(s, NULL);
+	pop->stats = s;
 
 	UT_ASSERT(heap_check(heap_start, heap_size) != 0);
 	UT_ASSERT(heap_init(heap_start, heap_size,
 		&pop->heap_size, p_ops) == 0);
 	UT_ASSERT(heap_boot(heap, heap_start, heap_size,
 		&pop->heap_size,
-		pop, p_ops, s, pop->set) == 0);
+		pop, p_ops, s, pop->set, 0) == 0);
 	UT_ASSERT(heap_buckets_init(heap) == 0);
 	UT_ASSERT(pop->heap.rt != NULL);
 
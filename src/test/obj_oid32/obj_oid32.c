@@ -0,0 +1,233 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2024, Intel Corporation */
+
+/*
+ * obj_oid32.c -- unit test for compressed persistent pointers
+ *
+ * Scenario 0 registers enough objects to span two segments of the handle
+ * table, releases a few handles and reopens the pool cleanly, verifying the
+ * open-time rebuild of the volatile reverse map (same object, same handle)
+ * and of the free handle stack (released handles are reused before fresh
+ * ones, the high watermark survives). Scenarios 1 and 2 kill the process
+ * right after the handle directory, respectively a segment, is allocated
+ * but before any handle is published, and verify the grown table is usable
+ * after the crash.
+ */
+#include "pmalloc.h"
+#include "unittest.h"
+
+#define LAYOUT_NAME "obj_oid32"
+
+/* enough objects for the handles to spill into a second segment */
+#define SEG_ENTRIES 4096
+#define NOBJS (SEG_ENTRIES + 4)
+
+#define OBJ_SIZE 64
+
+struct root {
+	PMEMoid oids[NOBJS];
+	PMEMoid extra[8];
+};
+
+/* number of mocked allocations to let through before exiting, 0 - disabled */
+static int Constructs_until_exit;
+
+FUNC_MOCK(pmalloc_construct, int, PMEMobjpool *pop, uint64_t *off,
+	size_t size, palloc_constr constructor, void *arg,
+	uint64_t extra_field, uint16_t object_flags, uint16_t class_id)
+	FUNC_MOCK_RUN_DEFAULT {
+		int ret = _FUNC_REAL(pmalloc_construct)(pop, off, size,
+			constructor, arg, extra_field, object_flags, class_id);
+		if (Constructs_until_exit > 0 && --Constructs_until_exit == 0)
+			exit(0);
+		return ret;
+	}
+FUNC_MOCK_END
+
+/*
+ * root_get -- returns the root object, allocating it on first use
+ */
+static struct root *
+root_get(PMEMobjpool *pop)
+{
+	PMEMoid root = pmemobj_root(pop, sizeof(struct root));
+	UT_ASSERT(!OID_IS_NULL(root));
+
+	return pmemobj_direct(root);
+}
+
+/*
+ * alloc_obj -- allocates one test object
+ */
+static void
+alloc_obj(PMEMobjpool *pop, PMEMoid *oidp)
+{
+	int ret = pmemobj_zalloc(pop, oidp, OBJ_SIZE, 0);
+	UT_ASSERTeq(ret, 0);
+}
+
+/*
+ * test_create_rebuild -- registers two segments worth of handles, pokes
+ *	holes into the handle space and closes the pool cleanly
+ */
+static void
+test_create_rebuild(PMEMobjpool *pop)
+{
+	struct root *rootp = root_get(pop);
+
+	/* an object from a different pool gets no handle */
+	errno = 0;
+	UT_ASSERTeq(pmemobj_oid32(pop, OID_NULL), 0);
+	UT_ASSERTeq(errno, EINVAL);
+
+	for (uint32_t n = 0; n < NOBJS; ++n) {
+		alloc_obj(pop, &rootp->oids[n]);
+		UT_ASSERTeq(pmemobj_oid32(pop, rootp->oids[n]), n + 1);
+	}
+
+	/* registering the same object again yields the same handle */
+	UT_ASSERTeq(pmemobj_oid32(pop, rootp->oids[0]), 1);
+
+	/* translation across the segment boundary */
+	UT_ASSERTeq(pmemobj_oid32_direct(pop, SEG_ENTRIES),
+		pmemobj_direct(rootp->oids[SEG_ENTRIES - 1]));
+	UT_ASSERTeq(pmemobj_oid32_direct(pop, SEG_ENTRIES + 1),
+		pmemobj_direct(rootp->oids[SEG_ENTRIES]));
+
+	/* handles that map no object */
+	UT_ASSERTeq(pmemobj_oid32_direct(pop, 0), NULL);
+	UT_ASSERTeq(pmemobj_oid32_direct(pop, UINT32_MAX), NULL);
+
+	/* a released handle is reused before a fresh one */
+	pmemobj_oid32_release(pop, 10);
+	UT_ASSERTeq(pmemobj_oid32_direct(pop, 10), NULL);
+	alloc_obj(pop, &rootp->extra[0]);
+	UT_ASSERTeq(pmemobj_oid32(pop, rootp->extra[0]), 10);
+
+	/* holes in both segments, left for the reopen to rebuild */
+	pmemobj_oid32_release(pop, 3);
+	pmemobj_oid32_release(pop, 6);
+	pmemobj_oid32_release(pop, SEG_ENTRIES + 2);
+	/* releasing twice is a no-op */
+	pmemobj_oid32_release(pop, 3);
+
+	UT_ASSERTeq(pmemobj_oid32_direct(pop, 3), NULL);
+	UT_ASSERTeq(pmemobj_oid32_direct(pop, 6), NULL);
+	UT_ASSERTeq(pmemobj_oid32_direct(pop, SEG_ENTRIES + 2), NULL);
+
+	pmemobj_close(pop);
+}
+
+/*
+ * test_open_rebuild -- verifies the rebuilt reverse map and free stack
+ */
+static void
+test_open_rebuild(PMEMobjpool *pop)
+{
+	struct root *rootp = root_get(pop);
+
+	/* live handles still translate after the reopen */
+	UT_ASSERTeq(pmemobj_oid32_direct(pop, 1),
+		pmemobj_direct(rootp->oids[0]));
+	UT_ASSERTeq(pmemobj_oid32_direct(pop, SEG_ENTRIES + 1),
+		pmemobj_direct(rootp->oids[SEG_ENTRIES]));
+	UT_ASSERTeq(pmemobj_oid32_direct(pop, 10),
+		pmemobj_direct(rootp->extra[0]));
+
+	/* released handles still map nothing */
+	UT_ASSERTeq(pmemobj_oid32_direct(pop, 3), NULL);
+	UT_ASSERTeq(pmemobj_oid32_direct(pop, 6), NULL);
+	UT_ASSERTeq(pmemobj_oid32_direct(pop, SEG_ENTRIES + 2), NULL);
+
+	/* the reverse map knows the old objects again */
+	UT_ASSERTeq(pmemobj_oid32(pop, rootp->oids[1]), 2);
+	UT_ASSERTeq(pmemobj_oid32(pop, rootp->extra[0]), 10);
+
+	/*
+	 * The rebuilt free stack holds the gaps below the high watermark in
+	 * index order, so fresh registrations drain them top down before a
+	 * never-assigned handle is handed out.
+	 */
+	uint32_t expected[] = { SEG_ENTRIES + 2, 6, 3, NOBJS + 1 };
+	for (unsigned n = 0; n < 4; ++n) {
+		alloc_obj(pop, &rootp->extra[1 + n]);
+		UT_ASSERTeq(pmemobj_oid32(pop, rootp->extra[1 + n]),
+			expected[n]);
+		UT_ASSERTeq(pmemobj_oid32_direct(pop, expected[n]),
+			pmemobj_direct(rootp->extra[1 + n]));
+	}
+
+	pmemobj_close(pop);
+}
+
+/*
+ * test_create_growth -- dies right after the directory or a segment is
+ *	allocated, before the first handle is published
+ */
+static void
+test_create_growth(PMEMobjpool *pop, int scenario)
+{
+	struct root *rootp = root_get(pop);
+
+	alloc_obj(pop, &rootp->oids[0]);
+
+	/* the first assignment allocates the directory, then a segment */
+	Constructs_until_exit = scenario == 1 ? 1 : 2;
+	pmemobj_oid32(pop, rootp->oids[0]);
+
+	/* if we get here, something is wrong with function mocking */
+	UT_ASSERT(0);
+}
+
+/*
+ * test_open_growth -- verifies the half-grown table is empty but usable
+ */
+static void
+test_open_growth(PMEMobjpool *pop)
+{
+	struct root *rootp = root_get(pop);
+
+	/* nothing was published into the grown table */
+	UT_ASSERTeq(pmemobj_oid32_direct(pop, 1), NULL);
+
+	UT_ASSERTeq(pmemobj_oid32(pop, rootp->oids[0]), 1);
+	UT_ASSERTeq(pmemobj_oid32_direct(pop, 1),
+		pmemobj_direct(rootp->oids[0]));
+
+	pmemobj_close(pop);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_oid32");
+
+	if (argc != 4)
+		UT_FATAL("usage: %s file [cmd: c/o] [scenario]", argv[0]);
+
+	const char *path = argv[1];
+	int exists = argv[2][0] == 'o';
+	int scenario = atoi(argv[3]);
+
+	PMEMobjpool *pop;
+	if (!exists) {
+		if ((pop = pmemobj_create(path, LAYOUT_NAME, 0,
+				S_IWUSR | S_IRUSR)) == NULL)
+			UT_FATAL("!pmemobj_create: %s", path);
+
+		if (scenario == 0)
+			test_create_rebuild(pop);
+		else
+			test_create_growth(pop, scenario);
+	} else {
+		if ((pop = pmemobj_open(path, LAYOUT_NAME)) == NULL)
+			UT_FATAL("!pmemobj_open: %s", path);
+
+		if (scenario == 0)
+			test_open_rebuild(pop);
+		else
+			test_open_growth(pop);
+	}
+
+	DONE(NULL);
+}
@@ -9,6 +9,7 @@
 #include "heap.h"
 #include "obj.h"
 #include "pmalloc.h"
+#include "tx.h"
 #include "unittest.h"
 #include "valgrind_internal.h"
 #include "set.h"
@@ -279,11 +280,15 @@ test_mock_pool_allocs(void)
 
 	struct stats *s = stats_new(mock_pop);
 	UT_ASSERTne(s, NULL);
+	mock_pop->stats = s;
+
+	mock_pop->tx_params = tx_params_new();
+	UT_ASSERTne(mock_pop->tx_params, NULL);
 
 	heap_init(heap_start, heap_size, &mock_pop->heap_size,
 		&mock_pop->p_ops);
 	heap_boot(&mock_pop->heap, heap_start, heap_size, &mock_pop->heap_size,
-		mock_pop, &mock_pop->p_ops, s, mock_pop->set);
+		mock_pop, &mock_pop->p_ops, s, mock_pop->set, 0);
 	heap_buckets_init(&mock_pop->heap);
 
 	/* initialize runtime lanes structure */
@@ -332,6 +337,7 @@ test_mock_pool_allocs(void)
 	test_realloc(TEST_HUGE_ALLOC_SIZE, TEST_MEGA_ALLOC_SIZE);
 
 	stats_delete(mock_pop, s);
+	tx_params_delete(mock_pop->tx_params);
 	lane_cleanup(mock_pop);
 	heap_cleanup(&mock_pop->heap);
 
@@ -0,0 +1,265 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2024, Intel Corporation */
+
+/*
+ * obj_ringbuf.c -- unit test for the persistent ring buffer
+ *
+ * The create phase exercises the enqueue/dequeue API and then exits with
+ * the buffer in the state left behind by a producer interrupted mid-append:
+ * an uncommitted slot followed by a committed record. The open phase checks
+ * that recovery trims the producer position at the gap and that the record
+ * committed after the gap can never reach the consumer.
+ */
+#include "ringbuf.h"
+#include "unittest.h"
+
+#define LAYOUT_NAME "obj_ringbuf"
+
+#define TEST_ENTRY_SIZE 64
+/* requested capacity, rounded up to a power of two by the constructor */
+#define TEST_ENTRIES 7
+#define TEST_CAPACITY 8
+
+struct root {
+	PMEMoid rb;
+};
+
+/*
+ * slot_at -- returns the slot assigned to an absolute position
+ */
+static struct ringbuf_slot *
+slot_at(struct ringbuf *rb, uint64_t pos)
+{
+	size_t stride = sizeof(struct ringbuf_slot) +
+		ALIGN_UP((size_t)rb->entry_size, sizeof(uint64_t));
+
+	return (struct ringbuf_slot *)(rb->slots +
+		(pos & (rb->nentries - 1)) * stride);
+}
+
+/*
+ * record_fill -- fills a record with a pattern derived from its id
+ */
+static size_t
+record_fill(uint8_t *buf, int id)
+{
+	size_t len = 1 + (size_t)(id % TEST_ENTRY_SIZE);
+	for (size_t i = 0; i < len; ++i)
+		buf[i] = (uint8_t)(id * 17 + (int)i);
+
+	return len;
+}
+
+struct checker {
+	int next_id;	/* id expected from the next record */
+	size_t seen;	/* records handed to the callback so far */
+	size_t stop_after;	/* end the batch after that many records */
+};
+
+/*
+ * record_check -- dequeue callback verifying record content and order
+ */
+static int
+record_check(const void *data, size_t len, void *arg)
+{
+	struct checker *c = arg;
+
+	uint8_t expected[TEST_ENTRY_SIZE];
+	size_t expected_len = record_fill(expected, c->next_id);
+
+	UT_ASSERTeq(len, expected_len);
+	UT_ASSERTeq(memcmp(data, expected, len), 0);
+
+	c->next_id++;
+	c->seen++;
+
+	return c->stop_after != 0 && c->seen == c->stop_after;
+}
+
+/*
+ * dequeue_expect -- consumes a batch and verifies its length and content
+ */
+static void
+dequeue_expect(PMEMobjpool *pop, PMEMoid rb, size_t max, int first_id,
+	size_t nrecords, size_t stop_after)
+{
+	struct checker c;
+	c.next_id = first_id;
+	c.seen = 0;
+	c.stop_after = stop_after;
+
+	size_t consumed = pmemobj_ringbuf_dequeue(pop, rb, max,
+		record_check, &c);
+
+	UT_ASSERTeq(consumed, nrecords);
+	UT_ASSERTeq(c.seen, nrecords);
+}
+
+/*
+ * enqueue_record -- appends a record with the pattern of the given id
+ */
+static void
+enqueue_record(PMEMobjpool *pop, PMEMoid rb, int id)
+{
+	uint8_t buf[TEST_ENTRY_SIZE];
+	size_t len = record_fill(buf, id);
+
+	int ret = pmemobj_ringbuf_enqueue(pop, rb, buf, len);
+	UT_ASSERTeq(ret, 0);
+}
+
+/*
+ * fabricate_record -- writes a record directly into a slot
+ *
+ * With a zero seq the slot looks like an append interrupted after the data
+ * was written but before the commit, with a nonzero seq like a record a
+ * faster producer committed at a higher position.
+ */
+static void
+fabricate_record(PMEMobjpool *pop, struct ringbuf *rb, uint64_t pos, int id,
+	uint64_t seq)
+{
+	struct ringbuf_slot *slot = slot_at(rb, pos);
+
+	slot->len = record_fill(slot->data, id);
+	if (seq != 0)
+		slot->seq = seq;
+	pmemobj_persist(pop, slot, sizeof(*slot) + slot->len);
+}
+
+/*
+ * test_create -- exercises the API and exits with an interrupted append
+ */
+static void
+test_create(const char *path)
+{
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT_NAME, 0,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	PMEMoid root = pmemobj_root(pop, sizeof(struct root));
+	struct root *rootp = pmemobj_direct(root);
+
+	/* parameter validation */
+	errno = 0;
+	UT_ASSERTeq(pmemobj_ringbuf_new(pop, NULL, TEST_ENTRY_SIZE,
+		TEST_ENTRIES, 0), -1);
+	UT_ASSERTeq(errno, EINVAL);
+	errno = 0;
+	UT_ASSERTeq(pmemobj_ringbuf_new(pop, &rootp->rb, 0,
+		TEST_ENTRIES, 0), -1);
+	UT_ASSERTeq(errno, EINVAL);
+	errno = 0;
+	UT_ASSERTeq(pmemobj_ringbuf_new(pop, &rootp->rb, TEST_ENTRY_SIZE,
+		0, 0), -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	UT_ASSERTeq(pmemobj_ringbuf_new(pop, &rootp->rb, TEST_ENTRY_SIZE,
+		TEST_ENTRIES, 0), 0);
+	UT_ASSERT(!OID_IS_NULL(rootp->rb));
+
+	struct ringbuf *rb = pmemobj_direct(rootp->rb);
+	UT_ASSERTeq(rb->nentries, TEST_CAPACITY);
+	UT_ASSERTeq(rb->entry_size, TEST_ENTRY_SIZE);
+
+	/* record length validation */
+	uint8_t buf[TEST_ENTRY_SIZE + 1];
+	memset(buf, 0, sizeof(buf));
+	errno = 0;
+	UT_ASSERTeq(pmemobj_ringbuf_enqueue(pop, rootp->rb, buf, 0), -1);
+	UT_ASSERTeq(errno, EINVAL);
+	errno = 0;
+	UT_ASSERTeq(pmemobj_ringbuf_enqueue(pop, rootp->rb, buf,
+		TEST_ENTRY_SIZE + 1), -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	int id = 0;
+
+	/* a batch limited by max and the remainder */
+	for (; id < 3; ++id)
+		enqueue_record(pop, rootp->rb, id);
+	dequeue_expect(pop, rootp->rb, 2, 0, 2, 0);
+	dequeue_expect(pop, rootp->rb, 0, 2, 1, 0);
+
+	/* fill to capacity */
+	for (; id < 3 + TEST_CAPACITY; ++id)
+		enqueue_record(pop, rootp->rb, id);
+	errno = 0;
+	UT_ASSERTeq(pmemobj_ringbuf_enqueue(pop, rootp->rb, buf, 1), -1);
+	UT_ASSERTeq(errno, EAGAIN);
+	dequeue_expect(pop, rootp->rb, 0, 3, TEST_CAPACITY, 0);
+
+	/* a few laps around the ring - stale sequence numbers never match */
+	for (; id < 35; ++id) {
+		enqueue_record(pop, rootp->rb, id);
+		dequeue_expect(pop, rootp->rb, 0, id, 1, 0);
+	}
+
+	/* a batch ended early by the callback and the remainder */
+	for (; id < 39; ++id)
+		enqueue_record(pop, rootp->rb, id);
+	dequeue_expect(pop, rootp->rb, 0, 35, 2, 2);
+	dequeue_expect(pop, rootp->rb, 0, 37, 2, 0);
+
+	/*
+	 * The interrupted append: a committed record at position 39, a torn
+	 * one at position 40 and one a faster producer committed at position
+	 * 41 before the crash.
+	 */
+	enqueue_record(pop, rootp->rb, 39);
+	fabricate_record(pop, rb, 40, 40, 0);
+	fabricate_record(pop, rb, 41, 41, 42);
+
+	/* simulate a crash - the volatile producer position is lost */
+	exit(0);
+}
+
+/*
+ * test_open -- verifies recovery from the interrupted append
+ */
+static void
+test_open(const char *path)
+{
+	PMEMobjpool *pop = pmemobj_open(path, LAYOUT_NAME);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	PMEMoid root = pmemobj_root(pop, sizeof(struct root));
+	struct root *rootp = pmemobj_direct(root);
+	UT_ASSERT(!OID_IS_NULL(rootp->rb));
+
+	/* the consumer stops at the gap left by the torn append */
+	dequeue_expect(pop, rootp->rb, 0, 39, 1, 0);
+
+	/*
+	 * The first append recovers the producer position, which must land
+	 * on the torn slot, and release the record committed above the gap -
+	 * the new record has to be the only one the consumer receives.
+	 */
+	enqueue_record(pop, rootp->rb, 100);
+	dequeue_expect(pop, rootp->rb, 0, 100, 1, 0);
+
+	/* the recovered buffer still handles a full lap */
+	for (int id = 101; id < 101 + TEST_CAPACITY; ++id)
+		enqueue_record(pop, rootp->rb, id);
+	dequeue_expect(pop, rootp->rb, 0, 101, TEST_CAPACITY, 0);
+
+	pmemobj_close(pop);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_ringbuf");
+
+	if (argc != 3)
+		UT_FATAL("usage: %s file [cmd: c/o]", argv[0]);
+
+	if (argv[2][0] == 'c')
+		test_create(argv[1]);
+	else
+		test_open(argv[1]);
+
+	DONE(NULL);
+}
@@ -0,0 +1,272 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2024, Intel Corporation */
+
+/*
+ * obj_stack.c -- unit test for the persistent stack
+ *
+ * The create phase exercises the push/pop API and then exits inside a pop
+ * callback, with an in-flight push fabricated below a record another pusher
+ * committed above it. The open phase checks that recovery replays the record
+ * whose pop was interrupted - pops are at-least-once - and that the record
+ * committed above the gap is released, never reaching another pop.
+ */
+#include "stack.h"
+#include "unittest.h"
+
+#define LAYOUT_NAME "obj_stack"
+
+#define TEST_ENTRY_SIZE 64
+#define TEST_ENTRIES 8
+
+struct root {
+	PMEMoid st;
+};
+
+/*
+ * slot_at -- returns the slot at the given position
+ */
+static struct stack_slot *
+slot_at(struct pstack *st, uint64_t pos)
+{
+	size_t stride = sizeof(struct stack_slot) +
+		ALIGN_UP((size_t)st->entry_size, sizeof(uint64_t));
+
+	return (struct stack_slot *)(st->slots + pos * stride);
+}
+
+/*
+ * record_fill -- fills a record with a pattern derived from its id
+ */
+static size_t
+record_fill(uint8_t *buf, int id)
+{
+	size_t len = 1 + (size_t)(id % TEST_ENTRY_SIZE);
+	for (size_t i = 0; i < len; ++i)
+		buf[i] = (uint8_t)(id * 17 + (int)i);
+
+	return len;
+}
+
+struct checker {
+	int next_id;	/* id expected from the next record, newest-first */
+	size_t seen;	/* records handed to the callback so far */
+	size_t stop_after;	/* end the batch after that many records */
+	int exit_on_first;	/* simulate a crash inside the callback */
+};
+
+/*
+ * record_check -- pop callback verifying record content and LIFO order
+ */
+static int
+record_check(const void *data, size_t len, void *arg)
+{
+	struct checker *c = arg;
+
+	uint8_t expected[TEST_ENTRY_SIZE];
+	size_t expected_len = record_fill(expected, c->next_id);
+
+	UT_ASSERTeq(len, expected_len);
+	UT_ASSERTeq(memcmp(data, expected, len), 0);
+
+	if (c->exit_on_first)
+		exit(0);
+
+	c->next_id--;
+	c->seen++;
+
+	return c->stop_after != 0 && c->seen == c->stop_after;
+}
+
+/*
+ * pop_expect -- pops a batch and verifies its length and content
+ */
+static void
+pop_expect(PMEMobjpool *pop, PMEMoid st, size_t max, int first_id,
+	size_t nrecords, size_t stop_after)
+{
+	struct checker c;
+	c.next_id = first_id;
+	c.seen = 0;
+	c.stop_after = stop_after;
+	c.exit_on_first = 0;
+
+	size_t consumed = pmemobj_stack_pop(pop, st, max, record_check, &c);
+
+	UT_ASSERTeq(consumed, nrecords);
+	UT_ASSERTeq(c.seen, nrecords);
+}
+
+/*
+ * push_record -- pushes a record with the pattern of the given id
+ */
+static void
+push_record(PMEMobjpool *pop, PMEMoid st, int id)
+{
+	uint8_t buf[TEST_ENTRY_SIZE];
+	size_t len = record_fill(buf, id);
+
+	int ret = pmemobj_stack_push(pop, st, buf, len);
+	UT_ASSERTeq(ret, 0);
+}
+
+/*
+ * fabricate_record -- writes a record directly into a slot
+ *
+ * With a zero seq the slot looks like a push interrupted after the data was
+ * written but before the commit, with a nonzero seq like a record another
+ * pusher committed at a higher position before the crash.
+ */
+static void
+fabricate_record(PMEMobjpool *pop, struct pstack *st, uint64_t pos, int id,
+	uint64_t seq)
+{
+	struct stack_slot *slot = slot_at(st, pos);
+
+	slot->len = record_fill(slot->data, id);
+	if (seq != 0)
+		slot->seq = seq;
+	pmemobj_persist(pop, slot, sizeof(*slot) + slot->len);
+}
+
+/*
+ * test_create -- exercises the API and exits inside a pop callback
+ */
+static void
+test_create(const char *path)
+{
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT_NAME, 0,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	PMEMoid root = pmemobj_root(pop, sizeof(struct root));
+	struct root *rootp = pmemobj_direct(root);
+
+	/* parameter validation */
+	errno = 0;
+	UT_ASSERTeq(pmemobj_stack_new(pop, NULL, TEST_ENTRY_SIZE,
+		TEST_ENTRIES, 0), -1);
+	UT_ASSERTeq(errno, EINVAL);
+	errno = 0;
+	UT_ASSERTeq(pmemobj_stack_new(pop, &rootp->st, 0, TEST_ENTRIES, 0),
+		-1);
+	UT_ASSERTeq(errno, EINVAL);
+	errno = 0;
+	UT_ASSERTeq(pmemobj_stack_new(pop, &rootp->st, TEST_ENTRY_SIZE,
+		0, 0), -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	UT_ASSERTeq(pmemobj_stack_new(pop, &rootp->st, TEST_ENTRY_SIZE,
+		TEST_ENTRIES, 0), 0);
+	UT_ASSERT(!OID_IS_NULL(rootp->st));
+
+	struct pstack *st = pmemobj_direct(rootp->st);
+	UT_ASSERTeq(st->nentries, TEST_ENTRIES);
+	UT_ASSERTeq(st->entry_size, TEST_ENTRY_SIZE);
+
+	/* record length validation */
+	uint8_t buf[TEST_ENTRY_SIZE + 1];
+	memset(buf, 0, sizeof(buf));
+	errno = 0;
+	UT_ASSERTeq(pmemobj_stack_push(pop, rootp->st, buf, 0), -1);
+	UT_ASSERTeq(errno, EINVAL);
+	errno = 0;
+	UT_ASSERTeq(pmemobj_stack_push(pop, rootp->st, buf,
+		TEST_ENTRY_SIZE + 1), -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	/* a batch limited by max and the remainder, newest-first */
+	for (int id = 0; id < 3; ++id)
+		push_record(pop, rootp->st, id);
+	pop_expect(pop, rootp->st, 2, 2, 2, 0);
+	pop_expect(pop, rootp->st, 0, 0, 1, 0);
+
+	/* fill to capacity */
+	for (int id = 10; id < 10 + TEST_ENTRIES; ++id)
+		push_record(pop, rootp->st, id);
+	errno = 0;
+	UT_ASSERTeq(pmemobj_stack_push(pop, rootp->st, buf, 1), -1);
+	UT_ASSERTeq(errno, EAGAIN);
+	pop_expect(pop, rootp->st, 0, 10 + TEST_ENTRIES - 1, TEST_ENTRIES, 0);
+
+	/* a batch ended early by the callback and the remainder */
+	for (int id = 20; id < 24; ++id)
+		push_record(pop, rootp->st, id);
+	pop_expect(pop, rootp->st, 0, 23, 2, 2);
+	pop_expect(pop, rootp->st, 0, 21, 2, 0);
+
+	/* slot reuse across a few push/pop rounds */
+	for (int round = 0; round < 4; ++round) {
+		for (int id = 30; id < 33; ++id)
+			push_record(pop, rootp->st, id);
+		pop_expect(pop, rootp->st, 0, 32, 3, 0);
+	}
+
+	/*
+	 * The crash state: two committed records, an in-flight push at
+	 * position 2 and a record another pusher committed at position 3
+	 * above it before the crash.
+	 */
+	push_record(pop, rootp->st, 200);
+	push_record(pop, rootp->st, 201);
+	fabricate_record(pop, st, 2, 202, 0);
+	fabricate_record(pop, st, 3, 203, 4);
+
+	/* crash inside the pop callback, before the slot is released */
+	struct checker c;
+	c.next_id = 201;
+	c.seen = 0;
+	c.stop_after = 0;
+	c.exit_on_first = 1;
+	pmemobj_stack_pop(pop, rootp->st, 1, record_check, &c);
+
+	/* if we get here, the callback did not run */
+	UT_ASSERT(0);
+}
+
+/*
+ * test_open -- verifies recovery from the interrupted push and pop
+ */
+static void
+test_open(const char *path)
+{
+	PMEMobjpool *pop = pmemobj_open(path, LAYOUT_NAME);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	PMEMoid root = pmemobj_root(pop, sizeof(struct root));
+	struct root *rootp = pmemobj_direct(root);
+	UT_ASSERT(!OID_IS_NULL(rootp->st));
+
+	/*
+	 * The record whose pop was interrupted is still committed and has to
+	 * be replayed - pops are at-least-once. The torn record and the one
+	 * committed above the gap must never surface.
+	 */
+	pop_expect(pop, rootp->st, 0, 201, 2, 0);
+	pop_expect(pop, rootp->st, 0, 0, 0, 0);
+
+	/* the released above-gap slot accepts new pushes again */
+	for (int id = 100; id < 100 + TEST_ENTRIES; ++id)
+		push_record(pop, rootp->st, id);
+	pop_expect(pop, rootp->st, 0, 100 + TEST_ENTRIES - 1,
+		TEST_ENTRIES, 0);
+
+	pmemobj_close(pop);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_stack");
+
+	if (argc != 3)
+		UT_FATAL("usage: %s file [cmd: c/o]", argv[0]);
+
+	if (argv[2][0] == 'c')
+		test_create(argv[1]);
+	else
+		test_open(argv[1]);
+
+	DONE(NULL);
+}
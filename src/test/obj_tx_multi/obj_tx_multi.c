@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2024, Intel Corporation */
+
+/*
+ * obj_tx_multi.c -- unit test for coupled transaction crash recovery
+ *
+ * A coupled transaction gates the secondary pool's undo log on the primary's
+ * commit record before that record is made durable, and disarms the gate
+ * after. The create phase kills the process in one of the two windows this
+ * opens: before the primary's commit record is published (the transaction
+ * must roll back in both pools) or right after (it must commit in both).
+ * The open phase settles the gate with pmemobj_tx_multi_recover() and
+ * verifies the expected resolution.
+ */
+#include "palloc.h"
+#include "unittest.h"
+
+#define LAYOUT_NAME "obj_tx_multi"
+
+#define VAL_OLD 0x1111111111111111
+#define VAL_NEW 0x2222222222222222
+#define VAL_POST 0x3333333333333333
+
+struct root {
+	uint64_t val;
+};
+
+/* 0 - pass through, 1 - exit before publishing, 2 - exit after publishing */
+static int Exit_at;
+
+FUNC_MOCK(palloc_publish, void, struct palloc_heap *heap,
+	struct pobj_action *actv, size_t actvcnt,
+	struct operation_context *ctx)
+	FUNC_MOCK_RUN_DEFAULT {
+		if (Exit_at == 1)
+			exit(0);
+		_FUNC_REAL(palloc_publish)(heap, actv, actvcnt, ctx);
+		if (Exit_at == 2)
+			exit(0);
+	}
+FUNC_MOCK_END
+
+/*
+ * root_val -- returns a pointer to the value in the pool's root object
+ */
+static uint64_t *
+root_val(PMEMobjpool *pop)
+{
+	PMEMoid root = pmemobj_root(pop, sizeof(struct root));
+	UT_ASSERT(!OID_IS_NULL(root));
+
+	return &((struct root *)pmemobj_direct(root))->val;
+}
+
+/*
+ * set_both -- sets the value in both roots within one coupled transaction
+ */
+static void
+set_both(PMEMobjpool *pop1, PMEMobjpool *pop2, uint64_t val)
+{
+	UT_ASSERTeq(pmemobj_tx_begin_multi(pop1, pop2, NULL,
+		TX_PARAM_NONE), 0);
+
+	PMEMoid root1 = pmemobj_root(pop1, sizeof(struct root));
+	PMEMoid root2 = pmemobj_root(pop2, sizeof(struct root));
+
+	UT_ASSERTeq(pmemobj_tx_add_range(root1, 0, sizeof(struct root)), 0);
+	*root_val(pop1) = val;
+	UT_ASSERTeq(pmemobj_tx_add_range(root2, 0, sizeof(struct root)), 0);
+	*root_val(pop2) = val;
+
+	pmemobj_tx_commit();
+	UT_ASSERTeq(pmemobj_tx_end(), 0);
+}
+
+/*
+ * test_create -- sets up both pools and crashes in the commit of a coupled
+ *	transaction
+ */
+static void
+test_create(const char *path1, const char *path2, int scenario)
+{
+	PMEMobjpool *pop1 = pmemobj_create(path1, LAYOUT_NAME, 0,
+		S_IWUSR | S_IRUSR);
+	if (pop1 == NULL)
+		UT_FATAL("!pmemobj_create: %s", path1);
+	PMEMobjpool *pop2 = pmemobj_create(path2, LAYOUT_NAME, 0,
+		S_IWUSR | S_IRUSR);
+	if (pop2 == NULL)
+		UT_FATAL("!pmemobj_create: %s", path2);
+
+	/* parameter validation */
+	errno = 0;
+	UT_ASSERTeq(pmemobj_tx_begin_multi(pop1, NULL, NULL, TX_PARAM_NONE),
+		EINVAL);
+	errno = 0;
+	UT_ASSERTeq(pmemobj_tx_begin_multi(pop1, pop1, NULL, TX_PARAM_NONE),
+		EINVAL);
+
+	/* a coupled transaction must be outermost */
+	UT_ASSERTeq(pmemobj_tx_begin(pop1, NULL, TX_PARAM_NONE), 0);
+	errno = 0;
+	UT_ASSERTeq(pmemobj_tx_begin_multi(pop1, pop2, NULL, TX_PARAM_NONE),
+		EINVAL);
+	pmemobj_tx_commit();
+	UT_ASSERTeq(pmemobj_tx_end(), 0);
+
+	uint64_t *val1 = root_val(pop1);
+	uint64_t *val2 = root_val(pop2);
+	*val1 = VAL_OLD;
+	pmemobj_persist(pop1, val1, sizeof(*val1));
+	*val2 = VAL_OLD;
+	pmemobj_persist(pop2, val2, sizeof(*val2));
+
+	UT_ASSERTeq(pmemobj_tx_begin_multi(pop1, pop2, NULL,
+		TX_PARAM_NONE), 0);
+
+	PMEMoid root1 = pmemobj_root(pop1, sizeof(struct root));
+	PMEMoid root2 = pmemobj_root(pop2, sizeof(struct root));
+
+	UT_ASSERTeq(pmemobj_tx_add_range(root1, 0, sizeof(struct root)), 0);
+	*val1 = VAL_NEW;
+	UT_ASSERTeq(pmemobj_tx_add_range(root2, 0, sizeof(struct root)), 0);
+	*val2 = VAL_NEW;
+
+	/* die in the commit - the gate publish brackets the mocked call */
+	Exit_at = scenario == 0 ? 1 : 2;
+	pmemobj_tx_commit();
+
+	/* if we get here, something is wrong with function mocking */
+	UT_ASSERT(0);
+}
+
+/*
+ * test_open -- settles the gated transaction and verifies its resolution
+ */
+static void
+test_open(const char *path1, const char *path2, int scenario)
+{
+	PMEMobjpool *pop1 = pmemobj_open(path1, LAYOUT_NAME);
+	if (pop1 == NULL)
+		UT_FATAL("!pmemobj_open: %s", path1);
+	PMEMobjpool *pop2 = pmemobj_open(path2, LAYOUT_NAME);
+	if (pop2 == NULL)
+		UT_FATAL("!pmemobj_open: %s", path2);
+
+	/* the gate is armed in both windows and demands the right peer */
+	errno = 0;
+	UT_ASSERTeq(pmemobj_tx_multi_recover(pop2, NULL), -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	UT_ASSERTeq(pmemobj_tx_multi_recover(pop2, pop1), 0);
+
+	uint64_t expected = scenario == 0 ? VAL_OLD : VAL_NEW;
+	UT_ASSERTeq(*root_val(pop1), expected);
+	UT_ASSERTeq(*root_val(pop2), expected);
+
+	/* settling is idempotent once the gate is disarmed */
+	UT_ASSERTeq(pmemobj_tx_multi_recover(pop2, pop1), 0);
+
+	/* the pools still work as a pair after the recovery */
+	set_both(pop1, pop2, VAL_POST);
+	UT_ASSERTeq(*root_val(pop1), VAL_POST);
+	UT_ASSERTeq(*root_val(pop2), VAL_POST);
+
+	pmemobj_close(pop2);
+	pmemobj_close(pop1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_tx_multi");
+
+	if (argc != 5)
+		UT_FATAL("usage: %s file1 file2 [cmd: c/o] [scenario]",
+			argv[0]);
+
+	int scenario = atoi(argv[4]);
+
+	if (argv[3][0] == 'c')
+		test_create(argv[1], argv[2], scenario);
+	else
+		test_open(argv[1], argv[2], scenario);
+
+	DONE(NULL);
+}
@@ -34,7 +34,7 @@ MATCH_BYTE_SMALL = \
         (PMEM_F_MEM_WC,                                 128, "t"),
         (PMEM_F_MEM_WB,                                 128, "t"),
         (PMEM_F_MEM_NOFLUSH,                            128, "t"),
-        (ALL_FLAGS,                                     128, "t")
+        (ALL_FLAGS,                                     128, "nt")
     )
 
 # This match is valid for all cases with a BYTE
@@ -48,7 +48,7 @@ MATCH_BYTE_BIG = \
         (PMEM_F_MEM_WC,                                 1024, "t"),
         (PMEM_F_MEM_WB,                                 1024, "t"),
         (PMEM_F_MEM_NOFLUSH,                            1024, "t"),
-        (ALL_FLAGS,                                     1024, "t")
+        (ALL_FLAGS,                                     1024, "nt")
     )
 
 # This match is valid for all cases with a PAGE/CACHELINE
@@ -62,7 +62,7 @@ MATCH_PAGE_CACHELINE_SMALL = \
         (PMEM_F_MEM_WC,                                 128, "nt"),
         (PMEM_F_MEM_WB,                                 128, "t"),
         (PMEM_F_MEM_NOFLUSH,                            128, "t"),
-        (ALL_FLAGS,                                     128, "t")
+        (ALL_FLAGS,                                     128, "nt")
     )
 
 # This match is valid for all cases with a PAGE/CACHELINE
@@ -76,7 +76,7 @@ MATCH_PAGE_CACHELINE_BIG = \
         (PMEM_F_MEM_WC,                                 1024, "nt"),
         (PMEM_F_MEM_WB,                                 1024, "t"),
         (PMEM_F_MEM_NOFLUSH,                            1024, "t"),
-        (ALL_FLAGS,                                     1024, "t")
+        (ALL_FLAGS,                                     1024, "nt")
     )
 
 SSE2 = 1
@@ -157,6 +157,45 @@ test_stress(void)
 	ravl_delete(r);
 }
 
+static void
+test_bulk_insert(void)
+{
+	struct ravl *r = ravl_new(cmpkey);
+	struct ravl_node *n = NULL;
+
+	const void *sorted[100];
+	for (intptr_t i = 0; i < 100; ++i)
+		sorted[i] = (void *)(i + 1);
+
+	UT_ASSERTeq(ravl_bulk_insert(r, sorted, 100), 0);
+
+	for (intptr_t i = 1; i <= 100; ++i) {
+		n = ravl_find(r, (void *)i, RAVL_PREDICATE_EQUAL);
+		UT_ASSERTne(n, NULL);
+		UT_ASSERTeq(ravl_data(n), (void *)i);
+	}
+
+	n = ravl_find(r, (void *)50, RAVL_PREDICATE_GREATER);
+	UT_ASSERTne(n, NULL);
+	UT_ASSERTeq(ravl_data(n), (void *)51);
+
+	n = ravl_find(r, (void *)50, RAVL_PREDICATE_EQUAL);
+	UT_ASSERTne(n, NULL);
+	ravl_remove(r, n);
+
+	n = ravl_find(r, (void *)50, RAVL_PREDICATE_EQUAL);
+	UT_ASSERTeq(n, NULL);
+
+	/* a non-empty tree falls back to regular inserts */
+	const void *more[2] = {(void *)101, (void *)102};
+	UT_ASSERTeq(ravl_bulk_insert(r, more, 2), 0);
+
+	n = ravl_find(r, (void *)102, RAVL_PREDICATE_EQUAL);
+	UT_ASSERTne(n, NULL);
+
+	ravl_delete(r);
+}
+
 struct foo {
 	int a;
 	int b;
@@ -237,6 +276,7 @@ main(int argc, char *argv[])
 	test_predicate();
 	test_misc();
 	test_stress();
+	test_bulk_insert();
 	test_emplace();
 
 	test_fault_injection_ravl_sized();
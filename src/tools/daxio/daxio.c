@@ -26,11 +26,23 @@
 
 #include "util.h"
 #include "os.h"
+#include "os_thread.h"
 #include "badblocks.h"
 
 #define ALIGN_UP(size, align) (((size) + (align) - 1) & ~((align) - 1))
 #define ALIGN_DOWN(size, align) ((size) & ~((align) - 1))
 
+#define DAXIO_MAX_THREADS 256
+
+/* stripe boundaries handed to I/O threads are aligned to this */
+#define IO_STRIPE_ALIGN (2UL << 20)
+
+/* single copy step of a thread; also the progress reporting granularity */
+#define IO_CHUNK_SIZE (64UL << 20)
+
+/* how often the progress monitor prints (microseconds) */
+#define IO_PROGRESS_INTERVAL_US 1000000
+
 #define ERR(fmt, ...)\
 do {\
 	fprintf(stderr, "daxio: " fmt, ##__VA_ARGS__);\
@@ -52,6 +64,8 @@ do {\
 "   -l, --len=BYTES                 - total length to perform the I/O\n"\
 "   -b, --clear-bad-blocks=<yes|no> - clear bad blocks (default: yes)\n"\
 "   -z, --zero                      - zeroing the device\n"\
+"   -t, --threads=NUM               - number of I/O threads (default 1)\n"\
+"   -p, --progress                  - print per-thread progress\n"\
 "   -h. --help                      - print this help\n"\
 "   -V, --version                   - display version of daxio\n"
 
@@ -80,6 +94,8 @@ struct daxio_context {
 	size_t len;	/* total length of I/O */
 	int zero;
 	int clear_bad_blocks;
+	unsigned nthreads;	/* number of I/O threads */
+	int progress;		/* print per-thread progress */
 	struct daxio_device src;
 	struct daxio_device dst;
 };
@@ -91,6 +107,8 @@ static struct daxio_context Ctx = {
 	SIZE_MAX,	/* len */
 	0,		/* zero */
 	1,		/* clear_bad_blocks */
+	1,		/* nthreads */
+	0,		/* progress */
 	{ NULL, -1, SIZE_MAX, 0, 0, NULL, 0, 0, 0, 0, NULL, NULL },
 	{ NULL, -1, SIZE_MAX, 0, 0, NULL, 0, 0, 0, 0, NULL, NULL },
 };
@@ -124,6 +142,8 @@ static const struct option long_options[] = {
 	{"len",				required_argument,	NULL,	'l'},
 	{"clear-bad-blocks",		required_argument,	NULL,	'b'},
 	{"zero",			no_argument,		NULL,	'z'},
+	{"threads",			required_argument,	NULL,	't'},
+	{"progress",			no_argument,		NULL,	'p'},
 	{"help",			no_argument,		NULL,	'h'},
 	{"version",			no_argument,		NULL,	'V'},
 	{NULL,				0,			NULL,	 0 },
@@ -138,8 +158,9 @@ parse_args(struct daxio_context *ctx, int argc, char * const argv[])
 	int opt;
 	size_t offset;
 	size_t len;
+	size_t nthreads;
 
-	while ((opt = getopt_long(argc, argv, "i:o:k:s:l:b:zhV",
+	while ((opt = getopt_long(argc, argv, "i:o:k:s:l:b:zt:phV",
 			long_options, NULL)) != -1) {
 		switch (opt) {
 		case 'i':
@@ -172,6 +193,18 @@ parse_args(struct daxio_context *ctx, int argc, char * const argv[])
 		case 'z':
 			ctx->zero = 1;
 			break;
+		case 't':
+			if (util_parse_size(optarg, &nthreads) ||
+			    nthreads < 1 || nthreads > DAXIO_MAX_THREADS) {
+				ERR("'%s' -- invalid number of threads\n",
+						optarg);
+				return -1;
+			}
+			ctx->nthreads = (unsigned)nthreads;
+			break;
+		case 'p':
+			ctx->progress = 1;
+			break;
 		case 'b':
 			if (strcmp(optarg, "no") == 0) {
 				ctx->clear_bad_blocks = 0;
@@ -482,6 +515,227 @@ cleanup_devices(struct daxio_context *ctx)
 		cleanup_device(&ctx->src);
 }
 
+/*
+ * io_mode -- (internal) transfer kinds performed by I/O threads
+ */
+enum io_mode {
+	IO_MODE_ZERO,		/* zero out mmap'ed dst */
+	IO_MODE_MEMCPY,		/* memcpy between mmap'ed src and dst */
+	IO_MODE_DEV_TO_FILE,	/* write to file directly from mmap'ed src */
+	IO_MODE_FILE_TO_DEV,	/* read from file directly to mmap'ed dst */
+};
+
+/*
+ * io_worker -- (internal) a single thread's stripe of the I/O range
+ */
+struct io_worker {
+	struct daxio_context *ctx;
+	enum io_mode mode;
+	size_t off;		/* stripe offset within the I/O range */
+	size_t len;		/* stripe length */
+	uint64_t done;		/* bytes completed -- read by the monitor */
+	int ret;
+	int started;		/* worker runs in its own thread */
+	os_thread_t thread;
+};
+
+/*
+ * io_worker_run -- (internal) perform I/O on a single stripe
+ *
+ * The mmap'ed paths go through pmem_memcpy/memset_persist, so each thread
+ * uses the widest non-temporal store kernel libpmem detected at startup.
+ */
+static void *
+io_worker_run(void *arg)
+{
+	struct io_worker *w = arg;
+	struct daxio_context *ctx = w->ctx;
+	char *src_addr = ctx->src.addr + ctx->src.offset + w->off;
+	char *dst_addr = ctx->dst.addr + ctx->dst.offset + w->off;
+
+	w->ret = -1;
+
+	size_t done = 0;
+	while (done < w->len) {
+		size_t chunk = w->len - done;
+		if (chunk > IO_CHUNK_SIZE)
+			chunk = IO_CHUNK_SIZE;
+
+		switch (w->mode) {
+		case IO_MODE_ZERO:
+			pmem_memset_persist(dst_addr + done, 0, chunk);
+			break;
+		case IO_MODE_MEMCPY:
+			pmem_memcpy_persist(dst_addr + done, src_addr + done,
+					chunk);
+			break;
+		case IO_MODE_DEV_TO_FILE:
+		{
+			ssize_t wcnt = pwrite(ctx->dst.fd, src_addr + done,
+					chunk, (off_t)(ctx->dst.offset +
+						w->off + done));
+			if (wcnt < 0) {
+				FAIL("pwrite");
+				return NULL;
+			}
+			chunk = (size_t)wcnt;
+			break;
+		}
+		case IO_MODE_FILE_TO_DEV:
+		{
+			ssize_t rcnt = pread(ctx->src.fd, dst_addr + done,
+					chunk, (off_t)(ctx->src.offset +
+						w->off + done));
+			if (rcnt < 0) {
+				FAIL("pread");
+				return NULL;
+			}
+			if (rcnt == 0) {
+				/* end of file */
+				w->ret = 0;
+				return NULL;
+			}
+			pmem_persist(dst_addr + done, (size_t)rcnt);
+			chunk = (size_t)rcnt;
+			break;
+		}
+		default:
+			break;
+		}
+
+		done += chunk;
+		util_atomic_store_explicit64(&w->done, done,
+				memory_order_relaxed);
+	}
+
+	w->ret = 0;
+	return NULL;
+}
+
+/*
+ * io_monitor -- (internal) progress monitor state
+ */
+struct io_monitor {
+	struct io_worker *workers;
+	unsigned nworkers;
+	int stop;
+	os_thread_t thread;
+};
+
+/*
+ * io_monitor_run -- (internal) periodically print per-thread progress
+ */
+static void *
+io_monitor_run(void *arg)
+{
+	struct io_monitor *m = arg;
+	int stop;
+
+	do {
+		usleep(IO_PROGRESS_INTERVAL_US);
+		util_atomic_load_explicit32(&m->stop, &stop,
+				memory_order_relaxed);
+
+		fprintf(stderr, "daxio:");
+		for (unsigned i = 0; i < m->nworkers; i++) {
+			uint64_t done;
+			util_atomic_load_explicit64(&m->workers[i].done,
+					&done, memory_order_relaxed);
+			fprintf(stderr, " [%u] %" PRIu64 "/%zu", i, done,
+					m->workers[i].len);
+		}
+		fprintf(stderr, "\n");
+	} while (!stop);
+
+	return NULL;
+}
+
+/*
+ * do_io_stripes -- (internal) perform I/O striped across worker threads
+ *
+ * Returns the total number of bytes copied or -1 on failure.
+ */
+static ssize_t
+do_io_stripes(struct daxio_context *ctx, enum io_mode mode)
+{
+	unsigned nthreads = ctx->nthreads;
+
+	/* don't create more workers than there are stripes to process */
+	size_t stripe = ALIGN_UP((ctx->len + nthreads - 1) / nthreads,
+			IO_STRIPE_ALIGN);
+	nthreads = (unsigned)((ctx->len + stripe - 1) / stripe);
+	if (nthreads == 0)
+		nthreads = 1;
+
+	struct io_worker *workers = calloc(nthreads, sizeof(*workers));
+	if (workers == NULL) {
+		FAIL("calloc");
+		return -1;
+	}
+
+	size_t off = 0;
+	for (unsigned i = 0; i < nthreads; i++) {
+		workers[i].ctx = ctx;
+		workers[i].mode = mode;
+		workers[i].off = off;
+		workers[i].len = ctx->len - off < stripe ?
+				ctx->len - off : stripe;
+		off += workers[i].len;
+	}
+
+	struct io_monitor monitor;
+	monitor.workers = workers;
+	monitor.nworkers = nthreads;
+	monitor.stop = 0;
+	int monitor_started = 0;
+	if (ctx->progress) {
+		if (os_thread_create(&monitor.thread, NULL, io_monitor_run,
+				&monitor) == 0)
+			monitor_started = 1;
+		else
+			FAIL("os_thread_create");
+	}
+
+	for (unsigned i = 0; i < nthreads; i++) {
+		if (nthreads > 1 && os_thread_create(&workers[i].thread,
+				NULL, io_worker_run, &workers[i]) == 0)
+			workers[i].started = 1;
+		else
+			(void) io_worker_run(&workers[i]);
+	}
+
+	for (unsigned i = 0; i < nthreads; i++) {
+		if (workers[i].started)
+			(void) os_thread_join(&workers[i].thread, NULL);
+	}
+
+	if (monitor_started) {
+		util_atomic_store_explicit32(&monitor.stop, 1,
+				memory_order_relaxed);
+		(void) os_thread_join(&monitor.thread, NULL);
+	}
+
+	ssize_t cnt = 0;
+	int ret = 0;
+	for (unsigned i = 0; i < nthreads; i++) {
+		if (workers[i].ret)
+			ret = -1;
+		cnt += (ssize_t)workers[i].done;
+	}
+
+	free(workers);
+	return ret ? -1 : cnt;
+}
+
+/*
+ * fd_is_seekable -- (internal) check if positioned I/O is possible on fd
+ */
+static int
+fd_is_seekable(int fd)
+{
+	return lseek(fd, 0, SEEK_CUR) != -1;
+}
+
 /*
  * do_io -- (internal) write data to device/file
  */
@@ -502,58 +756,67 @@ do_io(struct ndctl_ctx *ndctl_ctx, struct daxio_context *ctx)
 			return -1;
 		}
 
-		char *dst_addr = ctx->dst.addr + ctx->dst.offset;
-		pmem_memset_persist(dst_addr, 0, ctx->len);
-		cnt = (ssize_t)ctx->len;
+		cnt = do_io_stripes(ctx, IO_MODE_ZERO);
+		if (cnt < 0)
+			goto err;
 	} else if (ctx->src.is_devdax && ctx->dst.is_devdax) {
 		/* memcpy between src and dst */
-		char *src_addr = ctx->src.addr + ctx->src.offset;
-		char *dst_addr = ctx->dst.addr + ctx->dst.offset;
-		pmem_memcpy_persist(dst_addr, src_addr, ctx->len);
-		cnt = (ssize_t)ctx->len;
+		cnt = do_io_stripes(ctx, IO_MODE_MEMCPY);
+		if (cnt < 0)
+			goto err;
 	} else if (ctx->src.is_devdax) {
 		/* write to file directly from mmap'ed src */
-		char *src_addr = ctx->src.addr + ctx->src.offset;
-		if (ctx->dst.offset) {
-			if (lseek(ctx->dst.fd, (off_t)ctx->dst.offset,
-					SEEK_SET) < 0) {
-				FAIL("lseek");
+		if (fd_is_seekable(ctx->dst.fd)) {
+			cnt = do_io_stripes(ctx, IO_MODE_DEV_TO_FILE);
+			if (cnt < 0)
 				goto err;
-			}
-		}
-		do {
-			ssize_t wcnt = write(ctx->dst.fd, src_addr + cnt,
-					ctx->len - (size_t)cnt);
-			if (wcnt == -1) {
-				FAIL("write");
+		} else {
+			/* not seekable (pipe?) -- single-threaded copy */
+			char *src_addr = ctx->src.addr + ctx->src.offset;
+			if (ctx->dst.offset) {
+				ERR("seek offset requires seekable output\n");
 				goto err;
 			}
-			cnt += wcnt;
-		} while ((size_t)cnt < ctx->len);
+			do {
+				ssize_t wcnt = write(ctx->dst.fd,
+						src_addr + cnt,
+						ctx->len - (size_t)cnt);
+				if (wcnt == -1) {
+					FAIL("write");
+					goto err;
+				}
+				cnt += wcnt;
+			} while ((size_t)cnt < ctx->len);
+		}
 	} else if (ctx->dst.is_devdax) {
 		/* read from file directly to mmap'ed dst */
-		char *dst_addr = ctx->dst.addr + ctx->dst.offset;
-		if (ctx->src.offset) {
-			if (lseek(ctx->src.fd, (off_t)ctx->src.offset,
-					SEEK_SET) < 0) {
-				FAIL("lseek");
-				return -1;
-			}
-		}
-		do {
-			ssize_t rcnt = read(ctx->src.fd, dst_addr + cnt,
-					ctx->len - (size_t)cnt);
-			if (rcnt == -1) {
-				FAIL("read");
+		if (fd_is_seekable(ctx->src.fd)) {
+			cnt = do_io_stripes(ctx, IO_MODE_FILE_TO_DEV);
+			if (cnt < 0)
+				goto err;
+		} else {
+			/* not seekable (pipe?) -- single-threaded copy */
+			char *dst_addr = ctx->dst.addr + ctx->dst.offset;
+			if (ctx->src.offset) {
+				ERR("skip offset requires seekable input\n");
 				goto err;
 			}
-			/* end of file */
-			if (rcnt == 0)
-				break;
-			cnt = cnt + rcnt;
-		} while ((size_t)cnt < ctx->len);
+			do {
+				ssize_t rcnt = read(ctx->src.fd,
+						dst_addr + cnt,
+						ctx->len - (size_t)cnt);
+				if (rcnt == -1) {
+					FAIL("read");
+					goto err;
+				}
+				/* end of file */
+				if (rcnt == 0)
+					break;
+				cnt = cnt + rcnt;
+			} while ((size_t)cnt < ctx->len);
 
-		pmem_persist(dst_addr, (size_t)cnt);
+			pmem_persist(dst_addr, (size_t)cnt);
+		}
 
 		if ((size_t)cnt != ctx->len)
 			ERR("requested size %zu larger than source\n",
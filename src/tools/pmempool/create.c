@@ -45,6 +45,8 @@ struct pmempool_create {
 	char *layout;
 	struct options *opts;
 	int clearbadblocks;
+	int skipzero;
+	int growable;
 };
 
 /*
@@ -61,6 +63,8 @@ static const struct pmempool_create pmempool_create_default = {
 	.force		= 0,
 	.layout		= NULL,
 	.clearbadblocks	= 0,
+	.skipzero	= 0,
+	.growable	= 0,
 	.params		= {
 		.type	= PMEM_POOL_TYPE_UNKNOWN,
 		.size	= 0,
@@ -80,6 +84,10 @@ static const char * const help_str =
 "  -m, --mode <octal>   set permissions to <octal> (the default is 0664)\n"
 "  -i, --inherit <file> take required parameters from specified pool file\n"
 "  -b, --clear-bad-blocks clear bad blocks in existing files\n"
+"  -z, --skip-zero      skip block preallocation, relying on the device\n"
+"                       being zeroed already (e.g. a sanitized namespace)\n"
+"  -G, --growable       create a sparse pool which allocates file blocks\n"
+"                       on demand (implies --skip-zero)\n"
 "  -f, --force          remove the pool first\n"
 "  -v, --verbose        increase verbosity level\n"
 "  -h, --help           display this help and exit\n"
@@ -103,6 +111,8 @@ static const struct option long_options[] = {
 	{"layout",	required_argument,	NULL,	'l' | OPT_OBJ},
 	{"force",	no_argument,		NULL,	'f' | OPT_ALL},
 	{"clear-bad-blocks", no_argument,		NULL,	'b' | OPT_ALL},
+	{"skip-zero",	no_argument,		NULL,	'z' | OPT_ALL},
+	{"growable",	no_argument,		NULL,	'G' | OPT_ALL},
 	{NULL,		0,			NULL,	 0 },
 };
 
@@ -141,6 +151,20 @@ pmempool_create_help(const char *appname)
 static int
 pmempool_create_obj(struct pmempool_create *pcp)
 {
+	if (pcp->skipzero) {
+		/*
+		 * The pool is created by the library, so the preallocation
+		 * must be disabled through its global ctl namespace.
+		 */
+		int at_create = 0;
+		if (pmemobj_ctl_set(NULL, "fallocate.at_create",
+				&at_create) != 0) {
+			outv_err("'%s' -- %s\n", pcp->fname,
+					pmemobj_errormsg());
+			return -1;
+		}
+	}
+
 	PMEMobjpool *pop = pmemobj_create(pcp->fname, pcp->layout,
 			pcp->params.size, pcp->params.mode);
 	if (!pop) {
@@ -150,6 +174,15 @@ pmempool_create_obj(struct pmempool_create *pcp)
 
 	pmemobj_close(pop);
 
+	if (pcp->growable) {
+		if (pmempool_feature_enable(pcp->fname, PMEMPOOL_FEAT_PART_GROW,
+				0) != 0) {
+			outv_err("'%s' -- %s\n", pcp->fname,
+					pmempool_errormsg());
+			return -1;
+		}
+	}
+
 	return 0;
 }
 
@@ -237,7 +270,7 @@ pmempool_create_parse_args(struct pmempool_create *pcp, const char *appname,
 		int argc, char *argv[], struct options *opts)
 {
 	int opt, ret;
-	while ((opt = util_options_getopt(argc, argv, "vhi:s:Mm:l:wfb",
+	while ((opt = util_options_getopt(argc, argv, "vhi:s:Mm:l:wfbzG",
 			opts)) != -1) {
 		switch (opt) {
 		case 'v':
@@ -279,6 +312,13 @@ pmempool_create_parse_args(struct pmempool_create *pcp, const char *appname,
 		case 'b':
 			pcp->clearbadblocks = 1;
 			break;
+		case 'z':
+			pcp->skipzero = 1;
+			break;
+		case 'G':
+			pcp->growable = 1;
+			pcp->skipzero = 1;
+			break;
 		default:
 			print_usage(appname);
 			return -1;
@@ -29,6 +29,7 @@ struct pmempool_dump {
 	char *range;
 	FILE *ofh;
 	int hex;
+	int stream;
 	struct ranges ranges;
 };
 
@@ -41,6 +42,7 @@ static const struct pmempool_dump pmempool_dump_default = {
 	.range		= NULL,
 	.ofh		= NULL,
 	.hex		= 1,
+	.stream		= 0,
 };
 
 /*
@@ -50,6 +52,7 @@ static const struct option long_options[] = {
 	{"output",	required_argument,	NULL,	'o' | OPT_ALL},
 	{"binary",	no_argument,		NULL,	'b' | OPT_ALL},
 	{"range",	required_argument,	NULL,	'r' | OPT_ALL},
+	{"stream",	no_argument,		NULL,	's' | OPT_OBJ},
 	{"help",	no_argument,		NULL,	'h' | OPT_ALL},
 	{NULL,		0,			NULL,	 0 },
 };
@@ -64,6 +67,8 @@ static const char * const help_str =
 "  -o, --output <file>  output file name\n"
 "  -b, --binary         dump data in binary format\n"
 "  -r, --range <range>  range of bytes/blocks/data chunks\n"
+"  -s, --stream         binary streaming dump of the whole pool, restorable\n"
+"                       with the restore command (obj pools only)\n"
 "  -h, --help           display this help and exit\n"
 "\n"
 "For complete documentation see %s-dump(1) manual page.\n"
@@ -102,6 +107,90 @@ static const struct option_requirement option_requirements[] = {
 	{ 0,  0, 0}
 };
 
+/*
+ * pmempool_dump_stream -- (internal) dumps the whole pool as a binary stream
+ *	of non-zero extents in sequential file order
+ *
+ * The pool is walked front to back in large blocks, so zones come out in
+ * their natural order and both the reads and the writes stay sequential;
+ * all-zero blocks are elided from the stream. The output is plain stdio,
+ * so the stream can go to a file as well as down a pipe.
+ */
+static int
+pmempool_dump_stream(struct pmempool_dump *pdp)
+{
+	struct pool_set_file *pfile = pool_set_file_open(pdp->fname, 1, 1);
+	if (pfile == NULL) {
+		warn("%s", pdp->fname);
+		return -1;
+	}
+
+	int ret = 0;
+
+	struct dump_stream_hdr hdr;
+	memcpy(hdr.signature, DUMP_STREAM_SIGNATURE, sizeof(hdr.signature));
+	hdr.major = DUMP_STREAM_MAJOR;
+	hdr.reserved = 0;
+	hdr.poolsize = pfile->size;
+	if (fwrite(&hdr, sizeof(hdr), 1, pdp->ofh) != 1)
+		goto err_write;
+
+	uint8_t *addr = pfile->addr;
+	struct dump_stream_extent ext;
+	size_t start = 0;
+	int in_extent = 0;
+
+	for (size_t off = 0; off < pfile->size;
+			off += DUMP_STREAM_BLOCK_SIZE) {
+		size_t len = pfile->size - off < DUMP_STREAM_BLOCK_SIZE ?
+			pfile->size - off : DUMP_STREAM_BLOCK_SIZE;
+
+		if (util_is_zeroed(addr + off, len)) {
+			if (!in_extent)
+				continue;
+
+			ext.offset = start;
+			ext.length = off - start;
+			if (fwrite(&ext, sizeof(ext), 1, pdp->ofh) != 1 ||
+			    fwrite(addr + start, 1, ext.length,
+					pdp->ofh) != ext.length)
+				goto err_write;
+			in_extent = 0;
+		} else if (!in_extent) {
+			start = off;
+			in_extent = 1;
+		}
+	}
+
+	if (in_extent) {
+		ext.offset = start;
+		ext.length = pfile->size - start;
+		if (fwrite(&ext, sizeof(ext), 1, pdp->ofh) != 1 ||
+		    fwrite(addr + start, 1, ext.length,
+				pdp->ofh) != ext.length)
+			goto err_write;
+	}
+
+	/* stream terminator */
+	ext.offset = pfile->size;
+	ext.length = 0;
+	if (fwrite(&ext, sizeof(ext), 1, pdp->ofh) != 1)
+		goto err_write;
+
+	if (fflush(pdp->ofh) != 0)
+		goto err_write;
+
+out:
+	pool_set_file_close(pfile);
+
+	return ret;
+
+err_write:
+	warn("%s", pdp->ofname ? pdp->ofname : "stdout");
+	ret = -1;
+	goto out;
+}
+
 /*
  * pmempool_dump_func -- dump command main function
  */
@@ -118,7 +207,7 @@ pmempool_dump_func(const char *appname, int argc, char *argv[])
 	int ret = 0;
 	int opt;
 	while ((opt = util_options_getopt(argc, argv,
-			"ho:br:c:", opts)) != -1) {
+			"ho:br:c:s", opts)) != -1) {
 		switch (opt) {
 		case 'o':
 			pd.ofname = optarg;
@@ -129,6 +218,9 @@ pmempool_dump_func(const char *appname, int argc, char *argv[])
 		case 'r':
 			pd.range = optarg;
 			break;
+		case 's':
+			pd.stream = 1;
+			break;
 		case 'h':
 			pmempool_dump_help(appname);
 			exit(EXIT_SUCCESS);
@@ -169,8 +261,13 @@ pmempool_dump_func(const char *appname, int argc, char *argv[])
 
 	switch (params.type) {
 	case PMEM_POOL_TYPE_OBJ:
-		outv_err("%s: PMEMOBJ pool not supported\n", pd.fname);
-		ret = -1;
+		if (!pd.stream) {
+			outv_err("%s: PMEMOBJ pool supported only with "
+					"--stream\n", pd.fname);
+			ret = -1;
+			break;
+		}
+		ret = pmempool_dump_stream(&pd);
 		break;
 	case PMEM_POOL_TYPE_UNKNOWN:
 		outv_err("%s: unknown pool type -- '%s'\n", pd.fname,
@@ -1,9 +1,36 @@
 /* SPDX-License-Identifier: BSD-3-Clause */
-/* Copyright 2014-2023, Intel Corporation */
+/* Copyright 2014-2024, Intel Corporation */
 
 /*
  * dump.h -- pmempool dump command header file
  */
 
+#include <stdint.h>
+
+/*
+ * Binary stream dump format: a fixed header followed by a sequence of
+ * extent records, each carrying the pool file offset and length of the raw
+ * data that directly follows it. The stream is terminated by a zero-length
+ * extent with the offset equal to the pool size.
+ */
+#define DUMP_STREAM_SIGNATURE "PMEMDUMP"
+#define DUMP_STREAM_SIGNATURE_LEN 8
+#define DUMP_STREAM_MAJOR 1
+
+/* the granularity of the zero-block detection and of the data copies */
+#define DUMP_STREAM_BLOCK_SIZE (4UL << 20)
+
+struct dump_stream_hdr {
+	char signature[DUMP_STREAM_SIGNATURE_LEN];
+	uint32_t major;
+	uint32_t reserved;
+	uint64_t poolsize;
+};
+
+struct dump_stream_extent {
+	uint64_t offset;
+	uint64_t length;
+};
+
 int pmempool_dump_func(const char *appname, int argc, char *argv[]);
 void pmempool_dump_help(const char *appname);
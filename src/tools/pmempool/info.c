@@ -18,6 +18,9 @@
 #include <sys/param.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
 
 #include "common.h"
 #include "output.h"
@@ -52,6 +55,7 @@ static const struct pmempool_info_args pmempool_info_args_default = {
 	.human		= false,
 	.force		= false,
 	.badblocks	= PRINT_BAD_BLOCKS_NOT_SET,
+	.topology	= false,
 	.type		= PMEM_POOL_TYPE_UNKNOWN,
 	.vlevel		= VERBOSE_DEFAULT,
 	.vdata		= VERBOSE_SILENT,
@@ -88,6 +92,7 @@ static const struct option long_options[] = {
 	{"stats",	no_argument,		NULL, 's' | OPT_ALL},
 	{"range",	required_argument,	NULL, 'r' | OPT_ALL},
 	{"bad-blocks",	required_argument,	NULL, 'k' | OPT_ALL},
+	{"topology",	no_argument,		NULL, 'y' | OPT_ALL},
 	{"lanes",	no_argument,		NULL, 'l' | OPT_OBJ},
 	{"recovery",	no_argument,		NULL, 'R' | OPT_OBJ},
 	{"section",	required_argument,	NULL, 'S' | OPT_OBJ},
@@ -103,6 +108,7 @@ static const struct option long_options[] = {
 	{"chunk-type",	required_argument,	NULL, 'T' | OPT_OBJ},
 	{"bitmap",	no_argument,		NULL, 'b' | OPT_OBJ},
 	{"replica",	required_argument,	NULL, 'p' | OPT_OBJ},
+	{"stats-cache",	required_argument,	NULL, 'c' | OPT_OBJ},
 	{NULL,		0,			NULL,  0 },
 };
 
@@ -173,6 +179,11 @@ static const struct option_requirement option_requirements[] = {
 		.type	= PMEM_POOL_TYPE_OBJ,
 		.req	= OPT_REQ0('O') | OPT_REQ1('o'),
 	},
+	{
+		.opt	= 'c',
+		.type	= PMEM_POOL_TYPE_OBJ,
+		.req	= OPT_REQ0('s'),
+	},
 	{ 0,  0, 0}
 };
 
@@ -193,6 +204,8 @@ static const char * const help_str =
 "  -s, --stats                     Print statistics.\n"
 "  -r, --range <range>             Range of blocks/chunks/objects.\n"
 "  -k, --bad-blocks=<yes|no>       Print bad blocks.\n"
+"  -y, --topology                  Print NUMA node map and DIMM interleave\n"
+"                                  set of the memory backing the pool.\n"
 "\n"
 "Options for PMEMOBJ:\n"
 "  -l, --lanes [<range>]           Print lanes from specified range.\n"
@@ -218,6 +231,10 @@ static const char * const help_str =
 "  -b, --bitmap                    Print chunk run's bitmap in graphical\n"
 "                                  format. [requires --chunks|-C]\n"
 "  -p, --replica <num>             Print info from specified replica\n"
+"  -c, --stats-cache <file>        Keep a statistics snapshot in <file> and\n"
+"                                  re-scan only zones whose heap metadata\n"
+"                                  changed since the previous run.\n"
+"                                  [requires --stats|-s]\n"
 "For complete documentation see %s-info(1) manual page.\n"
 ;
 
@@ -272,7 +289,7 @@ parse_args(const char *appname, int argc, char *argv[],
 
 	struct ranges *rangesp = &argsp->ranges;
 	while ((opt = util_options_getopt(argc, argv,
-			"vhnf:ezuF:L:c:dmxVw:gBsr:lRS:OECZHT:bot:aAp:k:",
+			"vhnf:ezuF:L:c:dmxVw:gBsr:lRS:OECZHT:bot:aAp:k:y",
 			opts)) != -1) {
 
 		switch (opt) {
@@ -308,6 +325,9 @@ parse_args(const char *appname, int argc, char *argv[],
 				return -1;
 			}
 			break;
+		case 'y':
+			argsp->topology = true;
+			break;
 		case 'r':
 			if (util_parse_ranges(optarg, rangesp,
 					ENTIRE_UINT64)) {
@@ -385,6 +405,9 @@ parse_args(const char *appname, int argc, char *argv[],
 		case 'b':
 			argsp->obj.vbitmap = VERBOSE_DEFAULT;
 			break;
+		case 'c':
+			argsp->obj.stats_cache = optarg;
+			break;
 		case 'p':
 		{
 			char *endptr;
@@ -487,6 +510,189 @@ exit_free:
 	return ret;
 }
 
+/* maximum number of pages sampled for the per-offset NUMA node map */
+#define TOPOLOGY_MAX_SAMPLES 1024
+
+/*
+ * topology_read_region_attr -- (internal) read a sysfs attribute of an
+ * nvdimm region into a NUL-terminated buffer, with the trailing newline
+ * stripped
+ */
+static int
+topology_read_region_attr(unsigned region, const char *name,
+		char *buf, size_t len)
+{
+	char path[PATH_MAX];
+	if (util_snprintf(path, sizeof(path),
+			"/sys/bus/nd/devices/region%u/%s", region, name) < 0)
+		return -1;
+
+	int fd = os_open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	ssize_t n = read(fd, buf, len - 1);
+	close(fd);
+	if (n <= 0)
+		return -1;
+
+	buf[n] = '\0';
+	if (buf[n - 1] == '\n')
+		buf[n - 1] = '\0';
+
+	return 0;
+}
+
+/*
+ * topology_part_region -- (internal) resolve the nvdimm region backing
+ * a part file
+ *
+ * The sysfs device link of either the dax character device (device dax)
+ * or the block device holding the file system (fsdax) leads through the
+ * regionN directory of the backing region.
+ */
+static int
+topology_part_region(const char *path, unsigned *region)
+{
+	struct stat st;
+	if (os_stat(path, &st) < 0)
+		return -1;
+
+	char link[PATH_MAX];
+	if (S_ISCHR(st.st_mode)) {
+		if (util_snprintf(link, sizeof(link), "/sys/dev/char/%u:%u",
+				major(st.st_rdev), minor(st.st_rdev)) < 0)
+			return -1;
+	} else {
+		if (util_snprintf(link, sizeof(link), "/sys/dev/block/%u:%u",
+				major(st.st_dev), minor(st.st_dev)) < 0)
+			return -1;
+	}
+
+	char target[PATH_MAX];
+	ssize_t n = readlink(link, target, sizeof(target) - 1);
+	if (n < 0)
+		return -1;
+	target[n] = '\0';
+
+	char *r = strstr(target, "/region");
+	if (r == NULL || sscanf(r, "/region%u/", region) != 1)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * pmempool_info_topology_region -- (internal) print the NUMA node and the
+ * DIMM interleave set of an nvdimm region
+ */
+static void
+pmempool_info_topology_region(unsigned region, int v)
+{
+	char buf[PATH_MAX];
+
+	outv_field(v, "backing region", "region%u", region);
+
+	if (topology_read_region_attr(region, "numa_node",
+			buf, sizeof(buf)) == 0)
+		outv_field(v, "region NUMA node", "%s", buf);
+
+	unsigned mappings;
+	if (topology_read_region_attr(region, "mappings",
+			buf, sizeof(buf)) ||
+			sscanf(buf, "%u", &mappings) != 1) {
+		outv_field(v, "DIMM mappings", "%s", "unavailable");
+		return;
+	}
+
+	outv_field(v, "DIMM mappings", "%u-way interleave", mappings);
+	for (unsigned m = 0; m < mappings; m++) {
+		char name[32];
+		if (util_snprintf(name, sizeof(name), "mapping%u", m) < 0)
+			continue;
+		if (topology_read_region_attr(region, name,
+				buf, sizeof(buf)) == 0)
+			outv_field(v, name, "%s", buf);
+	}
+}
+
+/*
+ * pmempool_info_topology_map -- (internal) print the NUMA node map of
+ * the mapped part, with pool offsets sampled at a fixed stride and runs
+ * of samples on the same node coalesced
+ */
+static void
+pmempool_info_topology_map(struct pmem_info *pip,
+		const struct pool_set_part *part, int v)
+{
+	size_t len = part->filesize & ~(Pagesize - 1);
+	if (part->addr == NULL || len == 0)
+		return;
+
+	size_t stride = (len / TOPOLOGY_MAX_SAMPLES + Pagesize - 1) &
+			~(Pagesize - 1);
+	if (stride == 0)
+		stride = Pagesize;
+	unsigned count = (unsigned)((len + stride - 1) / stride);
+
+	void **pages = malloc(count * sizeof(void *));
+	int *status = malloc(count * sizeof(int));
+	if (pages == NULL || status == NULL)
+		err(1, "Cannot allocate memory for NUMA node map");
+
+	for (unsigned i = 0; i < count; i++) {
+		char *addr = (char *)part->addr + (size_t)i * stride;
+		/* fault the page in so move_pages can report its node */
+		(void) *(volatile char *)addr;
+		pages[i] = addr;
+	}
+
+	long ret = syscall(SYS_move_pages, 0, count, pages, NULL, status, 0);
+	if (ret < 0) {
+		outv_field(v, "node map", "%s", "unavailable");
+		goto out;
+	}
+
+	outv_field(v, "node map", "sampled every %s",
+			out_get_size_str(stride, pip->args.human));
+	unsigned r = 0;
+	for (unsigned i = 1; i <= count; i++) {
+		if (i < count && status[i] == status[r])
+			continue;
+		size_t beg = (size_t)r * stride;
+		size_t end = i < count ? (size_t)i * stride : len;
+		if (status[r] >= 0)
+			outv(v, "\t0x%zx - 0x%zx : node %d\n",
+					beg, end, status[r]);
+		else
+			outv(v, "\t0x%zx - 0x%zx : unknown\n",
+					beg, end);
+		r = i;
+	}
+
+out:
+	free(pages);
+	free(status);
+}
+
+/*
+ * pmempool_info_topology -- (internal) print info about the physical
+ * memory backing a part file
+ */
+static void
+pmempool_info_topology(struct pmem_info *pip,
+		const struct pool_set_part *part, const char *path, int v)
+{
+	unsigned region;
+	if (topology_part_region(path, &region) == 0)
+		pmempool_info_topology_region(region, v);
+	else
+		outv_field(v, "backing region", "%s",
+				"none (not backed by an nvdimm region)");
+
+	pmempool_info_topology_map(pip, part, v);
+}
+
 /*
  * pmempool_info_part -- (internal) print info about poolset part
  */
@@ -495,13 +701,14 @@ pmempool_info_part(struct pmem_info *pip, unsigned repn, unsigned partn, int v)
 {
 	/* get path of the part file */
 	const char *path = NULL;
+	struct pool_set_part *part;
 	if (repn != UNDEF_REPLICA && partn != UNDEF_PART) {
 		outv(v, "part %u:\n", partn);
-		struct pool_set_part *part =
-			&pip->pfile->poolset->replica[repn]->part[partn];
+		part = &pip->pfile->poolset->replica[repn]->part[partn];
 		path = part->path;
 	} else {
 		outv(v, "Part file:\n");
+		part = &pip->pfile->poolset->replica[0]->part[0];
 		path = pip->file_name;
 	}
 	outv_field(v, "path", "%s", path);
@@ -536,6 +743,10 @@ pmempool_info_part(struct pmem_info *pip, unsigned repn, unsigned partn, int v)
 		return -1;
 	}
 
+	/* map the part onto the physical topology */
+	if (pip->args.topology)
+		pmempool_info_topology(pip, part, path, VERBOSE_DEFAULT);
+
 	return 0;
 }
 
@@ -886,8 +1097,10 @@ static void
 pmempool_info_free(struct pmem_info *pip)
 {
 	if (pip->obj.stats.zone_stats) {
-		for (uint64_t i = 0; i < pip->obj.stats.n_zones; ++i)
+		for (uint64_t i = 0; i < pip->obj.stats.n_zones; ++i) {
 			VEC_DELETE(&pip->obj.stats.zone_stats[i].class_stats);
+			VEC_DELETE(&pip->obj.stats.zone_stats[i].type_stats);
+		}
 
 		free(pip->obj.stats.zone_stats);
 	}
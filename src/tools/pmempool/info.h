@@ -48,6 +48,7 @@ struct pmempool_info_args {
 	bool human;		/* sizes in human-readable formats */
 	bool force;		/* force parsing pool */
 	enum print_bb_e badblocks; /* print bad blocks */
+	bool topology;		/* print NUMA and DIMM interleave topology */
 	pmem_pool_type_t type;	/* forced pool type */
 	bool use_range;		/* use range for blocks */
 	struct ranges ranges;	/* range of block/chunks to dump */
@@ -69,6 +70,7 @@ struct pmempool_info_args {
 		bool ignore_empty_obj;
 		uint64_t chunk_types;
 		size_t replica;
+		const char *stats_cache;	/* statistics cache file */
 		struct ranges lane_ranges;
 		struct ranges type_ranges;
 		struct ranges zone_ranges;
@@ -85,12 +87,26 @@ struct pmem_obj_class_stats {
 	uint16_t flags;
 };
 
+/*
+ * pmem_obj_zone_type_stats -- per-zone slice of objects' type statistics,
+ * tracked only when the statistics cache is in use
+ */
+struct pmem_obj_zone_type_stats {
+	uint64_t type_num;
+	uint64_t n_objects;
+	uint64_t n_bytes;
+};
+
 struct pmem_obj_zone_stats {
+	uint64_t fingerprint;	/* checksum of the zone's heap metadata */
 	uint64_t n_chunks;
 	uint64_t n_chunks_type[MAX_CHUNK_TYPE];
 	uint64_t size_chunks;
 	uint64_t size_chunks_type[MAX_CHUNK_TYPE];
+	uint64_t n_objects;
+	uint64_t n_bytes;
 	VEC(, struct pmem_obj_class_stats) class_stats;
+	VEC(, struct pmem_obj_zone_type_stats) type_stats;
 };
 
 struct pmem_obj_type_stats {
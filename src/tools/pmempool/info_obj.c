@@ -17,6 +17,8 @@
 
 #include "set.h"
 #include "common.h"
+#include "file.h"
+#include "os.h"
 #include "output.h"
 #include "info.h"
 #include "util.h"
@@ -106,6 +108,7 @@ info_obj_redo_entry(struct ulog_entry_base *e, void *arg,
 {
 	struct info_obj_redo_args *a = arg;
 	struct ulog_entry_val *ev;
+	struct ulog_entry_val16 *er;
 	struct ulog_entry_buf *eb;
 
 	switch (ulog_entry_type(e)) {
@@ -121,6 +124,21 @@ info_obj_redo_entry(struct ulog_entry_base *e, void *arg,
 				ulog_entry_offset(e),
 				ev->value);
 			break;
+		case ULOG_OPERATION_SET_RANGE:
+			er = (struct ulog_entry_val16 *)e;
+
+			outv(a->v, "%010zu: "
+				"Offset: 0x%016jx "
+				"Size: %s "
+				"Data: 0x",
+				a->i++,
+				ulog_entry_offset(e),
+				out_get_size_str(er->size,
+					a->pip->args.human));
+			for (uint64_t b = 0; b < er->size; b++)
+				outv(a->v, "%02x", er->data[b]);
+			outv(a->v, " ");
+			break;
 		case ULOG_OPERATION_BUF_CPY:
 		case ULOG_OPERATION_BUF_SET:
 			eb = (struct ulog_entry_buf *)e;
@@ -560,6 +578,313 @@ info_obj_root_obj(struct pmem_info *pip)
 	info_obj_object_hdr(pip, v, VERBOSE_SILENT, &m, 0);
 }
 
+/*
+ * Statistics cache -- a sidecar file with a per-zone snapshot of heap
+ * statistics.  Each zone's snapshot is keyed by a checksum of the zone's
+ * heap metadata, so a subsequent run has to re-scan only the zones which
+ * changed since the snapshot was taken.
+ */
+#define STATS_CACHE_SIGNATURE		"PMEMSCAC"
+#define STATS_CACHE_SIGNATURE_LEN	8
+#define STATS_CACHE_MAJOR		1
+
+struct stats_cache_hdr {
+	char signature[STATS_CACHE_SIGNATURE_LEN];
+	uint32_t major;
+	uint32_t reserved;
+	uuid_t pool_uuid;	/* pool set UUID the snapshot was taken from */
+	uint64_t heap_size;
+	uint64_t chunk_types;	/* chunk type filter the snapshot was taken with */
+	uint64_t nzones;
+};
+
+/*
+ * stats_cache_zone -- fixed-size part of an on-file zone record, followed
+ * by nclasses pmem_obj_class_stats and ntypes pmem_obj_zone_type_stats
+ */
+struct stats_cache_zone {
+	uint64_t fingerprint;
+	uint64_t n_chunks;
+	uint64_t n_chunks_type[MAX_CHUNK_TYPE];
+	uint64_t size_chunks;
+	uint64_t size_chunks_type[MAX_CHUNK_TYPE];
+	uint64_t n_objects;
+	uint64_t n_bytes;
+	uint64_t nclasses;
+	uint64_t ntypes;
+};
+
+/*
+ * stats_cache_ranges_entire -- (internal) check if a range filter is a no-op
+ */
+static int
+stats_cache_ranges_entire(struct ranges *rangesp)
+{
+	return util_ranges_contain(rangesp, 0) &&
+		util_ranges_contain(rangesp, UINT64_MAX);
+}
+
+/*
+ * stats_cache_usable -- (internal) check if the statistics cache can be used
+ *
+ * The cache can short-circuit the zone walk only when the walk's output is
+ * consumed by statistics alone and no option narrows the walk down.
+ */
+static int
+stats_cache_usable(struct pmem_info *pip)
+{
+	if (pip->args.obj.stats_cache == NULL)
+		return 0;
+
+	return outv_check(pip->args.vstats) &&
+		!outv_check(pip->args.obj.vheap) &&
+		!outv_check(pip->args.obj.vzonehdr) &&
+		!outv_check(pip->args.obj.vchunkhdr) &&
+		!outv_check(pip->args.obj.vobjects) &&
+		stats_cache_ranges_entire(&pip->args.ranges) &&
+		stats_cache_ranges_entire(&pip->args.obj.type_ranges) &&
+		stats_cache_ranges_entire(&pip->args.obj.zone_ranges) &&
+		stats_cache_ranges_entire(&pip->args.obj.chunk_ranges);
+}
+
+/*
+ * stats_cache_zone_fp -- (internal) compute a zone's metadata fingerprint
+ *
+ * The fingerprint covers the zone header, all chunk headers and all run
+ * bitmaps, i.e. everything which changes whenever chunks are carved up or
+ * run-based allocations come and go.  Object data is deliberately left out,
+ * so in-place modifications of objects do not invalidate the snapshot.
+ */
+static uint64_t
+stats_cache_zone_fp(struct pmem_info *pip, struct zone *zone, uint64_t z)
+{
+	uint64_t fp = util_checksum_seq(&zone->header,
+			sizeof(zone->header), 0);
+
+	if (zone->header.magic != ZONE_HEADER_MAGIC)
+		return fp;
+
+	fp = util_checksum_seq(zone->chunk_headers,
+			zone->header.size_idx * sizeof(struct chunk_header),
+			fp);
+
+	uint64_t c = 0;
+	while (c < zone->header.size_idx) {
+		struct chunk_header *chunk_hdr = &zone->chunk_headers[c];
+
+		if (chunk_hdr->type == CHUNK_TYPE_RUN) {
+			struct chunk_run *run =
+				(struct chunk_run *)&zone->chunks[c];
+
+			struct memory_block m = MEMORY_BLOCK_NONE;
+			m.zone_id = (uint32_t)z;
+			m.chunk_id = (uint32_t)c;
+			m.size_idx = (uint32_t)chunk_hdr->size_idx;
+			memblock_rebuild_state(pip->obj.heap, &m);
+
+			struct run_bitmap bitmap;
+			m.m_ops->get_bitmap(&m, &bitmap);
+
+			fp = util_checksum_seq(&run->hdr, sizeof(run->hdr),
+					fp);
+			fp = util_checksum_seq(bitmap.values,
+					bitmap.nvalues * sizeof(uint64_t), fp);
+		}
+
+		c += chunk_hdr->size_idx;
+	}
+
+	return fp;
+}
+
+/*
+ * stats_cache_free -- (internal) free zone records loaded from the cache
+ */
+static void
+stats_cache_free(struct pmem_obj_zone_stats *zs, size_t nzones)
+{
+	if (zs == NULL)
+		return;
+
+	for (size_t i = 0; i < nzones; i++) {
+		VEC_DELETE(&zs[i].class_stats);
+		VEC_DELETE(&zs[i].type_stats);
+	}
+
+	free(zs);
+}
+
+/*
+ * stats_cache_load -- (internal) read per-zone snapshots from the cache file
+ *
+ * Returns NULL if the file does not exist or does not match the pool --
+ * both simply mean a full scan.
+ */
+static struct pmem_obj_zone_stats *
+stats_cache_load(struct pmem_info *pip, size_t nzones)
+{
+	struct pmem_obj_zone_stats *zs = NULL;
+
+	FILE *file = os_fopen(pip->args.obj.stats_cache, "rb");
+	if (file == NULL)
+		return NULL;
+
+	struct stats_cache_hdr hdr;
+	if (fread(&hdr, sizeof(hdr), 1, file) != 1)
+		goto err;
+
+	if (memcmp(hdr.signature, STATS_CACHE_SIGNATURE,
+				STATS_CACHE_SIGNATURE_LEN) ||
+	    hdr.major != STATS_CACHE_MAJOR ||
+	    uuidcmp(hdr.pool_uuid, pip->obj.pop->hdr.poolset_uuid) ||
+	    hdr.heap_size != pip->obj.pop->heap_size ||
+	    hdr.chunk_types != pip->args.obj.chunk_types ||
+	    hdr.nzones != nzones)
+		goto err;
+
+	zs = calloc(nzones, sizeof(*zs));
+	if (!zs)
+		err(1, "Cannot allocate memory for cached zone stats");
+
+	for (size_t i = 0; i < nzones; i++) {
+		struct stats_cache_zone rec;
+		if (fread(&rec, sizeof(rec), 1, file) != 1)
+			goto err;
+
+		zs[i].fingerprint = rec.fingerprint;
+		zs[i].n_chunks = rec.n_chunks;
+		memcpy(zs[i].n_chunks_type, rec.n_chunks_type,
+				sizeof(rec.n_chunks_type));
+		zs[i].size_chunks = rec.size_chunks;
+		memcpy(zs[i].size_chunks_type, rec.size_chunks_type,
+				sizeof(rec.size_chunks_type));
+		zs[i].n_objects = rec.n_objects;
+		zs[i].n_bytes = rec.n_bytes;
+
+		for (uint64_t c = 0; c < rec.nclasses; c++) {
+			struct pmem_obj_class_stats cstats;
+			if (fread(&cstats, sizeof(cstats), 1, file) != 1)
+				goto err;
+			if (VEC_PUSH_BACK(&zs[i].class_stats, cstats))
+				err(1, "Cannot allocate memory for zone stats");
+		}
+
+		for (uint64_t t = 0; t < rec.ntypes; t++) {
+			struct pmem_obj_zone_type_stats tstats;
+			if (fread(&tstats, sizeof(tstats), 1, file) != 1)
+				goto err;
+			if (VEC_PUSH_BACK(&zs[i].type_stats, tstats))
+				err(1, "Cannot allocate memory for zone stats");
+		}
+	}
+
+	fclose(file);
+	return zs;
+err:
+	stats_cache_free(zs, nzones);
+	fclose(file);
+	return NULL;
+}
+
+/*
+ * stats_cache_store -- (internal) write per-zone snapshots to the cache file
+ */
+static void
+stats_cache_store(struct pmem_info *pip)
+{
+	const char *path = pip->args.obj.stats_cache;
+	struct pmem_obj_stats *stats = &pip->obj.stats;
+
+	FILE *file = os_fopen(path, "wb");
+	if (file == NULL) {
+		outv_err("cannot write statistics cache '%s'\n", path);
+		return;
+	}
+
+	struct stats_cache_hdr hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.signature, STATS_CACHE_SIGNATURE,
+			STATS_CACHE_SIGNATURE_LEN);
+	hdr.major = STATS_CACHE_MAJOR;
+	memcpy(hdr.pool_uuid, pip->obj.pop->hdr.poolset_uuid,
+			POOL_HDR_UUID_LEN);
+	hdr.heap_size = pip->obj.pop->heap_size;
+	hdr.chunk_types = pip->args.obj.chunk_types;
+	hdr.nzones = stats->n_zones;
+
+	if (fwrite(&hdr, sizeof(hdr), 1, file) != 1)
+		goto err;
+
+	for (uint64_t i = 0; i < stats->n_zones; i++) {
+		struct pmem_obj_zone_stats *zstats = &stats->zone_stats[i];
+		struct stats_cache_zone rec;
+		memset(&rec, 0, sizeof(rec));
+
+		rec.fingerprint = zstats->fingerprint;
+		rec.n_chunks = zstats->n_chunks;
+		memcpy(rec.n_chunks_type, zstats->n_chunks_type,
+				sizeof(rec.n_chunks_type));
+		rec.size_chunks = zstats->size_chunks;
+		memcpy(rec.size_chunks_type, zstats->size_chunks_type,
+				sizeof(rec.size_chunks_type));
+		rec.n_objects = zstats->n_objects;
+		rec.n_bytes = zstats->n_bytes;
+		rec.nclasses = VEC_SIZE(&zstats->class_stats);
+		rec.ntypes = VEC_SIZE(&zstats->type_stats);
+
+		if (fwrite(&rec, sizeof(rec), 1, file) != 1)
+			goto err;
+
+		struct pmem_obj_class_stats *cstats;
+		VEC_FOREACH_BY_PTR(cstats, &zstats->class_stats) {
+			if (fwrite(cstats, sizeof(*cstats), 1, file) != 1)
+				goto err;
+		}
+
+		struct pmem_obj_zone_type_stats *tstats;
+		VEC_FOREACH_BY_PTR(tstats, &zstats->type_stats) {
+			if (fwrite(tstats, sizeof(*tstats), 1, file) != 1)
+				goto err;
+		}
+	}
+
+	if (fclose(file))
+		goto err_closed;
+	return;
+err:
+	fclose(file);
+err_closed:
+	outv_err("cannot write statistics cache '%s'\n", path);
+	(void) util_unlink(path);
+}
+
+/*
+ * stats_cache_zone_reuse -- (internal) adopt a cached zone snapshot
+ *
+ * Moves the cached record into the zone's stats (including ownership of
+ * its vectors) and merges the zone's object counts into the pool totals.
+ */
+static void
+stats_cache_zone_reuse(struct pmem_info *pip,
+	struct pmem_obj_zone_stats *cached, struct pmem_obj_zone_stats *zstats)
+{
+	*zstats = *cached;
+	VEC_INIT(&cached->class_stats);
+	VEC_INIT(&cached->type_stats);
+
+	struct pmem_obj_stats *stats = &pip->obj.stats;
+	stats->n_total_objects += zstats->n_objects;
+	stats->n_total_bytes += zstats->n_bytes;
+
+	struct pmem_obj_zone_type_stats *tstats;
+	VEC_FOREACH_BY_PTR(tstats, &zstats->type_stats) {
+		struct pmem_obj_type_stats *type =
+			pmem_obj_stats_get_type(stats, tstats->type_num);
+		type->n_objects += tstats->n_objects;
+		type->n_bytes += tstats->n_bytes;
+	}
+}
+
 /*
  * info_obj_zones -- print zones and chunks
  */
@@ -580,29 +905,108 @@ info_obj_zones_chunks(struct pmem_info *pip)
 	if (!pip->obj.stats.zone_stats)
 		err(1, "Cannot allocate memory for zone stats");
 
+	int cacheable = stats_cache_usable(pip);
+	if (pip->args.obj.stats_cache && !cacheable)
+		outv_err(
+			"statistics cache ignored -- it cannot be used with options which narrow down or print the zone walk\n");
+
+	struct pmem_obj_zone_stats *cached = NULL;
+	if (cacheable)
+		cached = stats_cache_load(pip, maxzone);
+
 	for (size_t i = 0; i < maxzone; i++) {
 		struct zone *zone = ZID_TO_ZONE(layout, i);
 
-		if (util_ranges_contain(&pip->args.obj.zone_ranges, i)) {
-			int vvv = pip->args.obj.vheap &&
-				(pip->args.obj.vzonehdr ||
-				pip->args.obj.vchunkhdr);
+		if (!util_ranges_contain(&pip->args.obj.zone_ranges, i))
+			continue;
+
+		int vvv = pip->args.obj.vheap &&
+			(pip->args.obj.vzonehdr ||
+			pip->args.obj.vchunkhdr);
+
+		outv_title(vvv, "Zone %zu", i);
+
+		if (zone->header.magic == ZONE_HEADER_MAGIC)
+			pip->obj.stats.n_zones_used++;
 
-			outv_title(vvv, "Zone %zu", i);
+		info_obj_zone_hdr(pip, pip->args.obj.vheap &&
+				pip->args.obj.vzonehdr,
+				&zone->header);
 
-			if (zone->header.magic == ZONE_HEADER_MAGIC)
-				pip->obj.stats.n_zones_used++;
+		struct pmem_obj_zone_stats *zstats =
+			&pip->obj.stats.zone_stats[i];
+
+		if (cacheable) {
+			zstats->fingerprint = stats_cache_zone_fp(pip,
+					zone, i);
+
+			if (cached &&
+			    cached[i].fingerprint == zstats->fingerprint) {
+				stats_cache_zone_reuse(pip, &cached[i],
+						zstats);
+				continue;
+			}
+		}
 
-			info_obj_zone_hdr(pip, pip->args.obj.vheap &&
-					pip->args.obj.vzonehdr,
-					&zone->header);
+		/*
+		 * Snapshot the object totals so the zone's share of them can
+		 * be computed after the walk and kept in the cache.
+		 */
+		uint64_t n_objects = pip->obj.stats.n_total_objects;
+		uint64_t n_bytes = pip->obj.stats.n_total_bytes;
+		VEC(, struct pmem_obj_zone_type_stats) typesnap;
+		VEC_INIT(&typesnap);
+		if (cacheable) {
+			struct pmem_obj_type_stats *type;
+			PMDK_TAILQ_FOREACH(type, &pip->obj.stats.type_stats,
+					next) {
+				struct pmem_obj_zone_type_stats t = {
+					type->type_num, type->n_objects,
+					type->n_bytes};
+				if (VEC_PUSH_BACK(&typesnap, t))
+					err(1, "Cannot allocate memory for zone stats");
+			}
+		}
 
-			outv_indent(vvv, 1);
-			info_obj_zone_chunks(pip, zone, i,
-					&pip->obj.stats.zone_stats[i]);
-			outv_indent(vvv, -1);
+		outv_indent(vvv, 1);
+		info_obj_zone_chunks(pip, zone, i, zstats);
+		outv_indent(vvv, -1);
+
+		if (cacheable) {
+			zstats->n_objects = pip->obj.stats.n_total_objects -
+				n_objects;
+			zstats->n_bytes = pip->obj.stats.n_total_bytes -
+				n_bytes;
+
+			struct pmem_obj_type_stats *type;
+			PMDK_TAILQ_FOREACH(type, &pip->obj.stats.type_stats,
+					next) {
+				struct pmem_obj_zone_type_stats t = {
+					type->type_num, type->n_objects,
+					type->n_bytes};
+
+				struct pmem_obj_zone_type_stats *old;
+				VEC_FOREACH_BY_PTR(old, &typesnap) {
+					if (old->type_num != t.type_num)
+						continue;
+					t.n_objects -= old->n_objects;
+					t.n_bytes -= old->n_bytes;
+					break;
+				}
+
+				if (t.n_objects == 0 && t.n_bytes == 0)
+					continue;
+				if (VEC_PUSH_BACK(&zstats->type_stats, t))
+					err(1, "Cannot allocate memory for zone stats");
+			}
 		}
+
+		VEC_DELETE(&typesnap);
 	}
+
+	if (cacheable)
+		stats_cache_store(pip);
+	stats_cache_free(cached, maxzone);
 }
 
 /*
@@ -557,6 +557,8 @@ out_get_chunk_type_str(enum chunk_type type)
 		return "used";
 	case CHUNK_TYPE_RUN:
 		return "run";
+	case CHUNK_TYPE_BADBLOCK:
+		return "badblock";
 	case CHUNK_TYPE_UNKNOWN:
 	default:
 		return "unknown";
@@ -19,6 +19,8 @@
 #include "dump.h"
 #include "check.h"
 #include "rm.h"
+#include "recycle.h"
+#include "restore.h"
 #include "convert.h"
 #include "synchronize.h"
 #include "transform.h"
@@ -108,6 +110,12 @@ static const struct command commands[] = {
 		.func = pmempool_dump_func,
 		.help = pmempool_dump_help,
 	},
+	{
+		.name = "restore",
+		.brief = "restore a pool file from a binary stream dump",
+		.func = pmempool_restore_func,
+		.help = pmempool_restore_help,
+	},
 	{
 		.name = "check",
 		.brief = "check consistency of a pool",
@@ -120,6 +128,12 @@ static const struct command commands[] = {
 		.func = pmempool_rm_func,
 		.help = pmempool_rm_help,
 	},
+	{
+		.name = "recycle",
+		.brief = "re-initialize a pool file in place",
+		.func = pmempool_recycle_func,
+		.help = pmempool_recycle_help,
+	},
 	{
 		.name = "convert",
 		.brief = "perform pool layout conversion",
@@ -0,0 +1,245 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2026, Intel Corporation */
+
+/*
+ * recycle.c -- pmempool recycle command source file
+ *
+ * Re-initializes an existing pool file in place. Removing and recreating
+ * a pool unlinks the file and preallocates a new one, so every block is
+ * zeroed and faulted in again; recycling instead zeroes just the pool
+ * header - the only region that must be empty for pool creation - and
+ * recreates the pool in the same file, reusing the already allocated
+ * file system blocks. The layout name and permissions are taken from the
+ * old pool unless overridden.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+#include "common.h"
+#include "recycle.h"
+#include "output.h"
+#include "os.h"
+#include "set.h"
+#include "file.h"
+#include "pool_hdr.h"
+#include "libpmemobj.h"
+
+/*
+ * pmempool_recycle -- context and arguments for recycle command
+ */
+struct pmempool_recycle {
+	int verbose;
+	char *fname;
+	char *layout;
+	struct pmem_pool_params params;
+};
+
+/*
+ * pmempool_recycle_default -- default arguments and context values
+ */
+static const struct pmempool_recycle pmempool_recycle_default = {
+	.verbose	= 0,
+	.fname		= NULL,
+	.layout		= NULL,
+};
+
+/*
+ * long_options -- command line options
+ */
+static const struct option long_options[] = {
+	{"layout",	required_argument,	NULL,	'l'},
+	{"verbose",	no_argument,		NULL,	'v'},
+	{"help",	no_argument,		NULL,	'h'},
+	{NULL,		0,			NULL,	 0 },
+};
+
+/*
+ * help_str -- string for help message
+ */
+static const char * const help_str =
+"Re-initialize a pool file in place, reusing its allocated blocks\n"
+"\n"
+"Available options:\n"
+"  -l, --layout <name>  layout name stored in pool's header\n"
+"                       (the default is the old pool's layout)\n"
+"  -v, --verbose        increase verbosity level\n"
+"  -h, --help           display this help and exit\n"
+"\n"
+"For complete documentation see %s-recycle(1) manual page.\n"
+;
+
+/*
+ * print_usage -- print application usage short description
+ */
+static void
+print_usage(const char *appname)
+{
+	printf("Usage: %s recycle [<args>] <file>\n", appname);
+}
+
+/*
+ * print_version -- print version string
+ */
+static void
+print_version(const char *appname)
+{
+	printf("%s %s\n", appname, SRCVERSION);
+}
+
+/*
+ * pmempool_recycle_help -- print help message for recycle command
+ */
+void
+pmempool_recycle_help(const char *appname)
+{
+	print_usage(appname);
+	print_version(appname);
+	printf(help_str, appname);
+}
+
+/*
+ * pmempool_recycle_zero_hdr -- (internal) zeroes the pool header of the file
+ *
+ * The header is the only region pool creation requires to be empty; the
+ * exclusive lock guards against recycling a pool that is still open.
+ */
+static int
+pmempool_recycle_zero_hdr(const char *fname)
+{
+	int fd = os_open(fname, O_RDWR);
+	if (fd < 0) {
+		outv_err("!open '%s' failed", fname);
+		return -1;
+	}
+
+	int ret = -1;
+
+	if (os_flock(fd, OS_LOCK_EX | OS_LOCK_NB)) {
+		outv_err("'%s' -- pool is in use\n", fname);
+		goto out;
+	}
+
+	char hdr[sizeof(struct pool_hdr)];
+	memset(hdr, 0, sizeof(hdr));
+
+	ssize_t written = pwrite(fd, hdr, sizeof(hdr), 0);
+	if (written != (ssize_t)sizeof(hdr)) {
+		outv_err("!writing pool header of '%s' failed", fname);
+		goto out_unlock;
+	}
+
+	if (os_fsync(fd)) {
+		outv_err("!fsync '%s' failed", fname);
+		goto out_unlock;
+	}
+
+	ret = 0;
+out_unlock:
+	(void) os_flock(fd, OS_LOCK_UN);
+out:
+	os_close(fd);
+	return ret;
+}
+
+/*
+ * pmempool_recycle_func -- main function for recycle command
+ */
+int
+pmempool_recycle_func(const char *appname, int argc, char *argv[])
+{
+	struct pmempool_recycle pr = pmempool_recycle_default;
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "l:vh",
+			long_options, NULL)) != -1) {
+		switch (opt) {
+		case 'l':
+			pr.layout = optarg;
+			break;
+		case 'v':
+			pr.verbose = 1;
+			break;
+		case 'h':
+			pmempool_recycle_help(appname);
+			return 0;
+		default:
+			print_usage(appname);
+			return -1;
+		}
+	}
+
+	if (optind + 1 != argc) {
+		print_usage(appname);
+		return -1;
+	}
+
+	pr.fname = argv[optind];
+
+	/* set verbosity level */
+	out_set_vlevel(pr.verbose);
+
+	if (util_file_exists(pr.fname) != 1) {
+		outv_err("'%s' -- no such file\n", pr.fname);
+		return -1;
+	}
+
+	if (util_is_poolset_file(pr.fname) == 1) {
+		outv_err("'%s' -- poolset files are not supported\n",
+				pr.fname);
+		return -1;
+	}
+
+	if (pmem_pool_parse_params(pr.fname, &pr.params, 1)) {
+		if (errno)
+			perror(pr.fname);
+		else
+			outv_err("%s: cannot determine type of pool\n",
+					pr.fname);
+		return -1;
+	}
+
+	if (pr.params.type != PMEM_POOL_TYPE_OBJ) {
+		outv_err("'%s' -- unsupported pool type: %s\n", pr.fname,
+				out_get_pool_type_str(pr.params.type));
+		return -1;
+	}
+
+	if (pr.layout == NULL)
+		pr.layout = pr.params.obj.layout;
+
+	outv(1, "Recycling pool: %s\n", pr.fname);
+	outv(1, "\tsize  : %s\n", out_get_size_str(pr.params.size, 2));
+	outv(1, "\tmode  : 0%o\n", pr.params.mode);
+	outv(1, "\tlayout: '%s'\n", pr.layout);
+
+	if (pmempool_recycle_zero_hdr(pr.fname))
+		return -1;
+
+	/*
+	 * The file's blocks are already allocated and the data does not
+	 * need to be zeroed for creation to succeed, so skip the
+	 * preallocation pass entirely.
+	 */
+	int at_create = 0;
+	if (pmemobj_ctl_set(NULL, "fallocate.at_create", &at_create) != 0) {
+		outv_err("'%s' -- %s\n", pr.fname, pmemobj_errormsg());
+		return -1;
+	}
+
+	PMEMobjpool *pop = pmemobj_create(pr.fname, pr.layout, 0,
+			pr.params.mode);
+	if (!pop) {
+		outv_err("'%s' -- %s\n", pr.fname, pmemobj_errormsg());
+		return -1;
+	}
+
+	pmemobj_close(pop);
+
+	return 0;
+}
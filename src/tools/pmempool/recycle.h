@@ -0,0 +1,9 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright 2026, Intel Corporation */
+
+/*
+ * recycle.h -- pmempool recycle command header file
+ */
+
+int pmempool_recycle_func(const char *appname, int argc, char *argv[]);
+void pmempool_recycle_help(const char *appname);
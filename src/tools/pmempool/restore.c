@@ -0,0 +1,249 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2024, Intel Corporation */
+
+/*
+ * restore.c -- pmempool restore command source file
+ *
+ * Recreates a pool file from a binary stream produced by the dump command
+ * with the --stream option. The extents are written at their original
+ * offsets and the elided all-zero ranges become holes, so the restored
+ * file is logically identical to the dumped pool.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+#include "common.h"
+#include "dump.h"
+#include "restore.h"
+#include "output.h"
+#include "os.h"
+
+/*
+ * pmempool_restore -- context and arguments for restore command
+ */
+struct pmempool_restore {
+	char *dfname;
+	char *fname;
+	FILE *dfh;
+	int force;
+};
+
+/*
+ * pmempool_restore_default -- default arguments and context values
+ */
+static const struct pmempool_restore pmempool_restore_default = {
+	.dfname		= NULL,
+	.fname		= NULL,
+	.dfh		= NULL,
+	.force		= 0,
+};
+
+/*
+ * long_options -- command line options
+ */
+static const struct option long_options[] = {
+	{"force",	no_argument,	NULL,	'f'},
+	{"help",	no_argument,	NULL,	'h'},
+	{NULL,		0,		NULL,	 0 },
+};
+
+/*
+ * help_str -- string for help message
+ */
+static const char * const help_str =
+"Restore a pool file from a binary stream dump\n"
+"\n"
+"Available options:\n"
+"  -f, --force          overwrite an existing pool file\n"
+"  -h, --help           display this help and exit\n"
+"\n"
+"For complete documentation see %s-restore(1) manual page.\n"
+;
+
+/*
+ * print_usage -- print application usage short description
+ */
+static void
+print_usage(const char *appname)
+{
+	printf("Usage: %s restore [<args>] <dump-file> <pool-file>\n",
+			appname);
+}
+
+/*
+ * print_version -- print version string
+ */
+static void
+print_version(const char *appname)
+{
+	printf("%s %s\n", appname, SRCVERSION);
+}
+
+/*
+ * pmempool_restore_help -- print help message for restore command
+ */
+void
+pmempool_restore_help(const char *appname)
+{
+	print_usage(appname);
+	print_version(appname);
+	printf(help_str, appname);
+}
+
+/*
+ * pmempool_restore_stream -- (internal) recreates the pool file from the
+ *	dump stream
+ */
+static int
+pmempool_restore_stream(struct pmempool_restore *pr)
+{
+	struct dump_stream_hdr hdr;
+	if (fread(&hdr, sizeof(hdr), 1, pr->dfh) != 1) {
+		outv_err("%s: cannot read stream header\n", pr->dfname);
+		return -1;
+	}
+
+	if (memcmp(hdr.signature, DUMP_STREAM_SIGNATURE,
+			sizeof(hdr.signature)) != 0) {
+		outv_err("%s: not a stream dump\n", pr->dfname);
+		return -1;
+	}
+
+	if (hdr.major != DUMP_STREAM_MAJOR) {
+		outv_err("%s: unsupported stream version %u\n", pr->dfname,
+				hdr.major);
+		return -1;
+	}
+
+	int flags = O_RDWR | O_CREAT | (pr->force ? O_TRUNC : O_EXCL);
+	int fd = os_open(pr->fname, flags, 0664);
+	if (fd < 0) {
+		warn("%s", pr->fname);
+		return -1;
+	}
+
+	int ret = 0;
+
+	char *buff = malloc(DUMP_STREAM_BLOCK_SIZE);
+	if (buff == NULL) {
+		warn("malloc");
+		goto err;
+	}
+
+	if (os_ftruncate(fd, (os_off_t)hdr.poolsize) != 0) {
+		warn("%s", pr->fname);
+		goto err;
+	}
+
+	struct dump_stream_extent ext;
+	for (;;) {
+		if (fread(&ext, sizeof(ext), 1, pr->dfh) != 1) {
+			outv_err("%s: truncated stream\n", pr->dfname);
+			goto err;
+		}
+
+		if (ext.length == 0)
+			break;
+
+		if (ext.offset > hdr.poolsize ||
+		    ext.length > hdr.poolsize - ext.offset) {
+			outv_err("%s: extent outside of the pool\n",
+					pr->dfname);
+			goto err;
+		}
+
+		uint64_t off = ext.offset;
+		uint64_t remaining = ext.length;
+		while (remaining > 0) {
+			size_t len = remaining < DUMP_STREAM_BLOCK_SIZE ?
+				remaining : DUMP_STREAM_BLOCK_SIZE;
+
+			if (fread(buff, 1, len, pr->dfh) != len) {
+				outv_err("%s: truncated stream\n",
+						pr->dfname);
+				goto err;
+			}
+
+			if (pwrite(fd, buff, len, (os_off_t)off) !=
+					(ssize_t)len) {
+				warn("%s", pr->fname);
+				goto err;
+			}
+
+			off += len;
+			remaining -= len;
+		}
+	}
+
+	if (ext.offset != hdr.poolsize) {
+		outv_err("%s: unexpected stream terminator\n", pr->dfname);
+		goto err;
+	}
+
+out:
+	free(buff);
+	os_close(fd);
+
+	return ret;
+
+err:
+	ret = -1;
+	goto out;
+}
+
+/*
+ * pmempool_restore_func -- restore command main function
+ */
+int
+pmempool_restore_func(const char *appname, int argc, char *argv[])
+{
+	struct pmempool_restore pr = pmempool_restore_default;
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "fh",
+			long_options, NULL)) != -1) {
+		switch (opt) {
+		case 'f':
+			pr.force = 1;
+			break;
+		case 'h':
+			pmempool_restore_help(appname);
+			exit(EXIT_SUCCESS);
+		default:
+			print_usage(appname);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (optind + 1 >= argc) {
+		print_usage(appname);
+		exit(EXIT_FAILURE);
+	}
+
+	pr.dfname = argv[optind];
+	pr.fname = argv[optind + 1];
+
+	if (strcmp(pr.dfname, "-") == 0) {
+		/* read the stream from standard input, e.g. down a pipe */
+		pr.dfh = stdin;
+	} else {
+		pr.dfh = os_fopen(pr.dfname, "rb");
+		if (!pr.dfh) {
+			warn("%s", pr.dfname);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	int ret = pmempool_restore_stream(&pr);
+
+	if (pr.dfh != stdin)
+		fclose(pr.dfh);
+
+	return ret;
+}
@@ -0,0 +1,9 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright 2024, Intel Corporation */
+
+/*
+ * restore.h -- pmempool restore command header file
+ */
+
+void pmempool_restore_help(const char *appname);
+int pmempool_restore_func(const char *appname, int argc, char *argv[]);
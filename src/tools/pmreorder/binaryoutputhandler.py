@@ -6,6 +6,7 @@ from reorderexceptions import InconsistentFileException
 from sys import byteorder
 import utils
 import os
+import shutil
 
 
 class BinaryOutputHandler:
@@ -59,6 +60,33 @@ class BinaryOutputHandler:
             if bf.file_name is file:
                 self._files.remove(bf)
 
+    def make_copy(self, dest_dir):
+        """
+        Create a new handler working on copies of the registered files.
+
+        Each registered file is copied into the given directory and
+        registered at its original base address, so stores, reverts and
+        consistency checks made through the returned handler leave the
+        original files untouched.
+
+        :param dest_dir: The directory the file copies are created in.
+        :type dest_dir: str
+        :return: A new handler over the copied files.
+        :rtype: BinaryOutputHandler
+        """
+        handler = BinaryOutputHandler(self._checker, self._logger)
+        for bf in self._files:
+            copy_path = os.path.join(
+                dest_dir, os.path.basename(bf._file_name)
+            )
+            shutil.copyfile(bf._file_name, copy_path)
+            handler.add_file(
+                copy_path,
+                bf.get_base_address(),
+                bf.get_max_address() - bf.get_base_address(),
+            )
+        return handler
+
     def do_store(self, store_op):
         """
         Perform a store to the given file.
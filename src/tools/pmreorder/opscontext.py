@@ -23,9 +23,12 @@ class OpsContext:
     :ivar default_barrier: Default consistency barrier status.
     :type default_barrier: bool
     :ivar file_handler: The file handler used.
+    :ivar jobs: Number of processes used to check sequences in parallel.
+    :type jobs: int
     """
 
-    def __init__(self, log_file, checker, logger, arg_engine, markers):
+    def __init__(self, log_file, checker, logger, arg_engine, markers,
+                 jobs=1):
         """
         Splits the operations in the log file and sets the instance variables
         to default values.
@@ -47,6 +50,7 @@ class OpsContext:
         self.logger = logger
         self.markers = markers
         self.stack_engines = [("START", getattr(memoryoperations, arg_engine))]
+        self.jobs = jobs
 
     # TODO this should probably be made a generator
     def extract_operations(self):
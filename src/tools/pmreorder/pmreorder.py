@@ -79,6 +79,15 @@ def main():
         action="version",
         version="%(prog)s " + pmreorder_version,
     )
+    parser.add_argument(
+        "-j",
+        "--jobs",
+        type=int,
+        default=1,
+        help="number of processes used to check the generated "
+        + "sequences in parallel, each working on its own copies "
+        + "of the registered files, default=1",
+    )
     engines_keys = list(reorderengines.engines.keys())
     parser.add_argument(
         "-r",
@@ -96,8 +105,12 @@ def main():
     markers = markerparser.MarkerParser().get_markers(args.extended_macros)
 
     # create the script context
+    if args.jobs < 1:
+        parser.error("--jobs must be a positive number")
+
     context = opscontext.OpsContext(
-        args.logfile, checker, logger, args.default_engine, markers
+        args.logfile, checker, logger, args.default_engine, markers,
+        args.jobs
     )
     logger.debug("Input parameters: {}".format(context.__dict__))
 
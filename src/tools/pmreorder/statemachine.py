@@ -5,7 +5,10 @@ import memoryoperations as memops
 import reorderengines
 from reorderexceptions import InconsistentFileException
 from reorderexceptions import NotSupportedOperationException
+import multiprocessing
 import os
+import shutil
+import tempfile
 
 
 class State:
@@ -311,39 +314,146 @@ class ReplayingState(State):
         if self._context.test_on_barrier:
             self._context.logger.debug("Current reorder engine: {}"
                                        .format(self._context.reorder_engine))
+            if self._context.jobs > 1:
+                consistency = self.replay_parallel(flushed_stores)
+            else:
+                consistency = self.replay_sequential(flushed_stores)
+        # write all flushed stores
+        for op in flushed_stores:
+            self._context.file_handler.do_store(op)
+
+        return consistency
+
+    def replay_sequential(self, flushed_stores):
+        """
+        Replays all generated sequences one after another.
+
+        The sequences are applied to the registered files themselves,
+        with each sequence reverted before the next one is tried.
+
+        :param flushed_stores: The stores to generate sequences from.
+        :type flushed_stores: list of :class:`memoryoperations.Store`
+        :return: State of consistency check.
+        :rtype: bool
+        """
+        consistency = True
+        for i, seq in enumerate(
+            self._context.reorder_engine.generate_sequence(flushed_stores)
+        ):
+            self._context.logger.debug(
+                "NEXT Sequence (no. {0}) with length: \
+                    {1}".format(i, len(seq))
+            )
+            for j, op in enumerate(seq):
+                self._context.logger.debug(
+                    "NEXT Operation (no. {0}): {1}".format(j, op)
+                )
+                # do stores
+                self._context.file_handler.do_store(op)
+            # check consistency of all files
+            try:
+                self._context.file_handler.check_consistency()
+            except InconsistentFileException as e:
+                consistency = False
+                self._context.logger.warning(e)
+                stacktrace = "Call trace:\n"
+                for num, op in enumerate(seq):
+                    stacktrace += "Store [{}]:\n".format(num)
+                    stacktrace += str(op.trace)
+                self._context.logger.warning(stacktrace)
+
+            for op in reversed(seq):
+                # revert the changes
+                self._context.file_handler.do_revert(op)
+
+        return consistency
+
+    def replay_parallel(self, flushed_stores):
+        """
+        Replays the generated sequences across multiple processes.
+
+        The workers are forked at the barrier, so each of them inherits
+        a snapshot of the replaying state and regenerates the same
+        sequences as the sequential replay would; the sequences are
+        split between the workers round-robin by their position in the
+        generated order. Inconsistencies found by the workers are
+        reported through the parent logger once all of them finish.
+
+        :param flushed_stores: The stores to generate sequences from.
+        :type flushed_stores: list of :class:`memoryoperations.Store`
+        :return: State of consistency check.
+        :rtype: bool
+        """
+        jobs = self._context.jobs
+        queue = multiprocessing.Queue()
+        workers = [
+            multiprocessing.Process(
+                target=self.replay_worker,
+                args=(flushed_stores, worker_id, queue),
+            )
+            for worker_id in range(jobs)
+        ]
+        for worker in workers:
+            worker.start()
+
+        consistency = True
+        for _ in workers:
+            worker_consistency, warnings = queue.get()
+            if worker_consistency is False:
+                consistency = False
+            for message in warnings:
+                self._context.logger.warning(message)
+
+        for worker in workers:
+            worker.join()
+
+        return consistency
+
+    def replay_worker(self, flushed_stores, worker_id, queue):
+        """
+        Replays the subset of sequences assigned to one worker.
+
+        Runs in a forked child process. The registered files are copied
+        aside and a private file handler is built on top of the copies,
+        so the stores and consistency checks of this worker do not
+        interfere with the other workers or with the original files.
+
+        :param flushed_stores: The stores to generate sequences from.
+        :type flushed_stores: list of :class:`memoryoperations.Store`
+        :param worker_id: The index of this worker.
+        :type worker_id: int
+        :param queue: The queue the verdict and warnings are sent to.
+        :type queue: multiprocessing.Queue
+        :return: None
+        """
+        consistency = True
+        warnings = []
+        workdir = tempfile.mkdtemp(prefix="pmreorder{}.".format(worker_id))
+        try:
+            file_handler = self._context.file_handler.make_copy(workdir)
             for i, seq in enumerate(
                 self._context.reorder_engine.generate_sequence(flushed_stores)
             ):
-                self._context.logger.debug(
-                    "NEXT Sequence (no. {0}) with length: \
-                        {1}".format(i, len(seq))
-                )
-                for j, op in enumerate(seq):
-                    self._context.logger.debug(
-                        "NEXT Operation (no. {0}): {1}".format(j, op)
-                    )
-                    # do stores
-                    self._context.file_handler.do_store(op)
-                # check consistency of all files
+                if i % self._context.jobs != worker_id:
+                    continue
+                for op in seq:
+                    file_handler.do_store(op)
                 try:
-                    self._context.file_handler.check_consistency()
+                    file_handler.check_consistency()
                 except InconsistentFileException as e:
                     consistency = False
-                    self._context.logger.warning(e)
+                    warnings.append(str(e))
                     stacktrace = "Call trace:\n"
                     for num, op in enumerate(seq):
                         stacktrace += "Store [{}]:\n".format(num)
                         stacktrace += str(op.trace)
-                    self._context.logger.warning(stacktrace)
+                    warnings.append(stacktrace)
 
                 for op in reversed(seq):
-                    # revert the changes
-                    self._context.file_handler.do_revert(op)
-        # write all flushed stores
-        for op in flushed_stores:
-            self._context.file_handler.do_store(op)
-
-        return consistency
+                    file_handler.do_revert(op)
+        finally:
+            queue.put((consistency, warnings))
+            shutil.rmtree(workdir, ignore_errors=True)
 
 
 class StateMachine: